@@ -0,0 +1,134 @@
+#!/usr/bin/env python
+# Pack the Duet Web Control files into a flash asset bundle.
+#
+# The bundle is looked up by src/Network2/EmbeddedWebAssets.cpp, which expects to find it in flash
+# at EmbeddedWebAssetsStart (see Pins_DuetNG.h). Layout, all fields little-endian:
+#
+#   header:     magic "DWEB", version (1), number of assets, total bundle length
+#   directory:  per asset: name offset, data offset, data length, flags (bit 0 = gzipped)
+#   names:      NUL-terminated file paths relative to /www, using forward slashes
+#   data:       the file contents, each aligned to a 4-byte boundary
+#
+# Usage:
+#   make_web_bundle.py <wwwdir> <bundle.bin> [--firmware <firmware.bin> --offset <hex> --max-size <hex> --output <combined.bin>]
+#
+# With --firmware, the firmware image is padded with 0xFF up to --offset and the bundle is appended,
+# producing a single image that can be flashed in one go.
+
+from __future__ import print_function
+
+import argparse
+import gzip
+import io
+import os
+import struct
+import sys
+
+MAGIC = 0x42455744      # "DWEB" as little-endian bytes
+VERSION = 1
+
+# Files that are already compressed gain nothing from gzip
+UNCOMPRESSED_EXTENSIONS = ('.png', '.jpg', '.gif', '.zip', '.gz', '.woff', '.woff2')
+
+
+def compress(data):
+    buf = io.BytesIO()
+    # mtime=0 keeps the output reproducible, but the keyword only exists on Python 2.7+/3.1+
+    try:
+        f = gzip.GzipFile(fileobj=buf, mode='wb', mtime=0)
+    except TypeError:
+        f = gzip.GzipFile(fileobj=buf, mode='wb')
+    f.write(data)
+    f.close()
+    return buf.getvalue()
+
+
+def collect_assets(wwwdir):
+    assets = []
+    for root, dirs, files in os.walk(wwwdir):
+        dirs.sort()
+        for name in sorted(files):
+            path = os.path.join(root, name)
+            relname = os.path.relpath(path, wwwdir).replace(os.sep, '/')
+            with open(path, 'rb') as f:
+                data = f.read()
+            zipped = False
+            if not name.lower().endswith(UNCOMPRESSED_EXTENSIONS):
+                zdata = compress(data)
+                if len(zdata) < len(data):
+                    data = zdata
+                    zipped = True
+            assets.append((relname, data, zipped))
+    return assets
+
+
+def build_bundle(assets):
+    header_size = 16
+    dir_size = 16 * len(assets)
+
+    names = b''
+    name_offsets = []
+    for relname, data, zipped in assets:
+        name_offsets.append(header_size + dir_size + len(names))
+        names += relname.encode('ascii') + b'\0'
+
+    data_start = header_size + dir_size + len(names)
+    data_start = (data_start + 3) & ~3
+
+    directory = b''
+    blob = b''
+    for i, (relname, data, zipped) in enumerate(assets):
+        offset = data_start + len(blob)
+        directory += struct.pack('<IIII', name_offsets[i], offset, len(data), 1 if zipped else 0)
+        blob += data + b'\xFF' * (-len(data) % 4)
+
+    total = data_start + len(blob)
+    header = struct.pack('<IIII', MAGIC, VERSION, len(assets), total)
+    padding = b'\xFF' * (data_start - header_size - dir_size - len(names))
+    return header + directory + names + padding + blob
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Pack web files into a flash asset bundle')
+    parser.add_argument('wwwdir', help='directory holding the web files')
+    parser.add_argument('bundle', help='bundle file to write')
+    parser.add_argument('--firmware', help='firmware image to combine with the bundle')
+    parser.add_argument('--offset', help='flash offset of the bundle relative to the firmware start, in hex')
+    parser.add_argument('--max-size', help='maximum bundle size in hex, for the flash region sanity check')
+    parser.add_argument('--output', help='combined image to write when --firmware is given')
+    args = parser.parse_args()
+
+    assets = collect_assets(args.wwwdir)
+    if not assets:
+        print('No files found under ' + args.wwwdir)
+        return 1
+
+    bundle = build_bundle(assets)
+    if args.max_size is not None and len(bundle) > int(args.max_size, 16):
+        print('Bundle is %u bytes but only %u fit in the flash region' % (len(bundle), int(args.max_size, 16)))
+        return 1
+
+    with open(args.bundle, 'wb') as f:
+        f.write(bundle)
+    print('Packed %u files into %s (%u bytes)' % (len(assets), args.bundle, len(bundle)))
+
+    if args.firmware is not None:
+        if args.offset is None or args.output is None:
+            print('--firmware requires --offset and --output')
+            return 1
+        offset = int(args.offset, 16)
+        with open(args.firmware, 'rb') as f:
+            firmware = f.read()
+        if len(firmware) > offset:
+            print('Firmware is %u bytes, overlapping the bundle region at 0x%X' % (len(firmware), offset))
+            return 1
+        with open(args.output, 'wb') as f:
+            f.write(firmware)
+            f.write(b'\xFF' * (offset - len(firmware)))
+            f.write(bundle)
+        print('Wrote combined image %s' % args.output)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
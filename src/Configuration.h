@@ -67,6 +67,7 @@ constexpr float TEMPERATURE_CLOSE_ENOUGH = 1.0;			// Celsius
 constexpr float TEMPERATURE_LOW_SO_DONT_CARE = 40.0;	// Celsius
 constexpr float HOT_ENOUGH_TO_EXTRUDE = 160.0;			// Celsius
 constexpr float HOT_ENOUGH_TO_RETRACT = 90.0;			// Celsius
+constexpr float COLD_EXTRUDE_HYSTERESIS = 5.0;			// Celsius. Once allowed, extrusion stays allowed until the temperature drops this far below the threshold
 
 constexpr uint8_t MAX_BAD_TEMPERATURE_COUNT = 4;		// Number of bad temperature samples permitted before a heater fault is reported
 constexpr float BAD_LOW_TEMPERATURE = -10.0;			// Celsius
@@ -135,6 +136,7 @@ constexpr unsigned int NumTmcDriversSenseChannels = 2;	// Sensors 1001..1002 are
 // PWM frequencies
 constexpr unsigned int SlowHeaterPwmFreq = 10;			// slow PWM frequency for bed and chamber heaters, compatible with DC/AC SSRs
 constexpr unsigned int NormalHeaterPwmFreq = 250;		// normal PWM frequency used for hot ends
+constexpr unsigned int MaxStaggeredHeaterPwmFreq = 25;	// heaters at or below this PWM frequency are switched by the tick ISR with staggered phases
 constexpr PwmFrequency DefaultFanPwmFreq = 250;			// increase to 25kHz using M106 command to meet Intel 4-wire PWM fan specification
 constexpr unsigned int DefaultPinWritePwmFreq = 500;	// default PWM frequency for M42 pin writes and extrusion ancillary PWM
 
@@ -165,6 +167,17 @@ const float DefaultGridSpacing = 20.0;					// Default bed probing grid spacing i
 static_assert(MaxProbePoints <= MaxGridProbePoints, "MaxProbePoints must be <= MaxGridProbePoints");
 static_assert(MaxCalibrationPoints <= MaxProbePoints, "MaxDeltaCalibrationPoints must be <= MaxProbePoints");
 
+// Tiled height maps (see Grid.cpp). A binary height map file defining more than MaxGridProbePoints points is not loaded
+// into RAM; instead square tiles of it are read from the file on demand, so very large beds can be compensated at fine
+// spacing without the RAM usage growing with the bed size.
+constexpr size_t HeightMapTileSide = 8;					// the number of grid points along each side of a tile
+#if SAM4E || SAM4S || SAME70
+constexpr size_t NumHeightMapTiles = 16;				// how many tiles we keep resident; 16 tiles of 8x8 points need a little over 4Kb
+#else
+constexpr size_t NumHeightMapTiles = 8;
+#endif
+constexpr size_t MaxTiledGridPointsPerAxis = 2048;		// sanity limit on each axis of a tiled map; allows a 1m bed at 0.5mm spacing
+
 // SD card
 constexpr uint32_t SdCardDetectDebounceMillis = 200;	// How long we give the SD card to settle in the socket
 
@@ -175,6 +188,8 @@ constexpr float DEFAULT_TRAVEL_SPEED = 100.0;			// Default speed for travel to p
 constexpr float ZProbeMaxAcceleration = 250.0;			// Maximum Z acceleration to use at the start of a probing move
 constexpr size_t MaxZProbeProgramBytes = 8;				// Maximum number of bytes in a Z probe program
 constexpr uint32_t ProbingSpeedReductionFactor = 3;		// The factor by which we reduce the Z probing speed when we get a 'near' indication
+constexpr size_t MaxProbeTaps = 8;						// Maximum number of readings we take per point when multi-tap probing is enabled
+constexpr float ProbeTapLift = 1.0;						// How far we lift the probe between taps, less than the dive height because we are already close to the bed
 
 constexpr float TRIANGLE_ZERO = -0.001;					// Millimetres
 constexpr float SILLY_Z_VALUE = -9999.0;				// Millimetres
@@ -210,6 +225,8 @@ constexpr size_t RESERVED_OUTPUT_BUFFERS = 2;			// Number of reserved output buf
 # error
 #endif
 
+constexpr size_t LOW_PRIORITY_SPARE_BUFFERS = 4;		// How many buffers we keep free for error messages and responses. Low-priority message traffic is dropped when fewer remain.
+
 // Move system
 constexpr float DefaultFeedrate = 3000.0;				// The initial requested feed rate after resetting the printer, in mm/min
 constexpr float DefaultRetractSpeed = 1000.0;			// The default firmware retraction and un-retraction speed, in mm
@@ -262,6 +279,7 @@ constexpr size_t FILE_BUFFER_SIZE = 256;
 #define CONFIG_FILE "config.g"
 #define DEFAULT_FILE "default.g"
 #define DEFAULT_LOG_FILE "eventlog.txt"
+#define MOVE_STATS_FILE "print-stats.csv"			// Movement statistics report written at the end of each print
 
 #define EOF_STRING "<!-- **EoF** -->"
 
@@ -0,0 +1,52 @@
+/*
+ * DebugRouting.cpp
+ *
+ * Per-module debug message levels and output sinks
+ */
+
+#include <cstdarg>
+
+#include "DebugRouting.h"
+#include "RepRap.h"
+#include "Platform.h"
+#include "EventTrace.h"
+
+uint8_t DebugRouting::levels[numModules] = { 0 };
+
+uint8_t DebugRouting::sinks[numModules] =
+{
+	sinkUsb, sinkUsb, sinkUsb, sinkUsb, sinkUsb, sinkUsb, sinkUsb, sinkUsb,
+	sinkUsb, sinkUsb, sinkUsb, sinkUsb, sinkUsb, sinkUsb, sinkUsb
+};
+
+// Format the message once, then hand it to each sink enabled for the module
+void DebugRouting::Output(Module m, DebugLevel level, const char *fmt, ...)
+{
+	char messageSpace[FORMAT_STRING_LENGTH];
+	StringRef message(messageSpace, ARRAY_SIZE(messageSpace));
+	va_list vargs;
+	va_start(vargs, fmt);
+	message.vprintf(fmt, vargs);
+	va_end(vargs);
+
+	const uint8_t s = sinks[m];
+	if ((s & sinkUsb) != 0)
+	{
+		reprap.GetPlatform().Message(DebugMessage, message.Pointer());
+	}
+	if ((s & sinkLog) != 0)
+	{
+		reprap.GetPlatform().Message(LogMessage, message.Pointer());
+	}
+	if ((s & sinkTrace) != 0)
+	{
+		// The trace buffer stores compact 8-byte events, not text, so record a hash of the format
+		// string that can be matched up with the call site in the source
+		uint16_t hash = 0;
+		for (const char *p = fmt; *p != 0; ++p)
+		{
+			hash = (uint16_t)((hash * 31u) + (uint8_t)*p);
+		}
+		EventTrace::Record(EventTrace::EventType::debugMessage, (uint8_t)m, hash);
+	}
+}
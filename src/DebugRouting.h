@@ -0,0 +1,132 @@
+/*
+ * DebugRouting.h
+ *
+ * Per-module debug message levels and output sinks
+ */
+
+#ifndef SRC_DEBUGROUTING_H_
+#define SRC_DEBUGROUTING_H_
+
+#include "RepRapFirmware.h"
+
+// How important a debug message is. Higher values are chattier.
+enum class DebugLevel : uint8_t
+{
+	off = 0,
+	error = 1,			// something went wrong that the module can recover from
+	warning = 2,		// an unusual condition worth knowing about when investigating a problem
+	info = 3,			// state changes and other once-per-operation messages
+	verbose = 4			// chatty per-iteration output
+};
+
+// Per-module compile-time verbosity caps. A DEBUG_OUTPUT call at a level above the cap for its module
+// compiles to nothing, format string and argument evaluation included, so instrumentation that is too
+// hot for a production build can be shut out on the compiler command line without touching the call
+// sites. The default cap admits everything; the runtime levels (all off by default, set by M111) then
+// decide what is actually emitted.
+#ifndef DEBUG_LEVEL_DEFAULT
+# define DEBUG_LEVEL_DEFAULT 4
+#endif
+#ifndef DEBUG_LEVEL_PLATFORM
+# define DEBUG_LEVEL_PLATFORM DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_NETWORK
+# define DEBUG_LEVEL_NETWORK DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_WEBSERVER
+# define DEBUG_LEVEL_WEBSERVER DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_GCODES
+# define DEBUG_LEVEL_GCODES DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_MOVE
+# define DEBUG_LEVEL_MOVE DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_HEAT
+# define DEBUG_LEVEL_HEAT DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_DDA
+# define DEBUG_LEVEL_DDA DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_ROLAND
+# define DEBUG_LEVEL_ROLAND DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_SCANNER
+# define DEBUG_LEVEL_SCANNER DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_PRINTMONITOR
+# define DEBUG_LEVEL_PRINTMONITOR DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_STORAGE
+# define DEBUG_LEVEL_STORAGE DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_PORTCONTROL
+# define DEBUG_LEVEL_PORTCONTROL DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_DUETEXPANSION
+# define DEBUG_LEVEL_DUETEXPANSION DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_FILAMENTSENSORS
+# define DEBUG_LEVEL_FILAMENTSENSORS DEBUG_LEVEL_DEFAULT
+#endif
+#ifndef DEBUG_LEVEL_WIFI
+# define DEBUG_LEVEL_WIFI DEBUG_LEVEL_DEFAULT
+#endif
+
+constexpr uint8_t CompiledDebugLevels[numModules] =
+{
+	DEBUG_LEVEL_PLATFORM,
+	DEBUG_LEVEL_NETWORK,
+	DEBUG_LEVEL_WEBSERVER,
+	DEBUG_LEVEL_GCODES,
+	DEBUG_LEVEL_MOVE,
+	DEBUG_LEVEL_HEAT,
+	DEBUG_LEVEL_DDA,
+	DEBUG_LEVEL_ROLAND,
+	DEBUG_LEVEL_SCANNER,
+	DEBUG_LEVEL_PRINTMONITOR,
+	DEBUG_LEVEL_STORAGE,
+	DEBUG_LEVEL_PORTCONTROL,
+	DEBUG_LEVEL_DUETEXPANSION,
+	DEBUG_LEVEL_FILAMENTSENSORS,
+	DEBUG_LEVEL_WIFI
+};
+
+constexpr bool DebugCompiled(Module m, DebugLevel level)
+{
+	return (uint8_t)level <= CompiledDebugLevels[m];
+}
+
+// Runtime routing of debug messages: each module has a level (set by M111 V) below which messages are
+// dropped, and a set of sinks (set by M111 D) that the survivors are sent to.
+class DebugRouting
+{
+public:
+	// Sink bits for SetSinks/M111 D
+	static const uint8_t sinkUsb = 0x01;								// the blocking USB debug channel
+	static const uint8_t sinkTrace = 0x02;								// the retained event trace buffer
+	static const uint8_t sinkLog = 0x04;								// the SD card log file
+
+	static bool Enabled(Module m, DebugLevel level) { return (uint8_t)level <= levels[m]; }
+	static void SetLevel(Module m, DebugLevel level) { levels[m] = (uint8_t)level; }
+	static DebugLevel GetLevel(Module m) { return (DebugLevel)levels[m]; }
+	static void SetSinks(Module m, uint8_t mask) { sinks[m] = mask; }
+	static uint8_t GetSinks(Module m) { return sinks[m]; }
+	static void Output(Module m, DebugLevel level, const char *fmt, ...) __attribute__ ((format (printf, 3, 4)));
+
+private:
+	static uint8_t levels[numModules];
+	static uint8_t sinks[numModules];
+};
+
+// Emit a debug message for a module at a level. When the compile-time cap for the module excludes the
+// level, the whole statement folds away.
+#define DEBUG_OUTPUT(_module, _level, ...) \
+	do { \
+		if (DebugCompiled(_module, _level) && DebugRouting::Enabled(_module, _level)) \
+		{ \
+			DebugRouting::Output(_module, _level, __VA_ARGS__); \
+		} \
+	} while (false)
+
+#endif /* SRC_DEBUGROUTING_H_ */
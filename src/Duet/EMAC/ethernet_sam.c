@@ -268,6 +268,24 @@ void ethernet_set_rx_callback(emac_dev_tx_cb_t callback)
 	ethernetif_set_rx_callback(callback);
 }
 
+/*
+ * \brief Masks the receive interrupt sources of the EMAC, leaving received
+ * frames in the DMA descriptor ring until the next call to ethernet_task().
+ */
+void ethernet_mask_rx_interrupt(void)
+{
+	ethernetif_mask_rx_interrupt();
+}
+
+/*
+ * \brief Re-enables the receive interrupt sources of the EMAC. Should be
+ * called after the descriptor ring has been drained by ethernet_task().
+ */
+void ethernet_unmask_rx_interrupt(void)
+{
+	ethernetif_unmask_rx_interrupt();
+}
+
 /*
  * \brief Returns the current IP address
  */
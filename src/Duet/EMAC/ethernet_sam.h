@@ -83,6 +83,10 @@ void ethernet_task(void);
 // Set the RX callback for incoming network packets
 void ethernet_set_rx_callback(emac_dev_tx_cb_t callback);
 
+// Mask/unmask the receive interrupt sources of the EMAC
+void ethernet_mask_rx_interrupt(void);
+void ethernet_unmask_rx_interrupt(void);
+
 // Returns the network interface's current IPv4 address
 const uint8_t *ethernet_get_ipaddress();
 
@@ -273,8 +273,6 @@ bool ethernetif_link_established(void)
 static err_t low_level_output(struct netif *netif, struct pbuf *p)
 {
 	struct pbuf *q = NULL;
-	int8_t pc_buf[NET_RW_BUFF_SIZE];
-	int8_t *bufptr = &pc_buf[0];
 	uint8_t uc_rc;
 
 #if ETH_PAD_SIZE
@@ -286,21 +284,27 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
 		return ERR_BUF;
 	}
 
-	/* Clear the output buffer */
-	memset(bufptr, 0x0, NET_RW_BUFF_SIZE);
+	if (p->next == NULL) {
+		/* The whole packet is in one pbuf, so the EMAC driver can copy it into the DMA buffers directly */
+		uc_rc = emac_dev_write(&gs_emac_dev, p->payload, p->tot_len, NULL);
+	} else {
+		/* The packet is spread over a pbuf chain, so gather it into one buffer first */
+		int8_t pc_buf[NET_RW_BUFF_SIZE];
+		int8_t *bufptr = &pc_buf[0];
 
-	for (q = p; q != NULL; q = q->next) {
-		/* Send the data from the pbuf to the interface, one pbuf at a
-		 * time. The size of the data in each pbuf is kept in the ->len
-		 * variable. */
+		for (q = p; q != NULL; q = q->next) {
+			/* Send the data from the pbuf to the interface, one pbuf at a
+			 * time. The size of the data in each pbuf is kept in the ->len
+			 * variable. */
 
-		/* Send data from(q->payload, q->len); */
-		memcpy(bufptr, q->payload, q->len);
-		bufptr += q->len;
-	}
+			/* Send data from(q->payload, q->len); */
+			memcpy(bufptr, q->payload, q->len);
+			bufptr += q->len;
+		}
 
-	/* Signal that packet should be sent(); */
-	uc_rc = emac_dev_write(&gs_emac_dev, pc_buf, p->tot_len, NULL);
+		/* Signal that packet should be sent(); */
+		uc_rc = emac_dev_write(&gs_emac_dev, pc_buf, p->tot_len, NULL);
+	}
 	if (uc_rc != EMAC_OK) {
 		return ERR_BUF;
 	}
@@ -326,57 +330,59 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
  */
 static struct pbuf *low_level_input(struct netif *netif)
 {
-	struct pbuf *p = NULL, *q = NULL;
-	uint16_t s_len;
-	uint8_t pc_buf[NET_RW_BUFF_SIZE];
-	int8_t *bufptr = (s8_t *)&pc_buf[0];
-
+	struct pbuf *p = NULL;
 	uint32_t ul_frmlen;
 	uint8_t uc_rc;
 
-	/* Obtain the size of the packet and put it into the "len"
-	 * variable. */
-	uc_rc = emac_dev_read(&gs_emac_dev, pc_buf, sizeof(pc_buf), &ul_frmlen);
-	if (uc_rc != EMAC_OK) {
+	/* Allocate a maximum-length pbuf before reading the frame, so that the EMAC driver can copy the
+	 * frame directly into its payload. With the pool buffer size derived from TCP_MSS a full frame
+	 * always fits in a single pbuf, which removes the staging copy through a stack buffer; the pbufs
+	 * are then handed up the stack and read in place, so this is the only copy the frame makes. */
+	p = pbuf_alloc(PBUF_RAW, PBUF_POOL_BUFSIZE, PBUF_POOL);
+	if (p == NULL) {
+		/* Drop packet(); */
+		LINK_STATS_INC(link.memerr);
+		LINK_STATS_INC(link.drop);
 		return NULL;
 	}
 
-	s_len = ul_frmlen;
-
 #if ETH_PAD_SIZE
-	s_len += ETH_PAD_SIZE;    /* allow room for Ethernet padding */
+	pbuf_header(p, -ETH_PAD_SIZE);    /* drop the padding word */
 #endif
 
-	/* We allocate a pbuf chain of pbufs from the pool. */
-	p = pbuf_alloc(PBUF_RAW, s_len, PBUF_POOL);
-
-	if (p != NULL) {
-#if ETH_PAD_SIZE
-		pbuf_header(p, -ETH_PAD_SIZE);  /* drop the padding word */
-#endif
+	if (p->next == NULL) {
+		/* The normal case: read the frame straight into the pbuf payload */
+		uc_rc = emac_dev_read(&gs_emac_dev, (uint8_t *)p->payload, p->len, &ul_frmlen);
+		if (uc_rc != EMAC_OK) {
+			pbuf_free(p);
+			return NULL;
+		}
+	} else {
+		/* The pool buffers are smaller than a frame, so fall back to reading via a staging buffer */
+		uint8_t pc_buf[NET_RW_BUFF_SIZE];
+		const uint8_t *bufptr = &pc_buf[0];
+		struct pbuf *q;
+
+		uc_rc = emac_dev_read(&gs_emac_dev, pc_buf, sizeof(pc_buf), &ul_frmlen);
+		if (uc_rc != EMAC_OK || ul_frmlen > p->tot_len) {
+			pbuf_free(p);
+			return NULL;
+		}
 
-		/* Iterate over the pbuf chain until we have read the entire
-		 * packet into the pbuf. */
 		for (q = p; q != NULL; q = q->next) {
-			/* Read enough bytes to fill this pbuf in the chain. The
-			 * available data in the pbuf is given by the q->len
-			 * variable. */
-			/* read data into(q->payload, q->len); */
 			memcpy(q->payload, bufptr, q->len);
 			bufptr += q->len;
 		}
-		/* Acknowledge that packet has been read(); */
+	}
 
 #if ETH_PAD_SIZE
-		pbuf_header(p, ETH_PAD_SIZE);    /* Reclaim the padding word */
+	pbuf_header(p, ETH_PAD_SIZE);    /* Reclaim the padding word */
+	pbuf_realloc(p, (u16_t)ul_frmlen + ETH_PAD_SIZE);    /* trim the pbuf to the frame we received */
+#else
+	pbuf_realloc(p, (u16_t)ul_frmlen);
 #endif
 
-		LINK_STATS_INC(link.recv);
-	} else {
-		/* Drop packet(); */
-		LINK_STATS_INC(link.memerr);
-		LINK_STATS_INC(link.drop);
-	}
+	LINK_STATS_INC(link.recv);
 
 	return p;
 }
@@ -469,6 +475,19 @@ void ethernetif_set_rx_callback(emac_dev_tx_cb_t callback)
 	emac_dev_set_rx_callback(&gs_emac_dev, callback);
 }
 
+/* The EMAC interrupts once per received frame. When the main loop cannot keep up with that rate it is
+ * cheaper to mask the receive interrupt sources and let frames accumulate in the DMA descriptor ring
+ * until the next poll, which reads them all in one go. */
+void ethernetif_mask_rx_interrupt(void)
+{
+	emac_disable_interrupt(EMAC, EMAC_IDR_RCOMP | EMAC_IDR_RXUBR | EMAC_IDR_ROVR);
+}
+
+void ethernetif_unmask_rx_interrupt(void)
+{
+	emac_enable_interrupt(EMAC, EMAC_IER_RCOMP | EMAC_IER_RXUBR | EMAC_IER_ROVR);
+}
+
 void ethernetif_set_mac_address(const u8_t macAddress[])
 {
 	// chrishamm 2016-03-23: It doesn't matter if we don't update the EMAC's MAC address here,
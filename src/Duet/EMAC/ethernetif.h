@@ -64,4 +64,7 @@ bool ethernetif_link_established(void);
 void ethernetif_set_rx_callback(emac_dev_tx_cb_t callback);
 void ethernetif_set_mac_address(const u8_t macAddress[]);
 
+void ethernetif_mask_rx_interrupt(void);
+void ethernetif_unmask_rx_interrupt(void);
+
 #endif /* ETHERNETIF_H_INCLUDED */
@@ -138,21 +138,16 @@ void UnlockLWIP()
 
 // Callback functions for the EMAC driver and for LwIP
 
-// Called from ISR
+// Called from ISR when the EMAC has received a frame.
+// We used to run the LWIP stack from here whenever the lock was free, but processing a frame takes long
+// enough to disturb step generation on the SAM3X, and during a burst of incoming traffic the EMAC interrupts
+// once per frame. So instead we mask the receive interrupt sources and leave the frames in the DMA descriptor
+// ring; the next Spin() call drains the whole ring in one go and then re-enables the interrupt, so however
+// many frames arrive in the meantime cost us only this one interrupt.
 static void ethernet_rx_callback(uint32_t ul_status)
 {
-	// Because the LWIP stack can become corrupted if we work with it in parallel,
-	// we may have to wait for the next Spin() call to read the next packet.
-	if (LockLWIP())
-	{
-		ethernet_task();
-		UnlockLWIP();
-	}
-	else
-	{
-		ethernet_set_rx_callback(nullptr);
-		reprap.GetNetwork().ResetCallback();
-	}
+	ethernet_mask_rx_interrupt();
+	reprap.GetNetwork().ResetCallback();
 }
 
 // Callback functions for LWIP (may be called from ISR)
@@ -420,12 +415,15 @@ void Network::Spin(bool full)
 					return;
 				}
 
-				// See if we can read any packets. They may include DHCP responses too
+				// See if we can read any packets. They may include DHCP responses too.
+				// This drains the whole EMAC descriptor ring, so all the frames that arrived since
+				// the receive interrupt was masked are dealt with here in one batch.
 				ethernet_task();
 				if (resetCallback)
 				{
 					resetCallback = false;
 					ethernet_set_rx_callback(&ethernet_rx_callback);
+					ethernet_unmask_rx_interrupt();
 				}
 
 				// Have we obtained a valid IP address yet?
@@ -78,6 +78,7 @@ public:
 
 	void Enable(int mode, StringRef& reply);			// enable or disable the network
 	bool GetNetworkState(StringRef& reply);
+	void Prepare() { }									// nothing useful to do before config.g, because LwIP needs the MAC address and hostname from it
 	void Activate();
 
 	// Interfaces for the Webserver
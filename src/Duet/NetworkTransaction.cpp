@@ -163,6 +163,35 @@ bool NetworkTransaction::ReadBuffer(const char *&buffer, size_t &len)
 	return true;
 }
 
+// Return a pointer to the unread data in the current pbuf and its length, or nullptr if there is none.
+// Unlike ReadBuffer, this does not consume the data; the caller reports how much it used via Taken.
+const char *NetworkTransaction::UnreadData(size_t &len)
+{
+	if (readingPb != nullptr && inputPointer >= readingPb->len)
+	{
+		readingPb = readingPb->next;
+		inputPointer = 0;
+	}
+	if (readingPb == nullptr)
+	{
+		return nullptr;
+	}
+
+	len = readingPb->len - inputPointer;
+	return (const char*)readingPb->payload + inputPointer;
+}
+
+// Mark bytes returned by UnreadData as consumed
+void NetworkTransaction::Taken(size_t len)
+{
+	inputPointer += len;
+	if (readingPb != nullptr && inputPointer >= readingPb->len)
+	{
+		readingPb = readingPb->next;
+		inputPointer = 0;
+	}
+}
+
 void NetworkTransaction::Write(char b)
 {
 	if (CanWrite())
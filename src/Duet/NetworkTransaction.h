@@ -48,6 +48,8 @@ public:
 	bool HasMoreDataToRead() const { return readingPb != nullptr; }
 	bool Read(char& b);
 	bool ReadBuffer(const char *&buffer, size_t &len);
+	const char *UnreadData(size_t &len);	// return a pointer to the unread data in the current pbuf without consuming it
+	void Taken(size_t len);					// mark bytes returned by UnreadData as consumed
 	void Write(char b);
 	void Write(const char* s);
 	void Write(StringRef ref);
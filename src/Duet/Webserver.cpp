@@ -65,11 +65,13 @@
  rr_download?name=xxx
 			 Download a specified file from the SD card
 
- rr_upload?name=xxx&time=yyy
+ rr_upload?name=xxx&time=yyy&crc32=zzz
  	 	 	 Upload a specified file using a POST request. The payload of this request has to be
  	 	 	 the file content. Only one file may be uploaded at once. When the upload has finished,
  	 	 	 a JSON response with the variable "err" will be returned, which will be 0 if the job
- 	 	 	 has finished without problems, it will be set to 1 otherwise.
+ 	 	 	 has finished without problems, it will be set to 1 otherwise. If the optional crc32
+ 	 	 	 qualifier is present (CRC-32 of the file content in hex), the upload is verified
+ 	 	 	 against it and deleted on mismatch.
 
  rr_delete?name=xxx
 			 Delete file xxx. Returns err (zero if successful).
@@ -204,28 +206,56 @@ void Webserver::Spin()
 			else if (interpreter->CanParseData())
 			{
 				readingConnection = currentTransaction->GetConnection();
-				for(size_t i = 0; i < TCP_MSS / 3; i++)
+
+				// Work on the pbuf payloads in place instead of calling Read() for every character, so that
+				// the per-byte cost is just the parser itself. The quota limits how long we spend here per Spin.
+				size_t bytesLeft = TCP_MSS / 3;
+				for (;;)
 				{
-					char c;
-					if (currentTransaction->Read(c))
+					size_t blockLength;
+					const char * const block = currentTransaction->UnreadData(blockLength);
+					if (block == nullptr)
 					{
-						// Each ProtocolInterpreter must take care of the current NetworkTransaction by
-						// calling either Commit(), Discard() or Defer()
+						// We ran out of data before finding a complete request. This happens when the incoming
+						// message length exceeds the TCP MSS. Notify the current ProtocolInterpreter about this,
+						// which will remove the current transaction too
+						interpreter->NoMoreDataAvailable();
+						readingConnection = NoConnection;
+						break;
+					}
+
+					if (blockLength > bytesLeft)
+					{
+						blockLength = bytesLeft;
+					}
+
+					// Each ProtocolInterpreter must take care of the current NetworkTransaction by
+					// calling either Commit(), Discard() or Defer()
+					size_t taken = 0;
+					bool finished = false;
+					while (taken < blockLength)
+					{
+						const char c = block[taken++];
 						if (interpreter->CharFromClient(c))
 						{
-							readingConnection = NoConnection;
+							finished = true;
 							break;
 						}
 					}
-					else
+					if (finished)
 					{
-						// We ran out of data before finding a complete request. This happens when the incoming
-						// message length exceeds the TCP MSS. Notify the current ProtocolInterpreter about this,
-						// which will remove the current transaction too
-						interpreter->NoMoreDataAvailable();
+						// The interpreter has finished with this transaction and may have discarded it already,
+						// so don't touch it again
 						readingConnection = NoConnection;
 						break;
 					}
+					currentTransaction->Taken(taken);
+
+					bytesLeft -= taken;
+					if (bytesLeft == 0)
+					{
+						break;			// quota used up, continue from here next Spin
+					}
 				}
 			}
 		}
@@ -477,7 +507,8 @@ bool ProtocolInterpreter::FinishUpload(uint32_t fileLength)
 
 
 Webserver::HttpInterpreter::HttpInterpreter(Platform *p, Webserver *ws, Network *n)
-	: ProtocolInterpreter(p, ws, n), state(doingCommandWord), numSessions(0), clientsServed(0)
+	: ProtocolInterpreter(p, ws, n), state(doingCommandWord), numSessions(0), clientsServed(0),
+	  checkUploadCRC(false), lastUploadOK(false)
 {
 	gcodeReply = new OutputStack();
 	deferredRequestConnection = NoConnection;
@@ -564,9 +595,16 @@ void Webserver::HttpInterpreter::DoFastUpload()
 			CancelUpload();
 
 			while (!network->Lock()) { }
+			lastUploadOK = false;
 			SendJsonResponse("upload");
 			return;
 		}
+		if (checkUploadCRC)
+		{
+			// Write() above only copied the data into a write buffer, queueing any full one for MassStorage::Spin
+			// to flush, so this CRC update runs while the previous chunk is being written to the SD card
+			uploadCRC.Update(buffer, len);
+		}
 		uploadedBytes += len;
 		while (!network->Lock()) { }
 	}
@@ -586,10 +624,17 @@ void Webserver::HttpInterpreter::DoFastUpload()
 			}
 		}
 
+		// If the client sent a CRC then check it now; each chunk was added to it as it arrived
+		if (uploadState == uploadOK && checkUploadCRC && uploadCRC.Get() != expectedUploadCRC)
+		{
+			uploadState = uploadError;
+			platform->MessageF(GenericMessage, "Error: Uploaded file CRC is 0x%08" PRIx32 ", expected 0x%08" PRIx32 "\n", uploadCRC.Get(), expectedUploadCRC);
+		}
+
 		// Grab a copy of the filename and finish this upload
 		char filename[FILENAME_LENGTH];
 		SafeStrncpy(filename, filenameBeingUploaded, FILENAME_LENGTH);
-		FinishUpload(postFileLength);
+		lastUploadOK = FinishUpload(postFileLength);
 
 		// Update the file timestamp if it was specified before
 		if (fileLastModified != 0)
@@ -945,7 +990,7 @@ void Webserver::HttpInterpreter::GetJsonResponse(const char* request, OutputBuff
 	}
 	else if (StringEquals(request, "upload"))
 	{
-		response->printf("{\"err\":%d}", (uploadedBytes == postFileLength) ? 0 : 1);
+		response->printf("{\"err\":%d}", (lastUploadOK && uploadedBytes == postFileLength) ? 0 : 1);
 	}
 	else if (StringEquals(request, "delete") && GetKeyValue("name") != nullptr)
 	{
@@ -1562,6 +1607,15 @@ bool Webserver::HttpInterpreter::ProcessMessage()
 					fileLastModified = 0;
 				}
 
+				// If the client sent the CRC of the file, verify the upload against it
+				const char* const expectedCrcString = GetKeyValue("crc32");
+				checkUploadCRC = (expectedCrcString != nullptr);
+				if (checkUploadCRC)
+				{
+					expectedUploadCRC = strtoul(expectedCrcString, nullptr, 16);
+				}
+				uploadCRC.Reset();
+
 				if (reprap.Debug(moduleWebserver))
 				{
 					platform->MessageF(UsbMessage, "Start uploading file %s length %lu\n", filename, postFileLength);
@@ -34,6 +34,7 @@ Licence: GPL
 #include "RepRapFirmware.h"
 #include "MessageType.h"
 #include "Storage/FileData.h"
+#include "Storage/CRC32.h"
 
 /* Generic values */
 
@@ -233,6 +234,10 @@ protected:
 		// File uploads
 		uint32_t postFileLength, uploadedBytes;			// How many POST bytes do we expect and how many have already been written?
 		time_t fileLastModified;
+		CRC32 uploadCRC;								// running CRC of the POST data received so far
+		uint32_t expectedUploadCRC;						// the CRC the client says the complete file should have
+		bool checkUploadCRC;							// true if the upload request included a crc32 qualifier
+		bool lastUploadOK;								// whether the last completed upload was successful
 
 		// Deferred requests (rr_fileinfo)
 		volatile Connection deferredRequestConnection;	// Which connection expects a response for a deferred request?
@@ -139,13 +139,21 @@ namespace DuetExpansion
 	// even though it is not safe for it to call expander.digitalReadAll(). When we move to RTOS, this will be a high priority task.
 	void Spin(bool full)
 	{
-		if (dueXnBoardType != ExpansionBoardType::none && !digitalRead(DueX_INT))
+		if (dueXnBoardType != ExpansionBoardType::none)
 		{
-			// Interrupt is active, so input data may have changed
-			dueXnInputBits = dueXnExpander.digitalReadAll();
+			if (!digitalRead(DueX_INT))
+			{
+				// Interrupt is active, so input data may have changed
+				dueXnInputBits = dueXnExpander.digitalReadAll();
+			}
+			dueXnExpander.flush();					// write any pending output pin changes in one transaction
 		}
 
 		// We don't have an interrupt from the additional I/O expander, so we don't poll it here
+		if (additionalIoExpanderPresent)
+		{
+			additionalIoExpander.flush();
+		}
 	}
 
 	// Set the I/O mode of a pin
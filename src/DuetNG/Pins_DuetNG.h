@@ -43,6 +43,7 @@ constexpr size_t NumFirmwareUpdateModules = 1;		// 1 module
 #define SUPPORT_SCANNER		1						// set zero to disable support for FreeLSS scanners
 #define SUPPORT_IOBITS		1						// set to support P parameter in G0/G1 commands
 #define SUPPORT_DHT_SENSOR	1						// set nonzero to support DHT temperature/humidity sensors
+#define SUPPORT_EMBEDDED_WEB_ASSETS	1				// set nonzero to look for a DWC asset bundle in the spare flash above the firmware
 
 #define USE_CACHE			1						// set nonzero to enable the cache
 
@@ -184,6 +185,13 @@ constexpr int HighestLogicalPin = 135;										// highest logical pin number on
 constexpr uint32_t IAP_FLASH_START = 0x00470000;
 constexpr uint32_t IAP_FLASH_END = 0x0047FFFF;		// we allow a full 64K on the SAM4
 
+#if SUPPORT_EMBEDDED_WEB_ASSETS
+// The DWC asset bundle occupies the flash between the end of the firmware and the IAP.
+// The 'webassets' makefile target pads the firmware image up to this address and appends the bundle.
+constexpr uint32_t EmbeddedWebAssetsStart = 0x00450000;
+constexpr uint32_t EmbeddedWebAssetsEnd = IAP_FLASH_START;
+#endif
+
 #if defined(DUET_WIFI)
 
 // Duet pin numbers to control the WiFi interface
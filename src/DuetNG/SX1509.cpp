@@ -26,7 +26,7 @@ Distributed as-is; no warranty is given.
 #include "SX1509.h"
 #include "SX1509Registers.h"
 
-SX1509::SX1509() : _clkX(0)
+SX1509::SX1509() : _clkX(0), shadowData(0xFFFF), dataDirty(false)
 {
 }
 
@@ -49,6 +49,8 @@ bool SX1509::begin(uint8_t address)
 	{
 		clock(DefaultOscDivider);
 		writeWord(REG_HIGH_INPUT_B, 0xFFFF);						// set all inputs to be 5V-tolerant
+		shadowData = readWord(REG_DATA_B);							// initialise the shadow copy of the data register
+		dataDirty = false;
 	}
 
 	return ok;
@@ -79,6 +81,28 @@ void SX1509::clearBitsInWord(uint8_t registerAddress, uint16_t bits)
 	}
 }
 
+// Update the shadow copy of the data register. The device is not written until flush() is called,
+// so that several pin changes (e.g. during a tool change) cost one I2C transaction between them.
+void SX1509::updateDataBits(uint16_t bitsToSet, uint16_t bitsToClear)
+{
+	const uint16_t newData = (shadowData & ~bitsToClear) | bitsToSet;
+	if (newData != shadowData)
+	{
+		shadowData = newData;
+		dataDirty = true;
+	}
+}
+
+// Write any pending output pin changes to the device
+void SX1509::flush()
+{
+	if (dataDirty)
+	{
+		writeWord(REG_DATA_B, shadowData);
+		dataDirty = false;
+	}
+}
+
 void SX1509::analogWriteMultiple(uint16_t pins, uint8_t pwm)
 {
 	for (uint8_t pin = 0; pins != 0; ++pin)
@@ -127,7 +151,8 @@ void SX1509::pinModeMultiple(uint16_t pins, PinMode inOut)
 	case OUTPUT_LOW:
 		clearBitsInWord(REG_PULL_UP_B, pins);
 		clearBitsInWord(REG_PULL_DOWN_B, pins);
-		clearBitsInWord(REG_DATA_B, pins & ~pwmPins);
+		updateDataBits(0, pins & ~pwmPins);
+		flush();									// get the data register right before we change the pin direction
 		clearBitsInWord(REG_OPEN_DRAIN_B, pins);
 		clearBitsInWord(REG_DIR_B, pins);
 		analogWriteMultiple(pins & pwmPins, 0);
@@ -136,7 +161,8 @@ void SX1509::pinModeMultiple(uint16_t pins, PinMode inOut)
 	case OUTPUT_HIGH:
 		clearBitsInWord(REG_PULL_UP_B, pins);
 		clearBitsInWord(REG_PULL_DOWN_B, pins);
-		setBitsInWord(REG_DATA_B, pins & ~pwmPins);
+		updateDataBits(pins & ~pwmPins, 0);
+		flush();									// get the data register right before we change the pin direction
 		clearBitsInWord(REG_OPEN_DRAIN_B, pins);
 		clearBitsInWord(REG_DIR_B, pins);
 		analogWriteMultiple(pins & pwmPins, 255);
@@ -145,7 +171,8 @@ void SX1509::pinModeMultiple(uint16_t pins, PinMode inOut)
 	case OUTPUT_LOW_OPEN_DRAIN:
 		clearBitsInWord(REG_PULL_UP_B, pins);
 		clearBitsInWord(REG_PULL_DOWN_B, pins);
-		clearBitsInWord(REG_DATA_B, pins & ~pwmPins);
+		updateDataBits(0, pins & ~pwmPins);
+		flush();									// get the data register right before we change the pin direction
 		setBitsInWord(REG_OPEN_DRAIN_B, pins);
 		clearBitsInWord(REG_DIR_B, pins);
 		analogWriteMultiple(pins & pwmPins, 0);
@@ -154,7 +181,8 @@ void SX1509::pinModeMultiple(uint16_t pins, PinMode inOut)
 	case OUTPUT_HIGH_OPEN_DRAIN:
 		clearBitsInWord(REG_PULL_UP_B, pins);
 		clearBitsInWord(REG_PULL_DOWN_B, pins);
-		setBitsInWord(REG_DATA_B, pins & ~pwmPins);
+		updateDataBits(pins & ~pwmPins, 0);
+		flush();									// get the data register right before we change the pin direction
 		setBitsInWord(REG_OPEN_DRAIN_B, pins);
 		clearBitsInWord(REG_DIR_B, pins);
 		analogWriteMultiple(pins & pwmPins, 255);
@@ -182,11 +210,11 @@ void SX1509::digitalWrite(uint8_t pin, bool highLow)
 	}
 	else if (highLow)
 	{
-		setBitsInWord(REG_DATA_B, 1u << pin);
+		updateDataBits(1u << pin, 0);
 	}
 	else
 	{
-		clearBitsInWord(REG_DATA_B, 1u << pin);
+		updateDataBits(0, 1u << pin);
 	}
 }
 
@@ -247,7 +275,8 @@ void SX1509::ledDriverInitMultiple(uint16_t pins, bool log, bool openDrain)
 	setBitsInWord(REG_LED_DRIVER_ENABLE_B, pins);
 	
 	// Set REG_DATA bit low ~ LED driver started
-	clearBitsInWord(REG_DATA_B, pins);
+	updateDataBits(0, pins);
+	flush();
 
 	pwmPins |= pins;							// record which pins are in LED driver mode
 }
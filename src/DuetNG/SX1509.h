@@ -37,6 +37,8 @@ private:
 	// Misc variables:
 	uint32_t _clkX;
 	uint16_t pwmPins;						// bitmap of pins configured as PWM output pins
+	uint16_t shadowData;					// shadow copy of the data register
+	bool dataDirty;							// true if shadowData has changes not yet written to the device
 
 	// Read Functions:
 	uint8_t readByte(uint8_t registerAddress);
@@ -51,6 +53,7 @@ private:
 	void writeBytes(uint8_t firstRegisterAddress, uint8_t * writeArray, uint8_t length);
 	void setBitsInWord(uint8_t registerAddress, uint16_t bits);
 	void clearBitsInWord(uint8_t registerAddress, uint16_t bits);
+	void updateDataBits(uint16_t bitsToSet, uint16_t bitsToClear);
 	void analogWriteMultiple(uint16_t pins, uint8_t pwm);
 
 	// Helper functions:
@@ -119,9 +122,19 @@ public:
 	//	Inputs:
 	//		- pin: The SX1509 pin number. Should be a value between 0 and 15.
 	//		- highLow: true for HIGH, false for LOW.
+	//
+	//	Note: the change is made to a shadow copy of the data register and is not
+	//		sent to the device until flush() is called, so several pin changes cost
+	//		a single I2C transaction.
 	// -----------------------------------------------------------------------------
 	void digitalWrite(uint8_t pin, bool highLow);
 
+	// -----------------------------------------------------------------------------
+	// flush(): Write any pending output pin changes to the device in a single
+	//		I2C transaction. Call this periodically after making digitalWrite() calls.
+	// -----------------------------------------------------------------------------
+	void flush();
+
 	// -----------------------------------------------------------------------------
 	// digitalRead(uint8_t pin): This function reads the HIGH/LOW status of a pin.
 	//		The pin should be configured as an INPUT, using the pinDir function.
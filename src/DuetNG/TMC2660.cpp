@@ -43,6 +43,12 @@ const uint32_t DriversSpiClockFrequency = 2000000;			// 2MHz SPI clock
 
 const int DefaultStallGuardThreshold = 1;					// Range is -64..63. Zero seems to be too sensitive. Higher values reduce sensitivity of stall detection.
 
+// Parameters of the filtered StallGuard load values used for step-loss monitoring. These are fixed-point exponential
+// moving averages updated in the ISR, so the filter coefficients are powers of two.
+const unsigned int SgLoadFilterFractionBits = 6;			// number of fraction bits in the filtered StallGuard load values
+const unsigned int SgLoadFastFilterShift = 3;				// the short-term filter settles within a few tens of samples
+const unsigned int SgLoadSlowFilterShift = 9;				// the long-term filter learns the typical load over the early part of a print
+
 // TMC2660 register addresses
 const uint32_t TMC_REG_DRVCTRL = 0;
 const uint32_t TMC_REG_CHOPCONF = 0x80000;
@@ -180,6 +186,7 @@ public:
 	unsigned int GetMicrostepping(int mode, bool& interpolation) const;		// Get microstepping or chopper control register
 	uint32_t ReadLiveStatus() const;
 	uint32_t ReadAccumulatedStatus(uint32_t bitsToKeep);
+	bool GetSgLoadFilters(uint32_t& fastVal, uint32_t& slowVal) const;		// get the filtered StallGuard load values
 
 private:
 	void ResetLoadRegisters()
@@ -201,6 +208,7 @@ private:
 	static constexpr unsigned int SmartEnable = 4;			// coolstep configuration
 
 	uint32_t pin;											// the pin number that drives the chip select pin of this driver
+	uint32_t driverBit;										// bit of this driver in the status-change bitmap
 	uint32_t configuredChopConfReg;							// the configured chopper control register, in the Enabled state
 	uint32_t registersToUpdate;								// bitmap of register values that need to be sent to the driver chip
 	uint32_t axisNumber;									// the axis number of this driver as used to index the DriveMovements in the DDA
@@ -213,6 +221,9 @@ private:
 
 	volatile uint32_t lastReadStatus;						// the status word that we read most recently, updated by the ISR
 	volatile uint32_t accumulatedStatus;
+	volatile uint32_t sgLoadFastFiltered;					// short-term filtered StallGuard load, with SgLoadFilterFractionBits fraction bits
+	volatile uint32_t sgLoadSlowFiltered;					// long-term filtered StallGuard load i.e. the learned load profile, same format
+	volatile bool sgLoadFiltersValid;						// true if the filters have been seeded since the motor last ran below the stall detection speed
 };
 
 // State structures for all drivers
@@ -227,6 +238,7 @@ volatile static uint32_t spiDataIn = 0;						// volatile because the PDC writes
 
 // Variables used by the ISR
 static TmcDriverState * volatile currentDriver = nullptr;	// volatile because the ISR changes it
+static volatile uint32_t driversWhoseStatusChanged = 0;		// bitmap of drivers whose reported status bits changed, set by the ISR
 
 // Set up the PDC to send a register and receive the status
 /*static*/ inline void TmcDriverState::SetupDMA(uint32_t outVal)
@@ -252,6 +264,7 @@ pre(!driversPowered)
 {
 	axisNumber = p_axisNumber;
 	pin = p_pin;
+	driverBit = 1u << (this - driverStates);
 	pinMode(pin, OUTPUT_HIGH);
 	registers[DriveControl] = defaultDrvCtrlReg;
 	configuredChopConfReg = defaultChopConfReg;
@@ -261,6 +274,7 @@ pre(!driversPowered)
 	registers[DriveConfig] = defaultDrvConfReg;
 	registersToUpdate = UpdateAllRegisters;
 	accumulatedStatus = lastReadStatus = 0;
+	sgLoadFiltersValid = false;
 	ResetLoadRegisters();
 	SetMicrostepping(DefaultMicrosteppingShift, DefaultInterpolation);
 	SetStallDetectThreshold(DefaultStallDetectThreshold);
@@ -338,6 +352,19 @@ uint32_t TmcDriverState::ReadAccumulatedStatus(uint32_t bitsToKeep)
 	return status & (TMC_RR_SG | TMC_RR_OT | TMC_RR_OTPW | TMC_RR_S2G | TMC_RR_OLA | TMC_RR_OLB | TMC_RR_STST);
 }
 
+// Get the filtered StallGuard load values, returning false if the motor has not been moving fast enough for them to be valid.
+// The ISR may update the filters between the two reads, but they are heavily smoothed so being one sample apart doesn't matter.
+bool TmcDriverState::GetSgLoadFilters(uint32_t& fastVal, uint32_t& slowVal) const
+{
+	if (!sgLoadFiltersValid)
+	{
+		return false;
+	}
+	fastVal = sgLoadFastFiltered >> SgLoadFilterFractionBits;
+	slowVal = sgLoadSlowFiltered >> SgLoadFilterFractionBits;
+	return true;
+}
+
 void TmcDriverState::SetStallDetectThreshold(int sgThreshold)
 {
 	const uint32_t sgVal = ((uint32_t)constrain<int>(sgThreshold, -64, 63)) & 127;
@@ -416,6 +443,11 @@ void TmcDriverState::AppendDriverStatus(const StringRef& reply)
 	if (minSgLoadRegister <= maxSgLoadRegister)
 	{
 		reply.catf(", SG min/max %" PRIu32 "/%" PRIu32, minSgLoadRegister, maxSgLoadRegister);
+		uint32_t fastLoad, slowLoad;
+		if (GetSgLoadFilters(fastLoad, slowLoad))
+		{
+			reply.catf(", SG load now/learned %" PRIu32 "/%" PRIu32, fastLoad, slowLoad);
+		}
 	}
 	else
 	{
@@ -447,6 +479,7 @@ inline void TmcDriverState::TransferDone()
 	if (interval == 0 || interval > maxStallStepInterval)	// if the motor speed is too low to get reliable stall indication
 	{
 		status &= ~TMC_RR_SG;								// remove the stall status bit
+		sgLoadFiltersValid = false;							// the load readings are meaningless too, so re-seed the filters when fast movement resumes
 	}
 	else
 	{
@@ -459,6 +492,25 @@ inline void TmcDriverState::TransferDone()
 		{
 			maxSgLoadRegister = sgLoad;
 		}
+
+		// Update the filtered load values that the Platform uses for step-loss monitoring
+		const uint32_t scaledLoad = sgLoad << SgLoadFilterFractionBits;
+		if (sgLoadFiltersValid)
+		{
+			sgLoadFastFiltered += (scaledLoad >> SgLoadFastFilterShift) - (sgLoadFastFiltered >> SgLoadFastFilterShift);
+			sgLoadSlowFiltered += (scaledLoad >> SgLoadSlowFilterShift) - (sgLoadSlowFiltered >> SgLoadSlowFilterShift);
+		}
+		else
+		{
+			sgLoadFastFiltered = sgLoadSlowFiltered = scaledLoad;
+			sgLoadFiltersValid = true;
+		}
+	}
+	// Flag this driver to the Platform if any of the reported status bits changed, so that fault handling and
+	// stall response don't have to wait for their turn in a polling rotation
+	if ((((status ^ lastReadStatus) & (TMC_RR_SG | TMC_RR_OT | TMC_RR_OTPW | TMC_RR_S2G | TMC_RR_OLA | TMC_RR_OLB | TMC_RR_STST)) != 0))
+	{
+		driversWhoseStatusChanged |= driverBit;
 	}
 	lastReadStatus = status;
 	accumulatedStatus |= status;
@@ -608,6 +660,21 @@ namespace SmartDrivers
 		return (drive < numTmc2660Drivers) ? driverStates[drive].ReadAccumulatedStatus(bitsToKeep) : 0;
 	}
 
+	bool GetSgLoadFilters(size_t drive, uint32_t& fastVal, uint32_t& slowVal)
+	{
+		return drive < numTmc2660Drivers && driverStates[drive].GetSgLoadFilters(fastVal, slowVal);
+	}
+
+	// Return and clear the bitmap of drivers whose reported status bits have changed since the last call
+	uint32_t GetDriversWithStatusChanges()
+	{
+		const irqflags_t flags = cpu_irq_save();
+		const uint32_t changes = driversWhoseStatusChanged;
+		driversWhoseStatusChanged = 0;
+		cpu_irq_restore(flags);
+		return changes;
+	}
+
 	// Set microstepping or chopper control register
 	bool SetMicrostepping(size_t drive, unsigned int microsteps, int mode)
 	{
@@ -38,6 +38,8 @@ namespace SmartDrivers
 	void EnableDrive(size_t drive, bool en);
 	uint32_t GetLiveStatus(size_t drive);
 	uint32_t GetAccumulatedStatus(size_t drive, uint32_t bitsToKeep);
+	uint32_t GetDriversWithStatusChanges();
+	bool GetSgLoadFilters(size_t drive, uint32_t& fastVal, uint32_t& slowVal);
 	bool SetMicrostepping(size_t drive, unsigned int microsteps, int mode);
 	unsigned int GetMicrostepping(size_t drive, int mode, bool& interpolation);
 	void Spin(bool powered);
@@ -72,6 +72,22 @@ $(OUTPUT_PATH):
 	@mkdir -p $(OUTPUT_PATH)
 
 
+# ================================= Target webassets ================================
+# Packs the DWC files from SD-image/www into a flash asset bundle and appends it to the firmware
+# image at the offset where EmbeddedWebAssets expects to find it (see Pins_DuetNG.h), producing a
+# single image that serves the web interface with no SD card I/O
+WEB_ASSETS_DIR := $(PWD)/../SD-image/www
+WEB_ASSETS_OFFSET := 0x50000
+WEB_ASSETS_MAX_SIZE := 0x20000
+
+.PHONY += webassets
+webassets: $(OUTPUT_PATH)/DuetWiFiFirmware-$(VERSION)+webassets.bin
+
+$(OUTPUT_PATH)/DuetWiFiFirmware-$(VERSION)+webassets.bin: $(OUTPUT_PATH)/DuetWiFiFirmware-$(VERSION).bin
+	@echo "  WEB     ../Release/Duet-WiFi/DuetWiFiFirmware-$(VERSION)+webassets.bin"
+	@python $(PWD)/../Tools/make_web_bundle.py $(WEB_ASSETS_DIR) $(OUTPUT_PATH)/webassets.bin --firmware $(OUTPUT_PATH)/DuetWiFiFirmware-$(VERSION).bin --offset $(WEB_ASSETS_OFFSET) --max-size $(WEB_ASSETS_MAX_SIZE) --output $(OUTPUT_PATH)/DuetWiFiFirmware-$(VERSION)+webassets.bin
+
+
 # ================================= Target clean ====================================
 .PHONY += clean
 clean:
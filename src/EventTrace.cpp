@@ -0,0 +1,141 @@
+/*
+ * EventTrace.cpp
+ *
+ * In-memory flight recorder for postmortem diagnostics
+ */
+
+#include <cstring>
+
+#include "EventTrace.h"
+#include "RepRap.h"
+#include "Platform.h"
+
+EventTrace::TraceEvent EventTrace::events[EventTrace::NumEvents];
+volatile uint32_t EventTrace::nextIndex = 0;
+
+// Record an event. This may be called from interrupt service routines, so keep it short.
+void EventTrace::Record(EventType et, uint8_t a, uint16_t b)
+{
+	const irqflags_t flags = cpu_irq_save();
+	TraceEvent& e = events[nextIndex % NumEvents];
+	e.when = millis();
+	e.type = (uint8_t)et;
+	e.a = a;
+	e.b = b;
+	++nextIndex;
+	cpu_irq_restore(flags);
+}
+
+// Append a description of one event to scratchString
+void EventTrace::AppendEvent(const TraceEvent& e)
+{
+	switch ((EventType)e.type)
+	{
+	case EventType::gcode:
+		scratchString.catf(" %" PRIu32 ":%c%d", e.when, (char)e.a, (int)(int16_t)e.b);
+		break;
+
+	case EventType::ddaStart:
+		scratchString.catf(" %" PRIu32 ":dda(%ums)", e.when, (unsigned int)e.b);
+		break;
+
+	case EventType::networkState:
+		scratchString.catf(" %" PRIu32 ":net(%u)", e.when, (unsigned int)e.a);
+		break;
+
+	case EventType::spinOutlier:
+		scratchString.catf(" %" PRIu32 ":spin(%s,%ums)", e.when, (e.a < numModules) ? moduleName[e.a] : "?", (unsigned int)e.b);
+		break;
+
+	case EventType::powerFail:
+		scratchString.catf(" %" PRIu32 ":powerfail(%.1fV)", e.when, (double)((float)e.b * 0.1));
+		break;
+
+	case EventType::debugMessage:
+		scratchString.catf(" %" PRIu32 ":dbg(%s,#%04x)", e.when, (e.a < numModules) ? moduleName[e.a] : "?", (unsigned int)e.b);
+		break;
+
+	default:
+		break;
+	}
+}
+
+// Print and clear scratchString if there may not be room for another event description
+void EventTrace::FlushScratchString(MessageType mtype)
+{
+	if (scratchString.strlen() > scratchString.Length() - 40)
+	{
+		reprap.GetPlatform().MessageF(mtype, "%s\n", scratchString.Pointer());
+		scratchString.Clear();
+	}
+}
+
+// Print the contents of the trace buffer, oldest event first. The timestamps are values of millis().
+void EventTrace::Diagnostics(MessageType mtype)
+{
+	const irqflags_t flags = cpu_irq_save();
+	const uint32_t next = nextIndex;
+	cpu_irq_restore(flags);
+
+	reprap.GetPlatform().Message(mtype, "Event trace (millis:event, most recent last):\n");
+	const uint32_t numRecorded = min<uint32_t>(next, NumEvents);
+	scratchString.Clear();
+	for (uint32_t i = 0; i < numRecorded; ++i)
+	{
+		const TraceEvent e = events[(next - numRecorded + i) % NumEvents];	// take a copy, because an ISR may overwrite the entry
+		AppendEvent(e);
+		FlushScratchString(mtype);
+	}
+	if (!scratchString.IsEmpty())
+	{
+		reprap.GetPlatform().MessageF(mtype, "%s\n", scratchString.Pointer());
+		scratchString.Clear();
+	}
+}
+
+// Copy the most recent events into 'dst' as 32-bit words, oldest first, leaving any words we don't fill untouched
+// so that unused flash words remain erased. Returns the number of words written. This is called by
+// Platform::SoftwareReset with interrupts already disabled.
+size_t EventTrace::CopyRecent(uint32_t *dst, size_t numWords)
+{
+	const uint32_t next = nextIndex;
+	const size_t numToCopy = min<size_t>(min<uint32_t>(next, NumEvents), numWords/2);
+	size_t wordsWritten = 0;
+	for (size_t i = 0; i < numToCopy; ++i)
+	{
+		const TraceEvent& e = events[(next - numToCopy + i) % NumEvents];
+		memcpy(dst + wordsWritten, &e, sizeof(e));
+		wordsWritten += 2;
+	}
+	return wordsWritten;
+}
+
+// Print events previously saved by CopyRecent along with the software reset data
+void EventTrace::PrintSaved(MessageType mtype, const uint32_t *src, size_t numWords)
+{
+	bool printedHeader = false;
+	scratchString.Clear();
+	for (size_t i = 0; i + 1 < numWords; i += 2)
+	{
+		if (src[i] == 0xFFFFFFFF && src[i + 1] == 0xFFFFFFFF)
+		{
+			break;										// unwritten flash words mark the end of the saved trace
+		}
+		if (!printedHeader)
+		{
+			reprap.GetPlatform().Message(mtype, "Event trace before reset (millis:event, most recent last):\n");
+			printedHeader = true;
+		}
+		TraceEvent e;
+		memcpy(&e, src + i, sizeof(e));
+		AppendEvent(e);
+		FlushScratchString(mtype);
+	}
+	if (!scratchString.IsEmpty())
+	{
+		reprap.GetPlatform().MessageF(mtype, "%s\n", scratchString.Pointer());
+		scratchString.Clear();
+	}
+}
+
+// End
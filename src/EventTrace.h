@@ -0,0 +1,57 @@
+/*
+ * EventTrace.h
+ *
+ * In-memory flight recorder for postmortem diagnostics
+ */
+
+#ifndef SRC_EVENTTRACE_H_
+#define SRC_EVENTTRACE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "MessageType.h"
+
+// Ring buffer of recent firmware events, for diagnosing sporadic crashes and stalls. Recording an event is
+// cheap enough to do from interrupt service routines. M122 prints the live buffer, and Platform::SoftwareReset
+// saves the most recent entries along with the software reset data so that they can still be reported after
+// a crash or watchdog reset.
+class EventTrace
+{
+public:
+	enum class EventType : uint8_t
+	{
+		none = 0,
+		gcode,					// a G/M/T command was executed: a = command letter, b = command number
+		ddaStart,				// a queued move started executing: b = move time in milliseconds
+		networkState,			// the network state machine changed state: a = the new state
+		spinOutlier,			// a module Spin() call took unusually long: a = module, b = time taken in milliseconds
+		powerFail,				// the supply voltage dropped below the auto save threshold: b = voltage in decivolts
+		debugMessage,			// a debug message was routed to the trace sink: a = module, b = hash of the format string
+	};
+
+	static void Record(EventType et, uint8_t a, uint16_t b);		// record an event; may be called from an ISR
+	static void Diagnostics(MessageType mtype);						// print the live buffer
+	static size_t CopyRecent(uint32_t *dst, size_t numWords);		// copy the most recent events into 'dst' as 32-bit words
+	static void PrintSaved(MessageType mtype, const uint32_t *src, size_t numWords);	// print events previously saved by CopyRecent
+
+private:
+	struct TraceEvent
+	{
+		uint32_t when;			// value of millis() when the event was recorded
+		uint8_t type;			// one of EventType
+		uint8_t a;				// meaning depends on the type
+		uint16_t b;				// meaning depends on the type
+	};
+
+	static_assert(sizeof(TraceEvent) == 8, "TraceEvent must pack into two 32-bit words");
+
+	static void AppendEvent(const TraceEvent& e);					// append a description of one event to scratchString
+	static void FlushScratchString(MessageType mtype);				// print and clear scratchString if it is nearly full
+
+	static const size_t NumEvents = 64;								// number of events kept; must be a power of 2
+	static TraceEvent events[NumEvents];
+	static volatile uint32_t nextIndex;								// total number of events recorded
+};
+
+#endif /* SRC_EVENTTRACE_H_ */
@@ -7,13 +7,15 @@
 
 #include "Duet3DFilamentSensor.h"
 #include "GCodes/GCodeBuffer.h"
+#include "GCodes/GCodes.h"
 #include "Platform.h"
+#include "RepRap.h"
 #include "Movement/DDA.h"					// for stepClockRate
 
 // Constructors
 Duet3DFilamentSensor::Duet3DFilamentSensor(int type)
 	: FilamentSensor(type), mmPerRev(DefaultMmPerRev),
-	  tolerance(DefaultTolerance), minimumExtrusionCheckLength(DefaultMinimumExtrusionCheckLength), withSwitch(type == 4)
+	  tolerance(DefaultTolerance), minimumExtrusionCheckLength(DefaultMinimumExtrusionCheckLength), withSwitch(type == 4), autoTrim(false)
 {
 	Init();
 }
@@ -47,14 +49,21 @@ bool Duet3DFilamentSensor::Configure(GCodeBuffer& gb, StringRef& reply, bool& se
 		tolerance = gb.GetFValue() * 0.01;
 	}
 
+	if (gb.Seen('A'))
+	{
+		seen = true;
+		autoTrim = (gb.GetIValue() > 0);
+	}
+
 	if (seen)
 	{
 		Init();
 	}
 	else
 	{
-		reply.printf("Duet3D filament monitor on E%u, %s microswitch, %.2fmm/rev, check every %.1fmm, tolerance %.1f%%, ",
-						GetEndstopNumber(), (withSwitch) ? "with" : "no", (double)mmPerRev, (double)minimumExtrusionCheckLength, (double)(tolerance * 100.0));
+		reply.printf("Duet3D filament monitor on E%u, %s microswitch, %.2fmm/rev, check every %.1fmm, tolerance %.1f%%, auto trim %s, ",
+						GetEndstopNumber(), (withSwitch) ? "with" : "no", (double)mmPerRev, (double)minimumExtrusionCheckLength, (double)(tolerance * 100.0),
+						(autoTrim) ? "on" : "off");
 
 		if (!dataReceived)
 		{
@@ -85,28 +94,31 @@ bool Duet3DFilamentSensor::Configure(GCodeBuffer& gb, StringRef& reply, bool& se
 	return false;
 }
 
-// ISR for when the pin state changes
+// ISR for when the pin state changes. All we do here is record the edge time in the ring buffer;
+// the bit decoding is done out of interrupt context by Poll(), which consumes the buffer batch-wise.
 void Duet3DFilamentSensor::Interrupt()
 {
 	uint32_t now = Platform::GetInterruptClocks();
 	const size_t writePointer = edgeCaptureWritePointer;			// capture volatile variable
-	if ((writePointer + 1) % EdgeCaptureBufferSize != edgeCaptureReadPointer)
+	if ((writePointer + 1) % EdgeCaptureBufferSize == edgeCaptureReadPointer)
 	{
-		if (IoPort::ReadPin(GetPin()))
+		return;														// buffer is full, so drop this edge instead of overwriting unread ones
+	}
+
+	if (IoPort::ReadPin(GetPin()))
+	{
+		if ((writePointer & 1) == 0)								// low-to-high transitions should occur on odd indices
 		{
-			if ((writePointer & 1) == 0)							// low-to-high transitions should occur on odd indices
-			{
-				return;
-			}
+			return;
 		}
-		else
+	}
+	else
+	{
+		if ((writePointer & 1) != 0)								// high-to-low transitions should occur on even indices
 		{
-			if ((writePointer & 1) != 0)							// high-to-low transitions should occur on even indices
-			{
-				return;
-			}
-			now -= 40;												// partial correction for skew caused by debounce filter on Duet endstop inputs (measured skew = 74)
+			return;
 		}
+		now -= 40;													// partial correction for skew caused by debounce filter on Duet endstop inputs (measured skew = 74)
 	}
 
 	edgeCaptures[writePointer] = now;								// record the time at which this edge was detected
@@ -329,7 +341,8 @@ FilamentSensorStatus Duet3DFilamentSensor::CheckFilament(float amountCommanded,
 	}
 
 	FilamentSensorStatus ret = FilamentSensorStatus::ok;
-	if (!comparisonStarted)
+	const bool firstMeasurement = !comparisonStarted;
+	if (firstMeasurement)
 	{
 		// The first measurement after we start extruding is often a long way out, so discard it
 		comparisonStarted = true;
@@ -379,6 +392,19 @@ FilamentSensorStatus Duet3DFilamentSensor::CheckFilament(float amountCommanded,
 		calibrationStarted = true;
 	}
 
+	// If automatic trimming is enabled and this measurement looks sane, nudge the extrusion factor towards the value
+	// that makes the delivered flow match what the slicer asked for. The commanded amount already includes the current
+	// extrusion factor, so the factor that delivers the right amount of filament is the reciprocal of the measured ratio.
+	// The gain is deliberately low so that one noisy measurement window cannot cause a big change, and the total
+	// correction is bounded.
+	if (autoTrim && !firstMeasurement && ret == FilamentSensorStatus::ok && amountCommanded > 0.0 && extrusionMeasured > 0.0)
+	{
+		const float targetFactor = amountCommanded/extrusionMeasured;
+		const float currentFactor = reprap.GetGCodes().GetExtrusionFactor(GetExtruder());
+		const float newFactor = constrain<float>(currentFactor + (AutoTrimGain * (targetFactor - currentFactor)), 1.0 - MaxAutoTrim, 1.0 + MaxAutoTrim);
+		reprap.GetGCodes().TrimExtrusionFactor(GetExtruder(), newFactor);
+	}
+
 	accumulatedExtrusionCommanded -= amountCommanded;
 	extrusionCommandedAtLastMeasurement = accumulatedRevsMeasured = 0.0;
 
@@ -26,6 +26,9 @@ private:
 	static constexpr float DefaultTolerance = 0.2;
 	static constexpr float DefaultMinimumExtrusionCheckLength = 3.0;
 
+	static constexpr float AutoTrimGain = 0.25;				// how much of the apparent flow error we correct per measurement window
+	static constexpr float MaxAutoTrim = 0.25;				// bound on the automatic extrusion factor correction, +/- from 100%
+
 	static constexpr uint16_t SwitchOpenBit = 0x4000u;
 	static constexpr uint16_t ErrorBit = 0x8000u;
 	static constexpr uint16_t AngleMask = 0x03FF;			// 10-bit sensor angle
@@ -42,6 +45,7 @@ private:
 	float tolerance;
 	float minimumExtrusionCheckLength;
 	bool withSwitch;
+	bool autoTrim;											// adjust the extrusion factor automatically to correct small flow errors?
 
 	// Other data
 	uint16_t sensorValue;
@@ -144,6 +144,10 @@ bool FilamentSensor::ConfigurePin(GCodeBuffer& gb, StringRef& reply, bool& seen)
 		{
 			delete sensor;
 			sensor = Create(newSensorType);
+			if (sensor != nullptr)
+			{
+				sensor->SetExtruder(extruder);
+			}
 			return true;
 		}
 	}
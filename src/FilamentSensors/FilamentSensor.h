@@ -45,6 +45,9 @@ public:
 	// Return the type of this sensor
 	int GetType() const { return type; }
 
+	// Tell this sensor which extruder drive it monitors
+	void SetExtruder(size_t extruder) { extruderNumber = extruder; }
+
 	// Return an error message corresponding to a status code
 	static const char *GetErrorMessage(FilamentSensorStatus f);
 
@@ -61,7 +64,7 @@ public:
 	static void Diagnostics(MessageType mtype);
 
 protected:
-	FilamentSensor(int t) : type(t), pin(NoPin) { }
+	FilamentSensor(int t) : type(t), pin(NoPin), extruderNumber(0) { }
 
 	bool ConfigurePin(GCodeBuffer& gb, StringRef& reply, bool& seen);
 
@@ -69,6 +72,8 @@ protected:
 
 	Pin GetPin() const { return pin; }
 
+	size_t GetExtruder() const { return extruderNumber; }
+
 private:
 	// Create a filament sensor returning null if not a valid sensor type
 	static FilamentSensor *Create(int type);
@@ -80,6 +85,7 @@ private:
 	int type;
 	int endstopNumber;
 	Pin pin;
+	size_t extruderNumber;
 };
 
 #endif /* SRC_FILAMENTSENSORS_FILAMENTSENSOR_H_ */
@@ -8,6 +8,7 @@
 //*************************************************************************************
 
 #include "GCodeBuffer.h"
+#include "Libraries/General/StringView.h"
 #include "Platform.h"
 #include "RepRap.h"
 
@@ -30,6 +31,8 @@ void GCodeBuffer::Init()
 	gcodeLineEnd = 0;
 	commandLength = 0;
 	readPointer = -1;
+	parametersCached = false;
+	lastSeenParameter = -1;
 	hadLineNumber = hadChecksum = timerRunning = false;
 	computedChecksum = 0;
 	bufferState = GCodeBufferState::parseNotStarted;
@@ -222,6 +225,113 @@ bool GCodeBuffer::Put(char c)
 	return false;
 }
 
+// Add a block of characters, behaving exactly as if Put had been called on each one in turn.
+// In the states that do nothing but accumulate ordinary characters - the body of a command, a quoted string,
+// a bracketed comment and the discard state after a checksum or semicolon - we find the end of the run of such
+// characters first and then checksum and copy the whole run, instead of taking every character through the
+// state machine switch. This is where almost all the characters of a typical line go, so when a host streams
+// GCode in blocks the per-character overhead largely disappears.
+// Return true when a complete command is ready to be acted upon, with bytesTaken set to the number of
+// characters consumed from the block; any remainder must be offered again after the command has been executed.
+bool GCodeBuffer::PutBlock(const char *data, size_t len, size_t& bytesTaken)
+{
+	size_t i = 0;
+	while (i < len)
+	{
+		size_t j = i;
+		switch (bufferState)
+		{
+		case GCodeBufferState::parsingGCode:
+			while (j < len)
+			{
+				const char c = data[j];
+				if (c == 0 || c == '\n' || c == '\r' || c == '*' || c == ';' || c == '(' || c == '"')
+				{
+					break;
+				}
+				++j;
+			}
+			break;
+
+		case GCodeBufferState::parsingQuotedString:
+			while (j < len)
+			{
+				const char c = data[j];
+				if (c == 0 || c == '\n' || c == '\r' || c == '"')
+				{
+					break;
+				}
+				++j;
+			}
+			break;
+
+		case GCodeBufferState::parsingBracketedComment:
+			while (j < len)
+			{
+				const char c = data[j];
+				if (c == 0 || c == '\n' || c == '\r' || c == ')')
+				{
+					break;
+				}
+				++j;
+			}
+			break;
+
+		case GCodeBufferState::discarding:
+			while (j < len)
+			{
+				const char c = data[j];
+				if (c == 0 || c == '\n' || c == '\r')
+				{
+					break;
+				}
+				++j;
+			}
+			break;
+
+		default:
+			// Parsing a line number or leading whitespace, which only lasts a few characters per line
+			break;
+		}
+
+		if (j != i)
+		{
+			// Checksum and store the run in one go. Characters in a bracketed comment are checksummed but not
+			// stored, and discarded characters are neither; this matches the per-character code above.
+			const size_t runLength = j - i;
+			commandLength += runLength;
+			if (bufferState != GCodeBufferState::discarding)
+			{
+				for (size_t k = i; k < j; ++k)
+				{
+					computedChecksum ^= (uint8_t)data[k];
+				}
+				if (bufferState != GCodeBufferState::parsingBracketedComment)
+				{
+					const size_t charsToStore = min<size_t>(runLength, ARRAY_SIZE(gcodeBuffer) - gcodeLineEnd);
+					memcpy(gcodeBuffer + gcodeLineEnd, data + i, charsToStore);
+					gcodeLineEnd += charsToStore;
+				}
+			}
+			i = j;
+			if (i == len)
+			{
+				break;
+			}
+		}
+
+		// The next character ends the line or changes the parsing state, so take it through the state machine
+		if (Put(data[i++]))
+		{
+			bytesTaken = i;
+			return true;
+		}
+	}
+
+	bytesTaken = len;
+	return false;
+}
+
 // This is called when we are fed a null, CR or LF character.
 // Return true if there is a completed command ready to be executed.
 bool GCodeBuffer::LineFinished()
@@ -345,9 +455,37 @@ void GCodeBuffer::DecodeCommand()
 		parameterStart = commandStart;
 		commandEnd = gcodeLineEnd;
 	}
+	CacheParameters();
 	bufferState = GCodeBufferState::ready;
 }
 
+// Scan the current command once and record where each parameter letter first occurs and the numeric value that follows it,
+// so that Seen() becomes a table lookup and GetFValue() doesn't need to parse text. This means that a movement command is
+// fully parsed in a single pass however many parameters the command handler asks about.
+void GCodeBuffer::CacheParameters()
+{
+	memset(parameterOffsets, NoParameterOffset, sizeof(parameterOffsets));
+	bool inQuotes = false;
+	for (unsigned int i = parameterStart; i < commandEnd; ++i)
+	{
+		const char b = gcodeBuffer[i];
+		if (b == '"')
+		{
+			inQuotes = !inQuotes;
+		}
+		else if (!inQuotes)
+		{
+			const char ub = toupper(b);
+			if (ub >= 'A' && ub <= 'Z' && parameterOffsets[ub - 'A'] == NoParameterOffset)
+			{
+				parameterOffsets[ub - 'A'] = (uint8_t)i;
+				parameterValues[ub - 'A'] = (float)strtod(&gcodeBuffer[i + 1], 0);
+			}
+		}
+	}
+	parametersCached = true;
+}
+
 // Add an entire string, overwriting any existing content and adding '\n' at the end if necessary to make it a complete line
 void GCodeBuffer::Put(const char *str, size_t len)
 {
@@ -404,6 +542,21 @@ FilePosition GCodeBuffer::GetFilePosition(size_t bytesCached) const
 // Leave the pointer there for a subsequent read.
 bool GCodeBuffer::Seen(char c)
 {
+	lastSeenParameter = -1;
+	if (parametersCached && c >= 'A' && c <= 'Z')
+	{
+		const uint8_t offset = parameterOffsets[c - 'A'];
+		if (offset == NoParameterOffset)
+		{
+			readPointer = -1;
+			return false;
+		}
+		readPointer = offset;
+		lastSeenParameter = c - 'A';
+		return true;
+	}
+
+	// The cache has been invalidated (e.g. commandEnd was moved by reading an unquoted string), so scan the buffer
 	bool inQuotes = false;
 	for (readPointer = parameterStart; (unsigned int)readPointer < commandEnd; ++readPointer)
 	{
@@ -421,12 +574,42 @@ bool GCodeBuffer::Seen(char c)
 	return false;
 }
 
+// Fetch all the parameters described by a descriptor table in one pass. values[] is parallel to descriptors[];
+// entries whose letters are absent are left unchanged, so the caller can preload defaults. The return value is
+// a bitmap with bit n set if descriptors[n].letter was present. Values outside the descriptor bounds are clamped,
+// which is what most handlers do anyway with constrain<float>. If the parameter cache is not valid for this
+// command we fall back to Seen(), which scans the buffer.
+uint32_t GCodeBuffer::FetchParameters(const ParameterDescriptor descriptors[], size_t numDescriptors, float values[])
+{
+	uint32_t seenBitmap = 0;
+	for (size_t i = 0; i < numDescriptors; ++i)
+	{
+		const char letter = descriptors[i].letter;
+		if (parametersCached)
+		{
+			if (parameterOffsets[letter - 'A'] != NoParameterOffset)
+			{
+				values[i] = constrain<float>(parameterValues[letter - 'A'], descriptors[i].minValue, descriptors[i].maxValue);
+				SetBit(seenBitmap, i);
+			}
+		}
+		else if (Seen(letter))
+		{
+			values[i] = constrain<float>(GetFValue(), descriptors[i].minValue, descriptors[i].maxValue);
+			SetBit(seenBitmap, i);
+		}
+	}
+	return seenBitmap;
+}
+
 // Get a float after a G Code letter found by a call to Seen()
 float GCodeBuffer::GetFValue()
 {
 	if (readPointer >= 0)
 	{
-		const float result = (float) strtod(&gcodeBuffer[readPointer + 1], 0);
+		const float result = (lastSeenParameter >= 0)
+								? parameterValues[lastSeenParameter]				// the value was parsed when the command was decoded
+								: (float) strtod(&gcodeBuffer[readPointer + 1], 0);
 		readPointer = -1;
 		return result;
 	}
@@ -633,16 +816,19 @@ bool GCodeBuffer::InternalGetPossiblyQuotedString(const StringRef& str)
 	}
 
 	commandEnd = gcodeLineEnd;				// the string is the remainder of the line of gcode
-	for (;;)
+	parametersCached = false;				// commandEnd has moved, so the cached offsets no longer cover the whole command
+
+	// Slice the remainder of the line out of the buffer as a view, then copy it to the destination in one operation
+	// instead of appending character by character
+	const unsigned int start = (unsigned int)readPointer;
+	unsigned int end = start;
+	while (gcodeBuffer[end] >= ' ')
 	{
-		const char c = gcodeBuffer[readPointer++];
-		if (c < ' ')
-		{
-			break;
-		}
-		str.cat(c);
+		++end;
 	}
-	str.StripTrailingSpaces();
+	readPointer = (int)end + 1;
+	const StringView remainder = StringView(gcodeBuffer + start, end - start).WithoutTrailingSpaces();
+	remainder.CopyTo(str);
 	return !str.IsEmpty();
 }
 
@@ -654,6 +840,7 @@ bool GCodeBuffer::InternalGetPossiblyQuotedString(const StringRef& str)
 bool GCodeBuffer::GetUnprecedentedString(const StringRef& str)
 {
 	readPointer = parameterStart;
+	lastSeenParameter = -1;
 	char c;
 	while ((unsigned int)readPointer < commandEnd && ((c = gcodeBuffer[readPointer]) == ' ' || c == '\t'))
 	{
@@ -21,10 +21,24 @@ public:
 	void Init(); 										// Set it up to parse another G-code
 	void Diagnostics(MessageType mtype);				// Write some debug info
 	bool Put(char c) __attribute__((hot));				// Add a character to the end
+	bool PutBlock(const char *data, size_t len, size_t& bytesTaken) __attribute__((hot));
+														// Add a block of characters, stopping after a complete command
 	void Put(const char *str, size_t len);				// Add an entire string, overwriting any existing content
 	void Put(const char *str);							// Add a null-terminated string, overwriting any existing content
 	bool Seen(char c) __attribute__((hot));				// Is a character present?
 
+	// Compile-time descriptor of one numeric parameter that a command accepts. Handlers declare a constexpr
+	// table of these and call FetchParameters to get all the values, validated against the bounds, in one pass.
+	struct ParameterDescriptor
+	{
+		char letter;									// the parameter letter, in upper case
+		float minValue;									// the lowest value the handler accepts; lower values are clamped
+		float maxValue;									// the highest value the handler accepts; higher values are clamped
+	};
+
+	uint32_t FetchParameters(const ParameterDescriptor descriptors[], size_t numDescriptors, float values[]);
+														// Fill in values[] from the parameters present, returning a bitmap of which ones were seen
+
 	char GetCommandLetter() const { return commandLetter; }
 	bool HasCommandNumber() const { return hasCommandNumber; }
 	int GetCommandNumber() const { return commandNumber; }
@@ -103,6 +117,7 @@ private:
 	void StoreAndAddToChecksum(char c);
 	bool LineFinished();								// Deal with receiving end-of-line and return true if we have a command
 	void DecodeCommand();
+	void CacheParameters();								// Record where each parameter letter first occurs in the current command
 	bool InternalGetQuotedString(const StringRef& str)
 		pre (gcodeBuffer[readPointer] == '"'; str.IsEmpty());
 	bool InternalGetPossiblyQuotedString(const StringRef& str)
@@ -132,6 +147,14 @@ private:
 	int commandNumber;
 	int8_t commandFraction;
 
+	static constexpr size_t NumParameterLetters = 26;	// one slot for each letter A-Z
+	static constexpr uint8_t NoParameterOffset = 0xFF;	// the offset we store for letters that are not present
+
+	uint8_t parameterOffsets[NumParameterLetters];		// index in gcodeBuffer of the first occurrence of each parameter letter in the current command
+	float parameterValues[NumParameterLetters];			// the numeric value following each parameter letter that is present, parsed when the command was decoded
+	bool parametersCached;								// true if parameterOffsets is valid for the current command
+	int8_t lastSeenParameter;							// index of the parameter that Seen() last found in the cache, or -1 if it used the scan fallback
+
 	bool queueCodes;									// Can we queue certain G-codes from this source?
 	bool binaryWriting;									// Executing gcode or writing binary file?
 	uint32_t crc32;										// crc32 of the binary file
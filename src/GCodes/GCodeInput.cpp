@@ -64,7 +64,13 @@ size_t StreamGCodeInput::BytesCached() const
 // Dynamic G-code input class for caching codes from software-defined sources
 
 RegularGCodeInput::RegularGCodeInput()
-	: state(GCodeInputState::idle), buffer(reinterpret_cast<char * const>(buf32)), writingPointer(0), readingPointer(0)
+	: state(GCodeInputState::idle), bufferSize(GCodeInputBufferSize), buffer(reinterpret_cast<char * const>(buf32)), writingPointer(0), readingPointer(0)
+{
+}
+
+// Constructor for derived classes that supply their own (e.g. larger) buffer
+RegularGCodeInput::RegularGCodeInput(char *buf, size_t bufSize)
+	: state(GCodeInputState::idle), bufferSize(bufSize), buffer(buf), writingPointer(0), readingPointer(0)
 {
 }
 
@@ -74,10 +80,37 @@ void RegularGCodeInput::Reset()
 	writingPointer = readingPointer = 0;
 }
 
+// Fill a GCodeBuffer from the ring buffer. The data is already in memory here, so instead of passing it to the
+// parser one ReadByte at a time we hand over the longest contiguous slices of the ring buffer and let it consume
+// whole runs of characters at once. Characters destined for a file being uploaded still need to be handled
+// individually by the GCodes class, so those cases fall back to the per-character code in the base class.
+bool RegularGCodeInput::FillBuffer(GCodeBuffer *gb)
+{
+	if (gb->IsWritingBinary() || gb->WritingFileDirectory() != nullptr)
+	{
+		return GCodeInput::FillBuffer(gb);
+	}
+
+	size_t bytesLeft = min<size_t>(BytesCached(), GCODE_LENGTH);
+	while (bytesLeft != 0)
+	{
+		const size_t contiguous = min<size_t>(bytesLeft, bufferSize - readingPointer);
+		size_t bytesTaken;
+		const bool commandComplete = gb->PutBlock(buffer + readingPointer, contiguous, bytesTaken);
+		readingPointer = (readingPointer + bytesTaken) % bufferSize;
+		bytesLeft -= bytesTaken;
+		if (commandComplete)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 char RegularGCodeInput::ReadByte()
 {
 	char c = buffer[readingPointer++];
-	if (readingPointer == GCodeInputBufferSize)
+	if (readingPointer == bufferSize)
 	{
 		readingPointer = 0;
 	}
@@ -91,7 +124,7 @@ size_t RegularGCodeInput::BytesCached() const
 	{
 		return writingPointer - readingPointer;
 	}
-	return GCodeInputBufferSize - readingPointer + writingPointer;
+	return bufferSize - readingPointer + writingPointer;
 }
 
 void RegularGCodeInput::Put(MessageType mtype, const char c)
@@ -170,7 +203,7 @@ void RegularGCodeInput::Put(MessageType mtype, const char c)
 
 	// Feed another character into the buffer
 	buffer[writingPointer++] = c;
-	if (writingPointer == GCodeInputBufferSize)
+	if (writingPointer == bufferSize)
 	{
 		writingPointer = 0;
 	}
@@ -181,6 +214,11 @@ void RegularGCodeInput::Put(MessageType mtype, const char *buf)
 	Put(mtype, buf, strlen(buf) + 1);
 }
 
+// Append a whole block of characters to the buffer. This is the path that network clients streaming entire print
+// jobs go through, so instead of passing every byte through a function call and the state machine switch, we make
+// one scan pass over the block for M112/M122 and then copy it into the ring buffer with bulk memcpy calls.
+// The state machine transitions and the dropping of whitespace between codes are the same as in the
+// single-character Put above, so the two paths can be mixed freely on the same input.
 void RegularGCodeInput::Put(MessageType mtype, const char *buf, size_t len)
 {
 	if (len > BufferSpaceLeft())
@@ -189,15 +227,98 @@ void RegularGCodeInput::Put(MessageType mtype, const char *buf, size_t len)
 		return;
 	}
 
+	size_t segmentStart = 0;						// start of the run of characters waiting to be copied
 	for (size_t i = 0; i < len; i++)
 	{
-		Put(mtype, buf[i]);
+		const char c = buf[i];
+		switch (state)
+		{
+			case GCodeInputState::idle:
+				if (c <= ' ')
+				{
+					// Ignore whitespace between codes: copy what came before it and skip this character
+					Append(buf + segmentStart, i - segmentStart);
+					segmentStart = i + 1;
+				}
+				else
+				{
+					state = (c == 'M') ? GCodeInputState::doingMCode : GCodeInputState::doingCode;
+				}
+				break;
+
+			case GCodeInputState::doingCode:
+				if (c == 0 || c == '\r' || c == '\n')
+				{
+					state = GCodeInputState::idle;
+				}
+				break;
+
+			case GCodeInputState::doingMCode:
+				state = (c == '1') ? GCodeInputState::doingMCode1 : GCodeInputState::doingCode;
+				break;
+
+			case GCodeInputState::doingMCode1:
+				state = (c == '1') ? GCodeInputState::doingMCode11: (c == '2') ? GCodeInputState::doingMCode12 : GCodeInputState::doingCode;
+				break;
+
+			case GCodeInputState::doingMCode11:
+				state = (c == '2') ? GCodeInputState::doingMCode112 : GCodeInputState::doingCode;
+				break;
+
+			case GCodeInputState::doingMCode12:
+				state = (c == '2') ? GCodeInputState::doingMCode122 : GCodeInputState::doingCode;
+				break;
+
+			case GCodeInputState::doingMCode112:
+				if (c <= ' ' || c == ';')
+				{
+					// Emergency stop requested - perform it now and discard the rest of the block
+					reprap.EmergencyStop();
+					reprap.GetGCodes().Reset();
+					Reset();
+					return;
+				}
+				state = GCodeInputState::doingCode;
+				break;
+
+			case GCodeInputState::doingMCode122:
+				if (c < ' ' || c == ';')
+				{
+					// Diagnostics requested - report them now and discard the rest of the block
+					reprap.Diagnostics(mtype);
+					Reset();
+					return;
+				}
+				state = GCodeInputState::doingCode;
+				break;
+		}
+	}
+
+	Append(buf + segmentStart, len - segmentStart);
+}
+
+// Copy a block of characters into the ring buffer, wrapping round the end if necessary.
+// The caller has already checked that there is enough room.
+void RegularGCodeInput::Append(const char *data, size_t len)
+{
+	while (len != 0)
+	{
+		const size_t chunk = min<size_t>(len, bufferSize - writingPointer);
+		memcpy(buffer + writingPointer, data, chunk);
+		writingPointer = (writingPointer + chunk) % bufferSize;
+		data += chunk;
+		len -= chunk;
 	}
 }
 
 size_t RegularGCodeInput::BufferSpaceLeft() const
 {
-	return (readingPointer - writingPointer - 1u) % GCodeInputBufferSize;
+	// The modulo trick only works when the buffer size is a power of two, which the file input buffer is not
+	if (readingPointer > writingPointer)
+	{
+		return readingPointer - writingPointer - 1;
+	}
+	return bufferSize - writingPointer + readingPointer - 1;
 }
 
 
@@ -238,8 +359,15 @@ bool FileGCodeInput::ReadFromFile(FileData &file)
 	}
 	lastFile = file.f;
 
-	// Read more from the file
-	if (bytesCached < GCodeInputFileReadThreshold)
+	// Read more from the file. We read whole sectors at a time directly into the ring buffer, so that FatFS can use its
+	// aligned (multi-)sector path instead of copying the data through its own sector cache. Because we only ever read
+	// multiples of the sector size, writingPointer stays sector-aligned except possibly after reading the tail of the
+	// file, and the read never needs to wrap round the end of the buffer.
+	// We top the buffer up only when it has room for a worthwhile multi-sector read, unless it is nearly empty.
+	// Reading a single sector as soon as one is free would keep the buffer full, but would deny the SD stack the
+	// chance to issue multi-block transfers, which is where most of the card's read throughput comes from.
+	const size_t alignedSpace = BufferSpaceLeft() & ~(SdSectorSize - 1);
+	if (alignedSpace >= MinSectorsPerFileRead * SdSectorSize || (alignedSpace != 0 && bytesCached < SdSectorSize))
 	{
 		// Reset the read+write pointers for better performance if possible
 		if (readingPointer == writingPointer)
@@ -247,25 +375,11 @@ bool FileGCodeInput::ReadFromFile(FileData &file)
 			readingPointer = writingPointer = 0;
 		}
 
-		// Read blocks with sizes multiple of 4 for HSMCI efficiency
-		uint32_t readBuffer32[(GCodeInputBufferSize + 3) / 4];
-		char * const readBuffer = reinterpret_cast<char * const>(readBuffer32);
-
-		int bytesRead = file.Read(readBuffer, BufferSpaceLeft() & (~3));
+		const size_t toRead = min<size_t>(alignedSpace, bufferSize - writingPointer);
+		const int bytesRead = file.Read(buffer + writingPointer, toRead);
 		if (bytesRead > 0)
 		{
-			int remaining = GCodeInputBufferSize - writingPointer;
-			if (bytesRead <= remaining)
-			{
-				memcpy(buffer + writingPointer, readBuffer, bytesRead);
-			}
-			else
-			{
-				memcpy(buffer + writingPointer, readBuffer, remaining);
-				memcpy(buffer, readBuffer + remaining, bytesRead - remaining);
-			}
-			writingPointer = (writingPointer + bytesRead) % GCodeInputBufferSize;
-
+			writingPointer = (writingPointer + bytesRead) % bufferSize;
 			return true;
 		}
 	}
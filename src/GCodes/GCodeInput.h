@@ -14,8 +14,14 @@
 #include "Storage/FileStore.h"
 
 
-const size_t GCodeInputBufferSize = 256;				// How many bytes can we cache per input source?
-const size_t GCodeInputFileReadThreshold = 128;			// How many free bytes must be available before data is read from the SD card?
+const size_t GCodeInputBufferSize = 256;				// How many bytes can we cache per regular input source?
+const size_t SdSectorSize = 512;						// The size of an SD card sector in bytes
+#if SAM4E || SAM4S || SAME70
+const size_t FileGCodeInputBufferSize = 8 * SdSectorSize;	// How many bytes we read ahead from the file being printed; must be a multiple of the sector size
+#else
+const size_t FileGCodeInputBufferSize = 3 * SdSectorSize;	// We are more memory-constrained on the SAM3X
+#endif
+const size_t MinSectorsPerFileRead = FileGCodeInputBufferSize/(2 * SdSectorSize);	// How many sectors the buffer must have room for before we top it up
 
 
 // This base class is intended to provide incoming G-codes for the GCodeBuffer class
@@ -23,7 +29,7 @@ class GCodeInput
 {
 public:
 	virtual void Reset() = 0;							// Clean all the cached data from this input
-	bool FillBuffer(GCodeBuffer *gb);					// Fill a GCodeBuffer with the last available G-code
+	virtual bool FillBuffer(GCodeBuffer *gb);			// Fill a GCodeBuffer with the last available G-code
 	virtual size_t BytesCached() const = 0;				// How many bytes have been cached?
 	virtual char ReadByte() = 0;						// Get the next byte from the source
 };
@@ -70,6 +76,7 @@ public:
 	RegularGCodeInput();
 
 	void Reset() override;
+	bool FillBuffer(GCodeBuffer *gb) override;			// Fill a GCodeBuffer, passing it whole slices of the ring buffer
 	size_t BytesCached() const override;				// How many bytes have been cached?
 	char ReadByte() override;
 
@@ -80,20 +87,27 @@ public:
 	size_t BufferSpaceLeft() const;						// How much space do we have left?
 
 private:
+	void Append(const char *data, size_t len);			// Copy a block of characters into the ring buffer
+
 	GCodeInputState state;
+	uint32_t buf32[(GCodeInputBufferSize + 3) / 4];		// the default buffer, not used if a derived class supplies its own
 
 protected:
-	uint32_t buf32[(GCodeInputBufferSize + 3) / 4];
+	RegularGCodeInput(char *buf, size_t bufSize);		// construct with a buffer supplied by a derived class
+
+	const size_t bufferSize;							// the size of the ring buffer
 	char * const buffer;
 	size_t writingPointer, readingPointer;
 };
 
 // This class is an expansion of the RegularGCodeInput class to buffer G-codes and to rewind file positions when
 // nested G-code files are started. However buffered codes are not explicitly checked for M112.
+// It uses a larger buffer than the other input sources, sized and read in whole SD sectors so that FatFS can
+// transfer data via its aligned sector path instead of copying through its own cache a few bytes at a time.
 class FileGCodeInput : public RegularGCodeInput
 {
 public:
-	FileGCodeInput() : RegularGCodeInput(), lastFile(nullptr) { }
+	FileGCodeInput() : RegularGCodeInput(new char[FileGCodeInputBufferSize], FileGCodeInputBufferSize), lastFile(nullptr) { }
 
 	void Reset() override;								// This should be called when the associated file is being closed
 	void Reset(const FileData &file);					// Should be called when a specific G-code or macro file is closed outside the reading context
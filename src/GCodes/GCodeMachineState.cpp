@@ -15,6 +15,7 @@ GCodeMachineState::GCodeMachineState()
 	: previous(nullptr), feedrate(DefaultFeedrate * SecondsToMinutes), fileState(), lockedResources(0), state(GCodeState::normal),
 	  drivesRelative(false), axesRelative(false), doingFileMacro(false), runningM501(false), runningM502(false), volumetricExtrusion(false), waitingForAcknowledgement(false), messageAcknowledged(false)
 {
+	ClearBlocks();
 }
 
 // Allocate a new GCodeMachineState
@@ -26,6 +27,7 @@ GCodeMachineState::GCodeMachineState()
 		freeList = ms->previous;
 		ms->lockedResources = 0;
 		ms->state = GCodeState::normal;
+		ms->ClearBlocks();
 	}
 	else
 	{
@@ -56,6 +56,18 @@ enum class GCodeState : uint8_t
 	gridProbing4,
 	gridProbing5,
 	gridProbing6,
+	gridProbing7,
+
+	// These next 9 must be contiguous. They are used for continuous-motion grid scanning with an analog Z probe (G29 S3).
+	gridScanning1,
+	gridScanning2,
+	gridScanning3,
+	gridScanning4,
+	gridScanning5,
+	gridScanning6,
+	gridScanning7,
+	gridScanning8,
+	gridScanning9,
 
 	// These next 8 must be contiguous
 	probingAtPoint0,
@@ -84,13 +96,22 @@ public:
 	typedef uint32_t ResourceBitmap;
 	GCodeMachineState();
 
+	static const size_t MaxBlockNesting = 4;			// maximum nesting of if/while blocks in one file
+
 	GCodeMachineState *previous;
 	float feedrate;
 	FileData fileState;
 	ResourceBitmap lockedResources;
+	FilePosition blockStartPos[MaxBlockNesting];		// for 'while' blocks, the file position of the start of the 'while' line
 	GCodeState state;
 	uint8_t toolChangeParam;
+	uint8_t blockNesting;								// how many if/while blocks we are currently inside
+	uint8_t skipLevel;									// if nonzero, lines are being skipped until the block at this level is closed
+	uint8_t whileBits;									// bitmap of which open blocks are 'while' blocks
+	uint8_t overflowedBlocks;							// how many blocks were rejected as nested too deeply, so their terminators can be consumed
 	int16_t newToolNumber;
+
+	void ClearBlocks() { blockNesting = skipLevel = whileBits = overflowedBlocks = 0; }	// forget any open if/while blocks
 	unsigned int
 		drivesRelative : 1,
 		axesRelative : 1,
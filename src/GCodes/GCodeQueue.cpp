@@ -8,24 +8,67 @@
 #include "GCodeQueue.h"
 
 #include "RepRap.h"
+#include "DebugRouting.h"
 #include "GCodes.h"
 #include "Movement/Move.h"
 
 // GCodeQueue class
 
-GCodeQueue::GCodeQueue() : freeItems(nullptr), queuedItems(nullptr)
+GCodeQueue::GCodeQueue() : head(0), tail(0), numQueuedCodes(0), maxArenaUsed(0)
 {
-	for (size_t i = 0; i < maxQueuedCodes; i++)
+}
+
+// Append a byte to the arena
+inline void GCodeQueue::PutByte(uint8_t b)
+{
+	arena[tail] = b;
+	tail = (tail + 1) % CodeQueueArenaSize;
+}
+
+// Fetch the byte at pos and advance pos with wraparound
+inline uint8_t GCodeQueue::GetByte(size_t& pos) const
+{
+	const uint8_t b = arena[pos];
+	pos = (pos + 1) % CodeQueueArenaSize;
+	return b;
+}
+
+// Fetch the move count of the entry starting at pos
+uint32_t GCodeQueue::GetMoveCount(size_t pos) const
+{
+	uint32_t count = 0;
+	for (unsigned int i = 0; i < 4; ++i)
 	{
-		freeItems = new QueuedCode(freeItems);
+		count |= (uint32_t)GetByte(pos) << (8 * i);
 	}
+	return count;
+}
+
+// Fetch the total size of the entry starting at pos
+size_t GCodeQueue::GetEntrySize(size_t pos) const
+{
+	return QueuedCodeHeaderSize + arena[(pos + QueuedCodeHeaderSize - 1) % CodeQueueArenaSize];
+}
+
+// How many bytes of the arena are free?
+size_t GCodeQueue::SpaceLeft() const
+{
+	return (head - tail - 1u) % CodeQueueArenaSize;
+}
+
+// Remove the entry at the head of the queue
+void GCodeQueue::ReleaseOldestEntry()
+{
+	head = (head + GetEntrySize(head)) % CodeQueueArenaSize;
+	--numQueuedCodes;
 }
 
 // If moves are scheduled and the command in the passed GCodeBuffer can be queued, try to queue it.
 // If successful, return true to indicate it has been queued and the caller should not execute it.
 // If it is not a command that should be queued, return false.
-// If the queue is full, free up the oldest queued entry by copying its command to our own gcode buffer
-// so that we have room to queue the original command.
+// If the arena is too full to hold it, free up the oldest queued entry by copying its command to our own gcode buffer
+// so that we have room to queue the original command; or if even that doesn't make enough room, return false so that
+// the new command is executed immediately instead.
 bool GCodeQueue::QueueCode(GCodeBuffer &gb, uint32_t segmentsLeft)
 {
 	// Don't queue anything if no moves are being performed
@@ -89,53 +132,60 @@ bool GCodeQueue::QueueCode(GCodeBuffer &gb, uint32_t segmentsLeft)
 	// Does it make sense to queue this code?
 	if (queueCode)
 	{
+		const size_t codeLength = strlen(gb.Buffer());
+		const size_t bytesNeeded = QueuedCodeHeaderSize + codeLength;
+
 		char codeToRun[GCODE_LENGTH];
-		size_t codeToRunLength;
+		size_t codeToRunLength = 0;
 
-		// Can we queue this code somewhere?
-		if (freeItems == nullptr)
+		if (bytesNeeded > SpaceLeft())
 		{
-			// No - we've run out of free items. Run the first outstanding code
+			// The arena is too full. See whether releasing the oldest entry would make enough room; if not, let the
+			// caller execute the new code immediately, because we can only run one displaced code ourselves.
+			if (numQueuedCodes == 0 || SpaceLeft() + GetEntrySize(head) < bytesNeeded)
+			{
+				return false;
+			}
+
+			// Copy the oldest code out so that we can run it from our own buffer, then release its entry
+			size_t pos = head;
+			for (unsigned int i = 0; i < QueuedCodeHeaderSize - 1; ++i)
+			{
+				(void)GetByte(pos);							// skip the move count and tool number adjust
+			}
+			codeToRunLength = GetByte(pos);
+			for (size_t i = 0; i < codeToRunLength; ++i)
+			{
+				codeToRun[i] = (char)GetByte(pos);
+			}
+			codeToRun[codeToRunLength] = 0;
+			ReleaseOldestEntry();
 			queueCode = false;
-			codeToRunLength = strlen(queuedItems->code) + 1;
-			SafeStrncpy(codeToRun, queuedItems->code, ARRAY_SIZE(codeToRun));
-
-			// Release the first queued item so that it can be reused later
-			QueuedCode * const item = queuedItems;
-			queuedItems = item->next;
-			item->next = nullptr;
-			freeItems = item;
 		}
 
-		// Unlink a free element and assign gb's code to it
-		QueuedCode * const code = freeItems;
-		freeItems = code->next;
-		code->AssignFrom(gb);
-		code->executeAtMove = scheduledMoves;
-		code->next = nullptr;
-
-		// Append it to the list of queued codes
-		if (queuedItems == nullptr)
+		// Store the new code in the arena
+		for (unsigned int i = 0; i < 4; ++i)
 		{
-			queuedItems = code;
+			PutByte((uint8_t)(scheduledMoves >> (8 * i)));
 		}
-		else
+		PutByte((uint8_t)(int8_t)gb.GetToolNumberAdjust());
+		PutByte((uint8_t)codeLength);
+		const char * const codeText = gb.Buffer();
+		for (size_t i = 0; i < codeLength; ++i)
 		{
-			QueuedCode *last = queuedItems;
-			while (last->Next() != nullptr)
-			{
-				last = last->Next();
-			}
-			last->next = code;
+			PutByte((uint8_t)codeText[i]);
+		}
+		++numQueuedCodes;
+		const size_t arenaUsed = CodeQueueArenaSize - SpaceLeft();
+		if (arenaUsed > maxArenaUsed)
+		{
+			maxArenaUsed = arenaUsed;
 		}
 
 		// Overwrite the passed gb's content if we could not store its original code
 		if (!queueCode)
 		{
-			if (reprap.Debug(moduleGcodes))
-			{
-				reprap.GetPlatform().Message(DebugMessage, "(swap) ");
-			}
+			DEBUG_OUTPUT(moduleGcodes, DebugLevel::verbose, "(swap) ");
 			gb.Put(codeToRun, codeToRunLength);
 		}
 	}
@@ -146,102 +196,91 @@ bool GCodeQueue::QueueCode(GCodeBuffer &gb, uint32_t segmentsLeft)
 bool GCodeQueue::FillBuffer(GCodeBuffer *gb)
 {
 	// Can this buffer be filled?
-	if (queuedItems == nullptr || queuedItems->executeAtMove > reprap.GetMove().GetCompletedMoves())
+	if (numQueuedCodes == 0 || GetMoveCount(head) > reprap.GetMove().GetCompletedMoves())
 	{
 		// No - stop here
 		return false;
 	}
 
-	// Yes - load it into the passed GCodeBuffer instance
-	QueuedCode *code = queuedItems;
-	code->AssignTo(gb);
+	// Yes - load the oldest queued code into the passed GCodeBuffer instance
+	size_t pos = (head + 4) % CodeQueueArenaSize;			// skip the move count
+	const int8_t toolNumberAdjust = (int8_t)GetByte(pos);
+	const size_t codeLength = GetByte(pos);
+	char codeText[GCODE_LENGTH];
+	for (size_t i = 0; i < codeLength; ++i)
+	{
+		codeText[i] = (char)GetByte(pos);
+	}
+
+	gb->SetToolNumberAdjust(toolNumberAdjust);
+	gb->Put(codeText, codeLength);
 
-	// Release this item again
-	queuedItems = queuedItems->next;
-	code->next = freeItems;
-	freeItems = code;
+	// Release this entry again
+	ReleaseOldestEntry();
 	return true;
 }
 
 // Return true if there is nothing to do
 bool GCodeQueue::IsIdle() const
 {
-	return queuedItems == nullptr || queuedItems->executeAtMove > reprap.GetMove().GetCompletedMoves();
+	return numQueuedCodes == 0 || GetMoveCount(head) > reprap.GetMove().GetCompletedMoves();
 }
 
 // Because some moves may end before the print is actually paused, we need a method to
-// remove all the entries that will not be executed after the print has finally paused
+// remove all the entries that will not be executed after the print has finally paused.
+// The move counts of the queued entries are non-decreasing from the head of the queue to the tail, because each one
+// was taken from the scheduled move count when it was queued, so we can truncate the queue at the first entry that
+// is due after the moves that will still be executed.
 void GCodeQueue::PurgeEntries()
 {
-	QueuedCode *item = queuedItems, *lastItem = nullptr;
-	while (item != nullptr)
+	const uint32_t scheduledMoves = reprap.GetMove().GetScheduledMoves();
+	size_t pos = head;
+	size_t entriesKept = 0;
+	while (entriesKept < numQueuedCodes && GetMoveCount(pos) <= scheduledMoves)
 	{
-		if (item->executeAtMove > reprap.GetMove().GetScheduledMoves())
-		{
-			// Release this item
-			QueuedCode *nextItem = item->Next();
-			item->next = freeItems;
-			freeItems = item;
-
-			// Unlink it from the list
-			if (lastItem == nullptr)
-			{
-				queuedItems = nextItem;
-			}
-			else
-			{
-				lastItem->next = nextItem;
-			}
-			item = nextItem;
-		}
-		else
-		{
-			lastItem = item;
-			item = item->Next();
-		}
+		pos = (pos + GetEntrySize(pos)) % CodeQueueArenaSize;
+		++entriesKept;
 	}
+	tail = pos;
+	numQueuedCodes = entriesKept;
 }
 
 void GCodeQueue::Clear()
 {
-	while (queuedItems != nullptr)
-	{
-		QueuedCode * const item = queuedItems;
-		queuedItems = item->Next();
-		item->next = freeItems;
-		freeItems = item;
-	}
+	head = tail = 0;
+	numQueuedCodes = 0;
+}
+
+// Report the arena occupancy and its high-water mark, for capacity planning
+void GCodeQueue::MemoryReport(MessageType mtype)
+{
+	reprap.GetPlatform().MessageF(mtype, "Code queue arena: %u of %u bytes used (%u max), %u codes queued\n",
+			CodeQueueArenaSize - SpaceLeft(), CodeQueueArenaSize, maxArenaUsed, numQueuedCodes);
 }
 
 void GCodeQueue::Diagnostics(MessageType mtype)
 {
-	reprap.GetPlatform().MessageF(mtype, "Code queue is %s\n", (queuedItems == nullptr) ? "empty." : "not empty:");
-	if (queuedItems != nullptr)
+	reprap.GetPlatform().MessageF(mtype, "Code queue is %s\n", (numQueuedCodes == 0) ? "empty." : "not empty:");
+	if (numQueuedCodes != 0)
 	{
-		const QueuedCode *item = queuedItems;
-		size_t queueLength = 0;
-		do
+		size_t pos = head;
+		for (size_t i = 0; i < numQueuedCodes; ++i)
 		{
-			queueLength++;
-			reprap.GetPlatform().MessageF(mtype, "Queued '%s' for move %" PRIu32 "\n", item->code, item->executeAtMove);
-		} while ((item = item->Next()) != nullptr);
-		reprap.GetPlatform().MessageF(mtype, "%d of %d codes have been queued.\n", queueLength, maxQueuedCodes);
+			const uint32_t moveCount = GetMoveCount(pos);
+			size_t textPos = (pos + QueuedCodeHeaderSize - 1) % CodeQueueArenaSize;
+			const size_t codeLength = GetByte(textPos);
+			char codeText[GCODE_LENGTH];
+			for (size_t j = 0; j < codeLength; ++j)
+			{
+				codeText[j] = (char)GetByte(textPos);
+			}
+			codeText[codeLength] = 0;
+			reprap.GetPlatform().MessageF(mtype, "Queued '%s' for move %" PRIu32 "\n", codeText, moveCount);
+			pos = (pos + GetEntrySize(pos)) % CodeQueueArenaSize;
+		}
+		reprap.GetPlatform().MessageF(mtype, "%u codes queued, using %u of %u arena bytes.\n",
+										numQueuedCodes, CodeQueueArenaSize - 1 - SpaceLeft(), CodeQueueArenaSize);
 	}
 }
 
-// QueuedCode class
-
-void QueuedCode::AssignFrom(GCodeBuffer &gb)
-{
-	toolNumberAdjust = gb.GetToolNumberAdjust();
-	SafeStrncpy(code, gb.Buffer(), ARRAY_SIZE(code));
-}
-
-void QueuedCode::AssignTo(GCodeBuffer *gb)
-{
-	gb->SetToolNumberAdjust(toolNumberAdjust);
-	gb->Put(code);
-}
-
 // End
-
@@ -10,9 +10,14 @@
 #include "RepRapFirmware.h"
 #include "GCodeBuffer.h"
 
-const size_t maxQueuedCodes = 8;				// How many codes can be queued?
-
-class QueuedCode;
+// Queued codes are stored end-to-end in a byte arena, so the number we can hold depends on how long they are.
+// Typical queued codes such as fan speed changes are around a dozen bytes, so even the smaller arena holds
+// far more of them than the old scheme of a few fixed-size slots did.
+#if SAM4E || SAM4S || SAME70
+const size_t CodeQueueArenaSize = 2048;			// How many bytes of queued codes can we hold?
+#else
+const size_t CodeQueueArenaSize = 1024;			// We are more memory-constrained on the SAM3X
+#endif
 
 class GCodeQueue
 {
@@ -26,29 +31,25 @@ class GCodeQueue
 		bool IsIdle() const;										// Return true if there is nothing to do
 
 		void Diagnostics(MessageType mtype);
+		void MemoryReport(MessageType mtype);						// Report the arena occupancy and its high-water mark
 
 	private:
-		QueuedCode *freeItems;
-		QueuedCode *queuedItems;
-};
-
-class QueuedCode
-{
-	public:
-		friend class GCodeQueue;
-
-		QueuedCode(QueuedCode *n) : next(n) { }
-		QueuedCode *Next() const { return next; }
-
-	private:
-		QueuedCode *next;
-
-		char code[GCODE_LENGTH];
-		uint32_t executeAtMove;
-		int toolNumberAdjust;
-
-		void AssignFrom(GCodeBuffer &gb);
-		void AssignTo(GCodeBuffer *gb);
+		// Each entry in the arena comprises a 4-byte move count, a 1-byte tool number adjust, a 1-byte code length
+		// and then the code itself without a null terminator. Entries wrap round the end of the arena byte-wise.
+		static const size_t QueuedCodeHeaderSize = 6;
+
+		void PutByte(uint8_t b);									// Append a byte to the arena
+		uint8_t GetByte(size_t& pos) const;							// Fetch the byte at pos and advance pos with wraparound
+		uint32_t GetMoveCount(size_t pos) const;					// Fetch the move count of the entry starting at pos
+		size_t GetEntrySize(size_t pos) const;						// Fetch the total size of the entry starting at pos
+		size_t SpaceLeft() const;									// How many bytes of the arena are free?
+		void ReleaseOldestEntry();									// Remove the entry at the head of the queue
+
+		size_t head;												// index of the oldest queued entry
+		size_t tail;												// index at which the next entry will be stored
+		size_t numQueuedCodes;										// how many entries are queued
+		size_t maxArenaUsed;										// the most arena bytes that have been in use at any one time
+		uint8_t arena[CodeQueueArenaSize];							// the stored entries
 };
 
 #endif
@@ -27,6 +27,7 @@
 
 #include "GCodeBuffer.h"
 #include "GCodeQueue.h"
+#include "JobQueue.h"
 #include "Heating/Heat.h"
 #include "Heating/HeaterProtection.h"
 #include "Platform.h"
@@ -42,12 +43,23 @@
 
 const size_t gcodeReplyLength = 2048;			// long enough to pass back a reasonable number of files in response to M20
 
+// Parameters used for continuous-motion grid scanning (G29 S3)
+const float GridScanCalibrationDelta = 0.5;		// how far above the probe trigger height we scan the bed (mm)
+const uint32_t GridScanSettleMillis = 50;		// how long we wait for the Z probe averaging filter to settle before taking a static reading
+const uint32_t MaxConfigFileSpinMillis = 2;		// how long we keep executing config.g codes per Spin() call during startup
+const int32_t GridScanMinReadingChange = 10;	// minimum reading change over the calibration delta for scanning to be considered viable
+
+#if HAS_VOLTAGE_MONITOR
+const uint32_t ResumeFilePrefixRefreshMillis = 20000;	// how often we refresh the prefix-only resume file while printing with auto save enabled
+#endif
+
 GCodes::GCodes(Platform& p) :
 	platform(p), machineType(MachineType::fff), active(false),
 #if HAS_VOLTAGE_MONITOR
 	powerFailScript(nullptr),
 #endif
-	isFlashing(false), fileBeingHashed(nullptr), lastWarningMillis(0)
+	isFlashing(false), fileBeingHashed(nullptr), firmwareBeingVerified(nullptr), lastWarningMillis(0), numNamedParameters(0),
+	machinePositionValid(false), lastPositionChangeCount(0), heightMapSaveFile(nullptr)
 {
 	httpInput = new RegularGCodeInput;
 	telnetInput = new RegularGCodeInput;
@@ -64,6 +76,8 @@ GCodes::GCodes(Platform& p) :
 	queuedGCode = new GCodeBuffer("queue", GenericMessage, false);
 	autoPauseGCode = new GCodeBuffer("autopause", GenericMessage, false);
 	codeQueue = new GCodeQueue();
+	jobQueue = new JobQueue();
+	startNextJobPending = nextJobMacroRunning = false;
 }
 
 void GCodes::Exit()
@@ -95,6 +109,8 @@ void GCodes::Init()
 	runningConfigFile = false;
 	doingToolChange = false;
 	active = true;
+	heightMapSaveFile = nullptr;
+	printCheckpointInterval = 0;
 	fileSize = 0;
 	longWait = millis();
 	limitAxes = true;
@@ -104,6 +120,10 @@ void GCodes::Init()
 		pausedFanSpeeds[i] = 0.0;
 	}
 	lastDefaultFanSpeed = pausedDefaultFanSpeed = 0.0;
+	moveFanChangeMask = 0;
+	moveNewFanSpeed = 0.0;
+	moveBuffer.fanChangeMask = 0;
+	moveBuffer.newFanSpeed = 0.0;
 
 	retractLength = DefaultRetractLength;
 	retractExtra = 0.0;
@@ -111,6 +131,8 @@ void GCodes::Init()
 	retractSpeed = unRetractSpeed = DefaultRetractSpeed * SecondsToMinutes;
 	isRetracted = false;
 	lastAuxStatusReportType = -1;						// no status reports requested yet
+	auxBinaryStatusMode = false;						// status reports default to JSON until the panel negotiates otherwise
+	auxBinarySentSeq = 0;
 
 	spindleMaxRpm = DefaultMaxSpindleRpm;
 	laserMaxPower = DefaultMaxLaserPower;
@@ -143,6 +165,8 @@ void GCodes::Reset()
 
 	fileToPrint.Close();
 	fileBeingWritten = nullptr;
+	startNextJobPending = nextJobMacroRunning = false;
+	jobQueue->Clear();									// after an emergency stop, queued jobs must not chain onto the next print
 	speedFactor = SecondsToMinutes;						// default is just to convert from mm/minute to mm/second
 
 	for (size_t i = 0; i < MaxExtruders; ++i)
@@ -189,17 +213,26 @@ void GCodes::Reset()
 	isPaused = false;
 #if HAS_VOLTAGE_MONITOR
 	isPowerFailPaused = false;
+	resumeFileIsPrefixOnly = false;
+	whenResumeFilePrefixWritten = 0;
 #endif
 	doingToolChange = false;
 	doingManualBedProbe = false;
+	AbandonStreamedHeightMapSave();				// in case we were resetting part way through a grid probe
+	tapsDone = 0;
+	machinePositionValid = false;
 	pausePending = false;
+	frozenPauseActive = false;
+	lastCheckpointFilePos = 0;
 	probeIsDeployed = false;
 	moveBuffer.filePos = noFilePosition;
 	lastEndstopStates = platform.GetAllEndstopStates();
 	firmwareUpdateModuleMap = 0;
 	lastFilamentError = FilamentSensorStatus::ok;
+	batchProbeCount = batchProbeNext = 0;
 
 	codeQueue->Clear();
+	moveFanChangeMask = 0;						// discard any fan speed change still waiting for a move
 	cancelWait = isWaiting = displayNoToolWarning = displayDeltaNotHomedWarning = false;
 
 	for (size_t i = 0; i < NumResources; ++i)
@@ -271,6 +304,24 @@ void GCodes::Spin()
 	CheckTriggers();
 	CheckHeaterFault();
 	CheckFilament();
+	CheckJobQueue();
+	CheckPrintCheckpoint();
+#if HAS_VOLTAGE_MONITOR
+	RefreshResumeFilePrefix();
+#endif
+
+	// If a fan speed change is waiting for a move that never came and motion has drained, apply it now
+	if (moveFanChangeMask != 0 && segmentsLeft == 0 && reprap.GetMove().GetScheduledMoves() == reprap.GetMove().GetCompletedMoves())
+	{
+		for (size_t fan = 0; fan < NUM_FANS; ++fan)
+		{
+			if ((moveFanChangeMask & (1u << fan)) != 0)
+			{
+				platform.SetFanValue(fan, moveNewFanSpeed);
+			}
+		}
+		moveFanChangeMask = 0;
+	}
 
 	// Get the GCodeBuffer that we want to process a command from. Give priority to auto-pause.
 	GCodeBuffer *gbp = autoPauseGCode;
@@ -316,9 +367,41 @@ void GCodes::Spin()
 	}
 	else
 	{
+		if (&gb == fileGCode && gb.MachineState().fileState.IsLive())
+		{
+			// The file code is parked in the state machine, typically waiting for heating (M109) or for a tool change.
+			// Keep the read-ahead buffer topped up meanwhile, so that when the wait ends the following codes are parsed
+			// from RAM and the movement queue fills to full lookahead depth without waiting on SD reads.
+			(void)fileInput->ReadFromFile(gb.MachineState().fileState);
+		}
 		RunStateMachine(gb, reply);			// Execute the state machine
 	}
 
+	// While config.g is being run at startup, executing just one code per call would make the boot time depend
+	// mostly on how often we get called. Nothing else is going on yet, so keep feeding codes to the config
+	// channel for a couple of milliseconds before returning. This gets long configuration files executed and
+	// the network up several times sooner, while still letting the other modules spin between our calls.
+	if (runningConfigFile && gbp == daemonGCode)
+	{
+		const uint32_t configSpinStartTime = millis();
+		while (runningConfigFile && millis() - configSpinStartTime < MaxConfigFileSpinMillis)
+		{
+			reply.Clear();
+			if (gb.GetState() == GCodeState::normal)
+			{
+				if (gb.MachineState().messageAcknowledged)
+				{
+					break;					// let the normal path above deal with message boxes
+				}
+				StartNextGCode(gb, reply);
+			}
+			else
+			{
+				RunStateMachine(gb, reply);
+			}
+		}
+	}
+
 	// Check if we need to display a warning
 	const uint32_t now = millis();
 	if (now - lastWarningMillis >= MinimumWarningInterval)
@@ -601,6 +684,13 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 			{
 				platform.SetFanValue(i, pausedFanSpeeds[i]);
 			}
+			if (frozenPauseActive)
+			{
+				// Re-arm the moves that were frozen in place when we paused. The file replay set up below starts from
+				// the first move that was not frozen, so the restores that follow are correct for both kinds of pause.
+				reprap.GetMove().ThawPrint();
+				frozenPauseActive = false;
+			}
 			virtualExtruderPosition = pauseRestorePoint.virtualExtruderPosition;	// reset the extruder position in case we are receiving absolute extruder moves
 			moveBuffer.virtualExtruderPosition = pauseRestorePoint.virtualExtruderPosition;
 			fileGCode->MachineState().feedrate = pauseRestorePoint.feedRate;
@@ -701,6 +791,7 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 					moveBuffer.yAxes = DefaultYAxisMapping;
 					totalSegments = 1;
 					segmentsLeft = 1;
+					tapsDone = 0;
 					gb.AdvanceState();
 				}
 				else
@@ -740,6 +831,7 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 			else if (reprap.GetPlatform().GetZProbeResult() == EndStopHit::lowHit)
 			{
 				platform.Message(ErrorMessage, "Z probe already triggered before probing move started");
+				AbandonStreamedHeightMapSave();
 				gb.SetState(GCodeState::normal);
 				if (platform.GetZProbeType() != 0 && !probeIsDeployed)
 				{
@@ -783,6 +875,7 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 				if (!zProbeTriggered)
 				{
 					platform.Message(ErrorMessage, "Z probe was not triggered during probing move\n");
+					AbandonStreamedHeightMapSave();
 					gb.SetState(GCodeState::normal);
 					if (platform.GetZProbeType() != 0 && !probeIsDeployed)
 					{
@@ -792,6 +885,30 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 				}
 
 				heightError = moveBuffer.coords[Z_AXIS] - platform.ZProbeStopHeight();
+
+				// If multi-tap probing is configured, probe again from a short lift instead of making another full approach
+				tapHeights[tapsDone] = heightError;
+				++tapsDone;
+				if (tapsDone < platform.GetCurrentZProbeParameters().probeTaps && tapsDone < MaxProbeTaps)
+				{
+					moveBuffer.moveType = 0;
+					moveBuffer.isCoordinated = false;
+					moveBuffer.endStopsToCheck = 0;
+					moveBuffer.usePressureAdvance = false;
+					moveBuffer.filePos = noFilePosition;
+					moveBuffer.coords[Z_AXIS] += ProbeTapLift;
+					moveBuffer.feedRate = platform.GetZProbeTravelSpeed();
+					moveBuffer.xAxes = DefaultXAxisMapping;
+					moveBuffer.yAxes = DefaultYAxisMapping;
+					totalSegments = 1;
+					segmentsLeft = 1;
+					gb.SetState(GCodeState::gridProbing2);			// wait for standstill, restart the recovery timer, then probe again
+					break;
+				}
+				if (tapsDone > 1)
+				{
+					heightError = ConsolidateTapHeights(platform.GetCurrentZProbeParameters().tapTolerance);
+				}
 			}
 			reprap.GetMove().AccessHeightMap().SetGridHeight(gridXindex, gridYindex, heightError);
 
@@ -839,6 +956,7 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 					++gridXindex;
 				}
 			}
+			ContinueStreamedHeightMapSave(gridYindex);		// rows the probe has passed are final, so they can be written while we probe the rest
 			if (gridYindex == grid.NumYpoints())
 			{
 				// Done all the points
@@ -862,13 +980,36 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 			const uint32_t numPointsProbed = reprap.GetMove().AccessHeightMap().GetStatistics(mean, deviation);
 			if (numPointsProbed >= 4)
 			{
+				if (heightMapSaveFile != nullptr)
+				{
+					// We have been streaming rows to the file while probing, so only the header statistics remain to be written
+					if (!heightMapSaveError)
+					{
+						heightMapSaveError = reprap.GetMove().AccessHeightMap().FinishStreamedSave(heightMapSaveFile);
+					}
+					reply.printf("%" PRIu32 " points probed, mean error %.3f, deviation %.3f\n", numPointsProbed, (double)mean, (double)deviation);
+					error = FinishHeightMapSave(reply);
+					reprap.GetMove().AccessHeightMap().ExtrapolateMissing();
+					reprap.GetMove().UseMesh(true);
+					gb.SetState(GCodeState::normal);
+					break;
+				}
+
+				// We could not stream the map while probing, so save it as a background task now
+				if (StartHeightMapSave(gb))
+				{
+					gb.SetState(GCodeState::gridProbing7);
+					break;
+				}
 				reply.printf("%" PRIu32 " points probed, mean error %.3f, deviation %.3f\n", numPointsProbed, (double)mean, (double)deviation);
-				error = SaveHeightMap(gb, reply);
+				reply.catf("Failed to create height map file %s", heightMapSaveFileName);
+				error = true;
 				reprap.GetMove().AccessHeightMap().ExtrapolateMissing();
 				reprap.GetMove().UseMesh(true);
 			}
 			else
 			{
+				AbandonStreamedHeightMapSave();
 				reply.copy("Too few points probed");
 				error = true;
 			}
@@ -876,6 +1017,289 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 		gb.SetState(GCodeState::normal);
 		break;
 
+	case GCodeState::gridProbing7:
+		// Waiting for the background height map save to finish
+		if (!reprap.IsBackgroundTaskRunning())
+		{
+			float mean, deviation;
+			const uint32_t numPointsProbed = reprap.GetMove().AccessHeightMap().GetStatistics(mean, deviation);
+			reply.printf("%" PRIu32 " points probed, mean error %.3f, deviation %.3f\n", numPointsProbed, (double)mean, (double)deviation);
+			error = FinishHeightMapSave(reply);
+			reprap.GetMove().AccessHeightMap().ExtrapolateMissing();
+			reprap.GetMove().UseMesh(true);
+			gb.SetState(GCodeState::normal);
+		}
+		break;
+
+	// States used for continuous-motion grid scanning with an analog Z probe (G29 S3)
+	case GCodeState::gridScanning1:	// ready to move to the calibration point
+		{
+			Move& move = reprap.GetMove();
+			const GridDefinition& grid = move.AccessHeightMap().GetGrid();
+
+			// Find the first grid point that the probe can reach, and use it to calibrate the probe readings
+			bool found = false;
+			while (gridYindex < grid.NumYpoints() && !found)
+			{
+				while (gridXindex < grid.NumXpoints())
+				{
+					const float x = grid.GetXCoordinate(gridXindex);
+					const float y = grid.GetYCoordinate(gridYindex);
+					if (grid.IsInRadius(x, y) && move.IsAccessibleProbePoint(x, y))
+					{
+						found = true;
+						break;
+					}
+					++gridXindex;
+				}
+				if (!found)
+				{
+					gridXindex = 0;
+					++gridYindex;
+				}
+			}
+			if (!found)
+			{
+				platform.Message(ErrorMessage, "No grid points are reachable by the Z probe\n");
+				gb.SetState(GCodeState::normal);
+				if (!probeIsDeployed)
+				{
+					DoFileMacro(gb, RETRACTPROBE_G, false);
+				}
+				break;
+			}
+
+			moveBuffer.moveType = 0;
+			moveBuffer.isCoordinated = false;
+			moveBuffer.endStopsToCheck = 0;
+			moveBuffer.usePressureAdvance = false;
+			moveBuffer.filePos = noFilePosition;
+			moveBuffer.coords[X_AXIS] = grid.GetXCoordinate(gridXindex) - platform.GetCurrentZProbeParameters().xOffset;
+			moveBuffer.coords[Y_AXIS] = grid.GetYCoordinate(gridYindex) - platform.GetCurrentZProbeParameters().yOffset;
+			moveBuffer.coords[Z_AXIS] = platform.GetZProbeStartingHeight();
+			moveBuffer.feedRate = platform.GetZProbeTravelSpeed();
+			moveBuffer.xAxes = DefaultXAxisMapping;
+			moveBuffer.yAxes = DefaultYAxisMapping;
+			totalSegments = 1;
+			segmentsLeft = 1;
+			gb.AdvanceState();
+		}
+		break;
+
+	case GCodeState::gridScanning2:	// moving to the calibration point
+		if (LockMovementAndWaitForStandstill(gb))
+		{
+			lastProbedTime = millis();
+			gb.AdvanceState();
+		}
+		break;
+
+	case GCodeState::gridScanning3:	// ready to probe the calibration point conventionally
+		if (millis() - lastProbedTime >= (uint32_t)(platform.GetCurrentZProbeParameters().recoveryTime * SecondsToMillis))
+		{
+			if (platform.GetZProbeResult() == EndStopHit::lowHit)
+			{
+				platform.Message(ErrorMessage, "Z probe already triggered before probing move started\n");
+				AbandonStreamedHeightMapSave();
+				gb.SetState(GCodeState::normal);
+				if (!probeIsDeployed)
+				{
+					DoFileMacro(gb, RETRACTPROBE_G, false);
+				}
+				break;
+			}
+			zProbeTriggered = false;
+			platform.SetProbing(true);
+			moveBuffer.moveType = 0;
+			moveBuffer.isCoordinated = false;
+			moveBuffer.endStopsToCheck = ZProbeActive;
+			moveBuffer.usePressureAdvance = false;
+			moveBuffer.filePos = noFilePosition;
+			moveBuffer.coords[Z_AXIS] = -platform.GetZProbeDiveHeight();
+			moveBuffer.feedRate = platform.GetCurrentZProbeParameters().probeSpeed;
+			moveBuffer.xAxes = DefaultXAxisMapping;
+			moveBuffer.yAxes = DefaultYAxisMapping;
+			totalSegments = 1;
+			segmentsLeft = 1;
+			gb.AdvanceState();
+		}
+		break;
+
+	case GCodeState::gridScanning4:	// ready to record the calibration point height
+		if (LockMovementAndWaitForStandstill(gb))
+		{
+			platform.SetProbing(false);
+			if (!zProbeTriggered)
+			{
+				platform.Message(ErrorMessage, "Z probe was not triggered during probing move\n");
+				AbandonStreamedHeightMapSave();
+				gb.SetState(GCodeState::normal);
+				if (!probeIsDeployed)
+				{
+					DoFileMacro(gb, RETRACTPROBE_G, false);
+				}
+				break;
+			}
+			scanReferenceHeightError = moveBuffer.coords[Z_AXIS] - platform.ZProbeStopHeight();
+			reprap.GetMove().AccessHeightMap().SetGridHeight(gridXindex, gridYindex, scanReferenceHeightError);
+			lastProbedTime = millis();							// wait at the trigger height for the probe averaging filter to settle
+			gb.AdvanceState();
+		}
+		break;
+
+	case GCodeState::gridScanning5:	// waiting at the trigger height, then rising to the scanning height
+		if (millis() - lastProbedTime >= GridScanSettleMillis)
+		{
+			scanCalibrationReading = platform.GetZProbeReading();
+			moveBuffer.moveType = 0;
+			moveBuffer.isCoordinated = false;
+			moveBuffer.endStopsToCheck = 0;
+			moveBuffer.usePressureAdvance = false;
+			moveBuffer.filePos = noFilePosition;
+			moveBuffer.coords[Z_AXIS] += GridScanCalibrationDelta;
+			moveBuffer.feedRate = platform.GetCurrentZProbeParameters().probeSpeed;
+			moveBuffer.xAxes = DefaultXAxisMapping;
+			moveBuffer.yAxes = DefaultYAxisMapping;
+			totalSegments = 1;
+			segmentsLeft = 1;
+			gb.AdvanceState();
+		}
+		break;
+
+	case GCodeState::gridScanning6:	// moving up to the scanning height
+		if (LockMovementAndWaitForStandstill(gb))
+		{
+			lastProbedTime = millis();
+			gb.AdvanceState();
+		}
+		break;
+
+	case GCodeState::gridScanning7:	// ready to compute the probe sensitivity and start the first row
+		if (millis() - lastProbedTime >= GridScanSettleMillis)
+		{
+			scanReferenceReading = platform.GetZProbeReading();
+			if (abs(scanCalibrationReading - scanReferenceReading) < GridScanMinReadingChange)
+			{
+				platform.Message(ErrorMessage, "Z probe reading does not vary with height, cannot scan\n");
+				AbandonStreamedHeightMapSave();
+				gb.SetState(GCodeState::normal);
+				if (!probeIsDeployed)
+				{
+					DoFileMacro(gb, RETRACTPROBE_G, false);
+				}
+				break;
+			}
+			scanSensitivity = (float)(scanCalibrationReading - scanReferenceReading)/GridScanCalibrationDelta;
+			gridYindex = 0;
+			if (StartScanRow(gb))
+			{
+				gb.AdvanceState();
+			}
+			else
+			{
+				gb.SetState(GCodeState::gridProbing6);			// shouldn't happen, we already found a reachable point
+				if (!probeIsDeployed)
+				{
+					DoFileMacro(gb, RETRACTPROBE_G, false);
+				}
+			}
+		}
+		break;
+
+	case GCodeState::gridScanning8:	// moving to the start of a row
+		if (LockMovementAndWaitForStandstill(gb))
+		{
+			RecordScanPoint();										// we are stationary over the first point of the row
+			--scanRowPointsLeft;
+			if (scanRowPointsLeft == 0)
+			{
+				++gridYindex;
+				ContinueStreamedHeightMapSave(gridYindex);	// rows the probe has passed are final, so they can be written while we scan the rest
+				if (!StartScanRow(gb))
+				{
+					gb.SetState(GCodeState::gridProbing6);
+					if (!probeIsDeployed)
+					{
+						DoFileMacro(gb, RETRACTPROBE_G, false);
+					}
+				}
+			}
+			else
+			{
+				// Command a single move to the far end of the row, segmented at the grid spacing so that the live
+				// coordinates are updated as we pass each grid point
+				const GridDefinition& grid = reprap.GetMove().AccessHeightMap().GetGrid();
+				const size_t numIntervals = scanRowPointsLeft;
+				gridXindex = (scanRowIncreasing) ? gridXindex + 1 : gridXindex - 1;
+				moveBuffer.moveType = 0;
+				moveBuffer.isCoordinated = false;
+				moveBuffer.endStopsToCheck = 0;
+				moveBuffer.usePressureAdvance = false;
+				moveBuffer.filePos = noFilePosition;
+				moveBuffer.coords[X_AXIS] = grid.GetXCoordinate(scanRowEndIndex) - platform.GetCurrentZProbeParameters().xOffset;
+				moveBuffer.feedRate = platform.GetZProbeTravelSpeed();
+				moveBuffer.xAxes = DefaultXAxisMapping;
+				moveBuffer.yAxes = DefaultYAxisMapping;
+				totalSegments = numIntervals;
+				segmentsLeft = numIntervals;
+				gb.SetState(GCodeState::gridScanning9);
+			}
+		}
+		break;
+
+	case GCodeState::gridScanning9:	// scanning along a row, sampling the probe on the fly
+		{
+			const GridDefinition& grid = reprap.GetMove().AccessHeightMap().GetGrid();
+			float currentPosition[DRIVES];
+			reprap.GetMove().LiveCoordinates(currentPosition, reprap.GetCurrentXAxes(), reprap.GetCurrentYAxes());
+			const float probeX = currentPosition[X_AXIS] + platform.GetCurrentZProbeParameters().xOffset;
+			while (scanRowPointsLeft != 0)
+			{
+				const float pointX = grid.GetXCoordinate(gridXindex);
+				if ((scanRowIncreasing) ? probeX < pointX : probeX > pointX)
+				{
+					break;											// we haven't passed the next grid point yet
+				}
+				RecordScanPoint();
+				--scanRowPointsLeft;
+				if (scanRowPointsLeft != 0)
+				{
+					gridXindex = (scanRowIncreasing) ? gridXindex + 1 : gridXindex - 1;
+				}
+			}
+			if (scanRowPointsLeft == 0)
+			{
+				++gridYindex;
+				ContinueStreamedHeightMapSave(gridYindex);	// rows the probe has passed are final, so they can be written while we scan the rest
+				if (StartScanRow(gb))
+				{
+					gb.SetState(GCodeState::gridScanning8);
+				}
+				else
+				{
+					gb.SetState(GCodeState::gridProbing6);
+					if (!probeIsDeployed)
+					{
+						DoFileMacro(gb, RETRACTPROBE_G, false);
+					}
+				}
+			}
+			else if (LockMovementAndWaitForStandstill(gb))
+			{
+				// The row move has finished but rounding stopped us recognising the last point(s) as passed, so record them from here
+				while (scanRowPointsLeft != 0)
+				{
+					RecordScanPoint();
+					--scanRowPointsLeft;
+					if (scanRowPointsLeft != 0)
+					{
+						gridXindex = (scanRowIncreasing) ? gridXindex + 1 : gridXindex - 1;
+					}
+				}
+			}
+		}
+		break;
+
 	// States used for G30 probing
 	case GCodeState::probingAtPoint0:
 		// Initial state when executing G30 with a P parameter. Start by moving to the dive height at the current position.
@@ -1008,6 +1432,31 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 					reprap.GetMove().GetCurrentMachinePosition(m, false);		// get height without bed compensation
 					g30zStoppedHeight = m[Z_AXIS] - heightAdjust;				// save for later
 					g30zHeightError = g30zStoppedHeight - platform.ZProbeStopHeight();
+
+					// If multi-tap probing is configured, probe again from a short lift instead of making another full approach
+					tapHeights[tapsDone] = g30zHeightError;
+					++tapsDone;
+					if (tapsDone < platform.GetCurrentZProbeParameters().probeTaps && tapsDone < MaxProbeTaps)
+					{
+						moveBuffer.moveType = 0;
+						moveBuffer.isCoordinated = false;
+						moveBuffer.endStopsToCheck = 0;
+						moveBuffer.usePressureAdvance = false;
+						moveBuffer.filePos = noFilePosition;
+						moveBuffer.coords[Z_AXIS] += ProbeTapLift;
+						moveBuffer.feedRate = platform.GetZProbeTravelSpeed();
+						moveBuffer.xAxes = DefaultXAxisMapping;
+						moveBuffer.yAxes = DefaultYAxisMapping;
+						totalSegments = 1;
+						segmentsLeft = 1;
+						gb.SetState(GCodeState::probingAtPoint2);	// wait for standstill, restart the recovery timer, then probe again
+						break;
+					}
+					if (tapsDone > 1)
+					{
+						g30zHeightError = ConsolidateTapHeights(platform.GetCurrentZProbeParameters().tapTolerance);
+						g30zStoppedHeight = g30zHeightError + platform.ZProbeStopHeight();
+					}
 				}
 			}
 
@@ -1072,10 +1521,21 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 		// Here when we were probing at a numbered point and we have moved the head back up to the dive height
 		if (LockMovementAndWaitForStandstill(gb))
 		{
-			gb.AdvanceState();
-			if (platform.GetZProbeType() != 0 && !probeIsDeployed)
+			if (batchProbeNext < batchProbeCount)
 			{
-				DoFileMacro(gb, RETRACTPROBE_G, false);
+				// More points remain in the batch, so keep the probe deployed and head straight for the next one
+				g30ProbePointIndex = batchProbeOrder[batchProbeNext];
+				++batchProbeNext;
+				tapsDone = 0;
+				gb.SetState(GCodeState::probingAtPoint1);
+			}
+			else
+			{
+				gb.AdvanceState();
+				if (platform.GetZProbeType() != 0 && !probeIsDeployed)
+				{
+					DoFileMacro(gb, RETRACTPROBE_G, false);
+				}
 			}
 		}
 		break;
@@ -1222,7 +1682,7 @@ void GCodes::RunStateMachine(GCodeBuffer& gb, StringRef& reply)
 		}
 		else
 		{
-			SaveResumeInfo(true);											// create the resume file so that we can resume after power down
+			// The resume file was saved before the pause script was run
 			platform.Message(LoggedGenericMessage, "Print auto-paused due to low voltage\n");
 			gb.SetState(GCodeState::normal);
 		}
@@ -1255,6 +1715,13 @@ void GCodes::StartNextGCode(GCodeBuffer& gb, StringRef& reply)
 	}
 	else if (gb.IsReady() || gb.IsExecuting())
 	{
+		if (&gb == fileGCode && gb.MachineState().fileState.IsLive())
+		{
+			// While a code from the file is executing - typically a move waiting for room in the movement queue -
+			// keep the file read-ahead buffer topped up, so that the following codes are already in RAM when this
+			// one completes instead of having to be fetched from the SD card on the critical path.
+			(void)fileInput->ReadFromFile(gb.MachineState().fileState);
+		}
 		gb.SetFinished(ActOnCode(gb, reply));
 	}
 	else if (gb.MachineState().fileState.IsLive())
@@ -1446,6 +1913,93 @@ void GCodes::CheckFilament()
 	}
 }
 
+// If the last job finished normally and there is another one in the job queue, start it. The setup macro of the
+// queued job (if any) is run via the daemon channel first, then the file is selected and started. This is called
+// from Spin, so each phase waits for the previous one to finish.
+void GCodes::CheckJobQueue()
+{
+	if (!startNextJobPending)
+	{
+		return;
+	}
+
+	if (jobQueue->IsEmpty())
+	{
+		startNextJobPending = nextJobMacroRunning = false;
+		return;
+	}
+
+	if (reprap.GetPrintMonitor().IsPrinting() || IsDaemonBusy() || daemonGCode->GetState() != GCodeState::normal)
+	{
+		return;																// wait for the previous job or the setup macro to finish
+	}
+
+	if (!nextJobMacroRunning && jobQueue->GetNextMacroName() != nullptr)
+	{
+		nextJobMacroRunning = true;
+		DoFileMacro(*daemonGCode, jobQueue->GetNextMacroName(), true);		// run the setup macro, then come back here
+		return;
+	}
+
+	// The setup macro (if there was one) has completed, so start the print
+	String<FILENAME_LENGTH> filename;
+	filename.GetRef().copy(jobQueue->GetNextFileName());
+	jobQueue->RemoveNextJob();
+	startNextJobPending = nextJobMacroRunning = false;
+
+	String<FILENAME_LENGTH + 40> reply;
+	if (QueueFileToPrint(filename.c_str(), reply.GetRef()))
+	{
+		reprap.GetPrintMonitor().StartingPrint(filename.c_str());
+		StartPrinting();
+	}
+	else
+	{
+		platform.MessageF(ErrorMessage, "Cannot start queued job: %s\n", reply.c_str());
+	}
+}
+
+// If checkpointing has been enabled by M597 and the print has advanced far enough through the file since the last
+// checkpoint, save the resume file. This gives us a recent resume point even after an abrupt power loss that leaves
+// no time to write one, at the cost of an occasional SD card write during the print. The state saved is that of the
+// last command read from the file, so the moves still in the movement queue will be printed again on resume.
+void GCodes::CheckPrintCheckpoint()
+{
+	if (   printCheckpointInterval != 0
+		&& reprap.GetPrintMonitor().IsPrinting()
+		&& !isPaused
+		&& simulationMode == 0
+		&& !fileGCode->IsDoingFileMacro()
+	   )
+	{
+		const FilePosition pos = fileGCode->GetFilePosition(fileInput->BytesCached());
+		if (pos != noFilePosition)
+		{
+			if (pos < lastCheckpointFilePos)
+			{
+				lastCheckpointFilePos = 0;					// a new file is being printed
+			}
+			if (pos - lastCheckpointFilePos >= printCheckpointInterval)
+			{
+				RestorePoint rp;
+				for (size_t axis = 0; axis < numVisibleAxes; ++axis)
+				{
+					rp.moveCoords[axis] = currentUserPosition[axis];
+				}
+				rp.feedRate = fileGCode->MachineState().feedrate;
+				rp.virtualExtruderPosition = virtualExtruderPosition;
+				rp.filePos = pos;
+#if SUPPORT_IOBITS
+				rp.ioBits = moveBuffer.ioBits;
+#endif
+				rp.toolNumber = reprap.GetCurrentToolNumber();
+				SaveResumeInfo(rp, "checkpoint", false);
+				lastCheckpointFilePos = pos;
+			}
+		}
+	}
+}
+
 // Log a filament error. Called by Platform when a filament sensor reports an incorrect status and a print is in progress.
 void GCodes::FilamentError(size_t extruder, FilamentSensorStatus fstat)
 {
@@ -1456,6 +2010,21 @@ void GCodes::FilamentError(size_t extruder, FilamentSensorStatus fstat)
 	}
 }
 
+// Apply a closed-loop extrusion factor correction from a filament sensor. This uses the same mechanism as M221,
+// including adjusting any move we have not yet committed. Tiny changes are ignored to avoid churning the status sequence.
+void GCodes::TrimExtrusionFactor(size_t extruder, float extrusionFactor)
+{
+	if (extruder < numExtruders && extrusionFactor > 0.0 && fabsf(extrusionFactor - extrusionFactors[extruder]) >= 0.001)
+	{
+		if (segmentsLeft != 0 && !moveBuffer.isFirmwareRetraction)
+		{
+			moveBuffer.coords[extruder + numTotalAxes] *= extrusionFactor/extrusionFactors[extruder];	// last move not gone, so update it
+		}
+		extrusionFactors[extruder] = extrusionFactor;
+		reprap.RecordStateChange(ChangedField::extrusionFactor, extruder, extrusionFactor * 100.0);	// the extrusion factors are omitted from differential status responses
+	}
+}
+
 // Execute an emergency stop
 void GCodes::DoEmergencyStop()
 {
@@ -1475,9 +2044,17 @@ void GCodes::DoPause(GCodeBuffer& gb, PauseReason reason, const char *msg)
 	else
 	{
 		// Pausing a file print via another input source or for some other reason
-		const bool movesSkipped = reprap.GetMove().PausePrint(pauseRestorePoint);		// tell Move we wish to pause the current print
+		// First try to freeze the queued moves in place, so that the lookahead and preparation work already done on them is
+		// kept and they need not be replayed from the file; if that isn't possible, fall back to skipping them
+		frozenPauseActive = reprap.GetMove().FreezePrint(pauseRestorePoint);
+		const bool movesSkipped = !frozenPauseActive && reprap.GetMove().PausePrint(pauseRestorePoint);	// tell Move we wish to pause the current print
 
-		if (movesSkipped)
+		if (frozenPauseActive)
+		{
+			// The FreezePrint call has filled in the restore point with machine coordinates
+			ToolOffsetInverseTransform(pauseRestorePoint.moveCoords, currentUserPosition);	// transform the returned coordinates to user coordinates
+		}
+		else if (movesSkipped)
 		{
 			// The PausePrint call has filled in the restore point with machine coordinates
 			ToolOffsetInverseTransform(pauseRestorePoint.moveCoords, currentUserPosition);	// transform the returned coordinates to user coordinates
@@ -1512,6 +2089,32 @@ void GCodes::DoPause(GCodeBuffer& gb, PauseReason reason, const char *msg)
 			pauseRestorePoint.moveCoords[axis] = currentUserPosition[axis];
 		}
 
+		if (frozenPauseActive)
+		{
+			// The frozen moves do not survive a reset, so if we lose power while paused then the resurrected print must
+			// replay them from the file. Save the restore point that FreezePrint built for writing to the resume file.
+			frozenPauseRestorePoint = pauseRestorePoint;
+
+			// A live resume re-arms the frozen moves instead of replaying them, so the restore point used for resuming must
+			// describe the first move that is NOT frozen: either the partly-fed move still in our buffer, or the next
+			// command in the file
+			if (segmentsLeft != 0)
+			{
+				pauseRestorePoint.proportionDone = (float)(totalSegments - segmentsLeft)/(float)totalSegments;	// the segments already fed to Move are frozen in the queue
+				pauseRestorePoint.virtualExtruderPosition = moveBuffer.virtualExtruderPosition;
+				pauseRestorePoint.filePos = moveBuffer.filePos;
+				pauseRestorePoint.feedRate = moveBuffer.feedRate;
+				ClearMove();
+			}
+			else
+			{
+				pauseRestorePoint.proportionDone = 0.0;
+				pauseRestorePoint.feedRate = fileGCode->MachineState().feedrate;
+				pauseRestorePoint.virtualExtruderPosition = virtualExtruderPosition;
+				pauseRestorePoint.filePos = fileGCode->GetFilePosition(fileInput->BytesCached());
+			}
+		}
+
 		// If we skipped any moves, reset the file pointer to the start of the first move we need to replay
 		// The following could be delayed until we resume the print
 		FileData& fdata = fileGCode->MachineState().fileState;
@@ -1521,7 +2124,10 @@ void GCodes::DoPause(GCodeBuffer& gb, PauseReason reason, const char *msg)
 			fileInput->Reset();															// clear the buffered data
 		}
 
-		codeQueue->PurgeEntries();
+		if (!frozenPauseActive)
+		{
+			codeQueue->PurgeEntries();													// when frozen, the queued codes belong to the frozen moves and must be kept
+		}
 
 		if (reprap.Debug(moduleGcodes))
 		{
@@ -1530,11 +2136,13 @@ void GCodes::DoPause(GCodeBuffer& gb, PauseReason reason, const char *msg)
 	}
 
 	SaveFanSpeeds();
-	pauseRestorePoint.toolNumber = reprap.GetCurrentToolNumber();
+	pauseRestorePoint.toolNumber = frozenPauseRestorePoint.toolNumber = reprap.GetCurrentToolNumber();
 
 	if (simulationMode == 0)
 	{
-		SaveResumeInfo(false);															// create the resume file so that we can resume after power down
+		// Create the resume file so that we can resume after power down. If we froze the queue then the resume file must
+		// replay the frozen moves from the file, because they will not survive the reset.
+		SaveResumeInfo((frozenPauseActive) ? frozenPauseRestorePoint : pauseRestorePoint, "print paused", true);
 	}
 
 	gb.SetState(GCodeState::pausing1);
@@ -1698,6 +2306,9 @@ bool GCodes::LowVoltagePause()
 			return false;
 		}
 
+		// Save the restart record first, so that it is on the SD card even if the stored energy runs out while the power fail script is executing
+		SaveResumeInfoAfterPowerFail();
+
 		// Run the auto-pause script
 		if (powerFailScript != nullptr)
 		{
@@ -1774,7 +2385,7 @@ bool GCodes::ReHomeOnStall(DriversBitmap stalledDrivers)
 
 #endif
 
-void GCodes::SaveResumeInfo(bool wasPowerFailure)
+void GCodes::SaveResumeInfo(const RestorePoint& rp, const char *reason, bool logSuccess)
 {
 	const char* const printingFilename = reprap.GetPrintMonitor().GetPrintingFilename();
 	if (printingFilename != nullptr)
@@ -1786,105 +2397,184 @@ void GCodes::SaveResumeInfo(bool wasPowerFailure)
 		}
 		else
 		{
-			char bufferSpace[200];
-			StringRef buf(bufferSpace, ARRAY_SIZE(bufferSpace));
-
-			// Write the header comment
-			buf.printf("; File \"%s\" resume print after %s", printingFilename, (wasPowerFailure) ? "power failure" : "print paused");
-			if (reprap.GetPlatform().IsDateTimeSet())
-			{
-				time_t timeNow = reprap.GetPlatform().GetDateTime();
-				const struct tm * const timeInfo = gmtime(&timeNow);
-				buf.catf(" at %04u-%02u-%02u %02u:%02u",
-								timeInfo->tm_year + 1900, timeInfo->tm_mon + 1, timeInfo->tm_mday, timeInfo->tm_hour, timeInfo->tm_min);
-			}
-			buf.cat('\n');
-			bool ok = f->Write(buf.Pointer())
-					&& reprap.GetHeat().WriteBedAndChamberTempSettings(f)	// turn on bed and chamber heaters
-					&& reprap.WriteToolSettings(f)							// set tool temperatures, tool mix ratios etc.
-					&& reprap.GetMove().WriteResumeSettings(f);				// load grid, if we are using one
-			if (ok)
-			{
-				buf.printf("M98 P%s\n", RESUME_PROLOGUE_G);					// call the prologue - must contain at least M116
-				ok = f->Write(buf.Pointer())
-					&& platform.WriteFanSettings(f);						// set the speeds of non-thermostatic fans
-			}
-			if (ok)
-			{
-				buf.printf("M106 S%.2f\n", (double)lastDefaultFanSpeed);
-				ok = f->Write(buf.Pointer());
-			}
-			if (ok)
+			bool ok = WriteResumeInfoPrefix(f, reason) && WriteResumeInfoSuffix(f, rp);
+			if (!f->Close())
 			{
-				buf.printf("M116\nM290 S%.3f\n", (double)currentBabyStepZOffset);
-				ok = f->Write(buf.Pointer());								// write baby stepping offset
+				ok = false;
 			}
-			if (ok && fileGCode->OriginalMachineState().volumetricExtrusion)
+			if (ok && logSuccess)
 			{
-				buf.copy("M200 ");
-				char c = 'D';
-				for (size_t i = 0; i < numExtruders; ++i)
-				{
-					buf.catf("%c%.03f", c, (double)volumetricExtrusionFactors[i]);
-					c = ':';
-				}
-				buf.cat('\n');
-				ok = f->Write(buf.Pointer());								// write volumetric extrusion factors
+				platform.Message(LoggedGenericMessage, "Resume-after-power-fail state saved\n");
 			}
-			if (ok)
+			else if (!ok)
 			{
-				buf.printf("G92 E%.5f\n%s\n", (double)virtualExtruderPosition, (fileGCode->OriginalMachineState().drivesRelative) ? "M83" : "M82");
-				ok = f->Write(buf.Pointer());								// write virtual extruder position and absolute/relative extrusion flag
+				platform.GetMassStorage()->Delete(platform.GetSysDir(), RESUME_AFTER_POWER_FAIL_G, true);
+				platform.MessageF(ErrorMessage, "Failed to write or close file %s\n", RESUME_AFTER_POWER_FAIL_G);
 			}
-			if (ok)
+		}
+#if HAS_VOLTAGE_MONITOR
+		resumeFileIsPrefixOnly = false;									// the file is either complete or deleted
+#endif
+	}
+}
+
+// Write the slowly-changing part of the resume file: the header comment, heater, tool, mesh, prologue and fan
+// settings. Returns true if successful.
+bool GCodes::WriteResumeInfoPrefix(FileStore *f, const char *reason)
+{
+	char bufferSpace[200];
+	StringRef buf(bufferSpace, ARRAY_SIZE(bufferSpace));
+
+	// Write the header comment
+	buf.printf("; File \"%s\" resume print after %s", reprap.GetPrintMonitor().GetPrintingFilename(), reason);
+	if (reprap.GetPlatform().IsDateTimeSet())
+	{
+		time_t timeNow = reprap.GetPlatform().GetDateTime();
+		const struct tm * const timeInfo = gmtime(&timeNow);
+		buf.catf(" at %04u-%02u-%02u %02u:%02u",
+						timeInfo->tm_year + 1900, timeInfo->tm_mon + 1, timeInfo->tm_mday, timeInfo->tm_hour, timeInfo->tm_min);
+	}
+	buf.cat('\n');
+	bool ok = f->Write(buf.Pointer())
+			&& reprap.GetHeat().WriteBedAndChamberTempSettings(f)	// turn on bed and chamber heaters
+			&& reprap.WriteToolSettings(f)							// set tool temperatures, tool mix ratios etc.
+			&& reprap.GetMove().WriteResumeSettings(f);				// load grid, if we are using one
+	if (ok)
+	{
+		buf.printf("M98 P%s\n", RESUME_PROLOGUE_G);					// call the prologue - must contain at least M116
+		ok = f->Write(buf.Pointer())
+			&& platform.WriteFanSettings(f);						// set the speeds of non-thermostatic fans
+	}
+	return ok;
+}
+
+// Write the position-dependent part of the resume file for the state in 'rp'. This part is cheap to generate,
+// so on a power failure we can append it to an already-written prefix within the PSU hold-up time.
+// Returns true if successful.
+bool GCodes::WriteResumeInfoSuffix(FileStore *f, const RestorePoint& rp)
+{
+	char bufferSpace[200];
+	StringRef buf(bufferSpace, ARRAY_SIZE(bufferSpace));
+
+	buf.printf("M106 S%.2f\n", (double)lastDefaultFanSpeed);
+	bool ok = f->Write(buf.Pointer());
+	if (ok)
+	{
+		buf.printf("M116\nM290 S%.3f\n", (double)currentBabyStepZOffset);
+		ok = f->Write(buf.Pointer());								// write baby stepping offset
+	}
+	if (ok && fileGCode->OriginalMachineState().volumetricExtrusion)
+	{
+		buf.copy("M200 ");
+		char c = 'D';
+		for (size_t i = 0; i < numExtruders; ++i)
+		{
+			buf.catf("%c%.03f", c, (double)volumetricExtrusionFactors[i]);
+			c = ':';
+		}
+		buf.cat('\n');
+		ok = f->Write(buf.Pointer());								// write volumetric extrusion factors
+	}
+	if (ok)
+	{
+		buf.printf("G92 E%.5f\n%s\n", (double)virtualExtruderPosition, (fileGCode->OriginalMachineState().drivesRelative) ? "M83" : "M82");
+		ok = f->Write(buf.Pointer());								// write virtual extruder position and absolute/relative extrusion flag
+	}
+	if (ok)
+	{
+		buf.printf("M23 %s\nM26 S%" PRIu32 " P%.3f\n", reprap.GetPrintMonitor().GetPrintingFilename(), rp.filePos, (double)rp.proportionDone);
+		ok = f->Write(buf.Pointer());								// write filename and file position
+	}
+	if (ok)
+	{
+		// Build the commands to restore the head position. These assume that we are working in mm.
+		// Start with a vertical move to 2mm above the final Z position
+		buf.printf("G0 F6000 Z%.3f\n", (double)(rp.moveCoords[Z_AXIS] + 2.0));
+
+		// Now set all the other axes
+		buf.cat("G0 F6000");
+		for (size_t axis = 0; axis < numVisibleAxes; ++axis)
+		{
+			if (axis != Z_AXIS)
 			{
-				buf.printf("M23 %s\nM26 S%" PRIu32 " P%.3f\n", printingFilename, pauseRestorePoint.filePos, (double)pauseRestorePoint.proportionDone);
-				ok = f->Write(buf.Pointer());								// write filename and file position
+				buf.catf(" %c%.2f", axisLetters[axis], (double)rp.moveCoords[axis]);
 			}
-			if (ok)
-			{
-				// Build the commands to restore the head position. These assume that we are working in mm.
-				// Start with a vertical move to 2mm above the final Z position
-				buf.printf("G0 F6000 Z%.3f\n", (double)(pauseRestorePoint.moveCoords[Z_AXIS] + 2.0));
-
-				// Now set all the other axes
-				buf.cat("G0 F6000");
-				for (size_t axis = 0; axis < numVisibleAxes; ++axis)
-				{
-					if (axis != Z_AXIS)
-					{
-						buf.catf(" %c%.2f", axisLetters[axis], (double)pauseRestorePoint.moveCoords[axis]);
-					}
-				}
+		}
 
-				// Now move down to the correct Z height
-				buf.catf("\nG0 F6000 Z%.3f\n", (double)pauseRestorePoint.moveCoords[Z_AXIS]);
+		// Now move down to the correct Z height
+		buf.catf("\nG0 F6000 Z%.3f\n", (double)rp.moveCoords[Z_AXIS]);
 
-				// Set the feed rate
-				buf.catf("G1 F%.1f", (double)(pauseRestorePoint.feedRate * MinutesToSeconds));
+		// Set the feed rate
+		buf.catf("G1 F%.1f", (double)(rp.feedRate * MinutesToSeconds));
 #if SUPPORT_IOBITS
-				buf.catf(" P%u", (unsigned int)pauseRestorePoint.ioBits);
+		buf.catf(" P%u", (unsigned int)rp.ioBits);
 #endif
-				buf.cat("\nM24\n");
-				ok = f->Write(buf.Pointer());								// restore feed rate and output bits
-			}
+		buf.cat("\nM24\n");
+		ok = f->Write(buf.Pointer());								// restore feed rate and output bits
+	}
+	return ok;
+}
+
+#if HAS_VOLTAGE_MONITOR
+
+// If auto save on power loss is enabled, keep a resume file containing just the slowly-changing settings on the
+// SD card while we are printing. When the supply voltage drops we then only have to append the short
+// position-dependent part, which keeps the SD card work within the hold-up time of the power supply.
+// We don't do this when M597 checkpointing is active, because that already writes complete resume files.
+void GCodes::RefreshResumeFilePrefix()
+{
+	if (   platform.IsAutoSaveEnabled()
+		&& printCheckpointInterval == 0
+		&& reprap.GetPrintMonitor().IsPrinting()
+		&& !isPaused
+		&& simulationMode == 0
+		&& millis() - whenResumeFilePrefixWritten >= ResumeFilePrefixRefreshMillis
+	   )
+	{
+		whenResumeFilePrefixWritten = millis();
+		FileStore * const f = platform.OpenFile(platform.GetSysDir(), RESUME_AFTER_POWER_FAIL_G, OpenMode::write);
+		if (f != nullptr)
+		{
+			const bool ok = WriteResumeInfoPrefix(f, "power failure");
+			resumeFileIsPrefixOnly = f->Close() && ok;
+		}
+		else
+		{
+			resumeFileIsPrefixOnly = false;
+		}
+	}
+}
+
+// Write the resume file as quickly as possible following a power-fail pause. If a prefix-only resume file is
+// already on the card then complete it by appending the position-dependent part, else write the whole file.
+void GCodes::SaveResumeInfoAfterPowerFail()
+{
+	bool saved = false;
+	if (resumeFileIsPrefixOnly)
+	{
+		resumeFileIsPrefixOnly = false;
+		FileStore * const f = platform.OpenFile(platform.GetSysDir(), RESUME_AFTER_POWER_FAIL_G, OpenMode::append);
+		if (f != nullptr)
+		{
+			saved = f->Seek(f->Length()) && WriteResumeInfoSuffix(f, pauseRestorePoint);
 			if (!f->Close())
 			{
-				ok = false;
-			}
-			if (ok)
-			{
-				platform.Message(LoggedGenericMessage, "Resume-after-power-fail state saved\n");
-			}
-			else
-			{
-				platform.GetMassStorage()->Delete(platform.GetSysDir(), RESUME_AFTER_POWER_FAIL_G, true);
-				platform.MessageF(ErrorMessage, "Failed to write or close file %s\n", RESUME_AFTER_POWER_FAIL_G);
+				saved = false;
 			}
 		}
 	}
+	if (saved)
+	{
+		platform.Message(LoggedGenericMessage, "Resume-after-power-fail state saved\n");
+	}
+	else
+	{
+		SaveResumeInfo(pauseRestorePoint, "power failure", true);
+	}
 }
 
+#endif
+
 void GCodes::Diagnostics(MessageType mtype)
 {
 	platform.Message(mtype, "=== GCodes ===\n");
@@ -1901,6 +2591,12 @@ void GCodes::Diagnostics(MessageType mtype)
 	codeQueue->Diagnostics(mtype);
 }
 
+// Report the code queue arena usage for the M122 memory report
+void GCodes::CodeQueueMemoryReport(MessageType mtype)
+{
+	codeQueue->MemoryReport(mtype);
+}
+
 // Lock movement and wait for pending moves to finish.
 // As a side-effect it loads moveBuffer with the last position and feedrate for you.
 bool GCodes::LockMovementAndWaitForStandstill(const GCodeBuffer& gb)
@@ -1923,10 +2619,17 @@ bool GCodes::LockMovementAndWaitForStandstill(const GCodeBuffer& gb)
 		return false;
 	}
 
-	// Get the current positions. These may not be the same as the ones we remembered from last time if we just did a special move.
-	reprap.GetMove().GetCurrentUserPosition(moveBuffer.coords, 0, reprap.GetCurrentXAxes(), reprap.GetCurrentYAxes());
-	memcpy(moveBuffer.initialCoords, moveBuffer.coords, numVisibleAxes * sizeof(moveBuffer.initialCoords[0]));
-	ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);
+	// Get the current positions unless the ones we remembered from last time are still valid. They become invalid if we
+	// did a special or probing move, a move was stopped early, the position was set directly, or a transform was changed.
+	const uint32_t positionChangeCount = reprap.GetMove().GetPositionChangeCount();
+	if (!machinePositionValid || positionChangeCount != lastPositionChangeCount)
+	{
+		reprap.GetMove().GetCurrentUserPosition(moveBuffer.coords, 0, reprap.GetCurrentXAxes(), reprap.GetCurrentYAxes());
+		memcpy(moveBuffer.initialCoords, moveBuffer.coords, numVisibleAxes * sizeof(moveBuffer.initialCoords[0]));
+		ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);
+		lastPositionChangeCount = positionChangeCount;
+		machinePositionValid = true;
+	}
 	return true;
 }
 
@@ -2016,6 +2719,7 @@ bool GCodes::LoadExtrusionAndFeedrateFromGCode(GCodeBuffer& gb, int moveType)
 						extrusionAmount *= volumetricExtrusionFactors[drive];
 					}
 					rawExtruderTotalByDrive[drive] += extrusionAmount;
+					tool->AccumulateExtrusion(extrusionAmount);
 					if (!doingToolChange)			// don't count extrusion done in tool change macros towards total filament consumed, it distorts the print progress
 					{
 						rawExtruderTotal += extrusionAmount;
@@ -2037,6 +2741,7 @@ bool GCodes::LoadExtrusionAndFeedrateFromGCode(GCodeBuffer& gb, int moveType)
 							extrusionAmount *= volumetricExtrusionFactors[drive];
 						}
 						rawExtruderTotalByDrive[drive] += extrusionAmount;
+						tool->AccumulateExtrusion(extrusionAmount);
 						if (!doingToolChange)		// don't count extrusion done in tool change macros towards total filament consumed, it distorts the print progress
 						{
 							rawExtruderTotal += extrusionAmount;
@@ -2364,6 +3069,20 @@ bool GCodes::DoArcMove(GCodeBuffer& gb, bool clockwise)
 		arcAngleIncrement = -arcAngleIncrement;
 	}
 
+	// Set up the incremental rotation so that we don't need to call sinf/cosf for every segment
+	arcIncrementCos = cosf(arcAngleIncrement);
+	arcIncrementSin = sinf(arcAngleIncrement);
+	if (arcRadius > 0.0)
+	{
+		arcCos = -iParam/arcRadius;
+		arcSin = -jParam/arcRadius;
+	}
+	else
+	{
+		arcCos = 1.0;
+		arcSin = 0.0;
+	}
+
 	doingArcMove = true;
 	FinaliseMove(gb);
 //	debugPrintf("Radius %.2f, initial angle %.1f, increment %.1f, segments %u\n",
@@ -2381,6 +3100,13 @@ void GCodes::FinaliseMove(const GCodeBuffer& gb)
 
 	if (totalSegments > 1)
 	{
+		// Precompute the axis movement per segment, so that ReadMove only has to do an addition per axis for each segment.
+		// For arc moves only the Z increment gets used, because the X and Y coordinates are generated from the arc parameters.
+		for (size_t drive = 0; drive < numVisibleAxes; ++drive)
+		{
+			segMoveIncrements[drive] = (moveBuffer.coords[drive] - moveBuffer.initialCoords[drive])/totalSegments;
+		}
+
 		for (size_t drive = numTotalAxes; drive < DRIVES; ++drive)
 		{
 			moveBuffer.coords[drive] /= totalSegments;							// change the extrusion to extrusion per segment
@@ -2412,6 +3138,16 @@ bool GCodes::ReadMove(RawMove& m)
 
 	m = moveBuffer;
 
+	if (moveBuffer.moveType != 0 || moveBuffer.endStopsToCheck != 0)
+	{
+		machinePositionValid = false;			// the endpoint of a raw or endstop-checking move is not predictable
+	}
+
+	// Attach any pending fan speed change to this move, so that it takes effect exactly when the move starts
+	m.fanChangeMask = moveFanChangeMask;
+	m.newFanSpeed = moveNewFanSpeed;
+	moveFanChangeMask = 0;
+
 	if (segmentsLeft == 1)
 	{
 		// If there is just 1 segment left, it doesn't matter if it is an arc move or not, just move to the end position
@@ -2432,7 +3168,14 @@ bool GCodes::ReadMove(RawMove& m)
 		// Do the axes
 		if (doingArcMove)
 		{
+			// Rotate the stored cosine/sine by the angle increment instead of calling sinf/cosf for every segment
 			arcCurrentAngle += arcAngleIncrement;
+			const float newCos = (arcCos * arcIncrementCos) - (arcSin * arcIncrementSin);
+			const float newSin = (arcSin * arcIncrementCos) + (arcCos * arcIncrementSin);
+			// A first-order renormalisation stops rounding errors accumulating in the radius over long arcs
+			const float correction = (3.0 - (fsquare(newCos) + fsquare(newSin))) * 0.5;
+			arcCos = newCos * correction;
+			arcSin = newSin * correction;
 		}
 
 		for (size_t drive = 0; drive < numVisibleAxes; ++drive)
@@ -2442,18 +3185,19 @@ bool GCodes::ReadMove(RawMove& m)
 				if (IsBitSet(moveBuffer.yAxes, drive))
 				{
 					// Y axis or a substitute Y axis
-					moveBuffer.initialCoords[drive] = arcCentre[drive] + arcRadius * sinf(arcCurrentAngle);
+					moveBuffer.initialCoords[drive] = arcCentre[drive] + arcRadius * arcSin;
 				}
 				else if (IsBitSet(moveBuffer.xAxes, drive))
 				{
 					// X axis or a substitute X axis
-					moveBuffer.initialCoords[drive] = arcCentre[drive] + arcRadius * cosf(arcCurrentAngle);
+					moveBuffer.initialCoords[drive] = arcCentre[drive] + arcRadius * arcCos;
 				}
 			}
 			else
 			{
-				const float movementToDo = (moveBuffer.coords[drive] - moveBuffer.initialCoords[drive])/segmentsLeft;
-				moveBuffer.initialCoords[drive] += movementToDo;
+				// Use the per-segment increment precomputed by FinaliseMove. Any accumulated rounding error doesn't matter,
+				// because the final segment goes to the exact end coordinates.
+				moveBuffer.initialCoords[drive] += segMoveIncrements[drive];
 			}
 			m.coords[drive] = moveBuffer.initialCoords[drive];
 		}
@@ -2494,7 +3238,7 @@ void GCodes::ClearMove()
 // Return true if the file was found or it wasn't and we were asked to report that fact.
 bool GCodes::DoFileMacro(GCodeBuffer& gb, const char* fileName, bool reportMissing, int codeRunning)
 {
-	FileStore * const f = platform.OpenFile(platform.GetSysDir(), fileName, OpenMode::read);
+	FileStore * const f = platform.OpenMacroFile(platform.GetSysDir(), fileName);
 	if (f == nullptr)
 	{
 		if (reportMissing)
@@ -2578,6 +3322,41 @@ GCodeResult GCodes::DoHome(GCodeBuffer& gb, StringRef& reply)
 	return GCodeResult::ok;
 }
 
+// Combine the readings taken by a multi-tap probe cycle into a single height error.
+// We take the median of the taps, then average the taps that lie within the tolerance of the median, which rejects occasional rogue readings.
+float GCodes::ConsolidateTapHeights(float tolerance) const
+{
+	// Insertion sort the taps; the count is small
+	float sorted[MaxProbeTaps];
+	for (size_t i = 0; i < tapsDone; ++i)
+	{
+		size_t j = i;
+		while (j != 0 && sorted[j - 1] > tapHeights[i])
+		{
+			sorted[j] = sorted[j - 1];
+			--j;
+		}
+		sorted[j] = tapHeights[i];
+	}
+	const float median = ((tapsDone & 1) != 0) ? sorted[tapsDone/2] : (sorted[tapsDone/2 - 1] + sorted[tapsDone/2]) * 0.5;
+	if (tolerance <= 0.0)
+	{
+		return median;
+	}
+
+	float sum = 0.0;
+	size_t numAccepted = 0;
+	for (size_t i = 0; i < tapsDone; ++i)
+	{
+		if (fabsf(sorted[i] - median) <= tolerance)
+		{
+			sum += sorted[i];
+			++numAccepted;
+		}
+	}
+	return (numAccepted != 0) ? sum/(float)numAccepted : median;		// numAccepted can't be zero unless the tolerance is NaN, but be safe
+}
+
 // This is called to execute a G30.
 // It sets wherever we are as the probe point P (probePointIndex) then probes the bed, or gets all its parameters from the arguments.
 // If X or Y are specified, use those; otherwise use the machine's coordinates.  If no Z is specified use the machine's coordinates.
@@ -2588,6 +3367,7 @@ GCodeResult GCodes::ExecuteG30(GCodeBuffer& gb, StringRef& reply)
 {
 	g30SValue = (gb.Seen('S')) ? gb.GetIValue() : -3;		// S-3 is equivalent to having no S parameter
 	g30ProbePointIndex = -1;
+	batchProbeCount = batchProbeNext = 0;
 	bool seenP = false;
 	gb.TryGetIValue('P', g30ProbePointIndex, seenP);
 	if (seenP)
@@ -2605,6 +3385,11 @@ GCodeResult GCodes::ExecuteG30(GCodeBuffer& gb, StringRef& reply)
 			const float z = (gb.Seen(axisLetters[Z_AXIS])) ? gb.GetFValue() : currentUserPosition[Z_AXIS];
 			reprap.GetMove().SetXYBedProbePoint((size_t)g30ProbePointIndex, x, y);
 
+			if (gb.Seen('B') && gb.GetIValue() > 0)
+			{
+				return GCodeResult::ok;					// G30 P... B1 just defines the point, for probing later with G30 B<n>
+			}
+
 			if (z > SILLY_Z_VALUE)
 			{
 				// Just set the height error to the specified Z coordinate
@@ -2617,6 +3402,7 @@ GCodeResult GCodes::ExecuteG30(GCodeBuffer& gb, StringRef& reply)
 			else
 			{
 				// Do a Z probe at the specified point.
+				tapsDone = 0;
 				gb.SetState(GCodeState::probingAtPoint0);
 				if (platform.GetZProbeType() != 0 && !probeIsDeployed)
 				{
@@ -2625,10 +3411,73 @@ GCodeResult GCodes::ExecuteG30(GCodeBuffer& gb, StringRef& reply)
 			}
 		}
 	}
+	else if (gb.Seen('B'))
+	{
+		// G30 B<n>: probe the first n defined points in one sequence, visiting them in nearest-neighbour order,
+		// then do whatever the S parameter says. The probe stays deployed for the whole sequence and there is no
+		// GCode round trip between points, which roughly halves the time of a delta calibration run.
+		const int numPoints = gb.GetIValue();
+		if (numPoints < 2 || numPoints > (int)MaxProbePoints)
+		{
+			reply.copy("Number of batch probe points out of range");
+			return GCodeResult::error;
+		}
+		Move& move = reprap.GetMove();
+		for (int i = 0; i < numPoints; ++i)
+		{
+			if (!move.XYProbeCoordinatesSet(i))
+			{
+				reply.printf("Probe point %d has no XY coordinates; define it with G30 P%d X... Y... B1", i, i);
+				return GCodeResult::error;
+			}
+		}
+
+		// Plan the visit order: greedy nearest-neighbour starting from the current position. Travel moves dominate
+		// the sequence time, and for the point counts involved the O(n^2) planning cost is negligible.
+		bool visited[MaxProbePoints];
+		for (int i = 0; i < numPoints; ++i)
+		{
+			visited[i] = false;
+		}
+		float lastX = currentUserPosition[X_AXIS], lastY = currentUserPosition[Y_AXIS];
+		for (int n = 0; n < numPoints; ++n)
+		{
+			int best = -1;
+			float bestDistSquared = 0.0;
+			for (int i = 0; i < numPoints; ++i)
+			{
+				if (!visited[i])
+				{
+					float x, y;
+					(void)move.GetProbeCoordinates(i, x, y, false);
+					const float distSquared = fsquare(x - lastX) + fsquare(y - lastY);
+					if (best < 0 || distSquared < bestDistSquared)
+					{
+						best = i;
+						bestDistSquared = distSquared;
+					}
+				}
+			}
+			visited[best] = true;
+			batchProbeOrder[n] = (uint8_t)best;
+			(void)move.GetProbeCoordinates(best, lastX, lastY, false);
+		}
+
+		batchProbeCount = (size_t)numPoints;
+		batchProbeNext = 1;
+		g30ProbePointIndex = batchProbeOrder[0];
+		tapsDone = 0;
+		gb.SetState(GCodeState::probingAtPoint0);
+		if (platform.GetZProbeType() != 0 && !probeIsDeployed)
+		{
+			DoFileMacro(gb, DEPLOYPROBE_G, false);
+		}
+	}
 	else
 	{
 		// G30 without P parameter. This probes the current location starting from the current position.
 		// If S=-1 it just reports the stopped height, else it resets the Z origin.
+		tapsDone = 0;
 		gb.SetState(GCodeState::probingAtPoint2);
 		if (platform.GetZProbeType() != 0 && !probeIsDeployed)
 		{
@@ -2683,6 +3532,7 @@ GCodeResult GCodes::ProbeGrid(GCodeBuffer& gb, StringRef& reply)
 	move.AccessHeightMap().ClearGridHeights();
 	move.SetIdentityTransform();
 	gridXindex = gridYindex = 0;
+	(void)StartStreamedHeightMapSave(gb);				// try to stream the height map to file as rows complete; if this fails we save it at the end instead
 	gb.SetState(GCodeState::gridProbing1);
 
 	if (platform.GetZProbeType() != 0 && !probeIsDeployed)
@@ -2692,6 +3542,112 @@ GCodeResult GCodes::ProbeGrid(GCodeBuffer& gb, StringRef& reply)
 	return GCodeResult::ok;
 }
 
+// Start probing the grid in continuous-motion scanning mode (G29 S3). The head is kept moving along each row of the grid
+// while the analog Z probe reading is sampled on the fly, after a single conventional probe to calibrate the reading,
+// so a large grid takes a small fraction of the time that discrete probing needs.
+GCodeResult GCodes::ScanGrid(GCodeBuffer& gb, StringRef& reply)
+{
+	const int probeType = platform.GetZProbeType();
+	if (probeType < 1 || probeType > 3)
+	{
+		reply.copy("Scanning mode requires an analog Z probe");
+		return GCodeResult::error;
+	}
+
+	if (!defaultGrid.IsValid())
+	{
+		reply.copy("No valid grid defined for bed probing");
+		return GCodeResult::error;
+	}
+
+	if (!AllAxesAreHomed())
+	{
+		reply.copy("Must home printer before bed probing");
+		return GCodeResult::error;
+	}
+
+	Move& move = reprap.GetMove();
+	move.AccessHeightMap().SetGrid(defaultGrid);
+	move.AccessHeightMap().ClearGridHeights();
+	move.SetIdentityTransform();
+	gridXindex = gridYindex = 0;
+	(void)StartStreamedHeightMapSave(gb);				// try to stream the height map to file as rows complete; if this fails we save it at the end instead
+	gb.SetState(GCodeState::gridScanning1);
+
+	if (!probeIsDeployed)
+	{
+		DoFileMacro(gb, DEPLOYPROBE_G, false);
+	}
+	return GCodeResult::ok;
+}
+
+// Find the next grid row containing points within the grid radius, starting at the row in gridYindex, and set up the move
+// to the first point of it. The Z coordinate is left at the scanning height. Return false if there are no more rows.
+bool GCodes::StartScanRow(GCodeBuffer& gb)
+{
+	Move& move = reprap.GetMove();
+	const GridDefinition& grid = move.AccessHeightMap().GetGrid();
+	while (gridYindex < grid.NumYpoints())
+	{
+		const float y = grid.GetYCoordinate(gridYindex);
+
+		// Find the first and last points of this row that are within the grid radius. They bound a contiguous run of points.
+		size_t firstIndex = 0, lastIndex = 0;
+		bool found = false;
+		for (size_t ix = 0; ix < grid.NumXpoints(); ++ix)
+		{
+			if (grid.IsInRadius(grid.GetXCoordinate(ix), y))
+			{
+				if (!found)
+				{
+					firstIndex = ix;
+					found = true;
+				}
+				lastIndex = ix;
+			}
+		}
+		if (found)
+		{
+			// Scan alternate rows in opposite directions
+			scanRowIncreasing = ((gridYindex & 1) == 0);
+			gridXindex = (scanRowIncreasing) ? firstIndex : lastIndex;
+			scanRowEndIndex = (scanRowIncreasing) ? lastIndex : firstIndex;
+			scanRowPointsLeft = lastIndex - firstIndex + 1;
+
+			moveBuffer.moveType = 0;
+			moveBuffer.isCoordinated = false;
+			moveBuffer.endStopsToCheck = 0;
+			moveBuffer.usePressureAdvance = false;
+			moveBuffer.filePos = noFilePosition;
+			moveBuffer.coords[X_AXIS] = grid.GetXCoordinate(gridXindex) - platform.GetCurrentZProbeParameters().xOffset;
+			moveBuffer.coords[Y_AXIS] = y - platform.GetCurrentZProbeParameters().yOffset;
+			moveBuffer.feedRate = platform.GetZProbeTravelSpeed();
+			moveBuffer.xAxes = DefaultXAxisMapping;
+			moveBuffer.yAxes = DefaultYAxisMapping;
+			totalSegments = 1;
+			segmentsLeft = 1;
+			return true;
+		}
+		++gridYindex;
+	}
+	return false;
+}
+
+// Record a scanned height sample at the grid point indexed by gridXindex/gridYindex, using the current Z probe reading
+void GCodes::RecordScanPoint()
+{
+	HeightMap& heightMap = reprap.GetMove().AccessHeightMap();
+	const GridDefinition& grid = heightMap.GetGrid();
+	const float x = grid.GetXCoordinate(gridXindex);
+	const float y = grid.GetYCoordinate(gridYindex);
+	if (grid.IsInRadius(x, y) && reprap.GetMove().IsAccessibleProbePoint(x, y))
+	{
+		const float heightError = scanReferenceHeightError
+									+ (float)(platform.GetZProbeReading() - scanReferenceReading)/scanSensitivity;
+		heightMap.SetGridHeight(gridXindex, gridYindex, heightError);
+	}
+}
+
 bool GCodes::LoadHeightMap(GCodeBuffer& gb, StringRef& reply) const
 {
 	reprap.GetMove().SetIdentityTransform();					// stop using old-style bed compensation and clear the height map
@@ -2714,7 +3670,10 @@ bool GCodes::LoadHeightMap(GCodeBuffer& gb, StringRef& reply) const
 	reply.printf("Failed to load height map from file %s: ", heightMapFileName.c_str());	// set up error message to append to
 	HeightMap& heightMap = reprap.GetMove().AccessHeightMap();
 	const bool err = heightMap.LoadFromFile(f, reply);
-	f->Close();
+	if (!heightMap.UsesFile(f))
+	{
+		f->Close();											// if the map went tiled then the height map now owns the file and reads tiles from it on demand
+	}
 	if (err)
 	{
 		heightMap.ClearGridHeights();							// make sure we don't end up with a partial height map
@@ -2749,7 +3708,10 @@ bool GCodes::SaveHeightMap(GCodeBuffer& gb, StringRef& reply) const
 	}
 	else
 	{
-		err = reprap.GetMove().AccessHeightMap().SaveToFile(f);
+		// Use the compact binary format if the filename says so, else the CSV format, which remains the default for easy export
+		err = (StringEndsWith(heightMapFileName.c_str(), ".bin"))
+				? reprap.GetMove().AccessHeightMap().SaveToBinaryFile(f)
+					: reprap.GetMove().AccessHeightMap().SaveToFile(f);
 		f->Close();
 		if (err)
 		{
@@ -2764,6 +3726,122 @@ bool GCodes::SaveHeightMap(GCodeBuffer& gb, StringRef& reply) const
 	return err;
 }
 
+// Open the height map file and schedule a background task to write the grid to it, returning false if the file
+// could not be created. Called from the grid probing state machine; heightMapSaveFileName is valid either way.
+bool GCodes::StartHeightMapSave(GCodeBuffer& gb)
+{
+	StringRef fileNameRef(heightMapSaveFileName, ARRAY_SIZE(heightMapSaveFileName));
+	bool seen = false;
+	gb.TryGetQuotedString('P', fileNameRef, seen);
+	if (!seen)
+	{
+		fileNameRef.copy(DefaultHeightMapFile);
+	}
+
+	FileStore * const f = platform.OpenFile(platform.GetSysDir(), heightMapSaveFileName, OpenMode::write);
+	if (f == nullptr)
+	{
+		return false;
+	}
+
+	heightMapSaveFile = f;
+	heightMapSavePhase = 0;
+	heightMapSaveError = false;
+	if (StringEndsWith(heightMapSaveFileName, ".bin"))
+	{
+		// The binary format is quick to write anyway, so there is no point in deferring it
+		heightMapSaveError = reprap.GetMove().AccessHeightMap().SaveToBinaryFile(f);
+	}
+	else if (!reprap.ScheduleBackgroundTask(HeightMapSaveTaskEntry, this))
+	{
+		// Another background task is already running, so save synchronously
+		heightMapSaveError = reprap.GetMove().AccessHeightMap().SaveToFile(f);
+	}
+	return true;
+}
+
+// Close the height map file opened by StartHeightMapSave and report the outcome, returning true on error
+bool GCodes::FinishHeightMapSave(StringRef& reply)
+{
+	heightMapSaveFile->Close();
+	heightMapSaveFile = nullptr;
+	if (heightMapSaveError)
+	{
+		platform.GetMassStorage()->Delete(platform.GetSysDir(), heightMapSaveFileName);
+		reply.catf("Failed to save height map to file %s", heightMapSaveFileName);
+	}
+	else
+	{
+		reply.catf("Height map saved to file %s", heightMapSaveFileName);
+	}
+	return heightMapSaveError;
+}
+
+// Try to open the height map file and write its header when grid probing starts, so that completed rows can be
+// streamed to the file while later rows are still being probed and the save finishes almost as soon as the probing
+// does. Returns false if streaming could not be started, in which case the map is saved conventionally at the end.
+bool GCodes::StartStreamedHeightMapSave(GCodeBuffer& gb)
+{
+	StringRef fileNameRef(heightMapSaveFileName, ARRAY_SIZE(heightMapSaveFileName));
+	bool seen = false;
+	gb.TryGetQuotedString('P', fileNameRef, seen);
+	if (!seen)
+	{
+		fileNameRef.copy(DefaultHeightMapFile);
+	}
+
+	if (StringEndsWith(heightMapSaveFileName, ".bin"))
+	{
+		return false;									// the binary format is written in one piece, and quickly
+	}
+
+	FileStore * const f = platform.OpenFile(platform.GetSysDir(), heightMapSaveFileName, OpenMode::write);
+	if (f == nullptr)
+	{
+		return false;
+	}
+
+	if (reprap.GetMove().AccessHeightMap().StartStreamedSave(f))
+	{
+		f->Close();
+		platform.GetMassStorage()->Delete(platform.GetSysDir(), heightMapSaveFileName, true);
+		return false;
+	}
+
+	heightMapSaveFile = f;
+	heightMapSaveError = false;
+	return true;
+}
+
+// Write any newly completed grid rows to the streamed height map file. Rows below 'rowLimit' are final because the
+// probe has passed them. Called from the grid probing state machine each time the row index advances.
+void GCodes::ContinueStreamedHeightMapSave(size_t rowLimit)
+{
+	if (heightMapSaveFile != nullptr && !heightMapSaveError)
+	{
+		heightMapSaveError = reprap.GetMove().AccessHeightMap().SaveRows(heightMapSaveFile, rowLimit);
+	}
+}
+
+// Close and delete a partially written streamed height map file. Called when grid probing fails part way through.
+void GCodes::AbandonStreamedHeightMapSave()
+{
+	if (heightMapSaveFile != nullptr)
+	{
+		heightMapSaveFile->Close();
+		heightMapSaveFile = nullptr;
+		platform.GetMassStorage()->Delete(platform.GetSysDir(), heightMapSaveFileName, true);
+	}
+}
+
+// Background task entry point for saving the height map. Writes grid rows until the deadline passes,
+// returning true when the whole file has been written.
+/*static*/ bool GCodes::HeightMapSaveTaskEntry(void *param, uint32_t deadline)
+{
+	GCodes * const gc = static_cast<GCodes*>(param);
+	return reprap.GetMove().AccessHeightMap().SaveSliceToFile(gc->heightMapSaveFile, gc->heightMapSavePhase, deadline, gc->heightMapSaveError);
+}
+
 // Return the current coordinates as a printable string.
 // Coordinates are updated at the end of each movement, so this won't tell you where you are mid-movement.
 void GCodes::GetCurrentCoordinates(StringRef& s) const
@@ -2932,6 +4010,12 @@ bool GCodes::QueueFileToPrint(const char* fileName, StringRef& reply)
 		rawExtruderTotal = 0.0;
 		reprap.GetMove().ResetExtruderPositions();
 
+		// Build the FAT cluster map for the file so that sequential reads and mid-print seeks (e.g. M26 and
+		// print resume) can locate the data directly instead of walking the FAT chain. If the file is too
+		// fragmented for the table then FatFS reverts to normal FAT traversal, so failure here doesn't matter.
+		printFileClusterMap[0] = FileClusterMapSize;
+		(void)f->SetClusterMap(printFileClusterMap);
+
 		fileToPrint.Set(f);
 		fileOffsetToPrint = 0;
 		moveFractionToStartAt = 0.0;
@@ -2946,6 +4030,7 @@ bool GCodes::QueueFileToPrint(const char* fileName, StringRef& reply)
 void GCodes::StartPrinting()
 {
 	fileGCode->OriginalMachineState().fileState.MoveFrom(fileToPrint);
+	fileGCode->OriginalMachineState().ClearBlocks();	// in case the last file ended with an if/while block open
 	fileInput->Reset();
 	lastFilamentError = FilamentSensorStatus::ok;
 	reprap.GetPrintMonitor().StartedPrint();
@@ -3267,6 +4352,85 @@ bool GCodes::ChangeMicrostepping(size_t drive, unsigned int microsteps, int mode
 	return success;
 }
 
+// If the command in gb is a simple fan speed change and moves are queued, record it to be applied when the
+// next move starts and return true so that the caller replies and discards it. Return false if the command
+// carries fan configuration parameters, or there are no moves pending (so it can be executed immediately),
+// or a move is still being segmented, or a different speed change is already waiting for the next move;
+// in those cases the command takes the normal execution or code queue path.
+bool GCodes::TryPerMoveFanChange(GCodeBuffer& gb)
+{
+	if (gb.GetCommandLetter() != 'M')
+	{
+		return false;
+	}
+	const int code = gb.GetCommandNumber();
+	if (code != 106 && code != 107)
+	{
+		return false;
+	}
+	if (segmentsLeft != 0 || reprap.GetMove().GetScheduledMoves() == reprap.GetMove().GetCompletedMoves())
+	{
+		return false;								// either the last move is still being segmented, or motion has drained
+	}
+
+	float speed = 0.0;								// M107 means fan off
+	bool seenFanNum = false;
+	int32_t fanNum = 0;
+	if (code == 106)
+	{
+		// Fetch all the parameters we care about in a single pass. Only the first two carry values we use;
+		// the rest are configuration parameters whose mere presence forces the normal path.
+		static constexpr GCodeBuffer::ParameterDescriptor M106ParamTable[] =
+		{
+			{ 'S', 0.0, 255.0 },						// the fan speed
+			{ 'P', -999.0, 999.0 },						// the fan number, range-checked properly below
+			{ 'I', 0.0, 0.0 }, { 'F', 0.0, 0.0 }, { 'L', 0.0, 0.0 }, { 'X', 0.0, 0.0 },
+			{ 'B', 0.0, 0.0 }, { 'H', 0.0, 0.0 }, { 'R', 0.0, 0.0 }, { 'T', 0.0, 0.0 }
+		};
+		float params[ARRAY_SIZE(M106ParamTable)];
+		const uint32_t present = gb.FetchParameters(M106ParamTable, ARRAY_SIZE(M106ParamTable), params);
+		if ((present & ~3u) != 0)
+		{
+			return false;							// the command carries fan configuration parameters
+		}
+		if (!IsBitSet(present, 0))
+		{
+			return false;							// no S parameter
+		}
+		speed = params[0];
+		seenFanNum = IsBitSet(present, 1);
+		if (seenFanNum)
+		{
+			fanNum = (int32_t)params[1];
+		}
+	}
+
+	FansBitmap whichFans;
+	if (seenFanNum)
+	{
+		if (fanNum < 0 || fanNum >= (int32_t)NUM_FANS)
+		{
+			return false;							// let the normal path report the bad fan number
+		}
+		whichFans = 1u << fanNum;
+	}
+	else
+	{
+		// No fan number, so the change applies to the fans mapped for the current tool
+		const Tool * const ct = reprap.GetCurrentTool();
+		whichFans = (ct == nullptr) ? 1u : ct->GetFanMapping();
+		lastDefaultFanSpeed = speed;				// keep tool changes and M106 R working as if the code had executed
+	}
+
+	if (moveFanChangeMask != 0 && moveNewFanSpeed != speed)
+	{
+		return false;								// a different change is already waiting for the next move, so queue this one after it
+	}
+	moveFanChangeMask |= whichFans;
+	moveNewFanSpeed = speed;
+	return true;
+}
+
 // Set the speeds of fans mapped for the current tool to lastDefaultFanSpeed
 void GCodes::SetMappedFanSpeed()
 {
@@ -3905,6 +5069,14 @@ void GCodes::StopPrint(bool normalCompletion)
 {
 	segmentsLeft = 0;
 	isPaused = pausePending = false;
+	if (frozenPauseActive)
+	{
+		reprap.GetMove().DiscardFrozenMoves();		// the print is not going to be resumed, so throw away the frozen moves
+		frozenPauseActive = false;
+	}
+#if HAS_VOLTAGE_MONITOR
+	resumeFileIsPrefixOnly = false;
+#endif
 
 	FileData& fileBeingPrinted = fileGCode->OriginalMachineState().fileState;
 
@@ -3948,12 +5120,25 @@ void GCodes::StopPrint(bool normalCompletion)
 		platform.MessageF(LoggedGenericMessage, "%s printing file %s, print time was %" PRIu32 "h %" PRIu32 "m\n",
 			(normalCompletion) ? "Finished" : "Cancelled",
 			printingFilename, printMinutes/60u, printMinutes % 60u);
+
+		// Write the movement statistics sampled during the print to the report file
+		FileStore * const statsFile = platform.OpenFile(platform.GetSysDir(), MOVE_STATS_FILE, OpenMode::write);
+		if (statsFile != nullptr)
+		{
+			statsFile->UseDeferredSync();			// let the data trickle out via the write-behind buffers
+			if (!reprap.GetMove().SaveStatsReport(statsFile, printingFilename))
+			{
+				platform.Message(ErrorMessage, "Failed to write movement statistics file\n");
+			}
+			statsFile->Close();
+		}
 	}
 
 	reprap.GetPrintMonitor().StoppedPrint();		// must do this after printing the simulation details because it clears the filename
 	if (normalCompletion && simulationMode == 0)
 	{
 		platform.GetMassStorage()->Delete(platform.GetSysDir(), RESUME_AFTER_POWER_FAIL_G, true);
+		startNextJobPending = !jobQueue->IsEmpty();	// chain to the next queued job, if there is one
 	}
 }
 
@@ -4286,7 +5471,7 @@ void GCodes::GenerateTemperatureReport(StringRef& reply) const
 
 // Check whether we need to report temperatures or status.
 // 'reply' is a convenient buffer that is free for us to use.
-void GCodes::CheckReportDue(GCodeBuffer& gb, StringRef& reply) const
+void GCodes::CheckReportDue(GCodeBuffer& gb, StringRef& reply)
 {
 	const uint32_t now = millis();
 	if (gb.timerRunning)
@@ -4302,8 +5487,11 @@ void GCodes::CheckReportDue(GCodeBuffer& gb, StringRef& reply) const
 			}
 			if (lastAuxStatusReportType >= 0)
 			{
-				// Send a standard status response for PanelDue
-				OutputBuffer * const statusBuf = GenerateJsonStatusResponse(0, -1, ResponseSource::AUX);
+				// Send a standard status response for PanelDue. In binary mode the periodic reports are
+				// delta frames; the panel gets a full frame whenever it asks explicitly via M408.
+				OutputBuffer * const statusBuf = (auxBinaryStatusMode)
+													? GenerateBinaryStatusFrame(false)
+													: GenerateJsonStatusResponse(0, -1, ResponseSource::AUX);
 				if (statusBuf != nullptr)
 				{
 					platform.AppendAuxReply(statusBuf);
@@ -4348,6 +5536,14 @@ OutputBuffer *GCodes::GenerateJsonStatusResponse(int type, int seq, ResponseSour
 	return statusResponse;
 }
 
+// Generate a binary status frame for PanelDue, either a full one or a delta covering the state changes
+// since the last frame we sent. Unlike the JSON responses, frames are not newline-terminated; they carry
+// their own length and checksum.
+OutputBuffer *GCodes::GenerateBinaryStatusFrame(bool wantFull)
+{
+	return reprap.GetBinaryStatusResponse(wantFull, auxBinarySentSeq);
+}
+
 // Resource locking/unlocking
 
 // Lock the resource, returning true if success.
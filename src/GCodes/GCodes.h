@@ -114,6 +114,8 @@ public:
 #if SUPPORT_IOBITS
 		IoBits_t ioBits;												// I/O bits to set/clear at the start of this move
 #endif
+		FansBitmap fanChangeMask;										// fans whose speed should change when this move starts
+		float newFanSpeed;												// the fan speed to apply to those fans, in the range 0 to 1 or 1 to 255
 		uint8_t moveType;												// the S parameter from the G0 or G1 command, 0 for a normal move
 
 		uint8_t isFirmwareRetraction : 1;								// true if this is a firmware retraction/un-retraction move
@@ -137,10 +139,13 @@ public:
 	bool DoingFileMacro() const;										// Or still busy processing a macro file?
 	float FractionOfFilePrinted() const;								// Get fraction of file printed
 	void Diagnostics(MessageType mtype);								// Send helpful information out
+	void CodeQueueMemoryReport(MessageType mtype);					// Report the code queue arena usage
 
 	bool RunConfigFile(const char* fileName);							// Start running the config file
 	bool IsDaemonBusy() const;											// Return true if the daemon is busy running config.g or a trigger file
 
+	const JobQueue& GetJobQueue() const { return *jobQueue; }			// Return the queue of jobs waiting to be printed
+
 	bool GetAxisIsHomed(unsigned int axis) const						// Has the axis been homed?
 		{ return IsBitSet(axesHomed, axis); }
 	void SetAxisIsHomed(unsigned int axis)								// Tell us that the axis is now homed
@@ -181,6 +186,7 @@ public:
 	size_t GetNumExtruders() const { return numExtruders; }
 
 	void FilamentError(size_t extruder, FilamentSensorStatus fstat);
+	void TrimExtrusionFactor(size_t extruder, float extrusionFactor);	// Apply a closed-loop extrusion factor correction from a filament sensor
 	void HandleHeaterFault(int heater);									// Respond to a heater fault
 
 #if HAS_VOLTAGE_MONITOR
@@ -229,8 +235,14 @@ private:
 	void FileMacroCyclesReturn(GCodeBuffer& gb);						// End a macro
 
 	bool ActOnCode(GCodeBuffer& gb, StringRef& reply);					// Do a G, M or T Code
+	bool ProcessMetaCommand(GCodeBuffer& gb, StringRef& reply);			// Deal with a flow control meta-command, returning true if the line has been handled
+	bool EvaluateCondition(const char *&s, bool& result, StringRef& reply);	// Evaluate a comparison of two operands
+	bool EvaluateExpression(const char *&s, float& value, StringRef& reply);	// Evaluate an operand optionally combined with a second one by an arithmetic operator
+	bool EvaluateOperand(const char *&s, float& value, StringRef& reply);	// Evaluate a constant, named parameter or machine value
 	bool HandleGcode(GCodeBuffer& gb, StringRef& reply);				// Do a G code
 	bool HandleMcode(GCodeBuffer& gb, StringRef& reply);				// Do an M code
+	bool HandleConfigMcode(GCodeBuffer& gb, StringRef& reply, int code);	// Do an M code numbered 500 or above (in GCodes4.cpp)
+	bool FinishedMcode(GCodeBuffer& gb, StringRef& reply, int code, GCodeResult result);	// Common tail handling for M codes
 	bool HandleTcode(GCodeBuffer& gb, StringRef& reply);				// Do a T code
 
 	bool DoStraightMove(GCodeBuffer& gb, StringRef& reply, bool isCoordinated) __attribute__((hot));	// Execute a straight move returning true if an error was written to 'reply'
@@ -242,6 +254,7 @@ private:
 	GCodeResult DoDwellTime(GCodeBuffer& gb, uint32_t dwellMillis);		// Really wait for a bit
 	GCodeResult DoHome(GCodeBuffer& gb, StringRef& reply);				// Home some axes
 	GCodeResult ExecuteG30(GCodeBuffer& gb, StringRef& reply);			// Probes at a given position - see the comment at the head of the function itself
+	float ConsolidateTapHeights(float tolerance) const;					// Combine the readings from a multi-tap probe cycle into a single height error
 	void SetBedEquationWithProbe(int sParam, StringRef& reply);			// Probes a series of points and sets the bed equation
 	GCodeResult SetPrintZProbe(GCodeBuffer& gb, StringRef& reply);		// Either return the probe value, or set its threshold
 	GCodeResult SetOrReportOffsets(GCodeBuffer& gb, StringRef& reply);	// Deal with a G10
@@ -270,7 +283,8 @@ private:
 	bool ToolHeatersAtSetTemperatures(const Tool *tool, bool waitWhenCooling) const; // Wait for the heaters associated with the specified tool to reach their set temperatures
 	void GenerateTemperatureReport(StringRef& reply) const;				// Store a standard-format temperature report in reply
 	OutputBuffer *GenerateJsonStatusResponse(int type, int seq, ResponseSource source) const;	// Generate a M408 response
-	void CheckReportDue(GCodeBuffer& gb, StringRef& reply) const;		// Check whether we need to report temperatures or status
+	OutputBuffer *GenerateBinaryStatusFrame(bool wantFull);				// Generate a binary status frame for PanelDue
+	void CheckReportDue(GCodeBuffer& gb, StringRef& reply);				// Check whether we need to report temperatures or status
 
 	void SavePosition(RestorePoint& rp, const GCodeBuffer& gb) const;	// Save position to a restore point
 	void RestorePosition(const RestorePoint& rp, GCodeBuffer *gb);		// Restore user position from a restore point
@@ -288,6 +302,7 @@ private:
 	void ListTriggers(StringRef reply, TriggerInputsBitmap mask);		// Append a list of trigger inputs to a message
 	void CheckTriggers();												// Check for and execute triggers
 	void CheckFilament();												// Check for and respond to filament errors
+	void CheckJobQueue();												// Start the next queued job when the current one has finished
 	void CheckHeaterFault();											// Check for and respond to a heater fault, returning true if we should exit
 	void DoEmergencyStop();												// Execute an emergency stop
 
@@ -300,14 +315,25 @@ private:
 
 	void SetMappedFanSpeed();											// Set the speeds of fans mapped for the current tool
 	void SaveFanSpeeds();												// Save the speeds of all fans
+	bool TryPerMoveFanChange(GCodeBuffer& gb);							// Try to attach a simple fan speed change to the next move instead of queueing it
 
 	GCodeResult SetOrReportZProbe(GCodeBuffer& gb, StringRef &reply);	// Handle M558
 	GCodeResult DefineGrid(GCodeBuffer& gb, StringRef &reply);			// Define the probing grid, returning true if error
 	bool LoadHeightMap(GCodeBuffer& gb, StringRef& reply) const;		// Load the height map from file
 	bool SaveHeightMap(GCodeBuffer& gb, StringRef& reply) const;		// Save the height map to file
+	bool StartHeightMapSave(GCodeBuffer& gb);							// Open the height map file and start saving it in the background
+	bool FinishHeightMapSave(StringRef& reply);							// Close the height map file and report the outcome
+	bool StartStreamedHeightMapSave(GCodeBuffer& gb);					// Open the height map file so that rows can be streamed to it while probing continues
+	void ContinueStreamedHeightMapSave(size_t rowLimit);				// Write newly completed grid rows to the streamed height map file
+	void AbandonStreamedHeightMapSave();								// Close and delete a partially written streamed height map file
+	static bool HeightMapSaveTaskEntry(void *param, uint32_t deadline);	// Background task entry point for saving the height map
 	GCodeResult ProbeGrid(GCodeBuffer& gb, StringRef& reply);			// Start probing the grid, returning true if we didn't because of an error
+	GCodeResult ScanGrid(GCodeBuffer& gb, StringRef& reply);			// Start probing the grid in continuous-motion scanning mode
+	bool StartScanRow(GCodeBuffer& gb);									// Set up the move to the start of the next grid row to be scanned
+	void RecordScanPoint();												// Record a height sample at the current scan grid point
 	GCodeResult CheckOrConfigureTrigger(GCodeBuffer& gb, StringRef& reply, int code);	// Handle M581 and M582
 	GCodeResult UpdateFirmware(GCodeBuffer& gb, StringRef &reply);		// Handle M997
+	GCodeResult VerifyStagedFirmware(GCodeBuffer& gb, StringRef& reply);	// Handle M997 C: CRC-check the staged firmware binary without stopping the machine
 
 	bool WriteConfigOverrideFile(GCodeBuffer& gb, StringRef& reply, const char *fileName) const; // Write the config-override file
 	void CopyConfigFinalValues(GCodeBuffer& gb);						// Copy the feed rate etc. from the daemon to the input channels
@@ -322,7 +348,14 @@ private:
 	void EndSimulation(GCodeBuffer *gb);								// Restore positions etc. when exiting simulation mode
 	bool IsCodeQueueIdle() const;										// Return true if the code queue is idle
 
-	void SaveResumeInfo(bool wasPowerFailure);
+	void SaveResumeInfo(const RestorePoint& rp, const char *reason, bool logSuccess);	// Write the resume file for the state in 'rp'
+	bool WriteResumeInfoPrefix(FileStore *f, const char *reason);		// Write the slowly-changing part of the resume file
+	bool WriteResumeInfoSuffix(FileStore *f, const RestorePoint& rp);	// Write the position-dependent part of the resume file
+	void CheckPrintCheckpoint();										// Periodically save the resume file while printing
+#if HAS_VOLTAGE_MONITOR
+	void RefreshResumeFilePrefix();										// Keep a prefix-only resume file on the SD card while printing
+	void SaveResumeInfoAfterPowerFail();								// Complete or write the resume file following a power-fail pause
+#endif
 
 	const char* GetMachineModeString() const;							// Get the name of the current machine mode
 
@@ -353,12 +386,23 @@ private:
 	bool active;								// Live and running?
 	bool isPaused;								// true if the print has been paused manually or automatically
 	bool pausePending;							// true if we have been asked to pause but we are running a macro
+	bool frozenPauseActive;						// true if the print is paused with the unexecuted moves frozen in the movement queue instead of skipped
+	// State of a background height map save started by StartHeightMapSave
+	FileStore *heightMapSaveFile;				// the file being written, or nullptr
+	uint32_t heightMapSavePhase;				// how much of the grid has been written so far
+	bool heightMapSaveError;					// true if a write failed
+	char heightMapSaveFileName[FILENAME_LENGTH];	// the name of the file being written
+
+	uint32_t printCheckpointInterval;			// how often we save the resume file while printing, in bytes of file progress, 0 = never (configured by M597)
+	FilePosition lastCheckpointFilePos;			// the file position at which we last saved a checkpoint
 	bool runningConfigFile;						// We are running config.g during the startup process
 	bool doingToolChange;						// We are running tool change macros
 
 #if HAS_VOLTAGE_MONITOR
 	bool isPowerFailPaused;						// true if the print was paused automatically because of a power failure
 	char *powerFailScript;						// the commands run when there is a power failure
+	bool resumeFileIsPrefixOnly;				// true if the resume file on the SD card ends after the prefix, ready for the suffix to be appended
+	uint32_t whenResumeFilePrefixWritten;		// when we last refreshed the prefix-only resume file
 #endif
 
 	float currentUserPosition[MaxAxes];			// The current position of the axes as commanded by the input gcode, before accounting for tool offset and Z hop
@@ -366,6 +410,8 @@ private:
 
 	// The following contain the details of moves that the Move module fetches
 	RawMove moveBuffer;							// Move details to pass to Move class
+	bool machinePositionValid;					// true if moveBuffer.coords and currentUserPosition are up to date, so we need not re-fetch and transform them
+	uint32_t lastPositionChangeCount;			// the Move position change count when we last fetched the position
 	unsigned int segmentsLeft;					// The number of segments left to do in the current move, or 0 if no move available
 	unsigned int totalSegments;					// The total number of segments left in the complete move
 
@@ -374,14 +420,19 @@ private:
 	float moveFractionToSkip;
 	float firstSegmentFractionToSkip;
 
+	float segMoveIncrements[MaxAxes];			// the axis movement per segment of a segmented linear move, precomputed when the move is set up
+
 	float arcCentre[MaxAxes];
 	float arcRadius;
 	float arcCurrentAngle;
 	float arcAngleIncrement;
+	float arcCos, arcSin;						// the cosine and sine of the current arc angle, maintained incrementally
+	float arcIncrementCos, arcIncrementSin;		// the cosine and sine of the arc angle increment per segment
 	bool doingArcMove;
 
 	RestorePoint simulationRestorePoint;		// The position and feed rate when we started a simulation
 	RestorePoint pauseRestorePoint;				// The position and feed rate when we paused the print
+	RestorePoint frozenPauseRestorePoint;		// Where to replay the file from if we lose power while paused with the queue frozen
 	RestorePoint toolChangeRestorePoint;		// The position and feed rate when we freed a tool
 	size_t numTotalAxes;						// How many axes we have
 	size_t numVisibleAxes;						// How many axes are visible
@@ -397,6 +448,8 @@ private:
 	FileData fileToPrint;						// The next file to print
 	FilePosition fileOffsetToPrint;				// The offset to print from
 
+	DWORD printFileClusterMap[FileClusterMapSize];		// FAT cluster map for the file being printed, so that reads and seeks on it avoid FAT chain walks
+
 	FileStore* fileBeingWritten;				// A file to write G Codes (or sometimes HTML) to
 	FilePosition fileSize;						// Size of the file being written
 
@@ -407,10 +460,25 @@ private:
 	char axisLetters[MaxAxes + 1];				// The names of the axes, with a null terminator
 	bool limitAxes;								// Don't think outside the box.
 
+	// Named parameters for the flow control meta-commands, set by the 'set' meta-command. They survive across
+	// prints so that per-machine values can be established in config.g and used by parametric job files.
+	static const size_t MaxNamedParameters = 8;
+	static const size_t MaxParameterNameLength = 11;
+	struct NamedParameter
+	{
+		char name[MaxParameterNameLength + 1];
+		float value;
+	};
+	NamedParameter namedParameters[MaxNamedParameters];
+	size_t numNamedParameters;
+	NamedParameter *FindNamedParameter(const char *name);				// Look up a named parameter, returning nullptr if it does not exist
+
 	AxesBitmap toBeHomed;						// Bitmap of axes still to be homed
 	AxesBitmap axesHomed;						// Bitmap of which axes have been homed
 
 	float pausedFanSpeeds[NUM_FANS];			// Fan speeds when the print was paused or a tool change started
+	FansBitmap moveFanChangeMask;				// fans whose speed should change when the next move read by Move starts, 0 = none
+	float moveNewFanSpeed;						// the fan speed to apply to those fans
 	float lastDefaultFanSpeed;					// Last speed given in a M106 command with on fan number
 	float pausedDefaultFanSpeed;				// The speed of the default print cooling fan when the print was paused or a tool change started
 	float speedFactor;							// speed factor, including the conversion from mm/min to mm/sec, normally 1/60
@@ -425,8 +493,20 @@ private:
 	float g30zStoppedHeight;					// the height to report after running G30 S-1
 	float g30zHeightError;						// the height error last time we probed
 	uint32_t lastProbedTime;					// time in milliseconds that the probe was last triggered
+	float tapHeights[MaxProbeTaps];				// the height error recorded by each tap at the point we are probing
+	size_t tapsDone;							// how many taps we have recorded at the point we are probing
+	uint8_t batchProbeOrder[MaxProbePoints];	// the planned visit order for batch probing (G30 B parameter)
+	size_t batchProbeCount;						// how many points are in the batch, 0 = not batch probing
+	size_t batchProbeNext;						// the index into batchProbeOrder of the next point to visit
 	volatile bool zProbeTriggered;				// Set by the step ISR when a move is aborted because the Z probe is triggered
 	size_t gridXindex, gridYindex;				// Which grid probe point is next
+	size_t scanRowEndIndex;						// The index of the last grid point to be sampled in the row being scanned
+	size_t scanRowPointsLeft;					// How many points in the current row remain to be sampled
+	int32_t scanCalibrationReading;				// The Z probe reading at the probe trigger height during scan calibration
+	int32_t scanReferenceReading;				// The Z probe reading at the scanning height over the calibration point
+	float scanSensitivity;						// The change in Z probe reading per mm that the bed is closer to the probe
+	float scanReferenceHeightError;				// The height error measured at the calibration point by conventional probing
+	bool scanRowIncreasing;						// True if the row being scanned is sampled in the direction of increasing X
 	bool doingManualBedProbe;					// true if we are waiting for the user to jog the nozzle until it touches the bed
 	bool probeIsDeployed;						// true if M401 has been used to deploy the probe and M402 has not yet been used t0 retract it
 
@@ -454,12 +534,22 @@ private:
 	// Code queue
 	GCodeQueue *codeQueue;						// Stores certain codes for deferred execution
 
+	// Job queue
+	JobQueue *jobQueue;							// The list of SD files to print one after another
+	bool startNextJobPending;					// true if the current job finished normally and the next queued job should be started
+	bool nextJobMacroRunning;					// true if we have started the setup macro for the next queued job
+
 	// SHA1 hashing
 	FileStore *fileBeingHashed;
 	SHA1Context hash;
 	bool StartHash(const char* filename);
 	GCodeResult AdvanceHash(StringRef &reply);
 
+	// Staged firmware verification (M997 C parameter)
+	FileStore *firmwareBeingVerified;
+	CRC32 firmwareVerifyCrc;
+	uint32_t firmwareExpectedCrc;
+
 	// Filament monitoring
 	FilamentSensorStatus lastFilamentError;
 	size_t lastFilamentErrorExtruder;
@@ -478,6 +568,8 @@ private:
 	uint32_t lastWarningMillis;					// When we last sent a warning message for things that can happen very often
 	AxesBitmap axesToSenseLength;				// The axes on which we are performing axis length sensing
 	int8_t lastAuxStatusReportType;				// The type of the last status report requested by PanelDue
+	bool auxBinaryStatusMode;					// True if PanelDue has negotiated binary status frames (M408 B parameter)
+	uint32_t auxBinarySentSeq;					// The newest journal sequence number already sent in a binary frame
 	bool isWaiting;								// True if waiting to reach temperature
 	bool cancelWait;							// Set true to cancel waiting
 	bool displayNoToolWarning;					// True if we need to display a 'no tool selected' warning
@@ -11,6 +11,7 @@
 
 #include "GCodeBuffer.h"
 #include "GCodeQueue.h"
+#include "JobQueue.h"
 #include "Heating/Heat.h"
 #include "Movement/Move.h"
 #include "Network.h"
@@ -20,6 +21,8 @@
 #include "Tools/Tool.h"
 #include "FilamentSensors/FilamentSensor.h"
 #include "Libraries/General/IP4String.h"
+#include "EventTrace.h"
+#include "DebugRouting.h"
 
 #if SUPPORT_IOBITS
 # include "PortControl.h"
@@ -35,6 +38,24 @@
 // It is called repeatedly for a given code until it returns true for that code.
 bool GCodes::ActOnCode(GCodeBuffer& gb, StringRef& reply)
 {
+	// Command activity means motion may be about to resume, so if the motors are in idle hold,
+	// restore their currents now rather than when the first move is prepared
+	reprap.GetMove().WakeFromIdleHold();
+
+	// Deal with flow control meta-commands, and discard ordinary commands if we are inside a false conditional block
+	if (ProcessMetaCommand(gb, reply))
+	{
+		return true;
+	}
+
+	// Simple fan speed changes are attached to the next move instead of being queued, so that they take
+	// effect exactly when the move they precede starts and don't occupy code queue space
+	if (gb.CanQueueCodes() && TryPerMoveFanChange(gb))
+	{
+		HandleReply(gb, false, "");
+		return true;
+	}
+
 	// Can we queue this code?
 	if (gb.CanQueueCodes() && codeQueue->QueueCode(gb, segmentsLeft))
 	{
@@ -42,6 +63,12 @@ bool GCodes::ActOnCode(GCodeBuffer& gb, StringRef& reply)
 		return true;
 	}
 
+	// Record the command in the event trace, for postmortem diagnostics
+	if (gb.HasCommandNumber())
+	{
+		EventTrace::Record(EventTrace::EventType::gcode, (uint8_t)gb.GetCommandLetter(), (uint16_t)gb.GetCommandNumber());
+	}
+
 	// G29 string parameters may contain the letter M, and various M-code string parameters may contain the letter G.
 	// So we now look for the first G, M or T in the command.
 	switch (gb.GetCommandLetter())
@@ -72,6 +99,425 @@ bool GCodes::ActOnCode(GCodeBuffer& gb, StringRef& reply)
 	return true;
 }
 
+// Match a keyword at the start of a meta-command line. If it matches, advance 's' past the keyword and any
+// following spaces and return true. The keywords are lower case so that they can never be confused with commands.
+static bool MatchKeyword(const char *&s, const char *keyword)
+{
+	const size_t len = strlen(keyword);
+	if (strncmp(s, keyword, len) == 0 && (s[len] == 0 || s[len] == ' ' || s[len] == '\t'))
+	{
+		s += len;
+		while (*s == ' ' || *s == '\t')
+		{
+			++s;
+		}
+		return true;
+	}
+	return false;
+}
+
+// Deal with a flow control meta-command (set/if/else/endif/while/endwhile), returning true if the line has been
+// handled. That includes the case where the line is an ordinary command but we are inside a conditional block
+// whose condition was false, in which case the line is discarded. The conditions are evaluated when the line is
+// read, so one parametric job file can replace many host-expanded variants at negligible runtime cost.
+bool GCodes::ProcessMetaCommand(GCodeBuffer& gb, StringRef& reply)
+{
+	const char *s = gb.Buffer();
+	while (*s == ' ' || *s == '\t')
+	{
+		++s;
+	}
+
+	GCodeMachineState& ms = gb.MachineState();
+	bool error = false;
+
+	if (MatchKeyword(s, "if"))
+	{
+		if (ms.blockNesting == GCodeMachineState::MaxBlockNesting)
+		{
+			reply.copy("Blocks nested too deeply");
+			++ms.overflowedBlocks;						// remember to consume the matching 'endif', else the nesting bookkeeping desynchronizes
+			error = true;
+		}
+		else
+		{
+			++ms.blockNesting;
+			ms.whileBits &= ~(1u << (ms.blockNesting - 1));
+			if (ms.skipLevel == 0)
+			{
+				bool cond;
+				if (!EvaluateCondition(s, cond, reply))
+				{
+					ms.skipLevel = ms.blockNesting;			// on a bad condition, report the error and skip the block
+					error = true;
+				}
+				else if (!cond)
+				{
+					ms.skipLevel = ms.blockNesting;
+				}
+			}
+		}
+	}
+	else if (MatchKeyword(s, "while"))
+	{
+		if (ms.blockNesting == GCodeMachineState::MaxBlockNesting)
+		{
+			reply.copy("Blocks nested too deeply");
+			++ms.overflowedBlocks;						// remember to consume the matching 'endwhile'
+			error = true;
+		}
+		else
+		{
+			++ms.blockNesting;
+			ms.whileBits |= (1u << (ms.blockNesting - 1));
+			if (ms.skipLevel == 0)
+			{
+				const FilePosition startPos = gb.GetFilePosition(fileInput->BytesCached());
+				bool cond;
+				if (startPos == noFilePosition)
+				{
+					reply.copy("'while' can only be used in a file");
+					ms.skipLevel = ms.blockNesting;
+					error = true;
+				}
+				else if (!EvaluateCondition(s, cond, reply))
+				{
+					ms.skipLevel = ms.blockNesting;
+					error = true;
+				}
+				else
+				{
+					ms.blockStartPos[ms.blockNesting - 1] = startPos;
+					if (!cond)
+					{
+						ms.skipLevel = ms.blockNesting;
+					}
+				}
+			}
+		}
+	}
+	else if (MatchKeyword(s, "else"))
+	{
+		if (ms.blockNesting == 0 || (ms.whileBits & (1u << (ms.blockNesting - 1))) != 0)
+		{
+			reply.copy("'else' without matching 'if'");
+			error = true;
+		}
+		else if (ms.skipLevel == ms.blockNesting)
+		{
+			ms.skipLevel = 0;								// the 'if' branch was skipped, so execute this one
+		}
+		else if (ms.skipLevel == 0)
+		{
+			ms.skipLevel = ms.blockNesting;					// the 'if' branch was executed, so skip this one
+		}
+		// else an outer block is being skipped, so there is nothing to do
+	}
+	else if (MatchKeyword(s, "endif"))
+	{
+		if (ms.overflowedBlocks != 0)
+		{
+			--ms.overflowedBlocks;						// this terminator closes a block that was rejected as nested too deeply
+		}
+		else if (ms.blockNesting == 0 || (ms.whileBits & (1u << (ms.blockNesting - 1))) != 0)
+		{
+			reply.copy("'endif' without matching 'if'");
+			error = true;
+		}
+		else
+		{
+			if (ms.skipLevel == ms.blockNesting)
+			{
+				ms.skipLevel = 0;
+			}
+			--ms.blockNesting;
+		}
+	}
+	else if (MatchKeyword(s, "endwhile"))
+	{
+		if (ms.overflowedBlocks != 0)
+		{
+			--ms.overflowedBlocks;						// this terminator closes a block that was rejected as nested too deeply
+		}
+		else if (ms.blockNesting == 0 || (ms.whileBits & (1u << (ms.blockNesting - 1))) == 0)
+		{
+			reply.copy("'endwhile' without matching 'while'");
+			error = true;
+		}
+		else if (ms.skipLevel == 0)
+		{
+			// The loop body was executed, so go round again. Seeking back to the 'while' line re-evaluates the condition.
+			ms.fileState.Seek(ms.blockStartPos[ms.blockNesting - 1]);
+			fileInput->Reset();
+			--ms.blockNesting;
+		}
+		else
+		{
+			if (ms.skipLevel == ms.blockNesting)
+			{
+				ms.skipLevel = 0;							// the condition was false, so the loop is finished
+			}
+			--ms.blockNesting;
+		}
+	}
+	else if (MatchKeyword(s, "set"))
+	{
+		if (ms.skipLevel != 0)
+		{
+			// Inside a false conditional block; fall through to the acknowledgement without executing
+		}
+		else if (*s == 0)
+		{
+			// Plain 'set' lists the named parameters
+			if (numNamedParameters == 0)
+			{
+				reply.copy("No named parameters are set");
+			}
+			else
+			{
+				for (size_t i = 0; i < numNamedParameters; ++i)
+				{
+					if (i == 0)
+					{
+						reply.printf("%s=%.2f", namedParameters[i].name, (double)namedParameters[i].value);
+					}
+					else
+					{
+						reply.catf(", %s=%.2f", namedParameters[i].name, (double)namedParameters[i].value);
+					}
+				}
+			}
+		}
+		else
+		{
+			// Read the parameter name
+			char name[MaxParameterNameLength + 1];
+			size_t nameLen = 0;
+			while (islower(*s) || isdigit(*s) || *s == '_')
+			{
+				if (nameLen < MaxParameterNameLength)
+				{
+					name[nameLen++] = *s;
+				}
+				++s;
+			}
+			name[nameLen] = 0;
+			float val;
+			if (nameLen == 0)
+			{
+				reply.copy("Bad parameter name");
+				error = true;
+			}
+			else if (!EvaluateExpression(s, val, reply))
+			{
+				error = true;
+			}
+			else
+			{
+				NamedParameter *np = FindNamedParameter(name);
+				if (np == nullptr)
+				{
+					if (numNamedParameters == MaxNamedParameters)
+					{
+						reply.copy("Too many named parameters");
+						error = true;
+					}
+					else
+					{
+						np = &namedParameters[numNamedParameters++];
+						SafeStrncpy(np->name, name, ARRAY_SIZE(np->name));
+					}
+				}
+				if (np != nullptr)
+				{
+					np->value = val;
+				}
+			}
+		}
+	}
+	else
+	{
+		if (ms.skipLevel == 0)
+		{
+			return false;				// not a meta-command and we are not skipping, so process it as an ordinary command
+		}
+		// Discard ordinary commands when we are inside a false conditional block. They must still be
+		// acknowledged, else a host streaming the file over USB or Telnet stalls waiting for the response.
+		HandleReply(gb, false, "");
+		return true;
+	}
+
+	HandleReply(gb, error, reply.Pointer());
+	return true;
+}
+
+// Evaluate a comparison of two operands for an 'if' or 'while' meta-command
+bool GCodes::EvaluateCondition(const char *&s, bool& result, StringRef& reply)
+{
+	float lhs, rhs;
+	if (!EvaluateOperand(s, lhs, reply))
+	{
+		return false;
+	}
+	while (*s == ' ' || *s == '\t')
+	{
+		++s;
+	}
+
+	enum class CompareOp { lt, le, gt, ge, eq, ne } op;
+	switch (*s)
+	{
+	case '<':
+		++s;
+		op = (*s == '=') ? (++s, CompareOp::le) : (*s == '>') ? (++s, CompareOp::ne) : CompareOp::lt;
+		break;
+	case '>':
+		++s;
+		op = (*s == '=') ? (++s, CompareOp::ge) : CompareOp::gt;
+		break;
+	case '=':
+		++s;
+		if (*s == '=')
+		{
+			++s;
+		}
+		op = CompareOp::eq;
+		break;
+	case '!':
+		++s;
+		if (*s != '=')
+		{
+			reply.copy("Bad comparison operator");
+			return false;
+		}
+		++s;
+		op = CompareOp::ne;
+		break;
+	default:
+		reply.copy("Bad comparison operator");
+		return false;
+	}
+
+	if (!EvaluateOperand(s, rhs, reply))
+	{
+		return false;
+	}
+
+	switch (op)
+	{
+	case CompareOp::lt:	result = (lhs < rhs); break;
+	case CompareOp::le:	result = (lhs <= rhs); break;
+	case CompareOp::gt:	result = (lhs > rhs); break;
+	case CompareOp::ge:	result = (lhs >= rhs); break;
+	case CompareOp::eq:	result = (lhs == rhs); break;
+	case CompareOp::ne:	result = (lhs != rhs); break;
+	}
+	return true;
+}
+
+// Evaluate a value expression for a 'set' meta-command: an operand optionally combined with a second one by an arithmetic operator
+bool GCodes::EvaluateExpression(const char *&s, float& value, StringRef& reply)
+{
+	if (!EvaluateOperand(s, value, reply))
+	{
+		return false;
+	}
+	while (*s == ' ' || *s == '\t')
+	{
+		++s;
+	}
+	if (*s == '+' || *s == '-' || *s == '*' || *s == '/')
+	{
+		const char op = *s++;
+		float rhs;
+		if (!EvaluateOperand(s, rhs, reply))
+		{
+			return false;
+		}
+		switch (op)
+		{
+		case '+':	value += rhs; break;
+		case '-':	value -= rhs; break;
+		case '*':	value *= rhs; break;
+		case '/':	value /= rhs; break;
+		}
+	}
+	return true;
+}
+
+// Evaluate one operand of a meta-command expression: a numeric constant, a named parameter, an axis letter
+// giving the current user position of that axis, or 'tool' giving the current tool number.
+// Named parameters take precedence, so a parameter named after an axis hides that axis position.
+bool GCodes::EvaluateOperand(const char *&s, float& value, StringRef& reply)
+{
+	while (*s == ' ' || *s == '\t')
+	{
+		++s;
+	}
+
+	if (isdigit(*s) || *s == '.' || ((*s == '-' || *s == '+') && (isdigit(s[1]) || s[1] == '.')))
+	{
+		char *endptr;
+		value = (float)strtod(s, &endptr);
+		s = endptr;
+		return true;
+	}
+
+	char name[MaxParameterNameLength + 1];
+	size_t nameLen = 0;
+	while (islower(*s) || isdigit(*s) || *s == '_')
+	{
+		if (nameLen < MaxParameterNameLength)
+		{
+			name[nameLen++] = *s;
+		}
+		++s;
+	}
+	name[nameLen] = 0;
+
+	const NamedParameter * const np = FindNamedParameter(name);
+	if (np != nullptr)
+	{
+		value = np->value;
+		return true;
+	}
+
+	if (strcmp(name, "tool") == 0)
+	{
+		const Tool * const tool = reprap.GetCurrentTool();
+		value = (tool == nullptr) ? -1.0f : (float)tool->Number();
+		return true;
+	}
+
+	if (nameLen == 1)
+	{
+		for (size_t axis = 0; axis < numVisibleAxes; ++axis)
+		{
+			if (tolower(axisLetters[axis]) == name[0])
+			{
+				value = currentUserPosition[axis];
+				return true;
+			}
+		}
+	}
+
+	reply.printf("Unknown value '%s'", name);
+	return false;
+}
+
+// Look up a named parameter, returning nullptr if it does not exist
+GCodes::NamedParameter *GCodes::FindNamedParameter(const char *name)
+{
+	for (size_t i = 0; i < numNamedParameters; ++i)
+	{
+		if (strcmp(namedParameters[i].name, name) == 0)
+		{
+			return &namedParameters[i];
+		}
+	}
+	return nullptr;
+}
+
 bool GCodes::HandleGcode(GCodeBuffer& gb, StringRef& reply)
 {
 	GCodeResult result = GCodeResult::ok;
@@ -181,6 +627,10 @@ bool GCodes::HandleGcode(GCodeBuffer& gb, StringRef& reply)
 				result = GetGCodeResultFromError(LoadHeightMap(gb, reply));
 				break;
 
+			case 3:		// probe in continuous-motion scanning mode and save height map
+				result = ScanGrid(gb, reply);
+				break;
+
 			default:	// clear height map
 				reprap.GetMove().SetIdentityTransform();
 				break;
@@ -281,12 +731,17 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 		return true;			// when running M502 the only mcodes we execute are 301, 307, 558, 665 and 666
 	}
 
+	if (code >= 500)
+	{
+		return HandleConfigMcode(gb, reply, code);		// the handlers for M500 and above are in GCodes4.cpp
+	}
+
 	switch (code)
 	{
 	case 0: // Stop
 	case 1: // Sleep
 		if (   !LockMovementAndWaitForStandstill(gb)	// wait until everything has stopped
-			|| !IsCodeQueueIdle()						// must also wait until deferred command queue has caught up
+			|| (!IsCodeQueueIdle() && !frozenPauseActive)	// must also wait until deferred command queue has caught up, unless its codes belong to frozen moves that we are about to discard
 		   )
 		{
 			return false;
@@ -756,34 +1211,95 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 
 		// For case 32, see case 23
 
-	case 36:	// Return file information
-		if (!LockFileSystem(gb))									// getting file info takes several calls and isn't reentrant
+	case 33:	// Add a file to the job queue
+		if (!LockFileSystem(gb))									// the file info scan below takes several calls and isn't reentrant
 		{
 			return false;
 		}
 		{
 			String<FILENAME_LENGTH> filename;
-			const bool gotFilename = gb.GetUnprecedentedString(filename.GetRef());
-			OutputBuffer *fileInfoResponse;
-			const bool done = reprap.GetPrintMonitor().GetFileInfoResponse((gotFilename) ? filename.Pointer() : nullptr, fileInfoResponse);
-			if (done)
+			bool seen = false;
+			gb.TryGetPossiblyQuotedString('P', filename.GetRef(), seen);
+			if (!seen)
 			{
-				fileInfoResponse->cat('\n');
-				UnlockAll(gb);
-				HandleReply(gb, false, fileInfoResponse);
+				reply.copy("Missing file name");
+				result = GCodeResult::error;
+				break;
 			}
-			return done;
-		}
-		break;
 
-	case 37:	// Simulation mode on/off, or simulate a whole file
-		{
-			bool seen = false;
-			uint32_t newSimulationMode;
-			String<FILENAME_LENGTH> simFileName;
-
-			gb.TryGetPossiblyQuotedString('P', simFileName.GetRef(), seen);
-			if (seen)
+			// Scan the file for its print information now, so that the result is in the file info cache
+			// and starting the job later doesn't have to wait for the scan. This also verifies that the file exists.
+			GCodeFileInfo info;
+			if (!reprap.GetPrintMonitor().GetFileInfo(platform.GetGCodeDir(), filename.c_str(), info))
+			{
+				return false;										// scanning a large file takes several calls
+			}
+			if (!info.isValid)
+			{
+				reply.printf("GCode file \"%s\" not found", filename.c_str());
+				result = GCodeResult::error;
+				break;
+			}
+
+			String<FILENAME_LENGTH> macroName;
+			seen = false;
+			gb.TryGetQuotedString('S', macroName.GetRef(), seen);
+			if (jobQueue->Add(filename.c_str(), (seen) ? macroName.c_str() : nullptr, reply))
+			{
+				reply.printf("Job %s added to queue (%u queued)", filename.c_str(), jobQueue->GetNumJobs());
+			}
+			else
+			{
+				result = GCodeResult::error;
+			}
+		}
+		break;
+
+	case 34:	// Report or clear the job queue
+		{
+			uint32_t clearValue;
+			bool seen = false;
+			gb.TryGetUIValue('S', clearValue, seen);
+			if (seen && clearValue == 0)
+			{
+				jobQueue->Clear();
+				reply.copy("Job queue cleared");
+			}
+			else
+			{
+				jobQueue->ListJobs(reply);
+			}
+		}
+		break;
+
+	case 36:	// Return file information
+		if (!LockFileSystem(gb))									// getting file info takes several calls and isn't reentrant
+		{
+			return false;
+		}
+		{
+			String<FILENAME_LENGTH> filename;
+			const bool gotFilename = gb.GetUnprecedentedString(filename.GetRef());
+			OutputBuffer *fileInfoResponse;
+			const bool done = reprap.GetPrintMonitor().GetFileInfoResponse((gotFilename) ? filename.Pointer() : nullptr, fileInfoResponse);
+			if (done)
+			{
+				fileInfoResponse->cat('\n');
+				UnlockAll(gb);
+				HandleReply(gb, false, fileInfoResponse);
+			}
+			return done;
+		}
+		break;
+
+	case 37:	// Simulation mode on/off, or simulate a whole file
+		{
+			bool seen = false;
+			uint32_t newSimulationMode;
+			String<FILENAME_LENGTH> simFileName;
+
+			gb.TryGetPossiblyQuotedString('P', simFileName.GetRef(), seen);
+			if (seen)
 			{
 				newSimulationMode = 1;			// default to simulation mode 1 when a filename is given
 			}
@@ -850,6 +1366,7 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 			{
 				reply.printf("Simulation mode: %s, move time: %.1f sec, other time: %.1f sec",
 						(simulationMode != 0) ? "on" : "off", (double)reprap.GetMove().GetSimulationTime(), (double)simulationTime);
+				reprap.GetMove().AppendSimulationPhaseTimes(reply);
 			}
 		}
 		break;
@@ -1259,22 +1776,60 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 		break;
 
 	case 111: // Debug level
-		if (gb.Seen('S'))
 		{
-			const bool dbv = (gb.GetIValue() != 0);
-			if (gb.Seen('P'))
+			bool seen = false;
+			if (gb.Seen('S'))
+			{
+				const bool dbv = (gb.GetIValue() != 0);
+				if (gb.Seen('P'))
+				{
+					reprap.SetDebug(static_cast<Module>(gb.GetIValue()), dbv);
+				}
+				else
+				{
+					reprap.SetDebug(dbv);
+				}
+				seen = true;
+			}
+			if (gb.Seen('V'))
 			{
-				reprap.SetDebug(static_cast<Module>(gb.GetIValue()), dbv);
+				// Set the debug level for one module or all of them, finer-grained than the S on/off switch
+				const DebugLevel level = (DebugLevel)constrain<int32_t>(gb.GetIValue(), 0, (int32_t)DebugLevel::verbose);
+				if (gb.Seen('P'))
+				{
+					DebugRouting::SetLevel(static_cast<Module>(gb.GetIValue()), level);
+				}
+				else
+				{
+					for (size_t i = 0; i < numModules; ++i)
+					{
+						DebugRouting::SetLevel((Module)i, level);
+					}
+				}
+				seen = true;
 			}
-			else
+			if (gb.Seen('D'))
+			{
+				// Select the sinks that debug messages are routed to: bit 0 = USB, bit 1 = trace buffer, bit 2 = log file
+				const uint8_t sinkMask = (uint8_t)gb.GetIValue();
+				if (gb.Seen('P'))
+				{
+					DebugRouting::SetSinks(static_cast<Module>(gb.GetIValue()), sinkMask);
+				}
+				else
+				{
+					for (size_t i = 0; i < numModules; ++i)
+					{
+						DebugRouting::SetSinks((Module)i, sinkMask);
+					}
+				}
+				seen = true;
+			}
+			if (!seen)
 			{
-				reprap.SetDebug(dbv);
+				reprap.PrintDebug();
 			}
 		}
-		else
-		{
-			reprap.PrintDebug();
-		}
 		break;
 
 	case 112: // Emergency stop - acted upon in Webserver, but also here in case it comes from USB etc.
@@ -1426,6 +1981,22 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 
 	case 122:
 		{
+			bool seen = false;
+			if (gb.Seen('S'))
+			{
+				reprap.SetSpinBudget(gb.GetUIValue());	// set the soft watchdog spin time budget in milliseconds
+				seen = true;
+			}
+			if (gb.Seen('D'))
+			{
+				reprap.SetSpinOverrunDeferral(gb.GetIValue() > 0);
+				seen = true;
+			}
+			if (seen)
+			{
+				break;
+			}
+
 			const int val = (gb.Seen('P')) ? gb.GetIValue() : 0;
 			if (val == 0)
 			{
@@ -1439,9 +2010,30 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 		break;
 
 	case 135: // Set PID sample interval
-		if (gb.Seen('S'))
+		if (gb.Seen('P'))
+		{
+			// Set or report the sample interval for one heater, leaving the others alone
+			const int heater = gb.GetIValue();
+			if (heater < 0 || heater >= (int)Heaters)
+			{
+				reply.copy("Invalid heater number");
+				result = GCodeResult::error;
+			}
+			else if (gb.Seen('S'))
+			{
+				// Keep the interval well below maxPidSpinDelay, else the tick ISR watchdog would treat the
+				// slowly-sampled heater as failed and pin it off
+				reprap.GetHeat().SetSampleInterval(heater, (uint32_t)constrain<int32_t>(gb.GetIValue(), 1, (int32_t)(maxPidSpinDelay/2)));
+			}
+			else
+			{
+				reply.printf("Heat sample interval for heater %d is %" PRIu32 "ms", heater, reprap.GetHeat().GetSampleInterval(heater));
+			}
+		}
+		else if (gb.Seen('S'))
 		{
 			platform.SetHeatSampleTime(gb.GetFValue() * 0.001);  // Value is in milliseconds; we want seconds
+			reprap.GetHeat().ResetSampleIntervals();
 		}
 		else
 		{
@@ -1863,7 +2455,10 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 				{
 					moveBuffer.feedRate *= speedFactorRatio;
 				}
+				// Rescale the moves already in the movement queue too, so that the change doesn't wait for the queue to drain
+				reprap.GetMove().ApplySpeedFactorChange(speedFactorRatio);
 				speedFactor = newSpeedFactor;
+				reprap.RecordStateChange(ChangedField::speedFactor, 0, speedFactor * MinutesToSeconds * 100.0);	// the speed factor is omitted from differential status responses
 			}
 			else
 			{
@@ -1895,6 +2490,7 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 							moveBuffer.coords[extruder + numTotalAxes] *= extrusionFactor/extrusionFactors[extruder];	// last move not gone, so update it
 						}
 						extrusionFactors[extruder] = extrusionFactor;
+						reprap.RecordStateChange(ChangedField::extrusionFactor, extruder, extrusionFactor * 100.0);	// the extrusion factors are omitted from differential status responses
 					}
 				}
 				else
@@ -1968,9 +2564,11 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 			const float amountPushed = reprap.GetMove().PushBabyStepping(babyStepAmount);
 			moveBuffer.initialCoords[Z_AXIS] += amountPushed;
 
-			// The following causes all the remaining baby stepping that we didn't manage to push to be added to the [remainder of the] currently-executing move, if there is one.
-			// This could result in an abrupt Z movement, however the move will be processed as normal so the jerk limit will be honoured.
+			// Move folds the offset into forthcoming moves a bounded amount at a time, so as far as the GCode state is
+			// concerned the whole offset takes effect immediately. Adjust the current target to match, so that the offset
+			// doesn't show up as a spurious Z component of the next commanded move.
 			moveBuffer.coords[Z_AXIS] += babyStepAmount;
+			reprap.StatusChanged();					// the babystep offset is omitted from differential status responses
 		}
 		else
 		{
@@ -2139,7 +2737,7 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 					maxPwm = model.GetMaxPwm(),
 					voltage = model.GetVoltage();
 				uint32_t freq = model.GetPwmFrequency();
-				int32_t dontUsePid = model.UsePid() ? 0 : 1;
+				int32_t dontUsePid = (!model.UsePid()) ? 1 : (model.UsesFeedForward()) ? 2 : 0;
 				int32_t inversionParameter = 0;
 
 				gb.TryGetFValue('A', gain, seen);
@@ -2155,10 +2753,15 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 				{
 					const bool inverseTemperatureControl = (inversionParameter == 1 || inversionParameter == 3);
 					if (!reprap.GetHeat().SetHeaterModel(heater, gain, tc, td, maxPwm, voltage,
-															dontUsePid == 0, inverseTemperatureControl, (uint16_t)min<uint32_t>(freq, MaxHeaterPwmFrequency)))
+															dontUsePid != 1, inverseTemperatureControl, (uint16_t)min<uint32_t>(freq, MaxHeaterPwmFrequency)))
 					{
 						reply.copy("Error: bad model parameters");
 					}
+					else
+					{
+						// B2 selects PID with the model supplying a feed-forward term
+						reprap.GetHeat().SetHeaterFeedForward(heater, dontUsePid == 2);
+					}
 
 					const bool invertedPwmSignal = (inversionParameter == 2 || inversionParameter == 3);
 					reprap.GetHeat().SetHeaterSignalInverted(heater, invertedPwmSignal);
@@ -2170,8 +2773,9 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 				else
 				{
 					const char* mode = (!model.UsePid()) ? "bang-bang"
-										: (model.ArePidParametersOverridden()) ? "custom PID"
-											: "PID";
+										: (model.UsesFeedForward()) ? "feed-forward + PID"
+											: (model.ArePidParametersOverridden()) ? "custom PID"
+												: "PID";
 					const bool pwmSignalInverted = reprap.GetHeat().IsHeaterSignalInverted(heater);
 					const char* inverted = model.IsInverted()
 											? (pwmSignalInverted ? "PWM signal and temperature control" : "temperature control")
@@ -2352,9 +2956,18 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 			if (&gb == auxGCode)
 			{
 				lastAuxStatusReportType = type;
+				if (gb.Seen('B'))
+				{
+					// Negotiate the compact binary frame protocol. The reply to the negotiating command is
+					// the first frame, so a panel that doesn't understand frames simply never sends B1.
+					auxBinaryStatusMode = (gb.GetIValue() > 0);
+				}
 			}
 
-			OutputBuffer * const statusResponse = GenerateJsonStatusResponse(type, seq, (&gb == auxGCode) ? ResponseSource::AUX : ResponseSource::Generic);
+			// An explicit M408 in binary mode always gets a full frame, so the panel can use it to resynchronise
+			OutputBuffer * const statusResponse = (&gb == auxGCode && auxBinaryStatusMode)
+													? GenerateBinaryStatusFrame(true)
+													: GenerateJsonStatusResponse(type, seq, (&gb == auxGCode) ? ResponseSource::AUX : ResponseSource::Generic);
 
 			if (statusResponse != nullptr)
 			{
@@ -2437,1654 +3050,80 @@ bool GCodes::HandleMcode(GCodeBuffer& gb, StringRef& reply)
 		}
 		break;
 
-	case 500: // Store parameters in EEPROM
-		result = GetGCodeResultFromError(WriteConfigOverrideFile(gb, reply, CONFIG_OVERRIDE_G));
-		break;
-
-	case 501: // Load parameters from EEPROM
-		DoFileMacro(gb, "config-override.g", true, code);
-		break;
-
-	case 502: // Revert to default "factory settings"
-		reprap.GetHeat().ResetHeaterModels();							// in case some heaters have no M307 commands in config.g
-		reprap.GetMove().GetKinematics().SetCalibrationDefaults();		// in case M665/M666/M667/M669 in config.g don't define all the parameters
-		platform.SetZProbeDefaults();
-		DoFileMacro(gb, "config.g", true, code);
+	default:
+		reply.copy("Unsupported command");
+		result = GCodeResult::error;
 		break;
+	}
 
-	case 503: // List variable settings
-		{
-			if (!LockFileSystem(gb))
-			{
-				return false;
-			}
-
-			// Need a valid output buffer to continue...
-			OutputBuffer *configResponse;
-			if (!OutputBuffer::Allocate(configResponse))
-			{
-				// No buffer available, try again later
-				return false;
-			}
-
-			// Read the entire file
-			FileStore * const f = platform.OpenFile(platform.GetSysDir(), platform.GetConfigFile(), OpenMode::read);
-			if (f == nullptr)
-			{
-				reply.copy("Configuration file not found");
-				result = GCodeResult::error;
-			}
-			else
-			{
-				char fileBuffer[FILE_BUFFER_SIZE];
-				size_t bytesRead,
-					bytesLeftForWriting = OutputBuffer::GetBytesLeft(configResponse);
-				while ((bytesRead = f->Read(fileBuffer, FILE_BUFFER_SIZE)) > 0 && bytesLeftForWriting > 0)
-				{
-					// Don't write more data than we can process
-					if (bytesRead < bytesLeftForWriting)
-					{
-						bytesLeftForWriting -= bytesRead;
-					}
-					else
-					{
-						bytesRead = bytesLeftForWriting;
-						bytesLeftForWriting = 0;
-					}
+	return FinishedMcode(gb, reply, code, result);
+}
 
-					// Write it
-					configResponse->cat(fileBuffer, bytesRead);
-				}
-				f->Close();
+// Common tail handling for M codes, shared between HandleMcode and HandleConfigMcode.
+// Return true if the command has been completed, false if it needs to be called again.
+bool GCodes::FinishedMcode(GCodeBuffer& gb, StringRef& reply, const int code, GCodeResult result)
+{
+	if (result == GCodeResult::notFinished)
+	{
+		return false;
+	}
 
-				UnlockAll(gb);
-				HandleReply(gb, false, configResponse);
-				return true;
-			}
-		}
-		break;
+	if (result == GCodeResult::notSupportedInCurrentMode)
+	{
+		reply.printf("M%d command is not supported in machine mode %s", code, GetMachineModeString());
+	}
 
-	case 540: // Set/report MAC address
-		if (gb.Seen('P'))
-		{
-			uint8_t mac[6];
-			if (gb.GetMacAddress(mac))
-			{
-				platform.SetMACAddress(mac);
-			}
-			else
-			{
-				reply.copy("Bad MAC address");
-				result = GCodeResult::error;
-			}
-		}
-		else
+	if (gb.GetState() == GCodeState::normal)
+	{
+		gb.timerRunning = false;
+		UnlockAll(gb);
+		if (result == GCodeResult::error)
 		{
-			const uint8_t *mac = platform.MACAddress();
-			reply.printf("MAC: %02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+			scratchString.printf("M%d: ", code);
+			reply.Prepend(scratchString.Pointer());
 		}
-		break;
+		HandleReply(gb, result != GCodeResult::ok, reply.Pointer());
+	}
+	return true;
+}
 
-	case 550: // Set/report machine name
-		{
-			String<MACHINE_NAME_LENGTH> name;
-			bool seen = false;
-			gb.TryGetPossiblyQuotedString('P', name.GetRef(), seen);
-			if (seen)
-			{
-				reprap.SetName(name.c_str());
-			}
-			else
-			{
-				reply.printf("RepRap name: %s", reprap.GetName());
-			}
-		}
-		break;
+bool GCodes::HandleTcode(GCodeBuffer& gb, StringRef& reply)
+{
+	if (gb.MachineState().runningM502)
+	{
+		return true;			// when running M502 we don't execute T commands
+	}
+
+	bool seen = false;
+	int toolNum;
+	if (gb.HasCommandNumber())
+	{
+		seen = true;
+		toolNum = gb.GetCommandNumber();
+		toolNum += gb.GetToolNumberAdjust();
+	}
+	else if (gb.Seen('R') && gb.GetIValue() == 1)
+	{
+		seen = true;
+		toolNum = pauseRestorePoint.toolNumber;
+	}
 
-	case 551: // Set password (no option to report it)
+	if (seen)
+	{
+		const Tool * const oldTool = reprap.GetCurrentTool();
+		if (simulationMode == 0 && (oldTool == nullptr || oldTool->Number() != toolNum))
 		{
-			String<PASSWORD_LENGTH> password;
-			bool seen = false;
-			gb.TryGetPossiblyQuotedString('P', password.GetRef(), seen);
-			if (seen)
-			{
-				reprap.SetPassword(password.c_str());
-			}
+			// Start the new tool's heaters ramping up now, so that the heating overlaps the wait for
+			// outstanding moves to complete and the tool change macros instead of starting after them.
+			// This gets called again on each spin until the machine is idle, but PreheatTool is cheap to repeat.
+			reprap.PreheatTool(toolNum);
 		}
-		break;
 
-	case 552: // Enable/Disable network and/or Set/Get IP address
+		if (!LockMovementAndWaitForStandstill(gb))
 		{
-			bool seen = false;
-
-#if HAS_MULTIPLE_NETWORK_INTERFACES
-			const int interface = (gb.Seen('I') ? gb.GetIValue() : 0);
-
-			if (reprap.GetNetwork().IsWiFiInterface(interface))
-			{
-				if (gb.Seen('S')) // Has the user turned the network on or off?
-				{
-					const int enableValue = gb.GetIValue();
-					seen = true;
+			return false;
+		}
 
-					char ssidBuffer[SsidLength + 1];
-					StringRef ssid(ssidBuffer, ARRAY_SIZE(ssidBuffer));
-					if (gb.Seen('P') && !gb.GetQuotedString(ssid))
-					{
-						reply.copy("Bad or missing SSID");
-						result = GCodeResult::error;
-					}
-					else
-					{
-						reprap.GetNetwork().EnableWiFi(enableValue, ssid, reply);
-					}
-				}
-			}
-			else
-			{
-				if (gb.Seen('P'))
-				{
-					seen = true;
-					uint8_t eth[4];
-					if (gb.GetIPAddress(eth))
-					{
-						platform.SetIPAddress(eth);
-					}
-					else
-					{
-						reply.copy("Bad IP address");
-						result = GCodeResult::error;
-						break;
-					}
-				}
-
-				// Process this one last in case the IP address is changed and the network enabled in the same command
-				if (gb.Seen('S')) // Has the user turned the network on or off?
-				{
-					seen = true;
-					reprap.GetNetwork().EnableEthernet(gb.GetIValue(), reply);
-				}
-			}
-#elif HAS_WIFI_NETWORKING
-			if (gb.Seen('S')) // Has the user turned the network on or off?
-			{
-				const int enableValue = gb.GetIValue();
-				seen = true;
-
-				char ssidBuffer[SsidLength + 1];
-				StringRef ssid(ssidBuffer, ARRAY_SIZE(ssidBuffer));
-				if (gb.Seen('P') && !gb.GetQuotedString(ssid))
-				{
-					reply.copy("Bad or missing SSID");
-					result = GCodeResult::error;
-				}
-				else
-				{
-					reprap.GetNetwork().Enable(enableValue, ssid, reply);
-				}
-			}
-#else
-			if (gb.Seen('P'))
-			{
-				seen = true;
-				uint8_t eth[4];
-				if (gb.GetIPAddress(eth))
-				{
-					platform.SetIPAddress(eth);
-				}
-				else
-				{
-					reply.copy("Bad IP address");
-					result = GCodeResult::error;
-					break;
-				}
-			}
-
-			// Process this one last in case the IP address is changed and the network enabled in the same command
-			if (gb.Seen('S')) // Has the user turned the network on or off?
-			{
-				seen = true;
-				reprap.GetNetwork().Enable(gb.GetIValue(), reply);
-			}
-#endif
-
-			if (!seen)
-			{
-#if HAS_MULTIPLE_NETWORK_INTERFACES
-				result = GetGCodeResultFromError(reprap.GetNetwork().GetNetworkState(interface, reply));
-#else
-				result = GetGCodeResultFromError(reprap.GetNetwork().GetNetworkState(reply));
-#endif
-			}
-		}
-		break;
-
-	case 553: // Set/Get netmask
-		if (gb.Seen('P'))
-		{
-			uint8_t eth[4];
-			if (gb.GetIPAddress(eth))
-			{
-				platform.SetNetMask(eth);
-			}
-			else
-			{
-				reply.copy("Bad IP address");
-				result = GCodeResult::error;
-			}
-		}
-		else
-		{
-			const uint8_t * const nm = platform.NetMask();
-			reply.printf("Net mask: %d.%d.%d.%d ", nm[0], nm[1], nm[2], nm[3]);
-		}
-		break;
-
-	case 554: // Set/Get gateway
-		if (gb.Seen('P'))
-		{
-			uint8_t eth[4];
-			if (gb.GetIPAddress(eth))
-			{
-				platform.SetGateWay(eth);
-			}
-			else
-			{
-				reply.copy("Bad IP address");
-				result = GCodeResult::error;
-			}
-		}
-		else
-		{
-			const uint8_t * const gw = platform.GateWay();
-			reply.printf("Gateway: %d.%d.%d.%d ", gw[0], gw[1], gw[2], gw[3]);
-		}
-		break;
-
-	case 555: // Set/report firmware type to emulate
-		if (gb.Seen('P'))
-		{
-			platform.SetEmulating((Compatibility) gb.GetIValue());
-		}
-		else
-		{
-			reply.copy("Emulating ");
-			switch (platform.Emulating())
-			{
-			case me:
-			case reprapFirmware:
-				reply.cat("RepRap Firmware (i.e. in native mode)");
-				break;
-
-			case marlin:
-				reply.cat("Marlin");
-				break;
-
-			case teacup:
-				reply.cat("Teacup");
-				break;
-
-			case sprinter:
-				reply.cat("Sprinter");
-				break;
-
-			case repetier:
-				reply.cat("Repetier");
-				break;
-
-			default:
-				reply.catf("Unknown: (%d)", platform.Emulating());
-			}
-		}
-		break;
-
-	case 556: // Axis compensation (we support only X, Y, Z)
-		if (gb.Seen('S'))
-		{
-			const float value = gb.GetFValue();
-			for (size_t axis = 0; axis <= Z_AXIS; axis++)
-			{
-				if (gb.Seen(axisLetters[axis]))
-				{
-					reprap.GetMove().SetAxisCompensation(axis, gb.GetFValue() / value);
-				}
-			}
-		}
-		else
-		{
-			reply.printf("Axis compensations - XY: %.5f, YZ: %.5f, ZX: %.5f",
-				(double)reprap.GetMove().AxisCompensation(X_AXIS), (double)reprap.GetMove().AxisCompensation(Y_AXIS), (double)reprap.GetMove().AxisCompensation(Z_AXIS));
-		}
-		break;
-
-	case 557: // Set/report Z probe point coordinates
-		result = DefineGrid(gb, reply);
-		break;
-
-	case 558: // Set or report Z probe type and for which axes it is used
-		result = SetOrReportZProbe(gb, reply);
-		break;
-
-	case 559:
-	case 560: // Binary writing
-	{
-		const char* folder = platform.GetSysDir();
-		const char* defaultFile = platform.GetConfigFile();
-		if (code == 560)
-		{
-			folder = platform.GetWebDir();
-			defaultFile = INDEX_PAGE_FILE;
-		}
-		String<FILENAME_LENGTH> filename;
-		if (gb.Seen('P'))
-		{
-			gb.GetPossiblyQuotedString(filename.GetRef());
-		}
-		else
-		{
-			filename.GetRef().copy(defaultFile);
-		}
-		const FilePosition size = (gb.Seen('S') ? (FilePosition)gb.GetIValue() : 0);
-		const uint32_t crc32 = (gb.Seen('C') ? gb.GetUIValue() : 0);
-		const bool ok = OpenFileToWrite(gb, folder, filename.Pointer(), size, true, crc32);
-		if (ok)
-		{
-			reply.printf("Writing to file: %s", filename.Pointer());
-		}
-		else
-		{
-			reply.printf("Can't open file %s for writing.", filename.Pointer());
-			result = GCodeResult::error;
-		}
-	}
-	break;
-
-	case 561: // Set identity transform (also clears bed probe grid)
-		reprap.GetMove().SetIdentityTransform();
-		break;
-
-	case 562: // Reset temperature fault - use with great caution
-		if (gb.Seen('P'))
-		{
-			const int heater = gb.GetIValue();
-			if (heater >= 0 && heater < (int)Heaters)
-			{
-				reprap.ClearTemperatureFault(heater);
-			}
-			else
-			{
-				reply.printf("Invalid heater number '%d'", heater);
-				result = GCodeResult::error;
-			}
-		}
-		else
-		{
-			// Clear all heater faults
-			for (int heater = 0; heater < (int)Heaters; ++heater)
-			{
-				reprap.ClearTemperatureFault(heater);
-			}
-		}
-		heaterFaultState = HeaterFaultState::noFault;
-		break;
-
-	case 563: // Define tool
-		result = GetGCodeResultFromError(ManageTool(gb, reply));
-		break;
-
-	case 564: // Think outside the box?
-		if (gb.Seen('S'))
-		{
-			limitAxes = (gb.GetIValue() != 0);
-		}
-		else
-		{
-			reply.printf("Movement outside the bed is %spermitted", (limitAxes) ? "not " : "");
-		}
-		break;
-
-	case 566: // Set/print maximum jerk speeds
-		{
-			bool seen = false;
-			for (size_t axis = 0; axis < numTotalAxes; axis++)
-			{
-				if (gb.Seen(axisLetters[axis]))
-				{
-					platform.SetInstantDv(axis, gb.GetFValue() * distanceScale * SecondsToMinutes); // G Code feedrates are in mm/minute; we need mm/sec
-					seen = true;
-				}
-			}
-
-			if (gb.Seen(extrudeLetter))
-			{
-				seen = true;
-				float eVals[MaxExtruders];
-				size_t eCount = numExtruders;
-				gb.GetFloatArray(eVals, eCount, true);
-				for (size_t e = 0; e < eCount; e++)
-				{
-					platform.SetInstantDv(numTotalAxes + e, eVals[e] * distanceScale * SecondsToMinutes);
-				}
-			}
-			else if (!seen)
-			{
-				reply.copy("Maximum jerk rates: ");
-				for (size_t axis = 0; axis < numTotalAxes; ++axis)
-				{
-					reply.catf("%c: %.1f, ", axisLetters[axis], (double)(platform.ConfiguredInstantDv(axis) / (distanceScale * SecondsToMinutes)));
-				}
-				reply.cat("E:");
-				char sep = ' ';
-				for (size_t extruder = 0; extruder < numExtruders; extruder++)
-				{
-					reply.catf("%c%.1f", sep, (double)(platform.ConfiguredInstantDv(extruder + numTotalAxes) / (distanceScale * SecondsToMinutes)));
-					sep = ':';
-				}
-			}
-		}
-		break;
-
-	case 567: // Set/report tool mix ratios
-		if (gb.Seen('P'))
-		{
-			const int8_t tNumber = gb.GetIValue();
-			Tool* const tool = reprap.GetTool(tNumber);
-			if (tool != nullptr)
-			{
-				if (gb.Seen(extrudeLetter))
-				{
-					float eVals[MaxExtruders];
-					size_t eCount = tool->DriveCount();
-					gb.GetFloatArray(eVals, eCount, false);
-					if (eCount != tool->DriveCount())
-					{
-						reply.printf("Setting mix ratios - wrong number of E drives: %s", gb.Buffer());
-					}
-					else
-					{
-						tool->DefineMix(eVals);
-					}
-				}
-				else
-				{
-					reply.printf("Tool %d mix ratios:", tNumber);
-					char sep = ' ';
-					for (size_t drive = 0; drive < tool->DriveCount(); drive++)
-					{
-						reply.catf("%c%.3f", sep, (double)tool->GetMix()[drive]);
-						sep = ':';
-					}
-				}
-			}
-		}
-		break;
-
-	case 568: // Turn on/off automatic tool mixing
-		reply.copy("The M568 command is no longer needed");
-		break;
-
-	case 569: // Set/report axis direction
-		if (gb.Seen('P'))
-		{
-			const size_t drive = gb.GetIValue();
-			if (drive < DRIVES)
-			{
-				bool seen = false;
-				if (gb.Seen('S'))
-				{
-					if (!LockMovementAndWaitForStandstill(gb))
-					{
-						return false;
-					}
-					platform.SetDirectionValue(drive, gb.GetIValue() != 0);
-					seen = true;
-				}
-				if (gb.Seen('R'))
-				{
-					if (!LockMovementAndWaitForStandstill(gb))
-					{
-						return false;
-					}
-					platform.SetEnableValue(drive, (int8_t)gb.GetIValue());
-					seen = true;
-				}
-				if (gb.Seen('T'))
-				{
-					platform.SetDriverStepTiming(drive, gb.GetFValue());
-					seen = true;
-				}
-				bool badParameter = false;
-				for (size_t axis = 0; axis < numTotalAxes; ++axis)
-				{
-					if (gb.Seen(axisLetters[axis]))
-					{
-						badParameter = true;
-					}
-				}
-				if (gb.Seen(extrudeLetter))
-				{
-					badParameter = true;
-				}
-				if (badParameter)
-				{
-					platform.Message(ErrorMessage, "M569 no longer accepts XYZE parameters; use M584 instead\n");
-				}
-				else if (!seen)
-				{
-					reply.printf("A %d sends drive %u forwards, a %d enables it, and the minimum pulse width is %.1f microseconds",
-								(int)platform.GetDirectionValue(drive), drive,
-								(int)platform.GetEnableValue(drive),
-								(double)platform.GetDriverStepTiming(drive));
-				}
-			}
-		}
-		break;
-
-	case 570: // Set/report heater monitoring
-		{
-			bool seen = false;
-			if (gb.Seen('S'))
-			{
-				seen = true;
-				heaterFaultTimeout = gb.GetUIValue() * (60 * 1000);
-			}
-			if (gb.Seen('H'))
-			{
-				const int heater = gb.GetIValue();
-				if (heater >= 0 && heater < (int)Heaters)
-				{
-					bool seenValue = false;
-					float maxTempExcursion, maxFaultTime;
-					reprap.GetHeat().GetFaultDetectionParameters(heater, maxTempExcursion, maxFaultTime);
-					gb.TryGetFValue('P', maxFaultTime, seenValue);
-					gb.TryGetFValue('T', maxTempExcursion, seenValue);
-					if (seenValue)
-					{
-						reprap.GetHeat().SetFaultDetectionParameters(heater, maxTempExcursion, maxFaultTime);
-					}
-					else if (!seen)
-					{
-						reply.printf("Heater %u allowed excursion %.1f" DEGREE_SYMBOL "C, fault trigger time %.1f seconds", heater, (double)maxTempExcursion, (double)maxFaultTime);
-					}
-				}
-				seen = true;
-			}
-			if (!seen)
-			{
-				reply.printf("Print will be terminated if a heater fault is not reset within %" PRIu32 " minutes", heaterFaultTimeout/(60 * 1000));
-			}
-		}
-		break;
-
-	case 571: // Set output on extrude
-		{
-			bool seen = false;
-			if (gb.Seen('P'))
-			{
-				const int pwmPin = gb.GetIValue();
-				if (!platform.SetExtrusionAncilliaryPwmPin(pwmPin))
-				{
-					reply.printf("Logical pin %d is already in use or not available for use by M571", pwmPin);
-					break;			// don't process 'S' parameter if the pin was wrong
-				}
-				seen = true;
-			}
-			if (gb.Seen('F'))
-			{
-				platform.SetExtrusionAncilliaryPwmFrequency(gb.GetFValue());
-			}
-			if (gb.Seen('S'))
-			{
-				platform.SetExtrusionAncilliaryPwmValue(gb.GetFValue());
-				seen = true;
-			}
-			if (!seen)
-			{
-				reply.printf("Extrusion ancillary PWM %.3f at %.1fHz on pin %u",
-								(double)platform.GetExtrusionAncilliaryPwmValue(),
-								(double)platform.GetExtrusionAncilliaryPwmFrequency(),
-								platform.GetExtrusionAncilliaryPwmPin());
-			}
-		}
-		break;
-
-	case 572: // Set/report pressure advance
-		if (gb.Seen('S'))
-		{
-			const float advance = gb.GetFValue();
-			if (gb.Seen('D'))
-			{
-				uint32_t eDrive[MaxExtruders];
-				size_t eCount = MaxExtruders;
-				gb.GetUnsignedArray(eDrive, eCount);
-				for (size_t i = 0; i < eCount; i++)
-				{
-					if (eDrive[i] >= numExtruders)
-					{
-						reply.printf("Invalid extruder number '%" PRIu32 "'", eDrive[i]);
-						result = GCodeResult::error;
-						break;
-					}
-					platform.SetPressureAdvance(eDrive[i], advance);
-				}
-			}
-		}
-		else
-		{
-			reply.copy("Extruder pressure advance");
-			char c = ':';
-			for (size_t i = 0; i < numExtruders; ++i)
-			{
-				reply.catf("%c %.3f", c, (double)platform.GetPressureAdvance(i));
-				c = ',';
-			}
-		}
-		break;
-
-	case 573: // Report heater average PWM
-		if (gb.Seen('P'))
-		{
-			const int heater = gb.GetIValue();
-			if (heater >= 0 && heater < (int)Heaters)
-			{
-				reply.printf("Average heater %d PWM: %.3f", heater, (double)reprap.GetHeat().GetAveragePWM(heater));
-			}
-		}
-		break;
-
-	case 574: // Set endstop configuration
-		{
-			bool seen = false;
-			const uint8_t inputType = (gb.Seen('S')) ? gb.GetUIValue() : 1;
-			for (size_t axis = 0; axis < numTotalAxes; ++axis)
-			{
-				if (gb.Seen(axisLetters[axis]))
-				{
-					const int ival = gb.GetIValue();
-					if (ival >= 0 && ival <= 3)
-					{
-						platform.SetEndStopConfiguration(axis, (EndStopPosition) ival, (EndStopInputType)inputType);
-						seen = true;
-					}
-				}
-			}
-			if (!seen)
-			{
-				reply.copy("Endstop configuration:");
-				EndStopPosition config;
-				EndStopInputType inputType;
-				for (size_t axis = 0; axis < numTotalAxes; ++axis)
-				{
-					platform.GetEndStopConfiguration(axis, config, inputType);
-					reply.catf(" %c: %s", axisLetters[axis],
-								(config == EndStopPosition::highEndStop) ? "high end"
-									: (config == EndStopPosition::lowEndStop) ? "low end"
-										: "none");
-					if (config == EndStopPosition::noEndStop)
-					{
-						reply.cat(',');
-					}
-					else
-					{
-						reply.catf(" %s,",
-									(inputType == EndStopInputType::activeHigh) ? "active high switch"
-										: (inputType == EndStopInputType::activeHigh) ? "active low switch"
-											: (inputType == EndStopInputType::zProbe) ? "Z probe"
-												: (inputType == EndStopInputType::motorStall) ? "motor stall"
-													: "unknown type"
-									);
-					}
-				}
-			}
-		}
-		break;
-
-	case 575: // Set communications parameters
-		if (gb.Seen('P'))
-		{
-			size_t chan = gb.GetIValue();
-			if (chan < NUM_SERIAL_CHANNELS)
-			{
-				bool seen = false;
-				if (gb.Seen('B'))
-				{
-					platform.SetBaudRate(chan, gb.GetIValue());
-					seen = true;
-				}
-				if (gb.Seen('S'))
-				{
-					uint32_t val = gb.GetIValue();
-					platform.SetCommsProperties(chan, val);
-					switch (chan)
-					{
-					case 0:
-						serialGCode->SetCommsProperties(val);
-						break;
-					case 1:
-						auxGCode->SetCommsProperties(val);
-						break;
-					default:
-						break;
-					}
-					seen = true;
-				}
-				if (!seen)
-				{
-					uint32_t cp = platform.GetCommsProperties(chan);
-					reply.printf("Channel %d: baud rate %" PRIu32 ", %s checksum", chan, platform.GetBaudRate(chan), (cp & 1) ? "requires" : "does not require");
-				}
-			}
-		}
-		break;
-
-	case 577: // Wait until endstop is triggered
-		if (gb.Seen('S'))
-		{
-			// Determine trigger type
-			EndStopHit triggerCondition;
-			switch (gb.GetIValue())
-			{
-				case 1:
-					triggerCondition = EndStopHit::lowHit;
-					break;
-				case 2:
-					triggerCondition = EndStopHit::highHit;
-					break;
-				case 3:
-					triggerCondition = EndStopHit::nearStop;
-					break;
-				default:
-					triggerCondition = EndStopHit::noStop;
-					break;
-			}
-
-			// Axis endstops
-			for (size_t axis=0; axis < numTotalAxes; axis++)
-			{
-				if (gb.Seen(axisLetters[axis]))
-				{
-					if (platform.Stopped(axis) != triggerCondition)
-					{
-						result = GCodeResult::notFinished;
-						break;
-					}
-				}
-			}
-
-			// Extruder drives
-			if (gb.Seen(extrudeLetter))
-			{
-				size_t eDriveCount = MaxExtruders;
-				uint32_t eDrives[MaxExtruders];
-				gb.GetUnsignedArray(eDrives, eDriveCount);
-				for (size_t extruder = 0; extruder < eDriveCount; extruder++)
-				{
-					const size_t eDrive = eDrives[extruder];
-					if (eDrive >= MaxExtruders)
-					{
-						reply.printf("Invalid extruder drive '%u'", eDrive);
-						result = GCodeResult::error;
-						break;
-					}
-
-					if (platform.Stopped(eDrive + E0_AXIS) != triggerCondition)
-					{
-						result = GCodeResult::notFinished;
-						break;
-					}
-				}
-			}
-		}
-		break;
-
-#if SUPPORT_INKJET
-	case 578: // Fire Inkjet bits
-		if (!AllMovesAreFinishedAndMoveBufferIsLoaded())
-		{
-			return false;
-		}
-
-		if (gb.Seen('S')) // Need to handle the 'P' parameter too; see http://reprap.org/wiki/G-code#M578:_Fire_inkjet_bits
-		{
-			platform.Inkjet(gb.GetIValue());
-		}
-		break;
-#endif
-
-	case 579: // Scale Cartesian axes (mostly for Delta configurations)
-		{
-			bool seen = false;
-			for (size_t axis = 0; axis < numVisibleAxes; axis++)
-			{
-				gb.TryGetFValue(axisLetters[axis], axisScaleFactors[axis], seen);
-			}
-
-			if (!seen)
-			{
-				char sep = ':';
-				reply.copy("Axis scale factors");
-				for(size_t axis = 0; axis < numVisibleAxes; axis++)
-				{
-					reply.catf("%c %c: %.3f", sep, axisLetters[axis], (double)axisScaleFactors[axis]);
-					sep = ',';
-				}
-			}
-		}
-		break;
-
-#if SUPPORT_ROLAND
-	case 580: // (De)Select Roland mill
-		if (gb.Seen('R'))
-		{
-			if (gb.GetIValue())
-			{
-				reprap.GetRoland()->Activate();
-				if (gb.Seen('P'))
-				{
-					result = reprap.GetRoland()->RawWrite(gb.GetString());
-				}
-			}
-			else
-			{
-				result = reprap.GetRoland()->Deactivate();
-			}
-		}
-		else
-		{
-			reply.printf("Roland is %s.", reprap.GetRoland()->Active() ? "active" : "inactive");
-		}
-		break;
-#endif
-
-	case 581: // Configure external trigger
-	case 582: // Check external trigger
-		result = CheckOrConfigureTrigger(gb, reply, code);
-		break;
-
-	case 584: // Set axis/extruder to stepper driver(s) mapping
-		result = DoDriveMapping(gb, reply);
-		break;
-
-	case 585: // Probe Tool
-		result = ProbeTool(gb, reply);
-		break;
-
-	case 586: // Configure network protocols
-#if HAS_MULTIPLE_NETWORK_INTERFACES
-		{
-			const int interface = (gb.Seen('I') ? gb.GetIValue() : 0);
-
-			if (gb.Seen('P'))
-			{
-				const int protocol = gb.GetIValue();
-				if (gb.Seen('S'))
-				{
-					const bool enable = (gb.GetIValue() == 1);
-					if (enable)
-					{
-						const int port = (gb.Seen('R')) ? gb.GetIValue() : -1;
-						const int secure = (gb.Seen('T')) ? gb.GetIValue() : -1;
-						reprap.GetNetwork().EnableProtocol(interface, protocol, port, secure, reply);
-					}
-					else
-					{
-						reprap.GetNetwork().DisableProtocol(interface, protocol, reply);
-					}
-				}
-				break;
-			}
-
-			// Default to reporting current protocols if P or S parameter missing
-			reprap.GetNetwork().ReportProtocols(interface, reply);
-		}
-#else
-		if (gb.Seen('P'))
-		{
-			const int protocol = gb.GetIValue();
-			if (gb.Seen('S'))
-			{
-				const bool enable = (gb.GetIValue() == 1);
-				if (enable)
-				{
-					const int port = (gb.Seen('R')) ? gb.GetIValue() : -1;
-					const int secure = (gb.Seen('T')) ? gb.GetIValue() : -1;
-					reprap.GetNetwork().EnableProtocol(protocol, port, secure, reply);
-				}
-				else
-				{
-					reprap.GetNetwork().DisableProtocol(protocol, reply);
-				}
-				break;
-			}
-		}
-
-		// Default to reporting current protocols if P or S parameter missing
-		reprap.GetNetwork().ReportProtocols(reply);
-#endif
-		break;
-
-#if HAS_WIFI_NETWORKING
-	case 587:	// Add WiFi network or list remembered networks
-	case 588:	// Forget WiFi network
-	case 589:	// Configure access point
-		{
-			OutputBuffer *longReply = nullptr;
-			result = reprap.GetNetwork().HandleWiFiCode(code, gb, reply, longReply);
-			if (longReply != nullptr)
-			{
-				if (result == GCodeResult::ok)
-				{
-					UnlockAll(gb);
-					HandleReply(gb, false, longReply);
-					return true;
-				}
-				OutputBuffer::ReleaseAll(longReply);
-			}
-		}
-		break;
-#endif
-
-	case 591: // Configure filament sensor
-		if (gb.Seen('D'))
-		{
-			const unsigned int extruder = gb.GetUIValue();
-			if (extruder < numExtruders)
-			{
-				bool seen = false;
-				long sensorType;
-				gb.TryGetIValue('P', sensorType, seen);
-				if (seen)
-				{
-					FilamentSensor::SetFilamentSensorType(extruder, sensorType);
-				}
-
-				FilamentSensor *sensor = FilamentSensor::GetFilamentSensor(extruder);
-				if (sensor != nullptr)
-				{
-					// Configure the sensor
-					const bool error = sensor->Configure(gb, reply, seen);
-					result = GetGCodeResultFromError(error);
-					if (error)
-					{
-						FilamentSensor::SetFilamentSensorType(extruder, 0);		// delete the sensor
-					}
-				}
-				else if (!seen)
-				{
-					reply.printf("Extruder drive %u has no filament sensor", extruder);
-				}
-			}
-		}
-		break;
-
-#if NONLINEAR_EXTRUSION
-	case 592: // Configure nonlinear extrusion
-		if (gb.Seen('D'))
-		{
-			const unsigned int extruder = gb.GetUIValue();
-			bool seen = false;
-			float a = 0.0, b = 0.0, limit = DefaultNonlinearExtrusionLimit;
-			gb.TryGetFValue('A', a, seen);
-			gb.TryGetFValue('B', b, seen);
-			gb.TryGetFValue('L', limit, seen);
-			if (seen)
-			{
-				platform.SetNonlinearExtrusion(extruder, a, b, limit);
-			}
-			else
-			{
-				platform.GetExtrusionCoefficients(extruder, a, b, limit);
-				reply.printf("Drive %u nonlinear extrusion coefficients: A=%.3f, B=%.4f, limit=%.2f", extruder, (double)a, (double)b, (double)limit);
-			}
-		}
-		break;
-#endif
-
-	case 593: // Configure filament properties
-		// TODO: We may need this code later to restrict specific filaments to certain tools or to reset filament counters.
-		break;
-
-	case 665: // Set delta configuration
-		if (!LockMovementAndWaitForStandstill(gb))
-		{
-			return false;
-		}
-		{
-			Move& move = reprap.GetMove();
-
-			bool changedMode = false;
-			if ((gb.Seen('L') || gb.Seen('D')) && move.GetKinematics().GetKinematicsType() != KinematicsType::linearDelta)
-			{
-				// Not in delta mode, so switch to it
-				changedMode = true;
-				move.SetKinematics(KinematicsType::linearDelta);
-			}
-			bool error = false;
-			const bool changed = move.GetKinematics().Configure(code, gb, reply, error);
-			if (changedMode)
-			{
-				move.GetKinematics().GetAssumedInitialPosition(numVisibleAxes, moveBuffer.coords);
-				ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);
-			}
-			if (changed || changedMode)
-			{
-				if (reprap.GetMove().GetKinematics().LimitPosition(moveBuffer.coords, numVisibleAxes, axesHomed, false))
-				{
-					ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);	// make sure the limits are reflected in the user position
-				}
-				reprap.GetMove().SetNewPosition(moveBuffer.coords, true);
-				SetAllAxesNotHomed();
-			}
-			result = GetGCodeResultFromError(error);
-		}
-		break;
-
-	case 666: // Set delta endstop adjustments
-		if (!LockMovementAndWaitForStandstill(gb))
-		{
-			return false;
-		}
-		{
-			bool error = false;
-			const bool changed = reprap.GetMove().GetKinematics().Configure(code, gb, reply, error);
-			if (changed)
-			{
-				SetAllAxesNotHomed();
-			}
-			result = GetGCodeResultFromError(error);
-		}
-		break;
-
-	case 667: // Set CoreXY mode
-		if (!LockMovementAndWaitForStandstill(gb))
-		{
-			return false;
-		}
-		{
-			Move& move = reprap.GetMove();
-			const KinematicsType oldK = move.GetKinematics().GetKinematicsType();		// get the current kinematics type so we can tell whether it changed
-
-			bool seen = false;
-			bool changedToCartesian = false;
-			if (gb.Seen('S'))
-			{
-				// Switch to the correct CoreXY mode
-				const int mode = gb.GetIValue();
-				switch (mode)
-				{
-				case 0:
-					move.SetKinematics(KinematicsType::cartesian);
-					changedToCartesian = true;
-					break;
-
-				case 1:
-					move.SetKinematics(KinematicsType::coreXY);
-					break;
-
-				case 2:
-					move.SetKinematics(KinematicsType::coreXZ);
-					break;
-
-				default:
-					reply.printf("Mode %d is not valid", mode);
-					result = GCodeResult::error;
-					break;
-				}
-				seen = true;
-			}
-
-			if (result == GCodeResult::ok)
-			{
-				if (!changedToCartesian)		// don't ask the kinematics to process M667 if we switched to Cartesian mode
-				{
-					bool error = false;
-					if (move.GetKinematics().Configure(667, gb, reply, error))
-					{
-						seen = true;
-					}
-					result = GetGCodeResultFromError(error);
-				}
-
-				if (seen)
-				{
-					// We changed something, so reset the positions and set all axes not homed
-					if (move.GetKinematics().GetKinematicsType() != oldK)
-					{
-						move.GetKinematics().GetAssumedInitialPosition(numVisibleAxes, moveBuffer.coords);
-						ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);
-					}
-					if (reprap.GetMove().GetKinematics().LimitPosition(moveBuffer.coords, numVisibleAxes, axesHomed, false))
-					{
-						ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);	// make sure the limits are reflected in the user position
-					}
-					reprap.GetMove().SetNewPosition(moveBuffer.coords, true);
-					SetAllAxesNotHomed();
-				}
-			}
-		}
-		break;
-
-	case 669:	// Set kinematics and parameters for SCARA and other kinematics that don't use M665, M666 or M667
-		if (!LockMovementAndWaitForStandstill(gb))
-		{
-			return false;
-		}
-		{
-			Move& move = reprap.GetMove();
-			const KinematicsType oldK = move.GetKinematics().GetKinematicsType();		// get the current kinematics type so we can tell whether it changed
-
-			bool seen = false;
-			if (gb.Seen('K'))
-			{
-				const int nk = gb.GetIValue();
-				if (nk < 0 || nk >= (int)KinematicsType::unknown || !move.SetKinematics(static_cast<KinematicsType>(nk)))
-				{
-					reply.printf("Unknown kinematics type %d", nk);
-					result = GCodeResult::error;
-					break;
-				}
-				seen = true;
-			}
-			bool error = false;
-			if (move.GetKinematics().Configure(code, gb, reply, error))
-			{
-				seen = true;
-			}
-			result = GetGCodeResultFromError(error);
-
-			if (seen)
-			{
-				// We changed something significant, so reset the positions and set all axes not homed
-				if (move.GetKinematics().GetKinematicsType() != oldK)
-				{
-					move.GetKinematics().GetAssumedInitialPosition(numVisibleAxes, moveBuffer.coords);
-					ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);
-				}
-				if (reprap.GetMove().GetKinematics().LimitPosition(moveBuffer.coords, numVisibleAxes, axesHomed, false))
-				{
-					ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);	// make sure the limits are reflected in the user position
-				}
-				reprap.GetMove().SetNewPosition(moveBuffer.coords, true);
-				SetAllAxesNotHomed();
-			}
-		}
-		break;
-
-#if SUPPORT_IOBITS
-	case 670:
-		result = GetGCodeResultFromError(reprap.GetPortControl().Configure(gb, reply));
-		break;
-#endif
-
-	case 671:	// Set Z leadscrew positions
-		if (!LockMovementAndWaitForStandstill(gb))
-		{
-			return false;
-		}
-		{
-			bool error = false;
-			(void)reprap.GetMove().GetKinematics().Configure(code, gb, reply, error);
-			result = GetGCodeResultFromError(error);
-		}
-		break;
-
-	case 672: // Program Z probe
-		result = GetGCodeResultFromError(platform.ProgramZProbe(gb, reply));
-		break;
-
-	case 701: // Load filament
-		result = LoadFilament(gb, reply);
-		break;
-
-	case 702: // Unload filament
-		result = UnloadFilament(gb, reply);
-		break;
-
-#if SUPPORT_SCANNER
-	case 750: // Enable 3D scanner extension
-		reprap.GetScanner().Enable();
-		break;
-
-	case 751: // Register 3D scanner extension over USB
-		if (&gb == serialGCode)
-		{
-			if (reprap.GetScanner().IsEnabled())
-			{
-				result = GetGCodeResultFromFinished(reprap.GetScanner().Register());
-			}
-			else
-			{
-				reply.copy("Scanner extension is not enabled");
-				result = GCodeResult::error;
-			}
-		}
-		else
-		{
-			reply.copy("Invalid source");
-			result = GCodeResult::error;
-		}
-		break;
-
-	case 752: // Start 3D scan
-		if (gb.Seen('P'))
-		{
-			String<FILENAME_LENGTH> file;
-			gb.GetPossiblyQuotedString(file.GetRef());
-			if (gb.Seen('S'))
-			{
-				const int sParam = gb.GetIValue();
-				if (reprap.GetScanner().IsEnabled())
-				{
-					if (reprap.GetScanner().IsRegistered())
-					{
-						result = GetGCodeResultFromFinished(reprap.GetScanner().StartScan(file.Pointer(), sParam));
-					}
-					else
-					{
-						reply.copy("Scanner is not registered");
-						result = GCodeResult::error;
-					}
-				}
-				else
-				{
-					reply.copy("Scanner extension is not enabled");
-					result = GCodeResult::error;
-				}
-			}
-			else
-			{
-				reply.copy("Missing length/degree parameter");
-				result = GCodeResult::error;
-			}
-		}
-		else
-		{
-			reply.copy("Missing filename");
-			result = GCodeResult::error;
-		}
-		break;
-
-	case 753: // Cancel current 3D scanner action
-		if (reprap.GetScanner().IsEnabled())
-		{
-			if (reprap.GetScanner().IsRegistered())
-			{
-				result = GetGCodeResultFromFinished(reprap.GetScanner().Cancel());
-			}
-			else
-			{
-				reply.copy("Scanner is not registered");
-				result = GCodeResult::error;
-			}
-		}
-		else
-		{
-			reply.copy("Scanner extension is not enabled");
-			result = GCodeResult::error;
-		}
-		break;
-
-	case 754: // Calibrate scanner
-		if (reprap.GetScanner().IsEnabled())
-		{
-			if (reprap.GetScanner().IsRegistered())
-			{
-				result = GetGCodeResultFromFinished(reprap.GetScanner().Calibrate());
-			}
-			else
-			{
-				reply.copy("Scanner is not registered");
-				result = GCodeResult::error;
-			}
-		}
-		else
-		{
-			reply.copy("Scanner extension is not enabled");
-			result = GCodeResult::error;
-		}
-		break;
-
-	case 755: // Set alignment mode for 3D scanner
-		if (reprap.GetScanner().IsEnabled())
-		{
-			if (reprap.GetScanner().IsRegistered())
-			{
-				const bool on = (gb.Seen('P') && gb.GetIValue() > 0);
-				result = GetGCodeResultFromFinished(reprap.GetScanner().SetAlignment(on));
-			}
-			else
-			{
-				reply.copy("Scanner is not registered");
-				result = GCodeResult::error;
-			}
-		}
-		else
-		{
-			reply.copy("Scanner extension is not enabled");
-			result = GCodeResult::error;
-		}
-		break;
-
-	case 756: // Shutdown 3D scanner
-		if (reprap.GetScanner().IsEnabled())
-		{
-			if (reprap.GetScanner().IsRegistered())
-			{
-				result = GetGCodeResultFromFinished(reprap.GetScanner().Shutdown());
-			}
-			else
-			{
-				reply.copy("Scanner is not registered");
-				result = GCodeResult::error;
-			}
-		}
-		else
-		{
-			reply.copy("Scanner extension is not enabled");
-			result = GCodeResult::error;
-		}
-		break;
-#else
-	case 750:
-	case 751:
-	case 752:
-	case 753:
-	case 754:
-	case 755:
-	case 756:
-		reply.copy("Scanner support not built-in");
-		result = GCodeResult::error;
-		break;
-#endif
-
-	case 905: // Set current RTC date and time
-		result = SetDateTime(gb, reply);
-		break;
-
-	case 906: // Set/report Motor currents
-	case 913: // Set/report motor current percent
-#if HAS_SMART_DRIVERS
-	case 917: // Set/report standstill motor current percentage
-#endif
-		// Note that we no longer wait for movement to stop. This is so that we can use these commands (in particular, M913) in the M911 power fail script.
-		{
-			bool seen = false;
-			for (size_t axis = 0; axis < numTotalAxes; axis++)
-			{
-				if (gb.Seen(axisLetters[axis]))
-				{
-					platform.SetMotorCurrent(axis, gb.GetFValue(), code);
-					seen = true;
-				}
-			}
-
-			if (gb.Seen(extrudeLetter))
-			{
-				seen = true;
-				float eVals[MaxExtruders];
-				size_t eCount = numExtruders;
-				gb.GetFloatArray(eVals, eCount, true);
-				for (size_t e = 0; e < eCount; e++)
-				{
-					platform.SetMotorCurrent(numTotalAxes + e, eVals[e], code);
-				}
-			}
-
-			if (code == 906 && gb.Seen('I'))
-			{
-				seen = true;
-				const float idleFactor = gb.GetFValue();
-				if (idleFactor >= 0 && idleFactor <= 100.0)
-				{
-					platform.SetIdleCurrentFactor(idleFactor/100.0);
-				}
-			}
-
-			if (!seen)
-			{
-				reply.copy(	(code == 913) ? "Motor current % of normal - "
-#if HAS_SMART_DRIVERS
-								: (code == 917) ? "Motor standstill current % of normal - "
-#endif
-									: "Motor current (mA) - "
-						);
-				for (size_t axis = 0; axis < numTotalAxes; ++axis)
-				{
-					reply.catf("%c:%d, ", axisLetters[axis], (int)platform.GetMotorCurrent(axis, code));
-				}
-				reply.cat("E");
-				for (size_t extruder = 0; extruder < numExtruders; extruder++)
-				{
-					reply.catf(":%d", (int)platform.GetMotorCurrent(extruder + numTotalAxes, code));
-				}
-				if (code == 906)
-				{
-					reply.catf(", idle factor %d%%", (int)(platform.GetIdleCurrentFactor() * 100.0));
-				}
-			}
-		}
-		break;
-
-#if HAS_VOLTAGE_MONITOR
-	case 911: // Enable auto save
-		if (gb.Seen('S'))
-		{
-			const float saveVoltage = gb.GetFValue();
-			if (saveVoltage < 10.0)
-			{
-				platform.DisableAutoSave();
-			}
-			else
-			{
-				float resumeVoltage = saveVoltage + 1.0;		// set up default resume voltage
-				bool dummy;
-				gb.TryGetFValue('R', resumeVoltage, dummy);
-
-				String<80> powerFailString;
-				bool seenCommandString = false;
-				gb.TryGetQuotedString('P', powerFailString.GetRef(), seenCommandString);
-				if (seenCommandString)
-				{
-					// Replace the power fail script atomically
-					char *newPowerFailScript = new char[powerFailString.strlen() + 1];
-					strcpy(newPowerFailScript, powerFailString.c_str());
-					std::swap(newPowerFailScript, powerFailScript);
-					delete[] newPowerFailScript;
-				}
-				else if (powerFailScript == nullptr)
-				{
-					reply.copy("No power fail script provided");
-					result = GCodeResult::error;
-					break;
-				}
-				platform.EnableAutoSave(saveVoltage, resumeVoltage);
-			}
-		}
-		else
-		{
-			float saveVoltage, resumeVoltage;
-			if (platform.GetAutoSaveSettings(saveVoltage, resumeVoltage))
-			{
-				reply.printf("Auto save voltage %.1fV, resume %.1fV, script \"%s\"", (double)saveVoltage, (double)resumeVoltage, (powerFailScript == nullptr) ? "" : powerFailScript);
-			}
-			else
-			{
-				reply.copy("Auto save is disabled");
-			}
-		}
-		break;
-#endif
-
-#if HAS_CPU_TEMP_SENSOR
-	case 912: // Set electronics temperature monitor adjustment
-		// Currently we ignore the P parameter (i.e. temperature measurement channel)
-		if (gb.Seen('S'))
-		{
-			platform.SetMcuTemperatureAdjust(gb.GetFValue());
-		}
-		else
-		{
-			reply.printf("MCU temperature calibration adjustment is %.1f" DEGREE_SYMBOL "C", (double)platform.GetMcuTemperatureAdjust());
-		}
-		break;
-#endif
-
-	// For case 913, see 906
-
-#if defined(__ALLIGATOR__)
-	case 914: 				// Set/Get J14 Expansion Voltage Level Translator on Port J5, 5.5V or 3.3V
-			  	  	  	  	// Get Piggy module presence status
-		if (gb.Seen('S'))
-		{
-			const int voltageValue = gb.GetIValue();
-			if (voltageValue != 5 && voltageValue != 3 )
-			{
-				reply.printf("The Expansion Voltage Translator does not support %dV. \n Only 5V or 3V are supported.",voltageValue);
-			}
-			else
-			{
-				// Change Voltage translator level
-				digitalWrite(ExpansionVoltageLevelPin, voltageValue == 5);
-			}
-		}
-		else
-		{
-			// Change Voltage translator level Status
-			reply.printf("The Voltage of Expansion Translator is %dV \nPiggy module %s",
-					digitalRead(ExpansionVoltageLevelPin) ? 5 : 3 ,
-					digitalRead(ExpansionPiggyDetectPin) ? "not detected" : "detected");
-		}
-		break;
-#endif
-
-#if HAS_STALL_DETECT
-	case 915:
-		result = GetGCodeResultFromError(platform.ConfigureStallDetection(gb, reply));
-		break;
-#endif
-
-#if HAS_VOLTAGE_MONITOR
-	case 916:
-		if (!platform.GetMassStorage()->FileExists(platform.GetSysDir(), RESUME_AFTER_POWER_FAIL_G))
-		{
-			reply.copy("No resume file found");
-			result = GCodeResult::error;
-		}
-		else if (!platform.GetMassStorage()->FileExists(platform.GetSysDir(), RESUME_PROLOGUE_G))
-		{
-			reply.printf("Resume prologue file '%s' not found", RESUME_PROLOGUE_G);
-			result = GCodeResult::error;
-		}
-		else
-		{
-			DoFileMacro(gb, RESUME_AFTER_POWER_FAIL_G, true);
-		}
-		break;
-#endif
-
-	case 929: // Start/stop event logging
-		result = GetGCodeResultFromError(platform.ConfigureLogging(gb, reply));
-		break;
-
-	case 997: // Perform firmware update
-		result = UpdateFirmware(gb, reply);
-		break;
-
-	case 998:
-		// The input handling code replaces the gcode by this when it detects a checksum error.
-		// Since we have no way of asking for the line to be re-sent, just report an error.
-		if (gb.Seen('P'))
-		{
-			const int val = gb.GetIValue();
-			if (val != 0)
-			{
-				reply.printf("Checksum error on line %d", val);
-			}
-		}
-		break;
-
-	case 999:
-		result = DoDwellTime(gb, 500);		// wait half a second to allow the response to be sent back to the web server, otherwise it may retry
-		if (result != GCodeResult::notFinished)
-		{
-			reprap.EmergencyStop();			// this disables heaters and drives - Duet WiFi pre-production boards need drives disabled here
-			bool doErase;
-			if (gb.Seen('P'))
-			{
-				String<8> eraseString;
-				gb.GetPossiblyQuotedString(eraseString.GetRef());
-				doErase = StringStartsWith(eraseString.Pointer(), "ERASE");
-			}
-			else
-			{
-				doErase = false;
-			}
-			const uint16_t reason = (doErase)
-									? (uint16_t)SoftwareResetReason::erase
-									: (uint16_t)SoftwareResetReason::user;
-			platform.SoftwareReset(reason);			// doesn't return
-		}
-		break;
-
-	default:
-		reply.copy("Unsupported command");
-		result = GCodeResult::error;
-		break;
-	}
-
-	if (result == GCodeResult::notFinished)
-	{
-		return false;
-	}
-
-	if (result == GCodeResult::notSupportedInCurrentMode)
-	{
-		reply.printf("M%d command is not supported in machine mode %s", code, GetMachineModeString());
-	}
-
-	if (gb.GetState() == GCodeState::normal)
-	{
-		gb.timerRunning = false;
-		UnlockAll(gb);
-		if (result == GCodeResult::error)
-		{
-			scratchString.printf("M%d: ", code);
-			reply.Prepend(scratchString.Pointer());
-		}
-		HandleReply(gb, result != GCodeResult::ok, reply.Pointer());
-	}
-	return true;
-}
-
-bool GCodes::HandleTcode(GCodeBuffer& gb, StringRef& reply)
-{
-	if (gb.MachineState().runningM502)
-	{
-		return true;			// when running M502 we don't execute T commands
-	}
-
-	bool seen = false;
-	int toolNum;
-	if (gb.HasCommandNumber())
-	{
-		seen = true;
-		toolNum = gb.GetCommandNumber();
-		toolNum += gb.GetToolNumberAdjust();
-	}
-	else if (gb.Seen('R') && gb.GetIValue() == 1)
-	{
-		seen = true;
-		toolNum = pauseRestorePoint.toolNumber;
-	}
-
-	if (seen)
-	{
-		if (!LockMovementAndWaitForStandstill(gb))
-		{
-			return false;
-		}
-
-		const Tool * const oldTool = reprap.GetCurrentTool();
 		// If old and new are the same we no longer follow the sequence. User can deselect and then reselect the tool if he wants the macros run.
 		if (oldTool == nullptr || oldTool->Number() != toolNum)
 		{
@@ -36,6 +36,13 @@ GCodeResult GCodes::SetPrintZProbe(GCodeBuffer& gb, StringRef& reply)
 	gb.TryGetFValue(axisLetters[Z_AXIS], params.height, seen);
 	gb.TryGetIValue('P', params.adcValue, seen);
 
+	if (gb.Seen('A'))
+	{
+		params.probeTaps = (uint8_t)constrain<int32_t>(gb.GetIValue(), 1, (int32_t)MaxProbeTaps);
+		seen = true;
+	}
+	gb.TryGetFValue('D', params.tapTolerance, seen);
+
 	if (gb.Seen('C'))
 	{
 		params.temperatureCoefficient = gb.GetFValue();
@@ -63,6 +70,10 @@ GCodeResult GCodes::SetPrintZProbe(GCodeBuffer& gb, StringRef& reply)
 	{
 		// Don't bother printing temperature coefficient and calibration temperature because we will probably remove them soon
 		reply.printf("Threshold %" PRIi32 ", trigger height %.2f, offsets X%.1f Y%.1f", params.adcValue, (double)params.height, (double)params.xOffset, (double)params.yOffset);
+		if (params.probeTaps > 1)
+		{
+			reply.catf(", %u taps, tap tolerance %.2f", params.probeTaps, (double)params.tapTolerance);
+		}
 	}
 	else
 	{
@@ -688,6 +699,13 @@ GCodeResult GCodes::SetDateTime(GCodeBuffer& gb, StringRef& reply)
 // Handle M997
 GCodeResult GCodes::UpdateFirmware(GCodeBuffer& gb, StringRef &reply)
 {
+	// M997 C<crc> verifies the staged firmware binary against the expected CRC32 without stopping the machine,
+	// so that a corrupt upload is discovered while printing continues instead of during the flash window
+	if (gb.Seen('C') || firmwareBeingVerified != nullptr)
+	{
+		return VerifyStagedFirmware(gb, reply);
+	}
+
 	if (!LockMovementAndWaitForStandstill(gb))
 	{
 		return GCodeResult::notFinished;
@@ -753,4 +771,65 @@ GCodeResult GCodes::UpdateFirmware(GCodeBuffer& gb, StringRef &reply)
 	return GCodeResult::ok;
 }
 
+// Handle M997 C<crc>. Read the staged main firmware binary back from the SD card and check its CRC32 against the
+// expected value, e.g. the one published with the release. Like the M38 file hashing, this processes one buffer of
+// the file per call so that it can run to completion while a print is in progress. The actual update can then be
+// requested knowing that the image on the card is good, so the downtime is just the IAP programming time.
+GCodeResult GCodes::VerifyStagedFirmware(GCodeBuffer& gb, StringRef& reply)
+{
+	if (!LockFileSystem(gb))									// verification takes several calls and isn't reentrant
+	{
+		return GCodeResult::notFinished;
+	}
+
+	if (firmwareBeingVerified == nullptr)
+	{
+		// Starting a new verification
+		if (gb.Seen('C'))
+		{
+			firmwareExpectedCrc = gb.GetUIValue();
+		}
+		firmwareBeingVerified = platform.OpenFile(platform.GetSysDir(), IAP_FIRMWARE_FILE, OpenMode::read);
+		if (firmwareBeingVerified == nullptr)
+		{
+			reply.printf("Firmware binary \"%s\" not found", IAP_FIRMWARE_FILE);
+			return GCodeResult::error;
+		}
+		firmwareVerifyCrc.Reset();
+		return GCodeResult::notFinished;
+	}
+
+	// Read and checksum some more of the file
+	uint32_t buf32[(FILE_BUFFER_SIZE + 3)/4];
+	char * const buffer = reinterpret_cast<char *>(buf32);
+	const int bytesRead = firmwareBeingVerified->Read(buffer, FILE_BUFFER_SIZE);
+	if (bytesRead < 0)
+	{
+		firmwareBeingVerified->Close();
+		firmwareBeingVerified = nullptr;
+		reply.printf("Error reading firmware binary \"%s\"", IAP_FIRMWARE_FILE);
+		return GCodeResult::error;
+	}
+
+	firmwareVerifyCrc.Update(buffer, bytesRead);
+	if (bytesRead == (int)FILE_BUFFER_SIZE)
+	{
+		return GCodeResult::notFinished;
+	}
+
+	// Reached end of file, report the result
+	const FilePosition fileLength = firmwareBeingVerified->Length();
+	firmwareBeingVerified->Close();
+	firmwareBeingVerified = nullptr;
+	const uint32_t crc = firmwareVerifyCrc.Get();
+	if (crc != firmwareExpectedCrc)
+	{
+		reply.printf("Firmware binary \"%s\" failed CRC check: expected 0x%08" PRIx32 ", got 0x%08" PRIx32 " - do not flash this image",
+						IAP_FIRMWARE_FILE, firmwareExpectedCrc, crc);
+		return GCodeResult::error;
+	}
+	reply.printf("Firmware binary \"%s\" verified, %lu bytes, CRC32 0x%08" PRIx32, IAP_FIRMWARE_FILE, (unsigned long)fileLength, crc);
+	return GCodeResult::ok;
+}
+
 // End
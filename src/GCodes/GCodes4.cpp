@@ -0,0 +1,1772 @@
+/*
+ * GCodes4.cpp
+ *
+ *  This file contains the handlers for M500 and above, split out of the main M-code switch in GCodes2.cpp
+ *  so that each dispatch switch stays a manageable size for both the compiler and the reader.
+ */
+
+#include "GCodes.h"
+
+#include "GCodeBuffer.h"
+#include "GCodeQueue.h"
+#include "Heating/Heat.h"
+#include "Movement/Move.h"
+#include "Network.h"
+#include "Scanner.h"
+#include "PrintMonitor.h"
+#include "RepRap.h"
+#include "Tools/Tool.h"
+#include "FilamentSensors/FilamentSensor.h"
+#include "Libraries/General/IP4String.h"
+
+#if SUPPORT_IOBITS
+# include "PortControl.h"
+#endif
+
+#if HAS_WIFI_NETWORKING
+# include "FirmwareUpdater.h"
+#endif
+
+#include <utility>			// for std::swap
+
+// Handle an M code numbered 500 or above. These are mostly configuration commands, so they are less
+// performance-critical than the codes that occur repeatedly during a print. The contract is the same as
+// for HandleMcode: return true if the command has been completed, false if it needs to be called again.
+bool GCodes::HandleConfigMcode(GCodeBuffer& gb, StringRef& reply, const int code)
+{
+	GCodeResult result = GCodeResult::ok;
+
+	switch (code)
+	{
+	case 500: // Store parameters in EEPROM
+		result = GetGCodeResultFromError(WriteConfigOverrideFile(gb, reply, CONFIG_OVERRIDE_G));
+		break;
+
+	case 501: // Load parameters from EEPROM
+		DoFileMacro(gb, "config-override.g", true, code);
+		break;
+
+	case 502: // Revert to default "factory settings"
+		reprap.GetHeat().ResetHeaterModels();							// in case some heaters have no M307 commands in config.g
+		reprap.GetMove().GetKinematics().SetCalibrationDefaults();		// in case M665/M666/M667/M669 in config.g don't define all the parameters
+		platform.SetZProbeDefaults();
+		DoFileMacro(gb, "config.g", true, code);
+		break;
+
+	case 503: // List variable settings
+		{
+			if (!LockFileSystem(gb))
+			{
+				return false;
+			}
+
+			// Need a valid output buffer to continue...
+			OutputBuffer *configResponse;
+			if (!OutputBuffer::Allocate(configResponse))
+			{
+				// No buffer available, try again later
+				return false;
+			}
+
+			// Read the entire file
+			FileStore * const f = platform.OpenFile(platform.GetSysDir(), platform.GetConfigFile(), OpenMode::read);
+			if (f == nullptr)
+			{
+				reply.copy("Configuration file not found");
+				result = GCodeResult::error;
+			}
+			else
+			{
+				char fileBuffer[FILE_BUFFER_SIZE];
+				size_t bytesRead,
+					bytesLeftForWriting = OutputBuffer::GetBytesLeft(configResponse);
+				while ((bytesRead = f->Read(fileBuffer, FILE_BUFFER_SIZE)) > 0 && bytesLeftForWriting > 0)
+				{
+					// Don't write more data than we can process
+					if (bytesRead < bytesLeftForWriting)
+					{
+						bytesLeftForWriting -= bytesRead;
+					}
+					else
+					{
+						bytesRead = bytesLeftForWriting;
+						bytesLeftForWriting = 0;
+					}
+
+					// Write it
+					configResponse->cat(fileBuffer, bytesRead);
+				}
+				f->Close();
+
+				UnlockAll(gb);
+				HandleReply(gb, false, configResponse);
+				return true;
+			}
+		}
+		break;
+
+	case 540: // Set/report MAC address
+		if (gb.Seen('P'))
+		{
+			uint8_t mac[6];
+			if (gb.GetMacAddress(mac))
+			{
+				platform.SetMACAddress(mac);
+			}
+			else
+			{
+				reply.copy("Bad MAC address");
+				result = GCodeResult::error;
+			}
+		}
+		else
+		{
+			const uint8_t *mac = platform.MACAddress();
+			reply.printf("MAC: %02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+		}
+		break;
+
+	case 550: // Set/report machine name
+		{
+			String<MACHINE_NAME_LENGTH> name;
+			bool seen = false;
+			gb.TryGetPossiblyQuotedString('P', name.GetRef(), seen);
+			if (seen)
+			{
+				reprap.SetName(name.c_str());
+			}
+			else
+			{
+				reply.printf("RepRap name: %s", reprap.GetName());
+			}
+		}
+		break;
+
+	case 551: // Set password (no option to report it)
+		{
+			String<PASSWORD_LENGTH> password;
+			bool seen = false;
+			gb.TryGetPossiblyQuotedString('P', password.GetRef(), seen);
+			if (seen)
+			{
+				reprap.SetPassword(password.c_str());
+			}
+		}
+		break;
+
+	case 552: // Enable/Disable network and/or Set/Get IP address
+		{
+			bool seen = false;
+
+#if HAS_MULTIPLE_NETWORK_INTERFACES
+			const int interface = (gb.Seen('I') ? gb.GetIValue() : 0);
+
+			if (reprap.GetNetwork().IsWiFiInterface(interface))
+			{
+				if (gb.Seen('S')) // Has the user turned the network on or off?
+				{
+					const int enableValue = gb.GetIValue();
+					seen = true;
+
+					char ssidBuffer[SsidLength + 1];
+					StringRef ssid(ssidBuffer, ARRAY_SIZE(ssidBuffer));
+					if (gb.Seen('P') && !gb.GetQuotedString(ssid))
+					{
+						reply.copy("Bad or missing SSID");
+						result = GCodeResult::error;
+					}
+					else
+					{
+						reprap.GetNetwork().EnableWiFi(enableValue, ssid, reply);
+					}
+				}
+			}
+			else
+			{
+				if (gb.Seen('P'))
+				{
+					seen = true;
+					uint8_t eth[4];
+					if (gb.GetIPAddress(eth))
+					{
+						platform.SetIPAddress(eth);
+					}
+					else
+					{
+						reply.copy("Bad IP address");
+						result = GCodeResult::error;
+						break;
+					}
+				}
+
+				// Process this one last in case the IP address is changed and the network enabled in the same command
+				if (gb.Seen('S')) // Has the user turned the network on or off?
+				{
+					seen = true;
+					reprap.GetNetwork().EnableEthernet(gb.GetIValue(), reply);
+				}
+			}
+#elif HAS_WIFI_NETWORKING
+			if (gb.Seen('S')) // Has the user turned the network on or off?
+			{
+				const int enableValue = gb.GetIValue();
+				seen = true;
+
+				char ssidBuffer[SsidLength + 1];
+				StringRef ssid(ssidBuffer, ARRAY_SIZE(ssidBuffer));
+				if (gb.Seen('P') && !gb.GetQuotedString(ssid))
+				{
+					reply.copy("Bad or missing SSID");
+					result = GCodeResult::error;
+				}
+				else
+				{
+					reprap.GetNetwork().Enable(enableValue, ssid, reply);
+				}
+			}
+#else
+			if (gb.Seen('P'))
+			{
+				seen = true;
+				uint8_t eth[4];
+				if (gb.GetIPAddress(eth))
+				{
+					platform.SetIPAddress(eth);
+				}
+				else
+				{
+					reply.copy("Bad IP address");
+					result = GCodeResult::error;
+					break;
+				}
+			}
+
+			// Process this one last in case the IP address is changed and the network enabled in the same command
+			if (gb.Seen('S')) // Has the user turned the network on or off?
+			{
+				seen = true;
+				reprap.GetNetwork().Enable(gb.GetIValue(), reply);
+			}
+#endif
+
+			if (!seen)
+			{
+#if HAS_MULTIPLE_NETWORK_INTERFACES
+				result = GetGCodeResultFromError(reprap.GetNetwork().GetNetworkState(interface, reply));
+#else
+				result = GetGCodeResultFromError(reprap.GetNetwork().GetNetworkState(reply));
+#endif
+			}
+		}
+		break;
+
+	case 553: // Set/Get netmask
+		if (gb.Seen('P'))
+		{
+			uint8_t eth[4];
+			if (gb.GetIPAddress(eth))
+			{
+				platform.SetNetMask(eth);
+			}
+			else
+			{
+				reply.copy("Bad IP address");
+				result = GCodeResult::error;
+			}
+		}
+		else
+		{
+			const uint8_t * const nm = platform.NetMask();
+			reply.printf("Net mask: %d.%d.%d.%d ", nm[0], nm[1], nm[2], nm[3]);
+		}
+		break;
+
+	case 554: // Set/Get gateway
+		if (gb.Seen('P'))
+		{
+			uint8_t eth[4];
+			if (gb.GetIPAddress(eth))
+			{
+				platform.SetGateWay(eth);
+			}
+			else
+			{
+				reply.copy("Bad IP address");
+				result = GCodeResult::error;
+			}
+		}
+		else
+		{
+			const uint8_t * const gw = platform.GateWay();
+			reply.printf("Gateway: %d.%d.%d.%d ", gw[0], gw[1], gw[2], gw[3]);
+		}
+		break;
+
+	case 555: // Set/report firmware type to emulate
+		if (gb.Seen('P'))
+		{
+			platform.SetEmulating((Compatibility) gb.GetIValue());
+		}
+		else
+		{
+			reply.copy("Emulating ");
+			switch (platform.Emulating())
+			{
+			case me:
+			case reprapFirmware:
+				reply.cat("RepRap Firmware (i.e. in native mode)");
+				break;
+
+			case marlin:
+				reply.cat("Marlin");
+				break;
+
+			case teacup:
+				reply.cat("Teacup");
+				break;
+
+			case sprinter:
+				reply.cat("Sprinter");
+				break;
+
+			case repetier:
+				reply.cat("Repetier");
+				break;
+
+			default:
+				reply.catf("Unknown: (%d)", platform.Emulating());
+			}
+		}
+		break;
+
+	case 556: // Axis compensation (we support only X, Y, Z)
+		if (gb.Seen('S'))
+		{
+			const float value = gb.GetFValue();
+			for (size_t axis = 0; axis <= Z_AXIS; axis++)
+			{
+				if (gb.Seen(axisLetters[axis]))
+				{
+					reprap.GetMove().SetAxisCompensation(axis, gb.GetFValue() / value);
+				}
+			}
+		}
+		else
+		{
+			reply.printf("Axis compensations - XY: %.5f, YZ: %.5f, ZX: %.5f",
+				(double)reprap.GetMove().AxisCompensation(X_AXIS), (double)reprap.GetMove().AxisCompensation(Y_AXIS), (double)reprap.GetMove().AxisCompensation(Z_AXIS));
+		}
+		break;
+
+	case 557: // Set/report Z probe point coordinates
+		result = DefineGrid(gb, reply);
+		break;
+
+	case 558: // Set or report Z probe type and for which axes it is used
+		result = SetOrReportZProbe(gb, reply);
+		break;
+
+	case 559:
+	case 560: // Binary writing
+	{
+		const char* folder = platform.GetSysDir();
+		const char* defaultFile = platform.GetConfigFile();
+		if (code == 560)
+		{
+			folder = platform.GetWebDir();
+			defaultFile = INDEX_PAGE_FILE;
+		}
+		String<FILENAME_LENGTH> filename;
+		if (gb.Seen('P'))
+		{
+			gb.GetPossiblyQuotedString(filename.GetRef());
+		}
+		else
+		{
+			filename.GetRef().copy(defaultFile);
+		}
+		const FilePosition size = (gb.Seen('S') ? (FilePosition)gb.GetIValue() : 0);
+		const uint32_t crc32 = (gb.Seen('C') ? gb.GetUIValue() : 0);
+		const bool ok = OpenFileToWrite(gb, folder, filename.Pointer(), size, true, crc32);
+		if (ok)
+		{
+			reply.printf("Writing to file: %s", filename.Pointer());
+		}
+		else
+		{
+			reply.printf("Can't open file %s for writing.", filename.Pointer());
+			result = GCodeResult::error;
+		}
+	}
+	break;
+
+	case 561: // Set identity transform (also clears bed probe grid)
+		reprap.GetMove().SetIdentityTransform();
+		break;
+
+	case 562: // Reset temperature fault - use with great caution
+		if (gb.Seen('P'))
+		{
+			const int heater = gb.GetIValue();
+			if (heater >= 0 && heater < (int)Heaters)
+			{
+				reprap.ClearTemperatureFault(heater);
+			}
+			else
+			{
+				reply.printf("Invalid heater number '%d'", heater);
+				result = GCodeResult::error;
+			}
+		}
+		else
+		{
+			// Clear all heater faults
+			for (int heater = 0; heater < (int)Heaters; ++heater)
+			{
+				reprap.ClearTemperatureFault(heater);
+			}
+		}
+		heaterFaultState = HeaterFaultState::noFault;
+		break;
+
+	case 563: // Define tool
+		result = GetGCodeResultFromError(ManageTool(gb, reply));
+		break;
+
+	case 564: // Think outside the box?
+		if (gb.Seen('S'))
+		{
+			limitAxes = (gb.GetIValue() != 0);
+		}
+		else
+		{
+			reply.printf("Movement outside the bed is %spermitted", (limitAxes) ? "not " : "");
+		}
+		break;
+
+	case 566: // Set/print maximum jerk speeds
+		{
+			bool seen = false;
+			for (size_t axis = 0; axis < numTotalAxes; axis++)
+			{
+				if (gb.Seen(axisLetters[axis]))
+				{
+					platform.SetInstantDv(axis, gb.GetFValue() * distanceScale * SecondsToMinutes); // G Code feedrates are in mm/minute; we need mm/sec
+					seen = true;
+				}
+			}
+
+			if (gb.Seen(extrudeLetter))
+			{
+				seen = true;
+				float eVals[MaxExtruders];
+				size_t eCount = numExtruders;
+				gb.GetFloatArray(eVals, eCount, true);
+				for (size_t e = 0; e < eCount; e++)
+				{
+					platform.SetInstantDv(numTotalAxes + e, eVals[e] * distanceScale * SecondsToMinutes);
+				}
+			}
+			else if (!seen)
+			{
+				reply.copy("Maximum jerk rates: ");
+				for (size_t axis = 0; axis < numTotalAxes; ++axis)
+				{
+					reply.catf("%c: %.1f, ", axisLetters[axis], (double)(platform.ConfiguredInstantDv(axis) / (distanceScale * SecondsToMinutes)));
+				}
+				reply.cat("E:");
+				char sep = ' ';
+				for (size_t extruder = 0; extruder < numExtruders; extruder++)
+				{
+					reply.catf("%c%.1f", sep, (double)(platform.ConfiguredInstantDv(extruder + numTotalAxes) / (distanceScale * SecondsToMinutes)));
+					sep = ':';
+				}
+			}
+		}
+		break;
+
+	case 567: // Set/report tool mix ratios
+		if (gb.Seen('P'))
+		{
+			const int8_t tNumber = gb.GetIValue();
+			Tool* const tool = reprap.GetTool(tNumber);
+			if (tool != nullptr)
+			{
+				if (gb.Seen(extrudeLetter))
+				{
+					float eVals[MaxExtruders];
+					size_t eCount = tool->DriveCount();
+					gb.GetFloatArray(eVals, eCount, false);
+					if (eCount != tool->DriveCount())
+					{
+						reply.printf("Setting mix ratios - wrong number of E drives: %s", gb.Buffer());
+					}
+					else
+					{
+						tool->DefineMix(eVals);
+					}
+				}
+				else
+				{
+					reply.printf("Tool %d mix ratios:", tNumber);
+					char sep = ' ';
+					for (size_t drive = 0; drive < tool->DriveCount(); drive++)
+					{
+						reply.catf("%c%.3f", sep, (double)tool->GetMix()[drive]);
+						sep = ':';
+					}
+				}
+			}
+		}
+		break;
+
+	case 568: // Turn on/off automatic tool mixing
+		reply.copy("The M568 command is no longer needed");
+		break;
+
+	case 569: // Set/report axis direction
+		if (gb.Seen('P'))
+		{
+			const size_t drive = gb.GetIValue();
+			if (drive < DRIVES)
+			{
+				bool seen = false;
+				if (gb.Seen('S'))
+				{
+					if (!LockMovementAndWaitForStandstill(gb))
+					{
+						return false;
+					}
+					platform.SetDirectionValue(drive, gb.GetIValue() != 0);
+					seen = true;
+				}
+				if (gb.Seen('R'))
+				{
+					if (!LockMovementAndWaitForStandstill(gb))
+					{
+						return false;
+					}
+					platform.SetEnableValue(drive, (int8_t)gb.GetIValue());
+					seen = true;
+				}
+				if (gb.Seen('T'))
+				{
+					platform.SetDriverStepTiming(drive, gb.GetFValue());
+					seen = true;
+				}
+				bool badParameter = false;
+				for (size_t axis = 0; axis < numTotalAxes; ++axis)
+				{
+					if (gb.Seen(axisLetters[axis]))
+					{
+						badParameter = true;
+					}
+				}
+				if (gb.Seen(extrudeLetter))
+				{
+					badParameter = true;
+				}
+				if (badParameter)
+				{
+					platform.Message(ErrorMessage, "M569 no longer accepts XYZE parameters; use M584 instead\n");
+				}
+				else if (!seen)
+				{
+					reply.printf("A %d sends drive %u forwards, a %d enables it, and the minimum pulse width is %.1f microseconds",
+								(int)platform.GetDirectionValue(drive), drive,
+								(int)platform.GetEnableValue(drive),
+								(double)platform.GetDriverStepTiming(drive));
+				}
+			}
+		}
+		break;
+
+	case 570: // Set/report heater monitoring
+		{
+			bool seen = false;
+			if (gb.Seen('S'))
+			{
+				seen = true;
+				heaterFaultTimeout = gb.GetUIValue() * (60 * 1000);
+			}
+			if (gb.Seen('H'))
+			{
+				const int heater = gb.GetIValue();
+				if (heater >= 0 && heater < (int)Heaters)
+				{
+					bool seenValue = false;
+					float maxTempExcursion, maxFaultTime;
+					reprap.GetHeat().GetFaultDetectionParameters(heater, maxTempExcursion, maxFaultTime);
+					gb.TryGetFValue('P', maxFaultTime, seenValue);
+					gb.TryGetFValue('T', maxTempExcursion, seenValue);
+					if (seenValue)
+					{
+						reprap.GetHeat().SetFaultDetectionParameters(heater, maxTempExcursion, maxFaultTime);
+					}
+					else if (!seen)
+					{
+						reply.printf("Heater %u allowed excursion %.1f" DEGREE_SYMBOL "C, fault trigger time %.1f seconds", heater, (double)maxTempExcursion, (double)maxFaultTime);
+					}
+				}
+				seen = true;
+			}
+			if (!seen)
+			{
+				reply.printf("Print will be terminated if a heater fault is not reset within %" PRIu32 " minutes", heaterFaultTimeout/(60 * 1000));
+			}
+		}
+		break;
+
+	case 571: // Set output on extrude
+		{
+			bool seen = false;
+			if (gb.Seen('P'))
+			{
+				const int pwmPin = gb.GetIValue();
+				if (!platform.SetExtrusionAncilliaryPwmPin(pwmPin))
+				{
+					reply.printf("Logical pin %d is already in use or not available for use by M571", pwmPin);
+					break;			// don't process 'S' parameter if the pin was wrong
+				}
+				seen = true;
+			}
+			if (gb.Seen('F'))
+			{
+				platform.SetExtrusionAncilliaryPwmFrequency(gb.GetFValue());
+			}
+			if (gb.Seen('S'))
+			{
+				platform.SetExtrusionAncilliaryPwmValue(gb.GetFValue());
+				seen = true;
+			}
+			if (!seen)
+			{
+				reply.printf("Extrusion ancillary PWM %.3f at %.1fHz on pin %u",
+								(double)platform.GetExtrusionAncilliaryPwmValue(),
+								(double)platform.GetExtrusionAncilliaryPwmFrequency(),
+								platform.GetExtrusionAncilliaryPwmPin());
+			}
+		}
+		break;
+
+	case 572: // Set/report pressure advance
+		if (gb.Seen('S'))
+		{
+			const float advance = gb.GetFValue();
+			if (gb.Seen('D'))
+			{
+				uint32_t eDrive[MaxExtruders];
+				size_t eCount = MaxExtruders;
+				gb.GetUnsignedArray(eDrive, eCount);
+				for (size_t i = 0; i < eCount; i++)
+				{
+					if (eDrive[i] >= numExtruders)
+					{
+						reply.printf("Invalid extruder number '%" PRIu32 "'", eDrive[i]);
+						result = GCodeResult::error;
+						break;
+					}
+					platform.SetPressureAdvance(eDrive[i], advance);
+				}
+			}
+		}
+		else
+		{
+			reply.copy("Extruder pressure advance");
+			char c = ':';
+			for (size_t i = 0; i < numExtruders; ++i)
+			{
+				reply.catf("%c %.3f", c, (double)platform.GetPressureAdvance(i));
+				c = ',';
+			}
+		}
+		break;
+
+	case 573: // Report heater average PWM
+		if (gb.Seen('P'))
+		{
+			const int heater = gb.GetIValue();
+			if (heater >= 0 && heater < (int)Heaters)
+			{
+				reply.printf("Average heater %d PWM: %.3f", heater, (double)reprap.GetHeat().GetAveragePWM(heater));
+			}
+		}
+		break;
+
+	case 574: // Set endstop configuration
+		{
+			bool seen = false;
+			const uint8_t inputType = (gb.Seen('S')) ? gb.GetUIValue() : 1;
+			for (size_t axis = 0; axis < numTotalAxes; ++axis)
+			{
+				if (gb.Seen(axisLetters[axis]))
+				{
+					const int ival = gb.GetIValue();
+					if (ival >= 0 && ival <= 3)
+					{
+						platform.SetEndStopConfiguration(axis, (EndStopPosition) ival, (EndStopInputType)inputType);
+						seen = true;
+					}
+				}
+			}
+			if (!seen)
+			{
+				reply.copy("Endstop configuration:");
+				EndStopPosition config;
+				EndStopInputType inputType;
+				for (size_t axis = 0; axis < numTotalAxes; ++axis)
+				{
+					platform.GetEndStopConfiguration(axis, config, inputType);
+					reply.catf(" %c: %s", axisLetters[axis],
+								(config == EndStopPosition::highEndStop) ? "high end"
+									: (config == EndStopPosition::lowEndStop) ? "low end"
+										: "none");
+					if (config == EndStopPosition::noEndStop)
+					{
+						reply.cat(',');
+					}
+					else
+					{
+						reply.catf(" %s,",
+									(inputType == EndStopInputType::activeHigh) ? "active high switch"
+										: (inputType == EndStopInputType::activeHigh) ? "active low switch"
+											: (inputType == EndStopInputType::zProbe) ? "Z probe"
+												: (inputType == EndStopInputType::motorStall) ? "motor stall"
+													: "unknown type"
+									);
+					}
+				}
+			}
+		}
+		break;
+
+	case 575: // Set communications parameters
+		if (gb.Seen('P'))
+		{
+			size_t chan = gb.GetIValue();
+			if (chan < NUM_SERIAL_CHANNELS)
+			{
+				bool seen = false;
+				if (gb.Seen('B'))
+				{
+					platform.SetBaudRate(chan, gb.GetIValue());
+					seen = true;
+				}
+				if (gb.Seen('S'))
+				{
+					uint32_t val = gb.GetIValue();
+					platform.SetCommsProperties(chan, val);
+					switch (chan)
+					{
+					case 0:
+						serialGCode->SetCommsProperties(val);
+						break;
+					case 1:
+						auxGCode->SetCommsProperties(val);
+						break;
+					default:
+						break;
+					}
+					seen = true;
+				}
+				if (!seen)
+				{
+					uint32_t cp = platform.GetCommsProperties(chan);
+					reply.printf("Channel %d: baud rate %" PRIu32 ", %s checksum", chan, platform.GetBaudRate(chan), (cp & 1) ? "requires" : "does not require");
+				}
+			}
+		}
+		break;
+
+	case 576: // Set/report step pulse coalescing window
+		if (gb.Seen('S'))
+		{
+			const uint32_t window = ((uint64_t)gb.GetUIValue() * DDA::stepClockRate)/1000000;
+			DDA::stepCoalesceClocks = max<uint32_t>(window, DDA::minInterruptInterval);
+		}
+		else
+		{
+			reply.printf("Step pulses up to %" PRIu32 "us early are coalesced into one interrupt",
+							(uint32_t)(((uint64_t)DDA::stepCoalesceClocks * 1000000)/DDA::stepClockRate));
+		}
+		break;
+
+	case 577: // Wait until endstop is triggered
+		if (gb.Seen('S'))
+		{
+			// Determine trigger type
+			EndStopHit triggerCondition;
+			switch (gb.GetIValue())
+			{
+				case 1:
+					triggerCondition = EndStopHit::lowHit;
+					break;
+				case 2:
+					triggerCondition = EndStopHit::highHit;
+					break;
+				case 3:
+					triggerCondition = EndStopHit::nearStop;
+					break;
+				default:
+					triggerCondition = EndStopHit::noStop;
+					break;
+			}
+
+			// Axis endstops
+			for (size_t axis=0; axis < numTotalAxes; axis++)
+			{
+				if (gb.Seen(axisLetters[axis]))
+				{
+					if (platform.Stopped(axis) != triggerCondition)
+					{
+						result = GCodeResult::notFinished;
+						break;
+					}
+				}
+			}
+
+			// Extruder drives
+			if (gb.Seen(extrudeLetter))
+			{
+				size_t eDriveCount = MaxExtruders;
+				uint32_t eDrives[MaxExtruders];
+				gb.GetUnsignedArray(eDrives, eDriveCount);
+				for (size_t extruder = 0; extruder < eDriveCount; extruder++)
+				{
+					const size_t eDrive = eDrives[extruder];
+					if (eDrive >= MaxExtruders)
+					{
+						reply.printf("Invalid extruder drive '%u'", eDrive);
+						result = GCodeResult::error;
+						break;
+					}
+
+					if (platform.Stopped(eDrive + E0_AXIS) != triggerCondition)
+					{
+						result = GCodeResult::notFinished;
+						break;
+					}
+				}
+			}
+		}
+		break;
+
+#if SUPPORT_INKJET
+	case 578: // Fire Inkjet bits
+		if (!AllMovesAreFinishedAndMoveBufferIsLoaded())
+		{
+			return false;
+		}
+
+		if (gb.Seen('S')) // Need to handle the 'P' parameter too; see http://reprap.org/wiki/G-code#M578:_Fire_inkjet_bits
+		{
+			platform.Inkjet(gb.GetIValue());
+		}
+		break;
+#endif
+
+	case 579: // Scale Cartesian axes (mostly for Delta configurations)
+		{
+			bool seen = false;
+			for (size_t axis = 0; axis < numVisibleAxes; axis++)
+			{
+				gb.TryGetFValue(axisLetters[axis], axisScaleFactors[axis], seen);
+			}
+
+			if (!seen)
+			{
+				char sep = ':';
+				reply.copy("Axis scale factors");
+				for(size_t axis = 0; axis < numVisibleAxes; axis++)
+				{
+					reply.catf("%c %c: %.3f", sep, axisLetters[axis], (double)axisScaleFactors[axis]);
+					sep = ',';
+				}
+			}
+		}
+		break;
+
+#if SUPPORT_ROLAND
+	case 580: // (De)Select Roland mill
+		if (gb.Seen('R'))
+		{
+			if (gb.GetIValue())
+			{
+				reprap.GetRoland()->Activate();
+				if (gb.Seen('P'))
+				{
+					result = reprap.GetRoland()->RawWrite(gb.GetString());
+				}
+			}
+			else
+			{
+				result = reprap.GetRoland()->Deactivate();
+			}
+		}
+		else
+		{
+			reply.printf("Roland is %s.", reprap.GetRoland()->Active() ? "active" : "inactive");
+		}
+		break;
+#endif
+
+	case 581: // Configure external trigger
+	case 582: // Check external trigger
+		result = CheckOrConfigureTrigger(gb, reply, code);
+		break;
+
+	case 583: // Enable/disable S-curve (jerk-limited) acceleration
+#if SUPPORT_SCURVE
+		if (gb.Seen('S'))
+		{
+			DDA::sCurveEnabled = (gb.GetIValue() > 0);
+		}
+		else
+		{
+			reply.printf("S-curve acceleration is %s", (DDA::sCurveEnabled) ? "enabled" : "disabled");
+		}
+#else
+		reply.copy("S-curve acceleration is not supported on this processor");
+		result = GCodeResult::error;
+#endif
+		break;
+
+	case 584: // Set axis/extruder to stepper driver(s) mapping
+		result = DoDriveMapping(gb, reply);
+		break;
+
+	case 585: // Probe Tool
+		result = ProbeTool(gb, reply);
+		break;
+
+	case 586: // Configure network protocols
+#if HAS_MULTIPLE_NETWORK_INTERFACES
+		{
+			const int interface = (gb.Seen('I') ? gb.GetIValue() : 0);
+
+			if (gb.Seen('P'))
+			{
+				const int protocol = gb.GetIValue();
+				if (gb.Seen('S'))
+				{
+					const bool enable = (gb.GetIValue() == 1);
+					if (enable)
+					{
+						const int port = (gb.Seen('R')) ? gb.GetIValue() : -1;
+						const int secure = (gb.Seen('T')) ? gb.GetIValue() : -1;
+						reprap.GetNetwork().EnableProtocol(interface, protocol, port, secure, reply);
+					}
+					else
+					{
+						reprap.GetNetwork().DisableProtocol(interface, protocol, reply);
+					}
+				}
+				break;
+			}
+
+			// Default to reporting current protocols if P or S parameter missing
+			reprap.GetNetwork().ReportProtocols(interface, reply);
+		}
+#else
+		if (gb.Seen('P'))
+		{
+			const int protocol = gb.GetIValue();
+			if (gb.Seen('S'))
+			{
+				const bool enable = (gb.GetIValue() == 1);
+				if (enable)
+				{
+					const int port = (gb.Seen('R')) ? gb.GetIValue() : -1;
+					const int secure = (gb.Seen('T')) ? gb.GetIValue() : -1;
+					reprap.GetNetwork().EnableProtocol(protocol, port, secure, reply);
+				}
+				else
+				{
+					reprap.GetNetwork().DisableProtocol(protocol, reply);
+				}
+				break;
+			}
+		}
+
+		// Default to reporting current protocols if P or S parameter missing
+		reprap.GetNetwork().ReportProtocols(reply);
+#endif
+		break;
+
+#if HAS_WIFI_NETWORKING
+	case 587:	// Add WiFi network or list remembered networks
+	case 588:	// Forget WiFi network
+	case 589:	// Configure access point
+		{
+			OutputBuffer *longReply = nullptr;
+			result = reprap.GetNetwork().HandleWiFiCode(code, gb, reply, longReply);
+			if (longReply != nullptr)
+			{
+				if (result == GCodeResult::ok)
+				{
+					UnlockAll(gb);
+					HandleReply(gb, false, longReply);
+					return true;
+				}
+				OutputBuffer::ReleaseAll(longReply);
+			}
+		}
+		break;
+#endif
+
+	case 591: // Configure filament sensor
+		if (gb.Seen('D'))
+		{
+			const unsigned int extruder = gb.GetUIValue();
+			if (extruder < numExtruders)
+			{
+				bool seen = false;
+				long sensorType;
+				gb.TryGetIValue('P', sensorType, seen);
+				if (seen)
+				{
+					FilamentSensor::SetFilamentSensorType(extruder, sensorType);
+				}
+
+				FilamentSensor *sensor = FilamentSensor::GetFilamentSensor(extruder);
+				if (sensor != nullptr)
+				{
+					// Configure the sensor
+					const bool error = sensor->Configure(gb, reply, seen);
+					result = GetGCodeResultFromError(error);
+					if (error)
+					{
+						FilamentSensor::SetFilamentSensorType(extruder, 0);		// delete the sensor
+					}
+				}
+				else if (!seen)
+				{
+					reply.printf("Extruder drive %u has no filament sensor", extruder);
+				}
+			}
+		}
+		break;
+
+#if NONLINEAR_EXTRUSION
+	case 592: // Configure nonlinear extrusion
+		if (gb.Seen('D'))
+		{
+			const unsigned int extruder = gb.GetUIValue();
+			bool seen = false;
+			float a = 0.0, b = 0.0, limit = DefaultNonlinearExtrusionLimit;
+			gb.TryGetFValue('A', a, seen);
+			gb.TryGetFValue('B', b, seen);
+			gb.TryGetFValue('L', limit, seen);
+			if (seen)
+			{
+				platform.SetNonlinearExtrusion(extruder, a, b, limit);
+			}
+			else
+			{
+				platform.GetExtrusionCoefficients(extruder, a, b, limit);
+				reply.printf("Drive %u nonlinear extrusion coefficients: A=%.3f, B=%.4f, limit=%.2f", extruder, (double)a, (double)b, (double)limit);
+			}
+		}
+		break;
+#endif
+
+	case 593: // Configure filament properties
+		// TODO: We may need this code later to restrict specific filaments to certain tools or to reset filament counters.
+		break;
+
+	case 665: // Set delta configuration
+		if (!LockMovementAndWaitForStandstill(gb))
+		{
+			return false;
+		}
+		{
+			Move& move = reprap.GetMove();
+
+			bool changedMode = false;
+			if ((gb.Seen('L') || gb.Seen('D')) && move.GetKinematics().GetKinematicsType() != KinematicsType::linearDelta)
+			{
+				// Not in delta mode, so switch to it
+				changedMode = true;
+				move.SetKinematics(KinematicsType::linearDelta);
+			}
+			bool error = false;
+			const bool changed = move.GetKinematics().Configure(code, gb, reply, error);
+			if (changedMode)
+			{
+				move.GetKinematics().GetAssumedInitialPosition(numVisibleAxes, moveBuffer.coords);
+				ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);
+			}
+			if (changed || changedMode)
+			{
+				if (reprap.GetMove().GetKinematics().LimitPosition(moveBuffer.coords, numVisibleAxes, axesHomed, false))
+				{
+					ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);	// make sure the limits are reflected in the user position
+				}
+				reprap.GetMove().SetNewPosition(moveBuffer.coords, true);
+				SetAllAxesNotHomed();
+			}
+			result = GetGCodeResultFromError(error);
+		}
+		break;
+
+	case 666: // Set delta endstop adjustments
+		if (!LockMovementAndWaitForStandstill(gb))
+		{
+			return false;
+		}
+		{
+			bool error = false;
+			const bool changed = reprap.GetMove().GetKinematics().Configure(code, gb, reply, error);
+			if (changed)
+			{
+				SetAllAxesNotHomed();
+			}
+			result = GetGCodeResultFromError(error);
+		}
+		break;
+
+	case 667: // Set CoreXY mode
+		if (!LockMovementAndWaitForStandstill(gb))
+		{
+			return false;
+		}
+		{
+			Move& move = reprap.GetMove();
+			const KinematicsType oldK = move.GetKinematics().GetKinematicsType();		// get the current kinematics type so we can tell whether it changed
+
+			bool seen = false;
+			bool changedToCartesian = false;
+			if (gb.Seen('S'))
+			{
+				// Switch to the correct CoreXY mode
+				const int mode = gb.GetIValue();
+				switch (mode)
+				{
+				case 0:
+					move.SetKinematics(KinematicsType::cartesian);
+					changedToCartesian = true;
+					break;
+
+				case 1:
+					move.SetKinematics(KinematicsType::coreXY);
+					break;
+
+				case 2:
+					move.SetKinematics(KinematicsType::coreXZ);
+					break;
+
+				default:
+					reply.printf("Mode %d is not valid", mode);
+					result = GCodeResult::error;
+					break;
+				}
+				seen = true;
+			}
+
+			if (result == GCodeResult::ok)
+			{
+				if (!changedToCartesian)		// don't ask the kinematics to process M667 if we switched to Cartesian mode
+				{
+					bool error = false;
+					if (move.GetKinematics().Configure(667, gb, reply, error))
+					{
+						seen = true;
+					}
+					result = GetGCodeResultFromError(error);
+				}
+
+				if (seen)
+				{
+					// We changed something, so reset the positions and set all axes not homed
+					if (move.GetKinematics().GetKinematicsType() != oldK)
+					{
+						move.GetKinematics().GetAssumedInitialPosition(numVisibleAxes, moveBuffer.coords);
+						ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);
+					}
+					if (reprap.GetMove().GetKinematics().LimitPosition(moveBuffer.coords, numVisibleAxes, axesHomed, false))
+					{
+						ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);	// make sure the limits are reflected in the user position
+					}
+					reprap.GetMove().SetNewPosition(moveBuffer.coords, true);
+					SetAllAxesNotHomed();
+				}
+			}
+		}
+		break;
+
+	case 669:	// Set kinematics and parameters for SCARA and other kinematics that don't use M665, M666 or M667
+		if (!LockMovementAndWaitForStandstill(gb))
+		{
+			return false;
+		}
+		{
+			Move& move = reprap.GetMove();
+			const KinematicsType oldK = move.GetKinematics().GetKinematicsType();		// get the current kinematics type so we can tell whether it changed
+
+			bool seen = false;
+			if (gb.Seen('K'))
+			{
+				const int nk = gb.GetIValue();
+				if (nk < 0 || nk >= (int)KinematicsType::unknown || !move.SetKinematics(static_cast<KinematicsType>(nk)))
+				{
+					reply.printf("Unknown kinematics type %d", nk);
+					result = GCodeResult::error;
+					break;
+				}
+				seen = true;
+			}
+			bool error = false;
+			if (move.GetKinematics().Configure(code, gb, reply, error))
+			{
+				seen = true;
+			}
+			result = GetGCodeResultFromError(error);
+
+			if (seen)
+			{
+				// We changed something significant, so reset the positions and set all axes not homed
+				if (move.GetKinematics().GetKinematicsType() != oldK)
+				{
+					move.GetKinematics().GetAssumedInitialPosition(numVisibleAxes, moveBuffer.coords);
+					ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);
+				}
+				if (reprap.GetMove().GetKinematics().LimitPosition(moveBuffer.coords, numVisibleAxes, axesHomed, false))
+				{
+					ToolOffsetInverseTransform(moveBuffer.coords, currentUserPosition);	// make sure the limits are reflected in the user position
+				}
+				reprap.GetMove().SetNewPosition(moveBuffer.coords, true);
+				SetAllAxesNotHomed();
+			}
+		}
+		break;
+
+#if SUPPORT_IOBITS
+	case 670:
+		result = GetGCodeResultFromError(reprap.GetPortControl().Configure(gb, reply));
+		break;
+#endif
+
+	case 671:	// Set Z leadscrew positions
+		if (!LockMovementAndWaitForStandstill(gb))
+		{
+			return false;
+		}
+		{
+			bool error = false;
+			(void)reprap.GetMove().GetKinematics().Configure(code, gb, reply, error);
+			result = GetGCodeResultFromError(error);
+		}
+		break;
+
+	case 594: // Report movement pipeline occupancy
+		reprap.GetMove().ReportPipelineStats(reply);
+		break;
+
+	case 595: // Set movement queue length
+		if (gb.Seen('P'))
+		{
+			if (!LockMovementAndWaitForStandstill(gb))		// the ring must be empty before it can be grown
+			{
+				return false;
+			}
+			result = GetGCodeResultFromError(!reprap.GetMove().SetQueueLength(gb.GetUIValue(), reply));
+		}
+		else
+		{
+			reply.printf("Movement queue length is %u", reprap.GetMove().GetQueueLength());
+		}
+		break;
+
+	case 596: // Configure input shaping
+#if SUPPORT_SCURVE
+		if (gb.Seen('F'))
+		{
+			const float freq = gb.GetFValue();
+			DDA::shaperHalfPeriod = (freq > 0.0) ? 1.0/(2.0 * freq) : 0.0;
+		}
+		else if (DDA::shaperHalfPeriod > 0.0)
+		{
+			reply.printf("Input shaping is centred on %.1fHz", (double)(1.0/(2.0 * DDA::shaperHalfPeriod)));
+		}
+		else
+		{
+			reply.copy("Input shaping is disabled");
+		}
+#else
+		reply.copy("Input shaping is not supported on this processor");
+		result = GCodeResult::error;
+#endif
+		break;
+
+	case 597: // Set or report the print checkpoint interval
+		if (gb.Seen('S'))
+		{
+			printCheckpointInterval = gb.GetUIValue() * 1024;
+			lastCheckpointFilePos = 0;
+		}
+		else if (printCheckpointInterval == 0)
+		{
+			reply.copy("Print checkpointing is disabled");
+		}
+		else
+		{
+			reply.printf("Print state is saved every %" PRIu32 "Kb of file progress", printCheckpointInterval / 1024);
+		}
+		break;
+
+	case 598: // Copy a file on the SD card
+		if (!LockFileSystem(gb))					// getting the file system requires locking it first
+		{
+			return false;
+		}
+		if (platform.GetMassStorage()->CopyInProgress())
+		{
+			result = platform.GetMassStorage()->AdvanceCopy(reply);
+		}
+		else
+		{
+			String<FILENAME_LENGTH> srcName, dstName;
+			bool dummy;
+			gb.TryGetQuotedString('S', srcName.GetRef(), dummy);
+			gb.TryGetQuotedString('T', dstName.GetRef(), dummy);
+			if (srcName.IsEmpty() || dstName.IsEmpty())
+			{
+				reply.copy("Source and destination filenames expected");
+				result = GCodeResult::error;
+			}
+			else if (platform.GetMassStorage()->StartCopy(srcName.c_str(), dstName.c_str()))
+			{
+				result = GCodeResult::notFinished;
+			}
+			else
+			{
+				reply.printf("Failed to start copying %s to %s", srcName.c_str(), dstName.c_str());
+				result = GCodeResult::error;
+			}
+		}
+		break;
+
+	case 672: // Program Z probe
+		result = GetGCodeResultFromError(platform.ProgramZProbe(gb, reply));
+		break;
+
+	case 701: // Load filament
+		result = LoadFilament(gb, reply);
+		break;
+
+	case 702: // Unload filament
+		result = UnloadFilament(gb, reply);
+		break;
+
+#if SUPPORT_SCANNER
+	case 750: // Enable 3D scanner extension
+		reprap.GetScanner().Enable();
+		break;
+
+	case 751: // Register 3D scanner extension over USB
+		if (&gb == serialGCode)
+		{
+			if (reprap.GetScanner().IsEnabled())
+			{
+				result = GetGCodeResultFromFinished(reprap.GetScanner().Register());
+			}
+			else
+			{
+				reply.copy("Scanner extension is not enabled");
+				result = GCodeResult::error;
+			}
+		}
+		else
+		{
+			reply.copy("Invalid source");
+			result = GCodeResult::error;
+		}
+		break;
+
+	case 752: // Start 3D scan
+		if (gb.Seen('P'))
+		{
+			String<FILENAME_LENGTH> file;
+			gb.GetPossiblyQuotedString(file.GetRef());
+			if (gb.Seen('S'))
+			{
+				const int sParam = gb.GetIValue();
+				if (reprap.GetScanner().IsEnabled())
+				{
+					if (reprap.GetScanner().IsRegistered())
+					{
+						result = GetGCodeResultFromFinished(reprap.GetScanner().StartScan(file.Pointer(), sParam));
+					}
+					else
+					{
+						reply.copy("Scanner is not registered");
+						result = GCodeResult::error;
+					}
+				}
+				else
+				{
+					reply.copy("Scanner extension is not enabled");
+					result = GCodeResult::error;
+				}
+			}
+			else
+			{
+				reply.copy("Missing length/degree parameter");
+				result = GCodeResult::error;
+			}
+		}
+		else
+		{
+			reply.copy("Missing filename");
+			result = GCodeResult::error;
+		}
+		break;
+
+	case 753: // Cancel current 3D scanner action
+		if (reprap.GetScanner().IsEnabled())
+		{
+			if (reprap.GetScanner().IsRegistered())
+			{
+				result = GetGCodeResultFromFinished(reprap.GetScanner().Cancel());
+			}
+			else
+			{
+				reply.copy("Scanner is not registered");
+				result = GCodeResult::error;
+			}
+		}
+		else
+		{
+			reply.copy("Scanner extension is not enabled");
+			result = GCodeResult::error;
+		}
+		break;
+
+	case 754: // Calibrate scanner
+		if (reprap.GetScanner().IsEnabled())
+		{
+			if (reprap.GetScanner().IsRegistered())
+			{
+				result = GetGCodeResultFromFinished(reprap.GetScanner().Calibrate());
+			}
+			else
+			{
+				reply.copy("Scanner is not registered");
+				result = GCodeResult::error;
+			}
+		}
+		else
+		{
+			reply.copy("Scanner extension is not enabled");
+			result = GCodeResult::error;
+		}
+		break;
+
+	case 755: // Set alignment mode for 3D scanner
+		if (reprap.GetScanner().IsEnabled())
+		{
+			if (reprap.GetScanner().IsRegistered())
+			{
+				const bool on = (gb.Seen('P') && gb.GetIValue() > 0);
+				result = GetGCodeResultFromFinished(reprap.GetScanner().SetAlignment(on));
+			}
+			else
+			{
+				reply.copy("Scanner is not registered");
+				result = GCodeResult::error;
+			}
+		}
+		else
+		{
+			reply.copy("Scanner extension is not enabled");
+			result = GCodeResult::error;
+		}
+		break;
+
+	case 756: // Shutdown 3D scanner
+		if (reprap.GetScanner().IsEnabled())
+		{
+			if (reprap.GetScanner().IsRegistered())
+			{
+				result = GetGCodeResultFromFinished(reprap.GetScanner().Shutdown());
+			}
+			else
+			{
+				reply.copy("Scanner is not registered");
+				result = GCodeResult::error;
+			}
+		}
+		else
+		{
+			reply.copy("Scanner extension is not enabled");
+			result = GCodeResult::error;
+		}
+		break;
+#else
+	case 750:
+	case 751:
+	case 752:
+	case 753:
+	case 754:
+	case 755:
+	case 756:
+		reply.copy("Scanner support not built-in");
+		result = GCodeResult::error;
+		break;
+#endif
+
+	case 905: // Set current RTC date and time
+		result = SetDateTime(gb, reply);
+		break;
+
+	case 906: // Set/report Motor currents
+	case 913: // Set/report motor current percent
+#if HAS_SMART_DRIVERS
+	case 917: // Set/report standstill motor current percentage
+#endif
+		// Note that we no longer wait for movement to stop. This is so that we can use these commands (in particular, M913) in the M911 power fail script.
+		{
+			bool seen = false;
+			for (size_t axis = 0; axis < numTotalAxes; axis++)
+			{
+				if (gb.Seen(axisLetters[axis]))
+				{
+					platform.SetMotorCurrent(axis, gb.GetFValue(), code);
+					seen = true;
+				}
+			}
+
+			if (gb.Seen(extrudeLetter))
+			{
+				seen = true;
+				float eVals[MaxExtruders];
+				size_t eCount = numExtruders;
+				gb.GetFloatArray(eVals, eCount, true);
+				for (size_t e = 0; e < eCount; e++)
+				{
+					platform.SetMotorCurrent(numTotalAxes + e, eVals[e], code);
+				}
+			}
+
+			if (code == 906 && gb.Seen('I'))
+			{
+				seen = true;
+				const float idleFactor = gb.GetFValue();
+				if (idleFactor >= 0 && idleFactor <= 100.0)
+				{
+					platform.SetIdleCurrentFactor(idleFactor/100.0);
+				}
+			}
+
+			if (!seen)
+			{
+				reply.copy(	(code == 913) ? "Motor current % of normal - "
+#if HAS_SMART_DRIVERS
+								: (code == 917) ? "Motor standstill current % of normal - "
+#endif
+									: "Motor current (mA) - "
+						);
+				for (size_t axis = 0; axis < numTotalAxes; ++axis)
+				{
+					reply.catf("%c:%d, ", axisLetters[axis], (int)platform.GetMotorCurrent(axis, code));
+				}
+				reply.cat("E");
+				for (size_t extruder = 0; extruder < numExtruders; extruder++)
+				{
+					reply.catf(":%d", (int)platform.GetMotorCurrent(extruder + numTotalAxes, code));
+				}
+				if (code == 906)
+				{
+					reply.catf(", idle factor %d%%", (int)(platform.GetIdleCurrentFactor() * 100.0));
+				}
+			}
+		}
+		break;
+
+#if HAS_VOLTAGE_MONITOR
+	case 911: // Enable auto save
+		if (gb.Seen('S'))
+		{
+			const float saveVoltage = gb.GetFValue();
+			if (saveVoltage < 10.0)
+			{
+				platform.DisableAutoSave();
+			}
+			else
+			{
+				float resumeVoltage = saveVoltage + 1.0;		// set up default resume voltage
+				bool dummy;
+				gb.TryGetFValue('R', resumeVoltage, dummy);
+
+				String<80> powerFailString;
+				bool seenCommandString = false;
+				gb.TryGetQuotedString('P', powerFailString.GetRef(), seenCommandString);
+				if (seenCommandString)
+				{
+					// Replace the power fail script atomically
+					char *newPowerFailScript = new char[powerFailString.strlen() + 1];
+					strcpy(newPowerFailScript, powerFailString.c_str());
+					std::swap(newPowerFailScript, powerFailScript);
+					delete[] newPowerFailScript;
+				}
+				else if (powerFailScript == nullptr)
+				{
+					reply.copy("No power fail script provided");
+					result = GCodeResult::error;
+					break;
+				}
+				platform.EnableAutoSave(saveVoltage, resumeVoltage);
+			}
+		}
+		else
+		{
+			float saveVoltage, resumeVoltage;
+			if (platform.GetAutoSaveSettings(saveVoltage, resumeVoltage))
+			{
+				reply.printf("Auto save voltage %.1fV, resume %.1fV, script \"%s\"", (double)saveVoltage, (double)resumeVoltage, (powerFailScript == nullptr) ? "" : powerFailScript);
+			}
+			else
+			{
+				reply.copy("Auto save is disabled");
+			}
+		}
+		break;
+#endif
+
+#if HAS_CPU_TEMP_SENSOR
+	case 912: // Set electronics temperature monitor adjustment
+		// Currently we ignore the P parameter (i.e. temperature measurement channel)
+		if (gb.Seen('S'))
+		{
+			platform.SetMcuTemperatureAdjust(gb.GetFValue());
+		}
+		else
+		{
+			reply.printf("MCU temperature calibration adjustment is %.1f" DEGREE_SYMBOL "C", (double)platform.GetMcuTemperatureAdjust());
+		}
+		break;
+#endif
+
+	// For case 913, see 906
+
+#if defined(__ALLIGATOR__)
+	case 914: 				// Set/Get J14 Expansion Voltage Level Translator on Port J5, 5.5V or 3.3V
+			  	  	  	  	// Get Piggy module presence status
+		if (gb.Seen('S'))
+		{
+			const int voltageValue = gb.GetIValue();
+			if (voltageValue != 5 && voltageValue != 3 )
+			{
+				reply.printf("The Expansion Voltage Translator does not support %dV. \n Only 5V or 3V are supported.",voltageValue);
+			}
+			else
+			{
+				// Change Voltage translator level
+				digitalWrite(ExpansionVoltageLevelPin, voltageValue == 5);
+			}
+		}
+		else
+		{
+			// Change Voltage translator level Status
+			reply.printf("The Voltage of Expansion Translator is %dV \nPiggy module %s",
+					digitalRead(ExpansionVoltageLevelPin) ? 5 : 3 ,
+					digitalRead(ExpansionPiggyDetectPin) ? "not detected" : "detected");
+		}
+		break;
+#endif
+
+#if HAS_STALL_DETECT
+	case 915:
+		result = GetGCodeResultFromError(platform.ConfigureStallDetection(gb, reply));
+		break;
+#endif
+
+#if HAS_VOLTAGE_MONITOR
+	case 916:
+		if (!platform.GetMassStorage()->FileExists(platform.GetSysDir(), RESUME_AFTER_POWER_FAIL_G))
+		{
+			reply.copy("No resume file found");
+			result = GCodeResult::error;
+		}
+		else if (!platform.GetMassStorage()->FileExists(platform.GetSysDir(), RESUME_PROLOGUE_G))
+		{
+			reply.printf("Resume prologue file '%s' not found", RESUME_PROLOGUE_G);
+			result = GCodeResult::error;
+		}
+		else
+		{
+			DoFileMacro(gb, RESUME_AFTER_POWER_FAIL_G, true);
+		}
+		break;
+#endif
+
+	case 929: // Start/stop event logging
+		result = GetGCodeResultFromError(platform.ConfigureLogging(gb, reply));
+		break;
+
+	case 930: // Configure telemetry sampling, or fetch the buffered samples
+		if (gb.Seen('P') && gb.GetIValue() > 0)
+		{
+			OutputBuffer *telemetryResponse;
+			if (!OutputBuffer::Allocate(telemetryResponse))
+			{
+				return false;											// cannot allocate an output buffer, try again later
+			}
+			platform.ReportTelemetry(telemetryResponse, (gb.Seen('D')) ? gb.GetUIValue() : 1);
+			HandleReply(gb, false, telemetryResponse);
+			return true;
+		}
+		result = GetGCodeResultFromError(platform.ConfigureTelemetry(gb, reply));
+		break;
+
+	case 997: // Perform firmware update
+		result = UpdateFirmware(gb, reply);
+		break;
+
+	case 998:
+		// The input handling code replaces the gcode by this when it detects a checksum error.
+		// Since we have no way of asking for the line to be re-sent, just report an error.
+		if (gb.Seen('P'))
+		{
+			const int val = gb.GetIValue();
+			if (val != 0)
+			{
+				reply.printf("Checksum error on line %d", val);
+			}
+		}
+		break;
+
+	case 999:
+		result = DoDwellTime(gb, 500);		// wait half a second to allow the response to be sent back to the web server, otherwise it may retry
+		if (result != GCodeResult::notFinished)
+		{
+			reprap.EmergencyStop();			// this disables heaters and drives - Duet WiFi pre-production boards need drives disabled here
+			bool doErase;
+			if (gb.Seen('P'))
+			{
+				String<8> eraseString;
+				gb.GetPossiblyQuotedString(eraseString.GetRef());
+				doErase = StringStartsWith(eraseString.Pointer(), "ERASE");
+			}
+			else
+			{
+				doErase = false;
+			}
+			const uint16_t reason = (doErase)
+									? (uint16_t)SoftwareResetReason::erase
+									: (uint16_t)SoftwareResetReason::user;
+			platform.SoftwareReset(reason);			// doesn't return
+		}
+		break;
+
+
+	default:
+		reply.copy("Unsupported command");
+		result = GCodeResult::error;
+		break;
+	}
+
+	return FinishedMcode(gb, reply, code, result);
+}
+
+// End
@@ -0,0 +1,91 @@
+/*
+ * JobQueue.cpp
+ *
+ * Queue of SD files to print one after another
+ */
+
+#include "JobQueue.h"
+#include "OutputMemory.h"
+
+JobQueue::JobQueue() : head(0), numJobs(0)
+{
+}
+
+// Append a job to the queue, returning false if the queue is full
+bool JobQueue::Add(const char *fileName, const char *macroName, StringRef& reply)
+{
+	if (numJobs == MaxQueuedJobs)
+	{
+		reply.printf("Job queue is full (maximum %u jobs)", MaxQueuedJobs);
+		return false;
+	}
+
+	Job& job = jobs[(head + numJobs) % MaxQueuedJobs];
+	SafeStrncpy(job.fileName, fileName, ARRAY_SIZE(job.fileName));
+	SafeStrncpy(job.macroName, (macroName != nullptr) ? macroName : "", ARRAY_SIZE(job.macroName));
+	++numJobs;
+	return true;
+}
+
+void JobQueue::Clear()
+{
+	head = numJobs = 0;
+}
+
+// Return the filename of the next job, or nullptr if the queue is empty
+const char *JobQueue::GetNextFileName() const
+{
+	return (numJobs != 0) ? jobs[head].fileName : nullptr;
+}
+
+// Return the setup macro of the next job, or nullptr if it has none
+const char *JobQueue::GetNextMacroName() const
+{
+	return (numJobs != 0 && jobs[head].macroName[0] != 0) ? jobs[head].macroName : nullptr;
+}
+
+// Remove the job at the head of the queue
+void JobQueue::RemoveNextJob()
+{
+	if (numJobs != 0)
+	{
+		head = (head + 1) % MaxQueuedJobs;
+		--numJobs;
+	}
+}
+
+// Append a human-readable listing of the queue to 'reply'
+void JobQueue::ListJobs(StringRef& reply) const
+{
+	if (numJobs == 0)
+	{
+		reply.copy("Job queue is empty");
+	}
+	else
+	{
+		reply.printf("%u queued job(s):", numJobs);
+		for (size_t i = 0; i < numJobs; ++i)
+		{
+			const Job& job = jobs[(head + i) % MaxQueuedJobs];
+			reply.catf("\n%u: %s", i + 1, job.fileName);
+			if (job.macroName[0] != 0)
+			{
+				reply.catf(" (macro %s)", job.macroName);
+			}
+		}
+	}
+}
+
+// Append the job queue details to a status response
+void JobQueue::AppendJsonReport(OutputBuffer *response) const
+{
+	response->catf(",\"jobQueue\":{\"numJobs\":%u", numJobs);
+	if (numJobs != 0)
+	{
+		response->cat(",\"nextFile\":");
+		response->EncodeString(jobs[head].fileName, ARRAY_SIZE(jobs[head].fileName), false);
+	}
+	response->cat('}');
+}
+
+// End
@@ -0,0 +1,51 @@
+/*
+ * JobQueue.h
+ *
+ * Queue of SD files to print one after another, with the next job's file information
+ * gathered while the current job is still printing
+ */
+
+#ifndef SRC_GCODES_JOBQUEUE_H_
+#define SRC_GCODES_JOBQUEUE_H_
+
+#include "RepRapFirmware.h"
+
+class OutputBuffer;
+
+// How many jobs can be queued. Each entry holds two filenames, so keep this modest on the SAM3X.
+#if SAM4E || SAM4S || SAME70
+const size_t MaxQueuedJobs = 10;
+#else
+const size_t MaxQueuedJobs = 4;
+#endif
+
+class JobQueue
+{
+	public:
+		JobQueue();
+
+		bool Add(const char *fileName, const char *macroName, StringRef& reply);	// Append a job, returning false if the queue is full
+		void Clear();
+		bool IsEmpty() const { return numJobs == 0; }
+		size_t GetNumJobs() const { return numJobs; }
+
+		const char *GetNextFileName() const;		// Return the filename of the next job, or nullptr if the queue is empty
+		const char *GetNextMacroName() const;		// Return the setup macro of the next job, or nullptr if it has none
+		void RemoveNextJob();						// Remove the job at the head of the queue
+
+		void ListJobs(StringRef& reply) const;		// Append a human-readable listing of the queue to 'reply'
+		void AppendJsonReport(OutputBuffer *response) const;	// Append the job queue details to a status response
+
+	private:
+		struct Job
+		{
+			char fileName[FILENAME_LENGTH];
+			char macroName[FILENAME_LENGTH];		// empty if no setup macro was given
+		};
+
+		Job jobs[MaxQueuedJobs];
+		size_t head;								// index of the next job to be printed
+		size_t numJobs;
+};
+
+#endif /* SRC_GCODES_JOBQUEUE_H_ */
@@ -15,7 +15,7 @@ extern StringRef scratchString;
 // Set up sensible defaults here in case the user enables the heater without specifying values for all the parameters.
 FopDt::FopDt()
 	: gain(DefaultHotEndHeaterGain), timeConstant(DefaultHotEndHeaterTimeConstant), deadTime(DefaultHotEndHeaterDeadTime), maxPwm(1.0), standardVoltage(0.0), pwmFreq(0),
-	  enabled(false), usePid(true), inverted(false), pidParametersOverridden(false)
+	  enabled(false), usePid(true), useFeedForward(false), inverted(false), pidParametersOverridden(false)
 {
 }
 
@@ -73,7 +73,8 @@ void FopDt::SetM301PidParameters(const M301PidParameters& pp)
 bool FopDt::WriteParameters(FileStore *f, size_t heater) const
 {
 	scratchString.printf("M307 H%u A%.1f C%.1f D%.1f S%.2f V%.1f B%d\n",
-							heater, (double)gain, (double)timeConstant, (double)deadTime, (double)maxPwm, (double)standardVoltage, (usePid) ? 0 : 1);
+							heater, (double)gain, (double)timeConstant, (double)deadTime, (double)maxPwm, (double)standardVoltage,
+							(!usePid) ? 1 : (useFeedForward) ? 2 : 0);
 	bool ok = f->Write(scratchString.Pointer());
 	if (ok && pidParametersOverridden)
 	{
@@ -85,7 +86,7 @@ bool FopDt::WriteParameters(FileStore *f, size_t heater) const
 }
 
 /* Re-calculate the PID parameters.
- * For some possible formulas, see "Comparison of some well-known PID tuning formulas", Computers and Chemical Engineering 30 (2006) 1416�1423,
+ * For some possible formulas, see "Comparison of some well-known PID tuning formulas", Computers and Chemical Engineering 30 (2006) 1416�1423,
  * available at http://www.ece.ualberta.ca/~marquez/journal_publications_files/papers/tan_cce_06.pdf
  * Here are some examples, where r = td/tc:
  *    Cohen-Coon (modified to use half the original Kc value):
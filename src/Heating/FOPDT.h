@@ -43,6 +43,8 @@ public:
 	float GetMaxPwm() const { return maxPwm; }
 	float GetVoltage() const { return standardVoltage; }
 	bool UsePid() const { return usePid; }
+	bool UsesFeedForward() const { return useFeedForward; }
+	void SetFeedForwardMode(bool ff) { useFeedForward = ff; }
 	bool IsInverted() const { return inverted; }
 	bool IsEnabled() const { return enabled; }
 	uint16_t GetPwmFrequency() const { return pwmFreq; }
@@ -68,6 +70,7 @@ private:
 	PwmFrequency pwmFreq;
 	bool enabled;
 	bool usePid;
+	bool useFeedForward;					// if using PID, whether the model supplies a feed-forward term and PID only trims the residual
 	bool inverted;
 	bool pidParametersOverridden;
 
@@ -24,13 +24,14 @@ Licence: GPL
 #include "Platform.h"
 #include "RepRap.h"
 #include "Sensors/TemperatureSensor.h"
+#include "Sensors/SpiTemperatureSensor.h"
 
 #if SUPPORT_DHT_SENSOR
 # include "Sensors/DhtSensor.h"
 #endif
 
 Heat::Heat(Platform& p)
-	: platform(p), active(false), coldExtrude(false), heaterBeingTuned(-1), lastHeaterTuned(-1)
+	: platform(p), active(false), coldExtrude(false), heatersBeingTuned(0), lastHeaterTuned(-1)
 {
 	ARRAY_INIT(bedHeaters, DefaultBedHeaters);
 	ARRAY_INIT(chamberHeaters, DefaultChamberHeaters);
@@ -120,7 +121,8 @@ void Heat::Init()
 	virtualHeaterSensors[2] = TemperatureSensor::Create(FirstTmcDriversSenseChannel + 1);
 #endif
 
-	lastTime = millis() - platform.HeatSampleInterval();		// flag the PIDS as due for spinning
+	ResetSampleIntervals();
+	lastTime = millis() - platform.HeatSampleInterval();		// flag the housekeeping as due
 	longWait = millis();
 	coldExtrude = false;
 	active = true;
@@ -135,26 +137,83 @@ void Heat::Exit()
 	active = false;
 }
 
+// Reset all heaters to the global sample interval, with their phases staggered so that the SPI sensor
+// reads are spread across the interval instead of bunching on one Spin pass
+void Heat::ResetSampleIntervals()
+{
+	const uint32_t interval = platform.HeatSampleInterval();
+	for (size_t heater = 0; heater < Heaters; heater++)
+	{
+		pids[heater]->SetSampleInterval(interval, (heater * interval)/Heaters);
+	}
+}
+
+// Set the sample interval for one heater, e.g. a fast loop for a low-mass hot end and a slow one for the bed
+void Heat::SetSampleInterval(int8_t heater, uint32_t interval)
+{
+	if (heater >= 0 && heater < (int)Heaters)
+	{
+		pids[heater]->SetSampleInterval(interval, (heater * interval)/Heaters);
+	}
+}
+
+uint32_t Heat::GetSampleInterval(int8_t heater) const
+{
+	return (heater >= 0 && heater < (int)Heaters) ? pids[heater]->GetSampleInterval() : 0;
+}
+
 void Heat::Spin()
 {
 	if (active)
 	{
-		// See if it is time to spin the PIDs
+		// See which heaters are due to be sampled. Each heater has its own sampling interval (M135 Pn Snnn),
+		// so a low-mass hot end can run a fast control loop while the bed runs a slow one.
 		const uint32_t now = millis();
-		if (now - lastTime >= platform.HeatSampleInterval())
+		uint32_t heatersDue = 0;
+		for (size_t heater = 0; heater < Heaters; heater++)
 		{
-			lastTime = now;
+			if (pids[heater]->SampleDue(now))
+			{
+				heatersDue |= 1u << heater;
+			}
+		}
+
+		if (heatersDue != 0)
+		{
+			// Acquire the SPI bus once for all the heaters sampled on this pass, so that when several SPI
+			// temperature sensors fall due together their reads run as back-to-back transactions instead of
+			// each one paying the bus acquisition and device setup cost separately
+			SpiTemperatureSensor::BeginBatch();
 			for (size_t heater = 0; heater < Heaters; heater++)
 			{
-				pids[heater]->Spin();
+				if ((heatersDue & (1u << heater)) != 0)
+				{
+					pids[heater]->Spin();
+				}
 			}
+			SpiTemperatureSensor::EndBatch();
+		}
 
-			// See if we have finished tuning a PID
-			if (heaterBeingTuned != -1 && !pids[heaterBeingTuned]->IsTuning())
+		// Do the once-per-interval housekeeping on the old fixed cadence
+		if (now - lastTime >= platform.HeatSampleInterval())
+		{
+			lastTime = now;
+
+			// See if any PIDs have finished tuning
+			if (heatersBeingTuned != 0)
 			{
-				lastHeaterTuned = heaterBeingTuned;
-				heaterBeingTuned = -1;
+				for (size_t heater = 0; heater < Heaters; heater++)
+				{
+					if ((heatersBeingTuned & (1u << heater)) != 0 && !pids[heater]->IsTuning())
+					{
+						heatersBeingTuned &= ~(1u << heater);
+						lastHeaterTuned = (int8_t)heater;
+					}
+				}
 			}
+
+			// See if any standby tools look due to be selected again soon, and start reheating them early if so
+			reprap.CheckToolReheat();
 		}
 
 #if SUPPORT_DHT_SENSOR
@@ -279,6 +338,7 @@ void Heat::SetActiveTemperature(int8_t heater, float t)
 	if (heater >= 0 && heater < (int)Heaters)
 	{
 		pids[heater]->SetActiveTemperature(t);
+		reprap.RecordStateChange(ChangedField::heaterActiveTemp, heater, t);	// setpoints are omitted from differential status responses
 	}
 }
 
@@ -292,6 +352,7 @@ void Heat::SetStandbyTemperature(int8_t heater, float t)
 	if (heater >= 0 && heater < (int)Heaters)
 	{
 		pids[heater]->SetStandbyTemperature(t);
+		reprap.RecordStateChange(ChangedField::heaterStandbyTemp, heater, t);	// setpoints are omitted from differential status responses
 	}
 }
 
@@ -300,6 +361,28 @@ float Heat::GetStandbyTemperature(int8_t heater) const
 	return (heater >= 0 && heater < (int)Heaters) ? pids[heater]->GetStandbyTemperature() : ABS_ZERO;
 }
 
+// Return an estimate of the time in seconds for a heater to reach the given temperature from its current
+// temperature, based on its first-order-plus-dead-time process model driven at its maximum PWM
+float Heat::GetHeatingTime(int8_t heater, float targetTemperature) const
+{
+	if (heater < 0 || heater >= (int)Heaters)
+	{
+		return 0.0;
+	}
+	const float currentTemperature = GetTemperature(heater);
+	if (targetTemperature <= currentTemperature + TEMPERATURE_CLOSE_ENOUGH)
+	{
+		return 0.0;
+	}
+	const FopDt& model = GetHeaterModel(heater);
+	const float maxTemperature = NormalAmbientTemperature + (model.GetGain() * model.GetMaxPwm());
+	if (targetTemperature >= maxTemperature - TEMPERATURE_CLOSE_ENOUGH)
+	{
+		return model.GetDeadTime() + (4.0 * model.GetTimeConstant());	// the model says the target is barely reachable, so return the time to get close
+	}
+	return model.GetDeadTime() + (model.GetTimeConstant() * logf((maxTemperature - currentTemperature)/(maxTemperature - targetTemperature)));
+}
+
 float Heat::GetHighestTemperatureLimit(int8_t heater) const
 {
 	float limit = BAD_ERROR_TEMPERATURE;
@@ -405,6 +488,11 @@ float Heat::GetAveragePWM(size_t heater) const
 	return pids[heater]->GetAveragePWM();
 }
 
+float Heat::GetResidualDrift(size_t heater) const
+{
+	return pids[heater]->GetResidualDrift();
+}
+
 uint32_t Heat::GetLastSampleTime(size_t heater) const
 {
 	return pids[heater]->GetLastSampleTime();
@@ -415,18 +503,21 @@ bool Heat::IsBedOrChamberHeater(int8_t heater) const
 	return IsBedHeater(heater) || IsChamberHeater(heater);
 }
 
-// Auto tune a PID
+// Auto tune a PID. The tuning state is per-heater, so several heaters can be tuned at the same time
+// provided that they are thermally independent of each other.
 void Heat::StartAutoTune(size_t heater, float temperature, float maxPwm, StringRef& reply)
 {
-	if (heaterBeingTuned == -1)
+	if ((heatersBeingTuned & (1u << heater)) != 0)
 	{
-		heaterBeingTuned = (int8_t)heater;
-		pids[heater]->StartAutoTune(temperature, maxPwm, reply);
+		reply.printf("Error: heater %u is already being tuned", heater);
 	}
 	else
 	{
-		// Trying to start a new auto tune, but we are already tuning a heater
-		reply.printf("Error: cannot start auto tuning heater %u because heater %d is being tuned", heater, heaterBeingTuned);
+		pids[heater]->StartAutoTune(temperature, maxPwm, reply);
+		if (pids[heater]->IsTuning())
+		{
+			heatersBeingTuned |= (1u << heater);
+		}
 	}
 }
 
@@ -437,10 +528,25 @@ bool Heat::IsTuning(size_t heater) const
 
 void Heat::GetAutoTuneStatus(StringRef& reply) const
 {
-	int8_t whichPid = (heaterBeingTuned == -1) ? lastHeaterTuned : heaterBeingTuned;
-	if (whichPid != -1)
+	reply.Clear();
+	if (heatersBeingTuned != 0)
+	{
+		// Report all the heaters currently being tuned
+		for (size_t heater = 0; heater < Heaters; heater++)
+		{
+			if ((heatersBeingTuned & (1u << heater)) != 0)
+			{
+				if (reply.strlen() != 0)
+				{
+					reply.cat(", ");
+				}
+				pids[heater]->GetAutoTuneStatus(reply);
+			}
+		}
+	}
+	else if (lastHeaterTuned != -1)
 	{
-		pids[whichPid]->GetAutoTuneStatus(reply);
+		pids[lastHeaterTuned]->GetAutoTuneStatus(reply);
 	}
 	else
 	{
@@ -472,6 +578,11 @@ void Heat::SetM301PidParameters(size_t heater, const M301PidParameters& params)
 	pids[heater]->SetM301PidParameters(params);
 }
 
+void Heat::SetHeaterFeedForward(size_t heater, bool ff)
+{
+	pids[heater]->SetFeedForwardMode(ff);
+}
+
 // Write heater model parameters to file returning true if no error
 bool Heat::WriteModelParameters(FileStore *f) const
 {
@@ -43,6 +43,10 @@ public:
 	void Spin();												// Called in a tight loop to keep everything going
 	void Init();												// Set everything up
 	void Exit();												// Shut everything down
+
+	void ResetSampleIntervals();								// Reset all heaters to the global sample interval, with staggered phases
+	void SetSampleInterval(int8_t heater, uint32_t interval);	// Set the sample interval for one heater, in milliseconds
+	uint32_t GetSampleInterval(int8_t heater) const;			// Get the sample interval for one heater, in milliseconds
 	void ResetHeaterModels();									// Reset all active heater models to defaults
 
 	bool ColdExtrude() const;									// Is cold extrusion allowed?
@@ -64,6 +68,7 @@ public:
 	float GetActiveTemperature(int8_t heater) const;
 	void SetStandbyTemperature(int8_t heater, float t);
 	float GetStandbyTemperature(int8_t heater) const;
+	float GetHeatingTime(int8_t heater, float targetTemperature) const;	// Predict how long a heater will take to reach the given temperature
 	float GetHighestTemperatureLimit(int8_t heater) const;
 	float GetLowestTemperatureLimit(int8_t heater) const;
 	void Activate(int8_t heater);								// Turn on a heater
@@ -81,6 +86,9 @@ public:
 	float GetAveragePWM(size_t heater) const					// Return the running average PWM to the heater as a fraction in [0, 1].
 	pre(heater < Heaters);
 
+	float GetResidualDrift(size_t heater) const					// Return the degC-equivalent drift of the heater's steady-state residual from its baseline
+	pre(heater < Heaters);
+
 	bool IsBedOrChamberHeater(int8_t heater) const;						// Queried by the Platform class
 
 	uint32_t GetLastSampleTime(size_t heater) const
@@ -120,6 +128,9 @@ public:
 	void SetM301PidParameters(size_t heater, const M301PidParameters& params)
 	pre(heater < Heaters);
 
+	void SetHeaterFeedForward(size_t heater, bool ff)			// Select feed-forward control with PID trimming the residual
+	pre(heater < Heaters);
+
 	bool WriteModelParameters(FileStore *f) const;				// Write heater model parameters to file returning true if no error
 
 	int GetHeaterChannel(size_t heater) const;					// Return the channel used by a particular heater, or -1 if not configured
@@ -170,7 +181,7 @@ private:
 	bool coldExtrude;											// Is cold extrusion allowed?
 	int8_t bedHeaters[NumBedHeaters];							// Indices of the hot bed heaters to use or -1 if none is available
 	int8_t chamberHeaters[NumChamberHeaters];					// Indices of the chamber heaters to use or -1 if none is available
-	int8_t heaterBeingTuned;									// which PID is currently being tuned
+	uint16_t heatersBeingTuned;									// bitmap of the PIDs currently being tuned; thermally-independent heaters can be tuned concurrently
 	int8_t lastHeaterTuned;										// which PID we last finished tuning
 };
 
@@ -11,35 +11,19 @@
 #include "HeaterProtection.h"
 #include "Platform.h"
 #include "RepRap.h"
+#include "DebugRouting.h"
 
 // Private constants
 const uint32_t InitialTuningReadingInterval = 250;	// the initial reading interval in milliseconds
 const uint32_t TempSettleTimeout = 20000;	// how long we allow the initial temperature to settle
 
-// Static class variables
-
-float *PID::tuningTempReadings = nullptr;	// the readings from the heater being tuned
-float PID::tuningStartTemp;					// the temperature when we turned on the heater
-float PID::tuningPwm;						// the PWM to use
-float PID::tuningTargetTemp;				// the maximum temperature we are allowed to reach
-uint32_t PID::tuningBeginTime;				// when we started the tuning process
-uint32_t PID::tuningPhaseStartTime;			// when we started the current tuning phase
-uint32_t PID::tuningReadingInterval;		// how often we are sampling
-size_t PID::tuningReadingsTaken;			// how many samples we have taken
-
-float PID::tuningHeaterOffTemp;				// the temperature when we turned the heater off
-float PID::tuningPeakTemperature;			// the peak temperature reached, averaged over 3 readings (so slightly less than the true peak)
-uint32_t PID::tuningHeatingTime;			// how long we had the heating on for
-uint32_t PID::tuningPeakDelay;				// how many milliseconds the temperature continues to rise after turning the heater off
-
-#if HAS_VOLTAGE_MONITOR
-unsigned int voltageSamplesTaken;			// how many readings we accumulated
-float tuningVoltageAccumulator;				// sum of the voltage readings we take during the heating phase
-#endif
+const float DriftFilterRate = 0.005;		// per-sample weight of the residual drift filter (time constant about 100 seconds at the default sample interval)
+const float DriftWarningThreshold = 8.0;	// warn when the filtered residual drifts this many degrees C equivalent from its baseline
 
 // Member functions and constructors
 
-PID::PID(Platform& p, int8_t h) : platform(p), heaterProtection(nullptr), heater(h), mode(HeaterMode::off), invertPwmSignal(false)
+PID::PID(Platform& p, int8_t h)
+	: platform(p), heaterProtection(nullptr), heater(h), mode(HeaterMode::off), invertPwmSignal(false), tuningTempReadings(nullptr)
 {
 }
 
@@ -63,6 +47,29 @@ void PID::Init(float pGain, float pTc, float pTd, bool usePid, bool inverted)
 	// Time the sensor was last sampled.  During startup, we use the current
 	// time as the initial value so as to not trigger an immediate warning from the Tick ISR.
 	lastSampleTime = millis();
+
+	sampleInterval = platform.HeatSampleInterval();
+	nextSampleTime = millis();
+}
+
+// Set how often this heater's sensor is read and its control loop run. The phase offset staggers the
+// heaters relative to each other so that their SPI sensor reads are interleaved across Spin passes
+// instead of all landing on the same one.
+void PID::SetSampleInterval(uint32_t interval, uint32_t phase)
+{
+	sampleInterval = interval;
+	nextSampleTime = millis() + phase;
+}
+
+// Called by Heat::Spin on every pass. If this heater is due to be sampled, schedule the next sample and return true.
+bool PID::SampleDue(uint32_t now)
+{
+	if ((int32_t)(now - nextSampleTime) >= 0)
+	{
+		nextSampleTime = now + sampleInterval;
+		return true;
+	}
+	return false;
 }
 
 void PID::Reset()
@@ -78,6 +85,9 @@ void PID::Reset()
 	tuned = false;
 	averagePWM = lastPwm = 0.0;
 	heatingFaultCount = 0;
+	driftResidualFilter = driftBaseline = 0.0;
+	driftSampleCount = 0;
+	driftWarningIssued = false;
 	temperature = BAD_ERROR_TEMPERATURE;
 #if HAS_VOLTAGE_MONITOR
 	suspended = false;
@@ -144,10 +154,7 @@ void PID::SwitchOn()
 	{
 		if (mode == HeaterMode::fault)
 		{
-			if (reprap.Debug(Module::moduleHeat))
-			{
-				platform.MessageF(WarningMessage, "Heater %d not switched on due to temperature fault\n", heater);
-			}
+			DEBUG_OUTPUT(moduleHeat, DebugLevel::warning, "Heater %d not switched on due to temperature fault\n", heater);
 		}
 		else if (model.IsEnabled())
 		{
@@ -164,9 +171,9 @@ void PID::SwitchOn()
 				{
 					timeSetHeating = millis();
 				}
-				if (reprap.Debug(Module::moduleHeat) && oldMode == HeaterMode::off)
+				if (oldMode == HeaterMode::off)
 				{
-					platform.MessageF(GenericMessage, "Heater %d switched on\n", heater);
+					DEBUG_OUTPUT(moduleHeat, DebugLevel::info, "Heater %d switched on\n", heater);
 				}
 			}
 		}
@@ -188,10 +195,7 @@ void PID::SwitchOff()
 		if (mode > HeaterMode::off)
 		{
 			mode = HeaterMode::off;
-			if (reprap.Debug(Module::moduleHeat))
-			{
-				platform.MessageF(GenericMessage, "Heater %d switched off\n", heater);
-			}
+			DEBUG_OUTPUT(moduleHeat, DebugLevel::info, "Heater %d switched off\n", heater);
 		}
 	}
 }
@@ -245,7 +249,7 @@ void PID::Spin()
 			if ((previousTemperaturesGood & (1 << (NumPreviousTemperatures - 1))) != 0)
 			{
 				const float tentativeDerivative = SecondsToMillis * (temperature - previousTemperatures[previousTemperatureIndex])
-								/ (float)(platform.HeatSampleInterval() * NumPreviousTemperatures);
+								/ (float)(sampleInterval * NumPreviousTemperatures);
 				// Some sensors give occasional temperature spikes. We don't expect the temperature to increase by more than 10C/second.
 				if (fabsf(tentativeDerivative) <= 10.0)
 				{
@@ -277,7 +281,7 @@ void PID::Spin()
 							&& (float)(millis() - timeSetHeating) > model.GetDeadTime() * SecondsToMillis * 2)
 						{
 							++heatingFaultCount;
-							if (heatingFaultCount * platform.HeatSampleInterval() > maxHeatingFaultTime * SecondsToMillis)
+							if (heatingFaultCount * sampleInterval > maxHeatingFaultTime * SecondsToMillis)
 							{
 								SetHeater(0.0);					// do this here just to be sure
 								mode = HeaterMode::fault;
@@ -304,7 +308,7 @@ void PID::Spin()
 				if (fabsf(error) > maxTempExcursion && temperature > MaxAmbientTemperature)
 				{
 					++heatingFaultCount;
-					if (heatingFaultCount * platform.HeatSampleInterval() > maxHeatingFaultTime * SecondsToMillis)
+					if (heatingFaultCount * sampleInterval > maxHeatingFaultTime * SecondsToMillis)
 					{
 						SetHeater(0.0);					// do this here just to be sure
 						mode = HeaterMode::fault;
@@ -317,6 +321,35 @@ void PID::Spin()
 				{
 					--heatingFaultCount;
 				}
+
+				// Accumulate residual statistics so that we can warn about slow drift - a degrading heater cartridge or a
+				// loosening temperature sensor - before it becomes a mid-print heating fault. The model predicts the
+				// steady-state temperature for the average power we are delivering; the residual from that prediction is
+				// sensitive to model error and fan state, so we compare it against a baseline taken when the heater
+				// settled rather than against zero.
+				{
+					const float residual = temperature - (NormalAmbientTemperature + (model.GetGain() * GetAveragePWM()));
+					if (driftSampleCount == 0)
+					{
+						driftResidualFilter = residual;
+					}
+					else
+					{
+						driftResidualFilter += DriftFilterRate * (residual - driftResidualFilter);
+					}
+					if (driftSampleCount < DriftBaselineSamples)
+					{
+						++driftSampleCount;
+						driftBaseline = driftResidualFilter;		// keep tracking the baseline until the filter has settled
+					}
+					else if (!driftWarningIssued && fabsf(driftResidualFilter - driftBaseline) > DriftWarningThreshold)
+					{
+						driftWarningIssued = true;
+						platform.MessageF(WarningMessage,
+								"Heater %d steady-state power has drifted by %.1f" DEGREE_SYMBOL "C equivalent since it stabilised; check the heater and temperature sensor\n",
+								heater, (double)(driftResidualFilter - driftBaseline));
+					}
+				}
 				break;
 
 			case HeaterMode::cooling:
@@ -337,6 +370,13 @@ void PID::Spin()
 				break;
 			}
 
+			// Restart drift monitoring whenever we are not holding a stable temperature
+			if (mode != HeaterMode::stable && driftSampleCount != 0)
+			{
+				driftSampleCount = 0;
+				driftWarningIssued = false;
+			}
+
 			// Calculate the PWM
 			if (mode <= HeaterMode::off)
 			{
@@ -351,37 +391,67 @@ void PID::Spin()
 					const bool inLoadMode = (mode == HeaterMode::stable) || fabsf(error) < 3.0;		// use standard PID when maintaining temperature
 					const PidParameters& params = model.GetPidParameters(inLoadMode);
 
-					// If the P and D terms together demand that the heater is full on or full off, disregard the I term
-					const float errorMinusDterm = error - (params.tD * derivative);
-					const float pPlusD = params.kP * errorMinusDterm;
-					const float expectedPwm = constrain<float>((temperature - NormalAmbientTemperature)/model.GetGain(), 0.0, model.GetMaxPwm());
-					if (pPlusD + expectedPwm > model.GetMaxPwm())
+					if (model.UsesFeedForward())
 					{
-						lastPwm = model.GetMaxPwm();
-						// If we are heating up, preset the I term to the expected PWM at this temperature, ready for the switch over to PID
-						if (mode == HeaterMode::heating && error > 0.0 && derivative > 0.0)
+						// Feed-forward mode: the model supplies the steady-state power for the target temperature and the
+						// PID terms only trim the residual error. After a setpoint change the output steps to the power
+						// for the new operating point immediately, instead of waiting for the integrator to wind there,
+						// so the heater settles about as fast as the dead time allows.
+						const float ffPwm = constrain<float>((targetTemperature - NormalAmbientTemperature)/model.GetGain(), 0.0, model.GetMaxPwm());
+						const float pPlusD = params.kP * (error - (params.tD * derivative));
+						if (pPlusD + ffPwm >= model.GetMaxPwm())
 						{
-							iAccumulator = expectedPwm;
+							lastPwm = model.GetMaxPwm();		// far below target, so heat at full power
+							iAccumulator = 0.0;
+						}
+						else if (pPlusD + ffPwm <= 0.0)
+						{
+							lastPwm = 0.0;						// far above target, so leave the heater off while it cools
+							iAccumulator = 0.0;
+						}
+						else
+						{
+							// The I term only accounts for the residual error, e.g. from gain mismatch or supply voltage variation
+							iAccumulator = constrain<float>
+											(iAccumulator + (error * params.kP * params.recipTi * sampleInterval * MillisToSeconds),
+												-ffPwm, model.GetMaxPwm() - ffPwm);
+							lastPwm = constrain<float>(ffPwm + pPlusD + iAccumulator, 0.0, model.GetMaxPwm());
 						}
-					}
-					else if (pPlusD + expectedPwm < 0.0)
-					{
-						lastPwm = 0.0;
 					}
 					else
 					{
+						// If the P and D terms together demand that the heater is full on or full off, disregard the I term
+						const float errorMinusDterm = error - (params.tD * derivative);
+						const float pPlusD = params.kP * errorMinusDterm;
+						const float expectedPwm = constrain<float>((temperature - NormalAmbientTemperature)/model.GetGain(), 0.0, model.GetMaxPwm());
+						if (pPlusD + expectedPwm > model.GetMaxPwm())
+						{
+							lastPwm = model.GetMaxPwm();
+							// If we are heating up, preset the I term to the expected PWM at this temperature, ready for the switch over to PID
+							if (mode == HeaterMode::heating && error > 0.0 && derivative > 0.0)
+							{
+								iAccumulator = expectedPwm;
+							}
+						}
+						else if (pPlusD + expectedPwm < 0.0)
+						{
+							lastPwm = 0.0;
+						}
+						else
+						{
 #if 1	// try normal PWM instead, because it looks like the modified PWM may be causing undershoot on initial heating
-						const float errorToUse = error;
+							const float errorToUse = error;
 #else
-						// In the following we use a modified PID when the temperature is a long way off target.
-						// During initial heating or cooling, the D term represents expected overshoot, which we don't want to add to the I accumulator.
-						// When we are in load mode, the I term is much larger and the D term doesn't represent overshoot, so use normal PID.
-						const float errorToUse = (inLoadMode || model.ArePidParametersOverridden()) ? error : errorMinusDterm;
+							// In the following we use a modified PID when the temperature is a long way off target.
+							// During initial heating or cooling, the D term represents expected overshoot, which we don't want to add to the I accumulator.
+							// When we are in load mode, the I term is much larger and the D term doesn't represent overshoot, so use normal PID.
+							const float errorToUse = (inLoadMode || model.ArePidParametersOverridden()) ? error : errorMinusDterm;
 #endif
-						iAccumulator = constrain<float>
-										(iAccumulator + (errorToUse * params.kP * params.recipTi * platform.HeatSampleInterval() * MillisToSeconds),
-											0.0, model.GetMaxPwm());
-						lastPwm = constrain<float>(pPlusD + iAccumulator, 0.0, model.GetMaxPwm());
+							iAccumulator = constrain<float>
+											(iAccumulator + (errorToUse * params.kP * params.recipTi * sampleInterval * MillisToSeconds),
+												0.0, model.GetMaxPwm());
+							lastPwm = constrain<float>(pPlusD + iAccumulator, 0.0, model.GetMaxPwm());
+						}
 					}
 #if HAS_VOLTAGE_MONITOR
 					// Scale the PID based on the current voltage vs. the calibration voltage
@@ -443,7 +513,7 @@ void PID::Spin()
 
 		// Set the heater power and update the average PWM
 		SetHeater(lastPwm);
-		averagePWM = averagePWM * (1.0 - platform.HeatSampleInterval()/(HEAT_PWM_AVERAGE_TIME * SecondsToMillis)) + lastPwm;
+		averagePWM = averagePWM * (1.0 - sampleInterval/(HEAT_PWM_AVERAGE_TIME * SecondsToMillis)) + lastPwm;
 		previousTemperatureIndex = (previousTemperatureIndex + 1) % NumPreviousTemperatures;
 
 		// For temperature sensors which do not require frequent sampling and averaging,
@@ -547,7 +617,7 @@ void PID::ResetFault()
 
 float PID::GetAveragePWM() const
 {
-	return averagePWM * platform.HeatSampleInterval()/(HEAT_PWM_AVERAGE_TIME * SecondsToMillis);
+	return averagePWM * sampleInterval/(HEAT_PWM_AVERAGE_TIME * SecondsToMillis);
 }
 
 // Get a conservative estimate of the expected heating rate at the current temperature and average PWM. The result may be negative.
@@ -590,7 +660,7 @@ void PID::StartAutoTune(float targetTemp, float maxPwm, StringRef& reply)
 			// would be wasteful to allocate a permanent array just in case we are going to run it, so we make an exception here.
 			tuningTempReadings = new float[MaxTuningTempReadings];
 			tuningTempReadings[0] = temperature;
-			tuningReadingInterval = platform.HeatSampleInterval();
+			tuningReadingInterval = sampleInterval;
 			tuningPwm = maxPwm;
 			tuningTargetTemp = targetTemp;
 			reply.printf("Auto tuning heater %d using target temperature %.1f" DEGREE_SYMBOL "C and PWM %.2f - do not leave printer unattended", heater, (double)targetTemp, (double)maxPwm);
@@ -600,26 +670,27 @@ void PID::StartAutoTune(float targetTemp, float maxPwm, StringRef& reply)
 
 void PID::GetAutoTuneStatus(StringRef& reply)	// Get the auto tune status or last result
 {
+	// Append to the reply rather than overwriting it, because the status of several heaters may be reported in one reply
 	if (mode >= HeaterMode::tuning0)
 	{
-		reply.printf("Heater %d is being tuned, phase %u of %u",
+		reply.catf("Heater %d is being tuned, phase %u of %u",
 						heater,
 						(unsigned int)mode - (unsigned int)HeaterMode::tuning0 + 1,
 						(unsigned int)HeaterMode::lastTuningMode - (unsigned int)HeaterMode::tuning0 + 1);
 	}
 	else if (tuned)
 	{
-		reply.printf("Heater %d tuning succeeded, use M307 H%d to see result", heater, heater);
+		reply.catf("Heater %d tuning succeeded, use M307 H%d to see result", heater, heater);
 	}
 	else
 	{
-		reply.printf("Heater %d tuning failed", heater);
+		reply.catf("Heater %d tuning failed", heater);
 	}
 }
 
 /* Notes on the auto tune algorithm
  *
- * Most 3D printer firmwares use the �str�m-H�gglund relay tuning method (sometimes called Ziegler-Nichols + relay).
+ * Most 3D printer firmwares use the �str�m-H�gglund relay tuning method (sometimes called Ziegler-Nichols + relay).
  * This gives results  of variable quality, but they seem to be generally satisfactory.
  *
  * We use Cohen-Coon tuning instead. This models the heating process as a first-order process (i.e. one that with constant heating
@@ -699,7 +770,7 @@ void PID::DoTuningStep()
 	{
 	case HeaterMode::tuning0:
 		// Waiting for initial temperature to settle after any thermostatic fans have turned on
-		if (ReadingsStable(6000/platform.HeatSampleInterval(), 2.0))	// expect temperature to be stable within a 2C band for 6 seconds
+		if (ReadingsStable(6000/sampleInterval, 2.0))	// expect temperature to be stable within a 2C band for 6 seconds
 		{
 			// Starting temperature is stable, so move on
 			tuningReadingsTaken = 1;
@@ -710,7 +781,7 @@ void PID::DoTuningStep()
 			tuningTempReadings[0] = tuningStartTemp = temperature;
 			timeSetHeating = tuningPhaseStartTime = millis();
 			lastPwm = tuningPwm;										// turn on heater at specified power
-			tuningReadingInterval = platform.HeatSampleInterval();		// reset sampling interval
+			tuningReadingInterval = sampleInterval;		// reset sampling interval
 			mode = HeaterMode::tuning1;
 			platform.Message(GenericMessage, "Auto tune phase 1, heater on\n");
 			return;
@@ -754,7 +825,7 @@ void PID::DoTuningStep()
 				tuningReadingsTaken = 1;
 				tuningHeaterOffTemp = tuningTempReadings[0] = temperature;
 				tuningPhaseStartTime = millis();
-				tuningReadingInterval = platform.HeatSampleInterval();		// reset sampling interval
+				tuningReadingInterval = sampleInterval;		// reset sampling interval
 				mode = HeaterMode::tuning2;
 				lastPwm = 0.0;
 				SetHeater(0.0);
@@ -792,7 +863,7 @@ void PID::DoTuningStep()
 				tuningReadingsTaken = 1;
 				tuningTempReadings[0] = temperature;
 				tuningPhaseStartTime = millis();
-				tuningReadingInterval = platform.HeatSampleInterval();		// reset sampling interval
+				tuningReadingInterval = sampleInterval;		// reset sampling interval
 				mode = HeaterMode::tuning3;
 				platform.MessageF(GenericMessage, "Auto tune phase 3, peak temperature was %.1f\n", (double)tuningPeakTemperature);
 				return;
@@ -824,7 +895,7 @@ void PID::DoTuningStep()
 }
 
 // Return true if the last 'numReadings' readings are stable
-/*static*/ bool PID::ReadingsStable(size_t numReadings, float maxDiff)
+bool PID::ReadingsStable(size_t numReadings, float maxDiff) const
 {
 	if (tuningTempReadings == nullptr || tuningReadingsTaken < numReadings)
 	{
@@ -846,7 +917,7 @@ void PID::DoTuningStep()
 // Calculate which reading gave us the peak temperature.
 // Return -1 if peak not identified yet, 0 if we are never going to find a peak, else the index of the peak
 // If the readings show a continuous decrease then we return 1, because zero dead time would lead to infinities
-/*static*/ int PID::GetPeakTempIndex()
+int PID::GetPeakTempIndex() const
 {
 	// Check we have enough readings to look for the peak
 	if (tuningReadingsTaken < 15)
@@ -880,7 +951,7 @@ void PID::DoTuningStep()
 // See if there is exactly one peak in the readings.
 // Return -1 if more than one peak, else the index of the peak. The so-called peak may be right at the end, in which case it isn't really a peak.
 // With a well-insulated bed heater the temperature may not start dropping appreciably within the 120 second time limit allowed.
-/*static*/ int PID::IdentifyPeak(size_t numToAverage)
+int PID::IdentifyPeak(size_t numToAverage) const
 {
 	int firstPeakIndex = -1, lastSameIndex = -1;
 	float peakTempTimesN = -999.0;
@@ -37,6 +37,7 @@ class PID
 	};
 
 	static const size_t NumPreviousTemperatures = 4; // How many samples we average the temperature derivative over
+	static const uint16_t DriftBaselineSamples = 600; // How many stable samples we let the residual filter settle for before freezing the baseline (5 minutes)
 
 public:
 
@@ -44,6 +45,10 @@ public:
 	void Init(float pGain, float pTc, float pTd, bool usePid, bool inverted);	// (Re)Set everything to start
 	void Reset();
 	void Spin();									// Called in a tight loop to keep things running
+	bool SampleDue(uint32_t now);					// If this heater is due to be sampled, schedule the next sample and return true
+	void SetSampleInterval(uint32_t interval, uint32_t phase);	// Set how often this heater is sampled, in milliseconds
+	uint32_t GetSampleInterval() const				// Get how often this heater is sampled, in milliseconds
+		{ return sampleInterval; }
 	void SetActiveTemperature(float t);
 	float GetActiveTemperature() const;
 	void SetStandbyTemperature(float t);
@@ -61,6 +66,7 @@ public:
 	void ResetFault();								// Reset a fault condition - only call this if you know what you are doing
 	float GetTemperature() const;					// Get the current temperature
 	float GetAveragePWM() const;					// Return the running average PWM to the heater. Answer is a fraction in [0, 1].
+	float GetResidualDrift() const;					// Return the degC-equivalent drift of the steady-state model residual from its baseline
 	uint32_t GetLastSampleTime() const;				// Return when the temp sensor was last sampled
 	float GetAccumulator() const;					// Return the integral accumulator
 	void StartAutoTune(float targetTemp, float maxPwm, StringRef& reply);	// Start an auto tune cycle for this PID
@@ -89,6 +95,9 @@ public:
 	void SetM301PidParameters(const M301PidParameters& params)
 		{ model.SetM301PidParameters(params); }
 
+	void SetFeedForwardMode(bool ff)				// Select feed-forward control with PID trimming the residual
+		{ model.SetFeedForwardMode(ff); }
+
 #if HAS_VOLTAGE_MONITOR
 	void Suspend(bool sus);							// Suspend the heater to conserve power
 #endif
@@ -99,10 +108,10 @@ private:
 	void SetHeater(float power) const;				// Power is a fraction in [0,1]
 	TemperatureError ReadTemperature();				// Read and store the temperature of this heater
 	void DoTuningStep();							// Called on each temperature sample when auto tuning
-	static bool ReadingsStable(size_t numReadings, float maxDiff)
+	bool ReadingsStable(size_t numReadings, float maxDiff) const
 		pre(numReadings >= 2; numReadings <= MaxTuningTempReadings);
-	static int GetPeakTempIndex();					// Auto tune helper function
-	static int IdentifyPeak(size_t numToAverage);	// Auto tune helper function
+	int GetPeakTempIndex() const;					// Auto tune helper function
+	int IdentifyPeak(size_t numToAverage) const;	// Auto tune helper function
 	void CalculateModel();							// Calculate G, td and tc from the accumulated readings
 	void DisplayBuffer(const char *intro);			// Debug helper
 	float GetExpectedHeatingRate() const;			// Get the minimum heating rate we expect
@@ -122,9 +131,18 @@ private:
 	float averagePWM;								// The running average of the PWM, after scaling.
 	uint32_t timeSetHeating;						// When we turned on the heater
 	uint32_t lastSampleTime;						// Time when the temperature was last sampled by Spin()
+	uint32_t sampleInterval;						// How often this heater is sampled, in milliseconds
+	uint32_t nextSampleTime;						// When the next sample is due
 
 	uint16_t heatingFaultCount;						// Count of questionable heating behaviours
 
+	// Model residual drift monitoring. A degrading heater cartridge or a loosening temperature sensor shows up as a slow
+	// change in the steady-state power needed to hold the setpoint, long before it trips the hard fault detection.
+	float driftResidualFilter;						// slow filter of (actual temperature - model steady-state prediction)
+	float driftBaseline;							// the filtered residual captured after the heater last became stable
+	uint16_t driftSampleCount;						// how many stable samples have fed the filter since the heater became stable
+	bool driftWarningIssued;						// true if we have already warned about drift since the heater became stable
+
 	int8_t heater;									// The index of our heater
 	uint8_t previousTemperaturesGood;				// Bitmap indicating which previous temperature were good readings
 	HeaterMode mode;								// Current state of the heater
@@ -138,21 +156,25 @@ private:
 
 	static_assert(sizeof(previousTemperaturesGood) * 8 >= NumPreviousTemperatures, "too few bits in previousTemperaturesGood");
 
-	// Variables used during heater tuning
+	// Variables used during heater tuning. These are per-instance so that several thermally-independent heaters can be tuned concurrently.
 	static const size_t MaxTuningTempReadings = 128; // The maximum number of readings we keep. Must be an even number.
 
-	static float *tuningTempReadings;				// the readings from the heater being tuned
-	static float tuningStartTemp;					// the temperature when we turned on the heater
-	static float tuningPwm;							// the PWM to use, 0..1
-	static float tuningTargetTemp;						// the maximum temperature we are allowed to reach
-	static uint32_t tuningBeginTime;				// when we started the tuning process
-	static uint32_t tuningPhaseStartTime;			// when we started the current tuning phase
-	static uint32_t tuningReadingInterval;			// how often we are sampling, in milliseconds
-	static size_t tuningReadingsTaken;				// how many temperature samples we have taken
-	static float tuningHeaterOffTemp;				// the temperature when we turned the heater off
-	static float tuningPeakTemperature;				// the peak temperature reached, averaged over 3 readings (so slightly less than the true peak)
-	static uint32_t tuningHeatingTime;				// how long we had the heating on for
-	static uint32_t tuningPeakDelay;				// how many milliseconds the temperature continues to rise after turning the heater off
+	float *tuningTempReadings;						// the readings from this heater while it is being tuned, or nullptr
+	float tuningStartTemp;							// the temperature when we turned on the heater
+	float tuningPwm;								// the PWM to use, 0..1
+	float tuningTargetTemp;							// the maximum temperature we are allowed to reach
+	uint32_t tuningBeginTime;						// when we started the tuning process
+	uint32_t tuningPhaseStartTime;					// when we started the current tuning phase
+	uint32_t tuningReadingInterval;					// how often we are sampling, in milliseconds
+	size_t tuningReadingsTaken;						// how many temperature samples we have taken
+	float tuningHeaterOffTemp;						// the temperature when we turned the heater off
+	float tuningPeakTemperature;					// the peak temperature reached, averaged over 3 readings (so slightly less than the true peak)
+	uint32_t tuningHeatingTime;						// how long we had the heating on for
+	uint32_t tuningPeakDelay;						// how many milliseconds the temperature continues to rise after turning the heater off
+#if HAS_VOLTAGE_MONITOR
+	float tuningVoltageAccumulator;					// sum of the voltage readings we take during the heating phase
+	unsigned int voltageSamplesTaken;				// how many readings we accumulated
+#endif
 };
 
 
@@ -201,4 +223,9 @@ inline bool PID::IsTuning() const
 	return mode >= HeaterMode::tuning0;
 }
 
+inline float PID::GetResidualDrift() const
+{
+	return (mode == HeaterMode::stable && driftSampleCount >= DriftBaselineSamples) ? driftResidualFilter - driftBaseline : 0.0;
+}
+
 #endif /* SRC_PID_H_ */
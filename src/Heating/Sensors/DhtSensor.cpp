@@ -122,7 +122,7 @@ TemperatureError DhtSensor::GetTemperature(float& t)
 // Pulse ISR
 uint32_t lastPulseTime;
 volatile uint8_t numPulses;
-uint32_t pulses[41];			// 1 start bit + 40 data bits
+uint32_t pulses[42];			// 1 bus release pulse + 1 start bit + 40 data bits
 
 void DhtDataTransition(CallbackParameter)
 {
@@ -152,9 +152,9 @@ void DhtDataTransition(CallbackParameter)
 	switch (state)
 	{
 	case Initialising:
-		// Send start signal. See DHT datasheet for full signal diagram:
+		// Let the bus idle high before sending the start signal. See DHT datasheet for full signal diagram:
 		// http://www.adafruit.com/datasheets/Digital%20humidity%20and%20temperature%20sensor%20AM2302.pdf
-		digitalWrite(DhtDataPin, HIGH);
+		pinMode(DhtDataPin, INPUT_PULLUP);
 
 		state = Starting;
 		lastOperationTime = millis();
@@ -176,19 +176,13 @@ void DhtDataTransition(CallbackParameter)
 		// Wait 20ms
 		if (millis() - lastOperationTime >= 20)
 		{
-			// End the start signal by setting data line high for 40 microseconds
-			digitalWrite(DhtDataPin, HIGH);
-			delayMicroseconds(40);
-
-			// Now start reading the data line to get the value from the DHT sensor
-			pinMode(DhtDataPin, INPUT_PULLUP);
-			delayMicroseconds(10);
-
-			// Read from the DHT sensor using an ISR, because we cannot use delays
-			// due to the fact that this messes with the stepping ISR
+			// End the start signal by releasing the data line and letting the pull-up raise it. The sensor
+			// replies on its own 20-40 microseconds later, so there is nothing to busy-wait for; the release
+			// and the sensor's response are captured by the pin change interrupt as the first pulse.
 			numPulses = 0;
 			lastPulseTime = 0;
 			attachInterrupt(DhtDataPin, DhtDataTransition, CHANGE, nullptr);
+			pinMode(DhtDataPin, INPUT_PULLUP);
 
 			// Wait for the next operation to complete
 			lastOperationTime = millis();
@@ -207,8 +201,8 @@ void DhtDataTransition(CallbackParameter)
 			break;
 		}
 
-		// Wait for the reading to complete (1 start bit + 40 data bits)
-		if (numPulses != 41)
+		// Wait for the reading to complete (1 bus release pulse + 1 start bit + 40 data bits)
+		if (numPulses != ARRAY_SIZE(pulses))
 		{
 			break;
 		}
@@ -217,8 +211,8 @@ void DhtDataTransition(CallbackParameter)
 		state = Initialising;
 		lastReadTime = millis();
 
-		// Check start bit
-		if (pulses[0] < 40)
+		// Check start bit, ignoring the first captured pulse which is just our release of the bus
+		if (pulses[1] < 40)
 		{
 			lastResult = TemperatureError::ioError;
 			break;
@@ -232,7 +226,7 @@ void DhtDataTransition(CallbackParameter)
 		for (size_t i = 0; i < 40; ++i)
 		{
 			data[i / 8] <<= 1;
-			if (pulses[i + 1] > 40)
+			if (pulses[i + 2] > 40)
 			{
 				data[i / 8] |= 1;
 			}
@@ -7,6 +7,31 @@
 
 #include "SpiTemperatureSensor.h"
 
+/*static*/ bool SpiTemperatureSensor::batchActive = false;
+/*static*/ const sspi_device *SpiTemperatureSensor::lastDeviceSetUp = nullptr;
+
+// Acquire the bus for a series of back-to-back transactions. If the bus is busy then we carry on without it,
+// and each transaction falls back to acquiring the bus individually as before.
+/*static*/ void SpiTemperatureSensor::BeginBatch()
+{
+	if (!batchActive)
+	{
+		batchActive = sspi_acquire();
+		lastDeviceSetUp = nullptr;
+	}
+}
+
+// Release the bus at the end of a series of transactions
+/*static*/ void SpiTemperatureSensor::EndBatch()
+{
+	if (batchActive)
+	{
+		sspi_release();
+		batchActive = false;
+		lastDeviceSetUp = nullptr;
+	}
+}
+
 SpiTemperatureSensor::SpiTemperatureSensor(unsigned int channel, const char *name, unsigned int relativeChannel, uint8_t spiMode, uint32_t clockFrequency)
 	: TemperatureSensor(channel, name)
 {
@@ -26,13 +51,19 @@ void SpiTemperatureSensor::InitSpi()
 // Send and receive 1 to 8 bytes of data and return the result as a single 32-bit word
 TemperatureError SpiTemperatureSensor::DoSpiTransaction(const uint8_t dataOut[], size_t nbytes, uint32_t& rslt) const
 {
-	if (!sspi_acquire())
+	const bool inBatch = batchActive;
+	if (!inBatch && !sspi_acquire())
 	{
 		return TemperatureError::busBusy;
 	}
 
-	sspi_master_setup_device(&device);
-	delayMicroseconds(1);
+	// Skip the device setup if the bus is already set up for our mode and frequency by the previous transaction in this batch
+	if (lastDeviceSetUp == nullptr || lastDeviceSetUp->spiMode != device.spiMode || lastDeviceSetUp->clockFrequency != device.clockFrequency)
+	{
+		sspi_master_setup_device(&device);
+		delayMicroseconds(1);
+	}
+	lastDeviceSetUp = (inBatch) ? &device : nullptr;
 	sspi_select_device(&device);
 	delayMicroseconds(1);
 
@@ -43,7 +74,10 @@ TemperatureError SpiTemperatureSensor::DoSpiTransaction(const uint8_t dataOut[],
 	sspi_deselect_device(&device);
 	delayMicroseconds(1);
 
-	sspi_release();
+	if (!inBatch)
+	{
+		sspi_release();
+	}
 
 	if (sts != SPI_OK)
 	{
@@ -13,6 +13,13 @@
 
 class SpiTemperatureSensor : public TemperatureSensor
 {
+public:
+	// Batching support. When several SPI sensors are polled in quick succession, acquiring the bus once
+	// and setting the device configuration up once lets the individual chip-select transactions run back
+	// to back instead of each one paying the full setup/teardown cost.
+	static void BeginBatch();							// acquire the bus for a series of transactions
+	static void EndBatch();								// release the bus again
+
 protected:
 	SpiTemperatureSensor(unsigned int channel, const char *name, unsigned int relativeChannel, uint8_t spiMode, uint32_t clockFrequency);
 	void InitSpi();
@@ -23,6 +30,10 @@ protected:
 	uint32_t lastReadingTime;
 	float lastTemperature;
 	TemperatureError lastResult;
+
+private:
+	static bool batchActive;							// true if we are holding the bus across transactions
+	static const sspi_device *lastDeviceSetUp;			// the device whose mode and frequency the bus is currently set up for, or nullptr
 };
 
 #endif /* SRC_HEATING_SPITEMPERATURESENSOR_H_ */
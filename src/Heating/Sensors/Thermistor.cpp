@@ -54,10 +54,10 @@ bool Thermistor::Configure(unsigned int mCode, unsigned int heater, GCodeBuffer&
 			}
 			gb.TryGetFValue('C', shC, seen);
 			gb.TryGetFValue('T', r25, seen);
-			if (seen)
-			{
-				CalcDerivedParameters();
-			}
+		}
+		if (seen)
+		{
+			CalcDerivedParameters();			// this also rebuilds the interpolation table, which depends on the series resistance too
 		}
 
 #if !HAS_VREF_MONITOR
@@ -149,10 +149,10 @@ TemperatureError Thermistor::GetTemperature(float& t)
 			return GetPT100Temperature(t, ohmsx100);
 		}
 
-		// Else it's a thermistor
-		const float logResistance = log(resistance);
-		const float recipT = shA + shB * logResistance + shC * logResistance * logResistance * logResistance;
-		const float temp =  (recipT > 0.0) ? (1.0/recipT) + ABS_ZERO : BAD_ERROR_TEMPERATURE;
+		// Else it's a thermistor. Look the temperature up in the interpolation table instead of evaluating
+		// the Steinhart-Hart equation, so that we don't compute a logarithm for every reading of every heater.
+		const float fraction = ((float)(averagedTempReading - averagedVssaReading) + 0.5)/(float)(averagedVrefReading - averagedVssaReading);
+		const float temp = InterpolateTemperature(fraction);
 
 		if (temp < MinimumConnectedTemperature)
 		{
@@ -170,12 +170,53 @@ TemperatureError Thermistor::GetTemperature(float& t)
 	return TemperatureError::busBusy;
 }
 
-// Calculate shA and shB from the other parameters
+// Calculate shA and shB from the other parameters, and rebuild the interpolation table
 void Thermistor::CalcDerivedParameters()
 {
 	shB = 1.0/beta;
 	const float lnR25 = logf(r25);
 	shA = 1.0/(25.0 - ABS_ZERO) - shB * lnR25 - shC * lnR25 * lnR25 * lnR25;
+	if (!isPT1000)
+	{
+		BuildTemperatureTable();
+	}
+}
+
+// Build the table of temperature against normalised ADC fraction. The fraction runs from 0 (zero thermistor
+// resistance) to 1 (open circuit), so the entire range of possible readings is covered. This is the only place
+// where we evaluate the Steinhart-Hart equation; GetTemperature just interpolates between adjacent entries.
+void Thermistor::BuildTemperatureTable()
+{
+	for (size_t i = 0; i <= TempTableSegments; ++i)
+	{
+		float temp;
+		if (i == 0)
+		{
+			temp = BAD_ERROR_TEMPERATURE;										// zero resistance, i.e. a short circuit
+		}
+		else if (i == TempTableSegments)
+		{
+			temp = ABS_ZERO;													// infinite resistance, i.e. an open circuit
+		}
+		else
+		{
+			const float fraction = (float)i/(float)TempTableSegments;
+			const float resistance = seriesR * fraction/(1.0 - fraction);
+			const float logResistance = logf(resistance);
+			const float recipT = shA + shB * logResistance + shC * logResistance * logResistance * logResistance;
+			temp = (recipT > 0.0) ? (1.0/recipT) + ABS_ZERO : BAD_ERROR_TEMPERATURE;
+		}
+		tempTable[i] = (int16_t)rintf(constrain<float>(temp, ABS_ZERO, BAD_ERROR_TEMPERATURE) * 10.0);
+	}
+}
+
+// Look up the temperature for a normalised ADC fraction, interpolating linearly between adjacent table entries
+float Thermistor::InterpolateTemperature(float fraction) const
+{
+	const float pos = constrain<float>(fraction, 0.0, 1.0) * (float)TempTableSegments;
+	const size_t index = min<size_t>((size_t)pos, TempTableSegments - 1);
+	const float interp = pos - (float)index;
+	return ((float)tempTable[index] * (1.0 - interp) + (float)tempTable[index + 1] * interp) * 0.1;
 }
 
 // End
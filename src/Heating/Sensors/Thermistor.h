@@ -30,7 +30,9 @@ private:
 	// For the theory behind ADC oversampling, see http://www.atmel.com/Images/doc8003.pdf
 	static constexpr unsigned int AdcOversampleBits = 2;					// we use 2-bit oversampling
 
-	void CalcDerivedParameters();											// calculate shA and shB
+	void CalcDerivedParameters();											// calculate shA and shB and rebuild the interpolation table
+	void BuildTemperatureTable();											// build the ADC fraction to temperature interpolation table
+	float InterpolateTemperature(float fraction) const;						// look up the temperature for a normalised ADC fraction
 
 	// The following are configurable parameters
 	float r25, beta, shC, seriesR;											// parameters declared in the M305 command
@@ -45,6 +47,12 @@ private:
 
 	static constexpr unsigned int AdcBits = 12;								// the ADCs in the SAM processors are 12-bit
 	static constexpr int32_t AdcRange = 1 << (AdcBits + AdcOversampleBits);	// The readings we pass in should be in range 0..(AdcRange - 1)
+
+	// Instead of evaluating the Steinhart-Hart equation for every reading, we build a table of temperatures
+	// at evenly-spaced values of the normalised ADC fraction when the sensor is configured, and interpolate
+	// linearly between its entries when taking a reading. Entries are in tenths of a degree C to save RAM.
+	static constexpr size_t TempTableSegments = 128;						// how many interpolation segments the table covers
+	int16_t tempTable[TempTableSegments + 1];								// temperature in 0.1C steps per normalised ADC fraction
 };
 
 #endif /* SRC_HEATING_THERMISTOR_H_ */
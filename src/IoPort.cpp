@@ -37,6 +37,24 @@ bool IoPort::Set(LogicalPin lp, PinAccess access)
 	return ret;
 }
 
+// Get the hardware port address and bit mask of this port, so that the caller can combine writes to several pins
+// on the same PIO controller into a single store. Returns false if the pin must be written through WriteDigital instead.
+bool IoPort::GetPortWriteDescriptor(Pio *&pioBase, uint32_t& pioMask, bool& inverted) const
+{
+	if (pin == NoPin
+#ifdef DUET_NG
+		|| pin >= DueXnExpansionStart
+#endif
+	   )
+	{
+		return false;
+	}
+	const PinDescription& pinDesc = g_APinDescription[pin];
+	pioBase = pinDesc.pPort;
+	pioMask = pinDesc.ulPin;
+	inverted = invert;
+	return true;
+}
 
 /*static*/ void IoPort::SetPinMode(Pin pin, PinMode mode)
 {
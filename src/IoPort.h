@@ -34,6 +34,11 @@ public:
 	LogicalPin GetLogicalPin() const { return logicalPort; }
 	void WriteDigital(bool high) const { if (pin != NoPin) { WriteDigital(pin, (invert) ? !high : high); } }
 
+	// Get the hardware port address and bit mask of this port, so that the caller can combine writes to several pins
+	// on the same PIO controller into a single store. Returns false if the pin must be written through WriteDigital
+	// instead, e.g. because it is on an expansion board.
+	bool GetPortWriteDescriptor(Pio *&pioBase, uint32_t& pioMask, bool& inverted) const;
+
 	// Low level port access
 	static void SetPinMode(Pin p, PinMode mode);
 	static bool ReadPin(Pin p);
@@ -83,6 +83,132 @@ extern "C" {
 #define SECTOR_SIZE_2048 4
 #define SECTOR_SIZE_4096 8
 
+/* Shared LRU sector cache.
+ *
+ * FatFS runs with _FS_TINY-style minimal buffering, so the same FAT and directory sectors are re-read
+ * from the card over and over, particularly when a print is being read while an upload is being written.
+ * We keep the most recently used single-sector transfers (which is how FatFS moves its FAT/directory
+ * window; bulk file data goes through here as multi-sector transfers and is deliberately not cached)
+ * in RAM, shared across all file handles and both drives. Writes of cached sectors are held back and
+ * coalesced, so repeated FAT updates for the same sector cost one card transaction; dirty sectors are
+ * flushed on eviction and on CTRL_SYNC, which FatFS issues from f_sync and f_close.
+ */
+#if ACCESS_MEM_TO_RAM
+
+#if SAM4E || SAM4S || SAME70
+# define SECTOR_CACHE_ENTRIES 16
+#else
+# define SECTOR_CACHE_ENTRIES 8		/* we are more memory-constrained on the SAM3X */
+#endif
+
+struct SectorCacheEntry {
+	DWORD sector;
+	uint32_t lastUsed;						/* pseudo-clock value for LRU replacement */
+	BYTE drv;
+	BYTE valid;
+	BYTE dirty;								/* the cached copy is newer than the one on the card */
+	BYTE data[SECTOR_SIZE_DEFAULT] __attribute__((aligned(4)));
+};
+
+static struct SectorCacheEntry sectorCache[SECTOR_CACHE_ENTRIES];
+static uint32_t sectorCacheClock = 0;
+
+/* Find the cache entry holding the given sector, or NULL if it is not cached */
+static struct SectorCacheEntry *cache_lookup(BYTE drv, DWORD sector)
+{
+	for (size_t i = 0; i < SECTOR_CACHE_ENTRIES; i++) {
+		if (sectorCache[i].valid && sectorCache[i].drv == drv
+				&& sectorCache[i].sector == sector) {
+			return &sectorCache[i];
+		}
+	}
+	return NULL;
+}
+
+/* Write a dirty entry back to the card, returning RES_OK if the entry is now clean */
+static DRESULT cache_flush_entry(struct SectorCacheEntry *e)
+{
+	if (e->dirty) {
+		if (ram_2_memory(e->drv, e->sector, e->data, 1) != CTRL_GOOD) {
+			return RES_ERROR;
+		}
+		e->dirty = 0;
+	}
+	return RES_OK;
+}
+
+/* Find the entry to load a new sector into, flushing the evicted sector if it is dirty.
+ * Returns NULL if the evicted sector could not be flushed, in which case the caller must not cache.
+ */
+static struct SectorCacheEntry *cache_evict(void)
+{
+	struct SectorCacheEntry *victim = &sectorCache[0];
+
+	for (size_t i = 0; i < SECTOR_CACHE_ENTRIES; i++) {
+		if (!sectorCache[i].valid) {
+			return &sectorCache[i];
+		}
+		if (sectorCache[i].lastUsed < victim->lastUsed) {
+			victim = &sectorCache[i];
+		}
+	}
+	if (cache_flush_entry(victim) != RES_OK) {
+		return NULL;
+	}
+	victim->valid = 0;
+	return victim;
+}
+
+/* Reconcile the cache with a multi-sector transfer that bypasses it. Before a read, dirty overlapping
+ * sectors must be written out so that the card holds the current data; before a write, overlapping
+ * entries are superseded and are simply discarded.
+ */
+static DRESULT cache_reconcile(BYTE drv, DWORD sector, BYTE count, int discard)
+{
+	DRESULT res = RES_OK;
+
+	for (size_t i = 0; i < SECTOR_CACHE_ENTRIES; i++) {
+		struct SectorCacheEntry *e = &sectorCache[i];
+		if (e->valid && e->drv == drv && e->sector >= sector && e->sector < sector + count) {
+			if (discard) {
+				e->valid = e->dirty = 0;
+			} else if (cache_flush_entry(e) != RES_OK) {
+				res = RES_ERROR;
+			}
+		}
+	}
+	return res;
+}
+
+/* Flush all dirty sectors cached for a drive. Called on CTRL_SYNC. */
+static DRESULT cache_flush_drive(BYTE drv)
+{
+	DRESULT res = RES_OK;
+
+	for (size_t i = 0; i < SECTOR_CACHE_ENTRIES; i++) {
+		if (sectorCache[i].valid && sectorCache[i].drv == drv
+				&& cache_flush_entry(&sectorCache[i]) != RES_OK) {
+			res = RES_ERROR;
+		}
+	}
+	return res;
+}
+
+/* Discard everything cached for a drive, including dirty sectors. Called when the drive is
+ * (re-)initialized, because a different card may have been inserted and stale data must neither be
+ * served nor written to it.
+ */
+static void cache_invalidate_drive(BYTE drv)
+{
+	for (size_t i = 0; i < SECTOR_CACHE_ENTRIES; i++) {
+		if (sectorCache[i].drv == drv) {
+			sectorCache[i].valid = sectorCache[i].dirty = 0;
+		}
+	}
+}
+
+#endif /* ACCESS_MEM_TO_RAM */
+
 /**
  * \brief Initialize a disk.
  *
@@ -124,6 +250,11 @@ DSTATUS disk_initialize(BYTE drv)
 		return STA_NOINIT;
 	}
 
+#if ACCESS_MEM_TO_RAM
+	/* A different card may have been inserted, so forget everything we had cached for this drive */
+	cache_invalidate_drive(drv);
+#endif
+
 	/* Check Write Protection Status */
 	if (mem_wr_protect(drv)) {
 		return STA_PROTECT;
@@ -180,6 +311,38 @@ DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, BYTE count)
 		return RES_PARERR;
 	}
 
+	if (count == 1 && uc_sector_size == SECTOR_SIZE_512) {
+		/* Single-sector transfers are FAT, directory and window sectors, which we cache */
+		struct SectorCacheEntry *e = cache_lookup(drv, sector);
+		if (e != NULL) {
+			memcpy(buff, e->data, SECTOR_SIZE_DEFAULT);
+			e->lastUsed = ++sectorCacheClock;
+			return RES_OK;
+		}
+
+		if (memory_2_ram(drv, sector, buff, 1) != CTRL_GOOD) {
+			return RES_ERROR;
+		}
+
+		e = cache_evict();
+		if (e != NULL) {
+			memcpy(e->data, buff, SECTOR_SIZE_DEFAULT);
+			e->drv = drv;
+			e->sector = sector;
+			e->lastUsed = ++sectorCacheClock;
+			e->dirty = 0;
+			e->valid = 1;
+		}
+		return RES_OK;
+	}
+
+	/* Bulk data transfer, which bypasses the cache. Any dirty cached sector in its range must be
+	 * written to the card first so that we read current data.
+	 */
+	if (cache_reconcile(drv, sector, count, 0) != RES_OK) {
+		return RES_ERROR;
+	}
+
 	/* Read the data */
 	if (memory_2_ram(drv, sector, buff, count) != CTRL_GOOD) {
 		return RES_ERROR;
@@ -226,6 +389,29 @@ DRESULT disk_write(BYTE drv, BYTE const *buff, DWORD sector, BYTE count)
 		return RES_PARERR;
 	}
 
+	if (count == 1 && uc_sector_size == SECTOR_SIZE_512) {
+		/* Hold the sector in the cache and write it back later, so that the repeated FAT and
+		 * directory updates made while a file grows coalesce into one card transaction.
+		 */
+		struct SectorCacheEntry *e = cache_lookup(drv, sector);
+		if (e == NULL) {
+			e = cache_evict();
+		}
+		if (e != NULL) {
+			memcpy(e->data, buff, SECTOR_SIZE_DEFAULT);
+			e->drv = drv;
+			e->sector = sector;
+			e->lastUsed = ++sectorCacheClock;
+			e->dirty = 1;
+			e->valid = 1;
+			return RES_OK;
+		}
+		/* No entry could be freed, so fall through and write the sector directly */
+	} else {
+		/* Bulk data transfer, which supersedes anything we had cached in its range */
+		cache_reconcile(drv, sector, count, 1);
+	}
+
 	/* Write the data */
 	if (ram_2_memory(drv, sector, buff, count) != CTRL_GOOD) {
 		return RES_ERROR;
@@ -311,7 +497,11 @@ DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
 	/* Make sure that data has been written */
 	case CTRL_SYNC:
 		if (mem_test_unit_ready(drv) == CTRL_GOOD) {
+#if ACCESS_MEM_TO_RAM
+			res = cache_flush_drive(drv);		/* write out any coalesced FAT/directory sectors we are still holding */
+#else
 			res = RES_OK;
+#endif
 		} else {
 			res = RES_NOTRDY;
 		}
@@ -8,6 +8,8 @@
 #include "StringRef.h"
 #include <cstring>
 #include <cstdio>
+#include <cstdint>
+#include <cmath>
 #include "WMath.h"
 
 // Need to define strnlen here because it isn't ISO standard
@@ -21,6 +23,220 @@ size_t strnlen(const char *s, size_t n)
 	return rslt;
 }
 
+//*************************************************************************************************
+// Formatting engine
+
+// Powers of ten for the fixed-precision float conversion. The table length limits %f to 7 decimal places,
+// which is all that a float can meaningfully provide anyway.
+static const unsigned int MaxFloatDecimals = 7;
+static const uint64_t PowersOfTen[MaxFloatDecimals + 1] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+// Append a character to the output, counting it even when the buffer is already full, as vsnprintf does
+static inline void PutChar(char *buf, size_t maxLen, size_t& pos, char c)
+{
+	if (pos + 1 < maxLen)
+	{
+		buf[pos] = c;
+	}
+	++pos;
+}
+
+// Write an already-converted item with an optional sign, honouring the field width and padding flags
+static void PutPadded(char *buf, size_t maxLen, size_t& pos, const char *item, size_t itemLen, char sign, unsigned int fieldWidth, bool leftAlign, bool zeroPad)
+{
+	const size_t totalLen = itemLen + ((sign != 0) ? 1 : 0);
+	if (leftAlign)
+	{
+		if (sign != 0) { PutChar(buf, maxLen, pos, sign); }
+		for (size_t i = 0; i < itemLen; ++i) { PutChar(buf, maxLen, pos, item[i]); }
+		for (size_t i = totalLen; i < fieldWidth; ++i) { PutChar(buf, maxLen, pos, ' '); }
+	}
+	else if (zeroPad)
+	{
+		if (sign != 0) { PutChar(buf, maxLen, pos, sign); }
+		for (size_t i = totalLen; i < fieldWidth; ++i) { PutChar(buf, maxLen, pos, '0'); }
+		for (size_t i = 0; i < itemLen; ++i) { PutChar(buf, maxLen, pos, item[i]); }
+	}
+	else
+	{
+		for (size_t i = totalLen; i < fieldWidth; ++i) { PutChar(buf, maxLen, pos, ' '); }
+		if (sign != 0) { PutChar(buf, maxLen, pos, sign); }
+		for (size_t i = 0; i < itemLen; ++i) { PutChar(buf, maxLen, pos, item[i]); }
+	}
+}
+
+// Convert an unsigned integer to decimal or hex digits. 'out' must have room for 20 characters.
+static size_t UnsignedToDigits(uint64_t val, unsigned int base, bool upperCase, char *out)
+{
+	char temp[20];
+	size_t tempLen = 0;
+	do
+	{
+		const unsigned int digit = (unsigned int)(val % base);
+		temp[tempLen++] = (digit < 10) ? (char)('0' + digit)
+						: (char)(((upperCase) ? 'A' : 'a') + digit - 10);
+		val /= base;
+	} while (val != 0);
+
+	for (size_t i = 0; i < tempLen; ++i)
+	{
+		out[i] = temp[tempLen - 1 - i];
+	}
+	return tempLen;
+}
+
+int SafeVsnprintf(char *buf, size_t maxLen, const char *fmt, va_list vargs)
+{
+	// Keep a copy of the arguments so that we can delegate the whole job to the library if we have to
+	va_list copiedArgs;
+	va_copy(copiedArgs, vargs);
+
+	size_t pos = 0;
+	bool formattedOk = true;
+	const char *p = fmt;
+	while (*p != 0 && formattedOk)
+	{
+		if (*p != '%')
+		{
+			PutChar(buf, maxLen, pos, *p++);
+			continue;
+		}
+		++p;
+
+		// Flags
+		bool leftAlign = false, zeroPad = false, plusFlag = false, spaceFlag = false;
+		for (;;)
+		{
+			if (*p == '-') { leftAlign = true; }
+			else if (*p == '0') { zeroPad = true; }
+			else if (*p == '+') { plusFlag = true; }
+			else if (*p == ' ') { spaceFlag = true; }
+			else break;
+			++p;
+		}
+
+		// Field width
+		unsigned int fieldWidth = 0;
+		while (*p >= '0' && *p <= '9')
+		{
+			fieldWidth = (fieldWidth * 10) + (*p++ - '0');
+		}
+
+		// Precision
+		bool havePrecision = false;
+		unsigned int precision = 0;
+		if (*p == '.')
+		{
+			havePrecision = true;
+			++p;
+			while (*p >= '0' && *p <= '9')
+			{
+				precision = (precision * 10) + (*p++ - '0');
+			}
+		}
+
+		// Length modifier - we support a single 'l' only
+		bool isLong = false;
+		if (*p == 'l')
+		{
+			isLong = true;
+			++p;
+		}
+
+		char numBuf[40];
+		switch (*p)
+		{
+		case '%':
+			PutChar(buf, maxLen, pos, '%');
+			break;
+
+		case 'c':
+			numBuf[0] = (char)va_arg(vargs, int);
+			PutPadded(buf, maxLen, pos, numBuf, 1, 0, fieldWidth, leftAlign, false);
+			break;
+
+		case 's':
+			{
+				const char *s = va_arg(vargs, const char*);
+				if (s == nullptr)
+				{
+					s = "(null)";
+				}
+				const size_t sLen = (havePrecision) ? strnlen(s, precision) : strlen(s);
+				PutPadded(buf, maxLen, pos, s, sLen, 0, fieldWidth, leftAlign, false);
+			}
+			break;
+
+		case 'd':
+		case 'i':
+			{
+				const long val = (isLong) ? va_arg(vargs, long) : va_arg(vargs, int);
+				const char sign = (val < 0) ? '-' : (plusFlag) ? '+' : (spaceFlag) ? ' ' : (char)0;
+				const size_t numLen = UnsignedToDigits((val < 0) ? -(uint64_t)val : (uint64_t)val, 10, false, numBuf);
+				PutPadded(buf, maxLen, pos, numBuf, numLen, sign, fieldWidth, leftAlign, zeroPad);
+			}
+			break;
+
+		case 'u':
+		case 'x':
+		case 'X':
+			{
+				const unsigned long val = (isLong) ? va_arg(vargs, unsigned long) : va_arg(vargs, unsigned int);
+				const size_t numLen = UnsignedToDigits(val, (*p == 'u') ? 10 : 16, (*p == 'X'), numBuf);
+				PutPadded(buf, maxLen, pos, numBuf, numLen, 0, fieldWidth, leftAlign, zeroPad);
+			}
+			break;
+
+		case 'f':
+		case 'F':
+			{
+				const double val = va_arg(vargs, double);
+				const unsigned int decimals = (havePrecision) ? precision : 6;
+				if (std::isnan(val) || std::isinf(val) || decimals > MaxFloatDecimals || fabs(val) >= 1.0e15)
+				{
+					formattedOk = false;		// let the library handle the odd cases
+					break;
+				}
+				const char sign = (val < 0.0) ? '-' : (plusFlag) ? '+' : (spaceFlag) ? ' ' : (char)0;
+				const uint64_t scaled = (uint64_t)((fabs(val) * (double)PowersOfTen[decimals]) + 0.5);
+				size_t numLen = UnsignedToDigits(scaled/PowersOfTen[decimals], 10, false, numBuf);
+				if (decimals != 0)
+				{
+					numBuf[numLen++] = '.';
+					uint64_t frac = scaled % PowersOfTen[decimals];
+					for (size_t i = 0; i < decimals; ++i)
+					{
+						const uint64_t divisor = PowersOfTen[decimals - 1 - i];
+						numBuf[numLen++] = (char)('0' + (frac/divisor));
+						frac %= divisor;
+					}
+				}
+				PutPadded(buf, maxLen, pos, numBuf, numLen, sign, fieldWidth, leftAlign, zeroPad);
+			}
+			break;
+
+		default:
+			formattedOk = false;				// a conversion we don't handle, e.g. %e, %g, %hu or %*d
+			break;
+		}
+		++p;
+	}
+
+	if (!formattedOk)
+	{
+		const int ret = vsnprintf(buf, maxLen, fmt, copiedArgs);
+		va_end(copiedArgs);
+		return ret;
+	}
+	va_end(copiedArgs);
+
+	if (maxLen != 0)
+	{
+		buf[(pos < maxLen) ? pos : maxLen - 1] = 0;
+	}
+	return (int)pos;
+}
+
 //*************************************************************************************************
 // StringRef class member implementations
 
@@ -33,14 +249,14 @@ int StringRef::printf(const char *fmt, ...) const
 {
 	va_list vargs;
 	va_start(vargs, fmt);
-	int ret = vsnprintf(p, len, fmt, vargs);
+	int ret = SafeVsnprintf(p, len, fmt, vargs);
 	va_end(vargs);
 	return ret;
 }
 
 int StringRef::vprintf(const char *fmt, va_list vargs) const
 {
-	return vsnprintf(p, len, fmt, vargs);
+	return SafeVsnprintf(p, len, fmt, vargs);
 }
 
 int StringRef::catf(const char *fmt, ...) const
@@ -50,7 +266,7 @@ int StringRef::catf(const char *fmt, ...) const
 	{
 		va_list vargs;
 		va_start(vargs, fmt);
-		int ret = vsnprintf(p + n, len - n, fmt, vargs);
+		int ret = SafeVsnprintf(p + n, len - n, fmt, vargs);
 		va_end(vargs);
 		return ret + n;
 	}
@@ -62,7 +278,7 @@ int StringRef::vcatf(const char *fmt, va_list vargs) const
 	size_t n = strlen();
 	if (n + 1 < len)		// if room for at least 1 more character and a null
 	{
-		return vsnprintf(p + n, len - n, fmt, vargs) + n;
+		return SafeVsnprintf(p + n, len - n, fmt, vargs) + n;
 	}
 	return 0;
 }
@@ -76,6 +292,15 @@ size_t StringRef::copy(const char* src) const
 	return length;
 }
 
+// Copy from characters that are not necessarily NUL terminated, truncating if they do not fit
+size_t StringRef::copy(const char* src, size_t srcLen) const
+{
+	const size_t length = min<size_t>(srcLen, len - 1);
+	memcpy(p, src, length);
+	p[length] = 0;
+	return length;
+}
+
 // This is quicker than catf for printing constant strings
 size_t StringRef::cat(const char* src) const
 {
@@ -18,6 +18,11 @@
 // Need to declare strnlen here because it isn't ISO standard
 size_t strnlen(const char *s, size_t n);
 
+// Formatting engine optimised for the numeric output that dominates our JSON responses. It handles the
+// conversions we actually use (including fixed-precision %f without going through the library float code);
+// any conversion it does not know is handed back to the library vsnprintf, so it is always safe to use.
+int SafeVsnprintf(char *buf, size_t maxLen, const char *fmt, va_list vargs);
+
 // Class to describe a string buffer, including its length. This saves passing buffer lengths around everywhere.
 class StringRef
 {
@@ -43,6 +48,7 @@ public:
 	int catf(const char *fmt, ...) const __attribute__ ((format (printf, 2, 3)));
 	int vcatf(const char *fmt, va_list vargs) const;
 	size_t copy(const char* src) const;
+	size_t copy(const char* src, size_t srcLen) const;	// copy from characters that are not necessarily NUL terminated
 	size_t cat(const char *src) const;
 	size_t cat(char c) const;
 	size_t StripTrailingSpaces() const;
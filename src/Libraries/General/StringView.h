@@ -0,0 +1,92 @@
+/*
+ * StringView.h
+ *
+ * Non-owning view of a character sequence with an explicit length
+ */
+
+#ifndef SRC_LIBRARIES_GENERAL_STRINGVIEW_H_
+#define SRC_LIBRARIES_GENERAL_STRINGVIEW_H_
+
+#include <cstddef>	// for size_t
+#include <cstring>	// for strlen etc.
+
+#include "StringRef.h"
+
+// Class to describe a slice of somebody else's character buffer, without owning it and without requiring a NUL
+// terminator. It lets parser code pass substrings around as pointer + length instead of copying them into scratch
+// buffers; the underlying buffer must of course outlive the view. All accesses are bounds checked.
+class StringView
+{
+public:
+	static constexpr size_t npos = ~(size_t)0;
+
+	StringView() : p(nullptr), len(0) { }
+	StringView(const char *pp, size_t pl) : p(pp), len(pl) { }
+	explicit StringView(const char *pp) : p(pp), len(::strlen(pp)) { }
+
+	size_t Length() const { return len; }
+	bool IsEmpty() const { return len == 0; }
+	const char *Data() const { return p; }				// note, NOT necessarily NUL terminated!
+
+	char operator[](size_t index) const { return (index < len) ? p[index] : 0; }
+
+	// Compare with a NUL-terminated string
+	bool Equals(const char *s) const
+	{
+		return strncmp(p, s, len) == 0 && s[len] == 0;
+	}
+
+	bool StartsWith(const char *prefix) const
+	{
+		const size_t prefixLength = ::strlen(prefix);
+		return prefixLength <= len && memcmp(p, prefix, prefixLength) == 0;
+	}
+
+	bool EndsWith(const char *suffix) const
+	{
+		const size_t suffixLength = ::strlen(suffix);
+		return suffixLength <= len && memcmp(p + len - suffixLength, suffix, suffixLength) == 0;
+	}
+
+	// Return the index of the first occurrence of a character, or npos if it is not present
+	size_t Find(char c) const
+	{
+		const char * const q = (const char *)memchr(p, c, len);
+		return (q == nullptr) ? npos : (size_t)(q - p);
+	}
+
+	// Return a sub-slice, clamped to the bounds of this view
+	StringView SubView(size_t start, size_t count = npos) const
+	{
+		if (start >= len)
+		{
+			return StringView();
+		}
+		const size_t maxCount = len - start;
+		return StringView(p + start, (count < maxCount) ? count : maxCount);
+	}
+
+	// Return this view with any trailing spaces excluded
+	StringView WithoutTrailingSpaces() const
+	{
+		size_t newLen = len;
+		while (newLen != 0 && p[newLen - 1] == ' ')
+		{
+			--newLen;
+		}
+		return StringView(p, newLen);
+	}
+
+	// Copy the viewed characters into NUL-terminated storage in one operation, truncating if they do not fit.
+	// Returns the number of characters copied.
+	size_t CopyTo(const StringRef& dst) const
+	{
+		return dst.copy(p, len);
+	}
+
+private:
+	const char *p;		// pointer to the viewed characters, not owned and not necessarily NUL terminated
+	size_t len;			// number of characters viewed
+};
+
+#endif /* SRC_LIBRARIES_GENERAL_STRINGVIEW_H_ */
@@ -0,0 +1,57 @@
+/*
+ * Fixed.h
+ *
+ * Fixed-point arithmetic support for the movement code
+ */
+
+#ifndef SRC_LIBRARIES_MATH_FIXED_H_
+#define SRC_LIBRARIES_MATH_FIXED_H_
+
+#include <cstdint>
+
+// Qfrac is a fixed-point number with a compile-time number of fraction bits, stored in integer type T.
+// The movement code previously scaled such values manually by constants like K1 = 1024 and divided the scale
+// factor back out at each point of use. Carrying the scale in the type instead lets the compiler check that
+// values of different formats are not mixed, and the divisions by the scale factor are guaranteed to be shifts.
+template<class T, unsigned int F> class Qfrac
+{
+public:
+	static_assert(F < 8 * sizeof(T), "too many fraction bits for the storage type");
+
+	typedef T RawType;
+	static constexpr unsigned int FractionBits = F;
+	static constexpr T ScaleFactor = (T)1 << F;
+
+	Qfrac() = default;										// deliberately uninitialised, like the plain integers it replaces, so that it can be a union member
+
+	// Conversions. FromFloat rounds towards zero, as the movement code does when ROUND_TO_NEAREST is not set.
+	static constexpr Qfrac FromFloat(float f) { return Qfrac((T)(f * (float)ScaleFactor)); }
+	static constexpr Qfrac FromRaw(T r) { return Qfrac(r); }
+	constexpr T GetRaw() const { return raw; }
+	constexpr float ToFloat() const { return (float)raw / (float)ScaleFactor; }
+
+	// Change the number of fraction bits. Which way to shift is decided at compile time.
+	template<unsigned int NewF> constexpr Qfrac<T, NewF> Rescale() const
+	{
+		return Qfrac<T, NewF>::FromRaw((NewF >= F) ? raw << (NewF - F) : raw >> (F - NewF));
+	}
+
+	// Addition and subtraction require identical formats, which is where the compile-time scaling check comes from:
+	// mixing formats fails to compile instead of silently producing a value with the wrong scale.
+	constexpr Qfrac operator+(const Qfrac& other) const { return Qfrac(raw + other.raw); }
+	constexpr Qfrac operator-(const Qfrac& other) const { return Qfrac(raw - other.raw); }
+
+	// Multiplying by a plain integer preserves the format
+	Qfrac& operator*=(T n) { raw *= n; return *this; }
+
+	// Multiply by a plain 32-bit unsigned integer through a 64-bit intermediate and discard the fraction bits,
+	// i.e. return floor(value * n). The division by the scale factor reduces to a shift.
+	uint32_t MulU(uint32_t n) const { return (uint32_t)(((uint64_t)raw * n) >> F); }
+
+private:
+	explicit constexpr Qfrac(T r) : raw(r) {}
+
+	T raw;
+};
+
+#endif /* SRC_LIBRARIES_MATH_FIXED_H_ */
@@ -8,6 +8,10 @@ uint32_t isqrt64(uint64_t num)
 	{
 		// 32-bit square root - thanks to Wilco Dijksra for this efficient ARM algorithm
 		uint32_t num32 = (uint32_t)num;
+		if (num32 == 0)
+		{
+			return 0;
+		}
 		uint32_t res = 0;
 
 		#define iter32(N)						\
@@ -20,11 +24,28 @@ uint32_t isqrt64(uint64_t num)
 			}									\
 		}
 
-		// We need to do 16 iterations
-		iter32(15); iter32(14); iter32(13); iter32(12);
-		iter32(11); iter32(10); iter32(9); iter32(8);
-		iter32(7); iter32(6); iter32(5); iter32(4);
-		iter32(3); iter32(2); iter32(1); iter32(0);
+		// Iteration N does nothing unless num32 >= 1 << (2 * N), so use a CLZ-based initial guess of the result
+		// magnitude to skip the iterations that cannot contribute. Small operands, which step time calculation
+		// generates in abundance, then do only a few iterations instead of all 16. The cases fall through.
+		switch ((31 - __builtin_clz(num32)) >> 1)
+		{
+		case 15:	iter32(15);
+		case 14:	iter32(14);
+		case 13:	iter32(13);
+		case 12:	iter32(12);
+		case 11:	iter32(11);
+		case 10:	iter32(10);
+		case 9:		iter32(9);
+		case 8:		iter32(8);
+		case 7:		iter32(7);
+		case 6:		iter32(6);
+		case 5:		iter32(5);
+		case 4:		iter32(4);
+		case 3:		iter32(3);
+		case 2:		iter32(2);
+		case 1:		iter32(1);
+		case 0:		iter32(0);
+		}
 
 		return res >> 1;
 	}
@@ -86,4 +107,60 @@ uint32_t isqrt64(uint64_t num)
 	}
 }
 
+#if !(SAM4E || SAME70)
+
+// Union for the float bit manipulation below; type-punning through a union is well-defined in GCC
+union FloatBits
+{
+	float f;
+	uint32_t u;
+};
+
+#endif
+
+// Fast approximate reciprocal square root, valid for x > 0
+float fastRsqrtf(float x)
+{
+#if SAM4E || SAME70
+	// These processors have a hardware FPU, so VSQRT followed by VDIV (about 14 cycles each) is both fast and exact
+	return 1.0f/__builtin_sqrtf(x);
+#else
+	// No FPU, so a software float divide would cost hundreds of cycles. Use the classic exponent bit hack to get
+	// an initial estimate and refine it with two Newton-Raphson iterations, giving a relative error below 5e-6.
+	FloatBits b;
+	b.f = x;
+	b.u = 0x5F3759DF - (b.u >> 1);
+	const float halfX = 0.5f * x;
+	float r = b.f;
+	r = r * (1.5f - halfX * r * r);
+	r = r * (1.5f - halfX * r * r);
+	return r;
+#endif
+}
+
+// Fast approximate reciprocal, valid for finite nonzero x
+float fastRecipf(float x)
+{
+#if SAM4E || SAME70
+	// VDIV is about 14 cycles, no point in approximating
+	return 1.0f/x;
+#else
+	// Negate the exponent to get an initial estimate, then refine with three Newton-Raphson iterations.
+	// Each iteration doubles the number of correct bits, so three leave the result good to the last bit or two.
+	// The bit hack only works on the magnitude, so handle the sign separately.
+	FloatBits b;
+	b.f = x;
+	const uint32_t sign = b.u & 0x80000000u;
+	b.u = 0x7EF311C3 - (b.u & 0x7FFFFFFFu);
+	const float ax = fabsf(x);
+	float r = b.f;
+	r = r * (2.0f - ax * r);
+	r = r * (2.0f - ax * r);
+	r = r * (2.0f - ax * r);
+	b.f = r;
+	b.u |= sign;
+	return b.f;
+#endif
+}
+
 // End
@@ -10,4 +10,10 @@
 
 extern uint32_t isqrt64(uint64_t num);		// This is defined in its own file, Isqrt.cpp or Isqrt.asm
 
+// Fast approximate float kernels, also defined in Isqrt.cpp. On processors with a hardware FPU these are exact
+// (VSQRT/VDIV); on the SAM3X they avoid the expensive software float divide at the cost of a relative error
+// of a few parts per million, which is far below the mechanical accuracy of any machine we drive.
+extern float fastRsqrtf(float x);			// approximate 1/sqrt(x) for x > 0
+extern float fastRecipf(float x);			// approximate 1/x for finite nonzero x
+
 #endif /* SRC_LIBRARIES_MATH_ISQRT_H_ */
@@ -50,6 +50,10 @@ public:
 	pre(numRows <= ROWS; numRows + 1 <= COLS)
 	;
 
+	bool CholeskySolve(T *solution, size_t numRows)
+	pre(numRows <= ROWS; numRows + 1 <= COLS)
+	;
+
 	// Return a pointer to a specified row, non-const version
 	T* GetRow(size_t r)
 	pre(r < ROWS)
@@ -100,33 +104,123 @@ template<class T, size_t ROWS, size_t COLS> void FixedMatrix<T, ROWS, COLS>::Gau
 			}
 		}
 
-		// Use row i to eliminate the ith element from previous and subsequent rows
-		T v = (*this)(i, i);
-		for (size_t j = 0; j < i; ++j)
+		// Use row i to eliminate the ith element from all the other rows. Work on raw row pointers with the inner loop
+		// unrolled by 4, which keeps the Cortex-M4 FPU pipeline fed instead of stalling on one multiply-add at a time.
+		const T * const pivotRow = GetRow(i);
+		const T v = pivotRow[i];
+		for (size_t j = 0; j < numRows; ++j)
 		{
-			T factor = (*this)(j, i)/v;
-			(*this)(j, i) = 0.0;
-			for (size_t k = i + 1; k <= numRows; ++k)
+			if (j != i)
 			{
-				(*this)(j, k) -= (*this)(i, k) * factor;
+				T * const row = GetRow(j);
+				const T factor = row[i]/v;
+				row[i] = 0.0;
+				size_t k = i + 1;
+				while (k + 3 <= numRows)
+				{
+					const T t0 = row[k] - pivotRow[k] * factor;
+					const T t1 = row[k + 1] - pivotRow[k + 1] * factor;
+					const T t2 = row[k + 2] - pivotRow[k + 2] * factor;
+					const T t3 = row[k + 3] - pivotRow[k + 3] * factor;
+					row[k] = t0;
+					row[k + 1] = t1;
+					row[k + 2] = t2;
+					row[k + 3] = t3;
+					k += 4;
+				}
+				while (k <= numRows)
+				{
+					row[k] -= pivotRow[k] * factor;
+					++k;
+				}
 			}
 		}
+	}
 
-		for (size_t j = i + 1; j < numRows; ++j)
+	for (size_t i = 0; i < numRows; ++i)
+	{
+		solution[i] = (*this)(i, numRows) / (*this)(i, i);
+	}
+}
+
+// Solve a N x (N+1) augmented matrix whose leading N x N part is symmetric positive definite, as the normal matrix of a
+// least squares fit is. This does about a third of the work of GaussJordan and needs no row interchanges, which matters
+// because the calibration solves run in the main loop. The matrix is overwritten.
+// Returns false without producing a solution if the matrix turns out not to be positive definite, e.g. because the probe
+// points were degenerate. In that case the matrix is restored, so the caller can fall back to GaussJordan.
+template<class T, size_t ROWS, size_t COLS> bool FixedMatrix<T, ROWS, COLS>::CholeskySolve(T *solution, size_t numRows)
+{
+	// Factorise the leading part as L * transpose(L). The off-diagonal elements of L go in the lower triangle, which is
+	// redundant because the matrix is symmetric; the diagonal of L goes in the solution vector, which is otherwise unused
+	// until the final substitution pass. That way the matrix is easy to restore if the factorisation fails.
+	for (size_t i = 0; i < numRows; ++i)
+	{
+		const T * const rowI = GetRow(i);
+		for (size_t j = 0; j <= i; ++j)
 		{
-			T factor = (*this)(j, i)/v;
-			(*this)(j, i) = 0.0;
-			for (size_t k = i + 1; k <= numRows; ++k)
+			// Accumulate the dot product in two independent streams so that consecutive FPU multiply-adds don't have to
+			// wait for each other, then combine them at the end
+			const T * const rowJ = GetRow(j);
+			T sum0 = 0.0, sum1 = 0.0;
+			size_t k = 0;
+			while (k + 1 < j)
 			{
-				(*this)(j, k) -= (*this)(i, k) * factor;
+				sum0 += rowI[k] * rowJ[k];
+				sum1 += rowI[k + 1] * rowJ[k + 1];
+				k += 2;
+			}
+			if (k < j)
+			{
+				sum0 += rowI[k] * rowJ[k];
+			}
+			const T sum = rowI[j] - (sum0 + sum1);
+			if (i == j)
+			{
+				if (sum <= 0.0)
+				{
+					// Not positive definite. Restore the lower triangle from the untouched upper one and give up.
+					for (size_t r = 1; r <= i; ++r)
+					{
+						for (size_t c = 0; c < r; ++c)
+						{
+							(*this)(r, c) = (*this)(c, r);
+						}
+					}
+					return false;
+				}
+				solution[i] = sqrt(sum);
+			}
+			else
+			{
+				(*this)(i, j) = sum/solution[j];
 			}
 		}
 	}
 
+	// Forward substitution: solve L * y = b using the augmented column as b, storing y back in the augmented column
 	for (size_t i = 0; i < numRows; ++i)
 	{
-		solution[i] = (*this)(i, numRows) / (*this)(i, i);
+		T sum = (*this)(i, numRows);
+		for (size_t k = 0; k < i; ++k)
+		{
+			sum -= (*this)(i, k) * (*this)(k, numRows);
+		}
+		(*this)(i, numRows) = sum/solution[i];
+	}
+
+	// Back substitution: solve transpose(L) * x = y. Each diagonal element of L is used one last time just before the
+	// corresponding solution element overwrites it.
+	for (size_t i = numRows; i != 0; )
+	{
+		--i;
+		T sum = (*this)(i, numRows);
+		for (size_t k = i + 1; k < numRows; ++k)
+		{
+			sum -= (*this)(k, i) * solution[k];
+		}
+		solution[i] = sum/solution[i];
 	}
+	return true;
 }
 
 #endif /* MATRIX_H_ */
@@ -10,6 +10,11 @@
 #include "OutputMemory.h"
 #include "RepRap.h"
 #include "Platform.h"
+#include "Movement/Move.h"
+
+// We hold off writing buffered log data to the SD card while a print is running low on buffered moves,
+// so that the write latency cannot contribute to a movement underrun
+const uint32_t HealthyQueuedMoves = DdaRingLength/2;
 
 // Simple lock class that sets a variable true when it is created and makes sure it gets set false when it falls out of scope
 class Lock
@@ -22,7 +27,8 @@ private:
 	bool& b;
 };
 
-Logger::Logger() : logFile(), lastFlushTime(0), lastFlushFileSize(0), dirty(false), inLogger(false)
+Logger::Logger() : logFile(), lastFlushTime(0), lastFlushFileSize(0), dirty(false), inLogger(false),
+	logBufferIn(0), logBufferOut(0), droppedLines(0)
 {
 }
 
@@ -34,9 +40,12 @@ void Logger::Start(time_t time, const StringRef& filename)
 		FileStore * const f = reprap.GetPlatform().OpenFile(SYS_DIR, filename.Pointer(), OpenMode::append);
 		if (f != nullptr)
 		{
+			f->UseDeferredSync();					// the log is written often, so batch its FAT updates to reduce latency spikes and card wear
 			logFile.Set(f);
 			lastFlushFileSize = logFile.Length();
 			logFile.Seek(lastFlushFileSize);
+			logBufferIn = logBufferOut = 0;
+			droppedLines = 0;
 			InternalLogMessage(time, "Event logging started\n");
 		}
 	}
@@ -48,6 +57,7 @@ void Logger::Stop(time_t time)
 	{
 		Lock loggerLock(inLogger);
 		InternalLogMessage(time, "Event logging stopped\n");
+		DrainBuffer();
 		logFile.Close();
 	}
 }
@@ -66,19 +76,27 @@ void Logger::LogMessage(time_t time, OutputBuffer *buf)
 	if (logFile.IsLive() && !inLogger)
 	{
 		Lock loggerLock(inLogger);
-		bool ok = WriteDateTime(time);
-		if (ok)
+		if (buf->Length() + 40 > SpaceInBuffer())		// allow for the date/time and a trailing newline
 		{
-			ok = buf->WriteToFile(logFile);
+			++droppedLines;
+			return;
 		}
 
-		if (ok)
-		{
-			dirty = true;
-		}
-		else
+		if (AppendDateTime(time))
 		{
-			logFile.Close();
+			char lastChar = 0;
+			for (const OutputBuffer *chunk = buf; chunk != nullptr; chunk = chunk->Next())
+			{
+				if (chunk->DataLength() != 0)
+				{
+					AppendToBuffer(chunk->Data(), chunk->DataLength());
+					lastChar = chunk->Data()[chunk->DataLength() - 1];
+				}
+			}
+			if (lastChar != '\n')
+			{
+				AppendToBuffer("\n", 1);
+			}
 		}
 	}
 }
@@ -86,59 +104,78 @@ void Logger::LogMessage(time_t time, OutputBuffer *buf)
 // Version of LogMessage for when we already know we want to proceed and we have already set inLogger
 void Logger::InternalLogMessage(time_t time, const char *message)
 {
-	bool ok = WriteDateTime(time);
-	if (ok)
+	const size_t len = strlen(message);
+	if (len + 40 > SpaceInBuffer())						// allow for the date/time and a trailing newline
 	{
-		const size_t len = strlen(message);
-		if (len != 0)
-		{
-			ok = logFile.Write(message, len);
-		}
-		if (ok && (len == 0 || message[len - 1] != '\n'))
-		{
-			ok = logFile.Write('\n');
-		}
+		++droppedLines;
+		return;
 	}
 
-	if (ok)
+	if (AppendDateTime(time))
 	{
-		dirty = true;
-	}
-	else
-	{
-		logFile.Close();
+		AppendToBuffer(message, len);
+		if (len == 0 || message[len - 1] != '\n')
+		{
+			AppendToBuffer("\n", 1);
+		}
 	}
 }
 
-// This is called regularly by Platform to give the logger an opportunity to flush the file buffer
+// This is called regularly by Platform to give the logger an opportunity to write out buffered data and flush the file.
+// Unless the flush is forced, we only touch the SD card when no movement is in progress or the DDA ring holds plenty of
+// queued moves, so that the write latency cannot starve the movement code.
 void Logger::Flush(bool forced)
 {
-	if (logFile.IsLive() && dirty && !inLogger)
+	if (logFile.IsLive() && !inLogger)
 	{
-		// Log file is dirty and can be flushed.
-		// To avoid excessive disk write operations, flush it only if one of the following is true:
-		// 1. We have possibly allocated a new cluster since the last flush. To avoid lost clusters if we power down before flushing,
-		//    we should flush early in this case. Rather than determine the cluster size, we flush if we have started a new 512-byte sector.
-		// 2. If it hasn't been flushed for LogFlushInterval milliseconds.
-		const FilePosition currentPos = logFile.GetPosition();
-		const uint32_t now = millis();
-		if (forced || now - lastFlushTime >= LogFlushInterval || currentPos/512 != lastFlushFileSize/512)
+		Lock loggerLock(inLogger);
+		if (logBufferIn != logBufferOut)
 		{
-			Lock loggerLock(inLogger);
-			logFile.Flush();
-			lastFlushTime = millis();
-			lastFlushFileSize = currentPos;
-			dirty = false;
+			const Move& move = reprap.GetMove();
+			if (forced || move.NoLiveMovement() || move.GetScheduledMoves() - move.GetCompletedMoves() >= HealthyQueuedMoves)
+			{
+				DrainBuffer();
+			}
+		}
+
+		if (logFile.IsLive() && dirty)
+		{
+			// Log file is dirty and can be flushed.
+			// To avoid excessive disk write operations, flush it only if one of the following is true:
+			// 1. We have possibly allocated a new cluster since the last flush. To avoid lost clusters if we power down before flushing,
+			//    we should flush early in this case. Rather than determine the cluster size, we flush if we have started a new 512-byte sector.
+			// 2. If it hasn't been flushed for LogFlushInterval milliseconds.
+			const FilePosition currentPos = logFile.GetPosition();
+			const uint32_t now = millis();
+			if (forced || now - lastFlushTime >= LogFlushInterval || currentPos/512 != lastFlushFileSize/512)
+			{
+				logFile.Flush();
+				lastFlushTime = millis();
+				lastFlushFileSize = currentPos;
+				dirty = false;
+			}
 		}
 	}
 }
 
-// Write the data and time to the file followed by a space.
-// Caller must already have checked and set inLogger.
-bool Logger::WriteDateTime(time_t time)
+// Append the date and time to the buffer followed by a space, preceded by a note about any lines we had to discard.
+// Caller must already have checked and set inLogger and confirmed that there is room in the buffer.
+bool Logger::AppendDateTime(time_t time)
 {
-	char bufferSpace[30];
+	char bufferSpace[40];
 	StringRef buf(bufferSpace, ARRAY_SIZE(bufferSpace));
+	if (droppedLines != 0)
+	{
+		buf.printf("(%u lines lost)\n", droppedLines);
+		if (buf.strlen() + 31 > SpaceInBuffer())		// keep room for the date/time too
+		{
+			++droppedLines;
+			return false;
+		}
+		AppendToBuffer(buf.Pointer(), buf.strlen());
+		droppedLines = 0;
+	}
+
 	if (time == 0)
 	{
 		const uint32_t timeSincePowerUp = (uint32_t)(millis64()/1000u);
@@ -150,7 +187,44 @@ bool Logger::WriteDateTime(time_t time)
 		buf.printf("%04u-%02u-%02u %02u:%02u:%02u ",
 						timeInfo->tm_year + 1900, timeInfo->tm_mon + 1, timeInfo->tm_mday, timeInfo->tm_hour, timeInfo->tm_min, timeInfo->tm_sec);
 	}
-	return logFile.Write(buf.Pointer());
+	AppendToBuffer(buf.Pointer(), buf.strlen());
+	return true;
+}
+
+// Return how many more characters the RAM buffer can hold
+size_t Logger::SpaceInBuffer() const
+{
+	return LogBufferSize - 1 - ((logBufferIn - logBufferOut) % LogBufferSize);
+}
+
+// Append data to the RAM buffer. Caller must have verified that it will fit.
+void Logger::AppendToBuffer(const char *data, size_t len)
+{
+	while (len != 0)
+	{
+		const size_t chunk = min<size_t>(len, LogBufferSize - logBufferIn);
+		memcpy(logBuffer + logBufferIn, data, chunk);
+		logBufferIn = (logBufferIn + chunk) % LogBufferSize;
+		data += chunk;
+		len -= chunk;
+	}
+}
+
+// Write all buffered data to the log file. If a write fails, give up on logging.
+void Logger::DrainBuffer()
+{
+	while (logBufferOut != logBufferIn)
+	{
+		const size_t chunk = (logBufferIn > logBufferOut) ? logBufferIn - logBufferOut : LogBufferSize - logBufferOut;
+		if (!logFile.Write(logBuffer + logBufferOut, chunk))
+		{
+			logFile.Close();
+			logBufferIn = logBufferOut = 0;
+			return;
+		}
+		logBufferOut = (logBufferOut + chunk) % LogBufferSize;
+		dirty = true;
+	}
 }
 
 // End
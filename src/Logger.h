@@ -26,14 +26,25 @@ public:
 	bool IsActive() const { return logFile.IsLive(); }
 
 private:
-	bool WriteDateTime(time_t time);
+	bool AppendDateTime(time_t time);
+	void AppendToBuffer(const char *data, size_t len);
+	size_t SpaceInBuffer() const;
+	void DrainBuffer();
 	void InternalLogMessage(time_t time, const char *message);
 
+	static const size_t LogBufferSize = 512;	// how many characters of log data we buffer in RAM, must be a power of 2; one entry is unused
+
 	FileData logFile;
 	uint32_t lastFlushTime;
 	FilePosition lastFlushFileSize;
 	bool dirty;
 	bool inLogger;
+
+	// Log lines are buffered here and written to the SD card from Flush() when doing so cannot disturb anything
+	// time-critical, so that enabling logging does not add SD write latency to whichever path logged the message.
+	char logBuffer[LogBufferSize];
+	size_t logBufferIn, logBufferOut;			// ring buffer indices; in == out means empty
+	unsigned int droppedLines;					// how many lines we have discarded because the buffer was full
 };
 
 #endif /* SRC_LOGGER_H_ */
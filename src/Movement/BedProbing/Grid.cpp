@@ -9,8 +9,25 @@
 #include "Platform.h"
 #include "RepRap.h"
 #include "Storage/FileStore.h"
+#include "Storage/CRC32.h"
 #include <cmath>
 
+// Header of the binary height map file format. All fields are 4 bytes so there is no padding.
+// The header is followed by numX * numY floats of height data and then the height-set bitmap words.
+struct HeightMapBinaryHeader
+{
+	static constexpr uint32_t Magic = 0x4D485252;				// "RRHM" in little-endian order
+	static constexpr uint32_t Version = 1;						// increase this whenever we change the binary format
+
+	uint32_t magic;
+	uint32_t version;
+	float xMin, xMax, yMin, yMax;
+	float radius;
+	float xSpacing, ySpacing;
+	uint32_t numX, numY;
+	uint32_t crc;												// CRC32 of the height and height-set data that follows
+};
+
 const char * const GridDefinition::HeightMapLabelLines[] =
 {
 	"xmin,xmax,ymin,ymax,radius,spacing,xnum,ynum",				// old version label line
@@ -38,16 +55,37 @@ bool GridDefinition::Set(const float xRange[2], const float yRange[2], float pRa
 	return isValid;
 }
 
+// Set the grid parameters for use as a tiled height map and return true if the result is valid.
+// A tiled map is allowed to be much bigger than a resident one, because only a few tiles of it are held in RAM at a time.
+bool GridDefinition::SetForTiledUse(const float xRange[2], const float yRange[2], float pRadius, const float pSpacings[2])
+{
+	xMin = xRange[0];
+	xMax = xRange[1];
+	yMin = yRange[0];
+	yMax = yRange[1];
+	radius = pRadius;
+	xSpacing = pSpacings[0];
+	ySpacing = pSpacings[1];
+	CheckValidity(MaxTiledGridPointsPerAxis * MaxTiledGridPointsPerAxis, MaxTiledGridPointsPerAxis);
+	return isValid;
+}
+
 // Set up internal variables and check validity of the grid.
 // numX, numY are always set up, but recipXspacing, recipYspacing only if the grid is valid
 void GridDefinition::CheckValidity()
+{
+	CheckValidity(MaxGridProbePoints, MaxXGridPoints);
+}
+
+// As above but checking against the given size limits, which are larger when the grid is to be used as a tiled height map
+void GridDefinition::CheckValidity(size_t maxPoints, size_t maxXpoints)
 {
 	numX = (xMax - xMin >= MinRange && xSpacing >= MinSpacing) ? (uint32_t)((xMax - xMin)/xSpacing) + 1 : 0;
 	numY = (yMax - yMin >= MinRange && ySpacing >= MinSpacing) ? (uint32_t)((yMax - yMin)/ySpacing) + 1 : 0;
 
-	isValid = NumPoints() != 0 && NumPoints() <= MaxGridProbePoints
+	isValid = NumPoints() != 0 && NumPoints() <= maxPoints
 			&& (radius < 0.0 || radius >= 1.0)
-			&& NumXpoints() <= MaxXGridPoints;
+			&& NumXpoints() <= maxXpoints;
 
 	if (isValid)
 	{
@@ -167,21 +205,33 @@ void GridDefinition::PrintError(float originalXrange, float originalYrange, Stri
 // Increase the version number in the following string whenever we change the format of the height map file.
 const char * const HeightMap::HeightMapComment = "RepRapFirmware height map file v2";
 
-HeightMap::HeightMap() : useMap(false) { }
+HeightMap::HeightMap() : useMap(false), cacheValid(false), tileFile(nullptr), tiles(nullptr), tileUseCounter(0), tileErrorReported(false) { }
 
 void HeightMap::SetGrid(const GridDefinition& gd)
 {
 	useMap = false;
 	def = gd;
+	CloseTileFile();				// a new grid supersedes any tiled map we were using
 	ClearGridHeights();
 }
 
+// Stop using the tiled map file, if any
+void HeightMap::CloseTileFile()
+{
+	if (tileFile != nullptr)
+	{
+		tileFile->Close();
+		tileFile = nullptr;
+	}
+}
+
 void HeightMap::ClearGridHeights()
 {
 	for (size_t i = 0; i < ARRAY_SIZE(gridHeightSet); ++i)
 	{
 		gridHeightSet[i] = 0;
 	}
+	InvalidateCache();
 }
 
 // Set the height of a grid point
@@ -192,6 +242,7 @@ void HeightMap::SetGridHeight(size_t xIndex, size_t yIndex, float height)
 	{
 		gridHeights[index] = height;
 		gridHeightSet[index/32] |= 1u << (index & 31u);
+		InvalidateCache();
 	}
 }
 
@@ -211,10 +262,72 @@ unsigned int HeightMap::GetMinimumSegments(float deltaX, float deltaY) const
 // Save the grid to file returning true if an error occurred
 bool HeightMap::SaveToFile(FileStore *f) const
 {
+	uint32_t phase = 0;
+	bool err = false;
+	while (!SaveSliceToFile(f, phase, Platform::GetInterruptClocks(), err))		// a deadline that has already passed writes one slice per call
+	{
+	}
+	return err;
+}
+
+// Save part of the grid to file in CSV format, returning true when the whole grid has been written or an error
+// has occurred, with 'err' set accordingly. Phase 0 writes the header lines and each subsequent phase writes one
+// grid row; at least one phase is written per call, then more follow until the step timer passes 'deadline'.
+// This lets the caller run a long save as a background task instead of stalling one Spin() call for the whole file.
+bool HeightMap::SaveSliceToFile(FileStore *f, uint32_t& phase, uint32_t deadline, bool& err) const
+{
+	if (tileFile != nullptr)
+	{
+		err = true;						// a tiled map is not resident so it cannot be saved, but the file it came from is already on the card
+		return true;
+	}
+
 	char bufferSpace[500];
 	StringRef buf(bufferSpace, ARRAY_SIZE(bufferSpace));
+	do
+	{
+		if (phase == 0)
+		{
+			// Write the header comment
+			float mean, deviation;
+			(void)GetStatistics(mean, deviation);
+			BuildCommentLine(buf, mean, deviation);
+			if (!f->Write(buf.Pointer()))
+			{
+				err = true;
+				return true;
+			}
+
+			// Write the grid parameters
+			def.WriteHeadingAndParameters(buf);
+			if (!f->Write(buf.Pointer()))
+			{
+				err = true;
+				return true;
+			}
+		}
+		else if (phase <= def.numY)
+		{
+			if (WriteRowToFile(f, phase - 1, buf))
+			{
+				err = true;
+				return true;
+			}
+		}
+		else
+		{
+			err = false;
+			return true;
+		}
+		++phase;
+	} while ((int32_t)(deadline - Platform::GetInterruptClocks()) > 0);
+	return false;
+}
 
-	// Write the header comment
+// Build the header comment line. The numeric fields are fixed width so that the line can be written with placeholder
+// values during a streamed save and patched with the real statistics later without changing its length.
+void HeightMap::BuildCommentLine(StringRef& buf, float mean, float deviation) const
+{
 	buf.copy(HeightMapComment);
 	if (reprap.GetPlatform().IsDateTimeSet())
 	{
@@ -223,55 +336,326 @@ bool HeightMap::SaveToFile(FileStore *f) const
 		buf.catf(" generated at %04u-%02u-%02u %02u:%02u",
 						timeInfo->tm_year + 1900, timeInfo->tm_mon, timeInfo->tm_mday, timeInfo->tm_hour, timeInfo->tm_min);
 	}
-	float mean, deviation;
-	(void)GetStatistics(mean, deviation);
-	buf.catf(", mean error %.3f, deviation %.3f\n", (double)mean, (double)deviation);
+	buf.catf(", mean error %7.3f, deviation %7.3f\n", (double)mean, (double)deviation);
+}
+
+// Write one row of grid heights, returning true if an error occurred.
+// We use a fixed field width of 7 characters to make the file easier to view.
+bool HeightMap::WriteRowToFile(FileStore *f, uint32_t row, StringRef& buf) const
+{
+	uint32_t index = row * def.numX;
+	buf.Clear();
+	for (uint32_t j = 0; j < def.numX; ++j)
+	{
+		if (j != 0)
+		{
+			buf.cat(',');
+		}
+		if (IsHeightSet(index))
+		{
+			buf.catf("%7.3f", (double)gridHeights[index]);
+		}
+		else
+		{
+			buf.cat("      0");				// write 0 with no decimal point where we didn't probe, so we can tell when we reload it
+		}
+		++index;
+	}
+	buf.cat('\n');
+	return !f->Write(buf.Pointer());
+}
+
+// Begin saving the grid to file while probing is still in progress. The heights of a row are final as soon as the
+// probe has passed it, so the caller streams completed rows through SaveRows and the file is already almost fully
+// written when probing ends. The statistics are not known yet, so the header is written with placeholder values
+// that FinishStreamedSave patches. Returns true if an error occurred.
+bool HeightMap::StartStreamedSave(FileStore *f)
+{
+	streamedRowsWritten = 0;
+
+	char bufferSpace[500];
+	StringRef buf(bufferSpace, ARRAY_SIZE(bufferSpace));
+	BuildCommentLine(buf, 0.0, 0.0);
+	streamedCommentLength = buf.strlen();
 	if (!f->Write(buf.Pointer()))
 	{
 		return true;
 	}
 
-	// Write the grid parameters
 	def.WriteHeadingAndParameters(buf);
-	if (!f->Write(buf.Pointer()))
+	return !f->Write(buf.Pointer());
+}
+
+// Write any rows below 'rowLimit' that have not been written yet, returning true if an error occurred.
+// Called from the grid probing state machine each time the probe finishes a row.
+bool HeightMap::SaveRows(FileStore *f, size_t rowLimit)
+{
+	char bufferSpace[500];
+	StringRef buf(bufferSpace, ARRAY_SIZE(bufferSpace));
+	while (streamedRowsWritten < rowLimit && streamedRowsWritten < def.numY)
+	{
+		if (WriteRowToFile(f, streamedRowsWritten, buf))
+		{
+			return true;
+		}
+		++streamedRowsWritten;
+	}
+	return false;
+}
+
+// Complete a streamed save by writing any remaining rows and patching the real statistics into the header,
+// returning true if an error occurred. The caller still owns the file and must close it.
+bool HeightMap::FinishStreamedSave(FileStore *f)
+{
+	if (SaveRows(f, def.numY))
 	{
 		return true;
 	}
 
-	// Write the grid heights. We use a fixed field with of 6 characters to make is easier to view.
-	uint32_t index = 0;
-	for (uint32_t i = 0; i < def.numY; ++i)
+	char bufferSpace[500];
+	StringRef buf(bufferSpace, ARRAY_SIZE(bufferSpace));
+	float mean, deviation;
+	(void)GetStatistics(mean, deviation);
+	BuildCommentLine(buf, mean, deviation);
+	if (buf.strlen() != streamedCommentLength)
+	{
+		return false;					// the clock must have been set while we were probing; leave the placeholder rather than corrupt the file
+	}
+
+	if (!f->Flush() || !f->Seek(0))
 	{
-		buf.Clear();
-		for (uint32_t j = 0; j < def.numX; ++j)
+		return true;
+	}
+	return !f->Write(buf.Pointer());
+}
+
+// Save the grid to file in the binary format, returning true if an error occurred.
+// The binary format loads in a couple of block reads instead of a parse of every grid point, which matters
+// when the height map is reloaded at the start of every print. The CSV format is retained for export.
+bool HeightMap::SaveToBinaryFile(FileStore *f) const
+{
+	if (tileFile != nullptr)
+	{
+		return true;					// a tiled map is not resident so it cannot be saved, but the file it came from is already on the card
+	}
+
+	const size_t heightsSize = def.NumPoints() * sizeof(gridHeights[0]);
+	const size_t bitmapSize = ((def.NumPoints() + 31)/32) * sizeof(gridHeightSet[0]);
+
+	CRC32 crc;
+	crc.Reset();
+	crc.Update(reinterpret_cast<const char*>(gridHeights), heightsSize);
+	crc.Update(reinterpret_cast<const char*>(gridHeightSet), bitmapSize);
+
+	HeightMapBinaryHeader header;
+	header.magic = HeightMapBinaryHeader::Magic;
+	header.version = HeightMapBinaryHeader::Version;
+	header.xMin = def.xMin;
+	header.xMax = def.xMax;
+	header.yMin = def.yMin;
+	header.yMax = def.yMax;
+	header.radius = def.radius;
+	header.xSpacing = def.xSpacing;
+	header.ySpacing = def.ySpacing;
+	header.numX = def.numX;
+	header.numY = def.numY;
+	header.crc = crc.Get();
+
+	return !f->Write(reinterpret_cast<const char*>(&header), sizeof(header))
+		|| !f->Write(reinterpret_cast<const char*>(gridHeights), heightsSize)
+		|| !f->Write(reinterpret_cast<const char*>(gridHeightSet), bitmapSize);
+}
+
+// Load the grid from a binary format file positioned at the start, returning true if an error occurred
+bool HeightMap::LoadFromBinaryFile(FileStore *f, StringRef& r)
+{
+	ClearGridHeights();
+
+	HeightMapBinaryHeader header;
+	if (   f->Read(reinterpret_cast<char*>(&header), sizeof(header)) != (int)sizeof(header)
+		|| header.magic != HeightMapBinaryHeader::Magic
+	   )
+	{
+		r.cat("failed to read binary header");
+		return true;
+	}
+	if (header.version != HeightMapBinaryHeader::Version)
+	{
+		r.cat("wrong binary format version");
+		return true;
+	}
+
+	const float xRange[2] = { header.xMin, header.xMax };
+	const float yRange[2] = { header.yMin, header.yMax };
+	const float spacings[2] = { header.xSpacing, header.ySpacing };
+	GridDefinition newGrid;
+	const bool residentOk = newGrid.Set(xRange, yRange, header.radius, spacings);
+	if (   !residentOk
+		&& newGrid.SetForTiledUse(xRange, yRange, header.radius, spacings)
+		&& newGrid.NumXpoints() == header.numX
+		&& newGrid.NumYpoints() == header.numY
+	   )
+	{
+		// The grid is too big to be resident but acceptable as a tiled map, so leave the heights in the file
+		// and read them on demand
+		return LoadTiledFromBinaryFile(f, newGrid, r);
+	}
+	if (   !residentOk
+		|| newGrid.NumXpoints() != header.numX
+		|| newGrid.NumYpoints() != header.numY
+	   )
+	{
+		r.cat("invalid grid");
+		return true;
+	}
+
+	SetGrid(newGrid);
+	const size_t heightsSize = def.NumPoints() * sizeof(gridHeights[0]);
+	const size_t bitmapSize = ((def.NumPoints() + 31)/32) * sizeof(gridHeightSet[0]);
+	if (   f->Read(reinterpret_cast<char*>(gridHeights), heightsSize) != (int)heightsSize
+		|| f->Read(reinterpret_cast<char*>(gridHeightSet), bitmapSize) != (int)bitmapSize
+	   )
+	{
+		r.cat("failed to read grid data");
+		return true;
+	}
+
+	CRC32 crc;
+	crc.Reset();
+	crc.Update(reinterpret_cast<const char*>(gridHeights), heightsSize);
+	crc.Update(reinterpret_cast<const char*>(gridHeightSet), bitmapSize);
+	if (crc.Get() != header.crc)
+	{
+		r.cat("bad checksum");
+		return true;
+	}
+
+	ExtrapolateMissing();
+	return false;
+}
+
+// Start using a map that is too big to be resident, returning true if an error occurred.
+// On success we take ownership of the file and keep it open, and GetPointHeight reads tiles from it on demand.
+// We can't verify the CRC without reading every point, which is what this mode exists to avoid, so a length check
+// has to do; and we can't extrapolate missing points either, so any point that was never probed or filled in reads
+// as zero. Maps this size are produced offline, so we expect them to be complete.
+bool HeightMap::LoadTiledFromBinaryFile(FileStore *f, const GridDefinition& newGrid, StringRef& r)
+{
+	const FilePosition heightsSize = newGrid.NumPoints() * sizeof(float);
+	const FilePosition bitmapSize = ((newGrid.NumPoints() + 31)/32) * sizeof(uint32_t);
+	if (f->Length() != sizeof(HeightMapBinaryHeader) + heightsSize + bitmapSize)
+	{
+		r.cat("wrong file length for grid");
+		return true;
+	}
+
+	if (tiles == nullptr)
+	{
+		// Allocate the tile cache the first time a tiled map is loaded. As with growing the movement queue, this
+		// violates our rule on no dynamic memory allocation after the initialisation phase, but it happens at most
+		// once and only on machines that use tiled maps.
+		tiles = new HeightMapTile[NumHeightMapTiles];
+	}
+
+	SetGrid(newGrid);							// this also closes the previous tiled map file, if any
+	tileFile = f;
+	tileDataOffset = sizeof(HeightMapBinaryHeader);
+	for (size_t i = 0; i < NumHeightMapTiles; ++i)
+	{
+		tiles[i].tileX = tiles[i].tileY = -1;
+		tiles[i].lastUse = 0;
+	}
+	tileUseCounter = 0;
+	tileErrorReported = false;
+	return false;
+}
+
+// Get the height of one grid point, which for a tiled map may mean reading a tile from the file
+float HeightMap::GetPointHeight(uint32_t xIndex, uint32_t yIndex) const
+{
+	if (tileFile == nullptr)
+	{
+		return gridHeights[GetMapIndex(xIndex, yIndex)];
+	}
+
+	const int32_t tileX = (int32_t)(xIndex/HeightMapTileSide);
+	const int32_t tileY = (int32_t)(yIndex/HeightMapTileSide);
+
+	// Look for the tile, keeping track of the least recently used slot in case we don't find it.
+	// There are few enough tiles that a linear search is fine.
+	HeightMapTile *tile = nullptr;
+	HeightMapTile *lru = &tiles[0];
+	for (size_t i = 0; i < NumHeightMapTiles; ++i)
+	{
+		if (tiles[i].tileX == tileX && tiles[i].tileY == tileY)
 		{
-			if (j != 0)
-			{
-				buf.cat(',');
-			}
-			if (IsHeightSet(index))
-			{
-				buf.catf("%7.3f", (double)gridHeights[index]);
-			}
-			else
-			{
-				buf.cat("      0");				// write 0 with no decimal point where we didn't probe, so we can tell when we reload it
-			}
-			++index;
+			tile = &tiles[i];
+			break;
 		}
-		buf.cat('\n');
-		if (!f->Write(buf.Pointer()))
+		if (tiles[i].lastUse < lru->lastUse)
 		{
-			return true;
+			lru = &tiles[i];
 		}
 	}
 
-	return false;
+	if (tile == nullptr)
+	{
+		tile = lru;
+		LoadTile(*tile, tileX, tileY);
+	}
+
+	tile->lastUse = ++tileUseCounter;
+	return tile->heights[((yIndex % HeightMapTileSide) * HeightMapTileSide) + (xIndex % HeightMapTileSide)];
+}
+
+// Read one tile of a tiled map from the file, one row of points at a time because the rows of a tile are not
+// contiguous in the file. A failed read leaves the affected points at zero, because no compensation is better
+// than stale compensation from whatever tile previously occupied the slot.
+void HeightMap::LoadTile(HeightMapTile& tile, int32_t tileX, int32_t tileY) const
+{
+	for (size_t i = 0; i < ARRAY_SIZE(tile.heights); ++i)
+	{
+		tile.heights[i] = 0.0;
+	}
+	tile.tileX = tileX;
+	tile.tileY = tileY;
+
+	const uint32_t firstX = (uint32_t)tileX * HeightMapTileSide;
+	const uint32_t firstY = (uint32_t)tileY * HeightMapTileSide;
+	const uint32_t numCols = min<uint32_t>(HeightMapTileSide, def.numX - firstX);
+	bool ok = true;
+	for (uint32_t row = 0; row < HeightMapTileSide && firstY + row < def.numY && ok; ++row)
+	{
+		const FilePosition where = tileDataOffset + ((((firstY + row) * def.numX) + firstX) * sizeof(float));
+		const int bytesWanted = (int)(numCols * sizeof(float));
+		ok = tileFile->Seek(where)
+			&& tileFile->Read(reinterpret_cast<char*>(&tile.heights[row * HeightMapTileSide]), bytesWanted) == bytesWanted;
+	}
+	if (!ok && !tileErrorReported)
+	{
+		tileErrorReported = true;				// report only the first failure, because we are called from the transform path
+		reprap.GetPlatform().Message(ErrorMessage, "Failed to read a height map tile, affected points read as zero\n");
+	}
 }
 
 // Load the grid from file, returning true if an error occurred with the error reason appended to the buffer
 bool HeightMap::LoadFromFile(FileStore *f, StringRef& r)
 {
+	// A binary format file starts with the magic word; anything else is assumed to be the CSV format
+	uint32_t magic;
+	if (f->Read(reinterpret_cast<char*>(&magic), sizeof(magic)) == (int)sizeof(magic) && magic == HeightMapBinaryHeader::Magic)
+	{
+		if (f->Seek(0))
+		{
+			return LoadFromBinaryFile(f, r);
+		}
+	}
+	if (!f->Seek(0))
+	{
+		r.cat("failed to rewind file");
+		return true;
+	}
+
 	const size_t MaxLineLength = (MaxXGridPoints * 8) + 2;						// maximum length of a line in the height map file, need 8 characters per grid point
 	const char* const readFailureText = "failed to read line from file";
 	char buffer[MaxLineLength + 1];
@@ -397,13 +781,24 @@ float HeightMap::GetInterpolatedHeightError(float x, float y) const
 	const float xLast = def.xMin + (def.numX-1)*def.xSpacing;
 	const float yLast = def.yMin + (def.numY-1)*def.ySpacing;
 
-	// Clamp to rectangle so InterpolateXY will always have valid parameters
+	// Clamp to rectangle so the corner lookups will always have valid parameters
 	const float fEPSILON = 0.01;
 	if (x < def.xMin) { x = def.xMin; }
 	if (y < def.yMin) {	y = def.yMin; }
 	if (x > xLast -fEPSILON) { x = xLast -fEPSILON; }
 	if (y > yLast -fEPSILON) { y = yLast -fEPSILON; }
 
+	// See whether the point is in the same cell as the last one, which is the usual case for segmented moves
+	if (cacheValid && x >= cacheX0 && x < cacheX0 + def.xSpacing && y >= cacheY0 && y < cacheY0 + def.ySpacing)
+	{
+		const float xFrac = (x - cacheX0) * def.recipXspacing;
+		const float yFrac = (y - cacheY0) * def.recipYspacing;
+		const float xyFrac = xFrac * yFrac;
+		return (cacheH00 * (1.0 - xFrac - yFrac + xyFrac))
+				+ (cacheH10 * (xFrac - xyFrac))
+				+ (cacheH01 * (yFrac - xyFrac))
+				+ (cacheH11 * xyFrac);
+	}
 
 	const float xf = (x - def.xMin) * def.recipXspacing;
 	const float xFloor = floor(xf);
@@ -412,21 +807,23 @@ float HeightMap::GetInterpolatedHeightError(float x, float y) const
 	const float yFloor = floor(yf);
 	const int32_t yIndex = (int32_t)yFloor;
 
-	return InterpolateXY(xIndex, yIndex, xf - xFloor, yf - yFloor);
-}
-
-float HeightMap::InterpolateXY(uint32_t xIndex, uint32_t yIndex, float xFrac, float yFrac) const
-{
-	const uint32_t indexX0Y0 = GetMapIndex(xIndex, yIndex);			// (X0,Y0)
-	const uint32_t indexX1Y0 = indexX0Y0 + 1;						// (X1,Y0)
-	const uint32_t indexX0Y1 = indexX0Y0 + def.numX;				// (X0 Y1)
-	const uint32_t indexX1Y1 = indexX0Y1 + 1;						// (X1,Y1)
-
+	// Remember this cell and its corner heights for next time. Going through GetPointHeight here also fetches the
+	// tile of a tiled map, so a tile read is only ever needed when the cell changes.
+	cacheX0 = def.xMin + (xFloor * def.xSpacing);
+	cacheY0 = def.yMin + (yFloor * def.ySpacing);
+	cacheH00 = GetPointHeight(xIndex, yIndex);
+	cacheH10 = GetPointHeight(xIndex + 1, yIndex);
+	cacheH01 = GetPointHeight(xIndex, yIndex + 1);
+	cacheH11 = GetPointHeight(xIndex + 1, yIndex + 1);
+	cacheValid = true;
+
+	const float xFrac = xf - xFloor;
+	const float yFrac = yf - yFloor;
 	const float xyFrac = xFrac * yFrac;
-	return (gridHeights[indexX0Y0] * (1.0 - xFrac - yFrac + xyFrac))
-			+ (gridHeights[indexX1Y0] * (xFrac - xyFrac))
-			+ (gridHeights[indexX0Y1] * (yFrac - xyFrac))
-			+ (gridHeights[indexX1Y1] * xyFrac);
+	return (cacheH00 * (1.0 - xFrac - yFrac + xyFrac))
+			+ (cacheH10 * (xFrac - xyFrac))
+			+ (cacheH01 * (yFrac - xyFrac))
+			+ (cacheH11 * xyFrac);
 }
 
 void HeightMap::ExtrapolateMissing()
@@ -518,6 +915,7 @@ void HeightMap::ExtrapolateMissing()
 			}
 		}
 	}
+	InvalidateCache();
 }
 
 // End
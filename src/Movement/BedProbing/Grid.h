@@ -29,6 +29,7 @@ public:
 	bool IsValid() const { return isValid; }
 
 	bool Set(const float xRange[2], const float yRange[2], float pRadius, const float pSpacings[2]);
+	bool SetForTiledUse(const float xRange[2], const float yRange[2], float pRadius, const float pSpacings[2]);
 	void PrintParameters(StringRef& r) const;
 	void WriteHeadingAndParameters(StringRef& r) const;
 	static int CheckHeading(const StringRef& s);
@@ -39,6 +40,7 @@ public:
 
 private:
 	void CheckValidity();
+	void CheckValidity(size_t maxPoints, size_t maxXpoints);
 
 	static constexpr float MinSpacing = 0.1;						// The minimum point spacing allowed
 	static constexpr float MinRange = 1.0;							// The minimum X and Y range allowed
@@ -68,10 +70,20 @@ public:
 	void ClearGridHeights();										// Clear all grid height corrections
 	void SetGridHeight(size_t xIndex, size_t yIndex, float height);	// Set the height of a grid point
 
-	bool SaveToFile(FileStore *f) const								// Save the grid to file returning true if an error occurred
+	bool SaveToFile(FileStore *f) const								// Save the grid to file in CSV format returning true if an error occurred
 	pre(IsValid());
 
-	bool LoadFromFile(FileStore *f, StringRef& r);					// Load the grid from file returning true if an error occurred
+	bool SaveSliceToFile(FileStore *f, uint32_t& phase, uint32_t deadline, bool& err) const;	// Save part of the grid in CSV format, see Grid.cpp
+
+	bool StartStreamedSave(FileStore *f);							// Write the file header so that rows can be streamed to the file as probing completes them
+	bool SaveRows(FileStore *f, size_t rowLimit);					// Write any rows below 'rowLimit' that have not been written yet
+	bool FinishStreamedSave(FileStore *f);							// Write any remaining rows and patch the real statistics into the header
+
+	bool SaveToBinaryFile(FileStore *f) const						// Save the grid to file in binary format returning true if an error occurred
+	pre(IsValid());
+
+	bool LoadFromFile(FileStore *f, StringRef& r);					// Load the grid from a file in either format returning true if an error occurred
+	bool UsesFile(const FileStore *f) const { return tileFile == f; }	// Return true if this is a tiled map reading its tiles from file 'f'
 
 	unsigned int GetMinimumSegments(float deltaX, float deltaY) const;	// Return the minimum number of segments for a move by this X or Y amount
 
@@ -90,10 +102,47 @@ private:
 	uint32_t gridHeightSet[(MaxGridProbePoints + 31)/32];			// Bitmap of which heights are set
 	bool useMap;													// True to do bed compensation
 
+	// State of a streamed save, used to overlap writing the height map file with the tail of grid probing
+	size_t streamedRowsWritten;										// how many grid rows have been written so far
+	size_t streamedCommentLength;									// the length of the comment line we wrote, so that we can check before patching it
+
+	void BuildCommentLine(StringRef& buf, float mean, float deviation) const;	// Build the header comment line using fixed-width numeric fields
+	bool WriteRowToFile(FileStore *f, uint32_t row, StringRef& buf) const;		// Write one row of grid heights, returning true if an error occurred
+
+	// Locality cache for GetInterpolatedHeightError. Successive transformed points usually fall in the same grid cell,
+	// so we remember the last cell used and its corner heights to avoid most of the divide/floor work in the transform hot path.
+	mutable float cacheX0, cacheY0;									// the coordinates of the lower corner of the cached cell
+	mutable float cacheH00, cacheH10, cacheH01, cacheH11;			// the corner heights of the cached cell
+	mutable bool cacheValid;										// true if the above are valid
+
+	void InvalidateCache() { cacheValid = false; }					// called whenever the grid or its heights change
+
+	// Tiled mode, used when the grid in a binary height map file has more than MaxGridProbePoints points. The heights
+	// stay in the file and are read on demand in square tiles of HeightMapTileSide points each way, with the least
+	// recently used tile being replaced on a miss. The transforms run when moves are added to the ring, well ahead of
+	// execution, so a tile is normally resident long before the moves that need it are executed.
+	struct HeightMapTile
+	{
+		int32_t tileX, tileY;										// which tile of the grid this holds, or -1 if the slot is empty
+		uint32_t lastUse;											// the value of the use counter when this tile was last used
+		float heights[HeightMapTileSide * HeightMapTileSide];
+	};
+
+	FileStore *tileFile;											// the binary file we read tiles from, or nullptr if the whole map is resident
+	FilePosition tileDataOffset;									// where the height data starts in that file
+	mutable HeightMapTile *tiles;									// the resident tiles, allocated the first time a tiled map is loaded
+	mutable uint32_t tileUseCounter;								// incremented whenever a tile is used, for the LRU replacement
+	mutable bool tileErrorReported;									// true if we have already reported a tile read failure for this map
+
+	void CloseTileFile();
+	bool LoadTiledFromBinaryFile(FileStore *f, const GridDefinition& newGrid, StringRef& r);	// Start using a map that is too big to be resident
+	void LoadTile(HeightMapTile& tile, int32_t tileX, int32_t tileY) const;	// Read one tile of a tiled map from the file
+	float GetPointHeight(uint32_t xIndex, uint32_t yIndex) const;	// Get the height of one grid point, fetching a tile if necessary
+
+	bool LoadFromBinaryFile(FileStore *f, StringRef& r);			// Load the grid from a binary format file positioned at the start
+
 	uint32_t GetMapIndex(uint32_t xIndex, uint32_t yIndex) const { return (yIndex * def.NumXpoints()) + xIndex; }
 	bool IsHeightSet(uint32_t index) const { return (gridHeightSet[index/32] & (1 << (index & 31))) != 0; }
-
-	float InterpolateXY(uint32_t xIndex, uint32_t yIndex, float xFrac, float yFrac) const;
 };
 
 #endif /* SRC_MOVEMENT_GRID_H_ */
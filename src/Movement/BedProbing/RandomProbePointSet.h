@@ -29,6 +29,9 @@ public:
 	bool PointWasCorrected(size_t index) const
 	pre(index < numPoints) { return (probePointSet[index] & xyCorrected) != 0; }
 
+	bool XYCoordinatesSet(size_t index) const
+	pre(index < MaxProbePoints) { return (probePointSet[index] & xySet) != 0; }
+
 	size_t NumberOfProbePoints() const;									// Return the number of points probed
 
 	void SetXYBedProbePoint(size_t index, float x, float y);			// Record the X and Y coordinates of a probe point
@@ -10,6 +10,8 @@
 #include "Platform.h"
 #include "Move.h"
 #include "Kinematics/LinearDeltaKinematics.h"		// for DELTA_AXES
+#include "Libraries/Math/Isqrt.h"					// for fastRsqrtf
+#include "EventTrace.h"
 
 #ifdef DUET_NG
 # define DDA_MOVE_DEBUG	(0)
@@ -242,6 +244,8 @@ void DDA::Init()
 #if SUPPORT_IOBITS
 	ioBits = 0;
 #endif
+	fanChangeMask = 0;
+	newFanSpeed = 0.0;
 }
 
 // Set up a real move. Return true if it represents real movement, else false.
@@ -251,14 +255,43 @@ bool DDA::Init(GCodes::RawMove &nextMove, bool doMotorMapping)
 	// 1. Compute the new endpoints and the movement vector
 	const int32_t * const positionNow = prev->DriveCoordinates();
 	const Move& move = reprap.GetMove();
+	const size_t numAxes = reprap.GetGCodes().GetTotalAxes();
 	if (doMotorMapping)
 	{
-		if (!move.CartesianToMotorSteps(nextMove.coords, endPoint, nextMove.isCoordinated))		// transform the axis coordinates if on a delta or CoreXY printer
+		// Check for a move that doesn't change any axis coordinate, e.g. firmware retraction or a pure extruder move.
+		// These are common (twice per travel move when firmware retraction is used), and as long as the previous end
+		// coordinates are valid we can reuse the previous motor endpoints and skip the inverse transform entirely.
+		bool axesMoving = !prev->endCoordinatesValid;
+		if (!axesMoving)
+		{
+			for (size_t axis = 0; axis < numAxes; ++axis)
+			{
+				if (nextMove.coords[axis] != prev->endCoordinates[axis])
+				{
+					axesMoving = true;
+					break;
+				}
+			}
+		}
+
+		if (axesMoving)
 		{
-			return false;												// throw away the move if it couldn't be transformed
+			if (!move.CartesianToMotorSteps(nextMove.coords, endPoint, nextMove.isCoordinated))		// transform the axis coordinates if on a delta or CoreXY printer
+			{
+				return false;											// throw away the move if it couldn't be transformed
+			}
+			isDeltaMovement = move.IsDeltaMode()
+								&& (endPoint[X_AXIS] != positionNow[X_AXIS] || endPoint[Y_AXIS] != positionNow[Y_AXIS] || endPoint[Z_AXIS] != positionNow[Z_AXIS]);
+		}
+		else
+		{
+			// No axis is moving, so the axis motors stay where they are, even on a delta or CoreXY machine
+			for (size_t axis = 0; axis < numAxes; ++axis)
+			{
+				endPoint[axis] = positionNow[axis];
+			}
+			isDeltaMovement = false;
 		}
-		isDeltaMovement = move.IsDeltaMode()
-							&& (endPoint[X_AXIS] != positionNow[X_AXIS] || endPoint[Y_AXIS] != positionNow[Y_AXIS] || endPoint[Z_AXIS] != positionNow[Z_AXIS]);
 	}
 	else
 	{
@@ -270,8 +303,15 @@ bool DDA::Init(GCodes::RawMove &nextMove, bool doMotorMapping)
 	bool realMove = false;
 	float accelerations[DRIVES];
 	const float * const normalAccelerations = reprap.GetPlatform().Accelerations();
-	const size_t numAxes = reprap.GetGCodes().GetTotalAxes();
-	for (size_t drive = 0; drive < DRIVES; drive++)
+	const size_t numTotalDrives = numAxes + reprap.GetGCodes().GetNumExtruders();	// drives above this are not in use, so don't waste time transforming them
+	for (size_t drive = numTotalDrives; drive < DRIVES; drive++)
+	{
+		accelerations[drive] = normalAccelerations[drive];		// the vector box intersection still looks at all DRIVES entries
+		endPoint[drive] = 0;
+		endCoordinates[drive] = 0.0;
+		directionVector[drive] = 0.0;
+	}
+	for (size_t drive = 0; drive < numTotalDrives; drive++)
 	{
 		accelerations[drive] = normalAccelerations[drive];
 		if (drive >= numAxes || !doMotorMapping)
@@ -355,6 +395,22 @@ bool DDA::Init(GCodes::RawMove &nextMove, bool doMotorMapping)
 		}
 	}
 
+	// 2b. Record how many DMs this move has taken from the pool, to help with tuning the pool size (NumDms)
+	{
+		uint32_t numDms = 0;
+		for (size_t drive = 0; drive < DRIVES; ++drive)
+		{
+			if (pddm[drive] != nullptr)
+			{
+				++numDms;
+			}
+		}
+		if (numDms > maxDmsPerMove)
+		{
+			maxDmsPerMove = numDms;
+		}
+	}
+
 	// 3. Store some values
 	xAxes = nextMove.xAxes;
 	yAxes = nextMove.yAxes;
@@ -374,6 +430,8 @@ bool DDA::Init(GCodes::RawMove &nextMove, bool doMotorMapping)
 #if SUPPORT_IOBITS
 	ioBits = nextMove.ioBits;
 #endif
+	fanChangeMask = nextMove.fanChangeMask;
+	newFanSpeed = nextMove.newFanSpeed;
 
 	// If it's a Z probing move, limit the Z acceleration to better handle nozzle-contact probes
 	if ((endStopsToCheck & ZProbeActive) != 0 && accelerations[Z_AXIS] > ZProbeMaxAcceleration)
@@ -442,6 +500,18 @@ bool DDA::Init(GCodes::RawMove &nextMove, bool doMotorMapping)
 	// speed lower than the 0.5mm/sec minimum. We must apply the minimum speed first and then limit it if necessary after that.
 	requestedSpeed = min<float>(max<float>(reqSpeed, 0.5), VectorBoxIntersection(normalisedDirectionVector, reprap.GetPlatform().MaxFeedrates(), DRIVES));
 
+	// Limit the speed again so that no drive is asked to step faster than the step interrupt can sustain.
+	// Drives using coarse microstepping with hardware interpolation keep full smoothness at these rates, whereas drives
+	// configured for fine microstepping have their speed limited here instead of overloading the step interrupt.
+	{
+		float stepRateSpeedLimits[DRIVES];
+		for (size_t drive = 0; drive < DRIVES; ++drive)
+		{
+			stepRateSpeedLimits[drive] = (float)MaxStepsPerSecond/reprap.GetPlatform().DriveStepsPerUnit(drive);
+		}
+		requestedSpeed = min<float>(requestedSpeed, VectorBoxIntersection(normalisedDirectionVector, stepRateSpeedLimits, DRIVES));
+	}
+
 	// On a Cartesian printer, it is OK to limit the X and Y speeds and accelerations independently, and in consequence to allow greater values
 	// for diagonal moves. On a delta, this is not OK and any movement in the XY plane should be limited to the X/Y axis values, which we assume to be equal.
 	if (doMotorMapping)
@@ -467,6 +537,10 @@ bool DDA::Init(GCodes::RawMove &nextMove, bool doMotorMapping)
 	}
 
 	RecalculateMove();
+	speedScalePending = 1.0;
+#if DDA_TIME_PHASES
+	whenInitialised = Platform::GetInterruptClocks();
+#endif
 	state = provisional;
 	return true;
 }
@@ -529,6 +603,8 @@ bool DDA::Init(const float_t adjustments[DRIVES])
 #if SUPPORT_IOBITS
 	ioBits = prev->ioBits;
 #endif
+	fanChangeMask = 0;							// leadscrew adjustment moves carry no fan speed change
+	newFanSpeed = 0.0;
 
 	// 4. Normalise the direction vector and compute the amount of motion.
 	// Currently we normalise the vector sum of all Z motor movement to unit length.
@@ -547,6 +623,10 @@ bool DDA::Init(const float_t adjustments[DRIVES])
 	startSpeed = endSpeed = 0.0;
 
 	RecalculateMove();
+	speedScalePending = 1.0;
+#if DDA_TIME_PHASES
+	whenInitialised = Platform::GetInterruptClocks();
+#endif
 	state = provisional;
 	return true;
 }
@@ -588,9 +668,11 @@ pre(state == provisional)
 //	if (reprap.Debug(moduleDda)) debugPrintf("Adjusting, %f\n", laDDA->targetNextSpeed);
 	unsigned int laDepth = 0;
 	bool goingUp = true;
+	bool startSpeedChanged = false;
 
 	for(;;)					// this loop is used to nest lookahead without making recursive calls
 	{
+		++laDdasExamined;
 		if (goingUp)
 		{
 			// We have been asked to adjust the end speed of this move to match the next move starting at targetNextSpeed
@@ -645,6 +727,7 @@ pre(state == provisional)
 		{
 			// Going back down the list
 			// We have adjusted the end speed of the previous move as much as is possible. Adjust this move to match it.
+			startSpeedChanged = (laDDA->prev->endSpeed != laDDA->startSpeed);
 			laDDA->startSpeed = laDDA->prev->endSpeed;
 			const float maxEndSpeed = sqrtf(fsquare(laDDA->startSpeed) + (2 * laDDA->acceleration * laDDA->totalDistance));
 			if (maxEndSpeed < laDDA->targetNextSpeed)
@@ -665,10 +748,16 @@ pre(state == provisional)
 		}
 		else
 		{
-			// Either just stopped going up, or going down
-			laDDA->endSpeed = laDDA->targetNextSpeed;
+			// Either just stopped going up, or going down.
+			// If neither the start speed nor the end speed changed then there is nothing to recalculate,
+			// which is the usual case when lookahead has already converged on the earlier moves in the queue.
+			if (laDDA->targetNextSpeed != laDDA->endSpeed || startSpeedChanged)
+			{
+				laDDA->endSpeed = laDDA->targetNextSpeed;
 LA_DEBUG;
-			laDDA->RecalculateMove();
+				laDDA->RecalculateMove();
+				++laDdasRecalculated;
+			}
 
 			if (laDepth == 0)
 			{
@@ -682,120 +771,141 @@ LA_DEBUG;
 	}
 }
 
-// Try to push babystepping earlier in the move queue, returning the amount we pushed
-float DDA::AdvanceBabyStepping(float amount)
+// Adjust the net Z movement of a drive movement by the specified number of steps
+/*static*/ void DDA::AdjustDmSteps(DriveMovement *pdm, int32_t steps)
 {
-	DDA *cdda = this;
-	while (cdda->prev->state == DDAState::provisional)
-	{
-		cdda = cdda->prev;
-	}
-
-	// cdda addresses the earliest un-prepared move, which is the first one we can apply babystepping to
-	// Allow babystepping Z speed up to 10% of the move top speed or up to half the Z jerk rate, whichever is lower
-	float babySteppingDone = 0.0;
-	while(cdda != this)
+	if (pdm != nullptr)
 	{
-		float babySteppingToDo = 0.0;
-		if (amount != 0.0 && cdda->xyMoving)
+		if (pdm->state == DMState::moving)
 		{
-			// If not on a delta printer, check that we have a DM for the Z axis
-			bool ok = (cdda->isDeltaMovement || cdda->pddm[Z_AXIS] != nullptr);
-			if (!ok)
+			if (pdm->direction)		// if moving up
 			{
-				cdda->pddm[Z_AXIS] = DriveMovement::Allocate(Z_AXIS, DMState::idle);
-				ok = (cdda->pddm[Z_AXIS] != nullptr);
+				steps += (int32_t)pdm->totalSteps;
 			}
+			else
+			{
+				steps -= (int32_t)pdm->totalSteps;
+			}
+		}
+		else
+		{
+			pdm->state = DMState::moving;
+		}
+		if (steps >= 0)
+		{
+			pdm->direction = true;
+			pdm->totalSteps = (uint32_t)steps;
+		}
+		else
+		{
+			pdm->direction = false;
+			pdm->totalSteps = (uint32_t)(-steps);
+		}
+	}
+}
 
-			if (ok)
+// Fold outstanding babystepping into this move, which has just been initialised and has not yet been seen by the lookahead.
+// The endpoint of this move already allows for the whole of 'amount', because the GCodes Z transform includes the full
+// babystepping offset as soon as M290 is processed. So we let a bounded portion of it stand and take the remainder out of
+// the move again, returning the portion that this move will realise. Applying babystepping here replaces the old scheme of
+// walking the whole ring of provisional moves at M290 time, which disturbed the step timing when the ring was full.
+float DDA::ApplyBabyStepping(float amount)
+{
+	float amountToDo = 0.0;
+	if (xyMoving)
+	{
+		// Limit the babystepping Z speed to the lower of 0.1 times the original XYZ speed and 0.5 times the Z jerk
+		const float maxBabySteppingAmount = totalDistance * min<float>(0.1, 0.5 * reprap.GetPlatform().ConfiguredInstantDv(Z_AXIS)/topSpeed);
+		amountToDo = constrain<float>(amount, -maxBabySteppingAmount, maxBabySteppingAmount);
+	}
+	else
+	{
+		// See whether this move has any movement other than in Z. If it doesn't then it is either a commanded Z move or a
+		// move that exists only because of the babystepping offset, so let it do all of the outstanding babystepping as an
+		// ordinary jerk-limited Z move.
+		bool otherMovement = false;
+		for (size_t drive = 0; drive < DRIVES; ++drive)
+		{
+			if (drive != Z_AXIS && directionVector[drive] != 0.0)
 			{
-				// Limit the babystepping Z speed to the lower of 0.1 times the original XYZ speed and 0.5 times the Z jerk
-				const float maxBabySteppingAmount = cdda->totalDistance * min<float>(0.1, 0.5 * reprap.GetPlatform().ConfiguredInstantDv(Z_AXIS)/cdda->topSpeed);
-				babySteppingToDo = constrain<float>(amount, -maxBabySteppingAmount, maxBabySteppingAmount);
-				cdda->directionVector[Z_AXIS] += babySteppingToDo/cdda->totalDistance;
-				cdda->totalDistance *= cdda->NormaliseXYZ();
-				cdda->RecalculateMove();
-				babySteppingDone += babySteppingToDo;
-				amount -= babySteppingToDo;
+				otherMovement = true;
+				break;
 			}
 		}
+		if (!otherMovement)
+		{
+			return amount;
+		}
+	}
 
-		// Even if there is no babystepping to do this move, we may need to adjust the end coordinates
-		cdda->endCoordinates[Z_AXIS] += babySteppingDone;
-		if (cdda->isDeltaMovement)
+	const float adjustment = amountToDo - amount;			// the amount of phantom Z movement we need to take out of this move
+	if (adjustment != 0.0)
+	{
+		directionVector[Z_AXIS] += adjustment/totalDistance;
+		totalDistance *= NormaliseXYZ();
+		RecalculateMove();
+		endCoordinates[Z_AXIS] += adjustment;
+		if (isDeltaMovement)
 		{
 			for (size_t tower = 0; tower < DELTA_AXES; ++tower)
 			{
-				cdda->endPoint[tower] += (int32_t)(babySteppingDone * reprap.GetPlatform().DriveStepsPerUnit(tower));
-				if (babySteppingToDo != 0.0)
-				{
-					int32_t steps = (int32_t)(babySteppingToDo * reprap.GetPlatform().DriveStepsPerUnit(tower));
-					DriveMovement* const pdm = cdda->pddm[tower];
-					if (pdm != nullptr)
-					{
-						if (pdm->direction)		// if moving up
-						{
-							steps += (int32_t)pdm->totalSteps;
-						}
-						else
-						{
-							steps -= (int32_t)pdm->totalSteps;
-						}
-						if (steps >= 0)
-						{
-							pdm->direction = true;
-							pdm->totalSteps = (uint32_t)steps;
-						}
-						else
-						{
-							pdm->direction = false;
-							pdm->totalSteps = (uint32_t)(-steps);
-						}
-					}
-				}
+				const int32_t steps = (int32_t)(adjustment * reprap.GetPlatform().DriveStepsPerUnit(tower));
+				endPoint[tower] += steps;
+				AdjustDmSteps(pddm[tower], steps);			// the towers all have DMs because this is a delta movement
 			}
 		}
 		else
 		{
-			cdda->endPoint[Z_AXIS] += (int32_t)(babySteppingDone * reprap.GetPlatform().DriveStepsPerUnit(Z_AXIS));
-			if (babySteppingToDo != 0.0)
+			const int32_t steps = (int32_t)(adjustment * reprap.GetPlatform().DriveStepsPerUnit(Z_AXIS));
+			endPoint[Z_AXIS] += steps;
+			if (pddm[Z_AXIS] == nullptr)					// we may have no Z DM if the net Z movement rounded to no steps
 			{
-				int32_t steps = (int32_t)(babySteppingToDo * reprap.GetPlatform().DriveStepsPerUnit(Z_AXIS));
-				DriveMovement* const pdm = cdda->pddm[Z_AXIS];			// must be non-null because we allocated one earlier if necessary
-				if (pdm->state == DMState::moving)
-				{
-					if (pdm->direction)		// if moving up
-					{
-						steps += (int32_t)pdm->totalSteps;
-					}
-					else
-					{
-						steps -= (int32_t)pdm->totalSteps;
-					}
-				}
-				else
-				{
-					pdm->state = DMState::moving;
-				}
-
-				if (steps >= 0)
-				{
-					pdm->direction = true;
-					pdm->totalSteps = (uint32_t)steps;
-				}
-				else
-				{
-					pdm->direction = false;
-					pdm->totalSteps = (uint32_t)(-steps);
-				}
+				pddm[Z_AXIS] = DriveMovement::Allocate(Z_AXIS, DMState::idle);
 			}
+			AdjustDmSteps(pddm[Z_AXIS], steps);
 		}
+	}
+	return amountToDo;
+}
+
+// Apply a pending M220 speed factor change to this move. This is called just before the move is prepared, so the moves
+// ahead of it in the ring have already been prepared and their speeds are final. Rescaling here means the new factor takes
+// effect within the prepared-move horizon (a fraction of a second) instead of waiting for the whole ring to drain, and the
+// recalculation cost is spread over the normal move preparation calls instead of re-planning the entire ring in one go.
+void DDA::ApplySpeedScale(float factor)
+{
+	if (prev->state == frozen)
+	{
+		// The previous move was rescaled when it was prepared, so pick up its adjusted end speed to keep the junction continuous.
+		// If it is already executing or completed then it was prepared before the factor changed and our start speed is correct as it is.
+		startSpeed = prev->endSpeed;
+	}
 
-		// Now do the next move
-		cdda = cdda->next;
+	// Scale the requested speed, but keep it within the configured axis speed limits and the step rate limit in case the factor increased
+	{
+		float speedLimits[DRIVES];
+		for (size_t drive = 0; drive < DRIVES; ++drive)
+		{
+			speedLimits[drive] = min<float>(reprap.GetPlatform().MaxFeedrate(drive), (float)MaxStepsPerSecond/reprap.GetPlatform().DriveStepsPerUnit(drive));
+		}
+		requestedSpeed = min<float>(requestedSpeed * factor, VectorBoxIntersection(directionVector, speedLimits, DRIVES));
+	}
+
+	// Scale the end speed too. The next move will be rescaled the same way when it is prepared, so the junction speeds stay
+	// matched; but we must keep the end speed reachable from the start speed within this move's distance and acceleration.
+	const float twoAd = 2.0 * acceleration * totalDistance;
+	float newEndSpeedSquared = fsquare(endSpeed * factor);
+	if (newEndSpeedSquared > fsquare(startSpeed) + twoAd)
+	{
+		newEndSpeedSquared = fsquare(startSpeed) + twoAd;					// can't accelerate to the scaled end speed in this move
 	}
+	else if (newEndSpeedSquared < fsquare(startSpeed) - twoAd)
+	{
+		newEndSpeedSquared = fsquare(startSpeed) - twoAd;					// can't brake to the scaled end speed in this move
+	}
+	endSpeed = sqrtf(newEndSpeedSquared);
 
-	return babySteppingDone;
+	RecalculateMove();
 }
 
 // Recalculate the top speed, acceleration distance and deceleration distance, and whether we can pause after this move
@@ -981,6 +1091,15 @@ pre(disableDeltaMapping || drive < MaxAxes)
 // This must not be called with interrupts disabled, because it calls Platform::EnableDrive.
 void DDA::Prepare(uint8_t simMode)
 {
+	if (speedScalePending != 1.0)
+	{
+		if (!isLeadscrewAdjustmentMove)
+		{
+			ApplySpeedScale(speedScalePending);
+		}
+		speedScalePending = 1.0;
+	}
+
 	PrepParams params;
 	params.decelStartDistance = totalDistance - decelDistance;
 
@@ -1010,6 +1129,71 @@ void DDA::Prepare(uint8_t simMode)
 		extraAccelerationClocks = roundS32((accelStopTime - (accelDistance/topSpeed)) * stepClockRate);
 		params.compFactor = (topSpeed - startSpeed)/topSpeed;
 
+#if SUPPORT_SCURVE
+		// We can't use the sub-phase ramps on delta towers (the tower step calculation assumes a trapezoid in Cartesian space),
+		// on moves that may be retimed by an endstop or Z probe, or on moves using pressure advance.
+		useSCurve = (sCurveEnabled || shaperHalfPeriod > 0.0) && !isDeltaMovement && endStopsToCheck == 0 && !usePressureAdvance;
+		if (useSCurve)
+		{
+			// Replace each constant-acceleration ramp by three sub-phases with accelerations g, 2g, g and symmetric durations,
+			// which leaves the total time, distance and speed change of the ramp unchanged, so the lookahead and the steady phase
+			// parameters are unaffected. If input shaping is configured (M596) and the ramp is long enough, the outer sub-phases
+			// last half the resonant period, which makes the ramp the exact ZV convolution of a steeper ramp with two
+			// half-amplitude impulses and so cancels ringing at the shaper frequency. Otherwise the outer sub-phases last a
+			// quarter of the ramp time, which reduces the acceleration step at each end of the ramp, where it excites ringing
+			// worst, by a third. Each sub-phase uses the same closed form as a plain ramp, so the cost per step in the ISR stays
+			// the same.
+			{
+				const float rampTime = (topSpeed - startSpeed)/acceleration;				// in seconds
+				const float outerTime = (shaperHalfPeriod > 0.0 && rampTime >= 2.5 * shaperHalfPeriod)
+											? shaperHalfPeriod
+												: rampTime * 0.25;
+				const float g = (rampTime > 0.0)
+									? (topSpeed - startSpeed)/(2.0 * (rampTime - outerTime))
+										: acceleration;										// the value doesn't matter when there is no acceleration phase, but it must be finite
+				const float subAcc[3] = { g, 2.0f * g, g };
+				const float subDur[3] = { outerTime, rampTime - (2.0f * outerTime), outerTime };
+				params.accelMidAcc = 2.0 * g;
+				float v = startSpeed, d = 0.0, t = 0.0;
+				for (size_t i = 0; i < 3; ++i)
+				{
+					const float vCdivA = (v * stepClockRate)/subAcc[i];
+					scurve.accelB[i] = roundS32((t * stepClockRate) - vCdivA);
+					scurve.accelK[i] = roundS64(((double)vCdivA * vCdivA) - ((double)(stepClockRateSquared * 2) * d)/subAcc[i]);
+					d += (v + (0.5 * subAcc[i] * subDur[i])) * subDur[i];
+					v += subAcc[i] * subDur[i];
+					t += subDur[i];
+					if (i == 0) { params.accelSubDist1 = d; }
+					else if (i == 1) { params.accelSubDist2 = d; }
+				}
+			}
+			{
+				const float rampTime = (topSpeed - endSpeed)/acceleration;					// in seconds
+				const float outerTime = (shaperHalfPeriod > 0.0 && rampTime >= 2.5 * shaperHalfPeriod)
+											? shaperHalfPeriod
+												: rampTime * 0.25;
+				const float g = (rampTime > 0.0)
+									? (topSpeed - endSpeed)/(2.0 * (rampTime - outerTime))
+										: acceleration;
+				const float subAcc[3] = { g, 2.0f * g, g };
+				const float subDur[3] = { outerTime, rampTime - (2.0f * outerTime), outerTime };
+				params.decelMidAcc = 2.0 * g;
+				float v = topSpeed, d = params.decelStartDistance, t = decelStartTime;
+				for (size_t i = 0; i < 3; ++i)
+				{
+					const float vCdivA = (v * stepClockRate)/subAcc[i];
+					scurve.decelB[i] = roundU32((t * stepClockRate) + vCdivA);
+					scurve.decelK[i] = roundU64(((double)vCdivA * vCdivA) + ((double)(stepClockRateSquared * 2) * d)/subAcc[i]);
+					d += (v - (0.5 * subAcc[i] * subDur[i])) * subDur[i];
+					v -= subAcc[i] * subDur[i];
+					t += subDur[i];
+					if (i == 0) { params.decelSubDist1 = d; }
+					else if (i == 1) { params.decelSubDist2 = d; }
+				}
+			}
+		}
+#endif
+
 		firstDM = nullptr;
 
 		const size_t numAxes = reprap.GetGCodes().GetTotalAxes();
@@ -1075,6 +1259,14 @@ void DDA::Prepare(uint8_t simMode)
 				pdm->nextStepTime = 0;
 				pdm->stepInterval = 999999;							// initialise to a large value so that we will calculate the time for just one step
 				pdm->stepsTillRecalc = 0;							// so that we don't skip the calculation
+				pdm->stepTimeBufferStart = 0;						// no precomputed step times yet
+				pdm->stepTimeBufferEnd = 0;
+				if (!(isDeltaMovement && drive < numAxes) && endStopsToCheck == 0)
+				{
+					// Precompute step times outside the ISR. We mustn't do this if the move may be cut short by an endstop or Z probe,
+					// because ReduceHomingSpeed changes the timing parameters while the move is being executed.
+					pdm->PrecomputeStepTimes(*this);
+				}
 				const bool stepsToDo = (isDeltaMovement && drive < numAxes)
 										? pdm->CalcNextStepTimeDelta(*this, false)
 										: pdm->CalcNextStepTimeCartesian(*this, false);
@@ -1089,6 +1281,18 @@ void DDA::Prepare(uint8_t simMode)
 			}
 		}
 
+#if SUPPORT_IOBITS
+		// Precompute the parallel port write for this move's port state, so that the step ISR can apply it with a
+		// single store per PIO controller. Also work out whether the switch to the next move's port state falls
+		// inside this move because of the configured advance time.
+		{
+			PortControl& pc = reprap.GetPortControl();
+			pc.PreparePortWrite(ioBits, portWrite);
+			const uint32_t advance = pc.GetAdvanceClocks();
+			ioBitsSwitchTime = (advance != 0 && advance < clocksNeeded) ? clocksNeeded - advance : clocksNeeded;
+		}
+#endif
+
 		if (reprap.Debug(moduleDda) && reprap.Debug(moduleMove))		// temp show the prepared DDA if debug enabled for both modules
 		{
 			DebugPrintAll();
@@ -1110,9 +1314,32 @@ void DDA::Prepare(uint8_t simMode)
 #endif
 	}
 
+#if DDA_TIME_PHASES
+	whenFrozen = Platform::GetInterruptClocks();
+#endif
+	__DMB();						// make sure that all the move data is written to memory before the ISR can see the new state
 	state = frozen;					// must do this last so that the ISR doesn't start executing it before we have finished setting it up
 }
 
+// Refill the precomputed step time buffers of this move. Called from Move::Spin while the move is being executed, so that drives
+// with many steps in the acceleration and deceleration ramps (in particular extruders using pressure advance) rarely need the
+// 64-bit square root in the step ISR. The same restrictions apply as when the buffers are first filled by Prepare.
+void DDA::TopUpStepTimes()
+{
+	if (endStopsToCheck == 0)
+	{
+		const size_t numAxes = reprap.GetGCodes().GetTotalAxes();
+		for (size_t drive = 0; drive < DRIVES; ++drive)
+		{
+			DriveMovement * const pdm = pddm[drive];
+			if (pdm != nullptr && pdm->state == DMState::moving && !(isDeltaMovement && drive < numAxes))
+			{
+				pdm->TopUpStepTimes(*this);
+			}
+		}
+	}
+}
+
 // Take a unit positive-hyperquadrant vector, and return the factor needed to obtain
 // length of the vector as projected to touch box[].
 /*static*/ float DDA::VectorBoxIntersection(const float v[], const float box[], size_t dimensions)
@@ -1137,13 +1364,19 @@ void DDA::Prepare(uint8_t simMode)
 // Normalise a vector with dim1 dimensions so that it is unit in the first dim2 dimensions, and also return its previous magnitude in dim2 dimensions
 /*static*/ float DDA::Normalise(float v[], size_t dim1, size_t dim2)
 {
-	const float magnitude = Magnitude(v, dim2);
-	if (magnitude <= 0.0)
+	float magSquared = 0.0;
+	for (size_t d = 0; d < dim2; d++)
+	{
+		magSquared += fsquare(v[d]);
+	}
+	if (magSquared <= 0.0)
 	{
 		return 0.0;
 	}
-	Scale(v, 1.0/magnitude, dim1);
-	return magnitude;
+	// Scale by the reciprocal square root so that we do no float division, which is slow on processors without a FPU
+	const float invMagnitude = fastRsqrtf(magSquared);
+	Scale(v, invMagnitude, dim1);
+	return magSquared * invMagnitude;
 }
 
 // Make the direction vector unit-normal in XYZ and return the previous magnitude
@@ -1152,18 +1385,15 @@ float DDA::NormaliseXYZ()
 	// First calculate the magnitude of the vector. If there is more than one X or Y axis, take an average of their movements (they should be equal).
 	float xMagSquared = 0.0, yMagSquared = 0.0;
 	unsigned int numXaxes = 0, numYaxes = 0;
-	for (size_t d = 0; d < MaxAxes; ++d)
+	for (AxesBitmap bits = xAxes; bits != 0; )
 	{
-		if (IsBitSet(xAxes, d))
-		{
-			xMagSquared += fsquare(directionVector[d]);
-			++numXaxes;
-		}
-		if (IsBitSet(yAxes, d))
-		{
-			yMagSquared += fsquare(directionVector[d]);
-			++numYaxes;
-		}
+		xMagSquared += fsquare(directionVector[TakeLowestSetBit(bits)]);
+		++numXaxes;
+	}
+	for (AxesBitmap bits = yAxes; bits != 0; )
+	{
+		yMagSquared += fsquare(directionVector[TakeLowestSetBit(bits)]);
+		++numYaxes;
 	}
 	if (numXaxes > 1)
 	{
@@ -1173,15 +1403,16 @@ float DDA::NormaliseXYZ()
 	{
 		yMagSquared /= numYaxes;
 	}
-	const float magnitude = sqrtf(xMagSquared + yMagSquared + fsquare(directionVector[Z_AXIS]));
-	if (magnitude <= 0.0)
+	const float magSquared = xMagSquared + yMagSquared + fsquare(directionVector[Z_AXIS]);
+	if (magSquared <= 0.0)
 	{
 		return 0.0;
 	}
 
-	// Now normalise it
-	Scale(directionVector, 1.0/magnitude, DRIVES);
-	return magnitude;
+	// Now normalise it, using the reciprocal square root to avoid a float division
+	const float invMagnitude = fastRsqrtf(magSquared);
+	Scale(directionVector, invMagnitude, DRIVES);
+	return magSquared * invMagnitude;
 }
 
 // Return the magnitude of a vector
@@ -1264,50 +1495,48 @@ void DDA::CheckEndstops(Platform& platform)
 #endif
 
 	const size_t numAxes = reprap.GetGCodes().GetTotalAxes();
-	for (size_t drive = 0; drive < numAxes; ++drive)
+	for (AxesBitmap axesToCheck = endStopsToCheck & LowestNBits<AxesBitmap>(numAxes); axesToCheck != 0; )
 	{
-		if (IsBitSet(endStopsToCheck, drive))
+		const size_t drive = TakeLowestSetBit(axesToCheck);
+		const EndStopHit esh = platform.Stopped(drive);
+		switch (esh)
 		{
-			const EndStopHit esh = platform.Stopped(drive);
-			switch (esh)
+		case EndStopHit::lowHit:
+		case EndStopHit::highHit:
+			if ((endStopsToCheck & UseSpecialEndstop) != 0)			// use only one (probably non-default) endstop while probing a tool offset
+			{
+				MoveAborted();
+			}
+			else
 			{
-			case EndStopHit::lowHit:
-			case EndStopHit::highHit:
-				if ((endStopsToCheck & UseSpecialEndstop) != 0)		// use only one (probably non-default) endstop while probing a tool offset
+				ClearBit(endStopsToCheck, drive);					// clear this check so that we can check for more
+				const Kinematics& kin = reprap.GetMove().GetKinematics();
+				if (endStopsToCheck == 0 || kin.QueryTerminateHomingMove(drive))
 				{
-					MoveAborted();
+					MoveAborted();									// no more endstops to check, or this axis uses shared motors, so stop the entire move
 				}
 				else
 				{
-					ClearBit(endStopsToCheck, drive);					// clear this check so that we can check for more
-					const Kinematics& kin = reprap.GetMove().GetKinematics();
-					if (endStopsToCheck == 0 || kin.QueryTerminateHomingMove(drive))
-					{
-						MoveAborted();									// no more endstops to check, or this axis uses shared motors, so stop the entire move
-					}
-					else
-					{
-						StopDrive(drive);								// we must stop the drive before we mess with its coordinates
-					}
-					if (drive < reprap.GetGCodes().GetTotalAxes() && IsHomingAxes())
-					{
-						kin.OnHomingSwitchTriggered(drive, esh == EndStopHit::highHit, reprap.GetPlatform().GetDriveStepsPerUnit(), *this);
-						reprap.GetGCodes().SetAxisIsHomed(drive);
-					}
+					StopDrive(drive);								// we must stop the drive before we mess with its coordinates
 				}
-				break;
-
-			case EndStopHit::nearStop:
-				// Only reduce homing speed if there are no more axes to be homed. This allows us to home X and Y simultaneously.
-				if (endStopsToCheck == MakeBitmap<AxesBitmap>(drive))
+				if (drive < reprap.GetGCodes().GetTotalAxes() && IsHomingAxes())
 				{
-					ReduceHomingSpeed();
+					kin.OnHomingSwitchTriggered(drive, esh == EndStopHit::highHit, reprap.GetPlatform().GetDriveStepsPerUnit(), *this);
+					reprap.GetGCodes().SetAxisIsHomed(drive);
 				}
-				break;
+			}
+			break;
 
-			default:
-				break;
+		case EndStopHit::nearStop:
+			// Only reduce homing speed if there are no more axes to be homed. This allows us to home X and Y simultaneously.
+			if (endStopsToCheck == MakeBitmap<AxesBitmap>(drive))
+			{
+				ReduceHomingSpeed();
 			}
+			break;
+
+		default:
+			break;
 		}
 	}
 }
@@ -1322,6 +1551,38 @@ pre(state == frozen)
 {
 	moveStartTime = tim;
 	state = executing;
+	EventTrace::Record(EventTrace::EventType::ddaStart, 0, (uint16_t)min<uint32_t>(clocksNeeded/(stepClockRate/1000u), 0xFFFF));
+
+#if DDA_TIME_PHASES
+	// Accumulate how long this move spent in each phase of the pipeline
+	const uint32_t prepareClocks = whenFrozen - whenInitialised;
+	const uint32_t queuedClocks = moveStartTime - whenFrozen;
+	if (prepareClocks < minPrepareClocks) { minPrepareClocks = prepareClocks; }
+	if (prepareClocks > maxPrepareClocks) { maxPrepareClocks = prepareClocks; }
+	totalPrepareClocks += prepareClocks;
+	if (queuedClocks < minQueuedClocks) { minQueuedClocks = queuedClocks; }
+	if (queuedClocks > maxQueuedClocks) { maxQueuedClocks = queuedClocks; }
+	totalQueuedClocks += queuedClocks;
+	++numPhaseTimedMoves;
+#endif
+
+	if (endStopsToCheck != 0)
+	{
+		reprap.GetPlatform().PrimeEndstopLatch(endStopsToCheck);	// make sure the first endstop check reads the inputs
+	}
+
+	if (fanChangeMask != 0)
+	{
+		// A fan speed change is attached to this move. Fan::Refresh is too heavy to call from the step
+		// interrupt, so hand the change to the Platform to apply on its next Spin.
+		reprap.GetPlatform().ScheduleFanChange(fanChangeMask, newFanSpeed);
+	}
+
+#if SUPPORT_IOBITS
+	// Apply the port state for this move. Prepare built the write descriptor, so this is just one store per PIO
+	// controller and the ports switch on the same clock as the move boundary instead of when Spin next polls.
+	reprap.GetPortControl().ApplyPortWrite(portWrite, ioBits);
+#endif
 
 #if DDA_LOG_PROBE_CHANGES
 	if ((endStopsToCheck & LogProbeChanges) != 0)
@@ -1398,6 +1659,42 @@ pre(state == frozen)
 
 uint32_t DDA::maxReps = 0;		// this holds he maximum ISR loop count
 
+uint32_t DDA::laDdasExamined = 0;
+uint32_t DDA::laDdasRecalculated = 0;
+
+uint32_t DDA::maxDmsPerMove = 0;
+
+uint32_t DDA::stepLatencyHistogram[DDA::NumStepLatencyBuckets] = { 0 };
+uint32_t DDA::maxIsrDuration = 0;
+
+#if DDA_TIME_PHASES
+uint32_t DDA::minPrepareClocks = 0xFFFFFFFF;
+uint32_t DDA::maxPrepareClocks = 0;
+uint64_t DDA::totalPrepareClocks = 0;
+uint32_t DDA::minQueuedClocks = 0xFFFFFFFF;
+uint32_t DDA::maxQueuedClocks = 0;
+uint64_t DDA::totalQueuedClocks = 0;
+uint32_t DDA::numPhaseTimedMoves = 0;
+
+/*static*/ void DDA::ResetPhaseTimes()
+{
+	minPrepareClocks = minQueuedClocks = 0xFFFFFFFF;
+	maxPrepareClocks = maxQueuedClocks = 0;
+	totalPrepareClocks = totalQueuedClocks = 0;
+	numPhaseTimedMoves = 0;
+}
+#endif
+
+// How far ahead of their due times we will generate step pulses within a single ISR entry. Making this larger reduces ISR entry/exit
+// overhead when steps on several drives fall close together, at the cost of a little extra timing jitter on the earlier pulses.
+// It can be changed at run time using the M576 command.
+uint32_t DDA::stepCoalesceClocks = DDA::minInterruptInterval;
+
+#if SUPPORT_SCURVE
+bool DDA::sCurveEnabled = false;
+float DDA::shaperHalfPeriod = 0.0;
+#endif
+
 // This is called by the interrupt service routine to execute steps.
 // It returns true if it needs to be called again on the DDA of the new current move, otherwise false.
 // This must be as fast as possible, because it determines the maximum movement speed.
@@ -1405,9 +1702,26 @@ uint32_t DDA::maxReps = 0;		// this holds he maximum ISR loop count
 bool DDA::Step()
 {
 	Platform& platform = reprap.GetPlatform();
-	uint32_t lastStepPulseTime = platform.GetInterruptClocks();
+	const uint32_t isrStartTime = platform.GetInterruptClocks();
+	uint32_t lastStepPulseTime = isrStartTime;
 	bool repeat;
 	uint32_t numReps = 0;
+
+	// Record how late we are running relative to the earliest due step, for the M122 latency histogram.
+	// A negative latency just means we were called a little prematurely (e.g. because of step coalescing), so don't record it.
+	if (firstDM != nullptr)
+	{
+		const int32_t latency = (int32_t)(isrStartTime - moveStartTime - firstDM->nextStepTime);
+		if (latency >= 0)
+		{
+			size_t bucket = 0;
+			for (uint32_t l = (uint32_t)latency >> 1; l != 0 && bucket < NumStepLatencyBuckets - 1; l >>= 1)
+			{
+				++bucket;
+			}
+			++stepLatencyHistogram[bucket];
+		}
+	}
 	do
 	{
 		// Keep this loop as fast as possible, in the case that there are no endstops to check!
@@ -1415,16 +1729,23 @@ bool DDA::Step()
 		// 1. Check endstop switches and Z probe if asked. This is not speed critical because fast moves do not use endstops or the Z probe.
 		if (endStopsToCheck != 0)										// if any homing switches or the Z probe is enabled in this move
 		{
-			CheckEndstops(platform);	// Call out to a separate function because this may help cache usage in the more common case where we don't call it
-			if (state == completed)		// we may have completed the move due to triggering an endstop switch or Z probe
+			// If all the endstops we are checking are monitored by pin change interrupts, we only need to do the full check
+			// after a transition has been latched. Start() primes the latch so that an endstop that was already triggered
+			// when the move began is still noticed. The Z probe and stall-detect endstops are not edge-monitored, so any
+			// move that uses them takes the polled path as before.
+			if ((endStopsToCheck & ~platform.GetInterruptMonitoredEndstops()) != 0 || platform.ReadAndClearEndstopLatch() != 0)
 			{
-				break;
+				CheckEndstops(platform);	// Call out to a separate function because this may help cache usage in the more common case where we don't call it
+				if (state == completed)		// we may have completed the move due to triggering an endstop switch or Z probe
+				{
+					break;
+				}
 			}
 		}
 
 		// 2. Determine which drivers are due for stepping, overdue, or will be due very shortly
 		DriveMovement* dm = firstDM;
-		const uint32_t elapsedTime = (Platform::GetInterruptClocks() - moveStartTime) + minInterruptInterval;
+		const uint32_t elapsedTime = (Platform::GetInterruptClocks() - moveStartTime) + stepCoalesceClocks;
 		uint32_t driversStepping = 0;
 		while (dm != nullptr && elapsedTime >= dm->nextStepTime)		// if the next step is due
 		{
@@ -1479,6 +1800,16 @@ bool DDA::Step()
 			Platform::StepDriversLow();									// set all step pins low
 		}
 
+#if SUPPORT_IOBITS
+		// 5a. If the configured advance time means the next move's port state is due before this move ends, apply
+		//     it at the first step after the switch point. The write was precomputed when the next move was prepared.
+		if (ioBitsSwitchTime < clocksNeeded && elapsedTime - stepCoalesceClocks >= ioBitsSwitchTime && next->state == frozen)
+		{
+			reprap.GetPortControl().ApplyPortWrite(next->portWrite, next->ioBits);
+			ioBitsSwitchTime = clocksNeeded;						// don't apply it again
+		}
+#endif
+
 		// 6. Check for move completed
 		if (firstDM == nullptr)
 		{
@@ -1495,6 +1826,13 @@ bool DDA::Step()
 		maxReps = numReps;
 	}
 
+	// Record the longest time spent generating steps, excluding any time taken to start the next move
+	const uint32_t isrDuration = Platform::GetInterruptClocks() - isrStartTime;
+	if (isrDuration > maxIsrDuration)
+	{
+		maxIsrDuration = isrDuration;
+	}
+
 	if (state == completed)
 	{
 		// The following finish time is wrong if we aborted the move because of endstop or Z probe checks.
@@ -18,6 +18,8 @@
 #define DDA_LOG_PROBE_CHANGES	0		// save memory on the wired Duet
 #endif
 
+#define DDA_TIME_PHASES			0		// record when each move is initialised, frozen and started, to measure motion pipeline latency
+
 /**
  * This defines a single linear movement of the print head
  */
@@ -48,6 +50,7 @@ public:
 	void Complete() { state = completed; }
 	bool Free();
 	void Prepare(uint8_t simMode) __attribute__ ((hot));			// Calculate all the values and freeze this DDA
+	void TopUpStepTimes();											// Refill the precomputed step time buffers while this move is being executed
 	bool HasStepError() const;
 	bool CanPauseAfter() const { return canPauseAfter; }
 	bool CanPauseBefore() const { return canPauseBefore; }
@@ -65,8 +68,10 @@ public:
     void SetPositions(const float move[], size_t numDrives);		// Force the endpoints to be these
     FilePosition GetFilePosition() const { return filePos; }
     float GetRequestedSpeed() const { return requestedSpeed; }
+    float GetTopSpeed() const { return topSpeed; }
     float GetVirtualExtruderPosition() const { return virtualExtruderPosition; }
-	float AdvanceBabyStepping(float amount);						// Try to push babystepping earlier in the move queue
+	float ApplyBabyStepping(float amount);							// Fold outstanding babystepping into this newly-initialised move
+	void RequestSpeedScale(float factor) { speedScalePending *= factor; }	// Ask for the speeds of this provisional move to be rescaled when it is prepared
 	bool IsHomingAxes() const { return (endStopsToCheck & HomeAxes) != 0; }
 	uint32_t GetXAxes() const { return xAxes; }
 	uint32_t GetYAxes() const { return yAxes; }
@@ -108,14 +113,17 @@ public:
 	static constexpr int32_t MinCalcIntervalDelta = (40 * stepClockRate)/1000000; 		// the smallest sensible interval between calculations (40us) in step timer clocks
 	static constexpr int32_t MinCalcIntervalCartesian = (40 * stepClockRate)/1000000;	// same as delta for now, but could be lower
 	static constexpr uint32_t minInterruptInterval = 6;									// about 6us minimum interval between interrupts, in step clocks
+	static constexpr uint32_t MaxStepsPerSecond = 180000;								// the highest per-drive step rate the step interrupt can sustain
 #elif SAM4E || SAM4S
 	static constexpr int32_t MinCalcIntervalDelta = (40 * stepClockRate)/1000000; 		// the smallest sensible interval between calculations (40us) in step timer clocks
 	static constexpr int32_t MinCalcIntervalCartesian = (40 * stepClockRate)/1000000;	// same as delta for now, but could be lower
 	static constexpr uint32_t minInterruptInterval = 6;									// about 6us minimum interval between interrupts, in step clocks
+	static constexpr uint32_t MaxStepsPerSecond = 180000;								// the highest per-drive step rate the step interrupt can sustain
 #else
 	static constexpr int32_t MinCalcIntervalDelta = (60 * stepClockRate)/1000000; 		// the smallest sensible interval between calculations (60us) in step timer clocks
 	static constexpr int32_t MinCalcIntervalCartesian = (60 * stepClockRate)/1000000;	// same as delta for now, but could be lower
 	static constexpr uint32_t minInterruptInterval = 4;									// about 6us minimum interval between interrupts, in step clocks
+	static constexpr uint32_t MaxStepsPerSecond = 100000;								// the highest per-drive step rate the step interrupt can sustain
 #endif
 
 	static void PrintMoves();										// print saved moves for debugging
@@ -128,10 +136,38 @@ public:
 
 	static uint32_t maxReps;
 
+	static uint32_t laDdasExamined;			// how many DDAs the lookahead passes have visited, for diagnostics
+	static uint32_t laDdasRecalculated;		// how many DDAs the lookahead passes actually adjusted, for diagnostics
+
+	static uint32_t maxDmsPerMove;			// the largest number of DriveMovements any single move has taken from the pool, for diagnostics
+
+	static constexpr size_t NumStepLatencyBuckets = 8;
+	static uint32_t stepLatencyHistogram[NumStepLatencyBuckets];	// log-bucketed histogram of how late the step ISR ran relative to the due step time, in step clocks
+	static uint32_t maxIsrDuration;			// the longest time we have spent in a single step ISR entry, in step clocks
+
+	static uint32_t stepCoalesceClocks;		// how far ahead of their due times we will generate step pulses in a single ISR entry, in step clocks
+
+#if DDA_TIME_PHASES
+	// Accumulated phase timings over all moves started since they were last reported, in step clocks
+	static uint32_t minPrepareClocks, maxPrepareClocks;		// shortest/longest time from Init to freeze
+	static uint64_t totalPrepareClocks;
+	static uint32_t minQueuedClocks, maxQueuedClocks;		// shortest/longest time a frozen move waited before Start
+	static uint64_t totalQueuedClocks;
+	static uint32_t numPhaseTimedMoves;
+
+	static void ResetPhaseTimes();
+#endif
+
+#if SUPPORT_SCURVE
+	static bool sCurveEnabled;				// true if new moves should use the jerk-limited acceleration profile where possible (M583)
+	static float shaperHalfPeriod;			// half the period of the resonance that input shaping should cancel, in seconds, or zero if shaping is disabled (M596)
+#endif
+
 private:
 	DriveMovement *FindDM(size_t drive) const;
 	void RecalculateMove() __attribute__ ((hot));
 	void MatchSpeeds() __attribute__ ((hot));
+	void ApplySpeedScale(float factor);								// apply a pending M220 speed factor change just before the move is prepared
 	void ReduceHomingSpeed();										// called to reduce homing speed when a near-endstop is triggered
 	void StopDrive(size_t drive);									// stop movement of a drive and recalculate the endpoint
 	void InsertDM(DriveMovement *dm) __attribute__ ((hot));
@@ -143,6 +179,7 @@ private:
 	float NormaliseXYZ();											// Make the direction vector unit-normal in XYZ
 
 	static void DoLookahead(DDA *laDDA) __attribute__ ((hot));		// Try to smooth out moves in the queue
+	static void AdjustDmSteps(DriveMovement *pdm, int32_t steps);	// Adjust the net movement of a drive movement by the specified number of steps
     static float Normalise(float v[], size_t dim1, size_t dim2);  	// Normalise a vector of dim1 dimensions to unit length in the first dim1 dimensions
     static void Absolute(float v[], size_t dimensions);				// Put a vector in the positive hyperquadrant
     static float Magnitude(const float v[], size_t dimensions);  	// Return the length of a vector
@@ -169,6 +206,9 @@ private:
 			uint8_t xyMoving : 1;					// True if movement along an X axis or the Y axis was requested, even it if's too small to do
 			uint8_t goingSlow : 1;					// True if we have slowed the movement because the Z probe is approaching its threshold
 			uint8_t isLeadscrewAdjustmentMove : 1;	// True if this is a leadscrews adjustment move
+#if SUPPORT_SCURVE
+			uint8_t useSCurve : 1;					// True if this move uses the jerk-limited acceleration profile
+#endif
 		};
 		uint16_t flags;								// so that we can print all the flags at once for debugging
 	};
@@ -197,6 +237,8 @@ private:
 	float accelDistance;
 	float decelDistance;
 
+	float speedScalePending;				// Accumulated M220 speed factor change to apply to this move when it is prepared, 1.0 if none
+
 	// This is a temporary, used to keep track of the lookahead to avoid making recursive calls
 	float targetNextSpeed;					// The speed that the next move would like to start at
 
@@ -209,16 +251,39 @@ private:
 
 	float proportionLeft;					// what proportion of the extrusion in the G1 or G0 move of which this is a part remains to be done after this segment is complete
 
+#if SUPPORT_SCURVE
+	// Coefficients of the jerk-limited profile, set up by Prepare() when useSCurve is set. They are in the same form as the
+	// trapezoidal phase parameters, one set per sub-phase of each ramp, and they are common to all drives of the move.
+	struct SCurveParams
+	{
+		int32_t accelB[3];					// clock offset of each acceleration sub-phase formula (the first one is negative)
+		int64_t accelK[3];					// constant term under the square root for each acceleration sub-phase
+		uint32_t decelB[3];					// clock offset of each deceleration sub-phase formula
+		uint64_t decelK[3];					// constant term under the square root for each deceleration sub-phase
+	};
+	SCurveParams scurve;
+#endif
+
 #if SUPPORT_IOBITS
 	IoBits_t ioBits;						// port state required during this move
+	PortControl::PortWriteDescriptor portWrite;	// precomputed write that applies ioBits, built by Prepare so that the step ISR applies it with single stores
+	uint32_t ioBitsSwitchTime;				// clocks into this move at which to apply the next move's port state, = clocksNeeded if not before the end
 #endif
 
+	FansBitmap fanChangeMask;				// fans whose speed changes when this move starts, 0 = none
+	float newFanSpeed;						// the fan speed to apply to those fans
+
 #if DDA_LOG_PROBE_CHANGES
 	static bool probeTriggered;
 
 	void LogProbePosition();
 #endif
 
+#if DDA_TIME_PHASES
+	uint32_t whenInitialised;				// when Init set this move up, in step clocks
+	uint32_t whenFrozen;					// when Prepare froze it
+#endif
+
     DriveMovement* firstDM;					// list of contained DMs that need steps, in step time order
 	DriveMovement *pddm[DRIVES];			// These describe the state of each drive movement
 };
@@ -64,8 +64,20 @@ void DriveMovement::PrepareCartesianAxis(const DDA& dda, const PrepParams& param
 	mp.cart.accelStopStep = (uint32_t)(dda.accelDistance * stepsPerMm) + 1;
 	mp.cart.compensationClocks = mp.cart.accelCompensationClocks = 0;
 
+#if SUPPORT_SCURVE
+	if (dda.useSCurve)
+	{
+		mp.cart.accelRampMidD = roundU64((double)(DDA::stepClockRateSquared * 2)/((double)stepsPerMm * (double)params.accelMidAcc));
+		mp.cart.decelRampMidD = roundU64((double)(DDA::stepClockRateSquared * 2)/((double)stepsPerMm * (double)params.decelMidAcc));
+		mp.cart.accelSubStep1 = (uint32_t)(params.accelSubDist1 * stepsPerMm) + 1;
+		mp.cart.accelSubStep2 = (uint32_t)(params.accelSubDist2 * stepsPerMm) + 1;
+		mp.cart.decelSubStep1 = (uint32_t)(params.decelSubDist1 * stepsPerMm) + 1;
+		mp.cart.decelSubStep2 = (uint32_t)(params.decelSubDist2 * stepsPerMm) + 1;
+	}
+#endif
+
 	// Constant speed phase parameters
-	mp.cart.mmPerStepTimesCKdivtopSpeed = roundU32(((float)((uint64_t)DDA::stepClockRate * K1))/(stepsPerMm * dda.topSpeed));
+	mp.cart.mmPerStepTimesCdivtopSpeed = Q22Dot10::FromFloat((float)DDA::stepClockRate/(stepsPerMm * dda.topSpeed));
 
 	// Deceleration phase parameters
 	// First check whether there is any deceleration at all, otherwise we may get strange results because of rounding errors
@@ -152,7 +164,7 @@ void DriveMovement::PrepareDeltaAxis(const DDA& dda, const PrepParams& params)
 	mp.delta.accelStopDsK = roundU32(dda.accelDistance * stepsPerMm * K2);
 
 	// Constant speed phase parameters
-	mp.delta.mmPerStepTimesCKdivtopSpeed = roundU32(((float)DDA::stepClockRate * K1)/(stepsPerMm * dda.topSpeed));
+	mp.delta.mmPerStepTimesCdivtopSpeed = Q22Dot10::FromFloat((float)DDA::stepClockRate/(stepsPerMm * dda.topSpeed));
 
 	// Deceleration phase parameters
 	// First check whether there is any deceleration at all, otherwise we may get strange results because of rounding errors
@@ -204,8 +216,21 @@ void DriveMovement::PrepareExtruder(const DDA& dda, const PrepParams& params, bo
 	// Acceleration phase parameters
 	mp.cart.accelStopStep = (uint32_t)((dda.accelDistance + accelCompensationDistance) * stepsPerMm) + 1;
 
+#if SUPPORT_SCURVE
+	if (dda.useSCurve)
+	{
+		// Jerk-limited moves never use pressure advance, so accelCompensationDistance is zero and the axis sub-phase distances apply unchanged
+		mp.cart.accelRampMidD = roundU64((double)(DDA::stepClockRateSquared * 2)/((double)stepsPerMm * (double)params.accelMidAcc));
+		mp.cart.decelRampMidD = roundU64((double)(DDA::stepClockRateSquared * 2)/((double)stepsPerMm * (double)params.decelMidAcc));
+		mp.cart.accelSubStep1 = (uint32_t)(params.accelSubDist1 * stepsPerMm) + 1;
+		mp.cart.accelSubStep2 = (uint32_t)(params.accelSubDist2 * stepsPerMm) + 1;
+		mp.cart.decelSubStep1 = (uint32_t)(params.decelSubDist1 * stepsPerMm) + 1;
+		mp.cart.decelSubStep2 = (uint32_t)(params.decelSubDist2 * stepsPerMm) + 1;
+	}
+#endif
+
 	// Constant speed phase parameters
-	mp.cart.mmPerStepTimesCKdivtopSpeed = (uint32_t)((float)((uint64_t)DDA::stepClockRate * K1)/(stepsPerMm * dda.topSpeed));
+	mp.cart.mmPerStepTimesCdivtopSpeed = Q22Dot10::FromFloat((float)DDA::stepClockRate/(stepsPerMm * dda.topSpeed));
 
 	// Calculate the deceleration and reverse phase parameters
 	// First check whether there is any deceleration at all, otherwise we may get strange results because of rounding errors
@@ -250,6 +275,182 @@ void DriveMovement::PrepareExtruder(const DDA& dda, const PrepParams& params, bo
 	}
 }
 
+#if SUPPORT_SCURVE
+
+// Calculate the time of a step in the acceleration ramp of a jerk-limited move.
+// The sub-phase coefficients are in the same form as the trapezoidal ones, so this costs the same as a plain acceleration step.
+uint32_t DriveMovement::CalcSCurveAccelStepTime(const DDA &dda, uint32_t stepNumber) const
+{
+	const size_t subPhase = (stepNumber < mp.cart.accelSubStep1) ? 0
+							: (stepNumber < mp.cart.accelSubStep2) ? 1
+								: 2;
+	const uint64_t d = (subPhase == 1) ? mp.cart.accelRampMidD : (mp.cart.accelRampMidD << 1);
+	// Guard against rounding error making the term under the square root slightly negative on the first step of a sub-phase
+	const int64_t t2a = dda.scurve.accelK[subPhase] + (int64_t)(d * stepNumber);
+	return (uint32_t)(dda.scurve.accelB[subPhase] + (int32_t)isqrt64((t2a > 0) ? (uint64_t)t2a : 0));
+}
+
+// Calculate the time of a step in the deceleration ramp of a jerk-limited move
+uint32_t DriveMovement::CalcSCurveDecelStepTime(const DDA &dda, uint32_t stepNumber) const
+{
+	const size_t subPhase = (stepNumber < mp.cart.decelSubStep1) ? 0
+							: (stepNumber < mp.cart.decelSubStep2) ? 1
+								: 2;
+	const uint64_t temp = ((subPhase == 1) ? mp.cart.decelRampMidD : (mp.cart.decelRampMidD << 1)) * stepNumber;
+	const uint64_t k = dda.scurve.decelK[subPhase];
+	// Allow for possible rounding error when the end speed is zero or very small
+	return (temp < k)
+					? dda.scurve.decelB[subPhase] - isqrt64(k - temp)
+					: dda.scurve.decelB[subPhase];
+}
+
+#endif
+
+// Calculate the time of a future step of a Cartesian or extruder move without changing any state.
+// This duplicates the phase calculations in CalcNextStepTimeCartesianFull, which remains the authoritative version.
+// The caller must ensure that stepNumber is below reverseStartStep, so we never have to handle the reverse phase here.
+uint32_t DriveMovement::CalcCartesianStepTime(const DDA &dda, uint32_t stepNumber) const
+pre(stepNumber < reverseStartStep)
+{
+	if (stepNumber < mp.cart.accelStopStep)
+	{
+#if SUPPORT_SCURVE
+		if (dda.useSCurve)
+		{
+			return CalcSCurveAccelStepTime(dda, stepNumber);
+		}
+#endif
+		// acceleration phase
+		const uint32_t adjustedStartSpeedTimesCdivA = dda.startSpeedTimesCdivA + mp.cart.compensationClocks;
+		return isqrt64(isquare64(adjustedStartSpeedTimesCdivA) + (mp.cart.twoCsquaredTimesMmPerStepDivA * stepNumber)) - adjustedStartSpeedTimesCdivA;
+	}
+	if (stepNumber < mp.cart.decelStartStep)
+	{
+		// steady speed phase
+		return (uint32_t)(  (int32_t)mp.cart.mmPerStepTimesCdivtopSpeed.MulU(stepNumber)
+						  + dda.extraAccelerationClocks
+						  - (int32_t)mp.cart.accelCompensationClocks
+						 );
+	}
+
+#if SUPPORT_SCURVE
+	if (dda.useSCurve)
+	{
+		return CalcSCurveDecelStepTime(dda, stepNumber);
+	}
+#endif
+	// deceleration phase, not reversed
+	const uint64_t temp = mp.cart.twoCsquaredTimesMmPerStepDivA * stepNumber;
+	const uint32_t adjustedTopSpeedTimesCdivAPlusDecelStartClocks = dda.topSpeedTimesCdivAPlusDecelStartClocks - mp.cart.compensationClocks;
+	// Allow for possible rounding error when the end speed is zero or very small
+	return (temp < twoDistanceToStopTimesCsquaredDivA)
+					? adjustedTopSpeedTimesCdivAPlusDecelStartClocks - isqrt64(twoDistanceToStopTimesCsquaredDivA - temp)
+					: adjustedTopSpeedTimesCdivAPlusDecelStartClocks;
+}
+
+// Initialise and fill the buffer of precomputed step times so that the step ISR can fetch the next step time without doing a square root.
+// This is called by DDA::Prepare, so it runs outside the step ISR.
+// We don't precompute times for delta towers, because the tower step calculation is inherently iterative.
+void DriveMovement::PrecomputeStepTimes(const DDA& dda)
+{
+	stepTimeBufferStart = nextStep + 1;
+	stepTimeBufferEnd = nextStep + 1;
+	TopUpStepTimes(dda);
+}
+
+// Refill the buffer of precomputed step times. This is called repeatedly from Move::Spin while the move is being executed,
+// so it must tolerate the step ISR consuming entries concurrently. The ISR never writes the buffer state: it just reads entries
+// between stepTimeBufferStart and stepTimeBufferEnd, indexed by step number, and falls back to calculating the step time itself
+// when the entry it wants is not there. The Cartesian step time is a pure function of the step number, so if the ISR overtakes
+// us we can simply restart the buffer just ahead of it.
+void DriveMovement::TopUpStepTimes(const DDA& dda)
+{
+	const uint32_t stepsDone = nextStep;					// capture volatile written by the ISR
+	uint32_t start = stepTimeBufferStart;
+	uint32_t end = stepTimeBufferEnd;
+	if ((int32_t)(end - (stepsDone + 1)) <= 0)
+	{
+		// The ISR has consumed or overtaken everything we buffered, so restart just ahead of it
+		start = end = stepsDone + 1;
+		stepTimeBufferStart = start;
+		stepTimeBufferEnd = end;
+		__DMB();											// make sure the old entries are invalidated before we overwrite them
+	}
+	else if ((int32_t)(start - stepsDone) < 0)
+	{
+		// Drop the entries the ISR has passed, but not the one it may be consuming right now, so that their slots can be reused
+		start = stepsDone;
+		stepTimeBufferStart = start;
+		__DMB();											// make sure the dropped entries are invalidated before we overwrite them
+	}
+
+	while (end - start < StepTimeBufferLength && end <= totalSteps && end < reverseStartStep)
+	{
+		uint32_t stepTime = CalcCartesianStepTime(dda, end);
+		if (stepTime > dda.clocksNeeded)
+		{
+			// When the end speed is very low, calculating the time of the last step is very sensitive to rounding error
+			if (end + 1 >= totalSteps)
+			{
+				stepTime = dda.clocksNeeded;
+			}
+			else
+			{
+				break;										// leave the late step for the ISR calculation to flag as a step error
+			}
+		}
+		stepTimeBuffer[end & (StepTimeBufferLength - 1)] = stepTime;
+		__DMB();											// make sure the entry is written before we publish it
+		++end;
+		stepTimeBufferEnd = end;
+	}
+}
+
+// Microbenchmark support for the M122 P105 harness: time 'numCalcs' Cartesian step time calculations on a synthetic
+// trapezoidal move and return the total time taken in step clocks. CalcCartesianStepTime contains the arithmetic that
+// dominates the cost of CalcNextStepTimeCartesianFull without its state updates, so its cost is the one worth tracking.
+uint32_t DriveMovement::TimeStepCalculations(uint32_t numCalcs)
+{
+	// Set up a 40mm move at 80 steps/mm that accelerates from 10mm/s to 100mm/s at 1000mm/s^2 and decelerates back again
+	DDA dda(nullptr);
+	dda.flags = 0;
+	dda.totalDistance = 40.0;
+	dda.acceleration = 1000.0;
+	dda.startSpeed = dda.endSpeed = 10.0;
+	dda.topSpeed = 100.0;
+	dda.accelDistance = dda.decelDistance = (fsquare(dda.topSpeed) - fsquare(dda.startSpeed))/(2 * dda.acceleration);
+	dda.startSpeedTimesCdivA = roundU32((dda.startSpeed * DDA::stepClockRate)/dda.acceleration);
+
+	const float accelClocks = ((dda.topSpeed - dda.startSpeed)/dda.acceleration) * DDA::stepClockRate;
+	const float steadyClocks = ((dda.totalDistance - dda.accelDistance - dda.decelDistance)/dda.topSpeed) * DDA::stepClockRate;
+	dda.clocksNeeded = roundU32((2 * accelClocks) + steadyClocks);		// the deceleration clocks equal the acceleration clocks
+	dda.extraAccelerationClocks = roundS32(accelClocks - ((dda.accelDistance/dda.topSpeed) * DDA::stepClockRate));
+	dda.topSpeedTimesCdivAPlusDecelStartClocks = roundU32(((dda.topSpeed * DDA::stepClockRate)/dda.acceleration) + accelClocks + steadyClocks);
+
+	PrepParams params;
+	params.decelStartDistance = dda.totalDistance - dda.decelDistance;
+	params.topSpeedTimesCdivA = roundU32((dda.topSpeed * DDA::stepClockRate)/dda.acceleration);
+
+	DriveMovement dm(nullptr);
+	dm.drive = 0;
+	dm.state = DMState::moving;
+	dm.totalSteps = (uint32_t)(dda.totalDistance * 80.0);
+	dm.PrepareCartesianAxis(dda, params);
+
+	// Cycle the step number through the whole move so that all three phases contribute to the average
+	volatile uint32_t sink = 0;							// accumulate the results here so that the calculations cannot be optimised away
+	uint32_t stepNumber = 1;
+	const uint32_t startTime = Platform::GetInterruptClocks();
+	for (uint32_t i = 0; i < numCalcs; ++i)
+	{
+		sink += dm.CalcCartesianStepTime(dda, stepNumber);
+		stepNumber = (stepNumber == dm.totalSteps) ? 1 : stepNumber + 1;
+	}
+	const uint32_t clocksTaken = Platform::GetInterruptClocks() - startTime;
+	(void)sink;
+	return clocksTaken;
+}
+
 void DriveMovement::DebugPrint(char c, bool isDeltaMovement) const
 {
 	if (state != DMState::idle)
@@ -264,7 +465,7 @@ void DriveMovement::DebugPrint(char c, bool isDeltaMovement) const
 			debugPrintf("hmz0sK=%" PRIi32 " minusAaPlusBbTimesKs=%" PRIi32 " dSquaredMinusAsquaredMinusBsquared=%" PRId64 "\n"
 						"2c2mmsda=%" PRIu64 " asdsk=%" PRIu32 " dsdsk=%" PRIu32 " mmstcdts=%" PRIu32 "\n",
 						mp.delta.hmz0sK, mp.delta.minusAaPlusBbTimesKs, mp.delta.dSquaredMinusAsquaredMinusBsquaredTimesKsquaredSsquared,
-						mp.delta.twoCsquaredTimesMmPerStepDivA, mp.delta.accelStopDsK, mp.delta.decelStartDsK, mp.delta.mmPerStepTimesCKdivtopSpeed
+						mp.delta.twoCsquaredTimesMmPerStepDivA, mp.delta.accelStopDsK, mp.delta.decelStartDsK, mp.delta.mmPerStepTimesCdivtopSpeed.GetRaw()
 						);
 		}
 		else
@@ -272,7 +473,7 @@ void DriveMovement::DebugPrint(char c, bool isDeltaMovement) const
 			debugPrintf("accelStopStep=%" PRIu32 " decelStartStep=%" PRIu32 " 2CsqtMmPerStepDivA=%" PRIu64 "\n"
 						"mmPerStepTimesCdivtopSpeed=%" PRIu32 " fmsdmtstdca2=%" PRId64 " cc=%" PRIu32 " acc=%" PRIu32 "\n",
 						mp.cart.accelStopStep, mp.cart.decelStartStep, mp.cart.twoCsquaredTimesMmPerStepDivA,
-						mp.cart.mmPerStepTimesCKdivtopSpeed, mp.cart.fourMaxStepDistanceMinusTwoDistanceToStopTimesCsquaredDivA, mp.cart.compensationClocks, mp.cart.accelCompensationClocks
+						mp.cart.mmPerStepTimesCdivtopSpeed.GetRaw(), mp.cart.fourMaxStepDistanceMinusTwoDistanceToStopTimesCsquaredDivA, mp.cart.compensationClocks, mp.cart.accelCompensationClocks
 						);
 		}
 	}
@@ -317,27 +518,45 @@ pre(nextStep < totalSteps; stepsTillRecalc == 0)
 	const uint32_t lastStepTime = nextStepTime;					// pick up the time of the last step
 	if (nextCalcStep < mp.cart.accelStopStep)
 	{
-		// acceleration phase
-		const uint32_t adjustedStartSpeedTimesCdivA = dda.startSpeedTimesCdivA + mp.cart.compensationClocks;
-		nextStepTime = isqrt64(isquare64(adjustedStartSpeedTimesCdivA) + (mp.cart.twoCsquaredTimesMmPerStepDivA * nextCalcStep)) - adjustedStartSpeedTimesCdivA;
+#if SUPPORT_SCURVE
+		if (dda.useSCurve)
+		{
+			nextStepTime = CalcSCurveAccelStepTime(dda, nextCalcStep);
+		}
+		else
+#endif
+		{
+			// acceleration phase
+			const uint32_t adjustedStartSpeedTimesCdivA = dda.startSpeedTimesCdivA + mp.cart.compensationClocks;
+			nextStepTime = isqrt64(isquare64(adjustedStartSpeedTimesCdivA) + (mp.cart.twoCsquaredTimesMmPerStepDivA * nextCalcStep)) - adjustedStartSpeedTimesCdivA;
+		}
 	}
 	else if (nextCalcStep < mp.cart.decelStartStep)
 	{
 		// steady speed phase
-		nextStepTime = (uint32_t)(  (int32_t)(((uint64_t)mp.cart.mmPerStepTimesCKdivtopSpeed * nextCalcStep)/K1)
+		nextStepTime = (uint32_t)(  (int32_t)mp.cart.mmPerStepTimesCdivtopSpeed.MulU(nextCalcStep)
 								  + dda.extraAccelerationClocks
 								  - (int32_t)mp.cart.accelCompensationClocks
 								 );
 	}
 	else if (nextCalcStep < reverseStartStep)
 	{
-		// deceleration phase, not reversed yet
-		const uint64_t temp = mp.cart.twoCsquaredTimesMmPerStepDivA * nextCalcStep;
-		const uint32_t adjustedTopSpeedTimesCdivAPlusDecelStartClocks = dda.topSpeedTimesCdivAPlusDecelStartClocks - mp.cart.compensationClocks;
-		// Allow for possible rounding error when the end speed is zero or very small
-		nextStepTime = (temp < twoDistanceToStopTimesCsquaredDivA)
-						? adjustedTopSpeedTimesCdivAPlusDecelStartClocks - isqrt64(twoDistanceToStopTimesCsquaredDivA - temp)
-						: adjustedTopSpeedTimesCdivAPlusDecelStartClocks;
+#if SUPPORT_SCURVE
+		if (dda.useSCurve)
+		{
+			nextStepTime = CalcSCurveDecelStepTime(dda, nextCalcStep);
+		}
+		else
+#endif
+		{
+			// deceleration phase, not reversed yet
+			const uint64_t temp = mp.cart.twoCsquaredTimesMmPerStepDivA * nextCalcStep;
+			const uint32_t adjustedTopSpeedTimesCdivAPlusDecelStartClocks = dda.topSpeedTimesCdivAPlusDecelStartClocks - mp.cart.compensationClocks;
+			// Allow for possible rounding error when the end speed is zero or very small
+			nextStepTime = (temp < twoDistanceToStopTimesCsquaredDivA)
+							? adjustedTopSpeedTimesCdivAPlusDecelStartClocks - isqrt64(twoDistanceToStopTimesCsquaredDivA - temp)
+							: adjustedTopSpeedTimesCdivAPlusDecelStartClocks;
+		}
 	}
 	else
 	{
@@ -456,7 +675,7 @@ pre(nextStep < totalSteps; stepsTillRecalc == 0)
 	else if ((uint32_t)dsK < mp.delta.decelStartDsK)
 	{
 		// Steady speed phase
-		nextStepTime = (uint32_t)(  (int32_t)(((uint64_t)mp.delta.mmPerStepTimesCKdivtopSpeed * (uint32_t)dsK)/(K1 * K2))
+		nextStepTime = (uint32_t)(  (int32_t)(mp.delta.mmPerStepTimesCdivtopSpeed.MulU((uint32_t)dsK)/K2)
 								  + dda.extraAccelerationClocks
 								 );
 	}
@@ -502,7 +721,7 @@ void DriveMovement::ReduceSpeed(const DDA& dda, uint32_t inverseSpeedFactor)
 		mp.delta.decelStartDsK = 0xFFFFFFFF;
 
 		// Adjust the speed
-		mp.delta.mmPerStepTimesCKdivtopSpeed *= inverseSpeedFactor;
+		mp.delta.mmPerStepTimesCdivtopSpeed *= inverseSpeedFactor;
 	}
 	else
 	{
@@ -511,7 +730,7 @@ void DriveMovement::ReduceSpeed(const DDA& dda, uint32_t inverseSpeedFactor)
 		mp.cart.decelStartStep = totalSteps + 1;
 
 		// Adjust the speed
-		mp.cart.mmPerStepTimesCKdivtopSpeed *= inverseSpeedFactor;
+		mp.cart.mmPerStepTimesCdivtopSpeed *= inverseSpeedFactor;
 	}
 }
 
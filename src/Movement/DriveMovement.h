@@ -9,11 +9,15 @@
 #define DRIVEMOVEMENT_H_
 
 #include "RepRapFirmware.h"
+#include "Libraries/Math/Fixed.h"
 
 class LinearDeltaKinematics;
 
 #define ROUND_TO_NEAREST	(0)			// 1 for round to nearest (as used in 1.20beta10), 0 for round down (as used prior to 1.20beta10)
 
+// S-curve (jerk-limited) acceleration profiles need extra per-move and per-drive parameters, so we only support them on processors with enough RAM
+#define SUPPORT_SCURVE		(SAM4E || SAM4S || SAME70)
+
 // Rounding functions, to improve code clarity. Also allows a quick switch between round-to-nearest and round down in the movement code.
 inline uint32_t roundU32(float f)
 {
@@ -94,6 +98,14 @@ struct PrepParams
 	float decelStartDistance;
 	uint32_t topSpeedTimesCdivA;
 
+#if SUPPORT_SCURVE
+	// Parameters used only for jerk-limited moves: the distances from the start of the move at which the second and third
+	// sub-phases of each ramp begin, and the middle sub-phase acceleration of each ramp (see DDA::Prepare)
+	float accelSubDist1, accelSubDist2;
+	float decelSubDist1, decelSubDist2;
+	float accelMidAcc, decelMidAcc;
+#endif
+
 	// Parameters used only for extruders
 	float compFactor;
 
@@ -123,6 +135,8 @@ public:
 
 	bool CalcNextStepTimeCartesian(const DDA &dda, bool live) __attribute__ ((hot));
 	bool CalcNextStepTimeDelta(const DDA &dda, bool live) __attribute__ ((hot));
+	void PrecomputeStepTimes(const DDA& dda);			// initialise and fill the step time buffer, called outside the step ISR
+	void TopUpStepTimes(const DDA& dda);				// refill the step time buffer while the move is being executed, called outside the step ISR
 	void PrepareCartesianAxis(const DDA& dda, const PrepParams& params) __attribute__ ((hot));
 	void PrepareDeltaAxis(const DDA& dda, const PrepParams& params) __attribute__ ((hot));
 	void PrepareExtruder(const DDA& dda, const PrepParams& params, bool doCompensation) __attribute__ ((hot));
@@ -142,9 +156,17 @@ public:
 	static DriveMovement *Allocate(size_t drive, DMState st);
 	static void Release(DriveMovement *item);
 
+	static uint32_t TimeStepCalculations(uint32_t numCalcs);	// microbenchmark: time step calculations on a synthetic move, returning the step clocks taken
+
 private:
 	bool CalcNextStepTimeCartesianFull(const DDA &dda, bool live) __attribute__ ((hot));
 	bool CalcNextStepTimeDeltaFull(const DDA &dda, bool live) __attribute__ ((hot));
+	uint32_t CalcCartesianStepTime(const DDA &dda, uint32_t stepNumber) const;	// calculate the time of a future step without changing any state
+
+#if SUPPORT_SCURVE
+	uint32_t CalcSCurveAccelStepTime(const DDA &dda, uint32_t stepNumber) const;	// calculate a step time in the acceleration ramp of a jerk-limited move
+	uint32_t CalcSCurveDecelStepTime(const DDA &dda, uint32_t stepNumber) const;	// calculate a step time in the deceleration ramp of a jerk-limited move
+#endif
 
 	static DriveMovement *freeList;
 	static int numFree;
@@ -169,9 +191,23 @@ private:
 	uint32_t nextStepTime;								// how many clocks after the start of this move the next step is due
 	uint32_t stepInterval;								// how many clocks between steps
 
+#if SAM4E || SAM4S || SAME70
+	static constexpr size_t StepTimeBufferLength = 8;	// number of step times we precompute outside the ISR
+#else
+	// We are more memory-constrained on the SAM3X
+	static constexpr size_t StepTimeBufferLength = 4;
+#endif
+	uint32_t stepTimeBuffer[StepTimeBufferLength];		// precomputed step times, indexed by step number modulo the buffer length
+	volatile uint32_t stepTimeBufferStart;				// the lowest step number that has a valid entry in the buffer; written only outside the ISR
+	volatile uint32_t stepTimeBufferEnd;				// one past the highest step number that has a valid entry; written only outside the ISR
+
 	// The following only needs to be stored per-drive if we are supporting pressure advance
 	uint64_t twoDistanceToStopTimesCsquaredDivA;
 
+	// Fixed-point format of the steady-phase clocks-per-step values below. The 10 fraction bits replace the old
+	// manual K1 = 1024 scale factor, so that the compiler tracks the scaling and the rescaling divides are shifts.
+	typedef Qfrac<uint32_t, 10> Q22Dot10;
+
 	// Parameters unique to a style of move (Cartesian, delta or extruder). Currently, extruders and Cartesian moves use the same parameters.
 	union MoveParams
 	{
@@ -184,9 +220,18 @@ private:
 			int64_t fourMaxStepDistanceMinusTwoDistanceToStopTimesCsquaredDivA;		// this one can be negative
 			uint32_t accelStopStep;						// the first step number at which we are no longer accelerating
 			uint32_t decelStartStep;					// the first step number at which we are decelerating
-			uint32_t mmPerStepTimesCKdivtopSpeed;		// mmPerStepInHyperCuboidSpace * clock / topSpeed
+			Q22Dot10 mmPerStepTimesCdivtopSpeed;		// mmPerStepInHyperCuboidSpace * clock / topSpeed, in Q22.10 fixed point
 			uint32_t compensationClocks;				// the pressure advance time in clocks
 			uint32_t accelCompensationClocks;			// compensationClocks * (1 - startSpeed/topSpeed)
+
+#if SUPPORT_SCURVE
+			// The following are used only when the DDA has useSCurve set. The outer sub-phases of each ramp use half the middle
+			// sub-phase acceleration, so their coefficient is just the middle one shifted left.
+			uint64_t accelRampMidD;						// as twoCsquaredTimesMmPerStepDivA but for the middle sub-phase acceleration of the acceleration ramp
+			uint64_t decelRampMidD;						// as twoCsquaredTimesMmPerStepDivA but for the middle sub-phase acceleration of the deceleration ramp
+			uint32_t accelSubStep1, accelSubStep2;		// the first step numbers of the second and third acceleration sub-phases
+			uint32_t decelSubStep1, decelSubStep2;		// the first step numbers of the second and third deceleration sub-phases
+#endif
 		} cart;
 
 		struct DeltaParameters							// Parameters for delta movement
@@ -200,12 +245,11 @@ private:
 			// The following depend on how the move is executed, so they must be set up in Prepare()
 			uint32_t accelStopDsK;
 			uint32_t decelStartDsK;
-			uint32_t mmPerStepTimesCKdivtopSpeed;
+			Q22Dot10 mmPerStepTimesCdivtopSpeed;		// as for the Cartesian case, in Q22.10 fixed point
 		} delta;
 	} mp;
 
 	static constexpr uint32_t NoStepTime = 0xFFFFFFFF;	// value to indicate that no further steps are needed when calculating the next step time
-	static constexpr uint32_t K1 = 1024;				// a power of 2 used to multiply the value mmPerStepTimesCdivtopSpeed to reduce rounding errors
 	static constexpr uint32_t K2 = 512;					// a power of 2 used in delta calculations to reduce rounding errors (but too large makes things worse)
 	static constexpr int32_t Kc = 1024 * 1024;			// a power of 2 for scaling the Z movement fraction
 };
@@ -224,6 +268,14 @@ inline bool DriveMovement::CalcNextStepTimeCartesian(const DDA &dda, bool live)
 			--stepsTillRecalc;			// we are doing double/quad/octal stepping
 			return true;
 		}
+		if (nextStep < stepTimeBufferEnd && nextStep >= stepTimeBufferStart)
+		{
+			// Use a step time that was precomputed outside the ISR, saving us an isqrt64 call
+			const uint32_t lastStepTime = nextStepTime;
+			nextStepTime = stepTimeBuffer[nextStep & (StepTimeBufferLength - 1)];
+			stepInterval = nextStepTime - lastStepTime;
+			return true;
+		}
 		return CalcNextStepTimeCartesianFull(dda, live);
 	}
 
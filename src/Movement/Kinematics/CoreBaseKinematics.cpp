@@ -15,6 +15,56 @@ CoreBaseKinematics::CoreBaseKinematics(KinematicsType t) : ZLeadscrewKinematics(
 	{
 		af = 1.0;
 	}
+	RecalcMatrices();			// note that this calls the base class implementation, so derived classes that override it must call it again
+}
+
+// Rebuild forwardMatrix and inverseMatrix from axisFactors. The default is the identity transform.
+void CoreBaseKinematics::RecalcMatrices()
+{
+	for (size_t i = 0; i < XYZ_AXES; ++i)
+	{
+		for (size_t j = 0; j < XYZ_AXES; ++j)
+		{
+			forwardMatrix[i][j] = inverseMatrix[i][j] = (i == j) ? 1.0 : 0.0;
+		}
+	}
+}
+
+// Convert Cartesian coordinates to motor coordinates using the precomputed forward matrix
+bool CoreBaseKinematics::CartesianToMotorSteps(const float machinePos[], const float stepsPerMm[], size_t numVisibleAxes, size_t numTotalAxes, int32_t motorPos[], bool isCoordinated) const
+{
+	for (size_t axis = 0; axis < XYZ_AXES; ++axis)
+	{
+		motorPos[axis] = lrintf(  (  (machinePos[X_AXIS] * forwardMatrix[axis][X_AXIS])
+								   + (machinePos[Y_AXIS] * forwardMatrix[axis][Y_AXIS])
+								   + (machinePos[Z_AXIS] * forwardMatrix[axis][Z_AXIS])
+								  ) * stepsPerMm[axis]);
+	}
+
+	for (size_t axis = XYZ_AXES; axis < numVisibleAxes; ++axis)
+	{
+		motorPos[axis] = lrintf(machinePos[axis] * stepsPerMm[axis]);
+	}
+	return true;
+}
+
+// Convert motor coordinates to machine coordinates using the precomputed inverse matrix.
+// Used after homing and after individual motor moves, so not speed-critical.
+void CoreBaseKinematics::MotorStepsToCartesian(const int32_t motorPos[], const float stepsPerMm[], size_t numVisibleAxes, size_t numTotalAxes, float machinePos[]) const
+{
+	const float motorMm[XYZ_AXES] = { motorPos[X_AXIS]/stepsPerMm[X_AXIS], motorPos[Y_AXIS]/stepsPerMm[Y_AXIS], motorPos[Z_AXIS]/stepsPerMm[Z_AXIS] };
+	for (size_t axis = 0; axis < XYZ_AXES; ++axis)
+	{
+		machinePos[axis] = (motorMm[X_AXIS] * inverseMatrix[axis][X_AXIS])
+						 + (motorMm[Y_AXIS] * inverseMatrix[axis][Y_AXIS])
+						 + (motorMm[Z_AXIS] * inverseMatrix[axis][Z_AXIS]);
+	}
+
+	// Convert any additional axes linearly
+	for (size_t drive = XYZ_AXES; drive < numVisibleAxes; ++drive)
+	{
+		machinePos[drive] = motorPos[drive]/stepsPerMm[drive];
+	}
 }
 
 // Set the parameters from a M665, M666 or M669 command
@@ -33,7 +83,11 @@ bool CoreBaseKinematics::Configure(unsigned int mCode, GCodeBuffer& gb, StringRe
 				seen = true;
 			}
 		}
-		if (!seen && !gb.Seen('K'))
+		if (seen)
+		{
+			RecalcMatrices();
+		}
+		else if (!gb.Seen('K'))
 		{
 			reply.printf("Kinematics is %s with axis factors", GetName());
 			for (size_t axis = 0; axis < XYZ_AXES; ++axis)
@@ -17,6 +17,8 @@ public:
 
 	// Overridden base class functions. See Kinematics.h for descriptions.
 	bool Configure(unsigned int mCode, GCodeBuffer& gb, StringRef& reply, bool& error) override;
+	bool CartesianToMotorSteps(const float machinePos[], const float stepsPerMm[], size_t numVisibleAxes, size_t numTotalAxes, int32_t motorPos[], bool isCoordinated) const override;
+	void MotorStepsToCartesian(const int32_t motorPos[], const float stepsPerMm[], size_t numVisibleAxes, size_t numTotalAxes, float machinePos[]) const override;
 	HomingMode GetHomingMode() const override { return homeCartesianAxes; }
 	bool QueryTerminateHomingMove(size_t axis) const override;
 	void OnHomingSwitchTriggered(size_t axis, bool highEnd, const float stepsPerMm[], DDA& dda) const override;
@@ -26,7 +28,18 @@ protected:
 	// Used to determine whether to abort the whole move or just one motor when an endstop switch is triggered.
 	virtual bool DriveIsShared(size_t drive) const = 0;
 
+	// Rebuild forwardMatrix and inverseMatrix from axisFactors. Called whenever the axis factors are changed.
+	// The default implementation leaves the matrices as the identity; CoreXY and CoreXZ override it.
+	virtual void RecalcMatrices();
+
 	float axisFactors[MaxAxes];			// allow more than just XYZ so that we can support e.g. CoreXYU kinematics
+
+	// The core transform for the XYZ axes, precomputed from the axis factors when they are configured so that
+	// CartesianToMotorSteps and MotorStepsToCartesian are plain multiply-accumulate loops with no per-move setup.
+	// forwardMatrix maps Cartesian position to motor position (excluding the steps/mm scaling),
+	// inverseMatrix maps motor position (already divided by steps/mm) back to Cartesian position.
+	float forwardMatrix[XYZ_AXES][XYZ_AXES];
+	float inverseMatrix[XYZ_AXES][XYZ_AXES];
 };
 
 #endif /* SRC_MOVEMENT_KINEMATICS_COREBASEKINEMATICS_H_ */
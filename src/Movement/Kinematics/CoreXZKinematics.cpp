@@ -9,6 +9,7 @@
 
 CoreXZKinematics::CoreXZKinematics() : CoreBaseKinematics(KinematicsType::coreXZ)
 {
+	RecalcMatrices();
 }
 
 // Return the name of the current kinematics
@@ -17,36 +18,18 @@ const char *CoreXZKinematics::GetName(bool forStatusReport) const
 	return (forStatusReport) ? "coreXZ" : "CoreXZ";
 }
 
-// Convert Cartesian coordinates to motor coordinates
-bool CoreXZKinematics::CartesianToMotorSteps(const float machinePos[], const float stepsPerMm[], size_t numVisibleAxes, size_t numTotalAxes, int32_t motorPos[], bool isCoordinated) const
+// Rebuild the core transform matrices from the axis factors:
+//   motorX = fX*x + fZ*z, motorY = y, motorZ = fX*x - fZ*z
+void CoreXZKinematics::RecalcMatrices()
 {
-	motorPos[X_AXIS] = lrintf(((machinePos[X_AXIS] * axisFactors[X_AXIS]) + (machinePos[Z_AXIS] * axisFactors[Z_AXIS])) * stepsPerMm[X_AXIS]);
-	motorPos[Y_AXIS] = lrintf(machinePos[Y_AXIS] * stepsPerMm[Y_AXIS]);
-	motorPos[Z_AXIS] = lrintf(((machinePos[X_AXIS] * axisFactors[X_AXIS]) - (machinePos[Z_AXIS] * axisFactors[Z_AXIS])) * stepsPerMm[Z_AXIS]);
-
-	for (size_t axis = XYZ_AXES; axis < numVisibleAxes; ++axis)
-	{
-		motorPos[axis] = lrintf(machinePos[axis] * stepsPerMm[axis]);
-	}
-	return true;
-}
-
-// Convert motor coordinates to machine coordinates. Used after homing and after individual motor moves.
-void CoreXZKinematics::MotorStepsToCartesian(const int32_t motorPos[], const float stepsPerMm[], size_t numVisibleAxes, size_t numTotalAxes, float machinePos[]) const
-{
-	// Convert the main axes
-	const float xzStepsMmm = stepsPerMm[X_AXIS] * stepsPerMm[Z_AXIS];
-	machinePos[X_AXIS] = ((motorPos[X_AXIS] * stepsPerMm[Z_AXIS]) + (motorPos[Z_AXIS] * stepsPerMm[X_AXIS]))
-								/(2 * axisFactors[X_AXIS] * xzStepsMmm);
-	machinePos[Y_AXIS] = motorPos[Y_AXIS]/stepsPerMm[Y_AXIS];
-	machinePos[Z_AXIS] = ((motorPos[X_AXIS] * stepsPerMm[Z_AXIS]) - (motorPos[Z_AXIS] * stepsPerMm[X_AXIS]))
-								/(2 * axisFactors[Z_AXIS] * xzStepsMmm);
-
-	// Convert any additional axes linearly
-	for (size_t drive = XYZ_AXES; drive < numVisibleAxes; ++drive)
-	{
-		machinePos[drive] = motorPos[drive]/stepsPerMm[drive];
-	}
+	CoreBaseKinematics::RecalcMatrices();				// set both matrices to the identity
+	forwardMatrix[X_AXIS][X_AXIS] = axisFactors[X_AXIS];
+	forwardMatrix[X_AXIS][Z_AXIS] = axisFactors[Z_AXIS];
+	forwardMatrix[Z_AXIS][X_AXIS] = axisFactors[X_AXIS];
+	forwardMatrix[Z_AXIS][Z_AXIS] = -axisFactors[Z_AXIS];
+	inverseMatrix[X_AXIS][X_AXIS] = inverseMatrix[X_AXIS][Z_AXIS] = 1.0/(2.0 * axisFactors[X_AXIS]);
+	inverseMatrix[Z_AXIS][X_AXIS] = 1.0/(2.0 * axisFactors[Z_AXIS]);
+	inverseMatrix[Z_AXIS][Z_AXIS] = -inverseMatrix[Z_AXIS][X_AXIS];
 }
 
 // Return true if the specified endstop axis uses shared motors.
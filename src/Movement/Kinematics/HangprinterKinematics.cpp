@@ -77,6 +77,8 @@ void HangprinterKinematics::Recalc()
 		  ) * 2;
 	U = (anchorA[2] * P2) + (anchorA[0] * Q * P) + (anchorA[1] * R * P);
 	A = (P2 + fsquare(Q) + fsquare(R)) * 2;
+
+	lineLengthsValid = false;							// the anchors may have moved, so don't use the cached line lengths
 }
 
 // Return the name of the current kinematics
@@ -150,21 +152,43 @@ bool HangprinterKinematics::CartesianToMotorSteps(const float machinePos[], cons
 {
     // Geometry of hangprinter makes fsquare(anchorABC[Z_AXIS] - machinePos[Z_AXIS]) the smallest term in the sum.
     // Starting sum with smallest number gives smallest roundoff error.
-	const float aSquared = LineLengthASquared(machinePos, anchorA);
-	const float bSquared = LineLengthASquared(machinePos, anchorB);
-	const float cSquared = LineLengthASquared(machinePos, anchorC);
-	const float dSquared =    fsquare(machinePos[X_AXIS])
-							+ fsquare(machinePos[Y_AXIS])
-							+ fsquare(anchorDz - machinePos[Z_AXIS]);
-	if (aSquared < 0.0 && bSquared < 0.0 && cSquared < 0.0 && dSquared < 0.0)
+	const float squaredLengths[NumSpools] =
 	{
-		motorPos[A_AXIS] = lrintf(sqrtf(aSquared) * stepsPerMm[A_AXIS]);
-		motorPos[B_AXIS] = lrintf(sqrtf(bSquared) * stepsPerMm[B_AXIS]);
-		motorPos[C_AXIS] = lrintf(sqrtf(cSquared) * stepsPerMm[C_AXIS]);
-		motorPos[D_AXIS] = lrintf(sqrtf(dSquared) * stepsPerMm[D_AXIS]);
-		return true;
+		LineLengthASquared(machinePos, anchorA),
+		LineLengthASquared(machinePos, anchorB),
+		LineLengthASquared(machinePos, anchorC),
+		fsquare(machinePos[X_AXIS]) + fsquare(machinePos[Y_AXIS]) + fsquare(anchorDz - machinePos[Z_AXIS])
+	};
+
+	// Decide whether the previous line lengths are close enough to serve as Newton-Raphson starting guesses for the new ones.
+	// One iteration from a guess within a few millimetres leaves the error far below a motor step on lines this long,
+	// and because each iteration starts from the exact squared length, the error does not accumulate from segment to segment.
+	const bool incremental = lineLengthsValid
+							&&   fsquare(machinePos[X_AXIS] - lastPosition[0])
+							   + fsquare(machinePos[Y_AXIS] - lastPosition[1])
+							   + fsquare(machinePos[Z_AXIS] - lastPosition[2]) < 25.0;
+	for (size_t spool = 0; spool < NumSpools; ++spool)
+	{
+		const float sq = squaredLengths[spool];
+		if (sq <= 0.0)
+		{
+			lineLengthsValid = false;
+			return false;							// the position coincides with an anchor, which should never happen
+		}
+		lastLineLengths[spool] = (incremental)
+									? (lastLineLengths[spool] + sq/lastLineLengths[spool]) * 0.5
+									: sqrtf(sq);
 	}
-	return false;
+	lastPosition[0] = machinePos[X_AXIS];
+	lastPosition[1] = machinePos[Y_AXIS];
+	lastPosition[2] = machinePos[Z_AXIS];
+	lineLengthsValid = true;
+
+	motorPos[A_AXIS] = lrintf(lastLineLengths[A_AXIS] * stepsPerMm[A_AXIS]);
+	motorPos[B_AXIS] = lrintf(lastLineLengths[B_AXIS] * stepsPerMm[B_AXIS]);
+	motorPos[C_AXIS] = lrintf(lastLineLengths[C_AXIS] * stepsPerMm[C_AXIS]);
+	motorPos[D_AXIS] = lrintf(lastLineLengths[D_AXIS] * stepsPerMm[D_AXIS]);
+	return true;
 }
 
 // Convert motor coordinates to machine coordinates. Used after homing and after individual motor moves.
@@ -414,7 +438,11 @@ bool HangprinterKinematics::DoAutoCalibration(size_t numFactors, const RandomPro
 		}
 
 		floatc_t solution[NumHangprinterFactors];
-		normalMatrix.GaussJordan(solution, numFactors);
+		if (!normalMatrix.CholeskySolve(solution, numFactors))
+		{
+			// The normal matrix is positive definite unless the probe points were degenerate, so this fallback should never be needed
+			normalMatrix.GaussJordan(solution, numFactors);
+		}
 
 		if (reprap.Debug(moduleMove))
 		{
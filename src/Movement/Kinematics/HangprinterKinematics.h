@@ -51,10 +51,19 @@ private:
 	void Adjust(size_t numFactors, const floatc_t v[]);									// Perform 3-, 6- or 9-factor adjustment
 	void PrintParameters(StringRef& reply) const;										// Print all the parameters for debugging
 
+	static constexpr size_t NumSpools = 4;					// the number of lines/spools
+
 	float anchorA[3], anchorB[3], anchorC[3];				// XYZ coordinates of the anchors
 	float anchorDz;
 	float printRadius;
 
+	// Cache used by CartesianToMotorSteps to avoid doing four full square roots for every segment. Hangprinter moves are heavily
+	// segmented, so consecutive calls are normally for points less than a millimetre apart and the previous line lengths are
+	// excellent Newton-Raphson starting guesses for the new ones.
+	mutable float lastLineLengths[NumSpools];				// the line lengths we last computed
+	mutable float lastPosition[3];							// the Cartesian position they were computed for
+	mutable bool lineLengthsValid;							// true if the above are valid
+
 	// Derived parameters
 	float printRadiusSquared;
 	float Da2, Db2, Dc2;
@@ -128,31 +128,69 @@ const char* Kinematics::GetHomingFileName(AxesBitmap toBeHomed, AxesBitmap alrea
 	return nullptr;
 }
 
+// Kinematics objects already created, indexed by kinematics type. Changing kinematics normally happens only while
+// config.g is processed, but reprocessing the configuration mid-session can switch back and forth, and repeatedly
+// deleting and recreating the objects would fragment the heap. So each type is created at most once and then recycled.
+static Kinematics *createdKinematics[(unsigned int)KinematicsType::unknown] = { nullptr };
+
 /*static*/ Kinematics *Kinematics::Create(KinematicsType k)
 {
-	switch (k)
+	if (k >= KinematicsType::unknown)
 	{
-	default:
 		return nullptr;
-	case KinematicsType::cartesian:
-		return new CartesianKinematics();
-	case KinematicsType::linearDelta:
-		return new LinearDeltaKinematics();
-	case KinematicsType::coreXY:
-		return new CoreXYKinematics();
-	case KinematicsType::coreXZ:
-		return new CoreXZKinematics();
-	case KinematicsType::scara:
-		return new ScaraKinematics();
-	case KinematicsType::coreXYU:
-		return new CoreXYUKinematics();
-	case KinematicsType::hangprinter:
-		return new HangprinterKinematics();
-	case KinematicsType::polar:
-		return new PolarKinematics();
-	case KinematicsType::coreXYUV:
-		return new CoreXYUVKinematics();
 	}
+
+	Kinematics*& slot = createdKinematics[(unsigned int)k];
+	if (slot == nullptr)
+	{
+		switch (k)
+		{
+		default:
+			return nullptr;
+		case KinematicsType::cartesian:
+			slot = new CartesianKinematics();
+			break;
+		case KinematicsType::linearDelta:
+			slot = new LinearDeltaKinematics();
+			break;
+		case KinematicsType::coreXY:
+			slot = new CoreXYKinematics();
+			break;
+		case KinematicsType::coreXZ:
+			slot = new CoreXZKinematics();
+			break;
+		case KinematicsType::scara:
+			slot = new ScaraKinematics();
+			break;
+		case KinematicsType::coreXYU:
+			slot = new CoreXYUKinematics();
+			break;
+		case KinematicsType::hangprinter:
+			slot = new HangprinterKinematics();
+			break;
+		case KinematicsType::polar:
+			slot = new PolarKinematics();
+			break;
+		case KinematicsType::coreXYUV:
+			slot = new CoreXYUVKinematics();
+			break;
+		}
+	}
+	return slot;
+}
+
+// Return how many kinematics objects have been created, for the diagnostics report
+/*static*/ unsigned int Kinematics::NumCreated()
+{
+	unsigned int count = 0;
+	for (const Kinematics *p : createdKinematics)
+	{
+		if (p != nullptr)
+		{
+			++count;
+		}
+	}
+	return count;
 }
 
 /*static*/ void Kinematics::PrintMatrix(const char* s, const MathMatrix<floatc_t>& m, size_t maxRows, size_t maxCols)
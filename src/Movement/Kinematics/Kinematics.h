@@ -159,10 +159,14 @@ public:
 	// Override this virtual destructor if your constructor allocates any dynamic memory
 	virtual ~Kinematics() { }
 
-	// Factory function to create a particular kinematics object and return a pointer to it.
+	// Factory function to create a particular kinematics object and return a pointer to it. Each type of
+	// kinematics object is created at most once and recycled thereafter, so the returned object must not be deleted.
 	// When adding new kinematics, you will need to extend this function to handle your new kinematics type.
 	static Kinematics *Create(KinematicsType k);
 
+	// Return how many kinematics objects have been created, for the diagnostics report
+	static unsigned int NumCreated();
+
 	// Functions that return information held in this base class
 	KinematicsType GetKinematicsType() const { return type; }
 
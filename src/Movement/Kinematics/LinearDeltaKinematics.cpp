@@ -11,6 +11,7 @@
 #include "Movement/Move.h"
 #include "RepRap.h"
 #include "Storage/FileStore.h"
+#include "Libraries/Math/Isqrt.h"
 
 LinearDeltaKinematics::LinearDeltaKinematics() : Kinematics(KinematicsType::linearDelta, -1.0, 0.0, true)
 {
@@ -64,6 +65,16 @@ void LinearDeltaKinematics::Recalc()
 	Q2 = fsquare(Q);
 	D2 = fsquare(diagonal);
 
+#if DELTA_INTEGER_TRANSFORM
+	// Precompute the scaled-integer versions of the constants used by Transform
+	D2K2 = roundU64((double)D2 * (double)((int64_t)Kd * Kd));
+	for (size_t axis = 0; axis < DELTA_AXES; ++axis)
+	{
+		towerXK[axis] = lrintf(towerX[axis] * Kd);
+		towerYK[axis] = lrintf(towerY[axis] * Kd);
+	}
+#endif
+
 	// Calculate the base carriage height when the printer is homed, i.e. the carriages are at the endstops less the corrections
 	const float tempHeight = diagonal;		// any sensible height will do here
 	float machinePos[DELTA_AXES];
@@ -89,10 +100,22 @@ float LinearDeltaKinematics::Transform(const float machinePos[], size_t axis) co
 	//TODO find a way of returning error if we can't transform the position
 	if (axis < DELTA_AXES)
 	{
+#if DELTA_INTEGER_TRANSFORM
+		// Compute the square root term as a scaled 64-bit integer, avoiding the slow soft-float sqrtf
+		const int32_t dxK = lrintf(machinePos[X_AXIS] * Kd) - towerXK[axis];
+		const int32_t dyK = lrintf(machinePos[Y_AXIS] * Kd) - towerYK[axis];
+		const int64_t sqK2 = (int64_t)D2K2 - ((int64_t)dxK * dxK) - ((int64_t)dyK * dyK);
+		const float sqrtTerm = (sqK2 > 0) ? (float)isqrt64((uint64_t)sqK2) * (1.0/Kd) : 0.0;
+		return sqrtTerm
+			 + machinePos[Z_AXIS]
+			 + (machinePos[X_AXIS] * xTilt)
+			 + (machinePos[Y_AXIS] * yTilt);
+#else
 		return sqrtf(D2 - fsquare(machinePos[X_AXIS] - towerX[axis]) - fsquare(machinePos[Y_AXIS] - towerY[axis]))
 			 + machinePos[Z_AXIS]
 			 + (machinePos[X_AXIS] * xTilt)
 			 + (machinePos[Y_AXIS] * yTilt);
+#endif
 	}
 	else
 	{
@@ -303,7 +326,11 @@ bool LinearDeltaKinematics::DoAutoCalibration(size_t numFactors, const RandomPro
 		}
 
 		floatc_t solution[NumDeltaFactors];
-		normalMatrix.GaussJordan(solution, numFactors);
+		if (!normalMatrix.CholeskySolve(solution, numFactors))
+		{
+			// The normal matrix is positive definite unless the probe points were degenerate, so this fallback should never be needed
+			normalMatrix.GaussJordan(solution, numFactors);
+		}
 
 		if (reprap.Debug(moduleMove))
 		{
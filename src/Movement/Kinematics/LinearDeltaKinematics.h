@@ -16,6 +16,15 @@ constexpr size_t DELTA_A_AXIS = 0;
 constexpr size_t DELTA_B_AXIS = 1;
 constexpr size_t DELTA_C_AXIS = 2;
 
+#if SAM4E || SAM4S || SAME70
+// These processors have a hardware FPU, so the float transform is fast enough
+# define DELTA_INTEGER_TRANSFORM	0
+#else
+// The SAM3X has no FPU, so the square root in the tower position calculation is done in soft-float.
+// Use a scaled 64-bit integer calculation instead, which is much faster via isqrt64.
+# define DELTA_INTEGER_TRANSFORM	1
+#endif
+
 // Class to hold the parameter for a delta machine.
 class LinearDeltaKinematics : public Kinematics
 {
@@ -89,6 +98,13 @@ private:
 	float coreFa, coreFb, coreFc;
     float Q, Q2, D2;
 
+#if DELTA_INTEGER_TRANSFORM
+    static constexpr int32_t Kd = 1024;					// scaling factor for the integer transform, giving about 1um resolution
+    uint64_t D2K2;										// D2 * Kd^2 as an integer
+    int32_t towerXK[DELTA_AXES];						// towerX * Kd as integers
+    int32_t towerYK[DELTA_AXES];						// towerY * Kd as integers
+#endif
+
     bool doneAutoCalibration;							// True if we have done auto calibration
 };
 
@@ -32,6 +32,49 @@ const char *ScaraKinematics::GetName(bool forStatusReport) const
 	return "Scara";
 }
 
+// Look up a value in one of the trig tables, using linear interpolation. The caller must ensure that arg * scale is within the table.
+static inline float TableLookup(const float table[], float arg, float scale)
+{
+	const float scaled = arg * scale;
+	const size_t index = (size_t)scaled;
+	const float frac = scaled - (float)index;
+	return table[index] + (frac * (table[index + 1] - table[index]));
+}
+
+// Table-driven replacement for acosf. We use the identity acos(a) = 2 * asin(sqrt((1 - a)/2)) so that the table only has to cover
+// the region in which asin is well-behaved, instead of the ends of the acos range where its slope becomes infinite.
+// The worst-case error with a 256-entry table is below 0.001 degrees over the whole reachable range.
+float ScaraKinematics::FastAcos(float cosine) const
+{
+	const float a = fabsf(cosine);
+	const float t = sqrtf((1.0f - a) * 0.5f);
+	const float acosA = 2.0f * TableLookup(asinTable, t, (float)AsinTableEntries/AsinTableRange);
+	return (cosine < 0.0f) ? PI - acosA : acosA;
+}
+
+// Table-driven replacement for atan2f. The ratio of the smaller to the larger argument is in 0..1, where atan is well-behaved,
+// and the octant is recovered from the signs and relative magnitudes afterwards.
+float ScaraKinematics::FastAtan2(float y, float x) const
+{
+	const float ax = fabsf(x);
+	const float ay = fabsf(y);
+	const float larger = max<float>(ax, ay);
+	if (larger == 0.0f)
+	{
+		return 0.0f;
+	}
+	float angle = TableLookup(atanTable, min<float>(ax, ay)/larger, (float)AtanTableEntries);
+	if (ay > ax)
+	{
+		angle = (PI * 0.5f) - angle;
+	}
+	if (x < 0.0f)
+	{
+		angle = PI - angle;
+	}
+	return (y < 0.0f) ? -angle : angle;
+}
+
 // Calculate theta, psi and the new arm mode from a target position.
 // If the position is not reachable because it is out of radius limits, set theta and psi to NaN and return false.
 // Otherwise set theta and psi to the required values and return true if they are in range.
@@ -49,7 +92,7 @@ bool ScaraKinematics::CalculateThetaAndPsi(const float machinePos[], bool isCoor
 		return false;		// not reachable
 	}
 
-	psi = acosf(cosPsi);
+	psi = FastAcos(cosPsi);
 	const float sinPsi = sqrtf(square);
 	const float SCARA_K1 = proximalArmLength + distalArmLength * cosPsi;
 	const float SCARA_K2 = distalArmLength * sinPsi;
@@ -63,7 +106,7 @@ bool ScaraKinematics::CalculateThetaAndPsi(const float machinePos[], bool isCoor
 			// The following equations choose arm mode 0 i.e. distal arm rotated anticlockwise relative to proximal arm
 			if (psi >= psiLimits[0] && psi <= psiLimits[1])
 			{
-				theta = atan2f(SCARA_K1 * y - SCARA_K2 * x, SCARA_K1 * x + SCARA_K2 * y);
+				theta = FastAtan2(SCARA_K1 * y - SCARA_K2 * x, SCARA_K1 * x + SCARA_K2 * y);
 				if (theta >= thetaLimits[0] && theta <= thetaLimits[1])
 				{
 					break;
@@ -75,7 +118,7 @@ bool ScaraKinematics::CalculateThetaAndPsi(const float machinePos[], bool isCoor
 			// The following equations choose arm mode 1 i.e. distal arm rotated clockwise relative to proximal arm
 			if ((-psi) >= psiLimits[0] && (-psi) <= psiLimits[1])
 			{
-				theta = atan2f(SCARA_K1 * y + SCARA_K2 * x, SCARA_K1 * x - SCARA_K2 * y);
+				theta = FastAtan2(SCARA_K1 * y + SCARA_K2 * x, SCARA_K1 * x - SCARA_K2 * y);
 				if (theta >= thetaLimits[0] && theta <= thetaLimits[1])
 				{
 					psi = -psi;
@@ -455,6 +498,22 @@ void ScaraKinematics::Recalc()
 	maxRadiusSquared = fsquare(maxRadius);
 
 	cachedX = cachedY = std::numeric_limits<float>::quiet_NaN();		// make sure that the cached values won't match any coordinates
+
+	BuildTrigTables();
+}
+
+// Build the lookup tables that replace the inverse trig library calls in the transform hot path.
+// The tables don't depend on the machine parameters, but building them here means they are ready as soon as the constructor has run.
+void ScaraKinematics::BuildTrigTables()
+{
+	for (size_t i = 0; i < AsinTableEntries + 2; ++i)
+	{
+		asinTable[i] = asinf((float)i * (AsinTableRange/(float)AsinTableEntries));
+	}
+	for (size_t i = 0; i < AtanTableEntries + 2; ++i)
+	{
+		atanTable[i] = atanf((float)i * (1.0f/(float)AtanTableEntries));
+	}
 }
 
 // End
@@ -56,8 +56,17 @@ private:
 	static constexpr const char *HomeDistalFileName = "homedistal.g";
 
 	void Recalc();
+	void BuildTrigTables();
+	float FastAcos(float cosine) const;				// table-driven replacement for acosf in the transform hot path
+	float FastAtan2(float y, float x) const;		// table-driven replacement for atan2f in the transform hot path
 	bool CalculateThetaAndPsi(const float machinePos[], bool isCoordinated, float& theta, float& psi, bool& armMode) const;
 
+	// Sizes of the inverse trig lookup tables. 256 entries keeps the linear interpolation error below 0.001 degrees,
+	// see the comments on FastAcos and FastAtan2. Each table entry is a float, so the two tables cost just over 2Kb of RAM.
+	static constexpr size_t AsinTableEntries = 256;
+	static constexpr float AsinTableRange = 0.7072;	// just above sqrt(0.5), the largest argument FastAcos can generate
+	static constexpr size_t AtanTableEntries = 256;
+
 	// Primary parameters
 	float proximalArmLength;
 	float distalArmLength;
@@ -74,6 +83,11 @@ private:
 	float distalArmLengthSquared;
 	float twoPd;
 
+	// Inverse trig lookup tables, built by Recalc. The extra entry at the end lets the interpolation read one entry
+	// past the largest index that an in-range argument can generate.
+	float asinTable[AsinTableEntries + 2];
+	float atanTable[AtanTableEntries + 2];
+
 	// State variables
 	mutable float cachedX, cachedY, cachedTheta, cachedPsi;
 	mutable bool currentArmMode, cachedArmMode;
@@ -227,7 +227,11 @@ bool ZLeadscrewKinematics::DoAutoCalibration(size_t numFactors, const RandomProb
 	}
 
 	floatc_t solution[MaxLeadscrews];
-	normalMatrix.GaussJordan(solution, numFactors);
+	if (!normalMatrix.CholeskySolve(solution, numFactors))
+	{
+		// The normal matrix is positive definite unless the probe points were degenerate, so this fallback should never be needed
+		normalMatrix.GaussJordan(solution, numFactors);
+	}
 
 	if (reprap.Debug(moduleMove))
 	{
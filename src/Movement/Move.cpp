@@ -7,11 +7,28 @@
 
 #include "Move.h"
 #include "Platform.h"
+#include "PrintMonitor.h"
+
+#ifdef FIXED_KINEMATICS_HEADER
+# include FIXED_KINEMATICS_HEADER
+#endif
 
 static constexpr uint32_t UsualMinimumPreparedTime = DDA::stepClockRate/10;			// 100ms
 static constexpr uint32_t AbsoluteMinimumPreparedTime = DDA::stepClockRate/20;		// 50ms
 
-Move::Move() : currentDda(nullptr), active(false), scheduledMoves(0), completedMoves(0)
+// Preparing a move involves a lot of floating point arithmetic, so preparing many moves in one Spin() call starves the network
+// and GCode processing and causes stutter on prints with many short segments. Once we have the absolute minimum of prepared
+// moves in hand, we prepare at most this many more per Spin() call and rely on being called again soon.
+static constexpr unsigned int MaxMovesToPreparePerSpin = 1;
+
+// How much never-used RAM we insist on keeping in hand when growing the DDA ring, to leave room for stack growth and
+// for objects that other modules allocate after config.g has run (e.g. network buffers)
+static constexpr uint32_t QueueGrowthRamToReserve = 2048;
+
+// FreezePrint must leave at least this many entries in the ring for the pause and resume macros to park the head with
+static constexpr unsigned int MinRingEntriesForParking = 6;
+
+Move::Move() : ddaRingLength(DdaRingLength), currentDda(nullptr), active(false), positionChangeCount(0), scheduledMoves(0), completedMoves(0)
 {
 	kinematics = Kinematics::Create(KinematicsType::cartesian);			// default to Cartesian
 
@@ -49,6 +66,9 @@ void Move::Init()
 	SetIdentityTransform();
 	tanXY = tanYZ = tanXZ = 0.0;
 
+	liveCoordinatesSequence = 0;
+	cachedLiveSequence = 0xFFFFFFFF;						// invalidate the transformed coordinates cache
+
 	// Put the origin on the lookahead ring with default velocity in the previous position to the first one that will be used.
 	// Do this by calling SetLiveCoordinates and SetPositions, so that the motor coordinates will be correct too even on a delta.
 	{
@@ -78,12 +98,75 @@ void Move::Init()
 
 	simulationMode = 0;
 	simulationTime = 0.0;
+	simTransformClocks = simLookaheadClocks = simPrepareClocks = 0;
 	longestGcodeWaitInterval = 0;
 	specialMoveAvailable = false;
+	frozenMovesHead = frozenMovesTail = nullptr;
+	frozenMoveCount = 0;
+	babyStepPendingZ = 0.0;
+
+	lastPreparedCount = 0;
+	lastPreparedTime = 0;
+	minPreparedTime = INT32_MAX;
+
+	statsSamplesUsed = 0;
+	statsSamplePeriod = MoveStatsSampleInterval;
+	statsActive = false;
 
 	active = true;
 }
 
+// Try to grow the DDA ring to the requested number of entries (M595), growing the DM pool in proportion.
+// The ring can only be grown, never shrunk, because removing entries that moves may have linked to is not safe.
+// Call this only when movement has stopped, so that the ring is empty and we can splice new entries in anywhere.
+// Returns false after setting an explanation in reply if the request could not be honoured in full.
+bool Move::SetQueueLength(unsigned int length, StringRef& reply)
+{
+	if (length < ddaRingLength)
+	{
+		reply.printf("Movement queue length is %u and cannot be reduced", ddaRingLength);
+		return false;
+	}
+
+	const unsigned int dmsPerDda = NumDms/DdaRingLength;
+	unsigned int extra = min<unsigned int>(length, MaxDdaRingLength) - ddaRingLength;
+
+	// Limit the growth to what the never-used RAM can accommodate, keeping some in hand for the stack and late allocations
+	uint32_t neverUsedRam;
+	reprap.GetPlatform().GetStackUsage(nullptr, nullptr, &neverUsedRam);
+	const uint32_t bytesPerEntry = sizeof(DDA) + (dmsPerDda * sizeof(DriveMovement));
+	const uint32_t bytesAvailable = (neverUsedRam > QueueGrowthRamToReserve) ? neverUsedRam - QueueGrowthRamToReserve : 0;
+	if ((uint32_t)extra * bytesPerEntry > bytesAvailable)
+	{
+		extra = bytesAvailable/bytesPerEntry;
+	}
+
+	// Splice the new entries in just after the add pointer. The ring is empty, so they will be used for the moves
+	// after the next one and every slot still fetches its start point from the slot filled in before it.
+	for (unsigned int i = 0; i < extra; ++i)
+	{
+		DDA * const newDda = new DDA(ddaRingAddPointer->GetNext());
+		newDda->SetPrevious(ddaRingAddPointer);
+		newDda->GetNext()->SetPrevious(newDda);
+		ddaRingAddPointer->SetNext(newDda);
+		newDda->Init();
+		++ddaRingLength;
+	}
+	DriveMovement::InitialAllocate(extra * dmsPerDda);
+
+	if (ddaRingLength < min<unsigned int>(length, MaxDdaRingLength))
+	{
+		reply.printf("Insufficient memory to increase movement queue length beyond %u", ddaRingLength);
+		return false;
+	}
+	if (length > MaxDdaRingLength)
+	{
+		reply.printf("Movement queue length is limited to %u entries", MaxDdaRingLength);
+		return false;
+	}
+	return true;
+}
+
 void Move::Exit()
 {
 	Platform::DisableStepInterrupt();
@@ -132,6 +215,14 @@ void Move::Spin()
 			reprap.GetPlatform().LogError(ErrorCode::BadMove);
 		}
 
+		// Accumulate the speed figures for the movement statistics while a print is being recorded
+		if (statsActive)
+		{
+			statsRequestedSpeedSum += ddaRingCheckPointer->GetRequestedSpeed();
+			statsTopSpeedSum += ddaRingCheckPointer->GetTopSpeed();
+			++statsMovesCompleted;
+		}
+
 		// Now release the DMs and check for underrun
 		if (ddaRingCheckPointer->Free())
 		{
@@ -147,7 +238,9 @@ void Move::Spin()
 #endif
 						  ddaRingAddPointer->GetState() == DDA::empty
 					   && ddaRingAddPointer->GetNext()->GetState() != DDA::provisional		// function Prepare needs to access the endpoints in the previous move, so don't change them
-					   && DriveMovement::NumFree() >= (int)DRIVES							// check that we won't run out of DMs
+					   && DriveMovement::NumFree() >= (int)DRIVES							// check that we won't run out of DMs. We must reserve one DM per drive because
+																						// we can't tell how many the next move needs until it has been fetched from GCodes,
+																						// and by then it is too late to refuse it
 					  );
 	if (canAddMove)
 	{
@@ -212,15 +305,30 @@ void Move::Spin()
 						nextMove.coords[drive] += extrusionPending[drive - numAxes];
 					}
 #endif
+					uint32_t phaseStartTime = Platform::GetInterruptClocks();
 					if (nextMove.moveType == 0)
 					{
 						AxisAndBedTransform(nextMove.coords, nextMove.xAxes, nextMove.yAxes, true);
 					}
+					if (simulationMode != 0)
+					{
+						const uint32_t now = Platform::GetInterruptClocks();
+						simTransformClocks += now - phaseStartTime;
+						phaseStartTime = now;
+					}
 					if (ddaRingAddPointer->Init(nextMove, !IsRawMotorMove(nextMove.moveType)))
 					{
+						// Fold any outstanding babystepping into this move before the lookahead sees it
+						if (babyStepPendingZ != 0.0 && nextMove.moveType == 0)
+						{
+							babyStepPendingZ -= ddaRingAddPointer->ApplyBabyStepping(babyStepPendingZ);
+						}
 						ddaRingAddPointer = ddaRingAddPointer->GetNext();
 						idleCount = 0;
-						scheduledMoves++;
+						if (frozenMovesHead == nullptr)
+						{
+							scheduledMoves++;			// don't count parking moves added while the queue is frozen, so that the code queue stays in step with the frozen moves
+						}
 						if (moveState == MoveState::idle || moveState == MoveState::timing)
 						{
 							moveState = MoveState::collecting;
@@ -233,6 +341,10 @@ void Move::Spin()
 							lastStateChangeTime = now;
 						}
 					}
+					if (simulationMode != 0)
+					{
+						simLookaheadClocks += Platform::GetInterruptClocks() - phaseStartTime;
+					}
 #if 0	// see above
 					// Save the amount of extrusion not done
 					for (size_t drive = numAxes; drive < DRIVES; ++drive)
@@ -256,7 +368,12 @@ void Move::Spin()
 			DDA * const dda = ddaRingGetPointer;					// capture volatile variable
 			if (dda->GetState() == DDA::provisional)
 			{
+				const uint32_t prepareStartTime = Platform::GetInterruptClocks();
 				dda->Prepare(simulationMode);
+				if (simulationMode != 0)
+				{
+					simPrepareClocks += Platform::GetInterruptClocks() - prepareStartTime;
+				}
 			}
 			if (dda->GetState() == DDA::frozen)
 			{
@@ -307,21 +424,53 @@ void Move::Spin()
 			}
 		}
 
+		// Record the pipeline occupancy before topping it up, for reporting by M594
+		lastPreparedCount = preparedCount;
+		lastPreparedTime = preparedTime;
+		if (preparedTime < minPreparedTime)
+		{
+			minPreparedTime = preparedTime;
+		}
+
 		// If the number of prepared moves will execute in less than the minimum time, prepare another move.
 		// Try to avoid preparing deceleration-only moves
+		unsigned int movesPrepared = 0;
 		while (st == DDA::provisional
 				&& preparedTime < (int32_t)UsualMinimumPreparedTime		// prepare moves one eighth of a second ahead of when they will be needed
-				&& preparedCount < DdaRingLength/2 - 1					// but don't prepare as much as half the ring
+				&& preparedCount < ddaRingLength/2 - 1					// but don't prepare as much as half the ring
 			  )
 		{
 			if (cdda->IsGoodToPrepare() || preparedTime < (int32_t)AbsoluteMinimumPreparedTime)
 			{
+				const uint32_t prepareStartTime = Platform::GetInterruptClocks();
 				cdda->Prepare(simulationMode);
+				++movesPrepared;
+				if (simulationMode != 0)
+				{
+					simPrepareClocks += Platform::GetInterruptClocks() - prepareStartTime;
+				}
 			}
 			preparedTime += cdda->GetTimeLeft();
 			++preparedCount;
 			cdda = cdda->GetNext();
 			st = cdda->GetState();
+
+			// Once we have enough moves in hand, spread the preparation work over several Spin() calls
+			// so that we don't starve the network and GCode modules
+			if (movesPrepared >= MaxMovesToPreparePerSpin && preparedTime >= (int32_t)AbsoluteMinimumPreparedTime)
+			{
+				break;
+			}
+		}
+
+		// Top up the precomputed step time buffers of the executing move, so that the step ISR rarely has to do a square root
+		if (simulationMode == 0)
+		{
+			DDA * const edda = currentDda;						// capture volatile variable, it may have changed since we copied it earlier
+			if (edda != nullptr && edda->GetState() == DDA::executing)
+			{
+				edda->TopUpStepTimes();
+			}
 		}
 
 		// If we are simulating, simulate completion of the current move
@@ -335,29 +484,48 @@ void Move::Spin()
 		}
 	}
 
+	// Sample the movement pipeline at intervals while a print is running, for the end-of-job report
+	if (simulationMode == 0 && reprap.GetPrintMonitor().IsPrinting())
+	{
+		if (!statsActive)
+		{
+			StartMoveStats();
+		}
+		else if (millis() - lastStatsSampleTime >= statsSamplePeriod)
+		{
+			SampleMoveStats();
+		}
+	}
+	else
+	{
+		statsActive = false;
+	}
+
 	reprap.GetPlatform().ClassReport(longWait);
 }
 
-// Try to push some babystepping through the lookahead queue
+// Accept some babystepping. We no longer walk the ring of queued moves here; the amount is saved and folded into
+// forthcoming moves as they are admitted to the ring, a bounded amount per move, so M290 costs almost nothing even
+// when the ring is full.
 float Move::PushBabyStepping(float amount)
 {
-	return ddaRingAddPointer->AdvanceBabyStepping(amount);
+	babyStepPendingZ += amount;
+	return amount;
 }
 
 // Change the kinematics to the specified type if it isn't already
 // If it is already correct leave its parameters alone.
-// This violates our rule on no dynamic memory allocation after the initialisation phase,
-// however this function is normally called only when M665, M667 and M669 commands in config.g are processed.
+// Kinematics::Create recycles previously-created objects, so switching kinematics allocates memory at most
+// once per type and repeated configuration changes cannot fragment the heap.
 bool Move::SetKinematics(KinematicsType k)
 {
 	if (kinematics->GetKinematicsType() != k)
 	{
-		Kinematics *nk = Kinematics::Create(k);
+		Kinematics * const nk = Kinematics::Create(k);
 		if (nk == nullptr)
 		{
 			return false;
 		}
-		delete kinematics;
 		kinematics = nk;
 	}
 	return true;
@@ -404,35 +572,44 @@ bool Move::PausePrint(RestorePoint& rp)
 	// In general, we can pause after a move if it is the last segment and its end speed is slow enough.
 	// We can pause before a move if it is the first segment in that move.
 
-	const DDA * const savedDdaRingAddPointer = ddaRingAddPointer;
-	bool pauseOkHere;
+	++positionChangeCount;								// we may truncate the ring, so make GCodes re-fetch the position
 
-	cpu_irq_disable();
-	DDA *dda = currentDda;
-	if (dda == nullptr)
-	{
-		pauseOkHere = true;								// no move was executing, so we have already paused here whether it was a good idea or not.
-		dda = ddaRingGetPointer;
-	}
-	else
-	{
-		pauseOkHere = dda->CanPauseAfter();
-		dda = dda->GetNext();
-	}
+	DDA * const savedDdaRingAddPointer = ddaRingAddPointer;
+	bool pauseOkHere;
+	DDA *dda;
 
-	while (dda != savedDdaRingAddPointer)
+	// Walk the ring without disabling interrupts, so that we don't disturb the step timing of the move being executed.
+	// The step ISR is the only other party that changes the ring state, and it increments completedMoves whenever it does;
+	// so if that count is unchanged after the walk, we know we acted on a consistent snapshot. Otherwise walk again.
+	uint32_t movesCompletedAtStart;
+	do
 	{
-		if (pauseOkHere && dda->CanPauseBefore())
+		movesCompletedAtStart = completedMoves;
+		ddaRingAddPointer = savedDdaRingAddPointer;		// undo any speculative truncation made by a previous iteration
+		dda = currentDda;
+		if (dda == nullptr)
 		{
-			// We can pause before executing this move
-			ddaRingAddPointer = dda;
-			break;
+			pauseOkHere = true;							// no move was executing, so we have already paused here whether it was a good idea or not.
+			dda = ddaRingGetPointer;
+		}
+		else
+		{
+			pauseOkHere = dda->CanPauseAfter();
+			dda = dda->GetNext();
 		}
-		pauseOkHere = dda->CanPauseAfter();
-		dda = dda->GetNext();
-	}
 
-	cpu_irq_enable();
+		while (dda != savedDdaRingAddPointer)
+		{
+			if (pauseOkHere && dda->CanPauseBefore())
+			{
+				// We can pause before executing this move
+				ddaRingAddPointer = dda;
+				break;
+			}
+			pauseOkHere = dda->CanPauseAfter();
+			dda = dda->GetNext();
+		}
+	} while (completedMoves != movesCompletedAtStart);
 
 	// We may be going to skip some moves. Get the end coordinate of the previous move.
 	DDA * const prevDda = ddaRingAddPointer->GetPrevious();
@@ -472,11 +649,198 @@ bool Move::PausePrint(RestorePoint& rp)
 	return true;
 }
 
+// Pause the print without discarding the work already done on the queued moves, returning true if we succeeded.
+// PausePrint (above) frees every move it skips, which throws away the lookahead and preparation already done on them and
+// requires them to be re-read from the file and replayed when the print is resumed. Instead we unlink the skippable moves
+// from the ring as a unit, let the pause and resume macros park the head using ordinary moves through the shortened ring,
+// and on resuming ThawPrint splices the unit back in exactly as it was.
+// On return true, 'rp' describes the first frozen move in the same way that PausePrint describes the first skipped move.
+// The caller only needs that information if we lose power while paused and have to resurrect the print, because the frozen
+// moves do not survive a reset; a live resume re-arms them instead of replaying them.
+// On return false the ring has not been touched and the caller should fall back to PausePrint.
+bool Move::FreezePrint(RestorePoint& rp)
+{
+	++positionChangeCount;								// we may unlink moves from the ring, so make GCodes re-fetch the position
+
+	DDA * const savedDdaRingAddPointer = ddaRingAddPointer;
+	DDA *firstFrozen;
+	unsigned int numToFreeze;
+	uint32_t movesCompletedAtStart;
+
+	for (;;)
+	{
+		// Find the first move we could pause before, using the same consistent-snapshot protocol as PausePrint
+		do
+		{
+			movesCompletedAtStart = completedMoves;
+			firstFrozen = nullptr;
+			DDA *dda = currentDda;
+			bool pauseOkHere;
+			if (dda == nullptr)
+			{
+				pauseOkHere = true;
+				dda = ddaRingGetPointer;
+			}
+			else
+			{
+				pauseOkHere = dda->CanPauseAfter();
+				dda = dda->GetNext();
+			}
+
+			while (dda != savedDdaRingAddPointer)
+			{
+				if (pauseOkHere && dda->CanPauseBefore())
+				{
+					firstFrozen = dda;
+					break;
+				}
+				pauseOkHere = dda->CanPauseAfter();
+				dda = dda->GetNext();
+			}
+		} while (completedMoves != movesCompletedAtStart);
+
+		if (firstFrozen == nullptr)
+		{
+			return false;											// there is no pause boundary in the queue, so there is nothing to freeze
+		}
+
+		// Count the moves we would freeze and check that the shortened ring leaves the parking moves enough room to work in
+		numToFreeze = 0;
+		for (const DDA *dda = firstFrozen; dda != savedDdaRingAddPointer; dda = dda->GetNext())
+		{
+			++numToFreeze;
+		}
+		if (ddaRingLength - numToFreeze < MinRingEntriesForParking)
+		{
+			return false;
+		}
+
+		// Moves at the head of the frozen section may already have been prepared, in which case they keep their drive
+		// movements while frozen; so make sure the parking moves will still have enough
+		if (DriveMovement::NumFree() < (int)(2 * DRIVES))
+		{
+			return false;
+		}
+
+		// The step ISR may have moved on since we walked the ring, so re-check the snapshot with interrupts disabled and
+		// walk again if it has. If the ISR has started the first move we meant to freeze then keep re-walking until that
+		// move completes, which will move the boundary on.
+		cpu_irq_disable();
+		if (completedMoves == movesCompletedAtStart && currentDda != firstFrozen)
+		{
+			break;													// interrupts remain disabled
+		}
+		cpu_irq_enable();
+	}
+
+	// Unlink the frozen section from the ring. The entries keep their own links to each other and are re-attached by
+	// ThawPrint, so the moves in them keep their endpoints, lookahead results and any preparation already done.
+	DDA * const ddaBeforeFrozen = firstFrozen->GetPrevious();
+	frozenMovesHead = firstFrozen;
+	frozenMovesTail = savedDdaRingAddPointer->GetPrevious();
+	frozenMoveCount = numToFreeze;
+	ddaBeforeFrozen->SetNext(savedDdaRingAddPointer);
+	savedDdaRingAddPointer->SetPrevious(ddaBeforeFrozen);
+
+	// If no move was executing then the get pointer may be at the first frozen move, because the boundary walk
+	// starts there in that case. Keep it (and the check pointer) in the shortened ring, else the next Spin would
+	// start executing the supposedly frozen moves.
+	if (ddaRingGetPointer == firstFrozen)
+	{
+		ddaRingGetPointer = savedDdaRingAddPointer;
+	}
+	if (ddaRingCheckPointer == firstFrozen)
+	{
+		ddaRingCheckPointer = savedDdaRingAddPointer;
+	}
+
+	// Take the frozen moves out of the scheduled count while they are parked, so that codes queued behind moves still in
+	// flight are released as those moves complete, but codes queued behind the frozen moves wait until after we resume
+	scheduledMoves -= numToFreeze;
+	cpu_irq_enable();
+
+	// Get the coordinates at which we are pausing from the end of the move before the frozen section
+	const size_t numVisibleAxes = reprap.GetGCodes().GetVisibleAxes();
+	for (size_t axis = 0; axis < numVisibleAxes; ++axis)
+	{
+		rp.moveCoords[axis] = ddaBeforeFrozen->GetEndCoordinate(axis, false);
+	}
+
+	InverseAxisAndBedTransform(rp.moveCoords, ddaBeforeFrozen->GetXAxes(), ddaBeforeFrozen->GetYAxes());	// we assume that xAxes hasn't changed between the moves
+
+	rp.proportionDone = frozenMovesHead->GetProportionDone(false);
+	rp.feedRate = frozenMovesHead->GetRequestedSpeed();
+	rp.virtualExtruderPosition = frozenMovesHead->GetVirtualExtruderPosition();
+	rp.filePos = frozenMovesHead->GetFilePosition();
+
+#if SUPPORT_IOBITS
+	rp.ioBits = frozenMovesHead->GetIoBits();
+#endif
+
+	return true;
+}
+
+// Splice the moves that FreezePrint unlinked back into the ring and re-arm them.
+// Call this only when movement has stopped and the head has been moved back to the coordinates at which FreezePrint paused it,
+// so that the ring is empty and the frozen moves carry straight on from the machine position.
+void Move::ThawPrint()
+{
+	if (frozenMovesHead != nullptr)
+	{
+		cpu_irq_disable();
+		DDA * const insertPoint = ddaRingGetPointer;				// movement has stopped, so this equals the add pointer
+		frozenMovesHead->SetPrevious(insertPoint->GetPrevious());
+		insertPoint->GetPrevious()->SetNext(frozenMovesHead);
+		frozenMovesTail->SetNext(insertPoint);
+		insertPoint->SetPrevious(frozenMovesTail);
+		ddaRingGetPointer = frozenMovesHead;
+		if (ddaRingCheckPointer == insertPoint)
+		{
+			ddaRingCheckPointer = frozenMovesHead;					// the frozen moves must pass under the check pointer to get their DMs released when they complete
+		}
+		scheduledMoves += frozenMoveCount;							// the frozen moves count as scheduled again, so the codes queued behind them get released as they complete
+		frozenMovesHead = frozenMovesTail = nullptr;
+		frozenMoveCount = 0;
+		cpu_irq_enable();
+	}
+}
+
+// Throw away the moves that FreezePrint unlinked, because the print has been cancelled instead of resumed.
+// The freed entries are spliced back in just after the add pointer, where they are out of the way of any moves still completing.
+// The frozen moves were already removed from the scheduled count when they were frozen, so the move counters need no adjustment.
+void Move::DiscardFrozenMoves()
+{
+	if (frozenMovesHead != nullptr)
+	{
+		DDA *dda = frozenMovesHead;
+		for (;;)
+		{
+			(void)dda->Free();
+			if (dda == frozenMovesTail)
+			{
+				break;
+			}
+			dda = dda->GetNext();
+		}
+
+		cpu_irq_disable();
+		frozenMovesTail->SetNext(ddaRingAddPointer->GetNext());
+		ddaRingAddPointer->GetNext()->SetPrevious(frozenMovesTail);
+		ddaRingAddPointer->SetNext(frozenMovesHead);
+		frozenMovesHead->SetPrevious(ddaRingAddPointer);
+		frozenMovesHead = frozenMovesTail = nullptr;
+		frozenMoveCount = 0;
+		cpu_irq_enable();
+	}
+}
+
 #if HAS_VOLTAGE_MONITOR
 
 // Pause the print immediately, returning true if we were able to skip or abort any moves and setting up to the move we aborted
 bool Move::LowPowerPause(RestorePoint& rp)
 {
+	++positionChangeCount;								// we may abort or skip moves, so make GCodes re-fetch the position
+
 	const DDA * const savedDdaRingAddPointer = ddaRingAddPointer;
 	bool abortedMove = false;
 
@@ -560,9 +924,34 @@ void Move::Diagnostics(MessageType mtype)
 {
 	Platform& p = reprap.GetPlatform();
 	p.Message(mtype, "=== Move ===\n");
-	p.MessageF(mtype, "MaxReps: %" PRIu32 ", StepErrors: %u, LaErrors: %u, FreeDm: %d, MinFreeDm %d, MaxWait: %" PRIu32 "ms, Underruns: %u, %u\n",
-						DDA::maxReps, stepErrors, numLookaheadErrors, DriveMovement::NumFree(), DriveMovement::MinFree(), longestGcodeWaitInterval, numLookaheadUnderruns, numPrepareUnderruns);
+	p.MessageF(mtype, "MaxReps: %" PRIu32 ", StepErrors: %u, LaErrors: %u, FreeDm: %d, MinFreeDm %d, MaxDmsPerMove: %" PRIu32 ", MaxWait: %" PRIu32 "ms, Underruns: %u, %u\n",
+						DDA::maxReps, stepErrors, numLookaheadErrors, DriveMovement::NumFree(), DriveMovement::MinFree(), DDA::maxDmsPerMove, longestGcodeWaitInterval, numLookaheadUnderruns, numPrepareUnderruns);
+	p.MessageF(mtype, "Lookahead: %" PRIu32 " DDAs examined, %" PRIu32 " recalculated\n", DDA::laDdasExamined, DDA::laDdasRecalculated);
+	DDA::laDdasExamined = DDA::laDdasRecalculated = 0;
+
+	// Report the step ISR latency histogram. Bucket N counts ISR entries that ran between 2^N and 2^(N+1) step clocks late.
+	p.Message(mtype, "Step ISR latency histogram:");
+	for (size_t i = 0; i < DDA::NumStepLatencyBuckets; ++i)
+	{
+		p.MessageF(mtype, " %" PRIu32, DDA::stepLatencyHistogram[i]);
+		DDA::stepLatencyHistogram[i] = 0;
+	}
+	p.MessageF(mtype, ", MaxIsrTime: %" PRIu32 "us\n", (uint32_t)(((uint64_t)DDA::maxIsrDuration * 1000000u)/DDA::stepClockRate));
+
+#if DDA_TIME_PHASES
+	// Report how long moves spent being prepared and then waiting in the queue before their first step, in step clocks
+	if (DDA::numPhaseTimedMoves != 0)
+	{
+		p.MessageF(mtype, "Move phase times over %" PRIu32 " moves: prepare %" PRIu32 "/%" PRIu32 "/%" PRIu32 ", queued %" PRIu32 "/%" PRIu32 "/%" PRIu32 " (min/avg/max clocks)\n",
+							DDA::numPhaseTimedMoves,
+							DDA::minPrepareClocks, (uint32_t)(DDA::totalPrepareClocks/DDA::numPhaseTimedMoves), DDA::maxPrepareClocks,
+							DDA::minQueuedClocks, (uint32_t)(DDA::totalQueuedClocks/DDA::numPhaseTimedMoves), DDA::maxQueuedClocks);
+	}
+	DDA::ResetPhaseTimes();
+#endif
+	DDA::maxIsrDuration = 0;
 	DDA::maxReps = 0;
+	DDA::maxDmsPerMove = 0;
 	numLookaheadUnderruns = numPrepareUnderruns = numLookaheadErrors = 0;
 	longestGcodeWaitInterval = 0;
 	DriveMovement::ResetMinFree();
@@ -622,6 +1011,103 @@ void Move::Diagnostics(MessageType mtype)
 #endif
 }
 
+// Report and reset the move preparation pipeline occupancy figures. Called in response to M594.
+void Move::ReportPipelineStats(StringRef& reply)
+{
+	reply.printf("Movement pipeline: %" PRIu32 " moves (%" PRIu32 "ms) prepared",
+					lastPreparedCount, (uint32_t)(((int64_t)max<int32_t>(lastPreparedTime, 0) * 1000)/DDA::stepClockRate));
+	if (minPreparedTime != INT32_MAX)
+	{
+		reply.catf(", min %" PRIu32 "ms since last report", (uint32_t)(((int64_t)max<int32_t>(minPreparedTime, 0) * 1000)/DDA::stepClockRate));
+	}
+	minPreparedTime = INT32_MAX;
+}
+
+// Begin sampling the movement pipeline because a print has started
+void Move::StartMoveStats()
+{
+	statsSamplesUsed = 0;
+	statsSamplePeriod = MoveStatsSampleInterval;
+	lastStatsSampleTime = millis();
+	statsRequestedSpeedSum = statsTopSpeedSum = 0.0;
+	statsMovesCompleted = 0;
+	statsUnderrunsAtLastSample = numPrepareUnderruns;
+	statsActive = true;
+}
+
+// Record one sample of the movement pipeline state. When the buffer is full we merge adjacent pairs of samples
+// and double the sampling interval, so however long the job runs the buffer covers all of it at whatever
+// resolution its size allows.
+void Move::SampleMoveStats()
+{
+	if (statsSamplesUsed == NumMoveStatsSamples)
+	{
+		for (size_t i = 0; i < NumMoveStatsSamples/2; ++i)
+		{
+			const MoveStatsSample& a = statsSamples[2 * i];
+			const MoveStatsSample& b = statsSamples[(2 * i) + 1];
+			const uint32_t moves = (uint32_t)a.movesCompleted + b.movesCompleted;
+			MoveStatsSample& m = statsSamples[i];
+			m.avgRequestedSpeed = (moves == 0) ? 0.0 : ((a.avgRequestedSpeed * a.movesCompleted) + (b.avgRequestedSpeed * b.movesCompleted))/moves;
+			m.avgTopSpeed = (moves == 0) ? 0.0 : ((a.avgTopSpeed * a.movesCompleted) + (b.avgTopSpeed * b.movesCompleted))/moves;
+			m.queuedMoves = (a.queuedMoves + b.queuedMoves + 1)/2;
+			m.preparedMoves = (a.preparedMoves + b.preparedMoves + 1)/2;
+			m.prepareUnderruns = a.prepareUnderruns + b.prepareUnderruns;
+			m.movesCompleted = (uint16_t)min<uint32_t>(moves, 0xFFFF);
+		}
+		statsSamplesUsed = NumMoveStatsSamples/2;
+		statsSamplePeriod *= 2;
+	}
+
+	MoveStatsSample& s = statsSamples[statsSamplesUsed++];
+	const uint32_t scheduled = scheduledMoves, completed = completedMoves;
+	s.queuedMoves = (uint16_t)min<uint32_t>((scheduled > completed) ? scheduled - completed : 0, 0xFFFF);
+	s.preparedMoves = (uint16_t)min<uint32_t>(lastPreparedCount, 0xFFFF);
+
+	// Diagnostics resets the underrun counter, so allow for it having gone backwards since the last sample
+	const unsigned int underruns = numPrepareUnderruns;
+	s.prepareUnderruns = (uint16_t)min<unsigned int>((underruns >= statsUnderrunsAtLastSample) ? underruns - statsUnderrunsAtLastSample : underruns, 0xFFFF);
+	statsUnderrunsAtLastSample = underruns;
+
+	s.movesCompleted = (uint16_t)min<uint32_t>(statsMovesCompleted, 0xFFFF);
+	s.avgRequestedSpeed = (statsMovesCompleted == 0) ? 0.0 : statsRequestedSpeedSum/statsMovesCompleted;
+	s.avgTopSpeed = (statsMovesCompleted == 0) ? 0.0 : statsTopSpeedSum/statsMovesCompleted;
+	statsRequestedSpeedSum = statsTopSpeedSum = 0.0;
+	statsMovesCompleted = 0;
+	lastStatsSampleTime = millis();
+}
+
+// Write the movement statistics sampled during a print to a report file, returning true if successful.
+// The file goes through the normal buffered FileStore path, so the data trickles out via the write-behind
+// buffers instead of holding up the caller.
+bool Move::SaveStatsReport(FileStore *f, const char *jobName) const
+{
+	char bufferSpace[200];
+	StringRef buf(bufferSpace, ARRAY_SIZE(bufferSpace));
+
+	buf.printf("Movement statistics for %s, %" PRIu32 " sec per sample\n", jobName, statsSamplePeriod/1000u);
+	if (!f->Write(buf.Pointer()))
+	{
+		return false;
+	}
+	if (!f->Write("sample,queued,prepared,underruns,moves,requested mm/s,achieved mm/s\n"))
+	{
+		return false;
+	}
+	for (size_t i = 0; i < statsSamplesUsed; ++i)
+	{
+		const MoveStatsSample& s = statsSamples[i];
+		buf.printf("%u,%u,%u,%u,%u,%.1f,%.1f\n",
+					(unsigned int)i, s.queuedMoves, s.preparedMoves, s.prepareUnderruns, s.movesCompleted,
+					(double)s.avgRequestedSpeed, (double)s.avgTopSpeed);
+		if (!f->Write(buf.Pointer()))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
 // Set the current position to be this
 void Move::SetNewPosition(const float positionNow[DRIVES], bool doBedCompensation)
 {
@@ -635,6 +1121,7 @@ void Move::SetNewPosition(const float positionNow[DRIVES], bool doBedCompensatio
 // These are the actual numbers we want in the positions, so don't transform them.
 void Move::SetPositions(const float move[DRIVES])
 {
+	++positionChangeCount;
 	if (DDARingEmpty())
 	{
 		ddaRingAddPointer->GetPrevious()->SetPositions(move, DRIVES);
@@ -667,6 +1154,14 @@ int32_t Move::MotorEndPointToMachine(size_t drive, float coord)
 // This is computationally expensive on a delta or SCARA machine, so only call it when necessary, and never from the step ISR.
 void Move::MotorStepsToCartesian(const int32_t motorPos[], size_t numVisibleAxes, size_t numTotalAxes, float machinePos[]) const
 {
+#ifdef FIXED_KINEMATICS
+	if (kinematics->GetKinematicsType() == FIXED_KINEMATICS_TYPE)
+	{
+		// The qualified call binds statically, so the transform can be inlined here
+		static_cast<const FIXED_KINEMATICS*>(kinematics)->FIXED_KINEMATICS::MotorStepsToCartesian(motorPos, reprap.GetPlatform().GetDriveStepsPerUnit(), numVisibleAxes, numTotalAxes, machinePos);
+		return;
+	}
+#endif
 	kinematics->MotorStepsToCartesian(motorPos, reprap.GetPlatform().GetDriveStepsPerUnit(), numVisibleAxes, numTotalAxes, machinePos);
 }
 
@@ -674,8 +1169,17 @@ void Move::MotorStepsToCartesian(const int32_t motorPos[], size_t numVisibleAxes
 // Used to perform movement and G92 commands.
 bool Move::CartesianToMotorSteps(const float machinePos[MaxAxes], int32_t motorPos[MaxAxes], bool isCoordinated) const
 {
+#ifdef FIXED_KINEMATICS
+	const bool b = (kinematics->GetKinematicsType() == FIXED_KINEMATICS_TYPE)
+					// The qualified call binds statically, so the transform can be inlined here
+					? static_cast<const FIXED_KINEMATICS*>(kinematics)->FIXED_KINEMATICS::CartesianToMotorSteps(machinePos, reprap.GetPlatform().GetDriveStepsPerUnit(),
+														reprap.GetGCodes().GetVisibleAxes(), reprap.GetGCodes().GetTotalAxes(), motorPos, isCoordinated)
+					: kinematics->CartesianToMotorSteps(machinePos, reprap.GetPlatform().GetDriveStepsPerUnit(),
+														reprap.GetGCodes().GetVisibleAxes(), reprap.GetGCodes().GetTotalAxes(), motorPos, isCoordinated);
+#else
 	const bool b = kinematics->CartesianToMotorSteps(machinePos, reprap.GetPlatform().GetDriveStepsPerUnit(),
 														reprap.GetGCodes().GetVisibleAxes(), reprap.GetGCodes().GetTotalAxes(), motorPos, isCoordinated);
+#endif
 	if (reprap.Debug(moduleMove) && reprap.Debug(moduleDda))
 	{
 		if (b)
@@ -692,10 +1196,17 @@ bool Move::CartesianToMotorSteps(const float machinePos[MaxAxes], int32_t motorP
 
 void Move::AxisAndBedTransform(float xyzPoint[MaxAxes], AxesBitmap xAxes, AxesBitmap yAxes, bool useBedCompensation) const
 {
-	AxisTransform(xyzPoint, xAxes, yAxes);
+	AxisAndBedTransform(reinterpret_cast<float (*)[MaxAxes]>(xyzPoint), 1, xAxes, yAxes, useBedCompensation);
+}
+
+// Transform a batch of points in one pass. The compensation constants are loaded just once for the whole batch,
+// which matters when the segmentation or arc generator produces runs of closely-spaced endpoints.
+void Move::AxisAndBedTransform(float points[][MaxAxes], size_t numPoints, AxesBitmap xAxes, AxesBitmap yAxes, bool useBedCompensation) const
+{
+	AxisTransform(points, numPoints, xAxes, yAxes);
 	if (useBedCompensation)
 	{
-		BedTransform(xyzPoint, xAxes, yAxes);
+		BedTransform(points, numPoints, xAxes, yAxes);
 	}
 }
 
@@ -706,24 +1217,30 @@ void Move::InverseAxisAndBedTransform(float xyzPoint[MaxAxes], AxesBitmap xAxes,
 }
 
 // Do the Axis transform BEFORE the bed transform
-void Move::AxisTransform(float xyzPoint[MaxAxes], AxesBitmap xAxes, AxesBitmap yAxes) const
+void Move::AxisTransform(float points[][MaxAxes], size_t numPoints, AxesBitmap xAxes, AxesBitmap yAxes) const
 {
-	// Identify the lowest Y axis
+	// Identify the lowest Y axis. It is the same for every point in the batch, so find it just once.
 	const size_t NumVisibleAxes = reprap.GetGCodes().GetVisibleAxes();
 	for (size_t yAxis = Y_AXIS; yAxis < NumVisibleAxes; ++yAxis)
 	{
 		if (IsBitSet(yAxes, yAxis))
 		{
 			// Found a Y axis. Use this one when correcting the X coordinate.
-			for (size_t axis = 0; axis < NumVisibleAxes; ++axis)
+			// Copy the tangents to locals so that the compiler can keep them in registers across the batch.
+			const float lTanXY = tanXY, lTanXZ = tanXZ, lTanYZ = tanYZ;
+			for (size_t i = 0; i < numPoints; ++i)
 			{
-				if (IsBitSet(xAxes, axis))
-				{
-					xyzPoint[axis] += tanXY*xyzPoint[yAxis] + tanXZ*xyzPoint[Z_AXIS];
-				}
-				if (IsBitSet(yAxes, axis))
+				float * const xyzPoint = points[i];
+				for (size_t axis = 0; axis < NumVisibleAxes; ++axis)
 				{
-					xyzPoint[axis] += tanYZ*xyzPoint[Z_AXIS];
+					if (IsBitSet(xAxes, axis))
+					{
+						xyzPoint[axis] += lTanXY*xyzPoint[yAxis] + lTanXZ*xyzPoint[Z_AXIS];
+					}
+					if (IsBitSet(yAxes, axis))
+					{
+						xyzPoint[axis] += lTanYZ*xyzPoint[Z_AXIS];
+					}
 				}
 			}
 			break;
@@ -758,46 +1275,56 @@ void Move::InverseAxisTransform(float xyzPoint[MaxAxes], AxesBitmap xAxes, AxesB
 }
 
 // Do the bed transform AFTER the axis transform
-void Move::BedTransform(float xyzPoint[MaxAxes], AxesBitmap xAxes, AxesBitmap yAxes) const
+void Move::BedTransform(float points[][MaxAxes], size_t numPoints, AxesBitmap xAxes, AxesBitmap yAxes) const
 {
-	if (!useTaper || xyzPoint[Z_AXIS] < taperHeight)
-	{
-		float zCorrection = 0.0;
-		const size_t numAxes = reprap.GetGCodes().GetVisibleAxes();
-		unsigned int numCorrections = 0;
+	// Copy the constants to locals once so that the compiler can keep them in registers for the whole batch
+	const size_t numAxes = reprap.GetGCodes().GetVisibleAxes();
+	const bool applyTaper = useTaper;
+	const float lTaperHeight = taperHeight;
+	const float lRecipTaperHeight = recipTaperHeight;
+	const bool lUsingMesh = usingMesh;
 
-		// Transform the Z coordinate based on the average correction for each axis used as an X axis.
-		// We are assuming that the tool Y offsets are small enough to be ignored.
-		for (uint32_t xAxis = 0; xAxis < numAxes; ++xAxis)
+	for (size_t i = 0; i < numPoints; ++i)
+	{
+		float * const xyzPoint = points[i];
+		if (!applyTaper || xyzPoint[Z_AXIS] < lTaperHeight)
 		{
-			if (IsBitSet(xAxes, xAxis))
+			float zCorrection = 0.0;
+			unsigned int numCorrections = 0;
+
+			// Transform the Z coordinate based on the average correction for each axis used as an X axis.
+			// We are assuming that the tool Y offsets are small enough to be ignored.
+			for (uint32_t xAxis = 0; xAxis < numAxes; ++xAxis)
 			{
-				const float xCoord = xyzPoint[xAxis];
-				for (uint32_t yAxis = 0; yAxis < numAxes; ++yAxis)
+				if (IsBitSet(xAxes, xAxis))
 				{
-					if (IsBitSet(yAxes, yAxis))
+					const float xCoord = xyzPoint[xAxis];
+					for (uint32_t yAxis = 0; yAxis < numAxes; ++yAxis)
 					{
-						const float yCoord = xyzPoint[yAxis];
-						if (usingMesh)
+						if (IsBitSet(yAxes, yAxis))
 						{
-							zCorrection += heightMap.GetInterpolatedHeightError(xCoord, yCoord);
-						}
-						else
-						{
-							zCorrection += probePoints.GetInterpolatedHeightError(xCoord, yCoord);
+							const float yCoord = xyzPoint[yAxis];
+							if (lUsingMesh)
+							{
+								zCorrection += heightMap.GetInterpolatedHeightError(xCoord, yCoord);
+							}
+							else
+							{
+								zCorrection += probePoints.GetInterpolatedHeightError(xCoord, yCoord);
+							}
+							++numCorrections;
 						}
-						++numCorrections;
 					}
 				}
 			}
-		}
 
-		if (numCorrections > 1)
-		{
-			zCorrection /= numCorrections;			// take an average
-		}
+			if (numCorrections > 1)
+			{
+				zCorrection /= numCorrections;			// take an average
+			}
 
-		xyzPoint[Z_AXIS] += (useTaper) ? (taperHeight - xyzPoint[Z_AXIS]) * recipTaperHeight * zCorrection : zCorrection;
+			xyzPoint[Z_AXIS] += (applyTaper) ? (lTaperHeight - xyzPoint[Z_AXIS]) * lRecipTaperHeight * zCorrection : zCorrection;
+		}
 	}
 }
 
@@ -855,6 +1382,7 @@ void Move::InverseBedTransform(float xyzPoint[MaxAxes], AxesBitmap xAxes, AxesBi
 
 void Move::SetIdentityTransform()
 {
+	++positionChangeCount;
 	probePoints.SetIdentity();
 	heightMap.ClearGridHeights();
 	heightMap.UseHeightMap(false);
@@ -863,6 +1391,7 @@ void Move::SetIdentityTransform()
 
 void Move::SetTaperHeight(float h)
 {
+	++positionChangeCount;
 	useTaper = (h > 1.0);
 	if (useTaper)
 	{
@@ -874,6 +1403,7 @@ void Move::SetTaperHeight(float h)
 // Enable mesh bed compensation
 bool Move::UseMesh(bool b)
 {
+	++positionChangeCount;
 	usingMesh = heightMap.UseHeightMap(b);
 	return usingMesh;
 }
@@ -887,6 +1417,7 @@ void Move::SetAxisCompensation(unsigned int axis, float tangent)
 {
 	if (axis < ARRAY_SIZE(tangents))
 	{
+		++positionChangeCount;
 		tangents[axis] = tangent;
 	}
 }
@@ -957,6 +1488,7 @@ void Move::AdjustMotorPositions(const float_t adjustment[], size_t numMotors)
 	}
 
 	liveCoordinatesValid = false;		// force the live XYZ position to be recalculated
+	++liveCoordinatesSequence;
 }
 
 // This is called from the step ISR when the current move has been completed
@@ -964,6 +1496,7 @@ void Move::CurrentMoveCompleted()
 {
 	// Save the current motor coordinates, and the machine Cartesian coordinates if known
 	liveCoordinatesValid = currentDda->FetchEndPosition(const_cast<int32_t*>(liveEndPoints), const_cast<float *>(liveCoordinates));
+	++liveCoordinatesSequence;
 	const size_t numAxes = reprap.GetGCodes().GetTotalAxes();
 	for (size_t drive = numAxes; drive < DRIVES; ++drive)
 	{
@@ -972,7 +1505,13 @@ void Move::CurrentMoveCompleted()
 	currentDda = nullptr;
 
 	ddaRingGetPointer = ddaRingGetPointer->GetNext();
-	completedMoves++;
+
+	// Parking moves added while the queue is frozen were not counted in scheduledMoves, so don't count their completion either.
+	// Moves that were already in flight when FreezePrint was called are still counted, so that the codes queued after them get released.
+	if (frozenMovesHead == nullptr || completedMoves < scheduledMoves)
+	{
+		completedMoves++;
+	}
 }
 
 // Try to start another move. Must be called with interrupts disabled, to avoid a race condition.
@@ -1021,10 +1560,22 @@ void Move::GetCurrentMachinePosition(float m[MaxAxes], bool disableMotorMapping)
 // Is filament being extruded?
 bool Move::IsExtruding() const
 {
-	cpu_irq_disable();
-	const bool rslt = currentDda != nullptr && currentDda->IsPrintingMove();
-	cpu_irq_enable();
-	return rslt;
+	const DDA * const cdda = currentDda;				// capture volatile variable. The DDA is not recycled until the ring wraps, so this is safe without disabling interrupts.
+	return cdda != nullptr && cdda->IsPrintingMove();
+}
+
+// Ask all the provisional moves in the ring to rescale their speeds when they are prepared. Called when M220 changes the
+// speed factor, so that the change takes effect within the prepared-move horizon instead of only after the whole ring of
+// queued moves has drained. Moves that are already frozen or executing keep their planned speeds.
+void Move::ApplySpeedFactorChange(float ratio)
+{
+	for (DDA *dda = ddaRingGetPointer; dda != ddaRingAddPointer; dda = dda->GetNext())
+	{
+		if (dda->GetState() == DDA::provisional)
+		{
+			dda->RequestSpeedScale(ratio);
+		}
+	}
 }
 
 // Return the transformed machine coordinates
@@ -1041,6 +1592,18 @@ void Move::GetCurrentUserPosition(float m[MaxAxes], uint8_t moveType, AxesBitmap
 // Interrupts are assumed enabled on entry
 void Move::LiveCoordinates(float m[DRIVES], AxesBitmap xAxes, AxesBitmap yAxes)
 {
+	// The status poll calls this several times a second, so if no move has completed since we last did the inverse
+	// transforms, serve the result from the cache instead of repeating them
+	if (liveCoordinatesSequence == cachedLiveSequence && xAxes == cachedLiveXAxes && yAxes == cachedLiveYAxes)
+	{
+		memcpy(m, cachedLiveCoordinates, sizeof(m[0]) * DRIVES);
+		return;
+	}
+
+	// Capture the sequence number before we read the coordinates, so that if a move completes while we are working,
+	// the cache we store is treated as stale on the next call
+	const uint32_t capturedSequence = liveCoordinatesSequence;
+
 	// The live coordinates and live endpoints are modified by the ISR, so be careful to get a self-consistent set of them
 	const size_t numVisibleAxes = reprap.GetGCodes().GetVisibleAxes();		// do this before we disable interrupts
 	const size_t numTotalAxes = reprap.GetGCodes().GetTotalAxes();			// do this before we disable interrupts
@@ -1071,6 +1634,12 @@ void Move::LiveCoordinates(float m[DRIVES], AxesBitmap xAxes, AxesBitmap yAxes)
 		cpu_irq_enable();
 	}
 	InverseAxisAndBedTransform(m, xAxes, yAxes);
+
+	// Store the transformed coordinates in the cache
+	memcpy(cachedLiveCoordinates, m, sizeof(cachedLiveCoordinates));
+	cachedLiveXAxes = xAxes;
+	cachedLiveYAxes = yAxes;
+	cachedLiveSequence = capturedSequence;
 }
 
 // These are the actual numbers that we want to be the coordinates, so don't transform them.
@@ -1082,6 +1651,7 @@ void Move::SetLiveCoordinates(const float coords[DRIVES])
 		liveCoordinates[drive] = coords[drive];
 	}
 	liveCoordinatesValid = true;
+	++liveCoordinatesSequence;
 	EndPointToMachine(coords, const_cast<int32_t *>(liveEndPoints), reprap.GetGCodes().GetVisibleAxes());
 }
 
@@ -1092,6 +1662,7 @@ void Move::ResetExtruderPositions()
 	{
 		liveCoordinates[eDrive] = 0.0;
 	}
+	++liveCoordinatesSequence;
 	cpu_irq_enable();
 }
 
@@ -1125,6 +1696,11 @@ void Move::SetXYBedProbePoint(size_t index, float x, float y)
 	}
 }
 
+bool Move::XYProbeCoordinatesSet(size_t index) const
+{
+	return index < MaxProbePoints && probePoints.XYCoordinatesSet(index);
+}
+
 void Move::SetZBedProbePoint(size_t index, float z, bool wasXyCorrected, bool wasError)
 {
 	if (index >= MaxProbePoints)
@@ -1160,9 +1736,19 @@ void Move::Simulate(uint8_t simMode)
 	if (simMode != 0)
 	{
 		simulationTime = 0.0;
+		simTransformClocks = simLookaheadClocks = simPrepareClocks = 0;
 	}
 }
 
+// Append the wall-clock time spent in each phase of processing moves during the current or most recent simulation
+void Move::AppendSimulationPhaseTimes(StringRef& reply) const
+{
+	reply.catf(", transform time: %.3f sec, lookahead time: %.3f sec, prepare time: %.3f sec",
+				(double)((float)simTransformClocks/DDA::stepClockRate),
+				(double)((float)simLookaheadClocks/DDA::stepClockRate),
+				(double)((float)simPrepareClocks/DDA::stepClockRate));
+}
+
 // Adjust the leadscrews
 // This is only ever called after bed probing, so we can assume that no such move is already pending.
 void Move::AdjustLeadscrews(const floatc_t corrections[])
@@ -1191,6 +1777,25 @@ void Move::SetIdleTimeout(float timeout)
 	idleTimeout = (uint32_t)lrintf(timeout * 1000.0);
 }
 
+// Return true if the motors have been put in idle hold
+bool Move::IsInIdleHold() const
+{
+	return moveState == MoveState::idle;
+}
+
+// Called when G-code activity resumes while the motors are in idle hold. Restore the motor currents
+// now, so that they are already at full current by the time the first move of the new activity is
+// prepared, and restart the idle timing so that we drop back to idle hold if no move follows after all.
+void Move::WakeFromIdleHold()
+{
+	if (moveState == MoveState::idle)
+	{
+		reprap.GetPlatform().WakeDriversFromIdle();
+		lastStateChangeTime = millis();
+		moveState = MoveState::timing;
+	}
+}
+
 // Write settings for resuming the print
 // The GCodes module deals with the head position so all we need worry about is the bed compensation
 // We don't handle random probe point bed compensation, and we assume that if a height map is being used it is the default one.
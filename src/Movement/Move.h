@@ -21,13 +21,25 @@
 // Each DDA needs one DM per drive that it moves.
 // However, DM's are large, so we provide fewer than DRIVES * DdaRingLength of them. The planner checks that enough DMs are available before filling in a new DDA.
 
+// These are the initial sizes; the ring and the DM pool can be grown at run time using M595, subject to available memory.
 #if SAM4E || SAM4S || SAME70
 const unsigned int DdaRingLength = 30;
 const unsigned int NumDms = DdaRingLength * 8;						// suitable for e.g. a delta + 5 input hot end
+const unsigned int MaxDdaRingLength = 100;							// the most that M595 may grow the ring to
 #else
 // We are more memory-constrained on the SAM3X
 const unsigned int DdaRingLength = 20;
 const unsigned int NumDms = DdaRingLength * 5;						// suitable for e.g. a delta + 2-input hot end
+const unsigned int MaxDdaRingLength = 40;							// the most that M595 may grow the ring to
+#endif
+
+// Movement statistics sampling. While a print is running we record the state of the movement pipeline at intervals,
+// so that a report written at the end of the job shows whether the firmware or the GCode limited the speed.
+const uint32_t MoveStatsSampleInterval = 1000;						// initial interval between samples, in milliseconds
+#if SAM4E || SAM4S || SAME70
+const size_t NumMoveStatsSamples = 64;
+#else
+const size_t NumMoveStatsSamples = 32;								// keep the buffer smaller on the SAM3X
 #endif
 
 /**
@@ -53,6 +65,7 @@ public:
 	void SetLiveCoordinates(const float coords[DRIVES]);			// Force the live coordinates (see above) to be these
 	void ResetExtruderPositions();									// Resets the extrusion amounts of the live coordinates
 	void SetXYBedProbePoint(size_t index, float x, float y);		// Record the X and Y coordinates of a probe point
+	bool XYProbeCoordinatesSet(size_t index) const;					// Have the X and Y coordinates of this probe point been defined?
 	void SetZBedProbePoint(size_t index, float z, bool wasXyCorrected, bool wasError); // Record the Z coordinate of a probe point
 	float GetProbeCoordinates(int count, float& x, float& y, bool wantNozzlePosition) const; // Get pre-recorded probe coordinates
 	bool FinishedBedProbing(int sParam, StringRef& reply);			// Calibrate or set the bed equation after probing
@@ -61,16 +74,23 @@ public:
 	void SetIdentityTransform();									// Cancel the bed equation; does not reset axis angle compensation
 	void AxisAndBedTransform(float move[], AxesBitmap xAxes, AxesBitmap yAxes, bool useBedCompensation) const;
 																	// Take a position and apply the bed and the axis-angle compensations
+	void AxisAndBedTransform(float points[][MaxAxes], size_t numPoints, AxesBitmap xAxes, AxesBitmap yAxes, bool useBedCompensation) const;
+																	// Transform a batch of points, loading the compensation constants only once
 	void InverseAxisAndBedTransform(float move[], AxesBitmap xAxes, AxesBitmap yAxes) const;
 																	// Go from a transformed point back to user coordinates
 	float GetTaperHeight() const { return (useTaper) ? taperHeight : 0.0; }
 	void SetTaperHeight(float h);
 	bool UseMesh(bool b);											// Try to enable mesh bed compensation and report the final state
 	bool IsUsingMesh() const { return usingMesh; }					// Return true if we are using mesh compensation
-	float PushBabyStepping(float amount);							// Try to push some babystepping through the lookahead queue
+	float PushBabyStepping(float amount);							// Accept babystepping to be folded into forthcoming moves
+	uint32_t GetPositionChangeCount() const { return positionChangeCount; }	// Used by GCodes to tell whether the position it remembers is still valid
+
+	bool SetQueueLength(unsigned int length, StringRef& reply);		// Try to grow the DDA ring to this many entries (M595)
+	unsigned int GetQueueLength() const { return ddaRingLength; }	// Return the current number of entries in the DDA ring
 
 	void Diagnostics(MessageType mtype);							// Report useful stuff
 	void RecordLookaheadError() { ++numLookaheadErrors; }			// Record a lookahead error
+	void ReportPipelineStats(StringRef& reply);						// Report and reset the move preparation pipeline occupancy figures
 
 	// Kinematics and related functions
 	Kinematics& GetKinematics() const { return *kinematics; }
@@ -97,9 +117,14 @@ public:
 
 	void Simulate(uint8_t simMode);													// Enter or leave simulation mode
 	float GetSimulationTime() const { return simulationTime; }						// Get the accumulated simulation time
+	void AppendSimulationPhaseTimes(StringRef& reply) const;						// Append the wall-clock time spent in each move processing phase while simulating
 	void PrintCurrentDda() const;													// For debugging
 
 	bool PausePrint(RestorePoint& rp);												// Pause the print as soon as we can, returning true if we were able to
+	bool FreezePrint(RestorePoint& rp);												// Pause the print by freezing the queued moves in place, returning true if we were able to
+	void ThawPrint();																// Splice the frozen moves back into the ring; call only when movement has stopped
+	void DiscardFrozenMoves();														// Throw away the frozen moves because the print has been cancelled
+	bool IsFrozen() const { return frozenMovesHead != nullptr; }					// Return true if frozen moves are awaiting ThawPrint or DiscardFrozenMoves
 #if HAS_VOLTAGE_MONITOR
 	bool LowPowerPause(RestorePoint& rp);											// Pause the print immediately, returning true if we were able to
 #endif
@@ -108,6 +133,8 @@ public:
 
 	bool IsExtruding() const;														// Is filament being extruded?
 
+	void ApplySpeedFactorChange(float ratio);										// Rescale the moves already in the queue after M220 changes the speed factor
+
 	uint32_t GetScheduledMoves() const { return scheduledMoves; }					// How many moves have been scheduled?
 	uint32_t GetCompletedMoves() const { return completedMoves; }					// How many moves have been completed?
 	void ResetMoveCounters() { scheduledMoves = completedMoves = 0; }
@@ -116,11 +143,15 @@ public:
 
 	const DDA *GetCurrentDDA() const { return currentDda; }							// Return the DDA of the currently-executing move
 
+	bool IsInIdleHold() const;														// Return true if the motors have been put in idle hold
+	void WakeFromIdleHold();														// Restore motor currents because command activity has resumed
+
 	void AdjustLeadscrews(const floatc_t corrections[]);							// Called by some Kinematics classes to adjust the leadscrews
 
 	int32_t GetAccumulatedExtrusion(size_t extruder);								// Return ands reset the accumulated extrusion amount
 
 	bool WriteResumeSettings(FileStore *f) const;									// Write settings for resuming the print
+	bool SaveStatsReport(FileStore *f, const char *jobName) const;					// Write the movement statistics sampled during a print to a report file
 
 #if HAS_SMART_DRIVERS
 	uint32_t GetStepInterval(size_t axis, uint32_t microstepShift) const;			// Get the current step interval for this axis or extruder
@@ -139,9 +170,9 @@ private:
 	};
 
 	bool StartNextMove(uint32_t startTime) __attribute__ ((hot));								// Start the next move, returning true if Step() needs to be called immediately
-	void BedTransform(float move[MaxAxes], AxesBitmap xAxes, AxesBitmap yAxes) const;			// Take a position and apply the bed compensations
+	void BedTransform(float points[][MaxAxes], size_t numPoints, AxesBitmap xAxes, AxesBitmap yAxes) const;	// Apply the bed compensations to a batch of points
 	void InverseBedTransform(float move[MaxAxes], AxesBitmap xAxes, AxesBitmap yAxes) const;	// Go from a bed-transformed point back to user coordinates
-	void AxisTransform(float move[MaxAxes], AxesBitmap xAxes, AxesBitmap yAxes) const;			// Take a position and apply the axis-angle compensations
+	void AxisTransform(float points[][MaxAxes], size_t numPoints, AxesBitmap xAxes, AxesBitmap yAxes) const;	// Apply the axis-angle compensations to a batch of points
 	void InverseAxisTransform(float move[MaxAxes], AxesBitmap xAxes, AxesBitmap yAxes) const;	// Go from an axis transformed point back to user coordinates
 	void SetPositions(const float move[DRIVES]);												// Force the machine coordinates to be these
 
@@ -149,6 +180,8 @@ private:
 	DDA* DDARingGet();									// Get the next DDA ring entry to be run
 	bool DDARingEmpty() const;							// Anything there?
 
+	unsigned int ddaRingLength;							// the current number of entries in the DDA ring
+
 	DDA* volatile currentDda;
 	DDA* ddaRingAddPointer;
 	DDA* volatile ddaRingGetPointer;
@@ -156,6 +189,13 @@ private:
 
 	bool active;										// Are we live and running?
 	uint8_t simulationMode;								// Are we simulating, or really printing?
+
+	// Wall-clock time spent in each phase of processing moves while simulating, in step clocks. Simulation replays the
+	// file through the normal GCodes/Move path at maximum speed, so these give a breakdown of the firmware-side cost
+	// per phase that can be compared between releases. They are only accumulated while simulating.
+	uint32_t simTransformClocks;						// time spent in the axis and bed transforms
+	uint32_t simLookaheadClocks;						// time spent initialising moves, including the lookahead passes
+	uint32_t simPrepareClocks;							// time spent preparing moves for execution
 	MoveState moveState;								// whether the idle timer is active
 
 	unsigned int numLookaheadUnderruns;					// How many times we have run out of moves to adjust during lookahead
@@ -163,11 +203,49 @@ private:
 	unsigned int numLookaheadErrors;					// How many times our lookahead algorithm failed
 	unsigned int idleCount;								// The number of times Spin was called and had no new moves to process
 	uint32_t longestGcodeWaitInterval;					// the longest we had to wait for a new GCode
+
+	float babyStepPendingZ;								// babystepping accepted but not yet folded into a move
+	uint32_t lastPreparedCount;							// how many prepared or executing moves we had at the last Spin call
+	int32_t lastPreparedTime;							// how many step clocks of prepared movement we had at the last Spin call
+	int32_t minPreparedTime;							// the lowest prepared-time watermark since it was last reported
 	float simulationTime;								// Print time since we started simulating
 
+	// One sample of how busy the movement pipeline was, taken periodically while a print is running
+	struct MoveStatsSample
+	{
+		uint16_t queuedMoves;							// moves in the ring that had not completed when the sample was taken
+		uint16_t preparedMoves;							// of those, how many were prepared or executing
+		uint16_t prepareUnderruns;						// times the step ISR wanted a move that was not yet prepared, during the interval
+		uint16_t movesCompleted;						// how many moves completed during the interval
+		float avgRequestedSpeed;						// mean requested speed of the moves that completed, in mm/sec
+		float avgTopSpeed;								// mean planned top speed of the same moves, in mm/sec
+	};
+
+	void StartMoveStats();								// Begin sampling the movement pipeline because a print has started
+	void SampleMoveStats();								// Record one sample of the movement pipeline state
+
+	MoveStatsSample statsSamples[NumMoveStatsSamples];
+	size_t statsSamplesUsed;							// how many entries of statsSamples are valid
+	uint32_t statsSamplePeriod;							// current interval between samples, in milliseconds
+	uint32_t lastStatsSampleTime;						// when we took the last sample
+	float statsRequestedSpeedSum;						// sum of the requested speeds of moves completed since the last sample
+	float statsTopSpeedSum;								// sum of the planned top speeds of the same moves
+	uint32_t statsMovesCompleted;						// how many moves completed since the last sample
+	unsigned int statsUnderrunsAtLastSample;			// the value of numPrepareUnderruns when we took the last sample
+	bool statsActive;									// true if we are currently sampling
+
 	float extrusionPending[MaxExtruders];				// Extrusion not done due to rounding to nearest step
 	volatile float liveCoordinates[DRIVES];				// The endpoint that the machine moved to in the last completed move
 	volatile bool liveCoordinatesValid;					// True if the XYZ live coordinates are reliable (the extruder ones always are)
+
+	// Cache for LiveCoordinates. The status poll calls it several times a second, so we transform the coordinates once
+	// per change and serve them from the cache in between, guarded by a sequence number that is bumped whenever the
+	// live coordinates change.
+	volatile uint32_t liveCoordinatesSequence;			// incremented whenever the live coordinates change
+	uint32_t positionChangeCount;						// incremented whenever the position or a transform changes other than by completing a queued move
+	uint32_t cachedLiveSequence;						// the sequence number the cache was built from
+	AxesBitmap cachedLiveXAxes, cachedLiveYAxes;		// the axis mappings the cache was built with
+	float cachedLiveCoordinates[DRIVES];				// the transformed user coordinates we last returned
 	volatile int32_t liveEndPoints[DRIVES];				// The XYZ endpoints of the last completed move in motor coordinates
 	volatile int32_t extrusionAccumulators[MaxExtruders]; // Accumulated extruder motor steps
 
@@ -194,6 +272,10 @@ private:
 	uint32_t scheduledMoves;							// Move counters for the code queue
 	volatile uint32_t completedMoves;					// This one is modified by an ISR, hence volatile
 
+	DDA * volatile frozenMovesHead;						// the first of the moves unlinked from the ring by FreezePrint, or nullptr if there are none
+	DDA *frozenMovesTail;								// the last of the moves unlinked from the ring by FreezePrint
+	unsigned int frozenMoveCount;						// how many moves FreezePrint unlinked
+
 	float specialMoveCoords[DRIVES];					// Amounts by which to move individual motors (leadscrew adjustment move)
 	bool specialMoveAvailable;							// True if a leadscrew adjustment move is pending
 };
@@ -10,9 +10,11 @@
 #include "GCodes/GCodeBuffer.h"
 #include "RepRap.h"
 #include "HttpResponder.h"
+#include "NetworkBuffer.h"
 #include "FtpResponder.h"
 #include "TelnetResponder.h"
 #include "Libraries/General/IP4String.h"
+#include "EventTrace.h"
 
 // Define exactly one of the following as 1, the other as zero
 // The PDC seems to be too slow to work reliably without getting transmit underruns, so we use the DMAC now.
@@ -31,6 +33,8 @@
 
 const uint32_t WifiResponseTimeoutMillis = 200;
 const uint32_t WiFiWaitReadyMillis = 100;
+const uint32_t WiFiResetMillis = 50;				// how long we hold the ESP8266 in reset before releasing it
+const uint32_t WiFiBootMillis = 50;					// how long we hold the boot mode pins after releasing reset (see the comments in Spin)
 const uint32_t WiFiStartupMillis = 300;
 const uint32_t WiFiStableMillis = 100;
 
@@ -105,8 +109,10 @@ static inline void DisableEspInterrupt()
 
 Network::Network(Platform& p) : platform(p), nextResponderToPoll(nullptr), uploader(nullptr), currentSocket(0), ftpDataPort(0),
 		state(NetworkState::disabled), requestedMode(WiFiState::disabled), currentMode(WiFiState::disabled), activated(false),
-		espStatusChanged(false), spiTxUnderruns(0), spiRxOverruns(0), serialRunning(false)
+		espStatusChanged(false), whenEspDataReady(0), idleSpinCount(0), spiTxUnderruns(0), spiRxOverruns(0), serialRunning(false)
 {
+	ResetEspLatencyStats();
+
 	for (size_t i = 0; i < NumProtocols; ++i)
 	{
 		portNumbers[i] = DefaultPortNumbers[i];
@@ -131,7 +137,7 @@ void Network::Init()
 	ResetWiFi();
 	longWait = lastTickMillis = millis();
 
-	NetworkBuffer::AllocateBuffers(NetworkBufferCount);
+	NetworkBuffer::AllocateBuffers(NetworkBufferCount, MaxNetworkBufferCount);
 
 	SetIPAddress(DefaultIpAddress, DefaultNetMask, DefaultGateway);
 	strcpy(hostname, HOSTNAME);
@@ -274,20 +280,32 @@ void Network::ReportOneProtocol(Protocol protocol, StringRef& reply) const
 	}
 }
 
+// This is called before config.g is run. Begin the ESP8266 reset/boot sequence speculatively so that its
+// startup waits overlap with configuration file processing. The SPI handshake, which sends the hostname to
+// the module, does not happen until Activate has been called, because config.g may change the hostname.
+void Network::Prepare()
+{
+	if (state == NetworkState::disabled)
+	{
+		Start();
+	}
+}
+
 // This is called at the end of config.g processing.
 // Start the network if it was enabled
 void Network::Activate()
 {
 	if (!activated)
 	{
-		activated = true;
-		if (requestedMode != WiFiState::disabled)
+		activated = true;								// this releases the pre-started module to complete the SPI handshake
+		if (requestedMode == WiFiState::disabled)
 		{
-			Start();
+			Stop();										// put the speculatively-started module back into reset
+			platform.Message(UsbMessage, "Network disabled.\n");
 		}
-		else
+		else if (state == NetworkState::disabled)
 		{
-			platform.Message(UsbMessage, "Network disabled.\n");
+			Start();									// Prepare was not called, so start the module now
 		}
 	}
 }
@@ -305,6 +323,8 @@ bool Network::GetNetworkState(StringRef& reply)
 	case NetworkState::disabled:
 		reply.copy("WiFi module is disabled");
 		break;
+	case NetworkState::resetting:
+	case NetworkState::booting:
 	case NetworkState::starting1:
 	case NetworkState::starting2:
 		reply.copy("WiFi module is being started");
@@ -355,32 +375,14 @@ void Network::Start()
 	// Set our CS input (ESP GPIO15) low ready for booting the ESP. This also clears the transfer ready latch.
 	pinMode(SamCsPin, OUTPUT_LOW);
 
-	// Make sure it has time to reset - no idea how long it needs, but 20ms should be plenty
-	delay(50);
-
-	// Release the reset on the ESP8266
-	StartWiFi();
-
-	// Give it time to sample GPIO0 and GPIO15
-	// GPIO0 has to be held high for sufficient time:
-	// - 10ms is not enough
-	// - 18ms after reset is released, an oscillating signal appears on GPIO0 for 55ms
-	// - so 18ms is probably long enough. Use 50ms for safety.
-	delay(50);
-
-	// Relinquish control of our CS pin so that the ESP can take it over
-	pinMode(SamCsPin, INPUT);
-
-	// Set the data request pin to be an input
-	pinMode(EspTransferRequestPin, INPUT_PULLUP);
-
-	// The ESP takes about 300ms before it starts talking to us, so don't wait for it here, do that in Spin()
+	// The module needs time to reset, then time to sample its boot mode pins after the reset is released.
+	// Those waits are completed in Spin() so that we don't hold up other modules (in particular config.g processing).
 	spiTxUnderruns = spiRxOverruns = 0;
 	reconnectCount = 0;
 	transferAlreadyPendingCount = readyTimeoutCount = responseTimeoutCount = 0;
 
 	lastTickMillis = millis();
-	state = NetworkState::starting1;
+	state = NetworkState::resetting;
 }
 
 // Stop the ESP
@@ -399,6 +401,7 @@ void Network::Stop()
 
 		state = NetworkState::disabled;
 		currentMode = WiFiState::disabled;
+		EventTrace::Record(EventTrace::EventType::networkState, (uint8_t)state, 0);
 	}
 }
 
@@ -409,6 +412,38 @@ void Network::Spin(bool full)
 		// Main state machine.
 		switch (state)
 		{
+		case NetworkState::resetting:
+			// Make sure it has time to reset - no idea how long it needs, but 20ms should be plenty
+			if (millis() - lastTickMillis >= WiFiResetMillis)
+			{
+				// Release the reset on the ESP8266
+				StartWiFi();
+
+				// Give it time to sample GPIO0 and GPIO15
+				// GPIO0 has to be held high for sufficient time:
+				// - 10ms is not enough
+				// - 18ms after reset is released, an oscillating signal appears on GPIO0 for 55ms
+				// - so 18ms is probably long enough. Use 50ms for safety.
+				lastTickMillis = millis();
+				state = NetworkState::booting;
+			}
+			break;
+
+		case NetworkState::booting:
+			if (millis() - lastTickMillis >= WiFiBootMillis)
+			{
+				// Relinquish control of our CS pin so that the ESP can take it over
+				pinMode(SamCsPin, INPUT);
+
+				// Set the data request pin to be an input
+				pinMode(EspTransferRequestPin, INPUT_PULLUP);
+
+				// The ESP takes about 300ms before it starts talking to us
+				lastTickMillis = millis();
+				state = NetworkState::starting1;
+			}
+			break;
+
 		case NetworkState::starting1:
 			{
 				// The ESP toggles CS before it has finished starting up, so don't look at the CS signal too soon
@@ -427,7 +462,9 @@ void Network::Spin(bool full)
 				const uint32_t now = millis();
 				if (digitalRead(SamCsPin) && digitalRead(EspTransferRequestPin) && !digitalRead(APIN_SPI_SCK))
 				{
-					if (now - lastTickMillis >= WiFiStableMillis)
+					// Don't proceed to the handshake until Activate has been called, because the hostname we send
+					// must be the one set by config.g
+					if (now - lastTickMillis >= WiFiStableMillis && activated)
 					{
 						// Setup the SPI controller in slave mode and assign the CS pin to it
 						platform.Message(NetworkInfoMessage, "WiFi module started\n");
@@ -447,6 +484,8 @@ void Network::Spin(bool full)
 							}
 
 							state = NetworkState::active;
+							EventTrace::Record(EventTrace::EventType::networkState, (uint8_t)state, 0);
+							whenEspDataReady = micros();
 							espStatusChanged = true;				// make sure we fetch the current state and enable the ESP interrupt
 						}
 						else
@@ -550,6 +589,11 @@ void Network::Spin(bool full)
 						nr = nr->GetNext();
 					} while (!doneSomething && nr != nextResponderToPoll);
 					nextResponderToPoll = nr;
+
+					if (!doneSomething)
+					{
+						++idleSpinCount;			// record that this Spin call found nothing to do
+					}
 				}
 			}
 			break;
@@ -659,6 +703,8 @@ const char* Network::TranslateNetworkState() const
 	switch (state)
 	{
 	case NetworkState::disabled:		return "disabled";
+	case NetworkState::resetting:
+	case NetworkState::booting:
 	case NetworkState::starting1:
 	case NetworkState::starting2:		return "starting";
 	case NetworkState::active:			return "running";
@@ -672,13 +718,21 @@ void Network::Diagnostics(MessageType mtype)
 	platform.MessageF(mtype, "Network state is %s\n", TranslateNetworkState());
 	platform.MessageF(mtype, "WiFi module is %s\n", TranslateWiFiState(currentMode));
 	platform.MessageF(mtype, "Failed messages: pending %u, notready %u, noresp %u\n", transferAlreadyPendingCount, readyTimeoutCount, responseTimeoutCount);
+	if (espLatencyCount != 0)
+	{
+		platform.MessageF(mtype, "ESP data ready to Spin latency (us): min %" PRIu32 " avg %" PRIu32 " max %" PRIu32 " over %" PRIu32 " transfers\n",
+							espLatencyMin, (uint32_t)(espLatencyTotal/espLatencyCount), espLatencyMax, espLatencyCount);
+	}
+	platform.MessageF(mtype, "Spin calls with no work to do: %" PRIu32 "\n", idleSpinCount);
+	ResetEspLatencyStats();
+	NetworkBuffer::Diagnostics(mtype);
 
 #if 0
 	// The underrun/overrun counters don't work at present
 	platform.MessageF(mtype, "SPI underruns %u, overruns %u\n", spiTxUnderruns, spiRxOverruns);
 #endif
 
-	if (state != NetworkState::disabled && state != NetworkState::starting1 && state != NetworkState::starting2)
+	if (state == NetworkState::active || state == NetworkState::changingMode)
 	{
 		Receiver<NetworkStatusResponse> status;
 		if (SendCommand(NetworkCommand::networkGetStatus, 0, 0, nullptr, 0, status) > 0)
@@ -1022,10 +1076,36 @@ GCodeResult Network::HandleWiFiCode(int mcode, GCodeBuffer &gb, StringRef& reply
 
 void Network::EspRequestsTransfer()
 {
+	whenEspDataReady = micros();		// note when the request arrived, so that Diagnostics can report how quickly Spin services it
 	espStatusChanged = true;
 	DisableEspInterrupt();				// don't allow more interrupts until we have acknowledged this one
 }
 
+// Record the time from the ESP data-ready interrupt to the Spin call that is now servicing it
+void Network::RecordEspLatency()
+{
+	const uint32_t latency = micros() - whenEspDataReady;
+	if (latency < espLatencyMin)
+	{
+		espLatencyMin = latency;
+	}
+	if (latency > espLatencyMax)
+	{
+		espLatencyMax = latency;
+	}
+	espLatencyTotal += latency;
+	++espLatencyCount;
+}
+
+void Network::ResetEspLatencyStats()
+{
+	espLatencyMin = UINT32_MAX;
+	espLatencyMax = 0;
+	espLatencyTotal = 0;
+	espLatencyCount = 0;
+	idleSpinCount = 0;
+}
+
 void Network::SetIPAddress(const uint8_t p_ipAddress[], const uint8_t p_netmask[], const uint8_t p_gateway[])
 {
 	memcpy(ipAddress, p_ipAddress, sizeof(ipAddress));
@@ -1114,6 +1194,19 @@ void Network::UpdateSocketStatus(uint16_t connectedSockets, uint16_t otherEndClo
 	}
 }
 
+// Return which protocol is served on the specified local port
+Protocol Network::GetProtocolByLocalPort(Port port) const
+{
+	for (size_t i = 0; i < NumProtocols; ++i)
+	{
+		if (portNumbers[i] == port)
+		{
+			return (Protocol)i;
+		}
+	}
+	return AnyProtocol;
+}
+
 // Find a responder to process a new connection
 bool Network::FindResponder(Socket *skt, Port localPort)
 {
@@ -1410,8 +1503,9 @@ void Network::SetupSpi()
 // Send a command to the ESP and get the result
 int32_t Network::SendCommand(NetworkCommand cmd, SocketNumber socketNum, uint8_t flags, const void *dataOut, size_t dataOutLength, void* dataIn, size_t dataInLength)
 {
-	if (state == NetworkState::disabled)
+	if (state == NetworkState::disabled || state == NetworkState::resetting || state == NetworkState::booting || state == NetworkState::starting1)
 	{
+		// Either the module is disabled, or it is still booting and the SPI subsystem has not been set up yet
 		if (reprap.Debug(moduleNetwork))
 		{
 			debugPrintf("ResponseNetworkDisabled\n");
@@ -1509,6 +1603,7 @@ int32_t Network::SendCommand(NetworkCommand cmd, SocketNumber socketNum, uint8_t
 		   )
 		{
 			++reconnectCount;
+			EventTrace::Record(EventTrace::EventType::networkState, (uint8_t)state, (uint16_t)reconnectCount);
 		}
 		currentMode = bufferIn.hdr.state;
 		response = bufferIn.hdr.response;
@@ -1553,6 +1648,7 @@ void Network::GetNewStatus()
 	};
 	Receiver<MessageResponse> rcvr;
 
+	RecordEspLatency();
 	espStatusChanged = false;
 	EnableEspInterrupt();
 
@@ -45,6 +45,7 @@ public:
 	Network(Platform& p);
 
 	void Init();
+	void Prepare();
 	void Activate();
 	void Exit();
 	void Spin(bool full);
@@ -90,11 +91,14 @@ public:
 	void SpiInterrupt();
 	void EspRequestsTransfer();
 	void UpdateSocketStatus(uint16_t connectedSockets, uint16_t otherEndClosedSockets);
+	Protocol GetProtocolByLocalPort(Port port) const;
 
 private:
 	enum class NetworkState
 	{
 		disabled,					// WiFi module disabled
+		resetting,					// holding the WiFi module in reset
+		booting,					// reset released, waiting for the module to sample its boot mode pins
 		starting1,					// starting up
 		starting2,					// starting up
 		active,						// running, but not necessarily in the requested mode
@@ -127,6 +131,8 @@ private:
 
 	void SendListenCommand(Port port, Protocol protocol, unsigned int maxConnections);
 	void GetNewStatus();
+	void RecordEspLatency();
+	void ResetEspLatencyStats();
 
 	static const char* TranslateEspResetReason(uint32_t reason);
 
@@ -152,6 +158,14 @@ private:
 	WiFiState currentMode;
 	bool activated;
 	volatile bool espStatusChanged;
+	volatile uint32_t whenEspDataReady;				// set by the data-ready ISR, read when Spin services the request
+
+	// Statistics of how quickly Spin services the ESP data-ready interrupt, reported by Diagnostics and then reset
+	uint32_t espLatencyMin;							// shortest interrupt-to-Spin latency seen, in microseconds
+	uint32_t espLatencyMax;							// longest interrupt-to-Spin latency seen, in microseconds
+	uint64_t espLatencyTotal;						// sum of the latencies, for computing the average
+	uint32_t espLatencyCount;						// how many latencies we have accumulated
+	uint32_t idleSpinCount;							// how many full Spin calls found no work to do
 
 	uint8_t ipAddress[4];
 	uint8_t netmask[4];
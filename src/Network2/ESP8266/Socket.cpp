@@ -11,7 +11,6 @@
 #include "RepRap.h"
 
 const uint32_t FindResponderTimeout = 2000;			// how long we wait for a responder to become available
-const unsigned int MaxBuffersPerSocket = 4;
 
 Socket::Socket() : localPort(0), receivedData(nullptr), state(SocketState::inactive), needsPolling(false)
 {
@@ -234,18 +233,23 @@ void Socket::Poll(bool full)
 }
 
 // Try to receive more incoming data from the socket.
+// The module frequently has several chunks waiting when a file is being uploaded, so rather than read one chunk
+// per poll cycle and leave the rest waiting for the socket's next turn, keep reading until we have taken
+// everything that was reported available or we run out of buffer space.
 void Socket::ReceiveData(uint16_t bytesAvailable)
 {
-	if (bytesAvailable != 0)
+	const unsigned int maxBuffers = NetworkBuffer::FairSharePerSocket();
+	while (bytesAvailable != 0)
 	{
 //		debugPrintf("%u available\n", bytesAvailable);
 		// First see if we already have a buffer with enough room
 		NetworkBuffer *const lastBuffer = NetworkBuffer::FindLast(receivedData);
-		if (lastBuffer != nullptr && (bytesAvailable <= lastBuffer->SpaceLeft() || (lastBuffer->SpaceLeft() != 0 && NetworkBuffer::Count(receivedData) >= MaxBuffersPerSocket)))
+		int32_t ret;
+		if (lastBuffer != nullptr && (bytesAvailable <= lastBuffer->SpaceLeft() || (lastBuffer->SpaceLeft() != 0 && NetworkBuffer::Count(receivedData) >= maxBuffers)))
 		{
 			// Read data into the existing buffer
 			const size_t maxToRead = min<size_t>(lastBuffer->SpaceLeft(), MaxDataLength);
-			const int32_t ret = reprap.GetNetwork().SendCommand(NetworkCommand::connRead, socketNum, 0, nullptr, 0, lastBuffer->UnwrittenData(), maxToRead);
+			ret = reprap.GetNetwork().SendCommand(NetworkCommand::connRead, socketNum, 0, nullptr, 0, lastBuffer->UnwrittenData(), maxToRead);
 			if (ret > 0 && (size_t)ret <= maxToRead)
 			{
 				lastBuffer->dataLength += (size_t)ret;
@@ -254,30 +258,42 @@ void Socket::ReceiveData(uint16_t bytesAvailable)
 					debugPrintf("Received %u bytes\n", (unsigned int)ret);
 				}
 			}
+			else
+			{
+				return;									// read failed, try again next time we are polled
+			}
 		}
-		else if (NetworkBuffer::Count(receivedData) < MaxBuffersPerSocket)
+		else if (NetworkBuffer::Count(receivedData) < maxBuffers)
 		{
-			NetworkBuffer * const buf = NetworkBuffer::Allocate();
-			if (buf != nullptr)
+			NetworkBuffer * const buf = NetworkBuffer::Allocate(reprap.GetNetwork().GetProtocolByLocalPort(localPort));
+			if (buf == nullptr)
 			{
-				const size_t maxToRead = min<size_t>(NetworkBuffer::bufferSize, MaxDataLength);
-				const int32_t ret = reprap.GetNetwork().SendCommand(NetworkCommand::connRead, socketNum, 0, nullptr, 0, buf->Data(), maxToRead);
-				if (ret > 0 && (size_t)ret <= maxToRead)
-				{
-					buf->dataLength = (size_t)ret;
-					NetworkBuffer::AppendToList(&receivedData, buf);
-					if (reprap.Debug(moduleNetwork))
-					{
-						debugPrintf("Received %u bytes\n", (unsigned int)ret);
-					}
-				}
-				else
+//				debugPrintf("no buffer\n");
+				return;
+			}
+			const size_t maxToRead = min<size_t>(NetworkBuffer::bufferSize, MaxDataLength);
+			ret = reprap.GetNetwork().SendCommand(NetworkCommand::connRead, socketNum, 0, nullptr, 0, buf->Data(), maxToRead);
+			if (ret > 0 && (size_t)ret <= maxToRead)
+			{
+				buf->dataLength = (size_t)ret;
+				NetworkBuffer::AppendToList(&receivedData, buf);
+				if (reprap.Debug(moduleNetwork))
 				{
-					buf->Release();
+					debugPrintf("Received %u bytes\n", (unsigned int)ret);
 				}
 			}
-//			else debugPrintf("no buffer\n");
+			else
+			{
+				buf->Release();
+				return;
+			}
 		}
+		else
+		{
+			return;										// all our buffers are full, so leave the rest on the module
+		}
+
+		bytesAvailable = ((uint16_t)ret < bytesAvailable) ? bytesAvailable - (uint16_t)ret : 0;
 	}
 }
 
@@ -28,8 +28,6 @@ const uint32_t ESP_OTP_MAC1 = 0x3ff00054;
 const uint32_t ESP_OTP_MAC2	= 0x3ff00058;
 const uint32_t ESP_OTP_MAC3 = 0x3ff0005c;
 
-const size_t EspFlashBlockSize = 0x0400;			// 1K byte blocks
-
 const uint8_t ESP_IMAGE_MAGIC = 0xe9;
 const uint8_t ESP_CHECKSUM_MAGIC = 0xef;
 
@@ -62,9 +60,10 @@ const char * const resultMessages[] =
 // The ESP8266 supports 921600, 460800, 230400, 115200, 74880 and some lower baud rates.
 // 921600b is not reliable because even though it sometimes succeeds in connecting, we get a bad response during uploading after a few blocks.
 // Probably our UART ISR cannot receive bytes fast enough, perhaps because of the latency of the system tick ISR.
-// 460800b doesn't always manage to connect, but if it does then uploading appears to be reliable.
+// 460800b doesn't always manage to connect, but if it does then uploading appears to be reliable,
+// so we try it first and fall back to lower rates if the connection attempts fail.
 // 230400b always manages to connect.
-static const uint32_t uploadBaudRates[] = { 230400, 115200, 74880, 9600 };
+static const uint32_t uploadBaudRates[] = { 460800, 230400, 115200, 74880, 9600 };
 
 WifiFirmwareUploader::WifiFirmwareUploader(UARTClass& port)
 	: uploadPort(port), uploadFile(nullptr), state(UploadState::idle)
@@ -507,31 +506,27 @@ uint16_t WifiFirmwareUploader::checksum(const uint8_t *data, uint16_t dataLen, u
 	return(cksum);
 }
 
-WifiFirmwareUploader::EspUploadResult WifiFirmwareUploader::flashWriteBlock(uint16_t flashParmVal, uint16_t flashParmMask)
+// Read the next block of the file into the block buffer and compute its checksum, so that it is ready to send.
+// We do this while the ESP is recovering from the previous packet, so that the SD card read is off the critical path.
+WifiFirmwareUploader::EspUploadResult WifiFirmwareUploader::prepareBlock(uint16_t flashParmVal, uint16_t flashParmMask)
 {
 	const uint32_t blkSize = EspFlashBlockSize;
-
-	// Allocate a data buffer for the combined header and block data
-	const uint16_t hdrOfst = 0;
-	const uint16_t dataOfst = 16;
-	const uint16_t blkBufSize = dataOfst + blkSize;
-	uint32_t blkBuf32[blkBufSize/4];
-	uint8_t * const blkBuf = reinterpret_cast<uint8_t*>(blkBuf32);
+	uint8_t * const blkBuf = reinterpret_cast<uint8_t*>(blockBuffer32);
 
 	// Prepare the header for the block
-	putData(blkSize, 4, blkBuf, hdrOfst + 0);
-	putData(uploadBlockNumber, 4, blkBuf, hdrOfst + 4);
-	putData(0, 4, blkBuf, hdrOfst + 8);
-	putData(0, 4, blkBuf, hdrOfst + 12);
+	putData(blkSize, 4, blkBuf, 0);
+	putData(uploadBlockNumber, 4, blkBuf, 4);
+	putData(0, 4, blkBuf, 8);
+	putData(0, 4, blkBuf, 12);
 
 	// Get the data for the block
-	size_t cnt = uploadFile->Read(reinterpret_cast<char *>(blkBuf + dataOfst), blkSize);
+	size_t cnt = uploadFile->Read(reinterpret_cast<char *>(blkBuf + blockDataOffset), blkSize);
 	if (cnt != blkSize)
 	{
 		if (uploadFile->Position() == fileSize)
 		{
 			// partial last block, fill the remainder
-			memset(blkBuf + dataOfst + cnt, 0xff, blkSize - cnt);
+			memset(blkBuf + blockDataOffset + cnt, 0xff, blkSize - cnt);
 		}
 		else
 		{
@@ -540,24 +535,41 @@ WifiFirmwareUploader::EspUploadResult WifiFirmwareUploader::flashWriteBlock(uint
 	}
 
 	// Patch the flash parameters into the first block if it is loaded at address 0
-	if (uploadBlockNumber == 0 && uploadAddress == 0 && blkBuf[dataOfst] == ESP_IMAGE_MAGIC && flashParmMask != 0)
+	if (uploadBlockNumber == 0 && uploadAddress == 0 && blkBuf[blockDataOffset] == ESP_IMAGE_MAGIC && flashParmMask != 0)
 	{
 		// update the Flash parameters
-		uint32_t flashParm = getData(2, blkBuf + dataOfst + 2, 0) & ~(uint32_t)flashParmMask;
-		putData(flashParm | flashParmVal, 2, blkBuf + dataOfst + 2, 0);
+		uint32_t flashParm = getData(2, blkBuf + blockDataOffset + 2, 0) & ~(uint32_t)flashParmMask;
+		putData(flashParm | flashParmVal, 2, blkBuf + blockDataOffset + 2, 0);
 	}
 
 	// Calculate the block checksum
-	uint16_t cksum = checksum(blkBuf + dataOfst, blkSize, ESP_CHECKSUM_MAGIC);
+	blockChecksum = checksum(blkBuf + blockDataOffset, blkSize, ESP_CHECKSUM_MAGIC);
+	blockBufferValid = true;
+	return EspUploadResult::success;
+}
+
+// Send the block in the block buffer, preparing it first if that hasn't been done already
+WifiFirmwareUploader::EspUploadResult WifiFirmwareUploader::flashWriteBlock(uint16_t flashParmVal, uint16_t flashParmMask)
+{
+	if (!blockBufferValid)
+	{
+		const EspUploadResult prepStat = prepareBlock(flashParmVal, flashParmMask);
+		if (prepStat != EspUploadResult::success)
+		{
+			return prepStat;
+		}
+	}
+
 	EspUploadResult stat;
 	for (int i = 0; i < 3; i++)
 	{
-		if ((stat = doCommand(ESP_FLASH_DATA, blkBuf, blkBufSize, cksum, nullptr, blockWriteTimeout)) == EspUploadResult::success)
+		if ((stat = doCommand(ESP_FLASH_DATA, reinterpret_cast<const uint8_t *>(blockBuffer32), blockDataOffset + EspFlashBlockSize, blockChecksum, nullptr, blockWriteTimeout)) == EspUploadResult::success)
 		{
 			break;
 		}
 	}
 
+	blockBufferValid = false;
 	return stat;
 }
 
@@ -663,6 +675,7 @@ void WifiFirmwareUploader::Spin()
 			{
 				MessageF("Uploading file...\n");
 				uploadBlockNumber = 0;
+				blockBufferValid = false;
 				uploadNextPercentToReport = percentToReportIncrement;
 				lastAttemptTime = millis();
 				state = UploadState::uploading;
@@ -696,6 +709,16 @@ void WifiFirmwareUploader::Spin()
 					MessageF("%u%% complete\n", percentComplete);
 					uploadNextPercentToReport += percentToReportIncrement;
 				}
+				if (uploadResult == EspUploadResult::success && uploadBlockNumber < blkCnt)
+				{
+					// Read and checksum the next block now, while the ESP recovers from the last packet
+					uploadResult = prepareBlock(0, 0);
+					if (uploadResult != EspUploadResult::success)
+					{
+						MessageF("Flash block read failed\n");
+						state = UploadState::done;
+					}
+				}
 			}
 			else
 			{
@@ -34,6 +34,8 @@ private:
 	static const unsigned int percentToReportIncrement = 5;		// how often we report % complete
 	static const uint32_t systemParametersAddress = 0x3FE000;	// the address of the system + user parameter area that needs to be cleared when changing SDK version
 	static const uint32_t systemParametersSize = 0x2000;		// the size of the system + user parameter area
+	static const size_t EspFlashBlockSize = 0x0400;				// we send 1K byte blocks
+	static const size_t blockDataOffset = 16;					// size of the ESP_FLASH_DATA header that precedes the data in the block buffer
 
 	// Return codes - this list must be kept in step with the corresponding messages
 	enum class EspUploadResult
@@ -79,6 +81,7 @@ private:
 	EspUploadResult flashBegin(uint32_t addr, uint32_t size);
 	EspUploadResult flashFinish(bool reboot);
 	static uint16_t checksum(const uint8_t *data, uint16_t dataLen, uint16_t cksum);
+	EspUploadResult prepareBlock(uint16_t flashParmVal, uint16_t flashParmMask);
 	EspUploadResult flashWriteBlock(uint16_t flashParmVal, uint16_t flashParmMask);
 	EspUploadResult DoErase(uint32_t address, uint32_t size);
 
@@ -94,6 +97,10 @@ private:
 	UploadState state;
 	EspUploadResult uploadResult;
 	int restartModeOnCompletion;
+
+	uint32_t blockBuffer32[(blockDataOffset + EspFlashBlockSize)/4];	// the next block to be sent, prepared while the ESP recovers from the previous one
+	uint16_t blockChecksum;										// checksum of the data currently in blockBuffer32
+	bool blockBufferValid;										// true if blockBuffer32 holds a block that has not been sent yet
 };
 
 #endif /* SRC_DUETNG_WIFIFIRMWAREUPLOADER_H_ */
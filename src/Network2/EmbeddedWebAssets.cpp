@@ -0,0 +1,55 @@
+/*
+ * EmbeddedWebAssets.cpp
+ *
+ * Web assets stored in spare program flash and served without SD card I/O
+ */
+
+#include "EmbeddedWebAssets.h"
+
+#if SUPPORT_EMBEDDED_WEB_ASSETS
+
+// Return the bundle header, or nullptr if no valid bundle is in flash
+const EmbeddedWebAssets::BundleHeader *EmbeddedWebAssets::GetHeader()
+{
+	const BundleHeader * const hdr = reinterpret_cast<const BundleHeader*>(EmbeddedWebAssetsStart);
+	return (   hdr->magic == BundleMagic
+			&& hdr->version == 1
+			&& hdr->numAssets != 0
+			&& hdr->numAssets <= MaxAssetsSanityLimit
+			&& hdr->totalLength <= EmbeddedWebAssetsEnd - EmbeddedWebAssetsStart
+		   ) ? hdr : nullptr;
+}
+
+// Look up a file by its path relative to /www. Returns true and fills in 'asset' if it is in the bundle.
+bool EmbeddedWebAssets::Find(const char *name, Asset& asset)
+{
+	const BundleHeader * const hdr = GetHeader();
+	if (hdr != nullptr)
+	{
+		const char * const base = reinterpret_cast<const char*>(hdr);
+		const DirectoryEntry *entry = reinterpret_cast<const DirectoryEntry*>(base + sizeof(BundleHeader));
+		for (uint32_t i = 0; i < hdr->numAssets; ++i, ++entry)
+		{
+			if (   entry->nameOffset < hdr->totalLength
+				&& entry->dataOffset + entry->length <= hdr->totalLength
+				&& StringEquals(base + entry->nameOffset, name)
+			   )
+			{
+				asset.data = base + entry->dataOffset;
+				asset.length = entry->length;
+				asset.isZipped = (entry->flags & 1u) != 0;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// How many files the bundle holds, 0 if no valid bundle. Used by the diagnostics report.
+unsigned int EmbeddedWebAssets::NumAssets()
+{
+	const BundleHeader * const hdr = GetHeader();
+	return (hdr != nullptr) ? hdr->numAssets : 0;
+}
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * EmbeddedWebAssets.h
+ *
+ * Web assets stored in spare program flash and served without SD card I/O
+ */
+
+#ifndef SRC_NETWORK2_EMBEDDEDWEBASSETS_H_
+#define SRC_NETWORK2_EMBEDDEDWEBASSETS_H_
+
+#include "RepRapFirmware.h"
+
+#if SUPPORT_EMBEDDED_WEB_ASSETS
+
+// A bundle of compressed DWC files can be appended to the firmware image at EmbeddedWebAssetsStart
+// (see Tools/make_web_bundle.py and the 'webassets' target in the board makefile). Flash is memory
+// mapped on the SAM4E, so the assets are served straight out of it with no SD card I/O at all. If no
+// valid bundle is found in flash, lookups simply fail and the webserver falls back to the SD card.
+class EmbeddedWebAssets
+{
+public:
+	struct Asset
+	{
+		const char *data;			// the file content, directly in flash
+		uint32_t length;			// length of the content in bytes
+		bool isZipped;				// true if the content is gzip-compressed
+	};
+
+	static bool Find(const char *name, Asset& asset);		// Look up a file by its path relative to /www
+	static unsigned int NumAssets();						// How many files the bundle holds, 0 if no valid bundle
+
+private:
+	struct BundleHeader
+	{
+		uint32_t magic;				// identifies a valid bundle
+		uint32_t version;			// layout version, currently 1
+		uint32_t numAssets;			// number of directory entries following the header
+		uint32_t totalLength;		// total length of the bundle including this header
+	};
+
+	struct DirectoryEntry
+	{
+		uint32_t nameOffset;		// offset of the NUL-terminated file name from the start of the bundle
+		uint32_t dataOffset;		// offset of the file content from the start of the bundle
+		uint32_t length;			// length of the content in bytes
+		uint32_t flags;				// bit 0 set if the content is gzip-compressed
+	};
+
+	static const uint32_t BundleMagic = 0x42455744;			// "DWEB" when read as little-endian bytes
+	static const uint32_t MaxAssetsSanityLimit = 1024;		// reject a header claiming more files than this
+
+	static const BundleHeader *GetHeader();					// Return the bundle header, or nullptr if no valid bundle is in flash
+};
+
+#endif
+
+#endif /* SRC_NETWORK2_EMBEDDEDWEBASSETS_H_ */
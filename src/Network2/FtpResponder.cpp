@@ -10,7 +10,7 @@
 #include "Platform.h"
 
 FtpResponder::FtpResponder(NetworkResponder *n) : NetworkResponder(n), dataSocket(nullptr),
-	passivePort(0),	passivePortOpenTime(0), dataBuf(nullptr)
+	passivePort(0),	passivePortOpenTime(0), dataBuf(nullptr), listInProgress(false)
 {
 	strcpy(fileToMove, "");
 }
@@ -220,6 +220,28 @@ void FtpResponder::SendData()
 // We send dataBuf first and then fileBeingSent.
 void FtpResponder::SendPassiveData()
 {
+	// If a directory listing is in progress, append a few more entries to the data buffers each time we are called
+	if (listInProgress)
+	{
+		MassStorage * const massStorage = GetPlatform().GetMassStorage();
+		for (unsigned int i = 0; i < MaxListEntriesPerSpin && listInProgress; ++i)
+		{
+			if (dataBuf == nullptr && !OutputBuffer::Allocate(dataBuf))
+			{
+				break;				// no buffer available, append more entries next time
+			}
+
+			// Example for a typical UNIX-like file list:
+			// "drwxr-xr-x    2 ftp      ftp             0 Apr 11 2013 bin\r\n"
+			const char dirChar = (listFileInfo.isDirectory) ? 'd' : '-';
+			const struct tm * const timeInfo = gmtime(&listFileInfo.lastModified);
+			dataBuf->catf("%crw-rw-rw- 1 ftp ftp %13lu %s %02d %04d %s\r\n",
+					dirChar, listFileInfo.size, massStorage->GetMonthName(timeInfo->tm_mon + 1),
+					timeInfo->tm_mday, timeInfo->tm_year + 1900, listFileInfo.fileName);
+			listInProgress = massStorage->FindNext(listFileInfo, listDir);
+		}
+	}
+
 	// Send our output buffers
 	while (dataBuf != nullptr)
 	{
@@ -265,10 +287,16 @@ void FtpResponder::SendPassiveData()
 	}
 
 	// If we get here then there are no output buffers left to send
+	// If the directory listing hasn't been generated completely yet, wait for the remaining entries
+	if (listInProgress)
+	{
+		return;
+	}
+
 	// If we have a file to send, send it
 	if (fileBeingSent != nullptr && fileBuffer == nullptr)
 	{
-		fileBuffer = NetworkBuffer::Allocate();
+		fileBuffer = NetworkBuffer::Allocate(FtpDataProtocol);
 		if (fileBuffer == nullptr)
 		{
 			return;					// no buffer available, try again later
@@ -343,10 +371,12 @@ void FtpResponder::SendPassiveData()
 // Write some more upload data
 void FtpResponder::DoUpload()
 {
-	// Write incoming data to the file
+	// Move all the data received so far into the file write-behind buffers. Draining the network buffers
+	// completely each time we are polled releases them back to the pool quickly, so the data socket can
+	// keep its receive window open while MassStorage writes the queued buffers out behind us.
 	const uint8_t *buffer;
 	size_t len;
-	if (dataSocket->ReadBuffer(buffer, len))
+	while (dataSocket->ReadBuffer(buffer, len))
 	{
 		if (reprap.Debug(moduleWebserver))
 		{
@@ -675,21 +705,10 @@ void FtpResponder::ProcessLine()
 			outBuf->copy("150 Here comes the directory listing.\r\n");
 			Commit(ResponderState::sendingPasvData);
 
-			// build directory listing, dataBuf is sent later in the Spin loop
-			MassStorage * const massStorage = GetPlatform().GetMassStorage();
-			FileInfo fileInfo;
-			if (massStorage->FindFirst(currentDirectory, fileInfo))
-			{
-				do {
-					// Example for a typical UNIX-like file list:
-					// "drwxr-xr-x    2 ftp      ftp             0 Apr 11 2013 bin\r\n"
-					const char dirChar = (fileInfo.isDirectory) ? 'd' : '-';
-					const struct tm * const timeInfo = gmtime(&fileInfo.lastModified);
-					dataBuf->catf("%crw-rw-rw- 1 ftp ftp %13lu %s %02d %04d %s\r\n",
-							dirChar, fileInfo.size, massStorage->GetMonthName(timeInfo->tm_mon + 1),
-							timeInfo->tm_mday, timeInfo->tm_year + 1900, fileInfo.fileName);
-				} while (massStorage->FindNext(fileInfo));
-			}
+			// Start the directory walk. The listing itself is generated a few entries per Spin call from
+			// SendPassiveData, so that listing a directory with hundreds of files doesn't stall the main
+			// loop or tie up every free output buffer while the data socket drains.
+			listInProgress = GetPlatform().GetMassStorage()->FindFirst(currentDirectory, listFileInfo, listDir);
 		}
 		// switch transfer mode (sends response, but doesn't have any effects)
 		else if (StringStartsWith(clientMessage, "TYPE"))
@@ -899,6 +918,7 @@ void FtpResponder::CloseDataPort()
 
 	OutputBuffer::ReleaseAll(dataBuf);
 	dataBuf = nullptr;
+	listInProgress = false;
 
 	if (fileBeingSent != nullptr)
 	{
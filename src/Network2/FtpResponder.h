@@ -9,6 +9,7 @@
 #define SRC_DUETNG_DUETETHERNET_FTPRESPONDER_H_
 
 #include "NetworkResponder.h"
+#include "Storage/MassStorage.h"
 
 class FtpResponder : public NetworkResponder
 {
@@ -23,6 +24,7 @@ public:
 protected:
 	static const size_t ftpMessageLength = 128;			// maximum line length for incoming FTP commands
 	static const uint32_t ftpPasvPortTimeout = 10000;	// maximum time to wait for an FTP data connection in milliseconds
+	static const unsigned int MaxListEntriesPerSpin = 8;	// how many directory entries we append to a LIST response in one Spin call
 
 	Socket *dataSocket;
 	Port passivePort;
@@ -51,6 +53,14 @@ protected:
 
 	char currentDirectory[FILENAME_LENGTH];
 	char fileToMove[FILENAME_LENGTH];
+
+	// Directory listing state. A LIST response is generated a few entries at a time from SendPassiveData rather
+	// than all at once, so that a large directory neither monopolises the Spin loop nor swallows the whole
+	// output buffer pool. The walk uses caller-owned iterator state because the shared MassStorage iterator
+	// may be reused by other consumers between our Spin calls.
+	bool listInProgress;
+	DIR listDir;
+	FileInfo listFileInfo;
 };
 
 #endif /* SRC_DUETNG_DUETETHERNET_FTPRESPONDER_H_ */
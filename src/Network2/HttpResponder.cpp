@@ -9,6 +9,8 @@
 #include "GCodes/GCodes.h"
 #include "PrintMonitor.h"
 #include "Libraries/General/IP4String.h"
+#include "Libraries/sha1/sha1.h"
+#include "EmbeddedWebAssets.h"
 
 #define KO_START "rr_"
 const size_t KoFirst = 3;
@@ -18,29 +20,111 @@ const char* const badEscapeResponse = "bad escape";
 
 const uint32_t HttpReceiveTimeout = 2000;
 
-HttpResponder::HttpResponder(NetworkResponder *n) : NetworkResponder(n)
+// Return the content type implied by the extension of a file name
+static const char *GetContentType(const char *fileName)
+{
+	if (StringEndsWith(fileName, ".png"))
+	{
+		return "image/png";
+	}
+	if (StringEndsWith(fileName, ".ico"))
+	{
+		return "image/x-icon";
+	}
+	if (StringEndsWith(fileName, ".js"))
+	{
+		return "application/javascript";
+	}
+	if (StringEndsWith(fileName, ".css"))
+	{
+		return "text/css";
+	}
+	if (StringEndsWith(fileName, ".htm") || StringEndsWith(fileName, ".html"))
+	{
+		return "text/html";
+	}
+	if (StringEndsWith(fileName, ".zip"))
+	{
+		return "application/zip";
+	}
+	if (StringEndsWith(fileName, ".g") || StringEndsWith(fileName, ".gc") || StringEndsWith(fileName, ".gcode"))
+	{
+		return "text/plain";
+	}
+	return "application/octet-stream";
+}
+
+// Base64 encode exactly len bytes into buf, which must have room for ((len + 2)/3) * 4 + 1 characters
+static void Base64Encode(const uint8_t *data, size_t len, char *buf)
+{
+	static const char base64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t i = 0;
+	while (i < len)
+	{
+		const uint8_t b0 = data[i];
+		const uint8_t b1 = (i + 1 < len) ? data[i + 1] : 0;
+		const uint8_t b2 = (i + 2 < len) ? data[i + 2] : 0;
+		*buf++ = base64Chars[b0 >> 2];
+		*buf++ = base64Chars[((b0 & 0x03) << 4) | (b1 >> 4)];
+		*buf++ = (i + 1 < len) ? base64Chars[((b1 & 0x0F) << 2) | (b2 >> 6)] : '=';
+		*buf++ = (i + 2 < len) ? base64Chars[b2 & 0x3F] : '=';
+		i += 3;
+	}
+	*buf = 0;
+}
+
+HttpResponder::HttpResponder(NetworkResponder *n) : NetworkResponder(n), parseBuf(nullptr), uploadingGzipped(false), gzipStreamComplete(false), assetBeingSent(nullptr)
 {
 }
 
+// Get a parse buffer from the shared pool, creating a new one if the pool is empty and we are below the limit.
+// The parse buffers are much bigger than the rest of a responder, so they are shared between responders and
+// only held while a connection is open. We can never need more of them than there are responders.
+bool HttpResponder::AcquireParseBuffer()
+{
+	if (parseBuf == nullptr)
+	{
+		if (parseBufferPool != nullptr)
+		{
+			parseBuf = parseBufferPool;
+			parseBufferPool = parseBuf->next;
+		}
+		else if (numParseBuffers < NumHttpResponders)
+		{
+			parseBuf = new HttpParseBuffer;
+			++numParseBuffers;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Return our parse buffer to the shared pool, if we have one
+void HttpResponder::ReleaseParseBuffer()
+{
+	if (parseBuf != nullptr)
+	{
+		parseBuf->next = parseBufferPool;
+		parseBufferPool = parseBuf;
+		parseBuf = nullptr;
+	}
+}
+
 // Ask the responder to accept this connection, returns true if it did
 bool HttpResponder::Accept(Socket *s, Protocol protocol)
 {
 	if (responderState == ResponderState::free && protocol == HttpProtocol)
 	{
-		// Make sure we can get an output buffer before we accept the connection, or we won't be able to reply
-		if (outBuf != nullptr || OutputBuffer::Allocate(outBuf))
+		// Make sure we can get an output buffer and a parse buffer before we accept the connection, or we won't be able to reply
+		if ((outBuf != nullptr || OutputBuffer::Allocate(outBuf)) && AcquireParseBuffer())
 		{
 			responderState = ResponderState::reading;
 			skt = s;
 			timer = millis();
-
-			// Reset the parse state variables
-			clientPointer = 0;
-			parseState = HttpParseState::doingCommandWord;
-			numCommandWords = 0;
-			numQualKeys = 0;
-			numHeaderKeys = 0;
-			commandWords[0] = clientMessage;
+			ResetParser();
 
 			if (reprap.Debug(moduleWebserver))
 			{
@@ -109,6 +193,9 @@ bool HttpResponder::Spin()
 		}
 		return true;
 
+	case ResponderState::webSocketConnected:
+		return DoWebSocket();
+
 	case ResponderState::uploading:
 		DoUpload();
 		return true;
@@ -149,21 +236,21 @@ bool HttpResponder::CharFromClient(char c)
 		switch(c)
 		{
 		case '\n':
-			clientMessage[clientPointer++] = 0;
+			parseBuf->clientMessage[clientPointer++] = 0;
 			++numCommandWords;
 			numHeaderKeys = 0;
-			headers[0].key = clientMessage + clientPointer;
+			parseBuf->headers[0].key = parseBuf->clientMessage + clientPointer;
 			parseState = HttpParseState::doingHeaderKey;
 			break;
 		case '\r':
 			break;
 		case ' ':
 		case '\t':
-			clientMessage[clientPointer++] = 0;
+			parseBuf->clientMessage[clientPointer++] = 0;
 			if (numCommandWords < MaxCommandWords)
 			{
 				++numCommandWords;
-				commandWords[numCommandWords] = clientMessage + clientPointer;
+				parseBuf->commandWords[numCommandWords] = parseBuf->clientMessage + clientPointer;
 				if (numCommandWords == 1)
 				{
 					parseState = HttpParseState::doingFilename;
@@ -176,7 +263,7 @@ bool HttpResponder::CharFromClient(char c)
 			}
 			break;
 		default:
-			clientMessage[clientPointer++] = c;
+			parseBuf->clientMessage[clientPointer++] = c;
 			break;
 		}
 		break;
@@ -185,18 +272,18 @@ bool HttpResponder::CharFromClient(char c)
 		switch(c)
 		{
 		case '\n':
-			clientMessage[clientPointer++] = 0;
+			parseBuf->clientMessage[clientPointer++] = 0;
 			++numCommandWords;
 			numQualKeys = 0;
 			numHeaderKeys = 0;
-			headers[0].key = clientMessage + clientPointer;
+			parseBuf->headers[0].key = parseBuf->clientMessage + clientPointer;
 			parseState = HttpParseState::doingHeaderKey;
 			break;
 		case '?':
-			clientMessage[clientPointer++] = 0;
+			parseBuf->clientMessage[clientPointer++] = 0;
 			++numCommandWords;
 			numQualKeys = 0;
-			qualifiers[0].key = clientMessage + clientPointer;
+			parseBuf->qualifiers[0].key = parseBuf->clientMessage + clientPointer;
 			parseState = HttpParseState::doingQualifierKey;
 			break;
 		case '%':
@@ -206,11 +293,11 @@ bool HttpResponder::CharFromClient(char c)
 			break;
 		case ' ':
 		case '\t':
-			clientMessage[clientPointer++] = 0;
+			parseBuf->clientMessage[clientPointer++] = 0;
 			if (numCommandWords < MaxCommandWords)
 			{
 				++numCommandWords;
-				commandWords[numCommandWords] = clientMessage + clientPointer;
+				parseBuf->commandWords[numCommandWords] = parseBuf->clientMessage + clientPointer;
 				parseState = HttpParseState::doingCommandWord;
 			}
 			else
@@ -220,7 +307,7 @@ bool HttpResponder::CharFromClient(char c)
 			}
 			break;
 		default:
-			clientMessage[clientPointer++] = c;
+			parseBuf->clientMessage[clientPointer++] = c;
 			break;
 		}
 		break;
@@ -229,8 +316,8 @@ bool HttpResponder::CharFromClient(char c)
 		switch(c)
 		{
 		case '=':
-			clientMessage[clientPointer++] = 0;
-			qualifiers[numQualKeys].value = clientMessage + clientPointer;
+			parseBuf->clientMessage[clientPointer++] = 0;
+			parseBuf->qualifiers[numQualKeys].value = parseBuf->clientMessage + clientPointer;
 			++numQualKeys;
 			parseState = HttpParseState::doingQualifierValue;
 			break;
@@ -243,7 +330,7 @@ bool HttpResponder::CharFromClient(char c)
 			RejectMessage("bad qualifier key");
 			return true;
 		default:
-			clientMessage[clientPointer++] = c;
+			parseBuf->clientMessage[clientPointer++] = c;
 			break;
 		}
 		break;
@@ -252,17 +339,17 @@ bool HttpResponder::CharFromClient(char c)
 		switch(c)
 		{
 		case '\n':
-			clientMessage[clientPointer++] = 0;
-			qualifiers[numQualKeys].key = clientMessage + clientPointer;	// so that we can read the whole value even if it contains a null
+			parseBuf->clientMessage[clientPointer++] = 0;
+			parseBuf->qualifiers[numQualKeys].key = parseBuf->clientMessage + clientPointer;	// so that we can read the whole value even if it contains a null
 			numHeaderKeys = 0;
-			headers[0].key = clientMessage + clientPointer;
+			parseBuf->headers[0].key = parseBuf->clientMessage + clientPointer;
 			parseState = HttpParseState::doingHeaderKey;
 			break;
 		case ' ':
 		case '\t':
-			clientMessage[clientPointer++] = 0;
-			qualifiers[numQualKeys].key = clientMessage + clientPointer;	// so that we can read the whole value even if it contains a null
-			commandWords[numCommandWords] = clientMessage + clientPointer;
+			parseBuf->clientMessage[clientPointer++] = 0;
+			parseBuf->qualifiers[numQualKeys].key = parseBuf->clientMessage + clientPointer;	// so that we can read the whole value even if it contains a null
+			parseBuf->commandWords[numCommandWords] = parseBuf->clientMessage + clientPointer;
 			parseState = HttpParseState::doingCommandWord;
 			break;
 		case '\r':
@@ -272,8 +359,8 @@ bool HttpResponder::CharFromClient(char c)
 			break;
 		case '&':
 			// Another variable is coming
-			clientMessage[clientPointer++] = 0;
-			qualifiers[numQualKeys].key = clientMessage + clientPointer;	// so that we can read the whole value even if it contains a null
+			parseBuf->clientMessage[clientPointer++] = 0;
+			parseBuf->qualifiers[numQualKeys].key = parseBuf->clientMessage + clientPointer;	// so that we can read the whole value even if it contains a null
 			if (numQualKeys < MaxQualKeys)
 			{
 				parseState = HttpParseState::doingQualifierKey;
@@ -285,10 +372,10 @@ bool HttpResponder::CharFromClient(char c)
 			}
 			break;
 		case '+':
-			clientMessage[clientPointer++] = ' ';
+			parseBuf->clientMessage[clientPointer++] = ' ';
 			break;
 		default:
-			clientMessage[clientPointer++] = c;
+			parseBuf->clientMessage[clientPointer++] = c;
 			break;
 		}
 		break;
@@ -316,12 +403,12 @@ bool HttpResponder::CharFromClient(char c)
 	case HttpParseState::doingQualifierValueEsc2:
 		if (c >= '0' && c <= '9')
 		{
-			clientMessage[clientPointer++] = decodeChar | (c - '0');
+			parseBuf->clientMessage[clientPointer++] = decodeChar | (c - '0');
 			parseState = (HttpParseState)((int)parseState - 2);
 		}
 		else if (c >= 'A' && c <= 'F')
 		{
-			clientMessage[clientPointer++] = decodeChar | (c - ('A' - 10));
+			parseBuf->clientMessage[clientPointer++] = decodeChar | (c - ('A' - 10));
 			parseState = (HttpParseState)((int)parseState - 2);
 		}
 		else
@@ -335,7 +422,7 @@ bool HttpResponder::CharFromClient(char c)
 		switch(c)
 		{
 		case '\n':
-			if (clientMessage + clientPointer == headers[numHeaderKeys].key)	// if the key hasn't started yet, then this is the blank line at the end
+			if (parseBuf->clientMessage + clientPointer == parseBuf->headers[numHeaderKeys].key)	// if the key hasn't started yet, then this is the blank line at the end
 			{
 				ProcessMessage();
 				return true;
@@ -354,13 +441,13 @@ bool HttpResponder::CharFromClient(char c)
 				RejectMessage("too many header key-value pairs");
 				return true;
 			}
-			clientMessage[clientPointer++] = 0;
-			headers[numHeaderKeys].value = clientMessage + clientPointer;
+			parseBuf->clientMessage[clientPointer++] = 0;
+			parseBuf->headers[numHeaderKeys].value = parseBuf->clientMessage + clientPointer;
 			++numHeaderKeys;
 			parseState = HttpParseState::expectingHeaderValue;
 			break;
 		default:
-			clientMessage[clientPointer++] = c;
+			parseBuf->clientMessage[clientPointer++] = c;
 			break;
 		}
 		break;
@@ -380,7 +467,7 @@ bool HttpResponder::CharFromClient(char c)
 		}
 		else if (c != '\r')
 		{
-			clientMessage[clientPointer++] = c;
+			parseBuf->clientMessage[clientPointer++] = c;
 		}
 		break;
 
@@ -390,23 +477,23 @@ bool HttpResponder::CharFromClient(char c)
 		case ' ':
 		case '\t':
 			// It's a continuation of the previous value
-			clientMessage[clientPointer++] = c;
+			parseBuf->clientMessage[clientPointer++] = c;
 			parseState = HttpParseState::doingHeaderValue;
 			break;
 		case '\n':
 			// It's the blank line
-			clientMessage[clientPointer] = 0;
+			parseBuf->clientMessage[clientPointer] = 0;
 			ProcessMessage();
 			return true;
 		case '\r':
 			break;
 		default:
 			// It's a new key
-			if (clientPointer + 3 <= ARRAY_SIZE(clientMessage))
+			if (clientPointer + 3 <= ARRAY_SIZE(parseBuf->clientMessage))
 			{
-				clientMessage[clientPointer++] = 0;
-				headers[numHeaderKeys].key = clientMessage + clientPointer;
-				clientMessage[clientPointer++] = c;
+				parseBuf->clientMessage[clientPointer++] = 0;
+				parseBuf->headers[numHeaderKeys].key = parseBuf->clientMessage + clientPointer;
+				parseBuf->clientMessage[clientPointer++] = c;
 				parseState = HttpParseState::doingHeaderKey;
 			}
 			else
@@ -422,7 +509,7 @@ bool HttpResponder::CharFromClient(char c)
 		break;
 	}
 
-	if (clientPointer == ARRAY_SIZE(clientMessage))
+	if (clientPointer == ARRAY_SIZE(parseBuf->clientMessage))
 	{
 		RejectMessage(overflowResponse);
 		return true;
@@ -494,8 +581,17 @@ bool HttpResponder::GetJsonResponse(const char* request, OutputBuffer *&response
 				type = 1;
 			}
 
+			// If the client passes back the status change sequence number it saw last, it gets a short
+			// differential response when nothing except positions and temperatures has changed since then
+			uint32_t clientSeq = 0;
+			const char * const baseVal = GetKeyValue("base");
+			if (baseVal != nullptr)
+			{
+				clientSeq = (uint32_t)strtoul(baseVal, nullptr, 10);
+			}
+
 			OutputBuffer::Release(response);
-			response = reprap.GetStatusResponse(type, ResponseSource::HTTP);
+			response = reprap.GetStatusResponse(type, ResponseSource::HTTP, clientSeq);
 		}
 		else
 		{
@@ -504,6 +600,19 @@ bool HttpResponder::GetJsonResponse(const char* request, OutputBuffer *&response
 			response = reprap.GetLegacyStatusResponse(1, 0);
 		}
 	}
+	else if (StringEquals(request, "journal"))
+	{
+		// Report the state changes journalled since the sequence number the client saw last,
+		// so that external controllers can fetch deltas instead of diffing full status responses
+		uint32_t since = 0;
+		const char * const seqVal = GetKeyValue("seq");
+		if (seqVal != nullptr)
+		{
+			since = (uint32_t)strtoul(seqVal, nullptr, 10);
+		}
+		OutputBuffer::Release(response);
+		response = reprap.GetJournalResponse(since);
+	}
 	else if (StringEquals(request, "gcode") && GetKeyValue("gcode") != nullptr)
 	{
 		RegularGCodeInput * const httpInput = reprap.GetGCodes().GetHTTPInput();
@@ -517,6 +626,10 @@ bool HttpResponder::GetJsonResponse(const char* request, OutputBuffer *&response
 	else if (StringEquals(request, "delete") && GetKeyValue("name") != nullptr)
 	{
 		const bool ok = GetPlatform().GetMassStorage()->Delete(FS_PREFIX, GetKeyValue("name"));
+		if (ok)
+		{
+			InvalidateAssetCache(GetKeyValue("name"));
+		}
 		response->printf("{\"err\":%d}", (ok) ? 0 : 1);
 	}
 	else if (StringEquals(request, "filelist") && GetKeyValue("dir") != nullptr)
@@ -565,6 +678,11 @@ bool HttpResponder::GetJsonResponse(const char* request, OutputBuffer *&response
 				ms->Delete(nullptr, newVal, true);
 			}
 			success = ms->Rename(oldVal, newVal);
+			if (success)
+			{
+				InvalidateAssetCache(oldVal);
+				InvalidateAssetCache(newVal);
+			}
 		}
 		response->printf("{\"err\":%d}", (success) ? 0 : 1);
 	}
@@ -588,6 +706,10 @@ bool HttpResponder::GetJsonResponse(const char* request, OutputBuffer *&response
 		RejectMessage("Unknown request", 500);
 		return false;
 	}
+
+	// Offer to keep the connection open for the client's next request, so that the batched requests DWC makes
+	// don't each pay for a new TCP connection. A client that is disconnecting has no next request.
+	keepOpen = !StringEquals(request, "disconnect");
 	return true;
 }
 
@@ -595,14 +717,41 @@ const char* HttpResponder::GetKeyValue(const char *key) const
 {
 	for (size_t i = 0; i < numQualKeys; ++i)
 	{
-		if (StringEquals(qualifiers[i].key, key))
+		if (StringEquals(parseBuf->qualifiers[i].key, key))
 		{
-			return qualifiers[i].value;
+			return parseBuf->qualifiers[i].value;
 		}
 	}
 	return nullptr;
 }
 
+// Return true if the client asked us to persist the connection
+bool HttpResponder::ClientWantsKeepAlive() const
+{
+	for (size_t i = 0; i < numHeaderKeys; ++i)
+	{
+		if (StringEquals(parseBuf->headers[i].key, "Connection"))
+		{
+			// Comment out the following line to disable persistent connections
+			return StringEquals(parseBuf->headers[i].value, "keep-alive");
+		}
+	}
+	return false;
+}
+
+// Reset the parse state variables ready for a new request. This is called when a connection is accepted,
+// and again when we have finished sending a response on a connection we are keeping open, so that any
+// pipelined request already waiting in the socket buffer is parsed straight away.
+void HttpResponder::ResetParser()
+{
+	clientPointer = 0;
+	parseState = HttpParseState::doingCommandWord;
+	numCommandWords = 0;
+	numQualKeys = 0;
+	numHeaderKeys = 0;
+	parseBuf->commandWords[0] = parseBuf->clientMessage;
+}
+
 // Called to process a FileInfo request, which may take several calls
 // When we have finished, set the state back to free.
 bool HttpResponder::SendFileInfo()
@@ -612,17 +761,20 @@ bool HttpResponder::SendFileInfo()
 	if (gotFileInfo)
 	{
 		// Got it - send the response now
-		outBuf->copy(	"HTTP/1.1 200 OK\n"
+		outBuf->copy("");								// discard anything already in the buffer
+		outBuf->catRef(	"HTTP/1.1 200 OK\n"
 						"Cache-Control: no-cache, no-store, must-revalidate\n"
 						"Pragma: no-cache\n"
 						"Expires: 0\n"
 						"Access-Control-Allow-Origin: *\n"
 						"Content-Type: application/json\n"
-					);
+					  );
 		outBuf->catf("Content-Length: %u\n", (jsonResponse != nullptr) ? jsonResponse->Length() : 0);
-		outBuf->cat("Connection: close\n\n");
+
+		const bool keepOpen = ClientWantsKeepAlive();
+		outBuf->catf("Connection: %s\n\n", keepOpen ? "keep-alive" : "close");
 		outBuf->Append(jsonResponse);
-		Commit();
+		Commit(keepOpen ? ResponderState::reading : ResponderState::free);
 	}
 	return gotFileInfo;
 }
@@ -690,6 +842,7 @@ void HttpResponder::SendFile(const char* nameOfFileToSend, bool isWebFile)
 {
 	FileStore *fileToSend = nullptr;
 	bool zip = false;
+	WebAssetCacheEntry *cacheEntry = nullptr;
 
 	if (isWebFile)
 	{
@@ -702,8 +855,51 @@ void HttpResponder::SendFile(const char* nameOfFileToSend, bool isWebFile)
 			}
 		}
 
+#if SUPPORT_EMBEDDED_WEB_ASSETS
+		// If the asset is in the flash bundle, serve it from there and never touch the SD card
+		{
+			EmbeddedWebAssets::Asset asset;
+			if (EmbeddedWebAssets::Find(nameOfFileToSend, asset))
+			{
+				SendEmbeddedAsset(nameOfFileToSend, asset);
+				return;
+			}
+		}
+#endif
+
+		// See whether we have served this asset before
+		cacheEntry = FindCachedAsset(nameOfFileToSend);
+		if (cacheEntry != nullptr && cacheEntry->contentLoaded)
+		{
+			// The asset is RAM-resident, so we can reply without touching the SD card at all
+			SendCachedAsset(cacheEntry);
+			return;
+		}
+
+		if (cacheEntry != nullptr)
+		{
+			// We already know whether the zipped variant exists, so open the right file straight away
+			if (cacheEntry->isZipped)
+			{
+				char nameBuf[FILENAME_LENGTH + 1];
+				strcpy(nameBuf, nameOfFileToSend);
+				strcat(nameBuf, ".gz");
+				fileToSend = GetPlatform().OpenFile(GetPlatform().GetWebDir(), nameBuf, OpenMode::read);
+				zip = (fileToSend != nullptr);
+			}
+			else
+			{
+				fileToSend = GetPlatform().OpenFile(GetPlatform().GetWebDir(), nameOfFileToSend, OpenMode::read);
+			}
+			if (fileToSend == nullptr)
+			{
+				cacheEntry->valid = false;			// the file has gone away, so forget it and resolve the name again
+				cacheEntry = nullptr;
+			}
+		}
+
 		// Try to open a gzipped version of the file first
-		if (!StringEndsWith(nameOfFileToSend, ".gz") && strlen(nameOfFileToSend) + 3 <= FILENAME_LENGTH)
+		if (fileToSend == nullptr && !StringEndsWith(nameOfFileToSend, ".gz") && strlen(nameOfFileToSend) + 3 <= FILENAME_LENGTH)
 		{
 			char nameBuf[FILENAME_LENGTH + 1];
 			strcpy(nameBuf, nameOfFileToSend);
@@ -751,57 +947,188 @@ void HttpResponder::SendFile(const char* nameOfFileToSend, bool isWebFile)
 	// Don't cache files served by rr_download
 	if (!isWebFile)
 	{
-		outBuf->cat(	"Cache-Control: no-cache, no-store, must-revalidate\n"
+		outBuf->catRef(	"Cache-Control: no-cache, no-store, must-revalidate\n"
 						"Pragma: no-cache\n"
 						"Expires: 0\n"
 						"Access-Control-Allow-Origin: *\n"
-					);
+					  );
 	}
 
-	const char* contentType;
-	if (StringEndsWith(nameOfFileToSend, ".png"))
+	const bool zippedVariant = zip;				// remember whether we resolved to a .gz variant, because 'zip' is also set for .zip downloads below
+
+	const char* const contentType = GetContentType(nameOfFileToSend);
+	if (StringEndsWith(nameOfFileToSend, ".zip"))
 	{
-		contentType = "image/png";
+		zip = true;
 	}
-	else if (StringEndsWith(nameOfFileToSend, ".ico"))
+	outBuf->catf("Content-Type: %s\n", contentType);
+
+	if (zip)
 	{
-		contentType = "image/x-icon";
+		outBuf->cat("Content-Encoding: gzip\n");
 	}
-	else if (StringEndsWith(nameOfFileToSend, ".js"))
+
+	// Always send the length, so that the client can reuse the connection for its next request
+	// instead of needing the connection to be closed to delimit the body
+	outBuf->catf("Content-Length: %lu\n", fileToSend->Length());
+
+	// Remember this asset so that the next request for it is cheaper
+	if (isWebFile)
 	{
-		contentType = "application/javascript";
+		if (cacheEntry == nullptr)
+		{
+			cacheEntry = RecordCachedAsset(nameOfFileToSend, zippedVariant, fileToSend->Length(), contentType);
+		}
+		if (   cacheEntry != nullptr && !cacheEntry->contentLoaded
+			&& fileToSend->Length() <= MaxRamWebAssetSize
+			&& (cacheEntry->content != nullptr || numRamAssetsLoaded < NumRamWebAssets)
+		   )
+		{
+			LoadAssetContent(cacheEntry, fileToSend);
+		}
 	}
-	else if (StringEndsWith(nameOfFileToSend, ".css"))
+
+	const bool keepOpen = ClientWantsKeepAlive();
+	outBuf->catf("Connection: %s\n\n", keepOpen ? "keep-alive" : "close");
+	Commit(keepOpen ? ResponderState::reading : ResponderState::free);
+}
+
+// Look up an asset in the cache, returning nullptr if we don't know it
+HttpResponder::WebAssetCacheEntry *HttpResponder::FindCachedAsset(const char *name)
+{
+	for (WebAssetCacheEntry& entry : assetCache)
 	{
-		contentType = "text/css";
+		if (entry.valid && StringEquals(entry.name, name))
+		{
+			entry.whenUsed = millis();
+			return &entry;
+		}
 	}
-	else if (StringEndsWith(nameOfFileToSend, ".htm") || StringEndsWith(nameOfFileToSend, ".html"))
+	return nullptr;
+}
+
+// Record the details of an asset we have just resolved, returning the new cache entry or nullptr if we couldn't make one
+HttpResponder::WebAssetCacheEntry *HttpResponder::RecordCachedAsset(const char *name, bool isZipped, uint32_t length, const char *contentType)
+{
+	if (strlen(name) >= FILENAME_LENGTH)
 	{
-		contentType = "text/html";
+		return nullptr;
 	}
-	else if (StringEndsWith(nameOfFileToSend, ".zip"))
+
+	// Use an invalid entry if there is one, else replace the least recently used entry that has no RAM-resident
+	// content. RAM-resident entries are never evicted, because they are the cheapest ones to serve.
+	WebAssetCacheEntry *chosen = nullptr;
+	for (WebAssetCacheEntry& entry : assetCache)
 	{
-		contentType = "application/zip";
-		zip = true;
+		if (entry.numSenders != 0)
+		{
+			continue;								// the content buffer is being sent from, so leave this entry alone
+		}
+		if (!entry.valid)
+		{
+			chosen = &entry;
+			break;
+		}
+		if (!entry.contentLoaded && (chosen == nullptr || entry.whenUsed < chosen->whenUsed))
+		{
+			chosen = &entry;
+		}
 	}
-	else if (StringEndsWith(nameOfFileToSend, ".g") || StringEndsWith(nameOfFileToSend, ".gc") || StringEndsWith(nameOfFileToSend, ".gcode"))
+
+	if (chosen != nullptr)
 	{
-		contentType = "text/plain";
+		SafeStrncpy(chosen->name, name, ARRAY_SIZE(chosen->name));
+		chosen->contentType = contentType;
+		chosen->fileLength = length;
+		chosen->whenUsed = millis();
+		chosen->contentLoaded = false;
+		chosen->isZipped = isZipped;
+		chosen->valid = true;
 	}
-	else
+	return chosen;
+}
+
+// Try to load the content of an asset into RAM. Called with the file positioned at the start.
+void HttpResponder::LoadAssetContent(WebAssetCacheEntry *entry, FileStore *f)
+{
+	if (entry->numSenders == 0)						// never overwrite content that a responder is still sending
 	{
-		contentType = "application/octet-stream";
+		if (entry->content == nullptr)
+		{
+			entry->content = new char[MaxRamWebAssetSize];	// allocated on first use and then kept, like the file write buffers
+			++numRamAssetsLoaded;
+		}
+		if (f->Read(entry->content, entry->fileLength) == (int)entry->fileLength)
+		{
+			entry->contentLoaded = true;
+		}
+		(void)f->Seek(0);							// rewind so that this request can still stream the file as usual
 	}
-	outBuf->catf("Content-Type: %s\n", contentType);
+}
 
-	if (zip && fileToSend != nullptr)
+// Serve an asset from the RAM cache, without touching the SD card
+void HttpResponder::SendCachedAsset(WebAssetCacheEntry *entry)
+{
+	outBuf->copy("HTTP/1.1 200 OK\n");
+	outBuf->catf("Content-Type: %s\n", entry->contentType);
+	if (entry->isZipped)
 	{
 		outBuf->cat("Content-Encoding: gzip\n");
-		outBuf->catf("Content-Length: %lu\n", fileToSend->Length());
 	}
+	outBuf->catf("Content-Length: %" PRIu32 "\n", entry->fileLength);
 
-	outBuf->cat("Connection: close\n\n");
-	Commit();
+	const bool keepOpen = ClientWantsKeepAlive();
+	outBuf->catf("Connection: %s\n\n", keepOpen ? "keep-alive" : "close");
+	outBuf->catRef(entry->content, entry->fileLength);	// reference the cached content instead of copying it
+	++entry->numSenders;							// stop the content being replaced while we are sending it
+	assetBeingSent = entry;
+	Commit(keepOpen ? ResponderState::reading : ResponderState::free);
+}
+
+#if SUPPORT_EMBEDDED_WEB_ASSETS
+
+// Serve an asset directly from memory-mapped flash. Flash is immutable, so unlike the RAM cache
+// there is no need to protect the content from being replaced while it is being sent.
+void HttpResponder::SendEmbeddedAsset(const char *name, const EmbeddedWebAssets::Asset& asset)
+{
+	outBuf->copy("HTTP/1.1 200 OK\n");
+	outBuf->catf("Content-Type: %s\n", GetContentType(name));
+	if (asset.isZipped)
+	{
+		outBuf->cat("Content-Encoding: gzip\n");
+	}
+	outBuf->catf("Content-Length: %" PRIu32 "\n", asset.length);
+
+	const bool keepOpen = ClientWantsKeepAlive();
+	outBuf->catf("Connection: %s\n\n", keepOpen ? "keep-alive" : "close");
+	outBuf->catRef(asset.data, asset.length);		// reference the flash content in place instead of copying it
+	Commit(keepOpen ? ResponderState::reading : ResponderState::free);
+}
+
+#endif
+
+// Tell the cache that we have finished sending RAM-resident content
+void HttpResponder::ReleaseCachedAsset()
+{
+	if (assetBeingSent != nullptr)
+	{
+		--assetBeingSent->numSenders;
+		assetBeingSent = nullptr;
+	}
+}
+
+// Called when a file has been uploaded, deleted or renamed, so that we don't serve stale assets.
+// Only changes under the web directory can affect us. Content buffers are kept for reuse.
+/*static*/ void HttpResponder::InvalidateAssetCache(const char *filename)
+{
+	if (filename == nullptr || StringStartsWith(filename, WEB_DIR) || StringStartsWith(filename, "/www/"))
+	{
+		for (WebAssetCacheEntry& entry : assetCache)
+		{
+			entry.valid = false;
+			entry.contentLoaded = false;
+		}
+	}
 }
 
 void HttpResponder::SendGCodeReply()
@@ -838,9 +1165,11 @@ void HttpResponder::SendGCodeReply()
 					"Content-Type: text/plain\n"
 				);
 	outBuf->catf("Content-Length: %u\n", gcodeReply->DataLength());
-	outBuf->cat("Connection: close\n\n");
+
+	const bool keepOpen = ClientWantsKeepAlive();
+	outBuf->catf("Connection: %s\n\n", keepOpen ? "keep-alive" : "close");
 	outStack->Append(gcodeReply);
-	Commit();
+	Commit(keepOpen ? ResponderState::reading : ResponderState::free);
 
 	// Possibly clean up the G-code reply once again
 	if (clearReply)
@@ -904,29 +1233,17 @@ void HttpResponder::SendJsonResponse(const char* command)
 		return;
 	}
 
-	// Send the JSON response
-	bool keepOpen = false;
-	if (mayKeepOpen)
-	{
-		// Check that the browser wants to persist the connection too
-		for (size_t i = 0; i < numHeaderKeys; ++i)
-		{
-			if (StringEquals(headers[i].key, "Connection"))
-			{
-				// Comment out the following line to disable persistent connections
-				keepOpen = StringEquals(headers[i].value, "keep-alive");
-				break;
-			}
-		}
-	}
+	// Send the JSON response, persisting the connection if the browser asked us to
+	const bool keepOpen = mayKeepOpen && ClientWantsKeepAlive();
 
-	outBuf->copy(	"HTTP/1.1 200 OK\n"
+	outBuf->copy("");									// discard anything already in the buffer
+	outBuf->catRef(	"HTTP/1.1 200 OK\n"
 					"Cache-Control: no-cache, no-store, must-revalidate\n"
 					"Pragma: no-cache\n"
 					"Expires: 0\n"
 					"Access-Control-Allow-Origin: *\n"
 					"Content-Type: application/json\n"
-				);
+				  );
 	outBuf->catf("Content-Length: %u\n", (jsonResponse != nullptr) ? jsonResponse->Length() : 0);
 	outBuf->catf("Connection: %s\n\n", keepOpen ? "keep-alive" : "close");
 	outBuf->Append(jsonResponse);
@@ -943,13 +1260,13 @@ void HttpResponder::ProcessMessage()
 		GetPlatform().MessageF(UsbMessage, "HTTP req, command words {");
 		for (size_t i = 0; i < numCommandWords; ++i)
 		{
-			GetPlatform().MessageF(UsbMessage, " %s", commandWords[i]);
+			GetPlatform().MessageF(UsbMessage, " %s", parseBuf->commandWords[i]);
 		}
 		GetPlatform().Message(UsbMessage, " }, parameters {");
 
 		for (size_t i = 0; i < numQualKeys; ++i)
 		{
-			GetPlatform().MessageF(UsbMessage, " %s=%s", qualifiers[i].key, qualifiers[i].value);
+			GetPlatform().MessageF(UsbMessage, " %s=%s", parseBuf->qualifiers[i].key, parseBuf->qualifiers[i].value);
 		}
 		GetPlatform().Message(UsbMessage, " }\n");
 	}
@@ -960,24 +1277,44 @@ void HttpResponder::ProcessMessage()
 		return;
 	}
 
-	if (StringEquals(commandWords[0], "GET"))
+	if (StringEquals(parseBuf->commandWords[0], "GET"))
 	{
-		if (StringStartsWith(commandWords[1], KO_START))
+		// See if this is a WebSocket upgrade request for the status push channel
+		const char *webSocketKey = nullptr;
+		bool isUpgrade = false;
+		for (size_t i = 0; i < numHeaderKeys; ++i)
+		{
+			if (StringEquals(parseBuf->headers[i].key, "Sec-WebSocket-Key"))
+			{
+				webSocketKey = parseBuf->headers[i].value;
+			}
+			else if (StringEquals(parseBuf->headers[i].key, "Upgrade") && StringEquals(parseBuf->headers[i].value, "websocket"))
+			{
+				isUpgrade = true;
+			}
+		}
+		if (isUpgrade && webSocketKey != nullptr)
 		{
-			SendJsonResponse(commandWords[1] + KoFirst);
+			HandleWebSocketUpgrade(webSocketKey);
+			return;
 		}
-		else if (commandWords[1][0] == '/' && StringStartsWith(commandWords[1] + 1, KO_START))
+
+		if (StringStartsWith(parseBuf->commandWords[1], KO_START))
 		{
-			SendJsonResponse(commandWords[1] + 1 + KoFirst);
+			SendJsonResponse(parseBuf->commandWords[1] + KoFirst);
+		}
+		else if (parseBuf->commandWords[1][0] == '/' && StringStartsWith(parseBuf->commandWords[1] + 1, KO_START))
+		{
+			SendJsonResponse(parseBuf->commandWords[1] + 1 + KoFirst);
 		}
 		else
 		{
-			SendFile(commandWords[1], true);
+			SendFile(parseBuf->commandWords[1], true);
 		}
 		return;
 	}
 
-	if (StringEquals(commandWords[0], "OPTIONS"))
+	if (StringEquals(parseBuf->commandWords[0], "OPTIONS"))
 	{
 		outBuf->copy(	"HTTP/1.1 200 OK\n"
 						"Allow: OPTIONS, GET, POST\n"
@@ -993,10 +1330,10 @@ void HttpResponder::ProcessMessage()
 		return;
 	}
 
-	if (CheckAuthenticated() && StringEquals(commandWords[0], "POST"))
+	if (CheckAuthenticated() && StringEquals(parseBuf->commandWords[0], "POST"))
 	{
-		const bool isUploadRequest = (StringEquals(commandWords[1], KO_START "upload"))
-								  || (commandWords[1][0] == '/' && StringEquals(commandWords[1] + 1, KO_START "upload"));
+		const bool isUploadRequest = (StringEquals(parseBuf->commandWords[1], KO_START "upload"))
+								  || (parseBuf->commandWords[1][0] == '/' && StringEquals(parseBuf->commandWords[1] + 1, KO_START "upload"));
 		if (isUploadRequest)
 		{
 			const char* const filename = GetKeyValue("name");
@@ -1006,9 +1343,9 @@ void HttpResponder::ProcessMessage()
 				bool contentLengthFound = false;
 				for (size_t i = 0; i < numHeaderKeys; i++)
 				{
-					if (StringEquals(headers[i].key, "Content-Length"))
+					if (StringEquals(parseBuf->headers[i].key, "Content-Length"))
 					{
-						postFileLength = atoi(headers[i].value);
+						postFileLength = atoi(parseBuf->headers[i].value);
 						contentLengthFound = true;
 						break;
 					}
@@ -1029,6 +1366,25 @@ void HttpResponder::ProcessMessage()
 					return;
 
 				}
+
+				// See if the client is sending the file gzip-compressed to save bandwidth
+				const char* const compression = GetKeyValue("compression");
+				uploadingGzipped = (compression != nullptr && StringEquals(compression, "gzip"));
+				gzipStreamComplete = false;
+				if (uploadingGzipped)
+				{
+					if (gzipDecompressor == nullptr)
+					{
+						gzipDecompressor = new GZipDecompressor();		// allocated on first use and then kept, like the macro file cache
+					}
+					if (!gzipDecompressor->Start(file))
+					{
+						file->Close();
+						(void)GetPlatform().GetMassStorage()->Delete(FS_PREFIX, filename, true);
+						RejectMessage("another compressed upload is already in progress");
+						return;
+					}
+				}
 				StartUpload(file, filename);
 
 				// Try to get the last modified file date and time
@@ -1102,10 +1458,32 @@ void HttpResponder::DoUpload()
 		skt->Taken(len);
 		uploadedBytes += len;
 
-		if (!fileBeingUploaded.Write(buffer, len))
+		bool writtenOk;
+		if (uploadingGzipped)
+		{
+			const GZipDecompressor::PutResult res = gzipDecompressor->PutData(buffer, len);
+			writtenOk = (res != GZipDecompressor::PutResult::error);
+			if (res == GZipDecompressor::PutResult::finished)
+			{
+				gzipStreamComplete = true;
+			}
+		}
+		else
+		{
+			writtenOk = fileBeingUploaded.Write(buffer, len);
+		}
+
+		if (!writtenOk)
 		{
 			uploadError = true;
-			GetPlatform().Message(ErrorMessage, "Could not write upload data!\n");
+			if (uploadingGzipped)
+			{
+				GetPlatform().MessageF(ErrorMessage, "Compressed upload failed: %s\n", gzipDecompressor->GetErrorMessage());
+			}
+			else
+			{
+				GetPlatform().Message(ErrorMessage, "Could not write upload data!\n");
+			}
 			CancelUpload();
 			SendJsonResponse("upload");
 			return;
@@ -1127,7 +1505,22 @@ void HttpResponder::DoUpload()
 			}
 		}
 
-		FinishUpload(postFileLength, fileLastModified);
+		if (uploadingGzipped)
+		{
+			if (!gzipStreamComplete)
+			{
+				uploadError = true;
+				GetPlatform().Message(ErrorMessage, "Compressed upload ended before the gzip stream was complete!\n");
+				gzipDecompressor->Abandon();
+			}
+			uploadingGzipped = false;
+			FinishUpload(0, fileLastModified);		// the decompressed length has already been checked against the gzip trailer
+		}
+		else
+		{
+			FinishUpload(postFileLength, fileLastModified);
+		}
+		InvalidateAssetCache(filenameBeingUploaded);	// in case a web asset has been replaced
 		SendJsonResponse("upload");
 		return;
 	}
@@ -1138,6 +1531,258 @@ void HttpResponder::DoUpload()
 	}
 }
 
+// Complete a WebSocket handshake. The client is then pushed a status frame whenever the machine state
+// changes instead of having to poll rr_status, which saves an HTTP parse, a JSON rebuild and a TCP round
+// trip per poll per client.
+void HttpResponder::HandleWebSocketUpgrade(const char *key)
+{
+	// Apply the same automatic authentication rule as the JSON requests do
+	if (!CheckAuthenticated() && !(reprap.NoPasswordSet() && Authenticate()))
+	{
+		RejectMessage("not authenticated", 401);
+		return;
+	}
+
+	// The accept token is the base64 encoding of the SHA1 of the client's key concatenated with a GUID fixed by the protocol
+	static const char * const WebSocketGuid = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+	SHA1Context ctx;
+	SHA1Reset(&ctx);
+	SHA1Input(&ctx, reinterpret_cast<const uint8_t *>(key), strlen(key));
+	SHA1Input(&ctx, reinterpret_cast<const uint8_t *>(WebSocketGuid), strlen(WebSocketGuid));
+	if (!SHA1Result(&ctx))
+	{
+		RejectMessage("bad WebSocket key");
+		return;
+	}
+
+	uint8_t digest[20];
+	for (size_t i = 0; i < 5; ++i)
+	{
+		digest[4 * i] = (uint8_t)(ctx.Message_Digest[i] >> 24);
+		digest[4 * i + 1] = (uint8_t)(ctx.Message_Digest[i] >> 16);
+		digest[4 * i + 2] = (uint8_t)(ctx.Message_Digest[i] >> 8);
+		digest[4 * i + 3] = (uint8_t)ctx.Message_Digest[i];
+	}
+	char acceptToken[29];
+	Base64Encode(digest, sizeof(digest), acceptToken);
+
+	// WebSocket clients are strict about the line endings of the handshake response, so use CRLF here
+	outBuf->printf(	"HTTP/1.1 101 Switching Protocols\r\n"
+					"Upgrade: websocket\r\n"
+					"Connection: Upgrade\r\n"
+					"Sec-WebSocket-Accept: %s\r\n"
+					"\r\n", acceptToken
+				  );
+	wsRxState = WsRxState::opcode;
+	wsLastStatusChar = 0;							// force an immediate status push once the handshake has been sent
+	wsLastSeq = seq;
+	wsLastPushTime = millis();
+	Commit(ResponderState::webSocketConnected);
+}
+
+// Look after an active WebSocket session: process incoming frames and push a status frame when the
+// machine state has changed. Returns true if we did anything significant.
+bool HttpResponder::DoWebSocket()
+{
+	bool readSomething = false;
+	char c;
+	while (responderState == ResponderState::webSocketConnected && skt->ReadChar(c))
+	{
+		readSomething = true;
+		ProcessWebSocketByte((uint8_t)c);			// this may queue a control frame reply, which changes the state to sending
+	}
+
+	if (responderState != ResponderState::webSocketConnected)
+	{
+		return true;
+	}
+
+	if (!skt->CanRead())
+	{
+		ConnectionLost();
+		return true;
+	}
+
+	// Push a status frame if anything has changed, and periodically anyway so that temperatures and positions stay fresh
+	const char statusChar = reprap.GetStatusCharacter();
+	const uint32_t now = millis();
+	if (statusChar != wsLastStatusChar || seq != wsLastSeq || now - wsLastPushTime >= WebSocketRefreshInterval)
+	{
+		OutputBuffer * const statusResponse = reprap.GetStatusResponse(1, ResponseSource::HTTP);
+		if (statusResponse != nullptr && SendWebSocketFrame(0x01, statusResponse))
+		{
+			wsLastStatusChar = statusChar;
+			wsLastSeq = seq;
+			wsLastPushTime = now;
+		}
+		return true;
+	}
+	return readSomething;
+}
+
+// Feed one received byte to the WebSocket frame parser
+void HttpResponder::ProcessWebSocketByte(uint8_t b)
+{
+	switch (wsRxState)
+	{
+	case WsRxState::opcode:
+		wsRxOpcode = b & 0x0F;						// the FIN bit does not matter to us, because we discard data frames anyway
+		wsRxState = WsRxState::length;
+		break;
+
+	case WsRxState::length:
+		wsRxMasked = ((b & 0x80) != 0);
+		wsRxPayloadLength = b & 0x7F;
+		wsRxPayloadRead = 0;
+		if (wsRxPayloadLength == 126)
+		{
+			wsRxPayloadLength = 0;
+			wsRxFieldBytes = 2;
+			wsRxState = WsRxState::lengthExt;
+		}
+		else if (wsRxPayloadLength == 127)
+		{
+			wsRxPayloadLength = 0;
+			wsRxFieldBytes = 8;
+			wsRxState = WsRxState::lengthExt;
+		}
+		else if (wsRxMasked)
+		{
+			wsRxFieldBytes = 4;
+			wsRxState = WsRxState::mask;
+		}
+		else if (wsRxPayloadLength != 0)
+		{
+			wsRxState = WsRxState::payload;
+		}
+		else
+		{
+			WebSocketFrameComplete();
+		}
+		break;
+
+	case WsRxState::lengthExt:
+		wsRxPayloadLength = (wsRxPayloadLength << 8) | b;	// lengths over 32 bits would wrap, but we discard oversize payloads anyway
+		if (--wsRxFieldBytes == 0)
+		{
+			if (wsRxMasked)
+			{
+				wsRxFieldBytes = 4;
+				wsRxState = WsRxState::mask;
+			}
+			else
+			{
+				wsRxState = (wsRxPayloadLength != 0) ? WsRxState::payload : WsRxState::opcode;
+				if (wsRxPayloadLength == 0)
+				{
+					WebSocketFrameComplete();
+				}
+			}
+		}
+		break;
+
+	case WsRxState::mask:
+		wsRxMaskBytes[4 - wsRxFieldBytes] = b;
+		if (--wsRxFieldBytes == 0)
+		{
+			if (wsRxPayloadLength != 0)
+			{
+				wsRxState = WsRxState::payload;
+			}
+			else
+			{
+				WebSocketFrameComplete();
+			}
+		}
+		break;
+
+	case WsRxState::payload:
+		if (wsRxPayloadRead < MaxWebSocketControlPayload)
+		{
+			// Keep the unmasked payload in case this is a ping that we must echo; data frame payloads are overwritten harmlessly
+			wsControlPayload[wsRxPayloadRead] = (wsRxMasked) ? b ^ wsRxMaskBytes[wsRxPayloadRead & 3] : b;
+		}
+		++wsRxPayloadRead;
+		if (--wsRxPayloadLength == 0)
+		{
+			WebSocketFrameComplete();
+		}
+		break;
+	}
+}
+
+// Act on a completely received WebSocket frame. Only control frames need any action; we have no
+// incoming commands, because the G-code and file interfaces remain on the ordinary HTTP requests.
+void HttpResponder::WebSocketFrameComplete()
+{
+	wsRxState = WsRxState::opcode;
+	switch (wsRxOpcode)
+	{
+	case 0x08:										// close: acknowledge it, then close the connection
+		if (outBuf != nullptr || OutputBuffer::Allocate(outBuf))
+		{
+			outBuf->cat((char)0x88);
+			outBuf->cat((char)0x00);
+			Commit();								// the default next state is free, which closes the connection after sending
+		}
+		else
+		{
+			ConnectionLost();
+		}
+		break;
+
+	case 0x09:										// ping: reply with a pong echoing the payload
+		{
+			OutputBuffer *pongPayload = nullptr;
+			const size_t payloadLength = min<size_t>(wsRxPayloadRead, MaxWebSocketControlPayload);
+			if (payloadLength != 0)
+			{
+				if (!OutputBuffer::Allocate(pongPayload))
+				{
+					break;							// no buffer free; the client will ping again
+				}
+				pongPayload->copy(reinterpret_cast<const char *>(wsControlPayload), payloadLength);
+			}
+			(void)SendWebSocketFrame(0x0A, pongPayload);
+		}
+		break;
+
+	default:										// pong or a data frame: nothing to do
+		break;
+	}
+}
+
+// Wrap a payload in a WebSocket frame header and send it, taking ownership of the payload buffer.
+// Frames from the server are not masked. Returns false if no buffer was available for the header.
+bool HttpResponder::SendWebSocketFrame(uint8_t opcode, OutputBuffer *payload)
+{
+	if (outBuf == nullptr && !OutputBuffer::Allocate(outBuf))
+	{
+		OutputBuffer::ReleaseAll(payload);
+		return false;								// no buffer free, try again later
+	}
+
+	const size_t payloadLength = (payload != nullptr) ? payload->Length() : 0;
+	outBuf->cat((char)(0x80 | opcode));				// FIN set; we never fragment
+	if (payloadLength < 126)
+	{
+		outBuf->cat((char)payloadLength);
+	}
+	else
+	{
+		// Status responses are always well under 64Kb, so the 16-bit length format suffices
+		outBuf->cat((char)126);
+		outBuf->cat((char)(payloadLength >> 8));
+		outBuf->cat((char)payloadLength);
+	}
+	if (payload != nullptr)
+	{
+		outBuf->Append(payload);
+	}
+	Commit(ResponderState::webSocketConnected);
+	return true;
+}
+
 // This is called to force termination if we implement the specified protocol
 void HttpResponder::Terminate(Protocol protocol)
 {
@@ -1151,12 +1796,19 @@ void HttpResponder::Terminate(Protocol protocol)
 void HttpResponder::ConnectionLost()
 {
 	fileInfoLock.Release(this);
+	ReleaseCachedAsset();
+	ReleaseParseBuffer();
 	NetworkResponder::ConnectionLost();
 }
 
 // This overrides the version in class NetworkResponder
 void HttpResponder::CancelUpload()
 {
+	if (uploadingGzipped)
+	{
+		gzipDecompressor->Abandon();
+		uploadingGzipped = false;
+	}
 	if (skt != nullptr)
 	{
 		for (size_t i = 0; i < numSessions; i++)
@@ -1176,8 +1828,25 @@ void HttpResponder::CancelUpload()
 void HttpResponder::SendData()
 {
 	NetworkResponder::SendData();
+	if (responderState != ResponderState::sending)
+	{
+		ReleaseCachedAsset();
+	}
+	if (responderState == ResponderState::free || responderState == ResponderState::webSocketConnected)
+	{
+		// The connection has ended, or it has become a WebSocket which doesn't use the request parser
+		ReleaseParseBuffer();
+	}
 	if (responderState == ResponderState::reading)
 	{
+		// We are keeping the connection open for the client's next request, which may already be waiting in the socket buffer.
+		// As in Accept, we need an output buffer available before we agree to read another request.
+		if (outBuf == nullptr && !OutputBuffer::Allocate(outBuf))
+		{
+			ConnectionLost();
+			return;
+		}
+		ResetParser();
 		timer = millis();				// restart the timer
 	}
 }
@@ -1261,6 +1930,13 @@ void HttpResponder::Diagnostics(MessageType mt) const
 /*static*/ void HttpResponder::CommonDiagnostics(MessageType mtype)
 {
 	GetPlatform().MessageF(mtype, "HTTP sessions: %u of %u\n", numSessions, MaxHttpSessions);
+#if SUPPORT_EMBEDDED_WEB_ASSETS
+	const unsigned int numEmbedded = EmbeddedWebAssets::NumAssets();
+	if (numEmbedded != 0)
+	{
+		GetPlatform().MessageF(mtype, "Embedded web assets: %u files\n", numEmbedded);
+	}
+#endif
 }
 
 // Static data
@@ -1274,4 +1950,12 @@ OutputStack *HttpResponder::gcodeReply = new OutputStack();
 
 NetworkResponderLock HttpResponder::fileInfoLock;
 
+GZipDecompressor *HttpResponder::gzipDecompressor = nullptr;
+
+HttpResponder::WebAssetCacheEntry HttpResponder::assetCache[NumWebAssetCacheEntries];
+size_t HttpResponder::numRamAssetsLoaded = 0;
+
+HttpResponder::HttpParseBuffer *HttpResponder::parseBufferPool = nullptr;
+size_t HttpResponder::numParseBuffers = 0;
+
 // End
@@ -9,6 +9,8 @@
 #define SRC_DUETNG_DUETETHERNET_HTTPRESPONDER_H_
 
 #include "NetworkResponder.h"
+#include "Storage/GZipDecompressor.h"
+#include "EmbeddedWebAssets.h"
 
 class HttpResponder : public NetworkResponder
 {
@@ -37,6 +39,8 @@ private:
 	static const size_t MaxQualKeys = 5;				// max number of key/value pairs in the qualifier
 	static const size_t MaxHeaders = 30;				// max number of key/value pairs in the headers
 	static const uint32_t HttpSessionTimeout = 8000;	// HTTP session timeout in milliseconds
+	static const uint32_t WebSocketRefreshInterval = 1000;	// how often we push a status frame when nothing has changed, so that temperatures etc. stay fresh
+	static const size_t MaxWebSocketControlPayload = 125;	// the longest payload a WebSocket control frame may carry
 
 	enum class HttpParseState
 	{
@@ -60,6 +64,19 @@ private:
 		const char* value;
 	};
 
+	// Per-request parse scratch. This is by far the largest part of a responder, so rather than each responder
+	// owning one for its whole life, these live in a small shared pool and a responder only holds one while it
+	// has a connection. Idle responders then cost very little RAM, and buffers beyond the first are only created
+	// when connections actually overlap, which leaves more never-used RAM for the network buffer pool at startup.
+	struct HttpParseBuffer
+	{
+		HttpParseBuffer *next;							// next buffer in the free list
+		char clientMessage[WebMessageLength + 3];		// holds the command, qualifier, and headers
+		const char* commandWords[MaxCommandWords];
+		KeyValueIndices qualifiers[MaxQualKeys + 1];	// offsets into the qualifier key/value pairs, the +1 is needed so that values can contain nulls
+		KeyValueIndices headers[MaxHeaders];			// offsets into the header key/value pairs
+	};
+
 	// HTTP sessions
 	struct HttpSession
 	{
@@ -84,19 +101,55 @@ private:
 
 	void DoUpload();
 
+	// WebSocket status push channel
+	void HandleWebSocketUpgrade(const char *key);	// complete a WebSocket handshake
+	bool DoWebSocket();								// look after an active WebSocket session, returning true if we did anything significant
+	void ProcessWebSocketByte(uint8_t b);			// feed one received byte to the frame parser
+	void WebSocketFrameComplete();					// act on a completely received frame
+	bool SendWebSocketFrame(uint8_t opcode, OutputBuffer *payload);	// wrap a payload in a frame header and send it, taking ownership of the payload
+
 	const char* GetKeyValue(const char *key) const;	// return the value of the specified key, or nullptr if not present
+	bool ClientWantsKeepAlive() const;				// did the client ask us to persist the connection?
+	void ResetParser();								// get the parser ready for a new request
+
+	bool AcquireParseBuffer();						// get a parse buffer from the shared pool, returning true if successful
+	void ReleaseParseBuffer();						// return our parse buffer to the shared pool
+
+	// Cache of hot web asset metadata. Looking an asset up here avoids probing the SD card for a .gz variant
+	// on every hit, and the first few small assets we serve are kept fully RAM-resident after first access.
+	struct WebAssetCacheEntry
+	{
+		char name[FILENAME_LENGTH];					// the requested name, relative to the web directory
+		const char *contentType;					// the Content-Type header value we send for it
+		uint32_t fileLength;						// the length of the data we serve
+		uint32_t whenUsed;							// when this entry was last used, for choosing one to replace
+		char *content;								// buffer for RAM-resident content, allocated on first use and then kept
+		unsigned int numSenders;					// how many responders are currently sending the RAM-resident content
+		bool contentLoaded;							// true if 'content' holds the current file content
+		bool isZipped;								// true if we serve the .gz variant of the file
+		bool valid;
+	};
+
+	static const size_t NumWebAssetCacheEntries = 8;	// how many assets we remember metadata for
+	static const size_t NumRamWebAssets = 4;			// how many assets we keep fully in RAM
+	static const uint32_t MaxRamWebAssetSize = 4096;	// only assets up to this size are kept in RAM
+
+	WebAssetCacheEntry *FindCachedAsset(const char *name);
+	WebAssetCacheEntry *RecordCachedAsset(const char *name, bool isZipped, uint32_t length, const char *contentType);
+	void LoadAssetContent(WebAssetCacheEntry *entry, FileStore *f);
+	void SendCachedAsset(WebAssetCacheEntry *entry);
+#if SUPPORT_EMBEDDED_WEB_ASSETS
+	void SendEmbeddedAsset(const char *name, const EmbeddedWebAssets::Asset& asset);	// serve an asset directly from memory-mapped flash
+#endif
+	void ReleaseCachedAsset();						// tell the cache we have finished sending RAM-resident content
+	static void InvalidateAssetCache(const char *filename);	// called when a file has been uploaded, deleted or renamed
 
 	HttpParseState parseState;
 
-	// Buffers for processing HTTP input
-	char clientMessage[WebMessageLength + 3];		// holds the command, qualifier, and headers
+	// Parser state. The buffers themselves are in the parse buffer, which we hold while we have a connection.
+	HttpParseBuffer *parseBuf;						// our parse buffer, or nullptr if we don't have a connection
 	size_t clientPointer;							// current index into clientMessage
 	char decodeChar;								// the character we are decoding in a URL-encoded argument
-
-	// Parser state
-	const char* commandWords[MaxCommandWords];
-	KeyValueIndices qualifiers[MaxQualKeys + 1];	// offsets into clientQualifier of the key/value pairs, the +1 is needed so that values can contain nulls
-	KeyValueIndices headers[MaxHeaders];			// offsets into clientHeader of the key/value pairs
 	size_t numCommandWords;
 	size_t numQualKeys;								// number of qualifier keys we have found, <= maxQualKeys
 	size_t numHeaderKeys;							// number of keys we have found, <= maxHeaders
@@ -104,6 +157,35 @@ private:
 	// rr_fileinfo requests
 	char filenameBeingProcessed[FILENAME_LENGTH];	// The filename being processed (for rr_fileinfo)
 
+	// Compressed uploads (upload parameter compression=gzip)
+	bool uploadingGzipped;							// is the current upload arriving gzip-compressed?
+	bool gzipStreamComplete;						// has the decompressor seen a complete, valid stream?
+
+	WebAssetCacheEntry *assetBeingSent;				// the RAM-resident asset we are sending, else nullptr
+
+	// WebSocket receive state. Frames from the client arrive in whatever pieces the network delivers,
+	// so the parser runs a byte at a time. We only act on control frames; data frames are discarded.
+	enum class WsRxState : uint8_t
+	{
+		opcode = 0,									// expecting the opcode byte
+		length,										// expecting the first length byte
+		lengthExt,									// expecting extended length bytes
+		mask,										// expecting masking key bytes
+		payload										// expecting payload bytes
+	};
+
+	WsRxState wsRxState;
+	uint8_t wsRxOpcode;								// the opcode of the frame being received
+	bool wsRxMasked;								// is the payload masked? (it always is from a compliant client)
+	uint32_t wsRxPayloadLength;						// payload bytes still to receive
+	uint32_t wsRxPayloadRead;						// payload bytes received so far, which also indexes the masking key
+	unsigned int wsRxFieldBytes;					// extended length or masking key bytes still to receive
+	uint8_t wsRxMaskBytes[4];						// the masking key
+	uint8_t wsControlPayload[MaxWebSocketControlPayload];	// the payload of a ping frame, so that the pong can echo it
+	char wsLastStatusChar;							// the machine status character when we last pushed a frame
+	uint32_t wsLastSeq;								// the G-code reply sequence number when we last pushed a frame
+	uint32_t wsLastPushTime;						// when we last pushed a frame
+
 	// Keeping track of HTTP sessions
 	static HttpSession sessions[MaxHttpSessions];
 	static unsigned int numSessions;
@@ -114,6 +196,14 @@ private:
 	static OutputStack *gcodeReply;
 
 	static NetworkResponderLock fileInfoLock;		// PrintMonitor::GetFileInfoResponse is single threaded at present, so use this to control access
+
+	static GZipDecompressor *gzipDecompressor;		// allocated when the first compressed upload starts and then kept; only one upload can use it at a time
+
+	static WebAssetCacheEntry assetCache[NumWebAssetCacheEntries];
+	static size_t numRamAssetsLoaded;				// how many cache entries have RAM-resident content
+
+	static HttpParseBuffer *parseBufferPool;		// free list of parse buffers
+	static size_t numParseBuffers;					// how many parse buffers we have created, never more than NumHttpResponders
 };
 
 #endif /* SRC_DUETNG_DUETETHERNET_HTTPRESPONDER_H_ */
@@ -8,8 +8,16 @@
 #include "NetworkBuffer.h"
 
 #include "Storage/FileStore.h"
+#include "RepRap.h"
+#include "Platform.h"
 
 NetworkBuffer *NetworkBuffer::freelist = nullptr;
+unsigned int NetworkBuffer::totalBuffers = 0;
+unsigned int NetworkBuffer::buffersInUse = 0;
+unsigned int NetworkBuffer::maxBuffersInUse = 0;
+unsigned int NetworkBuffer::allocationFailures[NumProtocols + 2] = { 0 };
+
+const uint32_t MinSpareRamForBuffers = 20 * 1024;		// how much never-used RAM we leave for the heap and stack when growing the pool
 
 NetworkBuffer::NetworkBuffer(NetworkBuffer *n) : next(n), dataLength(0), readPointer(0)
 {
@@ -21,6 +29,7 @@ NetworkBuffer *NetworkBuffer::Release()
 	NetworkBuffer *ret = next;
 	next = freelist;
 	freelist = this;
+	--buffersInUse;
 	return ret;
 }
 
@@ -104,7 +113,7 @@ void NetworkBuffer::Empty()
 	return list;
 }
 
-/*static*/ NetworkBuffer *NetworkBuffer::Allocate()
+/*static*/ NetworkBuffer *NetworkBuffer::Allocate(Protocol protocolWanted)
 {
 	NetworkBuffer *ret = freelist;
 	if (ret != nullptr)
@@ -112,16 +121,43 @@ void NetworkBuffer::Empty()
 		freelist = ret->next;
 		ret->next = nullptr;
 		ret->dataLength = ret->readPointer = 0;
+		++buffersInUse;
+		if (buffersInUse > maxBuffersInUse)
+		{
+			maxBuffersInUse = buffersInUse;
+		}
+	}
+	else
+	{
+		++allocationFailures[(protocolWanted <= FtpDataProtocol) ? protocolWanted : NumProtocols + 1];
 	}
 	return ret;
 }
 
-/*static*/ void NetworkBuffer::AllocateBuffers(unsigned int number)
+// Return the most buffers one socket may hold for received data. With the minimum pool this is tighter than the
+// old fixed limit of 4, so a stalled client can no longer hold half the pool; with a RAM-sized pool it is looser.
+/*static*/ unsigned int NetworkBuffer::FairSharePerSocket()
+{
+	return max<unsigned int>(2, min<unsigned int>(totalBuffers/4, 6));
+}
+
+// Allocate the minimum number of buffers we need to function, then keep adding buffers while there is plenty of
+// never-used RAM left, so that boards with spare memory get a deeper pool without risking the heap on others.
+/*static*/ void NetworkBuffer::AllocateBuffers(unsigned int minimum, unsigned int maximum)
 {
-	while (number != 0)
+	while (totalBuffers < minimum)
 	{
 		freelist = new NetworkBuffer(freelist);
-		--number;
+		++totalBuffers;
+	}
+
+	uint32_t neverUsed;
+	reprap.GetPlatform().GetStackUsage(nullptr, nullptr, &neverUsed);
+	while (totalBuffers < maximum && neverUsed >= MinSpareRamForBuffers + sizeof(NetworkBuffer))
+	{
+		freelist = new NetworkBuffer(freelist);
+		++totalBuffers;
+		neverUsed -= sizeof(NetworkBuffer);
 	}
 }
 
@@ -136,4 +172,15 @@ void NetworkBuffer::Empty()
 	return ret;
 }
 
+
+// Report the pool size, its high-water mark, and which protocols have gone short of buffers
+/*static*/ void NetworkBuffer::Diagnostics(MessageType mtype)
+{
+	reprap.GetPlatform().MessageF(mtype, "Network buffers: %u of %u used (%u max), %u bytes each\n",
+			buffersInUse, totalBuffers, maxBuffersInUse, bufferSize);
+	reprap.GetPlatform().MessageF(mtype, "Buffer allocation failures: HTTP %u, FTP %u, Telnet %u, FTP data %u, other %u\n",
+			allocationFailures[HttpProtocol], allocationFailures[FtpProtocol], allocationFailures[TelnetProtocol],
+			allocationFailures[FtpDataProtocol], allocationFailures[NumProtocols + 1]);
+}
+
 // End
@@ -10,6 +10,7 @@
 
 #include "RepRapFirmware.h"
 #include "NetworkDefs.h"
+#include "MessageType.h"
 
 // Network buffer class. These buffers are 2K long so that they can accept as much data as the W5500 can provide in one go.
 class NetworkBuffer
@@ -58,11 +59,17 @@ public:
 	// Find the last buffer in a list
 	static NetworkBuffer *FindLast(NetworkBuffer *list);
 
-	// Allocate a buffer
-	static NetworkBuffer *Allocate();
+	// Allocate a buffer, recording which protocol wanted it if none is available
+	static NetworkBuffer *Allocate(Protocol protocolWanted = AnyProtocol);
 
-	// Alocate buffers and put them in the freelist
-	static void AllocateBuffers(unsigned int number);
+	// Return the most buffers one socket may hold for received data, a fair share of the pool
+	static unsigned int FairSharePerSocket();
+
+	// Allocate buffers and put them in the freelist, sizing the pool from the spare RAM
+	static void AllocateBuffers(unsigned int minimum, unsigned int maximum);
+
+	// Report the pool size and its high-water mark
+	static void Diagnostics(MessageType mtype);
 
 	// Count how many buffers there are in a chain
 	static unsigned int Count(NetworkBuffer*& ptr);
@@ -89,6 +96,10 @@ private:
 	uint32_t data32[bufferSize/sizeof(uint32_t)];			// 32-bit aligned buffer so we can do direct DMA
 #endif
 	static NetworkBuffer *freelist;
+	static unsigned int totalBuffers;					// how many buffers have been allocated
+	static unsigned int buffersInUse;					// how many are currently taken from the freelist
+	static unsigned int maxBuffersInUse;				// the most that have been in use at any one time
+	static unsigned int allocationFailures[NumProtocols + 2];	// failed allocations for HTTP/FTP/Telnet, the FTP data connection, and everything else
 };
 
 #endif /* SRC_DUETNG_DUETETHERNET_NETWORKBUFFER_H_ */
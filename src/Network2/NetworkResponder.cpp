@@ -41,7 +41,8 @@ void NetworkResponderLock::Release(const NetworkResponder *who)
 
 NetworkResponder::NetworkResponder(NetworkResponder *n)
 	: next(n), responderState(ResponderState::free), skt(nullptr),
-	  outBuf(nullptr), outStack(new OutputStack), fileBeingSent(nullptr), fileBuffer(nullptr)
+	  outBuf(nullptr), outStack(new OutputStack), fileBeingSent(nullptr), fileBuffer(nullptr),
+	  coalesceLength(0), coalesceSent(0)
 {
 }
 
@@ -60,25 +61,15 @@ void NetworkResponder::Commit(ResponderState nextState)
 // We send outBuf first, then outStack, and finally fileBeingSent.
 void NetworkResponder::SendData()
 {
-	// Send our output buffer and output stack
+	// Send our output buffer and output stack. Rather than handing each buffer to the socket separately, we merge runs
+	// of buffers into the coalescing buffer first, so that a reply spread over several small output buffers costs one
+	// transaction on the interface and can go out as one TCP segment instead of one per buffer.
 	for(;;)
 	{
-		if (outBuf == nullptr)
+		// Send any previously coalesced data first
+		if (coalesceSent < coalesceLength)
 		{
-			outBuf = outStack->Pop();
-			if (outBuf == nullptr)
-			{
-				break;
-			}
-		}
-		const size_t bytesLeft = outBuf->BytesLeft();
-		if (bytesLeft == 0)
-		{
-			outBuf = OutputBuffer::Release(outBuf);
-		}
-		else
-		{
-			const size_t sent = skt->Send(reinterpret_cast<const uint8_t *>(outBuf->UnreadData()), bytesLeft);
+			const size_t sent = skt->Send(coalesceBuffer + coalesceSent, coalesceLength - coalesceSent);
 			if (sent == 0)
 			{
 				// Check whether the connection has been closed
@@ -94,32 +85,61 @@ void NetworkResponder::SendData()
 				return;
 			}
 
-			outBuf->Taken(sent);				// tell the output buffer how much data we have taken
-			if (sent < bytesLeft)
+			coalesceSent += sent;
+			if (coalesceSent < coalesceLength)
 			{
 				return;
 			}
-			outBuf = OutputBuffer::Release(outBuf);
 		}
-	}
+		coalesceLength = coalesceSent = 0;
 
-	// If we get here then there are no output buffers left to send
-	// If we have a file to send, send it
-	if (fileBeingSent != nullptr && fileBuffer == nullptr)
-	{
-		fileBuffer = NetworkBuffer::Allocate();
-		if (fileBuffer == nullptr)
+		// Refill the coalescing buffer from the queued output buffers
+		while (coalesceLength < CoalesceBufferSize)
+		{
+			if (outBuf == nullptr)
+			{
+				outBuf = outStack->Pop();
+				if (outBuf == nullptr)
+				{
+					break;
+				}
+			}
+			const size_t bytesLeft = outBuf->BytesLeft();
+			if (bytesLeft == 0)
+			{
+				outBuf = OutputBuffer::Release(outBuf);
+			}
+			else
+			{
+				const size_t toCopy = min<size_t>(bytesLeft, CoalesceBufferSize - coalesceLength);
+				memcpy(coalesceBuffer + coalesceLength, outBuf->UnreadData(), toCopy);
+				outBuf->Taken(toCopy);				// tell the output buffer how much data we have taken
+				coalesceLength += toCopy;
+			}
+		}
+
+		if (coalesceLength == 0)
 		{
-			return;					// no buffer available, try again later
+			break;									// no more buffered output to send
 		}
 	}
 
-	// If we have a file buffer here, we must be in the process of sending a file
-	while (fileBuffer != nullptr)
+	// If we get here then there are no output buffers left to send
+	// If we have a file to send, send it. We keep a short chain of full buffers ahead of the socket, so that the
+	// next SD card read has already been done by the time the interface accepts the previous buffer instead of
+	// strictly alternating reads with sends.
+	while (fileBeingSent != nullptr || fileBuffer != nullptr)
 	{
-		if (fileBuffer->IsEmpty() && fileBeingSent != nullptr)
+		// Top up the chain of buffers waiting to be sent
+		while (fileBeingSent != nullptr && NetworkBuffer::Count(fileBuffer) < NumFileSendBuffers)
 		{
-			const int bytesRead = fileBuffer->ReadFromFile(fileBeingSent);
+			NetworkBuffer * const buf = NetworkBuffer::Allocate();
+			if (buf == nullptr)
+			{
+				break;				// no buffer available, send what we have already read and try again later
+			}
+			const int bytesRead = buf->ReadFromFile(fileBeingSent);
+			NetworkBuffer::AppendToList(&fileBuffer, buf);
 			if (bytesRead != (int)NetworkBuffer::bufferSize)
 			{
 				// We had a read error or we reached the end of the file
@@ -128,11 +148,15 @@ void NetworkResponder::SendData()
 			}
 		}
 
+		if (fileBuffer == nullptr)
+		{
+			return;					// we couldn't allocate a buffer at all, try again later
+		}
+
 		if (fileBuffer->IsEmpty())
 		{
-			// Must have sent the whole file
-			fileBuffer->Release();
-			fileBuffer = nullptr;
+			// Sent all the data in this buffer, move on to the next one
+			fileBuffer = fileBuffer->Release();
 		}
 		else
 		{
@@ -179,6 +203,7 @@ void NetworkResponder::ConnectionLost()
 	OutputBuffer::ReleaseAll(outBuf);
 	outBuf = nullptr;
 	outStack->ReleaseAll();
+	coalesceLength = coalesceSent = 0;					// discard any coalesced data we hadn't sent yet
 
 	if (fileBeingSent != nullptr)
 	{
@@ -186,10 +211,9 @@ void NetworkResponder::ConnectionLost()
 		fileBeingSent = nullptr;
 	}
 
-	if (fileBuffer != nullptr)
+	while (fileBuffer != nullptr)
 	{
-		fileBuffer->Release();
-		fileBuffer = nullptr;
+		fileBuffer = fileBuffer->Release();
 	}
 
 	if (skt != nullptr)
@@ -208,6 +232,7 @@ void NetworkResponder::StartUpload(FileStore *file, const char *fileName)
 	SafeStrncpy(filenameBeingUploaded, fileName, ARRAY_SIZE(filenameBeingUploaded));
 	responderState = ResponderState::uploading;
 	uploadError = false;
+	uploadStartTime = millis();
 }
 
 // If this responder has an upload in progress, cancel it
@@ -233,6 +258,8 @@ void NetworkResponder::FinishUpload(uint32_t fileLength, time_t fileLastModified
 		GetPlatform().Message(ErrorMessage, "Could not flush remaining data while finishing upload!\n");
 	}
 
+	const FilePosition bytesUploaded = fileBeingUploaded.Length();
+
 	// Check the file length is as expected
 	if (fileLength != 0 && fileBeingUploaded.Length() != fileLength)
 	{
@@ -253,10 +280,21 @@ void NetworkResponder::FinishUpload(uint32_t fileLength, time_t fileLastModified
 		{
 			GetPlatform().GetMassStorage()->Delete(FS_PREFIX, filenameBeingUploaded);
 		}
-		else if (fileLastModified != 0)
+		else
 		{
-			// Update the file timestamp if it was specified
-			(void)GetPlatform().GetMassStorage()->SetLastModifiedTime(nullptr, filenameBeingUploaded, fileLastModified);
+			if (fileLastModified != 0)
+			{
+				// Update the file timestamp if it was specified
+				(void)GetPlatform().GetMassStorage()->SetLastModifiedTime(nullptr, filenameBeingUploaded, fileLastModified);
+			}
+
+			// Report the upload throughput, which is useful when tuning the write buffering
+			const uint32_t uploadTime = millis() - uploadStartTime;
+			if (uploadTime != 0)
+			{
+				GetPlatform().MessageF(LogMessage, "Uploaded file %s, %lu bytes in %.1f seconds, %.1fKbytes/sec\n",
+										filenameBeingUploaded, bytesUploaded, (float)uploadTime/1000.0, (float)bytesUploaded/(float)uploadTime);
+			}
 		}
 	}
 
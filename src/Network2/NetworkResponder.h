@@ -54,6 +54,7 @@ protected:
 		// HTTP responder additional states
 		gettingFileInfoLock,							// waiting to get the file info lock
 		gettingFileInfo,								// getting file info
+		webSocketConnected,								// a WebSocket status push session is active
 
 		// FTP responder additional states
 		waitingForPasvPort,
@@ -63,9 +64,13 @@ protected:
 
 		// Telnet responder additional states
 		justConnected,
-		authenticating
+		authenticating,
+		streaming										// raw bulk mode, for machine clients streaming G-code
 	};
 
+	static const unsigned int NumFileSendBuffers = 2;	// how many full network buffers we try to keep queued when sending a file, so that SD card reads stay ahead of the interface
+	static const size_t CoalesceBufferSize = 2 * OUTPUT_BUFFER_SIZE;	// how much output we merge into a single socket write
+
 	NetworkResponder(NetworkResponder *n);
 
 	void Commit(ResponderState nextState = ResponderState::free);
@@ -93,11 +98,15 @@ protected:
 	OutputStack *outStack;
 	FileStore *fileBeingSent;
 	NetworkBuffer *fileBuffer;
+	uint8_t coalesceBuffer[CoalesceBufferSize];			// staging area used to merge runs of small output buffers into one socket write
+	size_t coalesceLength;								// how much of coalesceBuffer is filled
+	size_t coalesceSent;								// how much of that has been accepted by the socket
 
 	// File uploads
 	FileData fileBeingUploaded;
 	char filenameBeingUploaded[FILENAME_LENGTH];
 	uint32_t postFileLength, uploadedBytes;				// How many POST bytes do we expect and how many have already been written?
+	uint32_t uploadStartTime;							// When the upload was started, so that we can report the throughput
 	time_t fileLastModified;
 	bool uploadError;
 };
@@ -58,9 +58,23 @@ bool TelnetResponder::Spin()
 	case ResponderState::justConnected:
 		if (millis() - connectTime < TelnetSetupDuration)
 		{
-			// Discard the setup message
+			// Look for a raw mode request from a machine client, otherwise discard the setup message
 			char c;
-			while (skt->ReadChar(c)) { }
+			while (skt->ReadChar(c))
+			{
+				CharFromClient(c);
+				if (haveCompleteLine)
+				{
+					if (StringEquals(clientMessage, "RAW") && reprap.NoPasswordSet())
+					{
+						EnterRawMode();
+						return true;
+					}
+					haveCompleteLine = false;
+					clientPointer = 0;
+				}
+			}
+			clientPointer = 0;							// discard any partial line, it is probably Telnet option negotiation
 			connectTime = 0;
 			return true;
 		}
@@ -146,6 +160,60 @@ bool TelnetResponder::Spin()
 			return readSomething;
 		}
 
+	case ResponderState::streaming:
+		{
+			// Raw bulk mode: hand entire received payloads to the G-code input in one call instead of
+			// reading character by character, and acknowledge the queued lines in one batch
+			RegularGCodeInput * const telnetInput = reprap.GetGCodes().GetTelnetInput();
+			bool readSomething = false;
+			const uint8_t *buffer;
+			size_t len;
+			while (skt->ReadBuffer(buffer, len))
+			{
+				const size_t spaceLeft = telnetInput->BufferSpaceLeft();
+				if (spaceLeft == 0)
+				{
+					break;								// the G-code input is full, try again next time we are polled
+				}
+
+				const size_t toTake = min<size_t>(len, spaceLeft);
+				for (size_t i = 0; i < toTake; i++)
+				{
+					if (buffer[i] == '\n')
+					{
+						++linesQueued;
+					}
+				}
+				telnetInput->Put(TelnetMessage, reinterpret_cast<const char *>(buffer), toTake);
+				skt->Taken(toTake);
+				readSomething = true;
+				if (toTake < len)
+				{
+					break;								// the G-code input is full, try again next time we are polled
+				}
+			}
+
+			if (!readSomething && !skt->CanRead())
+			{
+				ConnectionLost();
+				return true;
+			}
+
+			// Acknowledge all the lines we queued this time in one batch, so that the client can keep
+			// many lines in flight without waiting for a reply to each one
+			if (linesQueued != 0 && (outBuf != nullptr || OutputBuffer::Allocate(outBuf)))
+			{
+				outBuf->catf("ok %u\r\n", linesQueued);
+				linesQueued = 0;
+			}
+			if (outBuf != nullptr && outBuf->BytesLeft() != 0)
+			{
+				Commit(ResponderState::streaming);
+				return true;
+			}
+			return readSomething;
+		}
+
 	case ResponderState::sending:
 		SendData();
 		return true;
@@ -208,6 +276,11 @@ void TelnetResponder::ProcessLine()
 			Commit();
 		}
 	}
+	else if (StringEquals(clientMessage, "RAW"))
+	{
+		// A machine client wants to stream G-code in raw bulk mode
+		EnterRawMode();
+	}
 	else if (reprap.GetGCodes().GetTelnetInput()->BufferSpaceLeft() >= clientPointer + 1)
 	{
 		// All other codes are stored for the GCodes class
@@ -218,9 +291,24 @@ void TelnetResponder::ProcessLine()
 	}
 }
 
+// Switch the connection to raw bulk mode. In this mode we no longer interpret the input character by
+// character, we pass whole received payloads to the G-code input and acknowledge the lines in batches,
+// which lets a machine client stream G-code much faster than the interactive line handling allows.
+void TelnetResponder::EnterRawMode()
+{
+	if (outBuf != nullptr || OutputBuffer::Allocate(outBuf))
+	{
+		haveCompleteLine = false;
+		clientPointer = 0;
+		linesQueued = 0;
+		outBuf->copy("OK\r\n");
+		Commit(ResponderState::streaming);
+	}
+}
+
 void TelnetResponder::HandleGCodeReply(const char *reply)
 {
-	if (reply != nullptr && (responderState == ResponderState::reading || responderState == ResponderState::sending))
+	if (reply != nullptr && (responderState == ResponderState::reading || responderState == ResponderState::sending || responderState == ResponderState::streaming))
 	{
 		// We need a valid OutputBuffer to start the conversion from NL to CRNL
 		if (outBuf == nullptr)
@@ -252,7 +340,7 @@ void TelnetResponder::HandleGCodeReply(const char *reply)
 
 void TelnetResponder::HandleGCodeReply(OutputBuffer *reply)
 {
-	if (reply != nullptr && (responderState == ResponderState::reading || responderState == ResponderState::sending))
+	if (reply != nullptr && (responderState == ResponderState::reading || responderState == ResponderState::sending || responderState == ResponderState::streaming))
 	{
 		// We need a valid OutputBuffer to start the conversion from NL to CRNL
 		if (outBuf == nullptr)
@@ -25,11 +25,13 @@ public:
 private:
 	void CharFromClient(char c);
 	void ProcessLine();
+	void EnterRawMode();
 
 	bool haveCompleteLine;
 	char clientMessage[GCODE_LENGTH];
 	size_t clientPointer;
 	uint32_t connectTime;
+	unsigned int linesQueued;							// in raw mode, the number of complete lines queued since the last acknowledgement
 
 	static const uint32_t TelnetSetupDuration = 4000;	// ignore the first Telnet request within this duration (in ms)
 };
@@ -0,0 +1,169 @@
+/*
+ * Mdns.cpp
+ *
+ * Lightweight mDNS announcements for the W5500 interface. We only send unsolicited announcements;
+ * we do not answer queries, because the only spare W5500 socket is shared with the DHCP client and
+ * so cannot stay bound to the mDNS port. Periodic announcements are enough for listeners that
+ * maintain a cache, which lets a farm controller discover printers passively instead of sweeping
+ * the subnet.
+ */
+
+#include <Network2/W5500/Mdns.h>
+#include <Network2/W5500/Network.h>
+#include <Network2/W5500/Wiznet/Ethernet/socketlib.h>
+
+#include <cstring>
+
+static const uint8_t MdnsGroupIp[4] = { 224, 0, 0, 251 };
+static const uint8_t MdnsGroupMac[6] = { 0x01, 0x00, 0x5E, 0x00, 0x00, 0xFB };
+static const Port MdnsPort = 5353;
+static const uint32_t MdnsTtl = 120;							// record time-to-live in seconds
+
+static const size_t MdnsPacketBufferSize = 512;
+
+// DNS record types and the mDNS cache-flush class
+static const uint16_t TypeA = 0x0001;
+static const uint16_t TypePtr = 0x000C;
+static const uint16_t TypeSrv = 0x0021;
+static const uint16_t ClassIn = 0x0001;
+static const uint16_t ClassInFlush = 0x8001;
+
+// The service instance name for each protocol, in protocol number order
+static const char * const MdnsServiceNames[NumProtocols] = { "_http", "_ftp", "_telnet" };
+
+// We use the socket that the DHCP client owns. DHCP_run re-opens its socket whenever it finds
+// it closed, so it is safe to borrow it briefly between DHCP transactions.
+static const SocketNumber MdnsSocketNumber = DhcpSocketNumber;
+
+static void PutU16(uint8_t *buf, size_t& p, uint16_t val)
+{
+	buf[p++] = (uint8_t)(val >> 8);
+	buf[p++] = (uint8_t)val;
+}
+
+static void PutU32(uint8_t *buf, size_t& p, uint32_t val)
+{
+	buf[p++] = (uint8_t)(val >> 24);
+	buf[p++] = (uint8_t)(val >> 16);
+	buf[p++] = (uint8_t)(val >> 8);
+	buf[p++] = (uint8_t)val;
+}
+
+// Append one name label
+static void PutLabel(uint8_t *buf, size_t& p, const char *label)
+{
+	const size_t len = strlen(label);
+	buf[p++] = (uint8_t)len;
+	memcpy(buf + p, label, len);
+	p += len;
+}
+
+// Append "<hostname>.local" with the terminating zero label
+static void PutHostName(uint8_t *buf, size_t& p, const char *hostname)
+{
+	PutLabel(buf, p, hostname);
+	PutLabel(buf, p, "local");
+	buf[p++] = 0;
+}
+
+// Append "<service>._tcp.local" with the terminating zero label, optionally prefixed by the instance name
+static void PutServiceName(uint8_t *buf, size_t& p, const char *instance, const char *service)
+{
+	if (instance != nullptr)
+	{
+		PutLabel(buf, p, instance);
+	}
+	PutLabel(buf, p, service);
+	PutLabel(buf, p, "_tcp");
+	PutLabel(buf, p, "local");
+	buf[p++] = 0;
+}
+
+// Append the type, class, TTL and data length fields of a resource record, returning the offset
+// of the data length field so that it can be filled in when the record data is complete
+static size_t PutRecordHeader(uint8_t *buf, size_t& p, uint16_t type, uint16_t cls)
+{
+	PutU16(buf, p, type);
+	PutU16(buf, p, cls);
+	PutU32(buf, p, MdnsTtl);
+	const size_t lengthOffset = p;
+	PutU16(buf, p, 0);
+	return lengthOffset;
+}
+
+static void FillInRecordLength(uint8_t *buf, size_t lengthOffset, size_t p)
+{
+	const uint16_t rdLength = (uint16_t)(p - (lengthOffset + 2));
+	buf[lengthOffset] = (uint8_t)(rdLength >> 8);
+	buf[lengthOffset + 1] = (uint8_t)rdLength;
+}
+
+void MdnsAnnounce(const char *hostname, const uint8_t ipAddress[4], const Port portNumbers[], const bool protocolEnabled[])
+{
+	uint8_t buf[MdnsPacketBufferSize];
+	size_t p = 0;
+
+	// DNS header: zero ID, authoritative response, no questions
+	PutU16(buf, p, 0);										// transaction ID, always 0 for multicast responses
+	PutU16(buf, p, 0x8400);									// flags: response, authoritative
+	PutU16(buf, p, 0);										// question count
+	const size_t answerCountOffset = p;
+	PutU16(buf, p, 0);										// answer count, filled in below
+	PutU16(buf, p, 0);										// authority count
+	PutU16(buf, p, 0);										// additional count
+
+	uint16_t numAnswers = 0;
+
+	// Address record, so that "<hostname>.local" resolves to us
+	PutHostName(buf, p, hostname);
+	{
+		const size_t lengthOffset = PutRecordHeader(buf, p, TypeA, ClassInFlush);
+		memcpy(buf + p, ipAddress, 4);
+		p += 4;
+		FillInRecordLength(buf, lengthOffset, p);
+	}
+	++numAnswers;
+
+	// One pointer and one service record per enabled protocol, so that service browsers find us
+	for (size_t protocol = 0; protocol < NumProtocols; ++protocol)
+	{
+		if (protocolEnabled[protocol])
+		{
+			PutServiceName(buf, p, nullptr, MdnsServiceNames[protocol]);
+			{
+				const size_t lengthOffset = PutRecordHeader(buf, p, TypePtr, ClassIn);
+				PutServiceName(buf, p, hostname, MdnsServiceNames[protocol]);
+				FillInRecordLength(buf, lengthOffset, p);
+			}
+			++numAnswers;
+
+			PutServiceName(buf, p, hostname, MdnsServiceNames[protocol]);
+			{
+				const size_t lengthOffset = PutRecordHeader(buf, p, TypeSrv, ClassInFlush);
+				PutU16(buf, p, 0);							// priority
+				PutU16(buf, p, 0);							// weight
+				PutU16(buf, p, portNumbers[protocol]);
+				PutHostName(buf, p, hostname);
+				FillInRecordLength(buf, lengthOffset, p);
+			}
+			++numAnswers;
+		}
+	}
+
+	buf[answerCountOffset] = (uint8_t)(numAnswers >> 8);
+	buf[answerCountOffset + 1] = (uint8_t)numAnswers;
+
+	// Borrow the shared socket for one multicast send. The destination registers must be set up
+	// before the socket is opened in multicast mode.
+	close(MdnsSocketNumber);
+	setSn_DIPR(MdnsSocketNumber, MdnsGroupIp);
+	setSn_DPORT(MdnsSocketNumber, MdnsPort);
+	setSn_DHAR(MdnsSocketNumber, MdnsGroupMac);
+	if (socket(MdnsSocketNumber, Sn_MR_UDP, MdnsPort, SF_MULTI_ENABLE) == (int8_t)MdnsSocketNumber)
+	{
+		(void)sendto(MdnsSocketNumber, buf, (uint16_t)p, MdnsGroupIp, MdnsPort);
+	}
+	close(MdnsSocketNumber);								// give the socket back to the DHCP client
+}
+
+// End
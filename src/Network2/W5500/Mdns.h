@@ -0,0 +1,22 @@
+/*
+ * Mdns.h
+ *
+ * Lightweight mDNS announcements for the W5500 interface, so that hosts on the LAN can
+ * discover the printer and resolve its hostname without polling sweeps.
+ */
+
+#ifndef SRC_NETWORK2_W5500_MDNS_H_
+#define SRC_NETWORK2_W5500_MDNS_H_
+
+#include "NetworkDefs.h"
+
+// Multicast an unsolicited mDNS announcement carrying our address record and one service record
+// per enabled protocol. Called when the network comes up, when the hostname or a protocol changes,
+// and periodically to refresh the records before their TTL expires.
+void MdnsAnnounce(const char *hostname, const uint8_t ipAddress[4], const Port portNumbers[], const bool protocolEnabled[]);
+
+// How often to repeat the announcement, in milliseconds. Half the record TTL, so that listeners
+// never see our records expire while we are up.
+const uint32_t MdnsAnnouncementInterval = 60000;
+
+#endif /* SRC_NETWORK2_W5500_MDNS_H_ */
@@ -8,6 +8,7 @@
 #include <Network2/W5500/Network.h>
 #include <Network2/W5500/Wiznet/Ethernet/wizchip_conf.h>
 #include <Network2/W5500/Wiznet/Internet/DHCP/dhcp.h>
+#include <Network2/W5500/Mdns.h>
 #include "NetworkBuffer.h"
 #include "Platform.h"
 #include "RepRap.h"
@@ -20,7 +21,7 @@ const Port DefaultPortNumbers[NumProtocols] = { DefaultHttpPort, DefaultFtpPort,
 const char * const ProtocolNames[NumProtocols] = { "HTTP", "FTP", "TELNET" };
 
 Network::Network(Platform& p)
-	: platform(p), nextResponderToPoll(nullptr), lastTickMillis(0),
+	: platform(p), nextResponderToPoll(nullptr), lastTickMillis(0), whenLastMdnsAnnounce(0),
 	  state(NetworkState::disabled), activated(false)
 {
 	for (size_t i = 0; i < NumProtocols; ++i)
@@ -45,7 +46,7 @@ void Network::Init()
 	longWait = millis();
 	lastTickMillis = millis();
 
-	NetworkBuffer::AllocateBuffers(NetworkBufferCount);
+	NetworkBuffer::AllocateBuffers(NetworkBufferCount, MaxNetworkBufferCount);
 
 	SetIPAddress(DefaultIpAddress, DefaultNetMask, DefaultGateway);
 	strcpy(hostname, HOSTNAME);
@@ -70,15 +71,11 @@ void Network::EnableProtocol(int protocol, int port, int secure, StringRef& repl
 		if (!protocolEnabled[protocol])
 		{
 			protocolEnabled[protocol] = true;
+			UpdateSocketBufferSizes();
 			if (state == NetworkState::active)
 			{
 				StartProtocol(protocol);
-#if 0	// mdns not implemented yet
-				if (state == NetworkState::active)
-				{
-					DoMdnsAnnounce();
-				}
-#endif
+				DoMdnsAnnounce();
 			}
 		}
 		ReportOneProtocol(protocol, reply);
@@ -98,6 +95,31 @@ void Network::DisableProtocol(int protocol, StringRef& reply)
 			ShutdownProtocol(protocol);
 		}
 		protocolEnabled[protocol] = false;
+		UpdateSocketBufferSizes();
+
+		// The sockets of the disabled protocol are closed now, so release their buffer memory for other sockets to claim
+		switch (protocol)
+		{
+		case HttpProtocol:
+			for (SocketNumber skt = 0; skt < NumHttpSockets; ++skt)
+			{
+				ApplySocketBufferSize(skt);
+			}
+			break;
+
+		case FtpProtocol:
+			ApplySocketBufferSize(FtpSocketNumber);
+			ApplySocketBufferSize(FtpDataSocketNumber);
+			break;
+
+		case TelnetProtocol:
+			ApplySocketBufferSize(TelnetSocketNumber);
+			break;
+
+		default:
+			break;
+		}
+
 		ReportOneProtocol(protocol, reply);
 	}
 	else
@@ -229,13 +251,9 @@ void Network::Start()
 	IoPort::WriteDigital(W5500ResetPin, HIGH);	// raise /Reset pin
 	delay(55);									// W5500 needs 50ms to start up
 
-#ifdef USE_3K_BUFFERS
-	static const uint8_t bufSizes[8] = { 3, 3, 3, 3, 1, 1, 1, 1 };	// 3K buffers for http, 1K for everything else (FTP will be slow)
-#else
-	static const uint8_t bufSizes[8] = { 2, 2, 2, 2, 2, 2, 2, 2 };	// 2K buffers for everything
-#endif
-
-	wizchip_init(bufSizes, bufSizes);
+	UpdateSocketBufferSizes();
+	wizchip_init(wantedBufSizes, wantedBufSizes);
+	memcpy(appliedBufSizes, wantedBufSizes, sizeof(appliedBufSizes));
 
 	setSHAR(platform.MACAddress());
 	setSIPR(ipAddress);
@@ -310,9 +328,6 @@ void Network::Spin(bool full)
 				{
 //					debugPrintf("IP address obtained, network running\n");
 					getSIPR(ipAddress);
-					// Send mDNS announcement so that some routers can perform hostname mapping
-					// if this board is connected via a non-IGMP capable WiFi bridge (like the TP-Link WR701N)
-					//mdns_announce();
 					state = NetworkState::connected;
 				}
 			}
@@ -332,6 +347,10 @@ void Network::Spin(bool full)
 			InitSockets();
 			platform.MessageF(NetworkInfoMessage, "Network running, IP address = %s\n", IP4String(ipAddress).c_str());
 			state = NetworkState::active;
+			// Announce ourselves, so that hosts can resolve our hostname and a farm controller can
+			// discover us without sweeping the subnet. Also helps some routers perform hostname
+			// mapping when this board is connected via a non-IGMP capable WiFi bridge.
+			DoMdnsAnnounce();
 		}
 		break;
 
@@ -353,9 +372,16 @@ void Network::Spin(bool full)
 				{
 //					debugPrintf("IP address changed\n");
 					getSIPR(ipAddress);
+					DoMdnsAnnounce();
 				}
 			}
 
+			// Refresh our mDNS records before they expire from the listeners' caches
+			if (full && millis() - whenLastMdnsAnnounce >= MdnsAnnouncementInterval)
+			{
+				DoMdnsAnnounce();
+			}
+
 			// Poll the next TCP socket
 			sockets[nextSocketToPoll].Poll(full);
 
@@ -406,6 +432,7 @@ void Network::Diagnostics(MessageType mtype)
 {
 	platform.Message(mtype, "=== Network ===\n");
 	platform.MessageF(mtype, "State: %d\n", (int)state);
+	NetworkBuffer::Diagnostics(mtype);
 	HttpResponder::CommonDiagnostics(mtype);
 	platform.Message(mtype, "Responder states:");
 	for (NetworkResponder *r = responders; r != nullptr; r = r->GetNext())
@@ -475,6 +502,18 @@ void Network::SetHostname(const char *name)
 	{
 		strcpy(hostname, HOSTNAME);
 	}
+
+	if (state == NetworkState::active)
+	{
+		DoMdnsAnnounce();							// tell the LAN about the new name straight away
+	}
+}
+
+// Multicast an mDNS announcement of our hostname and enabled protocols
+void Network::DoMdnsAnnounce()
+{
+	MdnsAnnounce(hostname, ipAddress, portNumbers, protocolEnabled);
+	whenLastMdnsAnnounce = millis();
 }
 
 void Network::OpenDataPort(Port port)
@@ -488,6 +527,71 @@ void Network::TerminateDataPort()
 	sockets[FtpDataSocketNumber].Terminate();
 }
 
+// Decide how the 16Kb of on-chip buffer memory per direction is shared out among the sockets. Sockets of disabled
+// protocols get none; Telnet, FTP control and DHCP carry only short messages so they get the 1Kb minimum; the FTP
+// data socket, which carries a single bulk transfer when it is used at all, gets 4Kb; and the HTTP sockets divide
+// whatever is left, weighted towards the lowest-numbered ones because the chip hands a new connection to the lowest
+// listening socket. With only HTTP enabled (the usual configuration) the first HTTP socket gets an 8Kb window,
+// four times what the old equal partition allowed a single bulk upload or download.
+// Buffer sizes must be powers of two. The new shares take effect as each socket is next (re)initialised.
+void Network::UpdateSocketBufferSizes()
+{
+	wantedBufSizes[DhcpSocketNumber] = 1;
+	wantedBufSizes[TelnetSocketNumber] = (protocolEnabled[TelnetProtocol]) ? 1 : 0;
+	wantedBufSizes[FtpSocketNumber] = (protocolEnabled[FtpProtocol]) ? 1 : 0;
+	wantedBufSizes[FtpDataSocketNumber] = (protocolEnabled[FtpProtocol]) ? 4 : 0;
+
+	uint8_t remaining = W5500TotalBufferKb
+							- (wantedBufSizes[FtpSocketNumber] + wantedBufSizes[FtpDataSocketNumber]
+								+ wantedBufSizes[TelnetSocketNumber] + wantedBufSizes[DhcpSocketNumber]);
+	for (size_t skt = 0; skt < NumHttpSockets; ++skt)
+	{
+		const uint8_t reservedForOthers = NumHttpSockets - skt - 1;		// the remaining HTTP sockets need 1Kb each
+		uint8_t size = 1;
+		while (size < 8 && size * 2 <= remaining - reservedForOthers)
+		{
+			size *= 2;
+		}
+		wantedBufSizes[skt] = size;
+		remaining -= size;
+	}
+}
+
+// Give a closed socket its currently wanted share of the chip buffer memory. Called when a socket is about to be
+// (re)opened, which is the only time its buffer may safely be resized. Shrinking always succeeds; growing is skipped
+// if some other socket has not released its old share yet, in which case this socket keeps its old size until the
+// next reallocation rather than overcommitting the chip memory.
+void Network::ApplySocketBufferSize(SocketNumber skt)
+{
+	if (state == NetworkState::disabled || state == NetworkState::enabled)
+	{
+		return;											// the chip is held in reset; Start() programs all the sizes when it comes up
+	}
+
+	const uint8_t wanted = wantedBufSizes[skt];
+	if (wanted != appliedBufSizes[skt])
+	{
+		if (wanted > appliedBufSizes[skt])
+		{
+			uint8_t total = wanted;
+			for (size_t i = 0; i < NumW5500Sockets; ++i)
+			{
+				if (i != skt)
+				{
+					total += appliedBufSizes[i];
+				}
+			}
+			if (total > W5500TotalBufferKb)
+			{
+				return;
+			}
+		}
+		setSn_TXBUF_SIZE(skt, wanted);
+		setSn_RXBUF_SIZE(skt, wanted);
+		appliedBufSizes[skt] = wanted;
+	}
+}
+
 void Network::InitSockets()
 {
 	for (size_t i = 0; i < NumProtocols; ++i)
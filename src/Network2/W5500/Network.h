@@ -25,6 +25,8 @@ const SocketNumber FtpDataSocketNumber = 5;		// TODO can we allocate this dynami
 const SocketNumber TelnetSocketNumber = 6;
 const size_t NumTcpSockets = 7;
 const SocketNumber DhcpSocketNumber = 7;		// TODO can we allocate this dynamically when required, to allow more http sockets most of the time?
+const size_t NumW5500Sockets = 8;				// how many hardware sockets the chip has
+const uint8_t W5500TotalBufferKb = 16;			// how much transmit memory the chip has, in Kbytes (receive memory is the same)
 
 const unsigned int NumHttpResponders = 4;		// the number of concurrent HTTP requests we can process
 
@@ -37,6 +39,7 @@ public:
 	Network(Platform& p);
 
 	void Init();
+	void Prepare() { }									// nothing useful to do before config.g, because the W5500 setup needs the IP address from it
 	void Activate();
 	void Exit();
 	void Spin(bool full);
@@ -56,6 +59,8 @@ public:
 
 	bool FindResponder(Socket *skt, Protocol protocol);
 
+	void ApplySocketBufferSize(SocketNumber skt);		// give a closed socket its currently wanted share of the chip buffer memory
+
 	const uint8_t *GetIPAddress() const { return ipAddress; }
 	void OpenDataPort(Port port);
 	void TerminateDataPort();
@@ -79,6 +84,8 @@ private:
 
 	void InitSockets();
 	void TerminateSockets();
+	void DoMdnsAnnounce();
+	void UpdateSocketBufferSizes();					// recompute the per-socket buffer shares from the enabled protocols
 
 	void StartProtocol(Protocol protocol)
 	pre(protocol < NumProtocols);
@@ -98,6 +105,7 @@ private:
 	TelnetResponder *telnetResponder;
 	uint32_t longWait;
 	uint32_t lastTickMillis;
+	uint32_t whenLastMdnsAnnounce;					// when we last multicast an mDNS announcement
 
 	Socket sockets[NumTcpSockets];
 	size_t nextSocketToPoll;						// next TCP socket number to poll for read/write operations
@@ -105,6 +113,12 @@ private:
 	Port portNumbers[NumProtocols];					// port number used for each protocol
 	bool protocolEnabled[NumProtocols];				// whether each protocol is enabled
 
+	// Socket buffer allocation. The 16Kb of on-chip memory per direction is shared out according to which
+	// protocols are enabled, instead of being partitioned equally; wantedBufSizes is what we would like each
+	// socket to have and appliedBufSizes is what its size registers are actually set to.
+	uint8_t wantedBufSizes[NumW5500Sockets];
+	uint8_t appliedBufSizes[NumW5500Sockets];
+
 	NetworkState state;
 	bool activated;
 	bool usingDhcp;
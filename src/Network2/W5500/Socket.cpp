@@ -15,7 +15,6 @@
 // Socket class
 
 const uint32_t FindResponderTimeout = 2000;			// how long we wait for a responder to become available
-const unsigned int MaxBuffersPerSocket = 4;
 
 Socket::Socket() : receivedData(nullptr), state(SocketState::disabled)
 {
@@ -49,6 +48,9 @@ void Socket::ReInit()
 	isSending = false;
 	state = SocketState::inactive;
 
+	// The socket is closed, so this is the one safe time to change its share of the chip buffer memory
+	reprap.GetNetwork().ApplySocketBufferSize(socketNum);
+
 	// Re-initialise the socket on the W5500
 	socket(socketNum, Sn_MR_TCP, localPort, 0x00);
 }
@@ -212,8 +214,9 @@ void Socket::ReceiveData()
 	if (len != 0)
 	{
 //		debugPrintf("%u available\n", len);
+		const unsigned int maxBuffers = NetworkBuffer::FairSharePerSocket();
 		NetworkBuffer * const lastBuffer = NetworkBuffer::FindLast(receivedData);
-		if (lastBuffer != nullptr && (lastBuffer->SpaceLeft() >= len || (lastBuffer->SpaceLeft() != 0 && NetworkBuffer::Count(receivedData) >= MaxBuffersPerSocket)))
+		if (lastBuffer != nullptr && (lastBuffer->SpaceLeft() >= len || (lastBuffer->SpaceLeft() != 0 && NetworkBuffer::Count(receivedData) >= maxBuffers)))
 		{
 			const size_t lengthToRead = min<size_t>((size_t)len, lastBuffer->SpaceLeft());
 			wiz_recv_data(socketNum, lastBuffer->UnwrittenData(), (uint16_t)lengthToRead);
@@ -223,9 +226,9 @@ void Socket::ReceiveData()
 				debugPrintf("Received %u bytes\n", (unsigned int)lengthToRead);
 			}
 		}
-		else if (NetworkBuffer::Count(receivedData) < MaxBuffersPerSocket)
+		else if (NetworkBuffer::Count(receivedData) < maxBuffers)
 		{
-			NetworkBuffer * const buf = NetworkBuffer::Allocate();
+			NetworkBuffer * const buf = NetworkBuffer::Allocate(protocol);
 			if (buf != nullptr)
 			{
 				wiz_recv_data(socketNum, buf->Data(), len);
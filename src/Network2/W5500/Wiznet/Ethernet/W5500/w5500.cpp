@@ -95,18 +95,31 @@ void WIZCHIP_WRITE_BUF(uint32_t AddrSel, const uint8_t* pBuf, uint16_t len)
 	WizSpi::ReleaseSS();
 }
 
+// Read a 16-bit register pair in a single SPI transaction instead of one transaction per byte,
+// saving the second 3-byte address phase and the slave select overhead
+uint16_t WIZCHIP_READ_WORD(uint32_t AddrSel)
+{
+	uint8_t buf[2];
+	WIZCHIP_READ_BUF(AddrSel, buf, 2);
+	return ((uint16_t)buf[0] << 8) | buf[1];
+}
+
+// Write a 16-bit register pair in a single SPI transaction
+void WIZCHIP_WRITE_WORD(uint32_t AddrSel, uint16_t w)
+{
+	const uint8_t buf[2] = { (uint8_t)(w >> 8), (uint8_t)w };
+	WIZCHIP_WRITE_BUF(AddrSel, buf, 2);
+}
 
 uint16_t getSn_TX_FSR(uint8_t sn)
 {
 	uint16_t val = 0, val1 = 0;
 	do
 	{
-		val1 = WIZCHIP_READ(Sn_TX_FSR(sn));
-		val1 = (val1 << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_FSR(sn),1));
+		val1 = WIZCHIP_READ_WORD(Sn_TX_FSR(sn));
 		if (val1 != 0)
 		{
-			val = WIZCHIP_READ(Sn_TX_FSR(sn));
-			val = (val << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_FSR(sn),1));
+			val = WIZCHIP_READ_WORD(Sn_TX_FSR(sn));
 		}
 	} while (val != val1);
 	return val;
@@ -117,12 +130,10 @@ uint16_t getSn_RX_RSR(uint8_t sn)
 	uint16_t val = 0, val1 = 0;
 	do
 	{
-		val1 = WIZCHIP_READ(Sn_RX_RSR(sn));
-		val1 = (val1 << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_RSR(sn),1));
+		val1 = WIZCHIP_READ_WORD(Sn_RX_RSR(sn));
 		if (val1 != 0)
 		{
-			val = WIZCHIP_READ(Sn_RX_RSR(sn));
-			val = (val << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_RSR(sn),1));
+			val = WIZCHIP_READ_WORD(Sn_RX_RSR(sn));
 		}
 	} while (val != val1);
 	return val;
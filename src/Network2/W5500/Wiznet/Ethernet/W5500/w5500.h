@@ -1301,6 +1301,23 @@ void     WIZCHIP_READ_BUF (uint32_t AddrSel, uint8_t* pBuf, uint16_t len);
  */
 void     WIZCHIP_WRITE_BUF(uint32_t AddrSel, const uint8_t* pBuf, uint16_t len);
 
+/**
+ * @ingroup Basic_IO_function
+ * @brief It reads a big-endian 16-bit register pair in a single SPI transaction.
+ * @param AddrSel Register address of the most significant byte
+ * @return The value of the register pair
+ */
+uint16_t WIZCHIP_READ_WORD (uint32_t AddrSel);
+
+/**
+ * @ingroup Basic_IO_function
+ * @brief It writes a big-endian 16-bit register pair in a single SPI transaction.
+ * @param AddrSel Register address of the most significant byte
+ * @param w Write data
+ * @return void
+ */
+void     WIZCHIP_WRITE_WORD(uint32_t AddrSel, uint16_t w);
+
 /////////////////////////////////
 // Common Register I/O function //
 /////////////////////////////////
@@ -2097,8 +2114,7 @@ uint16_t getSn_TX_FSR(uint8_t sn);
  */
 static inline uint16_t getSn_TX_RD(uint8_t sn)
 {
-	const uint8_t msb = WIZCHIP_READ(Sn_TX_RD(sn));
-	return ((uint16_t)msb << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_RD(sn),1));
+	return WIZCHIP_READ_WORD(Sn_TX_RD(sn));
 }
 
 /**
@@ -2110,8 +2126,7 @@ static inline uint16_t getSn_TX_RD(uint8_t sn)
  */
 static inline void setSn_TX_WR(uint8_t sn, uint16_t txwr)
 {
-	WIZCHIP_WRITE(Sn_TX_WR(sn), (uint8_t)(txwr >> 8));
-	WIZCHIP_WRITE(WIZCHIP_OFFSET_INC(Sn_TX_WR(sn), 1), (uint8_t) txwr);
+	WIZCHIP_WRITE_WORD(Sn_TX_WR(sn), txwr);
 }
 
 /**
@@ -2123,8 +2138,7 @@ static inline void setSn_TX_WR(uint8_t sn, uint16_t txwr)
  */
 static inline uint16_t getSn_TX_WR(uint8_t sn)
 {
-	const uint8_t msb = WIZCHIP_READ(Sn_TX_WR(sn));
-	return ((uint16_t)msb << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_TX_WR(sn),1));
+	return WIZCHIP_READ_WORD(Sn_TX_WR(sn));
 }
 
 
@@ -2146,8 +2160,7 @@ uint16_t getSn_RX_RSR(uint8_t sn);
  */
 static inline void setSn_RX_RD(uint8_t sn, uint16_t rxrd)
 {
-	WIZCHIP_WRITE(Sn_RX_RD(sn), (uint8_t)(rxrd >> 8));
-	WIZCHIP_WRITE(WIZCHIP_OFFSET_INC(Sn_RX_RD(sn),1), (uint8_t) rxrd);
+	WIZCHIP_WRITE_WORD(Sn_RX_RD(sn), rxrd);
 }
 
 /**
@@ -2159,8 +2172,7 @@ static inline void setSn_RX_RD(uint8_t sn, uint16_t rxrd)
  */
 static inline uint16_t getSn_RX_RD(uint8_t sn)
 {
-	const uint8_t msb = WIZCHIP_READ(Sn_RX_RD(sn));
-	return ((uint16_t)msb << 8) + WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_RD(sn), 1));
+	return WIZCHIP_READ_WORD(Sn_RX_RD(sn));
 }
 
 /**
@@ -2171,8 +2183,7 @@ static inline uint16_t getSn_RX_RD(uint8_t sn)
  */
 static inline uint16_t getSn_RX_WR(uint8_t sn)
 {
-	const uint8_t msb = WIZCHIP_READ(Sn_RX_WR(sn));
-	return ((uint16_t)msb << 8) | WIZCHIP_READ(WIZCHIP_OFFSET_INC(Sn_RX_WR(sn), 1));
+	return WIZCHIP_READ_WORD(Sn_RX_WR(sn));
 }
 
 /**
@@ -13,6 +13,9 @@
 /*static*/ OutputBuffer * volatile OutputBuffer::freeOutputBuffers = nullptr;		// Messages may also be sent by ISRs,
 /*static*/ volatile size_t OutputBuffer::usedOutputBuffers = 0;						// so make these volatile.
 /*static*/ volatile size_t OutputBuffer::maxUsedOutputBuffers = 0;
+/*static*/ volatile uint32_t OutputBuffer::failedAllocations = 0;
+/*static*/ volatile uint32_t OutputBuffer::droppedLowPriorityMessages = 0;
+/*static*/ size_t OutputBuffer::totalOutputBuffers = OUTPUT_BUFFER_COUNT;
 
 //*************************************************************************************************
 // OutputBuffer class implementation
@@ -77,14 +80,14 @@ char OutputBuffer::operator[](size_t index) const
 	}
 
 	// Return the char reference
-	return itemToIndex->data[index];
+	return itemToIndex->Data()[index];
 }
 
 const char *OutputBuffer::Read(size_t len)
 {
 	size_t offset = bytesRead;
 	bytesRead += len;
-	return data + offset;
+	return Data() + offset;
 }
 
 size_t OutputBuffer::printf(const char *fmt, ...)
@@ -92,7 +95,7 @@ size_t OutputBuffer::printf(const char *fmt, ...)
 	char formatBuffer[FORMAT_STRING_LENGTH];
 	va_list vargs;
 	va_start(vargs, fmt);
-	vsnprintf(formatBuffer, ARRAY_SIZE(formatBuffer), fmt, vargs);
+	SafeVsnprintf(formatBuffer, ARRAY_SIZE(formatBuffer), fmt, vargs);
 	va_end(vargs);
 
 	return copy(formatBuffer);
@@ -101,7 +104,7 @@ size_t OutputBuffer::printf(const char *fmt, ...)
 size_t OutputBuffer::vprintf(const char *fmt, va_list vargs)
 {
 	char formatBuffer[FORMAT_STRING_LENGTH];
-	vsnprintf(formatBuffer, ARRAY_SIZE(formatBuffer), fmt, vargs);
+	SafeVsnprintf(formatBuffer, ARRAY_SIZE(formatBuffer), fmt, vargs);
 
 	return cat(formatBuffer);
 }
@@ -111,7 +114,7 @@ size_t OutputBuffer::catf(const char *fmt, ...)
 	char formatBuffer[FORMAT_STRING_LENGTH];
 	va_list vargs;
 	va_start(vargs, fmt);
-	vsnprintf(formatBuffer, ARRAY_SIZE(formatBuffer), fmt, vargs);
+	SafeVsnprintf(formatBuffer, ARRAY_SIZE(formatBuffer), fmt, vargs);
 	va_end(vargs);
 
 	formatBuffer[ARRAY_UPB(formatBuffer)] = 0;
@@ -129,6 +132,7 @@ size_t OutputBuffer::copy(const char c)
 	}
 
 	// Set the date
+	referencedData = nullptr;
 	data[0] = c;
 	dataLength = 1;
 	return 1;
@@ -149,6 +153,7 @@ size_t OutputBuffer::copy(const char *src, size_t len)
 		last = this;
 	}
 
+	referencedData = nullptr;
 	dataLength = 0;
 	return cat(src, len);
 }
@@ -156,7 +161,7 @@ size_t OutputBuffer::copy(const char *src, size_t len)
 size_t OutputBuffer::cat(const char c)
 {
 	// See if we can append a char
-	if (last->dataLength == OUTPUT_BUFFER_SIZE)
+	if (last->SpaceLeft() == 0)
 	{
 		// No - allocate a new item and copy the data
 		OutputBuffer *nextBuffer;
@@ -193,7 +198,7 @@ size_t OutputBuffer::cat(const char *src, size_t len)
 	size_t copied = 0;
 	while (copied < len)
 	{
-		if (last->dataLength == OUTPUT_BUFFER_SIZE)
+		if (last->SpaceLeft() == 0)
 		{
 			// The last buffer is full
 			OutputBuffer *nextBuffer;
@@ -210,7 +215,7 @@ size_t OutputBuffer::cat(const char *src, size_t len)
 				item->last = last;
 			}
 		}
-		const size_t copyLength = min<size_t>(len - copied, OUTPUT_BUFFER_SIZE - last->dataLength);
+		const size_t copyLength = min<size_t>(len - copied, last->SpaceLeft());
 		memcpy(last->data + last->dataLength, src + copied, copyLength);
 		last->dataLength += copyLength;
 		copied += copyLength;
@@ -223,6 +228,96 @@ size_t OutputBuffer::cat(StringRef &str)
 	return cat(str.Pointer(), str.Length());
 }
 
+size_t OutputBuffer::catRef(const char *src)
+{
+	return catRef(src, strlen(src));
+}
+
+// Append a reference to immutable data, typically a static string in flash memory, instead of copying it.
+// The data must remain valid until the buffer has been sent. A referencing item can describe any length of
+// data, so this also avoids chaining up many buffers for large static content.
+size_t OutputBuffer::catRef(const char *src, size_t len)
+{
+	if (len == 0)
+	{
+		return 0;
+	}
+
+	OutputBuffer *holder;
+	if (last->dataLength == 0 && last->referencedData == nullptr)
+	{
+		// The last buffer is still empty, so it can hold the reference itself
+		holder = last;
+	}
+	else
+	{
+		if (!Allocate(holder))
+		{
+			// We cannot store any more data. Should never happen
+			return 0;
+		}
+		holder->references = references;
+		last->next = holder;
+		last = holder;
+		for (OutputBuffer *item = this; item != holder; item = item->Next())
+		{
+			item->last = holder;
+		}
+	}
+	holder->referencedData = src;
+	holder->dataLength = len;
+	return len;
+}
+
+// Append a JSON template, rendering one entry of values[] into each value slot marker. The literal stretches
+// between the markers are copied in bulk, so only the values themselves go through the printf machinery.
+// Returns the number of bytes written.
+size_t OutputBuffer::catTemplate(const char *skeleton, const TemplateValue values[])
+{
+	size_t bytesWritten = 0;
+	const char *segmentStart = skeleton;
+	size_t valueIndex = 0;
+	for (const char *p = skeleton; ; ++p)
+	{
+		const char marker = *p;
+		if (marker == 0 || (marker >= TemplateInt && marker <= TemplateChar))
+		{
+			if (p != segmentStart)
+			{
+				bytesWritten += cat(segmentStart, p - segmentStart);
+			}
+			if (marker == 0)
+			{
+				break;
+			}
+			const TemplateValue& v = values[valueIndex++];
+			switch (marker)
+			{
+			case TemplateInt:
+				bytesWritten += catf("%" PRIi32, v.i);
+				break;
+			case TemplateUint:
+				bytesWritten += catf("%" PRIu32, v.u);
+				break;
+			case TemplateFloat1:
+				bytesWritten += catf("%.1f", (double)v.f);
+				break;
+			case TemplateFloat2:
+				bytesWritten += catf("%.2f", (double)v.f);
+				break;
+			case TemplateFloat3:
+				bytesWritten += catf("%.3f", (double)v.f);
+				break;
+			case TemplateChar:
+				bytesWritten += cat(v.c);
+				break;
+			}
+			segmentStart = p + 1;
+		}
+	}
+	return bytesWritten;
+}
+
 // Encode a string in JSON format and append it to a string buffer and return the number of bytes written
 size_t OutputBuffer::EncodeString(const char *src, size_t srcLength, bool allowControlChars, bool encapsulateString)
 {
@@ -311,11 +406,11 @@ bool OutputBuffer::WriteToFile(FileData& f) const
 	{
 		if (current->dataLength != 0)
 		{
-			if (!f.Write(current->data, current->dataLength))
+			if (!f.Write(current->Data(), current->dataLength))
 			{
 				return false;
 			}
-			endedInNewline = current->data[current->dataLength - 1] == '\n';
+			endedInNewline = current->Data()[current->dataLength - 1] == '\n';
 		}
 		current = current->Next();
 	} while (current != nullptr);
@@ -337,13 +432,49 @@ bool OutputBuffer::WriteToFile(FileData& f) const
 	}
 }
 
+#if SAM4E || SAM4S || SAME70
+
+// Enlarge the pool from RAM that has never been used. Call this once at startup after all modules have
+// allocated their memory, so that RAM which would otherwise sit idle shortens output buffer starvation.
+/*static*/ void OutputBuffer::GrowPoolFromSpareRam()
+{
+	const size_t maxOutputBuffers = OUTPUT_BUFFER_COUNT * 2;		// don't grow the pool beyond twice its configured size
+	const uint32_t minSpareRam = 8 * 1024;							// how much never-used RAM we leave for future stack and heap growth
+
+	uint32_t neverUsed;
+	reprap.GetPlatform().GetStackUsage(nullptr, nullptr, &neverUsed);
+	while (totalOutputBuffers < maxOutputBuffers && neverUsed >= minSpareRam + sizeof(OutputBuffer))
+	{
+		OutputBuffer * const extraBuffer = new OutputBuffer(nullptr);
+		const irqflags_t flags = cpu_irq_save();
+		extraBuffer->next = freeOutputBuffers;
+		freeOutputBuffers = extraBuffer;
+		++totalOutputBuffers;
+		cpu_irq_restore(flags);
+		reprap.GetPlatform().GetStackUsage(nullptr, nullptr, &neverUsed);
+	}
+}
+
+#endif
+
 // Allocates an output buffer instance which can be used for (large) string outputs
-/*static*/ bool OutputBuffer::Allocate(OutputBuffer *&buf)
+/*static*/ bool OutputBuffer::Allocate(OutputBuffer *&buf, OutputBufferPriority priority)
 {
 	const irqflags_t flags = cpu_irq_save();
 
+	if (priority == OutputBufferPriority::low && usedOutputBuffers + LOW_PRIORITY_SPARE_BUFFERS > totalOutputBuffers)
+	{
+		// The pool is nearly empty, so drop this informational message and leave the remaining buffers for errors and responses
+		++droppedLowPriorityMessages;
+		cpu_irq_restore(flags);
+
+		buf = nullptr;
+		return false;
+	}
+
 	if (freeOutputBuffers == nullptr)
 	{
+		++failedAllocations;
 		reprap.GetPlatform().LogError(ErrorCode::OutputStarvation);
 		cpu_irq_restore(flags);
 
@@ -362,6 +493,7 @@ bool OutputBuffer::WriteToFile(FileData& f) const
 
 	buf->next = nullptr;
 	buf->last = buf;
+	buf->referencedData = nullptr;
 	buf->dataLength = buf->bytesRead = 0;
 	buf->references = 1; // Assume it's only used once by default
 	buf->isReferenced = false;
@@ -373,7 +505,7 @@ bool OutputBuffer::WriteToFile(FileData& f) const
 // Get the number of bytes left for continuous writing
 /*static*/ size_t OutputBuffer::GetBytesLeft(const OutputBuffer *writingBuffer)
 {
-	const size_t freeOutputBuffers = OUTPUT_BUFFER_COUNT - usedOutputBuffers;
+	const size_t freeOutputBuffers = totalOutputBuffers - usedOutputBuffers;
 	if (writingBuffer == nullptr)
 	{
 		// Only return the total number of bytes left
@@ -381,7 +513,7 @@ bool OutputBuffer::WriteToFile(FileData& f) const
 	}
 
 	// We're doing a possibly long response like a filelist
-	const size_t bytesLeft = OUTPUT_BUFFER_SIZE - writingBuffer->last->DataLength();
+	const size_t bytesLeft = writingBuffer->last->SpaceLeft();
 
 	if (freeOutputBuffers < RESERVED_OUTPUT_BUFFERS)
 	{
@@ -464,8 +596,8 @@ bool OutputBuffer::WriteToFile(FileData& f) const
 
 /*static*/ void OutputBuffer::Diagnostics(MessageType mtype)
 {
-	reprap.GetPlatform().MessageF(mtype, "Used output buffers: %d of %d (%d max)\n",
-			usedOutputBuffers, OUTPUT_BUFFER_COUNT, maxUsedOutputBuffers);
+	reprap.GetPlatform().MessageF(mtype, "Used output buffers: %d of %d (%d max, %" PRIu32 " allocation failures, %" PRIu32 " messages dropped), %u bytes total\n",
+			usedOutputBuffers, totalOutputBuffers, maxUsedOutputBuffers, failedAllocations, droppedLowPriorityMessages, totalOutputBuffers * sizeof(OutputBuffer));
 }
 
 //*************************************************************************************************
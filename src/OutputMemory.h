@@ -14,6 +14,16 @@
 
 const size_t OUTPUT_STACK_DEPTH = 4;	// Number of OutputBuffer chains that can be pushed onto one stack instance
 
+// Priority classes for buffer allocation. A flood of informational messages (e.g. a macro looping on M117 or echo)
+// must not be able to exhaust the pool and stall the network stack, so low-priority allocations are refused while
+// the pool is nearly empty and the dropped messages are counted instead. Error and warning messages, and protocol
+// responses, allocate at high priority and only fail when the pool is completely empty.
+enum class OutputBufferPriority : uint8_t
+{
+	low = 0,		// informational message traffic; dropped with a counter under pool pressure
+	high			// errors, warnings and responses; delivered whenever any buffer is free
+};
+
 class OutputStack;
 
 // This class is used to hold data for sending (either for Serial or Network destinations)
@@ -29,9 +39,10 @@ class OutputBuffer
 		bool IsReferenced() const { return isReferenced; }
 		void IncreaseReferences(size_t refs);
 
-		const char *Data() const { return data; }
-		const char *UnreadData() const { return data + bytesRead; }
+		const char *Data() const { return (referencedData != nullptr) ? referencedData : data; }
+		const char *UnreadData() const { return Data() + bytesRead; }
 		size_t DataLength() const { return dataLength; }	// How many bytes have been written to this instance?
+		size_t SpaceLeft() const { return (referencedData != nullptr) ? 0 : OUTPUT_BUFFER_SIZE - dataLength; }	// How many more bytes can be appended to this instance?
 		size_t Length() const;								// How many bytes have been written to the whole chain?
 
 		char& operator[](size_t index);
@@ -53,6 +64,30 @@ class OutputBuffer
 		size_t cat(const char *src, size_t len);
 		size_t cat(StringRef &str);
 
+		size_t catRef(const char *src);						// Append a reference to immutable data (e.g. in flash) without copying it
+		size_t catRef(const char *src, size_t len);
+
+		// JSON template support. A template is a constant string, typically a piece of JSON with constant keys, in
+		// which each value slot is one of the marker characters below. catTemplate copies the literal stretches with
+		// bulk memcpy and renders one entry of values[] into each slot, so the printf machinery only ever sees the
+		// values, not the constant structure around them.
+		static constexpr char TemplateInt = '\x01';			// render the next value as %d
+		static constexpr char TemplateUint = '\x02';		// render the next value as %u
+		static constexpr char TemplateFloat1 = '\x03';		// render the next value as %.1f
+		static constexpr char TemplateFloat2 = '\x04';		// render the next value as %.2f
+		static constexpr char TemplateFloat3 = '\x05';		// render the next value as %.3f
+		static constexpr char TemplateChar = '\x06';		// render the next value as %c
+
+		union TemplateValue
+		{
+			int32_t i;
+			uint32_t u;
+			float f;
+			char c;
+		};
+
+		size_t catTemplate(const char *skeleton, const TemplateValue values[]);
+
 		size_t EncodeString(const char *src, size_t srcLength, bool allowControlChars, bool encapsulateString = true);
 		size_t EncodeReply(OutputBuffer *src, bool allowControlChars);
 
@@ -64,8 +99,14 @@ class OutputBuffer
 		// Initialise the output buffers manager
 		static void Init();
 
+#if SAM4E || SAM4S || SAME70
+		// Enlarge the pool from RAM that has never been used. Call this once at startup after all modules have allocated their memory.
+		static void GrowPoolFromSpareRam();
+#endif
+
 		// Allocate an unused OutputBuffer instance. Returns true on success or false if no instance could be allocated.
-		static bool Allocate(OutputBuffer *&buf);
+		// Low-priority allocations are also refused while fewer than LOW_PRIORITY_SPARE_BUFFERS buffers remain free.
+		static bool Allocate(OutputBuffer *&buf, OutputBufferPriority priority = OutputBufferPriority::high);
 
 		// Get the number of bytes left for allocation. If writingBuffer is not NULL, this returns the number of free bytes for
 		// continuous writes, i.e. for writes that need to allocate an extra OutputBuffer instance to finish the message.
@@ -90,6 +131,7 @@ class OutputBuffer
 		uint32_t whenQueued;
 
 		char data[OUTPUT_BUFFER_SIZE];
+		const char *referencedData;								// if not null, this instance holds a reference to immutable data instead of using 'data'
 		size_t dataLength, bytesRead;
 
 		bool isReferenced;
@@ -98,6 +140,9 @@ class OutputBuffer
 		static OutputBuffer * volatile freeOutputBuffers;		// Messages may also be sent by ISRs,
 		static volatile size_t usedOutputBuffers;				// so make these volatile.
 		static volatile size_t maxUsedOutputBuffers;
+		static volatile uint32_t failedAllocations;				// how many Allocate() calls found the pool empty
+		static volatile uint32_t droppedLowPriorityMessages;	// how many low-priority allocations we refused under pool pressure
+		static size_t totalOutputBuffers;						// how many buffers the pool holds, >= OUTPUT_BUFFER_COUNT if the pool has been grown
 };
 
 inline uint32_t OutputBuffer::GetAge() const
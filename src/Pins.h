@@ -42,4 +42,12 @@
 #define NONLINEAR_EXTRUSION		1		// for now this is always enabled
 #endif
 
+// On machines whose geometry never changes, the virtual call overhead of the kinematics coordinate transforms can be avoided
+// by binding one kinematics class statically in the movement hot path. To use this, define the following three macros in the
+// board configuration file or on the compiler command line, e.g. for a CoreXY machine:
+//   #define FIXED_KINEMATICS			CoreXYKinematics
+//   #define FIXED_KINEMATICS_HEADER	"Movement/Kinematics/CoreXYKinematics.h"
+//   #define FIXED_KINEMATICS_TYPE		KinematicsType::coreXY
+// Other kinematics selected at run time by M665/M667/M669 still work, but only the fixed type gets the devirtualised fast path.
+
 #endif // PINS_H__
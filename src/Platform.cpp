@@ -31,6 +31,9 @@
 #include "Scanner.h"
 #include "SoftTimer.h"
 #include "Logger.h"
+#include "Telemetry.h"
+#include "EventTrace.h"
+#include "Storage/CRC32.h"
 #include "Libraries/Math/Isqrt.h"
 
 #include "sam/drivers/tc/tc.h"
@@ -102,12 +105,20 @@ constexpr uint16_t driverNormalVoltageAdcReading = PowerVoltageToAdcReading(27.5
 
 #endif
 
+#if HAS_STALL_DETECT
+
+constexpr uint32_t MinSgLoadForMonitoring = 100;	// don't monitor for step loss when the learned StallGuard load is below this, the readings are too noisy
+constexpr uint8_t SgLoadAnomalySamplesNeeded = 5;	// how many consecutive low-load samples of a driver we need before reporting loss of sync
+
+#endif
+
 const uint8_t memPattern = 0xA5;
 
 static uint32_t fanInterruptCount = 0;				// accessed only in ISR, so no need to declare it volatile
 const uint32_t fanMaxInterruptCount = 32;			// number of fan interrupts that we average over
 static volatile uint32_t fanLastResetTime = 0;		// time (microseconds) at which we last reset the interrupt count, accessed inside and outside ISR
 static volatile uint32_t fanInterval = 0;			// written by ISR, read outside the ISR
+static volatile bool fanTachoMeasuring = false;		// true while the tacho interrupt is attached and counting edges
 
 const float minStepPulseTiming = 0.2;				// we assume that we always generate step high and low times at least this wide without special action
 
@@ -296,6 +307,8 @@ void ZProbeParameters::Init(float h)
 	probeSpeed = DEFAULT_PROBE_SPEED;
 	travelSpeed = DEFAULT_TRAVEL_SPEED;
 	recoveryTime = extraParam = 0.0;
+	tapTolerance = 0.03;			// when multi-tapping, ignore readings more than this from the median
+	probeTaps = 1;
 	invertReading = false;
 }
 
@@ -306,7 +319,12 @@ float ZProbeParameters::GetStopHeight(float temperature) const
 
 bool ZProbeParameters::WriteParameters(FileStore *f, unsigned int probeType) const
 {
-	scratchString.printf("G31 T%u P%" PRIu32 " X%.1f Y%.1f Z%.2f\n", probeType, adcValue, (double)xOffset, (double)yOffset, (double)height);
+	scratchString.printf("G31 T%u P%" PRIu32 " X%.1f Y%.1f Z%.2f", probeType, adcValue, (double)xOffset, (double)yOffset, (double)height);
+	if (probeTaps > 1)
+	{
+		scratchString.catf(" A%u D%.2f", probeTaps, (double)tapTolerance);
+	}
+	scratchString.cat("\n");
 	return f->Write(scratchString.Pointer());
 }
 
@@ -316,12 +334,13 @@ bool ZProbeParameters::WriteParameters(FileStore *f, unsigned int probeType) con
 uint8_t Platform::softwareResetDebugInfo = 0;			// extra info for debugging
 
 Platform::Platform() :
-		logger(nullptr), board(DEFAULT_BOARD_TYPE), active(false), errorCodeBits(0),
+		logger(nullptr), telemetry(nullptr), board(DEFAULT_BOARD_TYPE), active(false), errorCodeBits(0),
 #if HAS_SMART_DRIVERS
 		nextDriveToPoll(0),
 		onBoardDriversFanRunning(false), offBoardDriversFanRunning(false), onBoardDriversFanStartMillis(0), offBoardDriversFanStartMillis(0),
 #endif
-		lastFanCheckTime(0), auxGCodeReply(nullptr), tickState(0), debugCode(0), lastWarningMillis(0), deliberateError(false)
+		lastFanCheckTime(0), pendingFanChangeMask(0), pendingFanChangeSpeed(0.0),
+		auxGCodeReply(nullptr), tickState(0), debugCode(0), lastWarningMillis(0), deliberateError(false)
 {
 	// Output
 	auxOutput = new OutputStack();
@@ -533,6 +552,9 @@ void Platform::Init()
 	slowDriverStepPulseClocks = 0;								// no extended driver timing configured yet
 	slowDrivers = 0;											// assume no drivers need extended step pulse timing
 
+	endstopsMonitoredByInterrupt = 0;
+	UpdateEndstopInterrupts();									// set up pin change interrupts on the switch-type endstop inputs
+
 	for (size_t extr = 0; extr < MaxExtruders; ++extr)
 	{
 		extruderDrivers[extr] = (uint8_t)(extr + MinAxes);		// set up default extruder drive mapping
@@ -594,6 +616,10 @@ void Platform::Init()
 	stalledDrivers = 0;
 	logOnStallDrivers = pauseOnStallDrivers = rehomeOnStallDrivers = 0;
 	stalledDriversToLog = stalledDriversToPause = stalledDriversToRehome = 0;
+	for (size_t driver = 0; driver < MaxSmartDrivers; ++driver)
+	{
+		sgLoadAnomalyCount[driver] = 0;
+	}
 #endif
 
 #if HAS_VOLTAGE_MONITOR
@@ -631,6 +657,7 @@ void Platform::Init()
 		setPullup(SpiTempSensorCsPins[i], true);
 	}
 
+	heaterPwmTickCount = 0;
 	for (size_t heater = 0; heater < Heaters; heater++)
 	{
 		if (heatOnPins[heater] != NoPin)
@@ -643,6 +670,10 @@ void Platform::Init()
 #endif
 			);
 		}
+		heaterPwmSchedules[heater].periodTicks = 0;
+		heaterPwmSchedules[heater].onTicks = 0;
+		heaterPwmSchedules[heater].phaseTicks = 0;
+		heaterPwmSchedules[heater].pinOn = false;
 		const AnalogChannelNumber chan = PinToAdcChannel(tempSensePins[heater]);	// translate the pin number to the SAM ADC channel number
 		pinMode(tempSensePins[heater], AIN);
 		filteredAdcChannels[heater] = chan;
@@ -1317,21 +1348,24 @@ void Platform::SetNetMask(byte nm[])
 // Flush messages to USB and aux, returning true if there is more to send
 bool Platform::FlushAuxMessages()
 {
-	// Write non-blocking data to the AUX line
+	// Write non-blocking data to the AUX line. Keep draining successive output buffers for as long as the transmit
+	// buffer has room, so that a PanelDue status report spread over several buffers goes out in one call instead of
+	// one buffer per main loop iteration.
 	OutputBuffer *auxOutputBuffer = auxOutput->GetFirstItem();
-	if (auxOutputBuffer != nullptr)
+	while (auxOutputBuffer != nullptr)
 	{
-		size_t bytesToWrite = min<size_t>(SERIAL_AUX_DEVICE.canWrite(), auxOutputBuffer->BytesLeft());
+		const size_t bytesToWrite = min<size_t>(SERIAL_AUX_DEVICE.canWrite(), auxOutputBuffer->BytesLeft());
 		if (bytesToWrite > 0)
 		{
 			SERIAL_AUX_DEVICE.write(auxOutputBuffer->Read(bytesToWrite), bytesToWrite);
 		}
 
-		if (auxOutputBuffer->BytesLeft() == 0)
+		if (auxOutputBuffer->BytesLeft() != 0)
 		{
-			auxOutputBuffer = OutputBuffer::Release(auxOutputBuffer);
-			auxOutput->SetFirstItem(auxOutputBuffer);
+			break;											// the transmit buffer is full, try again next time
 		}
+		auxOutputBuffer = OutputBuffer::Release(auxOutputBuffer);
+		auxOutput->SetFirstItem(auxOutputBuffer);
 	}
 	return auxOutput->GetFirstItem() != nullptr;
 }
@@ -1342,21 +1376,22 @@ bool Platform::FlushMessages()
 	const bool auxHasMore = FlushAuxMessages();
 
 #ifdef SERIAL_AUX2_DEVICE
-	// Write non-blocking data to the second AUX line
+	// Write non-blocking data to the second AUX line, draining as many buffers as the transmit buffer allows
 	OutputBuffer *aux2OutputBuffer = aux2Output->GetFirstItem();
-	if (aux2OutputBuffer != nullptr)
+	while (aux2OutputBuffer != nullptr)
 	{
-		size_t bytesToWrite = min<size_t>(SERIAL_AUX2_DEVICE.canWrite(), aux2OutputBuffer->BytesLeft());
+		const size_t bytesToWrite = min<size_t>(SERIAL_AUX2_DEVICE.canWrite(), aux2OutputBuffer->BytesLeft());
 		if (bytesToWrite > 0)
 		{
 			SERIAL_AUX2_DEVICE.write(aux2OutputBuffer->Read(bytesToWrite), bytesToWrite);
 		}
 
-		if (aux2OutputBuffer->BytesLeft() == 0)
+		if (aux2OutputBuffer->BytesLeft() != 0)
 		{
-			aux2OutputBuffer = OutputBuffer::Release(aux2OutputBuffer);
-			aux2Output->SetFirstItem(aux2OutputBuffer);
+			break;
 		}
+		aux2OutputBuffer = OutputBuffer::Release(aux2OutputBuffer);
+		aux2Output->SetFirstItem(aux2OutputBuffer);
 	}
 #endif
 
@@ -1372,15 +1407,19 @@ bool Platform::FlushMessages()
 		}
 		else
 		{
-			// Write as much data as we can...
-			size_t bytesToWrite = min<size_t>(SERIAL_MAIN_DEVICE.canWrite(), usbOutputBuffer->BytesLeft());
-			if (bytesToWrite > 0)
+			// Write as much data as we can, draining as many buffers as the USB endpoint will accept
+			while (usbOutputBuffer != nullptr)
 			{
-				SERIAL_MAIN_DEVICE.write(usbOutputBuffer->Read(bytesToWrite), bytesToWrite);
-			}
+				const size_t bytesToWrite = min<size_t>(SERIAL_MAIN_DEVICE.canWrite(), usbOutputBuffer->BytesLeft());
+				if (bytesToWrite > 0)
+				{
+					SERIAL_MAIN_DEVICE.write(usbOutputBuffer->Read(bytesToWrite), bytesToWrite);
+				}
 
-			if (usbOutputBuffer->BytesLeft() == 0 || usbOutputBuffer->GetAge() > SERIAL_MAIN_TIMEOUT)
-			{
+				if (usbOutputBuffer->BytesLeft() != 0 && usbOutputBuffer->GetAge() <= SERIAL_MAIN_TIMEOUT)
+				{
+					break;									// the host is not keeping up, try again next time
+				}
 				usbOutputBuffer = OutputBuffer::Release(usbOutputBuffer);
 				usbOutput->SetFirstItem(usbOutputBuffer);
 			}
@@ -1422,6 +1461,21 @@ void Platform::Spin()
 	}
 #endif
 
+#if HAS_VOLTAGE_MONITOR
+	// Track the power input voltage extremes. The tick ISR just stores the latest reading.
+	{
+		const uint16_t vin = currentVin;
+		if (vin > highestVin)
+		{
+			highestVin = vin;
+		}
+		if (vin < lowestVin)
+		{
+			lowestVin = vin;
+		}
+	}
+#endif
+
 	// Diagnostics test
 	if (debugCode == (int)DiagnosticTestType::TestSpinLockup)
 	{
@@ -1445,11 +1499,19 @@ void Platform::Spin()
 		}
 		else
 		{
-			// Check one TMC2660 for temperature warning or temperature shutdown
-			if (enableValues[nextDriveToPoll] >= 0)				// don't poll driver if it is flagged "no poll"
+			// Check the TMC2660 drivers whose reported status has changed since we last looked. The drivers are polled
+			// continually by the DMA chain in the driver module, so here we only need to act on the transitions it has
+			// flagged. Check one driver in rotation as well, to refresh its accumulated status in case a change
+			// notification was missed.
+			const DriversBitmap driversToCheck = SmartDrivers::GetDriversWithStatusChanges() | MakeBitmap<DriversBitmap>(nextDriveToPoll);
+			for (size_t driver = 0; driver < numSmartDrivers; ++driver)
 			{
-				const uint32_t stat = SmartDrivers::GetAccumulatedStatus(nextDriveToPoll, 0);
-				const DriversBitmap mask = MakeBitmap<DriversBitmap>(nextDriveToPoll);
+				const DriversBitmap mask = MakeBitmap<DriversBitmap>(driver);
+				if ((driversToCheck & mask) == 0 || enableValues[driver] < 0)	// don't poll driver if it is flagged "no poll"
+				{
+					continue;
+				}
+				const uint32_t stat = SmartDrivers::GetAccumulatedStatus(driver, 0);
 				if (stat & TMC_RR_OT)
 				{
 					temperatureShutdownDrivers |= mask;
@@ -1508,6 +1570,45 @@ void Platform::Spin()
 				{
 					stalledDrivers &= ~mask;
 				}
+
+				// Step-loss monitoring. Compare the short-term filtered StallGuard load against the load profile that the
+				// driver has learned since movement started. A sustained drop to well below the learned load means the
+				// motor is running out of sync but not badly enough to trip the stall flag, so treat it like a stall.
+				// Check only the driver whose turn it is in the rotation, so that the samples are evenly spaced.
+				if (driver == nextDriveToPoll && ((rehomeOnStallDrivers | pauseOnStallDrivers | logOnStallDrivers) & mask) != 0)
+				{
+					uint32_t fastLoad, slowLoad;
+					if (   SmartDrivers::GetSgLoadFilters(driver, fastLoad, slowLoad)
+						&& slowLoad >= MinSgLoadForMonitoring
+						&& fastLoad < slowLoad/2
+					   )
+					{
+						if (sgLoadAnomalyCount[driver] < SgLoadAnomalySamplesNeeded)
+						{
+							++sgLoadAnomalyCount[driver];
+							if (sgLoadAnomalyCount[driver] == SgLoadAnomalySamplesNeeded && (stalledDrivers & mask) == 0)
+							{
+								// The count now stays at the limit until a healthy sample arrives, so we raise the event just once per episode
+								if ((rehomeOnStallDrivers & mask) != 0)
+								{
+									stalledDriversToRehome |= mask;
+								}
+								else if ((pauseOnStallDrivers & mask) != 0)
+								{
+									stalledDriversToPause |= mask;
+								}
+								else if ((logOnStallDrivers & mask) != 0)
+								{
+									stalledDriversToLog |= mask;
+								}
+							}
+						}
+					}
+					else
+					{
+						sgLoadAnomalyCount[driver] = 0;
+					}
+				}
 #endif
 			}
 
@@ -1555,6 +1656,24 @@ void Platform::Spin()
 		}
 	}
 
+	// Apply any fan speed change attached to the move that is now executing. The step ISR only records
+	// the change, because Fan::Refresh is too heavy to call from interrupt context.
+	if (pendingFanChangeMask != 0)
+	{
+		cpu_irq_disable();
+		const FansBitmap mask = pendingFanChangeMask;
+		const float speed = pendingFanChangeSpeed;
+		pendingFanChangeMask = 0;
+		cpu_irq_enable();
+		for (size_t fan = 0; fan < NUM_FANS; ++fan)
+		{
+			if ((mask & (1u << fan)) != 0)
+			{
+				SetFanValue(fan, speed);
+			}
+		}
+	}
+
 	// Thermostatically-controlled fans (do this after getting TMC driver status)
 	if (now - lastFanCheckTime >= FanCheckInterval)
 	{
@@ -1667,6 +1786,7 @@ void Platform::Spin()
 			{
 				if (reprap.GetGCodes().LowVoltagePause())
 				{
+					EventTrace::Record(EventTrace::EventType::powerFail, 0, (uint16_t)(AdcReadingToPowerVoltage(currentVin) * 10.0));
 					autoSaveState = AutoSaveState::autoPaused;
 				}
 			}
@@ -1688,6 +1808,12 @@ void Platform::Spin()
 	}
 #endif
 
+	// Take a telemetry sample if one is due
+	if (telemetry != nullptr)
+	{
+		telemetry->Spin();
+	}
+
 	// Flush the log file it it is time. This may take some time, so do it last.
 	if (logger != nullptr)
 	{
@@ -1892,6 +2018,7 @@ void Platform::SoftwareReset(uint16_t reason, const uint32_t *stk)
 				srdBuf[slot].stack[i] = stk[i];
 			}
 		}
+		EventTrace::CopyRecent(srdBuf[slot].trace, ARRAY_SIZE(srdBuf[slot].trace));	// save the flight recorder contents too
 
 		// Save diagnostics data to Flash
 #if SAM4E || SAM4S || SAME70
@@ -1924,13 +2051,24 @@ static void FanInterrupt(CallbackParameter)
 	++fanInterruptCount;
 	if (fanInterruptCount == fanMaxInterruptCount)
 	{
-		uint32_t now = micros();
+		const uint32_t now = micros();
 		fanInterval = now - fanLastResetTime;
 		fanLastResetTime = now;
 		fanInterruptCount = 0;
+		detachInterrupt(COOLING_FAN_RPM_PIN);		// one measurement is enough until the RPM is asked for again
+		fanTachoMeasuring = false;
 	}
 }
 
+// Start a new fan RPM measurement, so that we don't take an interrupt on every tacho pulse all the time
+static void StartFanTachoMeasurement(Pin tachoPin)
+{
+	fanInterruptCount = 0;
+	fanLastResetTime = micros();
+	fanTachoMeasuring = true;
+	attachInterrupt(tachoPin, FanInterrupt, FALLING, nullptr);
+}
+
 void Platform::InitialiseInterrupts()
 {
 #if SAM4E || SAM7E
@@ -2017,10 +2155,11 @@ void Platform::InitialiseInterrupts()
 	NVIC_SetPriority(TWI1_IRQn, NvicPriorityTwi);
 #endif
 
-	// Interrupt for 4-pin PWM fan sense line
+	// Interrupt for 4-pin PWM fan sense line. It stays attached only until a measurement completes,
+	// and is re-attached when the RPM is asked for.
 	if (coolingFanRpmPin != NoPin)
 	{
-		attachInterrupt(coolingFanRpmPin, FanInterrupt, FALLING, nullptr);
+		StartFanTachoMeasurement(coolingFanRpmPin);
 	}
 
 	// Tick interrupt for ADC conversions
@@ -2042,6 +2181,100 @@ void Platform::InitialiseInterrupts()
 	active = true;							// this enables the tick interrupt, which keeps the watchdog happy
 }
 
+// Worst observed lateness servicing the step compare interrupt, in step clocks. This bounds how long
+// stepping was ever blocked by higher or equal priority interrupts and interrupt-disabled sections.
+// Updated by STEP_TC_HANDLER, read and reset by Platform::Diagnostics.
+static volatile uint32_t maxStepIsrLateness = 0;
+
+// The NVIC priority each interrupt is meant to run at, mirroring what InitialiseInterrupts and the
+// network modules set up. See the architecture comment next to the NvicPriority constants.
+struct IrqPriorityEntry
+{
+	IRQn_Type irq;
+	uint32_t priority;
+	const char *name;
+};
+
+static const IrqPriorityEntry expectedIrqPriorities[] =
+{
+#if SAM4E || SAME70
+	{ WDT_IRQn, NvicPriorityWatchdog, "watchdog" },
+#endif
+	{ SysTick_IRQn, NvicPrioritySystick, "systick" },
+#if SAM4E || SAM4S || SAME70
+	{ UART0_IRQn, NvicPriorityPanelDueUart, "PanelDue UART" },
+	{ UART1_IRQn, NvicPriorityWiFiUart, "WiFi UART" },
+#else
+	{ UART_IRQn, NvicPriorityPanelDueUart, "PanelDue UART" },
+#endif
+#if HAS_SMART_DRIVERS
+	{ SERIAL_TMC_DRV_IRQn, NvicPriorityDriversSerialTMC, "TMC UART" },
+#endif
+	{ STEP_TC_IRQN, NvicPriorityStep, "step timer" },
+#if HAS_LWIP_NETWORKING
+	{ NETWORK_TC_IRQN, NvicPriorityNetworkTick, "network tick" },
+# if SAME70
+	{ GMAC_IRQn, NvicPriorityEthernet, "Ethernet" },
+# else
+	{ EMAC_IRQn, NvicPriorityEthernet, "Ethernet" },
+# endif
+#endif
+	{ PIOA_IRQn, NvicPriorityPins, "PIOA" },
+	{ PIOB_IRQn, NvicPriorityPins, "PIOB" },
+	{ PIOC_IRQn, NvicPriorityPins, "PIOC" },
+#ifdef ID_PIOD
+	{ PIOD_IRQn, NvicPriorityPins, "PIOD" },
+#endif
+#ifdef ID_PIOE
+	{ PIOE_IRQn, NvicPriorityPins, "PIOE" },
+#endif
+#if SAME70
+	{ USBHS_IRQn, NvicPriorityUSB, "USB" },
+#elif SAM4E || SAM4S
+	{ UDP_IRQn, NvicPriorityUSB, "USB" },
+#elif SAM3XA
+	{ UOTGHS_IRQn, NvicPriorityUSB, "USB" },
+#endif
+#if defined(DUET_WIFI)
+	{ SPI_IRQn, NvicPrioritySpi, "network SPI" },
+#endif
+#if !SAME70
+	{ TWI1_IRQn, NvicPriorityTwi, "TWI" },
+#endif
+};
+
+// Return true if the interrupt is enabled in the NVIC. System exceptions (negative IRQ numbers) are always active.
+static bool IsIrqEnabled(IRQn_Type irq)
+{
+	return (int32_t)irq < 0 || (NVIC->ISER[(uint32_t)irq >> 5] & (1u << ((uint32_t)irq & 31))) != 0;
+}
+
+// Check the live NVIC priorities against the intended table, reporting any that differ and returning how many did.
+// Interrupts that are not enabled yet (e.g. the WiFi SPI before the module has started) are skipped, because their
+// priority is programmed when the owning module starts up.
+unsigned int Platform::AuditInterruptPriorities(MessageType mtype, bool verbose)
+{
+	unsigned int numErrors = 0;
+	for (const IrqPriorityEntry& entry : expectedIrqPriorities)
+	{
+		if (IsIrqEnabled(entry.irq))
+		{
+			const uint32_t actual = NVIC_GetPriority(entry.irq);
+			if (actual != entry.priority)
+			{
+				MessageF(mtype, "Warning: %s interrupt is at NVIC priority %" PRIu32 ", expected %" PRIu32 "\n",
+							entry.name, actual, entry.priority);
+				++numErrors;
+			}
+		}
+	}
+	if (verbose && numErrors == 0)
+	{
+		Message(mtype, "Interrupt priorities: ok\n");
+	}
+	return numErrors;
+}
+
 //*************************************************************************************************
 
 // Debugging variables
@@ -2249,6 +2482,7 @@ void Platform::Diagnostics(MessageType mtype)
 				}
 				MessageF(mtype, "Stack:%s\n", scratchString.Pointer());
 			}
+			EventTrace::PrintSaved(mtype, srdBuf[slot].trace, ARRAY_SIZE(srdBuf[slot].trace));
 		}
 		else
 		{
@@ -2272,6 +2506,35 @@ void Platform::Diagnostics(MessageType mtype)
 	// Show the longest SD card write time
 	MessageF(mtype, "SD card longest block write time: %.1fms\n", (double)FileStore::GetAndClearLongestWriteTime());
 
+	// Show the endstop edge counts for the interrupt-monitored endstops, then reset them
+	scratchString.Clear();
+	for (size_t axis = 0; axis < MaxAxes; ++axis)
+	{
+		if (IsBitSet(endstopsMonitoredByInterrupt, axis))
+		{
+			scratchString.catf(" %c: %" PRIu32 " (%" PRIu32 " rejected)", reprap.GetGCodes().GetAxisLetters()[axis], endstopEdgeCounts[axis], endstopBounceCounts[axis]);
+			endstopEdgeCounts[axis] = endstopBounceCounts[axis] = 0;
+		}
+	}
+	if (!scratchString.IsEmpty())
+	{
+		MessageF(mtype, "Endstop edges since last report:%s\n", scratchString.Pointer());
+	}
+
+	// Show the range of Z probe readings seen while the probe was being consulted, then reset it
+	if (zProbeLowestReading <= zProbeHighestReading)
+	{
+		MessageF(mtype, "Z probe reading range: min %d, max %d\n", zProbeLowestReading, zProbeHighestReading);
+		zProbeLowestReading = 0x7FFFFFFF;
+		zProbeHighestReading = -1;
+	}
+
+	// Show the software timer statistics
+	SoftTimer::Diagnostics(mtype);
+
+	// Show the event trace
+	EventTrace::Diagnostics(mtype);
+
 #if HAS_CPU_TEMP_SENSOR
 	// Show the MCU temperatures
 	const uint32_t currentMcuTemperature = adcFilters[CpuTempFilterIndex].GetSum();
@@ -2333,6 +2596,15 @@ void Platform::Diagnostics(MessageType mtype)
 //		maxRead, maxWrite);
 //longestWriteWaitTime = longestReadWaitTime = 0; shortestReadWaitTime = shortestWriteWaitTime = 1000000;
 
+	// Report and reset the worst-case step interrupt service lateness, and audit the interrupt priorities
+	{
+		const uint32_t lateness = maxStepIsrLateness;
+		maxStepIsrLateness = 0;
+		MessageF(mtype, "Max step interrupt lateness: %" PRIu32 " step clocks (%.1fus)\n",
+					lateness, (double)((float)lateness * (1000000.0/(float)DDA::stepClockRate)));
+	}
+	AuditInterruptPriorities(mtype, true);
+
 	reprap.Timing(mtype);
 
 #ifdef MOVE_DEBUG
@@ -2480,6 +2752,28 @@ bool Platform::DiagnosticTest(GCodeBuffer& gb, StringRef& reply, int d)
 		}
 		break;
 
+	case (int)DiagnosticTestType::PrintMemoryUsage:
+		{
+			const MessageType mtype = gb.GetResponseMessageType();
+			OutputBuffer::Diagnostics(mtype);
+			massStorage->MemoryReport(mtype);
+			reprap.GetGCodes().CodeQueueMemoryReport(mtype);
+		}
+		break;
+
+	case (int)DiagnosticTestType::TestSdCardSpeed:
+		if (reprap.GetPrintMonitor().IsPrinting())
+		{
+			reply.copy("Cannot run the SD card speed test while a file is being printed");
+			return true;
+		}
+		massStorage->SpeedTest(gb.GetResponseMessageType());
+		break;
+
+	case (int)DiagnosticTestType::RunBenchmarks:
+		RunBenchmarks(gb.GetResponseMessageType());
+		break;
+
 	case (int)DiagnosticTestType::TestWatchdog:
 		deliberateError = true;
 		SysTick->CTRL &= ~(SysTick_CTRL_TICKINT_Msk);	// disable the system tick interrupt so that we get a watchdog timeout reset
@@ -2574,6 +2868,145 @@ bool Platform::DiagnosticTest(GCodeBuffer& gb, StringRef& reply, int d)
 	return false;
 }
 
+// Microbenchmark harness, run by M122 P105. Each benchmark returns the number of iterations it ran and the total time
+// taken in step clocks, or false if it could not run or its results failed verification. The results let successive
+// firmware builds be compared automatically instead of by printing test parts. The timings include any interrupts that
+// occur, so run the benchmarks on an idle machine.
+
+typedef bool (*BenchmarkFunction)(uint32_t& iterations, uint32_t& clocksTaken);
+
+// Time the 62-bit integer square root function, which dominates the trapezoidal step time calculation
+static bool BenchmarkIsqrt64(uint32_t& iterations, uint32_t& clocksTaken)
+{
+	iterations = 1000;
+	bool ok = true;
+	const uint32_t startTime = Platform::GetInterruptClocks();
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		const uint32_t num = 0x7265ac3d + i;
+		if (isqrt64((uint64_t)num * num) != num)
+		{
+			ok = false;
+		}
+	}
+	clocksTaken = Platform::GetInterruptClocks() - startTime;
+	return ok;
+}
+
+// Time the step time calculation that the step ISR and the step time precomputation run for every step
+static bool BenchmarkStepTimeCalculation(uint32_t& iterations, uint32_t& clocksTaken)
+{
+	iterations = 1000;
+	clocksTaken = DriveMovement::TimeStepCalculations(iterations);
+	return true;
+}
+
+// Time a round trip through the coordinate transforms of the configured kinematics, starting at the current machine position
+static bool BenchmarkKinematicsTransforms(uint32_t& iterations, uint32_t& clocksTaken)
+{
+	const Kinematics& kin = reprap.GetMove().GetKinematics();
+	const float * const stepsPerMm = reprap.GetPlatform().GetDriveStepsPerUnit();
+	const size_t numVisibleAxes = reprap.GetGCodes().GetVisibleAxes();
+	const size_t numTotalAxes = reprap.GetGCodes().GetTotalAxes();
+
+	float machinePos[MaxAxes];
+	reprap.GetMove().GetCurrentMachinePosition(machinePos, false);
+
+	int32_t motorPos[MaxAxes];
+	iterations = 100;
+	bool ok = true;
+	const uint32_t startTime = Platform::GetInterruptClocks();
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		if (!kin.CartesianToMotorSteps(machinePos, stepsPerMm, numVisibleAxes, numTotalAxes, motorPos, false))
+		{
+			ok = false;
+		}
+		kin.MotorStepsToCartesian(motorPos, stepsPerMm, numVisibleAxes, numTotalAxes, machinePos);
+	}
+	clocksTaken = Platform::GetInterruptClocks() - startTime;
+	return ok;
+}
+
+// Time the CRC32 calculation used when verifying uploaded files, processing 256 bytes per iteration
+static bool BenchmarkCrc32(uint32_t& iterations, uint32_t& clocksTaken)
+{
+	char buffer[256];
+	for (size_t i = 0; i < sizeof(buffer); ++i)
+	{
+		buffer[i] = (char)(i * 253);
+	}
+
+	CRC32 crc;
+	iterations = 256;
+	const uint32_t startTime = Platform::GetInterruptClocks();
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		crc.Update(buffer, sizeof(buffer));
+	}
+	clocksTaken = Platform::GetInterruptClocks() - startTime;
+	return true;
+}
+
+// Time formatting a typical status response into an output buffer
+static bool BenchmarkOutputBufferFormat(uint32_t& iterations, uint32_t& clocksTaken)
+{
+	OutputBuffer *buf;
+	if (!OutputBuffer::Allocate(buf))
+	{
+		return false;
+	}
+
+	iterations = 200;
+	bool ok = true;
+	const uint32_t startTime = Platform::GetInterruptClocks();
+	for (uint32_t i = 0; i < iterations; ++i)
+	{
+		if (buf->printf("T:%.1f B:%.1f X:%.3f Y:%.3f Z:%.3f", (double)(200.0 + (double)i * 0.1), (double)(60.0 + (double)i * 0.01),
+						(double)i * 0.123, (double)i * 0.456, (double)i * 0.005) == 0)
+		{
+			ok = false;
+		}
+	}
+	clocksTaken = Platform::GetInterruptClocks() - startTime;
+	OutputBuffer::ReleaseAll(buf);
+	return ok;
+}
+
+static const struct
+{
+	const char *name;
+	BenchmarkFunction func;
+} benchmarkTable[] =
+{
+	{ "isqrt64",	BenchmarkIsqrt64 },
+	{ "stepcalc",	BenchmarkStepTimeCalculation },
+	{ "transform",	BenchmarkKinematicsTransforms },
+	{ "crc32",		BenchmarkCrc32 },
+	{ "bufformat",	BenchmarkOutputBufferFormat }
+};
+
+// Run the registered microbenchmarks and report one line per benchmark. The output format is fixed so that it can be
+// parsed by the scripts we use to compare firmware builds - don't change it without changing them too.
+void Platform::RunBenchmarks(MessageType mtype)
+{
+	MessageF(mtype, "Benchmarks at %" PRIu32 "Hz step clock, kinematics %s:\n", DDA::stepClockRate, reprap.GetMove().GetKinematics().GetName(true));
+	for (size_t i = 0; i < ARRAY_SIZE(benchmarkTable); ++i)
+	{
+		uint32_t iterations = 0, clocksTaken = 0;
+		if (benchmarkTable[i].func(iterations, clocksTaken))
+		{
+			MessageF(mtype, "benchmark %s iterations %" PRIu32 " clocks %" PRIu32 " us/iter %.3f\n",
+						benchmarkTable[i].name, iterations, clocksTaken,
+						((double)clocksTaken * 1000000.0)/((double)iterations * (double)DDA::stepClockRate));
+		}
+		else
+		{
+			MessageF(mtype, "benchmark %s ERROR\n", benchmarkTable[i].name);
+		}
+	}
+}
+
 extern "C" uint32_t _estack;		// this is defined in the linker script
 
 // Return the stack usage and amount of memory that has never been used, in bytes
@@ -2634,13 +3067,56 @@ void Platform::SetHeater(size_t heater, float power, PwmFrequency freq)
 		{
 			freq = (reprap.GetHeat().IsBedOrChamberHeater(heater)) ? SlowHeaterPwmFreq : NormalHeaterPwmFreq;	// use sefault PWM frequency
 		}
-		const float pwm =
+		if (freq <= MaxStaggeredHeaterPwmFreq)
+		{
+			ScheduleStaggeredHeaterPwm(heater, power, freq);
+		}
+		else
+		{
+			heaterPwmSchedules[heater].periodTicks = 0;			// let hardware PWM drive the pin again
+			const float pwm =
+#if ACTIVE_LOW_HEAT_ON
+				1.0 - power;
+#else
+				power;
+#endif
+			IoPort::WriteAnalog(heatOnPins[heater], pwm, freq);
+		}
+	}
+}
+
+// Hand a slow heater channel over to the tick ISR, which switches it with a per-channel phase offset within the PWM period.
+// Free-running hardware PWM gives the channels no phase relationship, so the bed and chamber duty windows can line up and
+// draw their peak current together, and the resulting supply droop shows up as lost stepper torque. Starting each channel's
+// on-window at a different point in the period flattens the load. This is only worth doing (and at 1ms tick resolution,
+// only possible) for the slow SSR-class frequencies; the hot ends stay on hardware PWM.
+void Platform::ScheduleStaggeredHeaterPwm(size_t heater, float power, PwmFrequency freq)
+{
+	HeaterPwmSchedule& sched = heaterPwmSchedules[heater];
+	const uint16_t period = (uint16_t)max<uint32_t>(1000u/freq, 1u);
+	const uint16_t on = (power >= 1.0) ? period
+						: (power <= 0.0) ? 0
+							: (uint16_t)lrintf(power * (float)period);
+	if (sched.periodTicks != period)
+	{
+		// Starting the schedule, or the frequency has changed. Stop the tick ISR using the old values, claim the pin
+		// back from the PWM hardware, and give this channel its phase offset within the period.
+		sched.periodTicks = 0;
+		IoPort::SetPinMode(heatOnPins[heater],
 #if ACTIVE_LOW_HEAT_ON
-			1.0 - power;
+			OUTPUT_HIGH
 #else
-			power;
+			OUTPUT_LOW
 #endif
-		IoPort::WriteAnalog(heatOnPins[heater], pwm, freq);
+			);
+		sched.pinOn = false;
+		sched.phaseTicks = (uint16_t)((heater * period)/Heaters);
+		sched.onTicks = on;
+		sched.periodTicks = period;
+	}
+	else
+	{
+		sched.onTicks = on;										// period and phase unchanged, just update the duty
 	}
 }
 
@@ -2777,6 +3253,14 @@ uint32_t Platform::GetAllEndstopStates() const
 EndStopHit Platform::GetZProbeResult() const
 {
 	const int zProbeVal = GetZProbeReading();
+	if (zProbeVal < zProbeLowestReading)
+	{
+		zProbeLowestReading = zProbeVal;				// track the reading range seen while probing, for M122
+	}
+	if (zProbeVal > zProbeHighestReading)
+	{
+		zProbeHighestReading = zProbeVal;
+	}
 	const int zProbeADValue = GetCurrentZProbeParameters().adcValue;
 	return (zProbeVal >= zProbeADValue) ? EndStopHit::lowHit
 			: (zProbeVal * 10 >= zProbeADValue * 9) ? EndStopHit::nearStop	// if we are at/above 90% of the target value
@@ -2967,6 +3451,21 @@ void Platform::SetDriversIdle()
 	}
 }
 
+// Restore full current to any drives that are in idle hold. Called when command activity resumes, so
+// that the currents are already restored by the time the first move of the new activity is prepared.
+// Must not be called from an ISR, or with interrupts disabled.
+void Platform::WakeDriversFromIdle()
+{
+	for (size_t driver = 0; driver < DRIVES; ++driver)
+	{
+		if (driverState[driver] == DriverStatus::idle)
+		{
+			driverState[driver] = DriverStatus::enabled;
+			UpdateMotorCurrent(driver);
+		}
+	}
+}
+
 // Set the current for a drive. Current is in mA.
 void Platform::SetDriverCurrent(size_t driver, float currentOrPercent, int code)
 {
@@ -3306,9 +3805,19 @@ void Platform::SetFanValue(size_t fan, float speed)
 	if (fan < NUM_FANS)
 	{
 		fans[fan].SetValue(speed);
+		reprap.RecordStateChange(ChangedField::fanValue, fan, fans[fan].GetValue());	// fan speeds are omitted from differential status responses
 	}
 }
 
+// Record a fan speed change carried by the move that has just started. Called from the step interrupt,
+// so just note the change here; Spin() applies it. If a second change arrives before the first has been
+// applied, the later one wins, which is the correct final state.
+void Platform::ScheduleFanChange(FansBitmap whichFans, float speed)
+{
+	pendingFanChangeSpeed = speed;
+	pendingFanChangeMask = whichFans;				// written last; Spin reads and clears it with interrupts disabled
+}
+
 #if defined(DUET_06_085)
 
 // Enable or disable the fan that shares its PWM pin with the last heater. Called when we disable or enable the last heater.
@@ -3324,12 +3833,20 @@ void Platform::EnableSharedFan(bool enable)
 // Get current fan RPM
 float Platform::GetFanRPM() const
 {
-	// The ISR sets fanInterval to the number of microseconds it took to get fanMaxInterruptCount interrupts.
+	// The ISR sets fanInterval to the number of microseconds it took to get fanMaxInterruptCount interrupts,
+	// then detaches itself so that an idle machine doesn't take an interrupt on every tacho pulse.
+	// Return the result of the last measurement and start a new one if none is in progress.
 	// We get 2 tacho pulses per revolution, hence 2 interrupts per revolution.
 	// However, if the fan stops then we get no interrupts and fanInterval stops getting updated.
 	// We must recognise this and return zero.
-	return (fanInterval != 0 && micros() - fanLastResetTime < 3000000U)		// if we have a reading and it is less than 3 second old
-			? (float)((30000000U * fanMaxInterruptCount)/fanInterval)		// then calculate RPM assuming 2 interrupts per rev
+	const uint32_t interval = fanInterval;
+	const uint32_t lastResetTime = fanLastResetTime;
+	if (!fanTachoMeasuring && coolingFanRpmPin != NoPin)
+	{
+		StartFanTachoMeasurement(coolingFanRpmPin);
+	}
+	return (interval != 0 && micros() - lastResetTime < 3000000U)			// if we have a reading and it is less than 3 second old
+			? (float)((30000000U * fanMaxInterruptCount)/interval)			// then calculate RPM assuming 2 interrupts per rev
 			: 0.0;															// else assume fan is off or tacho not connected
 }
 
@@ -3397,6 +3914,61 @@ void Platform::SetEndStopConfiguration(size_t axis, EndStopPosition esPos, EndSt
 {
 	endStopPos[axis] = esPos;
 	endStopInputType[axis] = inputType;
+	UpdateEndstopInterrupts();
+}
+
+volatile uint32_t Platform::endstopsTriggeredLatch = 0;
+volatile uint32_t Platform::endstopEdgeCounts[MaxAxes] = { 0 };
+volatile uint32_t Platform::endstopBounceCounts[MaxAxes] = { 0 };
+volatile int Platform::zProbeLowestReading = 0x7FFFFFFF;
+volatile int Platform::zProbeHighestReading = -1;
+
+// Attach or detach the endstop pin change interrupts to match the endstop configuration.
+// Only plain switch inputs can be monitored this way; the Z probe and stall detection are still polled by the step ISR.
+void Platform::UpdateEndstopInterrupts()
+{
+	for (size_t axis = 0; axis < MaxAxes; ++axis)
+	{
+		const Pin pin = endStopPins[axis];
+		const bool monitorable = pin != NoPin
+								&& (endStopInputType[axis] == EndStopInputType::activeLow || endStopInputType[axis] == EndStopInputType::activeHigh);
+		if (monitorable && !IsBitSet(endstopsMonitoredByInterrupt, axis))
+		{
+			attachInterrupt(pin, EndstopInterrupt, CHANGE, reinterpret_cast<void*>(axis));
+			SetBit(endstopsMonitoredByInterrupt, axis);
+		}
+		else if (!monitorable && IsBitSet(endstopsMonitoredByInterrupt, axis))
+		{
+			detachInterrupt(pin);
+			ClearBit(endstopsMonitoredByInterrupt, axis);
+		}
+	}
+}
+
+// Pin change interrupt handler for endstop inputs. Just latch the transition; the step ISR does the definitive level read.
+/*static*/ void Platform::EndstopInterrupt(CallbackParameter param)
+{
+	const uint32_t axis = reinterpret_cast<uint32_t>(param.vp);
+	SetBit(endstopsTriggeredLatch, axis);
+	++endstopEdgeCounts[axis];
+}
+
+// Classify the latched endstop edges that the step ISR has just consumed. A latched edge whose definitive level read
+// does not confirm a trigger was a bounce or a noise spike, so count it as rejected. Called from the step ISR.
+void Platform::AccumulateEndstopStatistics(uint32_t latchedEndstops)
+{
+	for (size_t axis = 0; axis < MaxAxes; ++axis)
+	{
+		if (IsBitSet(latchedEndstops, axis) && endStopPins[axis] != NoPin)
+		{
+			const bool level = IoPort::ReadPin(endStopPins[axis]);
+			const bool triggered = (endStopInputType[axis] == EndStopInputType::activeHigh) ? level : !level;
+			if (!triggered)
+			{
+				++endstopBounceCounts[axis];
+			}
+		}
+	}
 }
 
 void Platform::GetEndStopConfiguration(size_t axis, EndStopPosition& esType, EndStopInputType& inputType) const
@@ -3441,9 +4013,9 @@ void Platform::AppendAuxReply(OutputBuffer *reply)
 	{
 		OutputBuffer::ReleaseAll(reply);
 	}
-	else if ((*reply)[0] == '{')
+	else if ((*reply)[0] == '{' || (uint8_t)(*reply)[0] == BinaryStatusFrameSync)
 	{
-		// JSON responses are always sent directly to the AUX device
+		// JSON responses and binary status frames are always sent directly to the AUX device
 		// For big responses it makes sense to write big chunks of data in portions. Store this data here
 		auxOutput->Push(reply);
 	}
@@ -3471,6 +4043,58 @@ void Platform::RawMessage(MessageType type, const char *message)
 		logger->LogMessage(realTime, message);
 	}
 
+	// Errors and warnings are always delivered while any buffer is free; plain informational messages are
+	// dropped (and counted) when the pool is nearly empty, so that a runaway macro flooding M117 or echo
+	// messages cannot starve the network stack of buffers and take the machine off line.
+	const OutputBufferPriority priority = ((type & (ErrorMessageFlag | WarningMessageFlag)) != 0)
+											? OutputBufferPriority::high : OutputBufferPriority::low;
+
+	// If the message is going to more than one buffered destination, render it once into an output buffer
+	// and let the OutputBuffer overload of Message share that buffer between them by reference, instead of
+	// copying the text into each destination's own buffer. A GenericMessage reply goes to four destinations,
+	// so this makes the fan-out cost independent of how many channels are connected. The blocking and
+	// immediate destinations keep the direct path because the OutputBuffer overload doesn't implement them.
+	unsigned int bufferedDestinations = 0;
+	if ((type & (LcdMessage | ImmediateLcdMessage)) == LcdMessage)
+	{
+		bufferedDestinations |= LcdMessage;
+	}
+	if ((type & HttpMessage) != 0)
+	{
+		bufferedDestinations |= HttpMessage;
+	}
+	if ((type & TelnetMessage) != 0)
+	{
+		bufferedDestinations |= TelnetMessage;
+	}
+	if ((type & (UsbMessage | BlockingUsbMessage)) == UsbMessage)
+	{
+		bufferedDestinations |= UsbMessage;
+	}
+#ifdef SERIAL_AUX2_DEVICE
+	if ((type & AuxMessage) != 0)
+	{
+		bufferedDestinations |= AuxMessage;
+	}
+#endif
+	if ((bufferedDestinations & (bufferedDestinations - 1)) != 0)		// if more than one bit set
+	{
+		OutputBuffer *sharedReply;
+		if (OutputBuffer::Allocate(sharedReply, priority))
+		{
+			sharedReply->cat(message);
+			Message((MessageType)bufferedDestinations, sharedReply);
+			type = (MessageType)(type & ~bufferedDestinations);
+		}
+		else if (priority == OutputBufferPriority::low)
+		{
+			// The message was dropped under pool pressure. Don't fall through to the per-destination copies,
+			// because they would allocate the very buffers we are trying to preserve.
+			type = (MessageType)(type & ~bufferedDestinations);
+		}
+		// If a high-priority allocation failed then fall through and copy the text into each destination as before
+	}
+
 	// Send the message to the destinations
 	if ((type & ImmediateLcdMessage) != 0)
 	{
@@ -3533,9 +4157,9 @@ void Platform::RawMessage(MessageType type, const char *message)
 			OutputBuffer *usbOutputBuffer = usbOutput->GetLastItem();
 			if (usbOutputBuffer == nullptr || usbOutputBuffer->IsReferenced())
 			{
-				if (!OutputBuffer::Allocate(usbOutputBuffer))
+				if (!OutputBuffer::Allocate(usbOutputBuffer, priority))
 				{
-					// Should never happen
+					// Either the pool is empty or this message was dropped under pool pressure
 					return;
 				}
 				usbOutput->Push(usbOutputBuffer);
@@ -3754,6 +4378,59 @@ bool Platform::ConfigureLogging(GCodeBuffer& gb, StringRef& reply)
 	return false;
 }
 
+// Configure telemetry sampling according to the M930 command received, returning true if error
+bool Platform::ConfigureTelemetry(GCodeBuffer& gb, StringRef& reply)
+{
+	if (gb.Seen('S'))
+	{
+		const int interval = gb.GetIValue();
+		if (interval <= 0)
+		{
+			if (telemetry != nullptr)
+			{
+				telemetry->Stop();
+			}
+		}
+		else
+		{
+			if (telemetry == nullptr)
+			{
+				telemetry = new Telemetry();
+			}
+			AxesBitmap axes = (gb.Seen('A')) ? gb.GetUIValue() : 0;
+			const uint32_t heaters = (gb.Seen('H')) ? gb.GetUIValue() : 0;
+			const bool fanRpm = gb.Seen('F') && gb.GetIValue() > 0;
+			if (axes == 0 && heaters == 0 && !fanRpm)
+			{
+				axes = LowestNBits<AxesBitmap>(MinAxes);			// default to recording the XYZ coordinates
+			}
+			telemetry->Start((uint32_t)interval, axes, heaters, fanRpm);
+		}
+	}
+	else if (telemetry != nullptr)
+	{
+		telemetry->AppendStatus(reply);
+	}
+	else
+	{
+		reply.copy("Telemetry sampling is stopped");
+	}
+	return false;
+}
+
+// Append the buffered telemetry samples to an output buffer as CSV, consuming them
+void Platform::ReportTelemetry(OutputBuffer *buf, unsigned int decimation)
+{
+	if (telemetry != nullptr)
+	{
+		telemetry->Report(buf, decimation);
+	}
+	else
+	{
+		buf->copy("No telemetry data\n");
+	}
+}
+
 // This is called from EmergencyStop. It closes the log file and stops logging.
 void Platform::StopLogging()
 {
@@ -3772,6 +4449,7 @@ void Platform::AtxPowerOn()
 {
 	deferredPowerDown = false;
 	IoPort::WriteDigital(ATX_POWER_PIN, true);
+	reprap.StatusChanged();
 }
 
 void Platform::AtxPowerOff(bool defer)
@@ -3786,7 +4464,9 @@ void Platform::AtxPowerOff(bool defer)
 			logger->Flush(true);
 			// We don't call logger->Stop() here because we don't now whether turning off the power will work
 		}
+		massStorage->SyncAll();						// make sure any deferred FAT updates reach the card before the power goes
 		IoPort::WriteDigital(ATX_POWER_PIN, false);
+		reprap.StatusChanged();
 	}
 }
 
@@ -4446,6 +5126,14 @@ void STEP_TC_HANDLER()
 	if ((tcsr & TC_SR_CPAS) != 0)									// the step interrupt uses RA compare
 	{
 		STEP_TC->TC_CHANNEL[STEP_TC_CHAN].TC_IDR = TC_IER_CPAS;		// disable the interrupt
+
+		// Record how late we are servicing the compare. A premature call (see ScheduleStepInterrupt)
+		// has the reprogrammed RA still in the future and gives a negative value, which we ignore.
+		const int32_t lateness = (int32_t)(Platform::GetInterruptClocks() - STEP_TC->TC_CHANNEL[STEP_TC_CHAN].TC_RA);
+		if (lateness > 0 && (uint32_t)lateness > maxStepIsrLateness)
+		{
+			maxStepIsrLateness = (uint32_t)lateness;
+		}
 #ifdef MOVE_DEBUG
 		++numInterruptsExecuted;
 		lastInterruptTime = Platform::GetInterruptClocks();
@@ -4545,16 +5233,9 @@ void Platform::Tick()
 	if (tickState != 0)
 	{
 #if HAS_VOLTAGE_MONITOR
-		// Read the power input voltage
+		// Read the power input voltage. The min/max tracking is done in Spin() to keep this ISR as short as possible;
+		// only the over voltage cutoff needs to act on the reading immediately.
 		currentVin = AnalogInReadChannel(vInMonitorAdcChannel);
-		if (currentVin > highestVin)
-		{
-			highestVin = currentVin;
-		}
-		if (currentVin < lowestVin)
-		{
-			lowestVin = currentVin;
-		}
 
 # if HAS_SMART_DRIVERS
 		if (driversPowered && currentVin > driverOverVoltageAdcReading)
@@ -4625,6 +5306,28 @@ void Platform::Tick()
 		break;
 	}
 
+	// Switch the software-scheduled slow heater channels at their staggered phases. Integer arithmetic only - see above.
+	++heaterPwmTickCount;
+	for (size_t heater = 0; heater < Heaters; heater++)
+	{
+		HeaterPwmSchedule& sched = heaterPwmSchedules[heater];
+		const uint16_t period = sched.periodTicks;
+		if (period != 0)
+		{
+			const uint16_t pos = (uint16_t)((heaterPwmTickCount + sched.phaseTicks) % period);
+			const bool on = (pos < sched.onTicks);
+			if (on != sched.pinOn)
+			{
+				sched.pinOn = on;
+#if ACTIVE_LOW_HEAT_ON
+				digitalWrite(heatOnPins[heater], (on) ? LOW : HIGH);
+#else
+				digitalWrite(heatOnPins[heater], (on) ? HIGH : LOW);
+#endif
+			}
+		}
+	}
+
 	AnalogInStartConversion();
 }
 
@@ -186,6 +186,9 @@ enum class DiagnosticTestType : int
 	PrintExpanderStatus = 101,		// print DueXn expander status
 #endif
 	TimeSquareRoot = 102,			// do a timing test on the square root function
+	PrintMemoryUsage = 103,			// print the sizes and high-water marks of the main RAM pools
+	TestSdCardSpeed = 104,			// run a read/write benchmark on the SD card
+	RunBenchmarks = 105,			// run the built-in microbenchmarks and report the timings
 
 	TestWatchdog = 1001,			// test that we get a watchdog reset if the tick interrupt stops
 	TestSpinLockup = 1002,			// test that we get a software reset if a Spin() function takes too long
@@ -211,6 +214,8 @@ struct ZProbeParameters
 	float travelSpeed;				// the speed at which we travel to the probe point
 	float recoveryTime;				// Z probe recovery time
 	float extraParam;				// extra parameters used by some types of probe e.g. Delta probe
+	float tapTolerance;				// readings further than this from the median are rejected when we take multiple taps
+	uint8_t probeTaps;				// how many readings we take per point, 1 = single reading as before
 	bool invertReading;				// true if we need to invert the reading
 
 	void Init(float h);
@@ -315,6 +320,7 @@ public:
 	Compatibility Emulating() const;
 	void SetEmulating(Compatibility c);
 	void Diagnostics(MessageType mtype);
+	unsigned int AuditInterruptPriorities(MessageType mtype, bool verbose);	// Check the live NVIC priorities against the intended table
 	bool DiagnosticTest(GCodeBuffer& gb, StringRef& reply, int d);
 	void ClassReport(uint32_t &lastTime);  			// Called on Spin() return to check everything's live.
 	void LogError(ErrorCode e) { errorCodeBits |= (uint32_t)e; }
@@ -373,6 +379,7 @@ public:
 
 	MassStorage* GetMassStorage() const;
 	FileStore* OpenFile(const char* directory, const char* fileName, OpenMode mode) { return massStorage->OpenFile(directory, fileName, mode); }
+	FileStore* OpenMacroFile(const char* directory, const char* fileName) { return massStorage->OpenMacroFile(directory, fileName); }
 
 	const char* GetWebDir() const; 					// Where the html etc files are
 	const char* GetGCodeDir() const; 				// Where the gcodes are
@@ -406,6 +413,7 @@ public:
 	void DisableDrive(size_t drive);
 	void DisableAllDrives();
 	void SetDriversIdle();
+	void WakeDriversFromIdle();
 	void SetMotorCurrent(size_t drive, float current, int code);
 	float GetMotorCurrent(size_t drive, int code) const;
 	void SetIdleCurrentFactor(float f);
@@ -454,6 +462,21 @@ public:
 	pre(axis < MaxAxes);
 
 	uint32_t GetAllEndstopStates() const;
+	void UpdateEndstopInterrupts();							// attach or detach endstop pin change interrupts to match the configuration
+	uint32_t GetInterruptMonitoredEndstops() const			// get the bitmap of axes whose endstop pins are edge-monitored
+		{ return endstopsMonitoredByInterrupt; }
+	void PrimeEndstopLatch(uint32_t endstops)				// force the next check of these endstops to read the inputs
+		{ endstopsTriggeredLatch |= endstops; }
+	uint32_t ReadAndClearEndstopLatch()						// return and clear the latched endstop transitions. Called from the step ISR,
+	{														// which runs at higher priority than the pin change interrupts, so no race.
+		const uint32_t rslt = endstopsTriggeredLatch;
+		endstopsTriggeredLatch &= ~rslt;
+		if (rslt != 0)
+		{
+			AccumulateEndstopStatistics(rslt);				// keep the diagnostic edge/bounce counters up to date
+		}
+		return rslt;
+	}
 	void SetAxisDriversConfig(size_t drive, const AxisDriversConfig& config);
 	const AxisDriversConfig& GetAxisDriversConfig(size_t drive) const
 		{ return axisDrivers[drive]; }
@@ -515,6 +538,7 @@ public:
 
 	float GetFanValue(size_t fan) const;					// Result is returned in percent
 	void SetFanValue(size_t fan, float speed);				// Accepts values between 0..1 and 1..255
+	void ScheduleFanChange(FansBitmap whichFans, float speed);	// Called from the step ISR when a move carrying a fan speed change starts
 #if defined(DUET_06_085)
 	void EnableSharedFan(bool enable);						// enable/disable the fan that shares its PWM pin with the last heater
 #endif
@@ -556,6 +580,7 @@ public:
 	void DisableAutoSave();
 	void EnableAutoSave(float saveVoltage, float resumeVoltage);
 	bool GetAutoSaveSettings(float& saveVoltage, float&resumeVoltage);
+	bool IsAutoSaveEnabled() const { return autoSaveEnabled; }
 #endif
 
 #if HAS_SMART_DRIVERS
@@ -575,6 +600,8 @@ public:
 
 	// Logging support
 	bool ConfigureLogging(GCodeBuffer& gb, StringRef& reply);
+	bool ConfigureTelemetry(GCodeBuffer& gb, StringRef& reply);
+	void ReportTelemetry(OutputBuffer *buf, unsigned int decimation);
 
 	// Ancilliary PWM
 	void SetExtrusionAncilliaryPwmValue(float v);
@@ -611,6 +638,7 @@ private:
 
 	void ResetChannel(size_t chan);					// re-initialise a serial channel
 	float AdcReadingToCpuTemperature(uint32_t reading) const;
+	void RunBenchmarks(MessageType mtype);			// run the built-in microbenchmarks and report the timings
 
 #if HAS_SMART_DRIVERS
 	void ReportDrivers(DriversBitmap whichDrivers, const char* text, bool& reported);
@@ -635,12 +663,12 @@ private:
 	// directly from/to flash memory.
 	struct SoftwareResetData
 	{
-		static const uint16_t versionValue = 8;		// increment this whenever this struct changes
+		static const uint16_t versionValue = 9;		// increment this whenever this struct changes
 		static const uint16_t magicValue = 0x7D00 | versionValue;	// value we use to recognise that all the flash data has been written
 #if SAM3XA
 		static const uint32_t nvAddress = 0;		// must be 4-byte aligned
 #endif
-		static const size_t numberOfSlots = 4;		// number of storage slots used to implement wear levelling - must fit in 512 bytes
+		static const size_t numberOfSlots = 2;		// number of storage slots used to implement wear levelling - must fit in 512 bytes
 
 		uint16_t magic;								// the magic number, including the version
 		uint16_t resetReason;						// this records why we did a software reset, for diagnostic purposes
@@ -652,6 +680,7 @@ private:
 		uint32_t sp;								// stack pointer
 		time_t when;								// value of the RTC when the software reset occurred
 		uint32_t stack[24];							// stack when the exception occurred, with the program counter at the bottom
+		uint32_t trace[32];							// the most recent entries of the event trace, saved by EventTrace::CopyRecent
 
 		bool isVacant() const						// return true if this struct can be written without erasing it first
 		{
@@ -677,6 +706,9 @@ private:
 	// Logging
 	Logger *logger;
 
+	// Telemetry sampling
+	Telemetry *telemetry;
+
 	// Z probes
 	ZProbeParameters switchZProbeParameters;		// Z probe values for the switch Z-probe
 	ZProbeParameters irZProbeParameters;			// Z probe values for the IR sensor
@@ -716,6 +748,17 @@ private:
 	bool directions[DRIVES];
 	int8_t enableValues[DRIVES];
 	Pin endStopPins[DRIVES];
+	uint32_t endstopsMonitoredByInterrupt;				// bitmap of axes whose endstop pins have a change interrupt attached
+	static volatile uint32_t endstopsTriggeredLatch;	// bitmap of axes whose endstop pins have changed state since the latch was last cleared
+	static void EndstopInterrupt(CallbackParameter param);	// pin change interrupt handler for endstop inputs
+
+	// Endstop and Z probe statistics, reported and reset under M122 so that intermittent homing failures
+	// can be diagnosed from the counters instead of by swapping parts
+	static volatile uint32_t endstopEdgeCounts[MaxAxes];	// how many pin change interrupts each monitored endstop input has generated
+	static volatile uint32_t endstopBounceCounts[MaxAxes];	// how many latched edges were rejected because the level read did not confirm a trigger
+	static volatile int zProbeLowestReading;			// the lowest Z probe reading seen while it was being consulted as a probe or endstop
+	static volatile int zProbeHighestReading;			// the highest such reading
+	void AccumulateEndstopStatistics(uint32_t latchedEndstops);	// classify latched endstop edges for the diagnostic counters
 	float maxFeedrates[DRIVES];
 	float accelerations[DRIVES];
 	float maxPrintingAcceleration;
@@ -752,6 +795,7 @@ private:
 #if HAS_STALL_DETECT
 	DriversBitmap logOnStallDrivers, pauseOnStallDrivers, rehomeOnStallDrivers;
 	DriversBitmap stalledDrivers, stalledDriversToLog, stalledDriversToPause, stalledDriversToRehome;
+	uint8_t sgLoadAnomalyCount[MaxSmartDrivers];		// how many consecutive low StallGuard load samples we have seen from each driver
 #endif
 
 #if defined(DUET_06_085)
@@ -803,10 +847,25 @@ private:
 	uint32_t configuredHeaters;										// bitmask of all real heaters in use
 	uint32_t heatSampleTicks;
 
+	// Phase scheduler for slow heater PWM. Channels at SSR-class frequencies are switched from the tick ISR with
+	// a per-channel phase offset within the PWM period, so that their duty windows do not all start together.
+	struct HeaterPwmSchedule
+	{
+		volatile uint16_t periodTicks;								// PWM period in 1ms ticks, 0 if this heater uses hardware PWM
+		volatile uint16_t onTicks;									// number of ticks per period for which the heater is on
+		uint16_t phaseTicks;										// tick within the period at which this channel's on-window starts
+		bool pinOn;													// whether the pin is currently driven to the 'on' level, maintained by the tick ISR
+	};
+	HeaterPwmSchedule heaterPwmSchedules[Heaters];
+	uint32_t heaterPwmTickCount;									// free-running tick counter shared by all scheduled channels
+	void ScheduleStaggeredHeaterPwm(size_t heater, float power, PwmFrequency freq);
+
 	// Fans
 	Fan fans[NUM_FANS];
 	Pin coolingFanRpmPin;											// we currently support only one fan RPM input
 	uint32_t lastFanCheckTime;
+	volatile FansBitmap pendingFanChangeMask;						// fans with a move-attached speed change awaiting application, written from the step ISR
+	volatile float pendingFanChangeSpeed;							// the speed to apply to them
 	void InitFans();
 	bool FansHardwareInverted(size_t fanNumber) const;
 
@@ -1239,6 +1298,12 @@ inline OutputBuffer *Platform::GetAuxGCodeReply()
 // Set the specified step pins high and all other step pins low
 // This needs to be as fast as possible, so we do a parallel write to the port(s).
 // We rely on only those port bits that are step pins being set in the PIO_OWSR register of each port
+//
+// Note on DMA-driven step generation: it has been suggested that we could stage upcoming step edges in a buffer and have a
+// timer-paced DMA stream write them to PIO_ODSR without CPU involvement. On the SAM4E this is not possible: neither the PDC
+// nor the central DMAC has a hardware handshake from a TC compare event, so a DMA transfer to the PIO could not be paced by
+// step times, only free-run. Until we move to a processor that can trigger DMA from a timer, the ways to raise the maximum
+// step rate are the interrupt coalescing window (M576) and the double/quad/octal stepping done by the DriveMovement code.
 /*static*/ inline void Platform::StepDriversHigh(uint32_t driverMap)
 {
 #if defined(__SAME70Q21__)
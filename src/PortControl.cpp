@@ -22,6 +22,12 @@ void PortControl::Init()
 	advanceMillis = 0;
 	advanceClocks = 0;
 	currentPortState = 0;
+	numPortGroups = 0;
+	invertedPorts = 0;
+	slowPorts = 0;
+	pendingSlowPortState = 0;
+	slowPortWritePending = false;
+	PreparePortWrite(0, allPortsOff);
 }
 
 void PortControl::Exit()
@@ -34,33 +40,28 @@ void PortControl::Spin(bool full)
 {
 	if (numConfiguredPorts != 0)
 	{
+		// Port changes during moves are applied by the step ISR at precomputed points in each move, so all that
+		// is left to do here is to turn the ports off when movement has stopped. Interrupts must be disabled for
+		// the check, otherwise a move could start between the check and the write and have its port state undone.
 		cpu_irq_disable();
-		const DDA * cdda = reprap.GetMove().GetCurrentDDA();
-		if (cdda == nullptr)
+		if (reprap.GetMove().GetCurrentDDA() == nullptr && currentPortState != 0)
 		{
-			// Movement has stopped, so turn all ports off
-			cpu_irq_enable();
-			UpdatePorts(0);
+			ApplyPortWrite(allPortsOff, 0);
 		}
-		else
+		cpu_irq_enable();
+
+		// Write any ports that cannot be written from the step ISR (e.g. expansion board pins)
+		if (slowPortWritePending)
 		{
-			const uint32_t now = Platform::GetInterruptClocks() + advanceClocks;
-			uint32_t moveEndTime = cdda->GetMoveStartTime();
-			DDA::DDAState st = cdda->GetState();
-			do
+			slowPortWritePending = false;
+			const IoBits_t bits = pendingSlowPortState;
+			for (size_t i = 0; i < numConfiguredPorts; ++i)
 			{
-				moveEndTime += cdda->GetClocksNeeded();
-				if ((int32_t)(moveEndTime - now) >= 0)
+				if ((slowPorts & (1u << i)) != 0)
 				{
-					break;
+					portMap[i].WriteDigital((bits & (1u << i)) != 0);
 				}
-				cdda = cdda->GetNext();
-				st = cdda->GetState();
-			} while (st == DDA::executing || st == DDA::frozen);
-			cpu_irq_enable();
-
-			const IoBits_t bits = (st == DDA::executing || st == DDA::frozen || st == DDA::provisional) ? cdda->GetIoBits() : 0;
-			UpdatePorts(bits);
+			}
 		}
 	}
 }
@@ -73,6 +74,9 @@ bool PortControl::Configure(GCodeBuffer& gb, StringRef& reply)
 		seen = true;
 		UpdatePorts(0);
 		numConfiguredPorts = 0;
+		numPortGroups = 0;
+		invertedPorts = 0;
+		slowPorts = 0;
 		uint32_t portNumbers[MaxPorts];
 		size_t numPorts = MaxPorts;
 		gb.GetUnsignedArray(portNumbers, numPorts);
@@ -91,11 +95,42 @@ bool PortControl::Configure(GCodeBuffer& gb, StringRef& reply)
 				return true;
 			}
 			pm.WriteDigital(false);				// ensure the port is off
+
+			// Build the port write descriptor so that UpdatePorts can use fast parallel writes on this pin
+			Pio *pioBase;
+			uint32_t pioMask;
+			bool inverted;
+			if (pm.GetPortWriteDescriptor(pioBase, pioMask, inverted))
+			{
+				size_t group = 0;
+				while (group < numPortGroups && groupPioBases[group] != pioBase)
+				{
+					++group;
+				}
+				if (group == numPortGroups)
+				{
+					groupPioBases[group] = pioBase;
+					++numPortGroups;
+				}
+				portPioMasks[i] = pioMask;
+				portGroupIndices[i] = (uint8_t)group;
+				if (inverted)
+				{
+					invertedPorts |= (IoBits_t)(1u << i);
+				}
+			}
+			else
+			{
+				portPioMasks[i] = 0;			// e.g. an expansion board pin, which we must write through WriteDigital
+				slowPorts |= (IoBits_t)(1u << i);
+			}
+
 			if (i >= numConfiguredPorts)
 			{
 				numConfiguredPorts = i + 1;
 			}
 		}
+		PreparePortWrite(0, allPortsOff);
 	}
 	if (gb.Seen('T'))
 	{
@@ -122,22 +157,99 @@ bool PortControl::Configure(GCodeBuffer& gb, StringRef& reply)
 	return false;
 }
 
+// Build the parallel write that drives the fast ports to the given state. This is called by DDA::Prepare while the
+// move is still being prepared, so that the step ISR has nothing left to compute when the switch point is reached.
+void PortControl::PreparePortWrite(IoBits_t bits, PortWriteDescriptor& descriptor) const
+{
+	for (size_t group = 0; group < MaxPortGroups; ++group)
+	{
+		descriptor.bitsToSet[group] = 0;
+		descriptor.bitsToClear[group] = 0;
+	}
+	const IoBits_t highPorts = bits ^ invertedPorts;	// the ports whose output pins need to be high
+	for (size_t i = 0; i < numConfiguredPorts; ++i)
+	{
+		if (portPioMasks[i] != 0)
+		{
+			if (highPorts & (IoBits_t)(1u << i))
+			{
+				descriptor.bitsToSet[portGroupIndices[i]] |= portPioMasks[i];
+			}
+			else
+			{
+				descriptor.bitsToClear[portGroupIndices[i]] |= portPioMasks[i];
+			}
+		}
+	}
+}
+
+// Apply a precomputed port write. This is called from the step ISR, so it must be fast: the fast ports are changed
+// with a single store per PIO controller, and any ports that cannot be written from an ISR are handed to Spin.
+void PortControl::ApplyPortWrite(const PortWriteDescriptor& descriptor, IoBits_t bits)
+{
+	if (numConfiguredPorts != 0)
+	{
+		for (size_t group = 0; group < numPortGroups; ++group)
+		{
+			if (descriptor.bitsToSet[group] != 0)
+			{
+				groupPioBases[group]->PIO_SODR = descriptor.bitsToSet[group];
+			}
+			if (descriptor.bitsToClear[group] != 0)
+			{
+				groupPioBases[group]->PIO_CODR = descriptor.bitsToClear[group];
+			}
+		}
+		if (slowPorts != 0 && ((currentPortState ^ bits) & slowPorts) != 0)
+		{
+			pendingSlowPortState = bits;
+			slowPortWritePending = true;
+		}
+		currentPortState = bits;
+	}
+}
+
 void PortControl::UpdatePorts(IoBits_t newPortState)
 {
 	if (newPortState != currentPortState)
 	{
-		const IoBits_t bitsToClear = currentPortState & ~newPortState;
-		const IoBits_t bitsToSet = newPortState & ~currentPortState;
+		const IoBits_t changedPorts = newPortState ^ currentPortState;
+		const IoBits_t highPorts = newPortState ^ invertedPorts;	// the ports whose output pins need to be high
+		uint32_t bitsToSet[MaxPortGroups] = { 0 };
+		uint32_t bitsToClear[MaxPortGroups] = { 0 };
 		for (size_t i = 0; i < numConfiguredPorts; ++i)
 		{
 			const IoBits_t mask = 1u << i;
-			if (bitsToClear & mask)
+			if (changedPorts & mask)
+			{
+				if (portPioMasks[i] != 0)
+				{
+					if (highPorts & mask)
+					{
+						bitsToSet[portGroupIndices[i]] |= portPioMasks[i];
+					}
+					else
+					{
+						bitsToClear[portGroupIndices[i]] |= portPioMasks[i];
+					}
+				}
+				else
+				{
+					portMap[i].WriteDigital((newPortState & mask) != 0);
+				}
+			}
+		}
+
+		// Now change all the pins on each PIO controller together
+		for (size_t group = 0; group < numPortGroups; ++group)
+		{
+			if (bitsToSet[group] != 0)
 			{
-				portMap[i].WriteDigital(false);
+				groupPioBases[group]->PIO_SODR = bitsToSet[group];
 			}
-			else if (bitsToSet & mask)
+			if (bitsToClear[group] != 0)
 			{
-				portMap[i].WriteDigital(true);
+				groupPioBases[group]->PIO_CODR = bitsToClear[group];
 			}
 		}
 		currentPortState = newPortState;
@@ -26,6 +26,21 @@ public:
 	void Spin(bool full);
 	bool Configure(GCodeBuffer& gb, StringRef& reply);
 
+	static const size_t MaxPortGroups = 5;	// the processors we support have no more than 5 PIO controllers (PIOA..PIOE)
+
+	// A precomputed parallel write that drives the fast ports to one particular state. Built while the move is
+	// still being prepared, so that the step ISR can apply the state with a single store per PIO controller.
+	// The descriptor sets or clears every fast port, so applying it does not depend on the previous port state.
+	struct PortWriteDescriptor
+	{
+		uint32_t bitsToSet[MaxPortGroups];
+		uint32_t bitsToClear[MaxPortGroups];
+	};
+
+	void PreparePortWrite(IoBits_t bits, PortWriteDescriptor& descriptor) const;	// called by DDA::Prepare
+	void ApplyPortWrite(const PortWriteDescriptor& descriptor, IoBits_t bits);		// called from the step ISR
+	uint32_t GetAdvanceClocks() const { return advanceClocks; }
+
 private:
 	void UpdatePorts(IoBits_t newPortState);
 
@@ -35,7 +50,18 @@ private:
 	size_t numConfiguredPorts;
 	unsigned int advanceMillis;
 	uint32_t advanceClocks;
-	IoBits_t currentPortState;
+	volatile IoBits_t currentPortState;		// the state most recently applied, written by the step ISR while moves are executing
+
+	// Port write descriptors built by Configure, so that port state changes write all the pins on one PIO controller with a single store
+	size_t numPortGroups;					// the number of different PIO controllers the configured ports are spread over
+	Pio *groupPioBases[MaxPortGroups];		// the PIO controller for each group
+	uint32_t portPioMasks[MaxPorts];		// the PIO bit mask of each configured port, or 0 if the port needs the slow path
+	uint8_t portGroupIndices[MaxPorts];		// which group each configured port belongs to
+	IoBits_t invertedPorts;					// bitmap of configured ports with inverted output polarity
+	IoBits_t slowPorts;						// bitmap of configured ports that cannot be written from the step ISR (e.g. expansion board pins)
+	PortWriteDescriptor allPortsOff;		// precomputed write that turns every fast port off, used when movement stops
+	volatile IoBits_t pendingSlowPortState;	// the state the slow ports should take, requested by the step ISR
+	volatile bool slowPortWritePending;		// whether the step ISR has requested a slow port write
 };
 
 #endif
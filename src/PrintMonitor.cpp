@@ -28,11 +28,17 @@ Licence: GPL
 PrintMonitor::PrintMonitor(Platform& p, GCodes& gc) : platform(p), gCodes(gc), isPrinting(false),
 	printStartTime(0), pauseStartTime(0), totalPauseTime(0), heatingUp(false), currentLayer(0), warmUpDuration(0.0),
 	firstLayerDuration(0.0), firstLayerFilament(0.0), firstLayerProgress(0.0), lastLayerChangeTime(0.0),
-	lastLayerFilament(0.0), lastLayerZ(0.0), numLayerSamples(0), layerEstimatedTimeLeft(0.0), parseState(notParsing),
+	lastLayerFilament(0.0), lastLayerZ(0.0), numLayerSamples(0), layerEstimatedTimeLeft(0.0),
+	numLayerTimesStored(0), layersPerTimeSample(1), layerTimeAccumulator(0.0), layersAccumulated(0), parseState(notParsing),
 	fileBeingParsed(nullptr), fileOverlapLength(0), printingFileParsed(false), accumulatedParseTime(0),
 	accumulatedReadTime(0), accumulatedSeekTime(0)
 {
 	filenameBeingPrinted[0] = 0;
+	for (FileInfoCacheEntry& entry : fileInfoCache)
+	{
+		entry.fileName[0] = 0;
+		entry.lastUsed = 0;
+	}
 }
 
 void PrintMonitor::Init()
@@ -193,18 +199,63 @@ void PrintMonitor::FirstLayerComplete()
 	firstLayerDuration = GetPrintDuration() - warmUpDuration;
 	firstLayerProgress = gCodes.FractionOfFilePrinted();
 
-	// Update layer-based estimation time (if the object and layer heights are known)
+	// Update layer-based estimation time
 	// This won't be very accurate, but at least something can be sent the web interface and to PanelDue
-	if (printingFileInfo.objectHeight > 0.0 && printingFileInfo.layerHeight > 0.0)
+	const unsigned int layersToPrint = GetTotalLayers();
+	if (layersToPrint != 0)
 	{
-		unsigned int layersToPrint = round((printingFileInfo.objectHeight - printingFileInfo.firstLayerHeight) / printingFileInfo.layerHeight) + 1;
 		layerEstimatedTimeLeft = firstLayerDuration * FIRST_LAYER_SPEED_FACTOR * (layersToPrint - 1);
 	}
 }
 
+// Return the total number of layers in the file being printed, preferring the exact count reported by the slicer
+// over one derived from the object and layer heights (which is wrong for parts with support or variable layer heights).
+// Returns 0 if we have insufficient information.
+unsigned int PrintMonitor::GetTotalLayers() const
+{
+	if (printingFileInfo.numLayers != 0)
+	{
+		return printingFileInfo.numLayers;
+	}
+	if (printingFileInfo.objectHeight > 0.0 && printingFileInfo.layerHeight > 0.0)
+	{
+		return round((printingFileInfo.objectHeight - printingFileInfo.firstLayerHeight) / printingFileInfo.layerHeight) + 1;
+	}
+	return 0;
+}
+
+// Add a completed layer time to the whole-print history, merging entries when the history is full
+void PrintMonitor::RecordLayerTime(float duration)
+{
+	layerTimeAccumulator += duration;
+	++layersAccumulated;
+	if (layersAccumulated >= layersPerTimeSample)
+	{
+		if (numLayerTimesStored == MAX_LAYER_TIME_HISTORY)
+		{
+			// History is full - merge adjacent entries so that each one covers twice as many layers
+			for (size_t i = 0; i < MAX_LAYER_TIME_HISTORY/2; ++i)
+			{
+				layerTimeHistory[i] = (layerTimeHistory[2 * i] + layerTimeHistory[(2 * i) + 1]) * 0.5;
+			}
+			numLayerTimesStored = MAX_LAYER_TIME_HISTORY/2;
+			layersPerTimeSample *= 2;
+			// The layers accumulated so far only cover part of the new sample interval, so keep accumulating
+		}
+		else
+		{
+			layerTimeHistory[numLayerTimesStored++] = layerTimeAccumulator/(float)layersAccumulated;
+			layerTimeAccumulator = 0.0;
+			layersAccumulated = 0;
+		}
+	}
+}
+
 // This is called whenever a layer greater than 2 has been finished
 void PrintMonitor::LayerComplete()
 {
+	RecordLayerTime(GetPrintDuration() - lastLayerChangeTime);
+
 	// Record a new set of layer, filament and file stats
 	const float extrRawTotal = gCodes.GetTotalRawExtrusion();
 	if (numLayerSamples < MAX_LAYER_SAMPLES)
@@ -237,8 +288,9 @@ void PrintMonitor::LayerComplete()
 	}
 	lastLayerFilament = extrRawTotal;
 
-	// Update layer-based estimation time (if the object and layer heights are known)
-	if (printingFileInfo.objectHeight > 0.0 && printingFileInfo.layerHeight > 0.0)
+	// Update layer-based estimation time (if the total layer count is known)
+	const unsigned int totalLayers = GetTotalLayers();
+	if (totalLayers != 0)
 	{
 		// Calculate the average layer time and include the first layer if possible
 		float avgLayerTime = (numLayerSamples < MAX_LAYER_SAMPLES)
@@ -251,8 +303,6 @@ void PrintMonitor::LayerComplete()
 		avgLayerTime /= (numLayerSamples < MAX_LAYER_SAMPLES) ? numLayerSamples + 1 : numLayerSamples;
 
 		// Estimate the layer-based time left
-		unsigned int totalLayers;
-		totalLayers = round((printingFileInfo.objectHeight - printingFileInfo.firstLayerHeight) / printingFileInfo.layerHeight) + 1;
 		if (currentLayer < totalLayers)
 		{
 			// Current layer is within reasonable boundaries, so an estimation can be made
@@ -270,6 +320,9 @@ void PrintMonitor::StoppedPrint()
 {
 	isPrinting = heatingUp = printingFileParsed = false;
 	currentLayer = numLayerSamples = 0;
+	numLayerTimesStored = layersAccumulated = 0;
+	layersPerTimeSample = 1;
+	layerTimeAccumulator = 0.0;
 	pauseStartTime = totalPauseTime = 0;
 	firstLayerDuration = firstLayerFilament = firstLayerProgress = 0.0;
 	layerEstimatedTimeLeft = printStartTime = warmUpDuration = 0.0;
@@ -308,12 +361,22 @@ bool PrintMonitor::GetFileInfo(const char *directory, const char *fileName, GCod
 		parsedFileInfo.objectHeight = 0.0;
 		parsedFileInfo.layerHeight = 0.0;
 		parsedFileInfo.numFilaments = 0;
+		parsedFileInfo.numLayers = 0;
 		parsedFileInfo.generatedBy[0] = 0;
 		for(size_t extr = 0; extr < MaxExtruders; extr++)
 		{
 			parsedFileInfo.filamentNeeded[extr] = 0.0;
 		}
 
+		// If we have parsed this file before and it has not changed since, serve the result from the cache
+		const GCodeFileInfo * const cachedInfo = FindCachedFileInfo(fileName, parsedFileInfo.fileSize, parsedFileInfo.lastModifiedTime);
+		if (cachedInfo != nullptr)
+		{
+			fileBeingParsed->Close();
+			info = *cachedInfo;
+			return true;
+		}
+
 		// Record some debug values here
 		if (reprap.Debug(modulePrintMonitor))
 		{
@@ -329,6 +392,12 @@ bool PrintMonitor::GetFileInfo(const char *directory, const char *fileName, GCod
 			info = parsedFileInfo;
 			return true;
 		}
+
+		// Build a cluster map for the file so that the backwards seeks we do when scanning the footer
+		// do not have to walk the FAT chain from the start of a large file every time
+		parseClusterMap[0] = FileClusterMapSize;
+		(void)fileBeingParsed->SetClusterMap(parseClusterMap);
+
 		parseState = parsingHeader;
 	}
 	else if (!StringEquals(fileName, filenameBeingParsed))
@@ -397,6 +466,12 @@ bool PrintMonitor::GetFileInfo(const char *directory, const char *fileName, GCod
 				headerInfoComplete &= FindLayerHeight(buf, sizeToScan, parsedFileInfo.layerHeight);
 			}
 
+			// Look for the layer count. Not all slicers report it, so this doesn't hold up header completion.
+			if (parsedFileInfo.numLayers == 0)
+			{
+				(void)FindNumLayers(buf, sizeToScan, parsedFileInfo.numLayers);
+			}
+
 			// Look for slicer program
 			if (parsedFileInfo.generatedBy[0] == 0)
 			{
@@ -537,6 +612,12 @@ bool PrintMonitor::GetFileInfo(const char *directory, const char *fileName, GCod
 				}
 			}
 
+			// Search for the layer count, opportunistically as in the header scan
+			if (parsedFileInfo.numLayers == 0)
+			{
+				(void)FindNumLayers(buf, sizeToScan, parsedFileInfo.numLayers);
+			}
+
 			// Search for object height
 			if (parsedFileInfo.objectHeight == 0.0)
 			{
@@ -560,6 +641,7 @@ bool PrintMonitor::GetFileInfo(const char *directory, const char *fileName, GCod
 				}
 				parseState = notParsing;
 				fileBeingParsed->Close();
+				StoreCachedFileInfo(fileName, parsedFileInfo);
 				info = parsedFileInfo;
 				return true;
 			}
@@ -584,6 +666,45 @@ bool PrintMonitor::GetFileInfo(const char *directory, const char *fileName, GCod
 	return false;
 }
 
+// Look up the parse results for a file in the cache. Returns nullptr if we have no current information about it.
+const GCodeFileInfo *PrintMonitor::FindCachedFileInfo(const char *fileName, FilePosition fileSize, time_t lastModifiedTime)
+{
+	for (FileInfoCacheEntry& entry : fileInfoCache)
+	{
+		if (   entry.fileName[0] != 0
+			&& StringEquals(entry.fileName, fileName)
+			&& entry.info.fileSize == fileSize
+			&& entry.info.lastModifiedTime == lastModifiedTime
+		   )
+		{
+			entry.lastUsed = millis();
+			return &entry.info;
+		}
+	}
+	return nullptr;
+}
+
+// Record the parse results for a file in the cache, replacing the least recently used entry
+void PrintMonitor::StoreCachedFileInfo(const char *fileName, const GCodeFileInfo& info)
+{
+	FileInfoCacheEntry *best = &fileInfoCache[0];
+	for (FileInfoCacheEntry& entry : fileInfoCache)
+	{
+		if (entry.fileName[0] == 0)
+		{
+			best = &entry;
+			break;
+		}
+		if ((int32_t)(entry.lastUsed - best->lastUsed) < 0)
+		{
+			best = &entry;
+		}
+	}
+	SafeStrncpy(best->fileName, fileName, ARRAY_SIZE(best->fileName));
+	best->info = info;
+	best->lastUsed = millis();
+}
+
 // Get information for the specified file, or the currently printing file, in JSON format
 bool PrintMonitor::GetFileInfoResponse(const char *filename, OutputBuffer *&response)
 {
@@ -1056,6 +1177,54 @@ bool PrintMonitor::FindLayerHeight(const char *buf, size_t len, float& layerHeig
 	return false;
 }
 
+// Scan the buffer for the total layer count reported by the slicer. The buffer is null-terminated.
+bool PrintMonitor::FindNumLayers(const char *buf, size_t len, unsigned int& numLayers) const
+{
+	static const char* const layerCountStrings[] =
+	{
+		"LAYER_COUNT",			// Cura
+		"num_layers"			// KISSlicer
+	};
+
+	if (*buf != 0)
+	{
+		++buf;														// make sure we can look back 1 character after we find a match
+		for (size_t i = 0; i < ARRAY_SIZE(layerCountStrings); ++i)	// search for each string in turn
+		{
+			const char *pos = buf;
+			for(;;)													// loop until success or strstr returns null
+			{
+				pos = strstr(pos, layerCountStrings[i]);
+				if (pos == nullptr)
+				{
+					break;											// didn't find this string in the buffer, so try the next string
+				}
+
+				const char c = pos[-1];								// fetch the previous character
+				pos += strlen(layerCountStrings[i]);				// skip the string we matched
+				if (c == ' ' || c == ';' || c == '\t')				// check we are not in the middle of a word
+				{
+					while (strchr(" \t=:,", *pos) != nullptr)		// skip the possible separators
+					{
+						++pos;
+					}
+					if (isDigit(*pos))
+					{
+						const unsigned long val = strtoul(pos, nullptr, 10);
+						if (val != 0)
+						{
+							numLayers = (unsigned int)val;
+							return true;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
 // Scan the buffer for the filament used. The buffer is null-terminated.
 // Returns the number of filaments found.
 unsigned int PrintMonitor::FindFilamentUsed(const char* buf, size_t len, float *filamentUsed, unsigned int maxFilaments) const
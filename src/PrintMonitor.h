@@ -21,6 +21,7 @@ Licence: GPL
 #define PRINTMONITOR_H
 
 #include "RepRapFirmware.h"
+#include "Storage/FileStore.h"
 
 const FilePosition GCODE_HEADER_SIZE = 20000uL;		// How many bytes to read from the header - I (DC) have a Kisslicer file with a layer height comment 14Kb from the start
 const FilePosition GCODE_FOOTER_SIZE = 400000uL;	// How many bytes to read from the footer
@@ -36,6 +37,7 @@ const size_t GCODE_OVERLAP_SIZE = 100;				// Size of the overlapping buffer for
 const float LAYER_HEIGHT_TOLERANCE = 0.015;			// Tolerance for comparing two Z heights (in mm)
 
 const size_t MAX_LAYER_SAMPLES = 5;					// Number of layer samples for end-time estimation (except for first layer)
+const size_t MAX_LAYER_TIME_HISTORY = 32;			// Number of entries in the whole-print layer time history; entries are merged when it fills up
 const float ESTIMATION_MIN_FILAMENT_USAGE = 0.01;	// Minimum per cent of filament to be printed before the filament-based estimation returns values
 const float ESTIMATION_MIN_FILE_USAGE = 0.001;		// Minimum per cent of the file to be processed before any file-based estimations are made
 const float FIRST_LAYER_SPEED_FACTOR = 0.25;		// First layer speed factor compared to other layers (only for layer-based estimation)
@@ -43,6 +45,8 @@ const float FIRST_LAYER_SPEED_FACTOR = 0.25;		// First layer speed factor compar
 const uint32_t PRINTMONITOR_UPDATE_INTERVAL = 200;	// Update interval in milliseconds
 const uint32_t MAX_FILEINFO_PROCESS_TIME = 200;		// Maximum time to spend polling for file info in each call
 
+const size_t NumFileInfoCacheEntries = 4;			// How many sets of parsed file information we remember
+
 enum PrintEstimationMethod
 {
 	filamentBased,
@@ -61,6 +65,7 @@ struct GCodeFileInfo
 	float filamentNeeded[MaxExtruders];
 	unsigned int numFilaments;
 	float layerHeight;
+	unsigned int numLayers;							// the layer count reported by the slicer, or 0 if it didn't report one
 	char generatedBy[50];
 };
 
@@ -98,6 +103,7 @@ class PrintMonitor
 		float GetWarmUpDuration() const;
 		float GetFirstLayerDuration() const;
 		float GetFirstLayerHeight() const;
+		size_t GetLayerTimeHistory(const float *&history, unsigned int& layersPerSample) const;
 
 		const char *GetPrintingFilename() const { return (isPrinting) ? filenameBeingPrinted : nullptr; }
 
@@ -111,6 +117,8 @@ class PrintMonitor
 		void WarmUpComplete();
 		void FirstLayerComplete();
 		void LayerComplete();
+		unsigned int GetTotalLayers() const;
+		void RecordLayerTime(float duration);
 
 		bool isPrinting;
 		uint64_t printStartTime;
@@ -128,15 +136,38 @@ class PrintMonitor
 		float fileProgressPerLayer[MAX_LAYER_SAMPLES];
 		float layerEstimatedTimeLeft;
 
+		// Whole-print layer time history for trend analysis. When the array fills up, adjacent entries are merged
+		// and each entry then covers twice as many layers, so long prints are downsampled automatically.
+		float layerTimeHistory[MAX_LAYER_TIME_HISTORY];
+		size_t numLayerTimesStored;
+		unsigned int layersPerTimeSample;			// how many layers each history entry averages over
+		float layerTimeAccumulator;					// sum of completed layer times not yet stored in the history
+		unsigned int layersAccumulated;				// how many layers layerTimeAccumulator covers
+
 		// We parse G-Code files in multiple stages. These variables hold the required information
 		volatile FileParseState parseState;
 		char filenameBeingParsed[FILENAME_LENGTH];
 		FileStore *fileBeingParsed;
 		GCodeFileInfo parsedFileInfo;
+		DWORD parseClusterMap[FileClusterMapSize];	// FAT cluster map for the file being parsed, so that the backwards seeks when scanning the footer are cheap
 
 		char fileOverlap[GCODE_OVERLAP_SIZE];
 		size_t fileOverlapLength;
 
+		// Results of recently completed parses, so that re-selecting a file we have already scanned costs nothing.
+		// An entry is valid if its fileName is not empty; the file size and date stored in the info form part of the key.
+		struct FileInfoCacheEntry
+		{
+			char fileName[FILENAME_LENGTH];			// which file the info belongs to, or empty if the entry is unused
+			GCodeFileInfo info;						// the parse results including the file size and last modified time
+			uint32_t lastUsed;						// when we last returned this entry, for LRU replacement
+		};
+
+		const GCodeFileInfo *FindCachedFileInfo(const char *fileName, FilePosition fileSize, time_t lastModifiedTime);
+		void StoreCachedFileInfo(const char *fileName, const GCodeFileInfo& info);
+
+		FileInfoCacheEntry fileInfoCache[NumFileInfoCacheEntries];
+
 		bool printingFileParsed;
 		GCodeFileInfo printingFileInfo;
 		char filenameBeingPrinted[FILENAME_LENGTH];
@@ -145,6 +176,7 @@ class PrintMonitor
 		bool FindHeight(const char* buf, size_t len, float& height) const;
 		bool FindFirstLayerHeight(const char* buf, size_t len, float& layerHeight) const;
 		bool FindLayerHeight(const char* buf, size_t len, float& layerHeight) const;
+		bool FindNumLayers(const char* buf, size_t len, unsigned int& numLayers) const;
 		unsigned int FindFilamentUsed(const char* buf, size_t len, float *filamentUsed, unsigned int maxFilaments) const;
 
 		uint32_t accumulatedParseTime, accumulatedReadTime, accumulatedSeekTime;
@@ -156,6 +188,13 @@ inline float PrintMonitor::GetCurrentLayerTime() const { return (lastLayerChange
 inline float PrintMonitor::GetFirstLayerDuration() const { return (firstLayerDuration > 0.0) ? firstLayerDuration : ((currentLayer > 0) ? GetPrintDuration() - warmUpDuration : 0.0); }
 inline float PrintMonitor::GetFirstLayerHeight() const { return printingFileParsed ? printingFileInfo.firstLayerHeight : 0.0; }
 
+inline size_t PrintMonitor::GetLayerTimeHistory(const float *&history, unsigned int& layersPerSample) const
+{
+	history = layerTimeHistory;
+	layersPerSample = layersPerTimeSample;
+	return numLayerTimesStored;
+}
+
 #endif /* PRINTMONITOR_H */
 
 // vim: ts=4:sw=4
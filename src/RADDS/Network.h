@@ -15,6 +15,7 @@ class Network
 public:
 	Network(Platform& p) { }
 	void Init() const { }
+	void Prepare() const { }
 	void Activate() const { }
 	void Enable(int mode, StringRef& reply);
 	bool GetNetworkState(StringRef& reply);
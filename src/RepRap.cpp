@@ -2,13 +2,21 @@
 
 #include "Movement/Move.h"
 #include "GCodes/GCodes.h"
+#include "GCodes/JobQueue.h"
 #include "Heating/Heat.h"
 #include "Network.h"
 #include "Platform.h"
 #include "Scanner.h"
 #include "PrintMonitor.h"
 #include "Tools/Tool.h"
+#include "Movement/Kinematics/Kinematics.h"
 #include "Tools/Filament.h"
+#include "EventTrace.h"
+#include "DebugRouting.h"
+
+static const char * const ToolStatsFileName = "toolstats.csv";	// where the lifetime tool usage statistics are kept, in the system directory
+static const uint32_t ToolStatsSaveInterval = 10 * 60 * 1000;	// how often to save changed tool usage statistics, in milliseconds
+static const uint32_t IdleNetworkPollInterval = 10;				// interval between full network polls when the machine is idle, in milliseconds
 
 #ifdef DUET_NG
 # include "DueXn.h"
@@ -50,14 +58,40 @@ extern "C" void hsmciIdle()
 	}
 }
 
+// The Spin() calls of these modules are not time-critical, so they take turns in RepRap::Spin()
+static const Module rotatedModules[] =
+{
+	moduleNetwork,
+#if SUPPORT_ROLAND
+	moduleRoland,
+#endif
+#if SUPPORT_SCANNER
+	moduleScanner,
+#endif
+	modulePrintMonitor,
+#ifdef DUET_NG
+	moduleDuetExpansion,
+#endif
+	moduleFilamentSensors
+};
+
+const uint32_t MaxRotatedSpinClocks = DDA::stepClockRate/1000;	// the rotated modules may together spend about 1ms per iteration
+
+const uint32_t MaxBackgroundTaskClocks = DDA::stepClockRate/500;	// the background task gets about 2ms per iteration
+const uint32_t DefaultSpinBudgetClocks = DDA::stepClockRate/100;	// default soft watchdog budget per Spin() call (10ms), adjustable by M122 S
+
+const uint32_t StatusResponseCacheLifetime = 250;	// for how long a rendered status response may be re-served to other HTTP clients (milliseconds)
+const size_t StatusResponseCacheSize = 2048;		// the longest status response we cache
+
 // RepRap member functions.
 
 // Do nothing more in the constructor; put what you want in RepRap:Init()
 
-RepRap::RepRap() : toolList(nullptr), currentTool(nullptr), lastWarningMillis(0), activeExtruders(0),
+RepRap::RepRap() : toolList(nullptr), currentTool(nullptr), lastWarningMillis(0), lastToolStatsSaveTime(0), lastFullNetworkPollTime(0), activeExtruders(0),
 	activeToolHeaters(0), ticksInSpinState(0), spinningModule(noModule), debug(0), stopped(false),
 	active(false), resetting(false), processingConfig(true), beepFrequency(0), beepDuration(0),
-	displayMessageBox(false), boxSeq(0)
+	statusChangeSeq(1), statusResponseCache(nullptr), statusResponseCacheLength(0), stateJournalSeq(0),
+	backgroundTask(nullptr), displayMessageBox(false), boxSeq(0)
 {
 	OutputBuffer::Init();
 	platform = new Platform();
@@ -103,8 +137,15 @@ void RepRap::Init()
 	printMonitor->Init();
 	active = true;					// must do this before we start the network, else the watchdog may time out
 
+	// Check that nothing has quietly reprogrammed an interrupt priority during the init sequence
+	platform->AuditInterruptPriorities(WarningMessage, false);
+
 	platform->MessageF(UsbMessage, "%s Version %s dated %s\n", FIRMWARE_NAME, VERSION, DATE);
 
+	// Begin bringing the network interface up, so that its startup waits overlap with running the configuration file.
+	// Anything that depends on values set by config.g (hostname, IP address etc.) waits for Activate below.
+	network->Prepare();
+
 	// Run the configuration file
 	const char *configFile = platform->GetConfigFile();
 	platform->Message(UsbMessage, "\nExecuting ");
@@ -133,6 +174,10 @@ void RepRap::Init()
 	}
 	processingConfig = false;
 
+#if SAM4E || SAM4S || SAME70
+	OutputBuffer::GrowPoolFromSpareRam();	// all modules have allocated their memory by now, so turn spare RAM into extra output buffers
+#endif
+
 	// Enable network (unless it's disabled)
 	network->Activate();			// Need to do this here, as the configuration GCodes may set IP address etc.
 
@@ -142,6 +187,26 @@ void RepRap::Init()
 	platform->MessageF(UsbMessage, "%s is up and running.\n", FIRMWARE_NAME);
 	fastLoop = UINT32_MAX;
 	slowLoop = 0;
+	for (size_t i = 0; i < numModules; ++i)
+	{
+		moduleSpinMaxClocks[i] = 0;
+		moduleSpinTotalClocks[i] = 0;
+	}
+	spinAccountingLoops = 0;
+	spinBudgetClocks = DefaultSpinBudgetClocks;
+	deferOverrunningModules = false;
+	deferredModules = 0;
+	for (size_t i = 0; i < numModules; ++i)
+	{
+		moduleSpinOverruns[i] = 0;
+		moduleSpinWorstClocks[i] = 0;
+	}
+	nextRotatedModule = 0;
+	for (size_t i = 0; i < numModules; ++i)
+	{
+		lastRotatedRunTime[i] = millis();
+		maxRotatedWaitTime[i] = 0;
+	}
 	lastTime = micros();
 }
 
@@ -169,64 +234,124 @@ void RepRap::Spin()
 	if(!active)
 		return;
 
+	uint32_t spinStartClocks;
 	ticksInSpinState = 0;
 	spinningModule = modulePlatform;
+	spinStartClocks = Platform::GetInterruptClocks();
 	platform->Spin();
-
-	ticksInSpinState = 0;
-	spinningModule = moduleNetwork;
-	network->Spin(true);
-
-	ticksInSpinState = 0;
-	spinningModule = moduleWebserver;
+	RecordSpinTime(modulePlatform, spinStartClocks);
 
 	ticksInSpinState = 0;
 	spinningModule = moduleGcodes;
+	spinStartClocks = Platform::GetInterruptClocks();
 	gCodes->Spin();
+	RecordSpinTime(moduleGcodes, spinStartClocks);
 
 	ticksInSpinState = 0;
 	spinningModule = moduleMove;
+	spinStartClocks = Platform::GetInterruptClocks();
 	move->Spin();
+	RecordSpinTime(moduleMove, spinStartClocks);
 
 	ticksInSpinState = 0;
 	spinningModule = moduleHeat;
+	spinStartClocks = Platform::GetInterruptClocks();
 	heat->Spin();
-
-#if SUPPORT_ROLAND
-	ticksInSpinState = 0;
-	spinningModule = moduleRoland;
-	roland->Spin();
-#endif
-
-#if SUPPORT_SCANNER
-	ticksInSpinState = 0;
-	spinningModule = moduleScanner;
-	scanner->Spin();
-#endif
+	RecordSpinTime(moduleHeat, spinStartClocks);
 
 #if SUPPORT_IOBITS
 	ticksInSpinState = 0;
 	spinningModule = modulePortControl;
+	spinStartClocks = Platform::GetInterruptClocks();
 	portControl->Spin(true);
+	RecordSpinTime(modulePortControl, spinStartClocks);
 #endif
 
-	ticksInSpinState = 0;
-	spinningModule = modulePrintMonitor;
-	printMonitor->Spin();
+	// The remaining modules are not time-critical, so they take turns: at least one of them runs each iteration,
+	// and more follow while the time budget allows. When everything is fast this degenerates to running them all,
+	// as before; when one of them is slow, the others wait but motion preparation in Move::Spin() is not delayed
+	// past the next iteration. We track the longest wait of each module so that starvation shows up under M122.
+	const uint32_t rotationStartClocks = Platform::GetInterruptClocks();
+	const size_t firstRotatedModule = nextRotatedModule;
+	do
+	{
+		const Module m = rotatedModules[nextRotatedModule];
+		nextRotatedModule = (nextRotatedModule + 1) % ARRAY_SIZE(rotatedModules);
+
+		if ((deferredModules & (1u << m)) != 0)
+		{
+			// This module overran its Spin budget last time it ran, so it forfeits this turn
+			deferredModules &= ~(1u << m);
+			continue;
+		}
+
+		const uint32_t now = millis();
+		if (now - lastRotatedRunTime[m] > maxRotatedWaitTime[m])
+		{
+			maxRotatedWaitTime[m] = now - lastRotatedRunTime[m];
+		}
+		lastRotatedRunTime[m] = now;
 
+		ticksInSpinState = 0;
+		spinningModule = m;
+		spinStartClocks = Platform::GetInterruptClocks();
+		switch (m)
+		{
+		case moduleNetwork:
+			// When the machine has been idle long enough for the motors to be in idle hold and no print
+			// is in progress, run full network polls at a relaxed cadence to save power; quick polls
+			// still run so that incoming requests are noticed promptly
+			if (move->IsInIdleHold() && !printMonitor->IsPrinting() && now - lastFullNetworkPollTime < IdleNetworkPollInterval)
+			{
+				network->Spin(false);
+			}
+			else
+			{
+				lastFullNetworkPollTime = now;
+				network->Spin(true);
+			}
+			break;
+#if SUPPORT_ROLAND
+		case moduleRoland:
+			roland->Spin();
+			break;
+#endif
+#if SUPPORT_SCANNER
+		case moduleScanner:
+			scanner->Spin();
+			break;
+#endif
+		case modulePrintMonitor:
+			printMonitor->Spin();
+			break;
 #ifdef DUET_NG
-	ticksInSpinState = 0;
-	spinningModule = moduleDuetExpansion;
-	DuetExpansion::Spin(true);
+		case moduleDuetExpansion:
+			DuetExpansion::Spin(true);
+			break;
 #endif
-
-	ticksInSpinState = 0;
-	spinningModule = moduleFilamentSensors;
-	FilamentSensor::Spin(true);
+		case moduleFilamentSensors:
+			FilamentSensor::Spin(true);
+			break;
+		default:
+			break;
+		}
+		RecordSpinTime(m, spinStartClocks);
+	}
+	while (nextRotatedModule != firstRotatedModule && Platform::GetInterruptClocks() - rotationStartClocks < MaxRotatedSpinClocks);
 
 	ticksInSpinState = 0;
 	spinningModule = noModule;
 
+	// Give the background task (if there is one) a slice of time
+	if (backgroundTask != nullptr)
+	{
+		if (backgroundTask(backgroundTaskParam, Platform::GetInterruptClocks() + MaxBackgroundTaskClocks))
+		{
+			backgroundTask = nullptr;
+		}
+		ticksInSpinState = 0;
+	}
+
 	// Check if we need to display a cold extrusion warning
 	const uint32_t now = millis();
 	if (now - lastWarningMillis >= MinimumWarningInterval)
@@ -241,6 +366,15 @@ void RepRap::Spin()
 		}
 	}
 
+	// Save the lifetime tool usage statistics from time to time if they have changed
+	if (!processingConfig && now - lastToolStatsSaveTime >= ToolStatsSaveInterval)
+	{
+		SaveToolStats();
+		lastToolStatsSaveTime = now;
+	}
+
+	++spinAccountingLoops;
+
 	// Keep track of the loop time
 	const uint32_t t = micros();
 	const uint32_t dt = t - lastTime;
@@ -255,13 +389,104 @@ void RepRap::Spin()
 	lastTime = t;
 }
 
+static const uint32_t SpinOutlierClocks = DDA::stepClockRate/10;	// Spin() calls longer than this (100ms) are recorded in the event trace
+
+// Add the elapsed time since 'startClocks' to the spin time accounts of 'module'
+inline void RepRap::RecordSpinTime(Module module, uint32_t startClocks)
+{
+	const uint32_t clocksTaken = Platform::GetInterruptClocks() - startClocks;
+	if (clocksTaken > moduleSpinMaxClocks[module])
+	{
+		moduleSpinMaxClocks[module] = clocksTaken;
+	}
+	if (clocksTaken > SpinOutlierClocks && !processingConfig)
+	{
+		EventTrace::Record(EventTrace::EventType::spinOutlier, (uint8_t)module, (uint16_t)min<uint32_t>(clocksTaken/(DDA::stepClockRate/1000u), 0xFFFF));
+	}
+	if (clocksTaken > spinBudgetClocks && !processingConfig)
+	{
+		// Soft watchdog: the call exceeded its budget. Count it against the module, and if deferral is enabled
+		// make the module forfeit its next turn (only meaningful for the rotated modules; the time-critical
+		// modules at the head of Spin() always run, but their overruns are still counted and reported).
+		++moduleSpinOverruns[module];
+		if (clocksTaken > moduleSpinWorstClocks[module])
+		{
+			moduleSpinWorstClocks[module] = clocksTaken;
+		}
+		if (deferOverrunningModules)
+		{
+			deferredModules |= 1u << module;
+		}
+	}
+	moduleSpinTotalClocks[module] += clocksTaken;
+}
+
 void RepRap::Timing(MessageType mtype)
 {
 	platform->MessageF(mtype, "Slowest main loop (seconds): %f; fastest: %f\n", (double)(slowLoop * 0.000001), (double)(fastLoop * 0.000001));
+	if (spinAccountingLoops != 0)
+	{
+		// Report the average and worst-case spin time of each module, so that when the main loop is slow we can
+		// see which module is responsible without attaching a debugger
+		platform->Message(mtype, "Spin times (avg/max microseconds):");
+		const float microsPerClock = 1000000.0 / (float)DDA::stepClockRate;
+		for (size_t i = 0; i < numModules; ++i)
+		{
+			if (moduleSpinTotalClocks[i] != 0)
+			{
+				platform->MessageF(mtype, " %s %.1f/%.1f", moduleName[i],
+									(double)((float)(moduleSpinTotalClocks[i]/spinAccountingLoops) * microsPerClock),
+									(double)((float)moduleSpinMaxClocks[i] * microsPerClock));
+			}
+			moduleSpinMaxClocks[i] = 0;
+			moduleSpinTotalClocks[i] = 0;
+		}
+		platform->Message(mtype, "\n");
+		spinAccountingLoops = 0;
+
+		platform->Message(mtype, "Longest wait of rotated modules (ms):");
+		for (size_t i = 0; i < ARRAY_SIZE(rotatedModules); ++i)
+		{
+			const Module m = rotatedModules[i];
+			platform->MessageF(mtype, " %s %" PRIu32, moduleName[m], maxRotatedWaitTime[m]);
+			maxRotatedWaitTime[m] = 0;
+		}
+		platform->Message(mtype, "\n");
+	}
+
+	// Report the soft watchdog state. The overrun counters are deliberately not reset by this report, so that
+	// chronic offenders accumulate across reports instead of hiding behind frequent M122s.
+	platform->MessageF(mtype, "Spin budget %" PRIu32 "ms, deferral %s, overruns (count/worst ms):",
+						spinBudgetClocks/(DDA::stepClockRate/1000u), (deferOverrunningModules) ? "on" : "off");
+	{
+		bool overrunsFound = false;
+		for (size_t i = 0; i < numModules; ++i)
+		{
+			if (moduleSpinOverruns[i] != 0)
+			{
+				overrunsFound = true;
+				platform->MessageF(mtype, " %s %" PRIu32 "/%" PRIu32, moduleName[i],
+									moduleSpinOverruns[i], moduleSpinWorstClocks[i]/(DDA::stepClockRate/1000u));
+			}
+		}
+		platform->Message(mtype, (overrunsFound) ? "\n" : " none\n");
+	}
+
 	fastLoop = UINT32_MAX;
 	slowLoop = 0;
 }
 
+// Set the per-call Spin time budget of the soft watchdog
+void RepRap::SetSpinBudget(uint32_t budgetMillis)
+{
+	spinBudgetClocks = constrain<uint32_t>(budgetMillis, 1, 1000) * (DDA::stepClockRate/1000u);
+	for (size_t i = 0; i < numModules; ++i)
+	{
+		moduleSpinOverruns[i] = 0;			// changing the budget starts the counts afresh
+		moduleSpinWorstClocks[i] = 0;
+	}
+}
+
 void RepRap::Diagnostics(MessageType mtype)
 {
 	platform->Message(mtype, "=== Diagnostics ===\n");
@@ -272,6 +497,7 @@ void RepRap::Diagnostics(MessageType mtype)
 	gCodes->Diagnostics(mtype);
 	network->Diagnostics(mtype);
 	FilamentSensor::Diagnostics(mtype);
+	platform->MessageF(mtype, "Object pools: %u recycled tools, %u kinematics created\n", Tool::FreelistSize(), Kinematics::NumCreated());
 }
 
 // Turn off the heaters, disable the motors, and deactivate the Heat and Move classes. Leave everything else working.
@@ -317,6 +543,7 @@ void RepRap::SetDebug(Module m, bool enable)
 		{
 			debug &= ~(1u << m);
 		}
+		DebugRouting::SetLevel(m, (enable) ? DebugLevel::verbose : DebugLevel::off);
 	}
 	PrintDebug();
 }
@@ -324,6 +551,10 @@ void RepRap::SetDebug(Module m, bool enable)
 void RepRap::SetDebug(bool enable)
 {
 	debug = (enable) ? 0xFFFF : 0;
+	for (size_t i = 0; i < numModules; ++i)
+	{
+		DebugRouting::SetLevel((Module)i, (enable) ? DebugLevel::verbose : DebugLevel::off);
+	}
 }
 
 void RepRap::PrintDebug()
@@ -346,6 +577,27 @@ void RepRap::PrintDebug()
 		}
 	}
 	platform->Message(GenericMessage, "\n");
+
+	// Report any modules using the finer-grained level/sink routing set by M111 V and D
+	bool printedHeading = false;
+	for (size_t i = 0; i < numModules; i++)
+	{
+		const DebugLevel level = DebugRouting::GetLevel((Module)i);
+		const uint8_t sinks = DebugRouting::GetSinks((Module)i);
+		if (level != DebugLevel::off || sinks != DebugRouting::sinkUsb)
+		{
+			if (!printedHeading)
+			{
+				platform->Message(GenericMessage, "Debug levels and sinks:");
+				printedHeading = true;
+			}
+			platform->MessageF(GenericMessage, " %s(V%u,D%u)", moduleName[i], (unsigned int)level, sinks);
+		}
+	}
+	if (printedHeading)
+	{
+		platform->Message(GenericMessage, "\n");
+	}
 }
 
 // Add a tool.
@@ -362,6 +614,8 @@ void RepRap::AddTool(Tool* tool)
 	*t = tool;
 	tool->UpdateExtruderAndHeaterCount(activeExtruders, activeToolHeaters);
 	platform->UpdateConfiguredHeaters();
+	LoadToolStats(tool);
+	StatusChanged();								// the tool list is omitted from differential status responses
 }
 
 void RepRap::DeleteTool(Tool* tool)
@@ -404,6 +658,7 @@ void RepRap::DeleteTool(Tool* tool)
 		t->UpdateExtruderAndHeaterCount(activeExtruders, activeToolHeaters);
 	}
 	platform->UpdateConfiguredHeaters();
+	StatusChanged();								// the tool list is omitted from differential status responses
 }
 
 // Select the specified tool, putting the existing current tool into standby
@@ -422,6 +677,10 @@ void RepRap::SelectTool(int toolNumber, bool simulating)
 		}
 	}
 	currentTool = newTool;
+	if (!simulating)
+	{
+		RecordStateChange(ChangedField::currentTool, 0, (float)((newTool != nullptr) ? toolNumber : -1));
+	}
 }
 
 void RepRap::PrintTool(int toolNumber, StringRef& reply) const
@@ -457,6 +716,95 @@ void RepRap::StandbyTool(int toolNumber, bool simulating)
 	}
 }
 
+// Start a tool's heaters ramping up to their active temperatures ahead of a tool change,
+// so that the heating overlaps the remaining moves and the tool change macros
+void RepRap::PreheatTool(int toolNumber)
+{
+	const Tool * const tool = GetTool(toolNumber);
+	if (tool != nullptr)
+	{
+		tool->HeatersToActive();
+	}
+}
+
+// Called by the Heat module at each temperature sampling cycle. Gives each tool on standby a chance to
+// start reheating early if it is predicted to be selected again soon, and accumulates the heater-on time
+// of each tool for the usage statistics.
+void RepRap::CheckToolReheat()
+{
+	const float interval = (float)platform->HeatSampleInterval() * MillisToSeconds;
+	for (Tool *tool = toolList; tool != nullptr; tool = tool->Next())
+	{
+		tool->CheckPredictedReheat();
+		tool->AccumulateHeaterOnTime(interval);
+		tool->UpdateExtrusionGate();				// keep the cached extrusion gate flags fresh for the step ISR
+	}
+}
+
+// Load the persisted usage statistics for a newly added tool, if any were saved for its number
+void RepRap::LoadToolStats(Tool *tool)
+{
+	FileStore * const f = platform->OpenFile(platform->GetSysDir(), ToolStatsFileName, OpenMode::read);
+	if (f != nullptr)
+	{
+		char lineBuffer[80];
+		while (f->ReadLine(lineBuffer, sizeof(lineBuffer)) > 0)
+		{
+			if (isDigit(lineBuffer[0]) || lineBuffer[0] == '-')
+			{
+				char *q;
+				const int toolNumber = (int)strtol(lineBuffer, &q, 10);
+				if (toolNumber == tool->Number() && *q == ',')
+				{
+					tool->lifetimeExtrusionMm = (uint32_t)strtoul(q + 1, &q, 10);
+					if (*q == ',')
+					{
+						tool->lifetimeHeaterSeconds = (uint32_t)strtoul(q + 1, &q, 10);
+					}
+					if (*q == ',')
+					{
+						tool->lifetimeToolChanges = (uint32_t)strtoul(q + 1, &q, 10);
+					}
+					break;
+				}
+			}
+		}
+		f->Close();
+	}
+}
+
+// Save the lifetime tool usage statistics if any have changed since the last save. The file uses
+// deferred sync so that its FAT update is batched by MassStorage with other pending syncs.
+void RepRap::SaveToolStats()
+{
+	bool changed = false;
+	for (const Tool *tool = toolList; tool != nullptr; tool = tool->Next())
+	{
+		if (tool->statsChanged)
+		{
+			changed = true;
+			break;
+		}
+	}
+	if (changed)
+	{
+		FileStore * const f = platform->OpenFile(platform->GetSysDir(), ToolStatsFileName, OpenMode::write);
+		if (f != nullptr)
+		{
+			f->UseDeferredSync();
+			bool ok = f->Write("; tool number, extruded mm, heater-on seconds, tool changes\n");
+			for (Tool *tool = toolList; ok && tool != nullptr; tool = tool->Next())
+			{
+				scratchString.printf("%d,%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n",
+										tool->Number(), tool->lifetimeExtrusionMm, tool->lifetimeHeaterSeconds, tool->lifetimeToolChanges);
+				ok = f->Write(scratchString.Pointer());
+				tool->statsChanged = false;
+			}
+			f->Close();
+		}
+	}
+}
+
 Tool* RepRap::GetTool(int toolNumber) const
 {
 	Tool* tool = toolList;
@@ -552,6 +900,18 @@ void RepRap::Tick()
 }
 
 // Return true if we are close to timeout
+// Schedule a background task, returning false if another one is still running
+bool RepRap::ScheduleBackgroundTask(BackgroundTaskFunc func, void *param)
+{
+	if (backgroundTask != nullptr)
+	{
+		return false;
+	}
+	backgroundTaskParam = param;
+	backgroundTask = func;
+	return true;
+}
+
 bool RepRap::SpinTimeoutImminent() const
 {
 	return ticksInSpinState >= HighTicksInSpinState;
@@ -561,8 +921,57 @@ bool RepRap::SpinTimeoutImminent() const
 // Type 1 is the ordinary JSON status response.
 // Type 2 is the same except that static parameters are also included.
 // Type 3 is the same but instead of static parameters we report print estimation values.
-OutputBuffer *RepRap::GetStatusResponse(uint8_t type, ResponseSource source)
+// If clientSeq is nonzero then it is the status change sequence number the client saw last. When nothing
+// except the continuously-moving values has changed since then, we send a much shorter response.
+// Template for the status of the bed, chamber and cabinet heaters in the status response. The skeleton lives in
+// flash and the escape characters are the value slot markers defined in OutputBuffer; see catTemplate.
+static const char AuxHeaterStatusTemplate[] = "{\"current\":\x03,\"active\":\x03,\"state\":\x01,\"heater\":\x01},";
+
+// Append the JSON object describing one named auxiliary heater (bed, chamber or cabinet) to the response
+static void AppendAuxHeaterStatus(OutputBuffer *response, const char *name, int8_t heater, Heat& heat)
+{
+	response->cat(name);
+	OutputBuffer::TemplateValue values[4];
+	values[0].f = heat.GetTemperature(heater);
+	values[1].f = heat.GetActiveTemperature(heater);
+	values[2].i = (int32_t)heat.GetStatus(heater);
+	values[3].i = heater;
+	response->catTemplate(AuxHeaterStatusTemplate, values);
+}
+
+OutputBuffer *RepRap::GetStatusResponse(uint8_t type, ResponseSource source, uint32_t clientSeq)
 {
+	if (type == 1 && clientSeq == statusChangeSeq)
+	{
+		OutputBuffer * const diffResponse = GetDifferentialStatusResponse(source);
+		if (diffResponse != nullptr)
+		{
+			return diffResponse;
+		}
+	}
+
+	// Each connected DWC client polls for the status several times a second, and rendering the response means
+	// formatting a lot of floating point numbers. If we rendered this response a moment ago, serve a copy of it
+	// instead of rendering the same data again. Only HTTP responses are cached, because the content differs for
+	// other sources, and only while the reply sequence number is unchanged so that G-code replies are never delayed.
+	if (   source == ResponseSource::HTTP
+		&& statusResponseCacheLength != 0
+		&& statusResponseCacheType == type
+		&& statusResponseCacheSeq == network->GetHttpReplySeq()
+		&& millis() - statusResponseCacheTime < StatusResponseCacheLifetime
+	   )
+	{
+		OutputBuffer *cachedResponse;
+		if (OutputBuffer::Allocate(cachedResponse))
+		{
+			if (cachedResponse->copy(statusResponseCache, statusResponseCacheLength) == statusResponseCacheLength)
+			{
+				return cachedResponse;
+			}
+			OutputBuffer::ReleaseAll(cachedResponse);			// we ran out of buffers, so render the response directly instead
+		}
+	}
+
 	// Need something to write to...
 	OutputBuffer *response;
 	if (!OutputBuffer::Allocate(response))
@@ -752,27 +1161,21 @@ OutputBuffer *RepRap::GetStatusResponse(uint8_t type, ResponseSource source)
 		const int8_t bedHeater = (NumBedHeaters > 0) ? heat->GetBedHeater(0) : -1;
 		if (bedHeater != -1)
 		{
-			response->catf("\"bed\":{\"current\":%.1f,\"active\":%.1f,\"state\":%d,\"heater\":%d},",
-				(double)heat->GetTemperature(bedHeater), (double)heat->GetActiveTemperature(bedHeater),
-					heat->GetStatus(bedHeater), bedHeater);
+			AppendAuxHeaterStatus(response, "\"bed\":", bedHeater, *heat);
 		}
 
 		/* Chamber */
 		const int8_t chamberHeater = (NumChamberHeaters > 0) ? heat->GetChamberHeater(0) : -1;
 		if (chamberHeater != -1)
 		{
-			response->catf("\"chamber\":{\"current\":%.1f,\"active\":%.1f,\"state\":%d,\"heater\":%d},",
-				(double)heat->GetTemperature(chamberHeater), (double)heat->GetActiveTemperature(chamberHeater),
-					heat->GetStatus(chamberHeater), chamberHeater);
+			AppendAuxHeaterStatus(response, "\"chamber\":", chamberHeater, *heat);
 		}
 
 		/* Cabinet */
 		const int8_t cabinetHeater = (NumChamberHeaters > 1) ? heat->GetChamberHeater(1) : -1;
 		if (cabinetHeater != -1)
 		{
-			response->catf("\"cabinet\":{\"current\":%.1f,\"active\":%.1f,\"state\":%d,\"heater\":%d},",
-				(double)heat->GetTemperature(cabinetHeater), (double)heat->GetActiveTemperature(cabinetHeater),
-					heat->GetStatus(cabinetHeater), cabinetHeater);
+			AppendAuxHeaterStatus(response, "\"cabinet\":", cabinetHeater, *heat);
 		}
 
 		/* Heaters */
@@ -901,6 +1304,9 @@ OutputBuffer *RepRap::GetStatusResponse(uint8_t type, ResponseSource source)
 	// Time since last reset
 	response->catf(",\"time\":%.1f", (double)(millis64()/1000u));
 
+	// Status change sequence number, so that the client can ask for differential responses
+	response->catf(",\"stateSeq\":%" PRIu32, statusChangeSeq);
+
 #if SUPPORT_SCANNER
 	// Scanner
 	if (scanner->IsEnabled())
@@ -920,6 +1326,16 @@ OutputBuffer *RepRap::GetStatusResponse(uint8_t type, ResponseSource source)
 		// Maximum hotend temperature - DWC just wants the highest one
 		response->catf(",\"tempLimit\":%1.f", (double)(heat->GetHighestTemperatureLimit()));
 
+		// Heater drift: degC-equivalent drift of each heater's steady-state residual from its baseline, 0 when not monitored
+		response->cat(",\"heaterDrift\":");
+		ch = '[';
+		for (size_t heater = 0; heater < Heaters; heater++)
+		{
+			response->catf("%c%.1f", ch, (double)heat->GetResidualDrift(heater));
+			ch = ',';
+		}
+		response->cat((ch == '[') ? "[]" : "]");
+
 		// Endstops
 		uint32_t endstops = 0;
 		for(size_t drive = 0; drive < DRIVES; drive++)
@@ -946,6 +1362,9 @@ OutputBuffer *RepRap::GetStatusResponse(uint8_t type, ResponseSource source)
 		}
 		response->catf(",\"volumes\":%u,\"mountedVolumes\":%u", NumSdCards, mountedCards);
 
+		// Queued jobs
+		gCodes->GetJobQueue().AppendJsonReport(response);
+
 		// Machine name
 		response->cat(",\"name\":");
 		response->EncodeString(myName, ARRAY_SIZE(myName), false);
@@ -1112,6 +1531,25 @@ OutputBuffer *RepRap::GetStatusResponse(uint8_t type, ResponseSource source)
 		// Warm-Up Time
 		response->catf(",\"warmUpDuration\":%.1f", (double)(printMonitor->GetWarmUpDuration()));
 
+		// Layer time history, for slowdown trend analysis. Each entry is the average duration of 'layersPerSample' consecutive layers.
+		{
+			const float *layerTimes;
+			unsigned int layersPerSample;
+			const size_t numEntries = printMonitor->GetLayerTimeHistory(layerTimes, layersPerSample);
+			response->catf(",\"layersPerSample\":%u,\"layerTimes\":", layersPerSample);
+			ch = '[';
+			for (size_t i = 0; i < numEntries; ++i)
+			{
+				response->catf("%c%.1f", ch, (double)layerTimes[i]);
+				ch = ',';
+			}
+			if (ch == '[')
+			{
+				response->cat(ch);		// no layers completed yet
+			}
+			response->cat(']');
+		}
+
 		/* Print Time Estimations */
 		{
 			// Based on file progress
@@ -1139,6 +1577,458 @@ OutputBuffer *RepRap::GetStatusResponse(uint8_t type, ResponseSource source)
 	}
 	response->cat("}");
 
+	// Retain a copy of the rendered response so that other HTTP clients polling at about the same time can reuse it
+	if (source == ResponseSource::HTTP)
+	{
+		statusResponseCacheLength = 0;
+		const size_t responseLength = response->Length();
+		if (responseLength <= StatusResponseCacheSize)
+		{
+			if (statusResponseCache == nullptr)
+			{
+				statusResponseCache = new char[StatusResponseCacheSize];
+			}
+			size_t bytesCopied = 0;
+			for (const OutputBuffer *chunk = response; chunk != nullptr; chunk = chunk->Next())
+			{
+				memcpy(statusResponseCache + bytesCopied, chunk->Data(), chunk->DataLength());
+				bytesCopied += chunk->DataLength();
+			}
+			statusResponseCacheLength = responseLength;
+			statusResponseCacheType = type;
+			statusResponseCacheSeq = network->GetHttpReplySeq();
+			statusResponseCacheTime = millis();
+		}
+	}
+
+	return response;
+}
+
+// Get the short status response that we send when the client tells us it has already seen the current status
+// change sequence number. Only the values that move continuously are included - positions, current temperatures,
+// probe and fan readings - plus any pending output notifications; everything else is unchanged by definition.
+OutputBuffer *RepRap::GetDifferentialStatusResponse(ResponseSource source)
+{
+	OutputBuffer *response;
+	if (!OutputBuffer::Allocate(response))
+	{
+		return nullptr;							// the caller falls back to rendering a full response
+	}
+
+	// Machine status
+	char ch = GetStatusCharacter();
+	response->printf("{\"status\":\"%c\",\"coords\":{", ch);
+
+	// Coordinates
+	const size_t numVisibleAxes = gCodes->GetVisibleAxes();
+	{
+		float liveCoordinates[DRIVES];
+#if SUPPORT_ROLAND
+		if (roland->Active())
+		{
+			roland->GetCurrentRolandPosition(liveCoordinates);
+		}
+		else
+#endif
+		{
+			move->LiveCoordinates(liveCoordinates, GetCurrentXAxes(), GetCurrentYAxes());
+		}
+
+		if (currentTool != nullptr)
+		{
+			for (size_t i = 0; i < numVisibleAxes; ++i)
+			{
+				liveCoordinates[i] += currentTool->GetOffset(i);
+			}
+		}
+
+		// Homed axes
+		response->cat("\"axesHomed\":");
+		ch = '[';
+		for (size_t axis = 0; axis < numVisibleAxes; ++axis)
+		{
+			response->catf("%c%d", ch, (gCodes->GetAxisIsHomed(axis)) ? 1 : 0);
+			ch = ',';
+		}
+
+		// Actual and theoretical extruder positions since power up, last G92 or last M23
+		response->catf("],\"extr\":");
+		ch = '[';
+		for (size_t extruder = 0; extruder < GetExtrudersInUse(); extruder++)
+		{
+			response->catf("%c%.1f", ch, (double)liveCoordinates[gCodes->GetTotalAxes() + extruder]);
+			ch = ',';
+		}
+		if (ch == '[')
+		{
+			response->cat(ch);
+		}
+
+		// XYZ positions
+		response->cat("],\"xyz\":");
+		ch = '[';
+		for (size_t axis = 0; axis < numVisibleAxes; axis++)
+		{
+			// Coordinates may be NaNs, for example when delta or SCARA homing fails. Replace any NaNs or infinities by 9999.9 to prevent JSON parsing errors.
+			const float coord = liveCoordinates[axis];
+			response->catf("%c%.3f", ch, (double)((std::isnan(coord) || std::isinf(coord)) ? 9999.9 : coord));
+			ch = ',';
+		}
+	}
+
+	// Current tool number
+	response->catf("]},\"currentTool\":%d", GetCurrentToolNumber());
+
+	// Output notifications. These must be reported and consumed here just as in the full response.
+	{
+		bool sendBeep = ((source == ResponseSource::AUX || !platform->HaveAux()) && beepDuration != 0 && beepFrequency != 0);
+		bool sendMessage = (message[0] != 0);
+
+		float timeLeft = 0.0;
+		if (displayMessageBox && boxTimer != 0)
+		{
+			timeLeft = (float)(boxTimeout) / 1000.0 - (float)(millis() - boxTimer) / 1000.0;
+			displayMessageBox = (timeLeft > 0.0);
+		}
+
+		if (sendBeep || sendMessage || displayMessageBox)
+		{
+			response->cat(",\"output\":{");
+
+			// Report beep values
+			if (sendBeep)
+			{
+				response->catf("\"beepDuration\":%d,\"beepFrequency\":%d", beepDuration, beepFrequency);
+				if (sendMessage)
+				{
+					response->cat(",");
+				}
+				beepFrequency = beepDuration = 0;
+			}
+
+			// Report message
+			if (sendMessage)
+			{
+				response->cat("\"message\":");
+				response->EncodeString(message, ARRAY_SIZE(message), false);
+				if (displayMessageBox)
+				{
+					response->cat(",");
+				}
+				message[0] = 0;
+			}
+
+			// Report message box
+			if (displayMessageBox)
+			{
+				response->cat("\"msgBox\":{\"msg\":");
+				response->EncodeString(boxMessage, ARRAY_SIZE(boxMessage), false);
+				response->cat(",\"title\":");
+				response->EncodeString(boxTitle, ARRAY_SIZE(boxTitle), false);
+				response->catf(",\"mode\":%d,\"seq\":%" PRIu32 ",\"timeout\":%.1f,\"controls\":%" PRIu32 "}", boxMode, boxSeq, (double)timeLeft, boxControls);
+			}
+			response->cat("}");
+		}
+	}
+
+	// G-code reply sequence for webserver
+	if (source == ResponseSource::HTTP)
+	{
+		response->catf(",\"seq\":%" PRIu32, network->GetHttpReplySeq());
+	}
+
+	// Sensors
+	{
+		response->cat(",\"sensors\":{");
+
+		// Probe
+		const int v0 = platform->GetZProbeReading();
+		int v1, v2;
+		switch (platform->GetZProbeSecondaryValues(v1, v2))
+		{
+			case 1:
+				response->catf("\"probeValue\":%d,\"probeSecondary\":[%d]", v0, v1);
+				break;
+			case 2:
+				response->catf("\"probeValue\":%d,\"probeSecondary\":[%d,%d]", v0, v1, v2);
+				break;
+			default:
+				response->catf("\"probeValue\":%d", v0);
+				break;
+		}
+
+		// Fan RPM
+		response->catf(",\"fanRPM\":%d}", static_cast<unsigned int>(platform->GetFanRPM()));
+	}
+
+	// Temperatures. The setpoints are unchanged, so only the current readings and heater states are sent.
+	{
+		response->cat(",\"temps\":{");
+
+		const int8_t bedHeater = (NumBedHeaters > 0) ? heat->GetBedHeater(0) : -1;
+		if (bedHeater != -1)
+		{
+			response->catf("\"bed\":{\"current\":%.1f,\"state\":%d},", (double)heat->GetTemperature(bedHeater), heat->GetStatus(bedHeater));
+		}
+
+		const int8_t chamberHeater = (NumChamberHeaters > 0) ? heat->GetChamberHeater(0) : -1;
+		if (chamberHeater != -1)
+		{
+			response->catf("\"chamber\":{\"current\":%.1f,\"state\":%d},", (double)heat->GetTemperature(chamberHeater), heat->GetStatus(chamberHeater));
+		}
+
+		const int8_t cabinetHeater = (NumChamberHeaters > 1) ? heat->GetChamberHeater(1) : -1;
+		if (cabinetHeater != -1)
+		{
+			response->catf("\"cabinet\":{\"current\":%.1f,\"state\":%d},", (double)heat->GetTemperature(cabinetHeater), heat->GetStatus(cabinetHeater));
+		}
+
+		// Current temperatures
+		response->cat("\"current\":");
+		ch = '[';
+		for (size_t heater = 0; heater < Heaters; heater++)
+		{
+			response->catf("%c%.1f", ch, (double)heat->GetTemperature(heater));
+			ch = ',';
+		}
+		response->cat((ch == '[') ? "[]" : "]");
+
+		// Current states
+		response->cat(",\"state\":");
+		ch = '[';
+		for (size_t heater = 0; heater < Heaters; heater++)
+		{
+			response->catf("%c%d", ch, heat->GetStatus(heater));
+			ch = ',';
+		}
+		response->cat((ch == '[') ? "[]" : "]");
+
+		// Named extra temperature sensors
+		response->cat(",\"extra\":[");
+		bool first = true;
+		for (size_t heater = FirstVirtualHeater; heater < FirstVirtualHeater + MaxVirtualHeaters; ++heater)
+		{
+			const char * const nm = heat->GetHeaterName(heater);
+			if (nm != nullptr)
+			{
+				if (!first)
+				{
+					response->cat(',');
+				}
+				first = false;
+				response->cat("{\"name\":");
+				response->EncodeString(nm, strlen(nm), false, true);
+				TemperatureError err;
+				const float t = heat->GetTemperature(heater, err);
+				response->catf(",\"temp\":%.1f}", (double)t);
+			}
+		}
+
+		response->cat("]}");
+	}
+
+	// Time since last reset
+	response->catf(",\"time\":%.1f", (double)(millis64()/1000u));
+
+	// Status change sequence number, confirming to the client that its state is still current
+	response->catf(",\"stateSeq\":%" PRIu32 ",\"diff\":1}", statusChangeSeq);
+
+	return response;
+}
+
+// Journal a machine state change so that external controllers can fetch deltas instead of diffing full responses.
+// This also bumps the status change sequence number, because anything worth journalling invalidates differential responses.
+void RepRap::RecordStateChange(ChangedField field, unsigned int index, float value)
+{
+	++stateJournalSeq;
+	StateChangeEntry& entry = stateJournal[stateJournalSeq % StateJournalSize];
+	entry.seq = stateJournalSeq;
+	entry.field = (uint8_t)field;
+	entry.index = (uint8_t)index;
+	entry.value = value;
+	StatusChanged();
+}
+
+// Return a JSON response listing journalled state changes after the given sequence number.
+// Each entry is reported as [sequence, field, index, value]. If the client is too far behind to catch up
+// from the journal (or passes a sequence number from before a reset), tell it to fetch a full status response.
+OutputBuffer *RepRap::GetJournalResponse(uint32_t since)
+{
+	OutputBuffer *response;
+	if (!OutputBuffer::Allocate(response))
+	{
+		// Should never happen
+		return nullptr;
+	}
+
+	response->printf("{\"seq\":%" PRIu32, stateJournalSeq);
+	if (since > stateJournalSeq || stateJournalSeq - since > StateJournalSize)
+	{
+		response->cat(",\"resync\":1,\"entries\":[]}");
+	}
+	else
+	{
+		response->cat(",\"resync\":0,\"entries\":[");
+		const uint32_t numEntries = stateJournalSeq - since;
+		for (uint32_t s = since + 1; s - since <= numEntries; ++s)
+		{
+			const StateChangeEntry& entry = stateJournal[s % StateJournalSize];
+			response->catf("%s[%" PRIu32 ",%u,%u,%.2f]", (s == since + 1) ? "" : ",", entry.seq, entry.field, entry.index, (double)entry.value);
+		}
+		response->cat("]}");
+	}
+	return response;
+}
+
+// Helper for building binary aux status frames (see GetBinaryStatusResponse). Values are appended
+// little-endian, and a running sum is kept so that the final checksum byte makes the whole frame
+// sum to zero modulo 256, which is what the panel verifies.
+class BinaryFrameWriter
+{
+public:
+	explicit BinaryFrameWriter(OutputBuffer *b) : buf(b), sum(0) { }
+
+	void PutU8(uint8_t v) { buf->cat((char)v); sum += v; }
+	void PutU16(uint16_t v) { PutU8((uint8_t)v); PutU8((uint8_t)(v >> 8)); }
+	void PutU32(uint32_t v) { PutU16((uint16_t)v); PutU16((uint16_t)(v >> 16)); }
+	void PutFloat(float v) { uint32_t u; memcpy(&u, &v, sizeof(u)); PutU32(u); }
+
+	// Append a temperature or similar value as a signed 16-bit count of tenths
+	void PutTenths(float v) { PutU16((uint16_t)(int16_t)lrintf(constrain<float>(v, -3276.0, 3276.0) * 10.0)); }
+
+	// Patch the length byte at the given offset and append the checksum. Must be the last call made.
+	void Finish(size_t lengthOffset)
+	{
+		const uint8_t len = (uint8_t)(buf->Length() - (lengthOffset + 1));
+		(*buf)[lengthOffset] = (char)len;
+		sum += len;
+		buf->cat((char)(uint8_t)(0u - sum));
+	}
+
+private:
+	OutputBuffer *buf;
+	uint8_t sum;
+};
+
+// Build a binary status frame for the aux channel, negotiated by M408 B1. A full frame carries the complete
+// machine state; a delta frame carries only the continuously-moving values plus the journalled state changes
+// after 'since', which is updated to the newest sequence number the frame covers so that the caller can pass
+// it back on the next call. If the panel has fallen too far behind for one frame to bridge the gap, a full
+// frame is sent instead of a delta - the frame type byte tells the panel which it got.
+// The frame is sync byte, frame type, payload length, payload, checksum, with all multi-byte values
+// little-endian. Short messages and message boxes are still pushed as JSON text between frames; the panel
+// tells them apart by the leading '{'.
+OutputBuffer *RepRap::GetBinaryStatusResponse(bool wantFull, uint32_t& since)
+{
+	// A delta frame can carry at most this many journal entries before it would overflow the length byte
+	static const uint32_t MaxJournalEntriesPerFrame = 24;
+
+	OutputBuffer *response;
+	if (!OutputBuffer::Allocate(response))
+	{
+		// Should never happen
+		return nullptr;
+	}
+
+	const bool full = wantFull || since > stateJournalSeq || stateJournalSeq - since > MaxJournalEntriesPerFrame;
+	BinaryFrameWriter writer(response);
+	writer.PutU8(BinaryStatusFrameSync);
+	writer.PutU8((full) ? BinaryStatusFrameFull : BinaryStatusFrameDelta);
+	writer.PutU8(0);										// payload length, patched by Finish
+	writer.PutU8(BinaryStatusProtocolVersion);
+	writer.PutU32(stateJournalSeq);
+
+	// Status character, with the same legacy mapping that the JSON response uses
+	char ch = GetStatusCharacter();
+	if (ch == 'S')			// if paused then send 'A'
+	{
+		ch = 'A';
+	}
+	else if (ch == 'H')		// if halted then send 'S'
+	{
+		ch = 'S';
+	}
+	writer.PutU8((uint8_t)ch);
+
+	// Heater temperatures. As in the JSON response, the bed occupies slot 0 even if there is no bed heater.
+	const int8_t bedHeater = (NumBedHeaters > 0) ? heat->GetBedHeater(0) : -1;
+	const size_t toolHeaterLimit = GetToolHeatersInUse();
+	const size_t numHeaterSlots = 1 + ((toolHeaterLimit > DefaultE0Heater) ? toolHeaterLimit - DefaultE0Heater : 0);
+	writer.PutU8((uint8_t)numHeaterSlots);
+	for (size_t slot = 0; slot < numHeaterSlots; ++slot)
+	{
+		const int h = (slot == 0) ? (int)bedHeater : (int)(DefaultE0Heater + slot - 1);
+		writer.PutTenths((h < 0) ? 0.0 : heat->GetTemperature(h));
+		if (full)
+		{
+			writer.PutTenths((h < 0) ? 0.0 : heat->GetActiveTemperature(h));
+			writer.PutTenths((h < 0) ? 0.0 : heat->GetStandbyTemperature(h));
+			writer.PutU8((h < 0) ? 0 : (uint8_t)static_cast<int>(heat->GetStatus(h)));
+		}
+	}
+
+	// Axis positions in user coordinates, plus the homed flags, which are not journalled and so go in every frame
+	const size_t numAxes = gCodes->GetVisibleAxes();
+	float liveCoordinates[DRIVES];
+	move->LiveCoordinates(liveCoordinates, GetCurrentXAxes(), GetCurrentYAxes());
+	if (currentTool != nullptr)
+	{
+		for (size_t i = 0; i < numAxes; ++i)
+		{
+			liveCoordinates[i] += currentTool->GetOffset(i);
+		}
+	}
+	writer.PutU8((uint8_t)numAxes);
+	uint16_t homed = 0;
+	for (size_t axis = 0; axis < numAxes; ++axis)
+	{
+		writer.PutFloat(liveCoordinates[axis]);
+		if (gCodes->GetAxisIsHomed(axis))
+		{
+			homed |= 1u << axis;
+		}
+	}
+	writer.PutU16(homed);
+
+	// The remaining continuously-moving values
+	writer.PutU16((uint16_t)constrain<int>(platform->GetZProbeReading(), 0, 65535));
+	writer.PutU16((uint16_t)lrintf(constrain<float>((printMonitor->IsPrinting()) ? gCodes->FractionOfFilePrinted() : 0.0, 0.0, 1.0) * 10000.0));
+	writer.PutU16((uint16_t)constrain<float>(platform->GetFanRPM(), 0.0, 65535.0));
+
+	if (full)
+	{
+		// The journalled state, sent in full so that the panel has a complete baseline for subsequent deltas
+		writer.PutU8((uint8_t)(int8_t)GetCurrentToolNumber());
+		writer.PutTenths(gCodes->GetSpeedFactor() * 100.0);
+		const size_t numExtruders = GetExtrudersInUse();
+		writer.PutU8((uint8_t)numExtruders);
+		for (size_t i = 0; i < numExtruders; ++i)
+		{
+			writer.PutTenths(gCodes->GetExtrusionFactor(i) * 100.0);
+		}
+		writer.PutFloat(gCodes->GetBabyStepOffset());
+		writer.PutU8((uint8_t)NUM_FANS);
+		for (size_t i = 0; i < NUM_FANS; ++i)
+		{
+			writer.PutU8((uint8_t)lrintf(constrain<float>(platform->GetFanValue(i), 0.0, 1.0) * 100.0));
+		}
+	}
+	else
+	{
+		// The journalled changes the panel has not seen yet, as (field, index, value) records
+		const uint32_t numEntries = stateJournalSeq - since;
+		writer.PutU8((uint8_t)numEntries);
+		for (uint32_t s = since + 1; s - since <= numEntries; ++s)
+		{
+			const StateChangeEntry& entry = stateJournal[s % StateJournalSize];
+			writer.PutU8(entry.field);
+			writer.PutU8(entry.index);
+			writer.PutFloat(entry.value);
+		}
+	}
+
+	writer.Finish(2);
+	since = stateJournalSeq;
 	return response;
 }
 
@@ -1592,6 +2482,7 @@ void RepRap::Beep(int freq, int ms)
 {
 	beepFrequency = freq;
 	beepDuration = ms;
+	InvalidateStatusResponseCache();
 
 	if (platform->HaveAux())
 	{
@@ -1604,6 +2495,7 @@ void RepRap::Beep(int freq, int ms)
 void RepRap::SetMessage(const char *msg)
 {
 	SafeStrncpy(message, msg, ARRAY_SIZE(message));
+	InvalidateStatusResponseCache();
 
 	if (platform->HaveAux())
 	{
@@ -1622,12 +2514,14 @@ void RepRap::SetAlert(const char *msg, const char *title, int mode, float timeou
 	boxControls = controls;
 	displayMessageBox = true;
 	++boxSeq;
+	InvalidateStatusResponseCache();
 }
 
 // Clear pending message box
 void RepRap::ClearAlert()
 {
 	displayMessageBox = false;
+	InvalidateStatusResponseCache();
 }
 
 // Get the status character for the new-style status response
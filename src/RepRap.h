@@ -31,6 +31,25 @@ enum class ResponseSource
 	Generic
 };
 
+// Identifies the piece of machine state that a change journal entry refers to.
+// These values form part of the external interface, so do not renumber existing ones.
+enum class ChangedField : uint8_t
+{
+	heaterActiveTemp = 0,		// index = heater number, value = temperature in degC
+	heaterStandbyTemp = 1,		// index = heater number, value = temperature in degC
+	fanValue = 2,				// index = fan number, value = PWM in the range 0 to 1
+	speedFactor = 3,			// value = speed factor in per cent
+	extrusionFactor = 4,		// index = extruder number, value = factor in per cent
+	currentTool = 5				// value = tool number, or -1 if no tool is selected
+};
+
+// Framing constants for the binary aux status protocol, negotiated by M408 B1. The sync byte must not occur
+// as the first character of any text or JSON response, so that Platform can route frames to the UART unmodified.
+constexpr uint8_t BinaryStatusFrameSync = 0xF5;
+constexpr uint8_t BinaryStatusFrameFull = 0x01;
+constexpr uint8_t BinaryStatusFrameDelta = 0x02;
+constexpr uint8_t BinaryStatusProtocolVersion = 1;
+
 class RepRap
 {
 public:
@@ -41,6 +60,8 @@ public:
 	void Exit();
 	void Diagnostics(MessageType mtype);
 	void Timing(MessageType mtype);
+	void SetSpinBudget(uint32_t budgetMillis);			// set the per-call Spin time budget of the soft watchdog (M122 S parameter)
+	void SetSpinOverrunDeferral(bool defer) { deferOverrunningModules = defer; }	// whether an overrunning rotated module forfeits its next turn
 
 	bool Debug(Module module) const;
 	void SetDebug(Module m, bool enable);
@@ -58,6 +79,8 @@ public:
 	void DeleteTool(Tool* t);
 	void SelectTool(int toolNumber, bool simulating);
 	void StandbyTool(int toolNumber, bool simulating);
+	void PreheatTool(int toolNumber);					// start a tool's heaters ramping up ahead of a tool change
+	void CheckToolReheat();								// per-interval tool housekeeping: predictive reheat, usage accounting, extrusion gate refresh
 	Tool* GetCurrentTool() const;
 	int GetCurrentToolNumber() const;
 	Tool* GetTool(int toolNumber) const;
@@ -87,6 +110,13 @@ public:
  	PortControl& GetPortControl() const;
 #endif
 
+	// Background task support. A task is called once per Spin() iteration and must return when the step timer
+	// passes the deadline passed to it; it returns true when the whole operation is complete. This lets long
+	// operations run to completion without any single Spin() call exceeding the time budget.
+	typedef bool (*BackgroundTaskFunc)(void *param, uint32_t deadline);
+	bool ScheduleBackgroundTask(BackgroundTaskFunc func, void *param);	// schedule a task, returning false if another one is still running
+	bool IsBackgroundTaskRunning() const { return backgroundTask != nullptr; }
+
 	void Tick();
 	bool SpinTimeoutImminent() const;
 	bool IsStopped() const;
@@ -94,7 +124,13 @@ public:
 	uint16_t GetExtrudersInUse() const;
 	uint16_t GetToolHeatersInUse() const;
 
-	OutputBuffer *GetStatusResponse(uint8_t type, ResponseSource source);
+	OutputBuffer *GetStatusResponse(uint8_t type, ResponseSource source, uint32_t clientSeq = 0);
+	void InvalidateStatusResponseCache() { statusResponseCacheLength = 0; }	// Call when status changes that must be reported promptly
+	uint32_t GetStatusChangeSeq() const { return statusChangeSeq; }
+	void StatusChanged() { ++statusChangeSeq; InvalidateStatusResponseCache(); }	// Call when state other than positions and current temperatures changes
+	void RecordStateChange(ChangedField field, unsigned int index, float value);	// Journal a state change; also implies StatusChanged
+	OutputBuffer *GetJournalResponse(uint32_t since);	// Report journalled state changes after the given sequence number
+	OutputBuffer *GetBinaryStatusResponse(bool wantFull, uint32_t& since);	// Build a binary status frame for the aux channel
 	OutputBuffer *GetConfigResponse();
 	OutputBuffer *GetLegacyStatusResponse(uint8_t type, int seq);
 	OutputBuffer *GetFilesResponse(const char* dir, bool flagsDirs);
@@ -117,6 +153,7 @@ private:
 	static void EncodeString(StringRef& response, const char* src, size_t spaceToLeave, bool allowControlChars = false, char prefix = 0);
 
 	char GetStatusCharacter() const;
+	OutputBuffer *GetDifferentialStatusResponse(ResponseSource source);	// render the short status response containing only the continuously-moving values
 
 	static constexpr uint32_t MaxTicksInSpinState = 20000;	// timeout before we reset the processor
 	static constexpr uint32_t HighTicksInSpinState = 16000;	// how long before we warn that timeout is approaching
@@ -134,18 +171,47 @@ private:
  	PortControl *portControl;
 #endif
 
+	void LoadToolStats(Tool *tool);				// Load the persisted usage statistics for a newly added tool
+	void SaveToolStats();						// Save the lifetime tool usage statistics if they have changed
+
 	Tool* toolList;								// the tool list is sorted in order of increasing tool number
 	Tool* currentTool;
 	uint32_t lastWarningMillis;					// When we last sent a warning message for things that can happen very often
+	uint32_t lastToolStatsSaveTime;				// when we last saved the tool usage statistics
+	uint32_t lastFullNetworkPollTime;			// when we last gave the network module a full poll while idle
 
 	uint16_t activeExtruders;
 	uint16_t activeToolHeaters;
 
+	void RecordSpinTime(Module module, uint32_t startClocks);	// Add the elapsed time to the spin time accounts of a module
+
 	uint16_t ticksInSpinState;
 	Module spinningModule;
 	uint32_t fastLoop, slowLoop;
 	uint32_t lastTime;
 
+	// Per-module spin time accounting, reported by Timing() under M122. Times are in step interrupt clocks.
+	uint32_t moduleSpinMaxClocks[numModules];	// the longest single Spin() call of each module since the last report
+	uint64_t moduleSpinTotalClocks[numModules];	// the total time each module has spent in its Spin() call since the last report
+	uint32_t spinAccountingLoops;				// how many main loop iterations the totals cover
+
+	// Soft spin watchdog. Calls that exceed the budget are counted per module; unlike the averages above, the
+	// counters are not reset by the report, so chronic offenders accumulate. Optionally an overrunning rotated
+	// module forfeits its next turn, so one misbehaving module cannot degrade motion on successive iterations.
+	uint32_t spinBudgetClocks;					// the per-call Spin() time budget (M122 S parameter)
+	bool deferOverrunningModules;				// whether a rotated module that overruns forfeits its next turn (M122 D parameter)
+	uint32_t moduleSpinOverruns[numModules];	// how many times each module has exceeded the budget
+	uint32_t moduleSpinWorstClocks[numModules];	// the worst overrunning call of each module
+	uint32_t deferredModules;					// bitmap of rotated modules that forfeit their next turn
+
+	BackgroundTaskFunc backgroundTask;			// the background task to call from Spin(), or nullptr
+	void *backgroundTaskParam;					// the parameter to pass to it
+
+	// Scheduling of the low-priority modules, which take turns in Spin() under a time budget
+	size_t nextRotatedModule;					// which of the rotated modules gets the next turn
+	uint32_t lastRotatedRunTime[numModules];	// when each rotated module last got a turn
+	uint32_t maxRotatedWaitTime[numModules];	// the longest each rotated module has waited between turns since the last report
+
 	uint32_t debug;
 	bool stopped;
 	bool active;
@@ -158,6 +224,34 @@ private:
 	int beepFrequency, beepDuration;
 	char message[MESSAGE_LENGTH + 1];
 
+	// Sequence number bumped whenever machine state other than the continuously-moving values (positions,
+	// current temperatures, probe readings) changes. A status poll that passes back the last value it saw
+	// gets a short differential response when the sequence is unchanged.
+	uint32_t statusChangeSeq;
+
+	// Cached status response. When several DWC dashboards poll the same machine, we serve them all from one
+	// recently rendered response instead of formatting the same data again for each of them.
+	char *statusResponseCache;					// holds the last rendered HTTP status response, allocated when first needed
+	size_t statusResponseCacheLength;			// how many bytes of the cache are valid, 0 = cache invalid
+	uint32_t statusResponseCacheTime;			// when the cached response was rendered
+	uint32_t statusResponseCacheSeq;			// the HTTP reply sequence number embedded in the cached response
+	uint8_t statusResponseCacheType;			// which status response type the cache holds
+
+	// Change journal, so that external controllers can fetch state deltas instead of diffing full status responses.
+	// Entries are written from the main loop only, so no locking is needed.
+	static const size_t StateJournalSize = 64;	// how many recent state changes we remember
+
+	struct StateChangeEntry
+	{
+		uint32_t seq;							// the sequence number assigned to this change
+		uint8_t field;							// which piece of state changed (a ChangedField value)
+		uint8_t index;							// which heater/fan/extruder etc. it refers to
+		float value;							// the new value
+	};
+
+	StateChangeEntry stateJournal[StateJournalSize];
+	uint32_t stateJournalSeq;					// sequence number of the newest journal entry, 0 = journal empty
+
 	// Message box data
 	bool displayMessageBox;
 	char boxMessage[MESSAGE_LENGTH + 1], boxTitle[MESSAGE_LENGTH + 1];
@@ -81,9 +81,11 @@ class OutputBuffer;
 class OutputStack;
 class GCodeBuffer;
 class GCodeQueue;
+class JobQueue;
 class FilamentSensor;
 class RandomProbePointSet;
 class Logger;
+class Telemetry;
 
 #if SUPPORT_IOBITS
 class PortControl;
@@ -181,6 +183,22 @@ template<typename BitmapType> inline void ClearBit(BitmapType &b, unsigned int n
 	b &= ~((BitmapType)1u << n);
 }
 
+// Return the index of the lowest set bit in a bitmap. The bitmap must not be empty.
+template<typename BitmapType> inline unsigned int LowestSetBit(BitmapType b)
+{
+	return (unsigned int)__builtin_ctz(b);
+}
+
+// Clear the lowest set bit in a bitmap and return its index. The bitmap must not be empty.
+// This allows a loop over the members of a bitmap to take time proportional to the number of bits set
+// instead of the width of the bitmap.
+template<typename BitmapType> inline unsigned int TakeLowestSetBit(BitmapType& b)
+{
+	const unsigned int n = LowestSetBit(b);
+	b &= b - 1;
+	return n;
+}
+
 // Convert an array of longs to a bit map with overflow checking
 template<typename BitmapType> BitmapType UnsignedArrayToBitMap(const uint32_t *arr, size_t numEntries)
 {
@@ -225,15 +243,24 @@ typedef uint32_t FilePosition;
 const FilePosition noFilePosition = 0xFFFFFFFF;
 
 // Interrupt priorities - must be chosen with care! 0 is the highest priority, 15 is the lowest.
+// The architecture is:
+// - Interrupts that lose data outright if they are not serviced at once (watchdog, single-character UARTs) come first.
+// - The step timer comes next, above everything that can afford to wait, so that no other interrupt adds jitter to
+//   step pulse timing. M122 reports the worst observed step interrupt lateness so that this can be verified.
+// - The tick (watchdog kick, ADC) and pin change interrupts sit just below; the step ISR delays them by at most a
+//   few tens of microseconds, which they tolerate.
+// - Network, USB and the SPI used for network transfers are lowest, because they are buffered and flow controlled.
+// Platform::AuditInterruptPriorities checks the live NVIC settings against these values at boot and in M122,
+// so that library code quietly reprogramming a priority does not go unnoticed.
 #if SAM4E || SAME70
 const uint32_t NvicPriorityWatchdog = 0;		// the secondary watchdog has the highest priority
 #endif
 
 const uint32_t NvicPriorityPanelDueUart = 1;	// UART is highest to avoid character loss (it has only a 1-character receive buffer)
 const uint32_t NvicPriorityDriversSerialTMC = 2;// USART or UART used to control and monitor the smart drivers
-const uint32_t NvicPrioritySystick = 3;			// systick kicks the watchdog and starts the ADC conversions, so must be quite high
-const uint32_t NvicPriorityPins = 4;			// priority for GPIO pin interrupts - filament sensors must be higher than step
-const uint32_t NvicPriorityStep = 5;			// step interrupt is next highest, it can preempt most other interrupts
+const uint32_t NvicPriorityStep = 3;			// step interrupt is time-critical, nothing below may delay it
+const uint32_t NvicPrioritySystick = 4;			// systick kicks the watchdog and starts the ADC conversions
+const uint32_t NvicPriorityPins = 5;			// priority for GPIO pin interrupts; filament sensor edges are delayed only by the bounded step ISR
 const uint32_t NvicPriorityWiFiUart = 6;		// UART used to receive debug data from the WiFi module
 const uint32_t NvicPriorityUSB = 6;				// USB interrupt
 
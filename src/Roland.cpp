@@ -19,6 +19,11 @@ void Roland::Init()
 	sBuffer = new StringRef(buffer, ARRAY_SIZE(buffer));
 	sBuffer->Clear();
 
+	for(size_t slot = 0; slot < ROLAND_RING_SIZE; slot++)
+	{
+		ring[slot][0] = 0;
+	}
+	ringHead = ringTail = 0;
 	bufferPointer = 0;
 	Zero(true);
 	longWait = platform.Time();
@@ -39,37 +44,51 @@ void Roland::Spin()
 	//SERIAL_AUX2_DEVICE.flush();
 	//return;
 
-	// Are we sending something to the Roland?
+	// Convert more queued G-codes into ML batches while the earlier batches are still draining,
+	// so that conversion and transmission overlap instead of alternating
 
-	if (Busy())	// Busy means we are sending something
+	while (!RingFull())
 	{
-		if (digitalRead(ROLAND_CTS_PIN))
+		EndstopChecks endStopsToCheck;
+		uint8_t moveType;
+		FilePosition filePos;
+		if (!reprap.GetGCodes()->ReadMove(move, endStopsToCheck, moveType, filePos))
 		{
-			platform.ClassReport(longWait);
-			return;
+			break;
 		}
-
-		SERIAL_AUX2_DEVICE.write(buffer[bufferPointer]);
-		SERIAL_AUX2_DEVICE.flush();
-		bufferPointer++;
+		move[AXES] = move[DRIVES]; // Roland doesn't have extruders etc.
+		ProcessMove();
+		QueueCommand();
 	}
-	else		// Not sending.
-	{	
-		// Finished talking to the Roland
-
-		sBuffer->Clear();
-		bufferPointer = 0;
 
-		// Anything new to do?
+	// Feed the mill from the head of the ring, subject to hardware flow control.
+	// Bound the number of bytes sent so that we don't spend too long here in one call.
 
-		EndstopChecks endStopsToCheck;
-		uint8_t moveType;
-		FilePosition filePos;
-		if (reprap.GetGCodes()->ReadMove(move, endStopsToCheck, moveType, filePos))
+	if (Busy())
+	{
+		size_t bytesSent = 0;
+		while (bytesSent < ROLAND_BUFFER_SIZE && !digitalRead(ROLAND_CTS_PIN))
 		{
-			move[AXES] = move[DRIVES]; // Roland doesn't have extruders etc.
-			ProcessMove();
+			const char c = ring[ringHead][bufferPointer];
+			if (c == 0)
+			{
+				// Finished this batch, move on to the next one
+				ring[ringHead][0] = 0;
+				ringHead = (ringHead + 1) % ROLAND_RING_SIZE;
+				bufferPointer = 0;
+				if (!Busy())
+				{
+					break;
+				}
+			}
+			else
+			{
+				SERIAL_AUX2_DEVICE.write(c);
+				bufferPointer++;
+				bytesSent++;
+			}
 		}
+		SERIAL_AUX2_DEVICE.flush();
 	}
 
 	platform.ClassReport(longWait);
@@ -92,19 +111,33 @@ void Roland::Zero(bool feed)
 	}
 }
 
+// Busy means we still have converted batches waiting to be sent
 bool Roland::Busy()
 {
-	return buffer[bufferPointer] != 0;
+	return ringHead != ringTail;
+}
+
+bool Roland::RingFull()
+{
+	return (ringTail + 1) % ROLAND_RING_SIZE == ringHead;
+}
+
+// Copy the command just composed in the scratch buffer into the next free ring slot
+void Roland::QueueCommand()
+{
+	SafeStrncpy(ring[ringTail], buffer, ROLAND_BUFFER_SIZE);
+	ringTail = (ringTail + 1) % ROLAND_RING_SIZE;
 }
 
 bool Roland::ProcessHome()
 {
-	if (Busy())
+	if (RingFull())
 	{
 		return false;
 	}
 
 	sBuffer->copy("H;\n");
+	QueueCommand();
 	Zero(false);
 	if (reprap.Debug(moduleGcodes))
 	{
@@ -115,7 +148,7 @@ bool Roland::ProcessHome()
 
 bool Roland::ProcessDwell(long milliseconds)
 {
-	if (Busy())
+	if (RingFull())
 	{
 		return false;
 	}
@@ -123,6 +156,7 @@ bool Roland::ProcessDwell(long milliseconds)
 	sBuffer->printf("W%ld;", milliseconds);
 	sBuffer->catf("Z %.4f,%.4f,%.4f;", oldCoordinates[0], oldCoordinates[1], oldCoordinates[2]);
 	sBuffer->cat("W0;\n");
+	QueueCommand();
 	if (reprap.Debug(moduleGcodes))
 	{
 		platform.MessageF(HOST_MESSAGE, "Roland dwell: %s", buffer);
@@ -150,7 +184,7 @@ bool Roland::ProcessG92(float v, size_t axis)
 
 bool Roland::ProcessSpindle(float rpm)
 {
-	if (Busy())
+	if (RingFull())
 	{
 		return false;
 	}
@@ -163,6 +197,7 @@ bool Roland::ProcessSpindle(float rpm)
 	{
 		sBuffer->printf("!RC%ld;!MC 1;\n", (long)(rpm + 100.0));
 	}
+	QueueCommand();
 
 	if (reprap.Debug(moduleGcodes))
 	{
@@ -217,13 +252,14 @@ void Roland::ProcessMove()
 
 bool Roland::RawWrite(const char* s)
 {
-	if (Busy())
+	if (RingFull())
 	{
 		return false;
 	}
 
 	sBuffer->copy(s);
 	sBuffer->cat("\n");
+	QueueCommand();
 
 	if (reprap.Debug(moduleGcodes))
 	{
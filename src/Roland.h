@@ -32,6 +32,7 @@ Licence: GPL
 
 const float ROLAND_FACTOR = (1.016088061*100.0/2.54);	// Roland units are 0.001"
 const size_t ROLAND_BUFFER_SIZE = 50;
+const size_t ROLAND_RING_SIZE = 4;		// how many converted command batches we buffer ahead of transmission
 
 class Roland
 {
@@ -53,6 +54,8 @@ class Roland
 		void ProcessMove();
 		void Zero(bool feed);
 		bool Busy();
+		bool RingFull();
+		void QueueCommand();
 
 		Platform& platform;
 		float longWait;
@@ -61,8 +64,10 @@ class Roland
 		float coordinates[AXES+1];
 		float oldCoordinates[AXES+1];
 		float offset[AXES+1];
-		char buffer[ROLAND_BUFFER_SIZE];
-		int bufferPointer;
+		char buffer[ROLAND_BUFFER_SIZE];					// scratch buffer in which commands are composed
+		char ring[ROLAND_RING_SIZE][ROLAND_BUFFER_SIZE];	// converted batches waiting to be transmitted
+		size_t ringHead, ringTail;							// ringHead is the batch being sent, ringTail the next free slot
+		int bufferPointer;									// how far through the head batch transmission has got
 		StringRef *sBuffer;
 		bool active;
 };
@@ -168,24 +168,30 @@ void Scanner::Spin()
 			break;
 
 		case ScannerState::Uploading:
-			// Write incoming scan data from USB to the file
-			while (SERIAL_MAIN_DEVICE.available() > 0)
+			// Write incoming scan data from USB to the file. Read the data in chunks so that we can pass
+			// whole blocks to the file write buffer instead of making one Write call per byte
+			while (uploadBytesLeft != 0 && SERIAL_MAIN_DEVICE.available() > 0)
 			{
-				char b = static_cast<char>(SERIAL_MAIN_DEVICE.read());
-				if (fileBeingUploaded->Write(&b, sizeof(char)))
+				size_t bytesToRead = (size_t)SERIAL_MAIN_DEVICE.available();
+				if (bytesToRead > ScanBufferSize)
+				{
+					bytesToRead = ScanBufferSize;
+				}
+				if (bytesToRead > uploadBytesLeft)
+				{
+					bytesToRead = uploadBytesLeft;
+				}
+				for (size_t i = 0; i < bytesToRead; i++)
+				{
+					buffer[i] = static_cast<char>(SERIAL_MAIN_DEVICE.read());
+				}
+
+				if (fileBeingUploaded->Write(buffer, bytesToRead))
 				{
-					uploadBytesLeft--;
+					uploadBytesLeft -= bytesToRead;
 					if (uploadBytesLeft == 0)
 					{
-						if (reprap.Debug(moduleScanner))
-						{
-							platform.MessageF(HttpMessage, "Finished uploading %u bytes of scan data\n", uploadSize);
-						}
-
-						fileBeingUploaded->Close();
-						fileBeingUploaded = nullptr;
-
-						SetState(ScannerState::Idle);
+						FinishUpload();
 						break;
 					}
 				}
@@ -284,17 +290,44 @@ void Scanner::ProcessCommand()
 
 		if (uploadFilename != nullptr)
 		{
-			uploadBytesLeft = uploadSize;
-			fileBeingUploaded = platform.OpenFile(SCANS_DIRECTORY, uploadFilename, OpenMode::write);
-			if (fileBeingUploaded != nullptr)
+			verifyUploadCrc = false;
+			StartUpload();
+		}
+		else
+		{
+			platform.Message(ErrorMessage, "Malformed scanner upload request\n");
+		}
+	}
+
+	// Upload request with CRC check: UPLOAD_CRC <SIZE> <CRC32-IN-HEX> <FILENAME>
+	else if (StringStartsWith(buffer, "UPLOAD_CRC "))
+	{
+		uploadSize = atoi(&buffer[11]);
+		uploadFilename = nullptr;
+		size_t i = 12;
+		while (i < bufferPointer - 1 && buffer[i] != ' ')
+		{
+			// Skip the size field
+			i++;
+		}
+		if (i < bufferPointer - 1)
+		{
+			expectedUploadCrc = strtoul(&buffer[i + 1], nullptr, 16);
+			for (i++; i < bufferPointer - 1; i++)
 			{
-				SetState(ScannerState::Uploading);
-				if (reprap.Debug(moduleScanner))
+				if (buffer[i] == ' ')
 				{
-					platform.MessageF(HttpMessage, "Starting scan upload for file %s (%u bytes total)\n", uploadFilename, uploadSize);
+					uploadFilename = &buffer[i+1];
+					break;
 				}
 			}
 		}
+
+		if (uploadFilename != nullptr)
+		{
+			verifyUploadCrc = true;
+			StartUpload();
+		}
 		else
 		{
 			platform.Message(ErrorMessage, "Malformed scanner upload request\n");
@@ -337,6 +370,42 @@ void Scanner::ProcessCommand()
 	}
 }
 
+// Open the upload file and get ready to receive binary scan data
+void Scanner::StartUpload()
+{
+	uploadBytesLeft = uploadSize;
+	fileBeingUploaded = platform.OpenFile(SCANS_DIRECTORY, uploadFilename, OpenMode::write);
+	if (fileBeingUploaded != nullptr)
+	{
+		SetState(ScannerState::Uploading);
+		if (reprap.Debug(moduleScanner))
+		{
+			platform.MessageF(HttpMessage, "Starting scan upload for file %s (%u bytes total)\n", uploadFilename, uploadSize);
+		}
+	}
+}
+
+// Complete the current upload, verifying the CRC of the received data if one was supplied
+void Scanner::FinishUpload()
+{
+	// Close flushes the remaining write buffers, so the CRC of the file is complete only after closing
+	fileBeingUploaded->Close();
+	const uint32_t actualCrc = fileBeingUploaded->GetCRC32();
+	fileBeingUploaded = nullptr;
+
+	if (verifyUploadCrc && actualCrc != expectedUploadCrc)
+	{
+		platform.GetMassStorage()->Delete(SCANS_DIRECTORY, uploadFilename);
+		platform.MessageF(ErrorMessage, "Scan upload failed CRC check (expected %08" PRIx32 ", got %08" PRIx32 ")\n", expectedUploadCrc, actualCrc);
+	}
+	else if (reprap.Debug(moduleScanner))
+	{
+		platform.MessageF(HttpMessage, "Finished uploading %u bytes of scan data\n", uploadSize);
+	}
+
+	SetState(ScannerState::Idle);
+}
+
 // Enable the scanner extensions
 bool Scanner::Enable()
 {
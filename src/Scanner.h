@@ -69,6 +69,8 @@ private:
 
 	void SetState(const ScannerState s);
 	void ProcessCommand();
+	void StartUpload();
+	void FinishUpload();
 
 	bool IsDoingFileMacro() const;
 	void DoFileMacro(const char *filename);
@@ -90,6 +92,8 @@ private:
 
 	const char *uploadFilename;
 	size_t uploadSize, uploadBytesLeft;
+	uint32_t expectedUploadCrc;
+	bool verifyUploadCrc;
 	FileStore *fileBeingUploaded;
 };
 
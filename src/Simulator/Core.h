@@ -0,0 +1,91 @@
+/*
+ * Core.h - simulator stub
+ *
+ * On target builds this header comes from CoreNG and declares the processor, pin I/O and utility
+ * functions. The host simulator build replaces it with just enough to compile the motion planner
+ * sources unmodified. Time is simulated: SimulatedTime holds the current time in step interrupt
+ * clocks (see DDA::stepClockRate) and is advanced by the simulator driver, never by real time.
+ */
+
+#ifndef CORE_H
+#define CORE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cinttypes>
+#include <cmath>
+#include <cstring>
+#include <cstdarg>
+#include <ctime>			// Grid.cpp uses gmtime; on target this comes in via the toolchain headers
+
+// We simulate the SAM4E build configuration (hardware FPU class processors), so that the planner
+// runs with the same ring sizes, S-curve support and float precision as a Duet WiFi/Ethernet.
+#define SAM3XA	0
+#define SAM4E	1
+#define SAM4S	0
+#define SAME70	0
+
+#define VARIANT_MCK		120000000		// the SAM4E master clock frequency, which sets DDA::stepClockRate
+
+// Pin I/O - the simulator records nothing at this level, the stub Platform does
+typedef uint8_t Pin;
+constexpr Pin NoPin = 0xFF;
+
+enum PinMode : uint8_t
+{
+	INPUT = 0,
+	INPUT_PULLUP,
+	INPUT_PULLDOWN,
+	OUTPUT_LOW,
+	OUTPUT_HIGH,
+	AIN,
+	SPECIAL,
+	OUTPUT_PWM_LOW,
+	OUTPUT_PWM_HIGH,
+	OUTPUT_SERVO_LOW,
+	OUTPUT_SERVO_HIGH
+};
+
+struct Pio;							// opaque; only ever used as a pointer by code we compile
+
+inline void pinMode(Pin, PinMode) { }
+inline void digitalWrite(Pin, bool) { }
+inline bool digitalRead(Pin) { return false; }
+
+// Interrupt control - the simulator is single threaded, so these are no-ops
+typedef uint32_t irqflags_t;
+inline irqflags_t cpu_irq_save() { return 0; }
+inline void cpu_irq_restore(irqflags_t) { }
+inline void cpu_irq_disable() { }
+inline void cpu_irq_enable() { }
+inline void __DMB() { }
+
+// Simulated time, in step clocks. The driver advances this; everything else just reads it.
+extern uint64_t SimulatedTime;
+
+uint32_t millis();
+uint64_t millis64();
+uint32_t micros();
+inline void delay(uint32_t ms) { SimulatedTime += (uint64_t)ms * (VARIANT_MCK/128000u); }
+inline void delayMicroseconds(uint32_t us) { SimulatedTime += ((uint64_t)us * (VARIANT_MCK/128000u))/1000u; }
+
+// Maths utilities normally provided by CoreNG
+#ifndef PI
+# define PI 3.1415926535897932384626433832795f
+#endif
+
+template<class T> inline constexpr T min(T a, T b) { return (a < b) ? a : b; }
+template<class T> inline constexpr T max(T a, T b) { return (a > b) ? a : b; }
+template<class T> inline constexpr T constrain(T v, T vMin, T vMax) { return (v < vMin) ? vMin : (v > vMax) ? vMax : v; }
+
+inline constexpr float fsquare(float a) { return a * a; }
+inline constexpr double dsquare(double a) { return a * a; }
+inline constexpr uint64_t isquare64(int32_t a) { return (uint64_t)((int64_t)a * a); }	// as in CoreNG: the argument is signed, because the delta step calculation squares negative values
+
+#define ARRAY_SIZE(_x)	(sizeof(_x)/sizeof((_x)[0]))
+#define ARRAY_UPB(_x)	(ARRAY_SIZE(_x) - 1)
+
+// Formatted output support; SafeVsnprintf is defined in Libraries/General/StringRef.cpp
+int SafeVsnprintf(char *buf, size_t maxLen, const char *fmt, va_list vargs);
+
+#endif
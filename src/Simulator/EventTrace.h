@@ -0,0 +1,28 @@
+/*
+ * EventTrace.h - simulator stub
+ *
+ * The firmware flight recorder is not useful on the host, so recording events is a no-op here.
+ */
+
+#ifndef SRC_EVENTTRACE_H_
+#define SRC_EVENTTRACE_H_
+
+#include "RepRapFirmware.h"
+
+class EventTrace
+{
+public:
+	enum class EventType : uint8_t
+	{
+		none = 0,
+		gcode,
+		ddaStart,
+		networkState,
+		spinOutlier,
+		powerFail
+	};
+
+	static void Record(EventType et, uint8_t a = 0, uint16_t b = 0) { (void)et; (void)a; (void)b; }
+};
+
+#endif
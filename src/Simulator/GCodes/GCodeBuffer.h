@@ -0,0 +1,26 @@
+/*
+ * GCodes/GCodeBuffer.h - simulator stub
+ *
+ * The kinematics classes take a GCodeBuffer in their Configure methods (M665/M666/M669). The
+ * simulator never feeds them G-code, so this stub just reports that no parameter is present,
+ * leaving every kinematics with its default configuration.
+ */
+
+#ifndef GCODEBUFFER_H
+#define GCODEBUFFER_H
+
+#include "RepRapFirmware.h"
+#include "Libraries/General/StringRef.h"
+
+class GCodeBuffer
+{
+public:
+	bool Seen(char c) { (void)c; return false; }
+	float GetFValue() { return 0.0; }
+	const void GetFloatArray(float arr[], size_t& length, bool doPad) { (void)arr; (void)doPad; length = 0; }
+	void TryGetFValue(char c, float& val, bool& seen) { (void)c; (void)val; seen = false; }
+	bool TryGetFloatArray(char c, size_t numVals, float vals[], const StringRef& reply, bool& seen, bool doPad = false)
+		{ (void)c; (void)numVals; (void)vals; (void)reply; (void)doPad; seen = false; return false; }
+};
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * GCodes/GCodes.h - simulator stub
+ *
+ * Replacement for the real GCodes class when building the host motion simulator. It keeps the
+ * RawMove definition and the query methods that Move and DDA call, and feeds moves to Move::Spin
+ * from a queue that the simulator driver fills instead of from interpreted G-code.
+ */
+
+#ifndef GCODES_H
+#define GCODES_H
+
+#include "RepRapFirmware.h"
+#include "Platform.h"			// the real GCodes.h includes this too, and the motion sources rely on getting it from here
+#include "GCodes/GCodeBuffer.h"	// likewise, for the kinematics Configure methods
+
+typedef AxesBitmap EndstopChecks;						// must be large enough to hold a bitmap of drive numbers or ZProbeActive
+const EndstopChecks ZProbeActive = 1 << 31;				// must be distinct from 1 << (any drive number)
+const EndstopChecks HomeAxes = 1 << 30;					// must be distinct from 1 << (any drive number)
+const EndstopChecks LogProbeChanges = 1 << 29;			// must be distinct from 1 << (any drive number)
+const EndstopChecks UseSpecialEndstop = 1 << 28;		// must be distinct from 1 << (any drive number)
+
+class GCodes
+{
+public:
+	// This struct must match the one in the real GCodes.h, because DDA::Init reads all of it
+	struct RawMove
+	{
+		float coords[DRIVES];											// new positions for the axes, amount of movement for the extruders
+		float initialCoords[MaxAxes];									// the initial positions of the axes
+		float feedRate;													// feed rate of this move
+		float virtualExtruderPosition;									// the virtual extruder position at the start of this move
+		FilePosition filePos;											// offset in the file being printed at the start of reading this move
+		float proportionLeft;											// what proportion of the entire move remains after this segment
+		AxesBitmap xAxes;												// axes that X is mapped to
+		AxesBitmap yAxes;												// axes that Y is mapped to
+		EndstopChecks endStopsToCheck;									// endstops to check
+#if SUPPORT_IOBITS
+		IoBits_t ioBits;												// I/O bits to set/clear at the start of this move
+#endif
+		FansBitmap fanChangeMask;										// fans whose speed should change when this move starts
+		float newFanSpeed;												// the fan speed to apply to those fans, in the range 0 to 1 or 1 to 255
+		uint8_t moveType;												// the S parameter from the G0 or G1 command, 0 for a normal move
+
+		uint8_t isFirmwareRetraction : 1;								// true if this is a firmware retraction/un-retraction move
+		uint8_t usePressureAdvance : 1;									// true if we want to us extruder pressure advance, if there is any extrusion
+		uint8_t canPauseBefore : 1;										// true if we can pause before this move
+		uint8_t canPauseAfter : 1;										// true if we can pause just after this move and successfully restart
+		uint8_t hasExtrusion : 1;										// true if the move includes extrusion - only valid if the move was set up by SetupMove
+		uint8_t isCoordinated : 1;										// true if this is a coordinates move
+	};
+
+	GCodes();
+
+	size_t GetTotalAxes() const { return numTotalAxes; }
+	size_t GetVisibleAxes() const { return numVisibleAxes; }
+	size_t GetNumExtruders() const { return numExtruders; }
+	const char* GetAxisLetters() const { return axisLetters; }
+	bool IsPaused() const { return false; }
+	void SetAxisIsHomed(unsigned int axis) { (void)axis; }
+	void MoveStoppedByZProbe() { }
+
+	bool ReadMove(RawMove& m);											// called by Move::Spin to fetch the next queued move
+
+	// Simulator support, used by the driver rather than by firmware code
+	bool SimQueueMove(const RawMove& m);								// append a move to the queue, returning false if it is full
+	bool SimQueueEmpty() const { return queueHead == queueTail; }
+	void SimSetNumAxes(size_t visible, size_t total);
+
+private:
+	static const size_t MoveQueueLength = 64;							// the driver tops this up, so it just needs to cover a burst
+
+	size_t numTotalAxes;
+	size_t numVisibleAxes;
+	size_t numExtruders;
+	char axisLetters[MaxAxes + 1];
+
+	RawMove moveQueue[MoveQueueLength];
+	size_t queueHead, queueTail;
+};
+
+#endif
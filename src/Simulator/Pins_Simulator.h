@@ -0,0 +1,53 @@
+#ifndef PINS_SIMULATOR_H__
+#define PINS_SIMULATOR_H__
+
+// Board definition for the host simulator build (make simulator). We mirror the Duet WiFi/Ethernet
+// machine capabilities so that the planner is exercised with the same limits as on the real board,
+// but no feature that needs hardware behind it is enabled.
+
+#define FIRMWARE_NAME "RepRapFirmware motion simulator"
+
+// Features definition
+#define HAS_LWIP_NETWORKING		0
+#define HAS_WIFI_NETWORKING		0
+#define HAS_CPU_TEMP_SENSOR		0
+#define HAS_HIGH_SPEED_SD		0
+#define HAS_SMART_DRIVERS		0
+#define HAS_STALL_DETECT		0
+#define HAS_VOLTAGE_MONITOR		0
+#define HAS_VREF_MONITOR		0
+#define ACTIVE_LOW_HEAT_ON		0
+
+#define SUPPORT_INKJET		0
+#define SUPPORT_ROLAND		0
+#define SUPPORT_SCANNER		0
+#define SUPPORT_IOBITS		0
+#define SUPPORT_DHT_SENSOR	0
+
+// The physical capabilities of the simulated machine, as for the Duet WiFi
+constexpr size_t DRIVES = 12;						// The maximum number of drives supported by the electronics
+#define DRIVES_(a,b,c,d,e,f,g,h,i,j,k,l) { a,b,c,d,e,f,g,h,i,j,k,l }
+
+constexpr size_t Heaters = 8;						// The number of heaters in the machine; 0 is the heated bed even if there isn't one
+#define HEATERS_(a,b,c,d,e,f,g,h) { a,b,c,d,e,f,g,h }
+
+constexpr size_t NumExtraHeaterProtections = 8;		// The number of extra heater protection instances
+
+constexpr size_t MinAxes = 3;						// The minimum and default number of axes
+constexpr size_t MaxAxes = 9;						// The maximum number of movement axes in the machine, usually just X, Y and Z, <= DRIVES
+#define AXES_(a,b,c,d,e,f,g,h,i) { a,b,c,d,e,f,g,h,i }
+
+constexpr size_t MaxExtruders = DRIVES - MinAxes;	// The maximum number of extruders
+constexpr size_t MaxDriversPerAxis = 4;				// The maximum number of stepper drivers assigned to one axis
+
+constexpr size_t NUM_SERIAL_CHANNELS = 1;			// The simulator only has its standard output
+
+constexpr size_t MaxSpiTempSensors = 8;
+
+constexpr size_t NUM_FANS = 9;
+
+constexpr size_t NumSdCards = 1;
+
+constexpr int HighestLogicalPin = 135;				// highest logical pin number on this electronics
+
+#endif
@@ -0,0 +1,183 @@
+/*
+ * Platform.h - simulator stub
+ *
+ * Replacement for the real Platform class when building the host motion simulator. It provides the
+ * interfaces that Move, DDA, DriveMovement and the kinematics classes call, backed by plain arrays
+ * of configuration values and by step/direction recording that the simulator driver checks against
+ * the requested moves. Everything that would touch hardware is either recorded or ignored.
+ */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include "RepRapFirmware.h"
+#include "MessageType.h"
+#include "RepRap.h"
+#include "Storage/FileStore.h"		// the real Platform.h includes this too, and Move.cpp relies on getting it from here
+#include "Storage/MassStorage.h"
+
+// Direction sense, as in the real Platform.h
+constexpr bool FORWARDS = true;
+constexpr bool BACKWARDS = !FORWARDS;
+
+// Enumeration of error condition bits
+enum class ErrorCode : uint32_t
+{
+	BadTemp = 1 << 0,
+	BadMove = 1 << 1,
+	OutputStarvation = 1 << 2,
+	OutputStackOverflow = 1 << 3
+};
+
+enum class EndStopHit
+{
+  noStop = 0,		// no endstop hit
+  lowHit = 1,		// low switch hit, or Z-probe in use and above threshold
+  highHit = 2,		// high stop hit
+  nearStop = 3		// approaching Z-probe threshold
+};
+
+// The values of the following enumeration must tally with the X,Y,... parameters for the M574 command
+enum class EndStopPosition
+{
+	noEndStop = 0,
+	lowEndStop = 1,
+	highEndStop = 2
+};
+
+// Type of an endstop input - values must tally with the M574 command S parameter
+enum class EndStopInputType
+{
+	activeLow = 0,
+	activeHigh = 1,
+	zProbe = 2,
+	motorStall = 3
+};
+
+// Struct for holding Z probe parameters
+struct ZProbeParameters
+{
+	int32_t adcValue;				// the target ADC value, after inversion if enabled
+	float xOffset, yOffset;			// the offset of the probe relative to the print head
+	float height;					// the nozzle height at which the target ADC value is returned
+	float calibTemperature;			// the temperature at which we did the calibration
+	float temperatureCoefficient;	// the variation of height with bed temperature
+	float diveHeight;				// the dive height we use when probing
+	float probeSpeed;				// the initial speed of probing
+	float travelSpeed;				// the speed at which we travel to the probe point
+	float recoveryTime;				// Z probe recovery time
+	float extraParam;				// extra parameters used by some types of probe e.g. Delta probe
+	bool invertReading;				// true if we need to invert the reading
+
+	float GetStopHeight(float temperature) const { return ((temperature - calibTemperature) * temperatureCoefficient) + height; }
+};
+
+struct AxisDriversConfig
+{
+	size_t numDrivers;								// Number of drivers assigned to each axis
+	uint8_t driverNumbers[MaxDriversPerAxis];		// The driver numbers assigned - only the first numDrivers are meaningful
+};
+
+class Platform
+{
+public:
+	Platform();
+
+	// Timing. The step clock is the simulated time; the driver advances it.
+	static uint32_t GetInterruptClocks();
+	static bool ScheduleStepInterrupt(uint32_t tim);	// Schedule an interrupt at the specified clock count, or return true if it has passed already
+	static void DisableStepInterrupt();					// Make sure we get no step interrupts
+
+	// Communications and generic support
+	void Message(MessageType type, const char *message);
+	void MessageF(MessageType type, const char *fmt, ...) __attribute__ ((format (printf, 3, 4)));
+	void MessageF(MessageType type, const char *fmt, va_list vargs);
+	void LogError(ErrorCode e) { errorCodeBits |= (uint32_t)e; }
+	void ClassReport(uint32_t &lastTime) { (void)lastTime; }
+	void GetStackUsage(uint32_t* currentStack, uint32_t* maxStack, uint32_t* neverUsed) const;
+	bool IsDateTimeSet() const { return false; }
+	time_t GetDateTime() const { return 0; }
+	MassStorage* GetMassStorage() const;
+	bool Inkjet(int bitPattern) { (void)bitPattern; return true; }
+
+	// Movement configuration
+	float DriveStepsPerUnit(size_t drive) const { return driveStepsPerUnit[drive]; }
+	const float *GetDriveStepsPerUnit() const { return driveStepsPerUnit; }
+	void SetDriveStepsPerUnit(size_t drive, float value) { driveStepsPerUnit[drive] = value; }
+	float Acceleration(size_t drive) const { return accelerations[drive]; }
+	const float* Accelerations() const { return accelerations; }
+	void SetAcceleration(size_t drive, float value) { accelerations[drive] = value; }
+	float GetMaxPrintingAcceleration() const { return maxPrintingAcceleration; }
+	float GetMaxTravelAcceleration() const { return maxTravelAcceleration; }
+	float MaxFeedrate(size_t drive) const { return maxFeedrates[drive]; }
+	const float* MaxFeedrates() const { return maxFeedrates; }
+	void SetMaxFeedrate(size_t drive, float value) { maxFeedrates[drive] = value; }
+	float ConfiguredInstantDv(size_t drive) const { return instantDvs[drive]; }
+	float ActualInstantDv(size_t drive) const { return instantDvs[drive]; }
+	float AxisMaximum(size_t axis) const { return axisMaxima[axis]; }
+	void SetAxisMaximum(size_t axis, float value, bool byProbing) { (void)byProbing; axisMaxima[axis] = value; }
+	float AxisMinimum(size_t axis) const { return axisMinima[axis]; }
+	void SetAxisMinimum(size_t axis, float value, bool byProbing) { (void)byProbing; axisMinima[axis] = value; }
+	float GetPressureAdvance(size_t drive) const { return pressureAdvance[drive]; }
+	void SetPressureAdvance(size_t drive, float value) { pressureAdvance[drive] = value; }
+	bool GetExtrusionCoefficients(size_t extruder, float& a, float& b, float& limit) const
+		{ (void)extruder; a = b = 0.0; limit = 1.0; return false; }
+
+	const AxisDriversConfig& GetAxisDriversConfig(size_t drive) const { return axisDrivers[drive]; }
+	uint32_t GetDriversBitmap(size_t drive) const { return 1u << drive; }
+	uint32_t GetSlowDrivers() const { return 0; }
+	uint32_t GetSlowDriverClocks() const { return 0; }
+
+	// Drive control. Step pulses and directions are recorded so that the driver can check them.
+	void SetDirection(size_t drive, bool direction);
+	void EnableDrive(size_t drive) { (void)drive; }
+	void DisableDrive(size_t drive) { (void)drive; }
+	void SetDriversIdle() { }
+	void WakeDriversFromIdle() { }
+	static void StepDriversHigh(uint32_t driverMap);
+	static void StepDriversLow() { }
+	void ExtrudeOn() { }
+	void ExtrudeOff() { }
+	void ScheduleFanChange(FansBitmap whichFans, float speed) { (void)whichFans; (void)speed; }
+
+	// Endstops and Z probe: the simulated machine has no endstops, so no move ever stops early
+	EndStopHit Stopped(size_t drive) const { (void)drive; return EndStopHit::noStop; }
+	EndStopHit GetZProbeResult() const { return EndStopHit::noStop; }
+	const ZProbeParameters& GetCurrentZProbeParameters() const { return zProbeParameters; }
+	bool HomingZWithProbe() const { return false; }
+	uint32_t GetInterruptMonitoredEndstops() const { return 0; }
+	void PrimeEndstopLatch(uint32_t endstops) { (void)endstops; }
+	uint32_t ReadAndClearEndstopLatch() { return 0; }
+
+	// Simulator support, used by the driver rather than by firmware code
+	static void SimSetClock(uint64_t when);						// set the simulated time
+	static bool SimStepInterruptPending(uint32_t& when);		// return the scheduled step interrupt time, if any
+	int32_t SimGetMotorPosition(size_t drive) const { return simMotorSteps[drive]; }
+	void SimResetMotorPositions();
+	static uint64_t SimGetTotalStepPulses() { return simTotalStepPulses; }
+	uint32_t SimGetErrorCodeBits() const { return errorCodeBits; }
+
+private:
+	float driveStepsPerUnit[DRIVES];
+	float accelerations[DRIVES];
+	float maxFeedrates[DRIVES];
+	float instantDvs[DRIVES];
+	float pressureAdvance[MaxExtruders];
+	float axisMaxima[MaxAxes];
+	float axisMinima[MaxAxes];
+	float maxPrintingAcceleration;
+	float maxTravelAcceleration;
+	AxisDriversConfig axisDrivers[DRIVES];
+	ZProbeParameters zProbeParameters;
+	uint32_t errorCodeBits;
+
+	// Step recording. These are static because StepDriversHigh is static, and there is only one Platform.
+	static int32_t simMotorSteps[DRIVES];				// the net number of steps taken by each motor
+	static bool simDirections[DRIVES];					// the last direction set for each motor
+	static uint64_t simTotalStepPulses;					// the total number of step pulses generated, for the throughput report
+
+	static bool stepInterruptScheduled;
+	static uint32_t stepInterruptTime;
+};
+
+#endif
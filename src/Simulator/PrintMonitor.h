@@ -0,0 +1,18 @@
+/*
+ * PrintMonitor.h - simulator stub
+ *
+ * The simulator replays moves directly into the planner, so as far as the print monitor is
+ * concerned no file print is ever in progress and Move never starts its statistics sampling.
+ */
+
+#ifndef PRINTMONITOR_H
+#define PRINTMONITOR_H
+
+class PrintMonitor
+{
+public:
+	bool IsPrinting() const { return false; }
+	const char *GetPrintingFilename() const { return nullptr; }
+};
+
+#endif
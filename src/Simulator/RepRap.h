@@ -0,0 +1,48 @@
+/*
+ * RepRap.h - simulator stub
+ *
+ * Minimal container object for the simulator build. It owns the real Move object and the stub
+ * Platform and GCodes objects, and provides the handful of query methods that the motion sources
+ * call on the real RepRap class.
+ */
+
+#ifndef REPRAP_H
+#define REPRAP_H
+
+#include "RepRapFirmware.h"
+
+class Platform;
+class GCodes;
+class Move;
+class PrintMonitor;
+
+class RepRap
+{
+public:
+	RepRap();
+	void Init();
+
+	Platform& GetPlatform() const { return *platform; }
+	Move& GetMove() const { return *move; }
+	GCodes& GetGCodes() const { return *gCodes; }
+	PrintMonitor& GetPrintMonitor() const { return *printMonitor; }
+
+	bool Debug(Module m) const { return (debugFlags & (1u << m)) != 0; }
+	void SetDebug(Module m, bool enable);
+
+	AxesBitmap GetCurrentXAxes() const { return 1u << X_AXIS; }
+	AxesBitmap GetCurrentYAxes() const { return 1u << Y_AXIS; }
+
+	// The simulated machine has no tools, so no extruder movement is ever prohibited
+	unsigned int GetProhibitedExtruderMovements(unsigned int extrusions, unsigned int retractions)
+		{ (void)extrusions; (void)retractions; return 0; }
+
+private:
+	Platform* platform;
+	Move* move;
+	GCodes* gCodes;
+	PrintMonitor* printMonitor;
+	uint32_t debugFlags;
+};
+
+#endif
@@ -0,0 +1,439 @@
+/*
+ * SimMain.cpp
+ *
+ * Driver for the host motion simulator. It replays a stream of moves through the real motion
+ * planner (Move, DDA, DriveMovement and the kinematics classes), emulating the step interrupt by
+ * advancing a simulated step clock, then checks that the recorded step counts match the commanded
+ * positions and reports planner throughput.
+ *
+ * Usage: simulator [-k kinematics] [-d] [movesfile]
+ *
+ * The moves file contains one move per line as letter-value pairs: axis letters give absolute
+ * target coordinates in mm, E gives an extrusion amount in mm, F gives a feed rate in mm/min.
+ * Lines starting with '#' or ';' are comments. With no file, a built-in raster pattern is used.
+ */
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "RepRapFirmware.h"
+#include "Platform.h"
+#include "RepRap.h"
+#include "GCodes/GCodes.h"
+#include "Movement/Move.h"
+#include "Movement/Kinematics/Kinematics.h"
+
+static const struct
+{
+	const char *name;
+	KinematicsType type;
+} kinematicsNames[] =
+{
+	{ "cartesian",	KinematicsType::cartesian },
+	{ "coreXY",		KinematicsType::coreXY },
+	{ "coreXZ",		KinematicsType::coreXZ },
+	{ "delta",		KinematicsType::linearDelta },
+	{ "scara",		KinematicsType::scara },
+	{ "coreXYU",	KinematicsType::coreXYU },
+	{ "coreXYUV",	KinematicsType::coreXYUV }
+};
+
+static const uint32_t SimStepClockRate = VARIANT_MCK/128;				// same as the firmware step clock
+static const uint32_t SpinIntervalClocks = SimStepClockRate/1000;		// call Move::Spin about every simulated millisecond
+static const uint64_t MaxSimulatedClocks = (uint64_t)SimStepClockRate * 3600;	// give up after an hour of simulated time
+
+// State of the move source
+static FILE *movesFile = nullptr;
+static unsigned int builtInMovesLeft = 0;
+static float currentPosition[MaxAxes];
+static float currentFeedRate = 50.0;									// mm/sec
+static float totalExtrusion = 0.0;
+static unsigned int extrudingMoves = 0;
+static unsigned int lineNumber = 0;
+
+// Geometry of the built-in raster pattern. The defaults suit a Cartesian or CoreXY bed; main()
+// shrinks and recentres the raster for kinematics with a restricted reachable area.
+static float rasterCentreX = 100.0;
+static float rasterStartY = 20.0;
+static float rasterHalfWidth = 80.0;
+static float rasterLineSpacing = 0.5;
+
+// Initialise a RawMove to continue from the current position with no extrusion
+static void InitMove(GCodes::RawMove& m)
+{
+	memset(&m, 0, sizeof(m));
+	for (size_t axis = 0; axis < MaxAxes; ++axis)
+	{
+		m.coords[axis] = currentPosition[axis];
+	}
+	m.feedRate = currentFeedRate;
+	m.virtualExtruderPosition = totalExtrusion;
+	m.xAxes = 1u << X_AXIS;
+	m.yAxes = 1u << Y_AXIS;
+	m.isCoordinated = 1;
+	m.usePressureAdvance = 1;
+	m.canPauseAfter = 1;
+	m.filePos = lineNumber;
+}
+
+// Parse one line of the moves file into a RawMove. Return true if the line contained a move.
+static bool ParseMoveLine(const char *line, GCodes::RawMove& m)
+{
+	const size_t numAxes = reprap.GetGCodes().GetVisibleAxes();
+	const char * const axisLetters = reprap.GetGCodes().GetAxisLetters();
+	InitMove(m);
+	bool anyParameter = false;
+	const char *p = line;
+	while (*p != 0)
+	{
+		while (*p == ' ' || *p == '\t')
+		{
+			++p;
+		}
+		if (*p == 0 || *p == '\n' || *p == '\r' || *p == '#' || *p == ';')
+		{
+			break;
+		}
+		const char letter = toupper(*p++);
+		char *endp;
+		const float value = strtof(p, &endp);
+		if (endp == p)
+		{
+			fprintf(stderr, "Line %u: bad value for '%c'\n", lineNumber, letter);
+			return false;
+		}
+		p = endp;
+		if (letter == 'F')
+		{
+			currentFeedRate = value * (1.0/60.0);						// feed rates are given in mm/min as in G-code
+			m.feedRate = currentFeedRate;
+			anyParameter = true;
+		}
+		else if (letter == 'E')
+		{
+			m.coords[numAxes] = value;									// amount to extrude, not an absolute position
+			m.hasExtrusion = 1;
+			anyParameter = true;
+		}
+		else
+		{
+			const char * const q = strchr(axisLetters, letter);
+			if (q == nullptr || (size_t)(q - axisLetters) >= numAxes)
+			{
+				fprintf(stderr, "Line %u: unknown axis letter '%c'\n", lineNumber, letter);
+				return false;
+			}
+			m.coords[q - axisLetters] = value;
+			anyParameter = true;
+		}
+	}
+	return anyParameter;
+}
+
+// Get the next move to feed to the planner, either from the moves file or from the built-in pattern.
+// Return false when there are no more.
+static bool GetNextMove(GCodes::RawMove& m)
+{
+	if (movesFile != nullptr)
+	{
+		char line[256];
+		while (fgets(line, sizeof(line), movesFile) != nullptr)
+		{
+			++lineNumber;
+			if (ParseMoveLine(line, m))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	if (builtInMovesLeft == 0)
+	{
+		return false;
+	}
+	--builtInMovesLeft;
+	++lineNumber;
+
+	// Built-in pattern: a raster of alternating printing and travel moves, the sort of thing a
+	// slicer generates for a solid infill layer
+	InitMove(m);
+	const unsigned int n = lineNumber - 1;
+	if ((n & 1) == 0)
+	{
+		// Printing move across the bed
+		m.coords[X_AXIS] = ((n & 2) == 0) ? rasterCentreX + rasterHalfWidth : rasterCentreX - rasterHalfWidth;
+		const float distance = 2.0 * rasterHalfWidth;
+		m.coords[reprap.GetGCodes().GetVisibleAxes()] = distance * 0.05;	// typical extrusion ratio
+		m.hasExtrusion = 1;
+		m.feedRate = 60.0;
+	}
+	else
+	{
+		// Travel move to the next raster line
+		m.coords[Y_AXIS] = rasterStartY + (float)(n/2) * rasterLineSpacing;
+		m.feedRate = 100.0;
+	}
+	return true;
+}
+
+// Record the effect the move should have, after the planner has accepted it
+static void RecordMoveEffect(const GCodes::RawMove& m)
+{
+	const size_t numAxes = reprap.GetGCodes().GetVisibleAxes();
+	for (size_t axis = 0; axis < numAxes; ++axis)
+	{
+		currentPosition[axis] = m.coords[axis];
+	}
+	totalExtrusion += m.coords[numAxes];
+	if (m.coords[numAxes] > 0.0)
+	{
+		++extrudingMoves;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	KinematicsType kinematicsType = KinematicsType::cartesian;
+	const char *movesFileName = nullptr;
+	bool debug = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+		{
+			++i;
+			bool found = false;
+			for (size_t j = 0; j < ARRAY_SIZE(kinematicsNames); ++j)
+			{
+				if (StringEquals(argv[i], kinematicsNames[j].name))
+				{
+					kinematicsType = kinematicsNames[j].type;
+					found = true;
+					break;
+				}
+			}
+			if (!found)
+			{
+				fprintf(stderr, "Unknown kinematics '%s'\n", argv[i]);
+				return 2;
+			}
+		}
+		else if (strcmp(argv[i], "-d") == 0)
+		{
+			debug = true;
+		}
+		else if (argv[i][0] == '-')
+		{
+			fprintf(stderr, "Usage: %s [-k kinematics] [-d] [movesfile]\n", argv[0]);
+			return 2;
+		}
+		else
+		{
+			movesFileName = argv[i];
+		}
+	}
+
+	if (movesFileName != nullptr)
+	{
+		movesFile = fopen(movesFileName, "r");
+		if (movesFile == nullptr)
+		{
+			fprintf(stderr, "Failed to open %s\n", movesFileName);
+			return 2;
+		}
+	}
+	else
+	{
+		builtInMovesLeft = 400;
+	}
+
+	reprap.Init();
+	Move& move = reprap.GetMove();
+	Platform& platform = reprap.GetPlatform();
+	GCodes& gCodes = reprap.GetGCodes();
+	if (debug)
+	{
+		reprap.SetDebug(moduleMove, true);
+		reprap.SetDebug(moduleDda, true);
+	}
+	if (!move.SetKinematics(kinematicsType))
+	{
+		fprintf(stderr, "Failed to create kinematics\n");
+		return 2;
+	}
+	printf("Simulating %s kinematics\n", move.GetKinematics().GetName(false));
+
+	// Shrink and recentre the built-in raster for kinematics that cannot reach the whole of a
+	// Cartesian bed: a delta can only print within its print radius around the origin, and a SCARA
+	// cannot reach the region close to the proximal joint
+	switch (kinematicsType)
+	{
+	case KinematicsType::linearDelta:
+		rasterCentreX = 0.0;
+		rasterStartY = -25.0;
+		rasterHalfWidth = 50.0;
+		rasterLineSpacing = 0.25;
+		break;
+
+	case KinematicsType::scara:
+		rasterCentreX = 120.0;
+		rasterStartY = -25.0;
+		rasterHalfWidth = 30.0;
+		rasterLineSpacing = 0.25;
+		break;
+
+	default:
+		break;
+	}
+
+	// Start from the first corner of the raster, which every supported kinematics can reach
+	for (size_t axis = 0; axis < MaxAxes; ++axis)
+	{
+		currentPosition[axis] = 0.0;
+	}
+	currentPosition[X_AXIS] = rasterCentreX - rasterHalfWidth;
+	currentPosition[Y_AXIS] = rasterStartY;
+	float startCoords[DRIVES];
+	memset(startCoords, 0, sizeof(startCoords));
+	memcpy(startCoords, currentPosition, MaxAxes * sizeof(startCoords[0]));
+	move.SetNewPosition(startCoords, false);
+	platform.SimResetMotorPositions();
+
+	// Record the motor endpoints of the start position, because the recorded step counts are relative to it
+	int32_t startEndpoints[DRIVES];
+	memset(startEndpoints, 0, sizeof(startEndpoints));
+	if (!move.CartesianToMotorSteps(currentPosition, startEndpoints, true))
+	{
+		fprintf(stderr, "Start position could not be transformed to motor steps\n");
+		return 2;
+	}
+
+	const auto wallStart = std::chrono::steady_clock::now();
+	unsigned int movesQueued = 0;
+	bool allMovesFed = false;
+	GCodes::RawMove pendingMove;
+	bool havePendingMove = false;
+
+	for (;;)
+	{
+		// Top up the move queue
+		while (!allMovesFed)
+		{
+			if (!havePendingMove)
+			{
+				if (!GetNextMove(pendingMove))
+				{
+					allMovesFed = true;
+					break;
+				}
+				havePendingMove = true;
+			}
+			if (!gCodes.SimQueueMove(pendingMove))
+			{
+				break;													// queue full, try again next spin
+			}
+			RecordMoveEffect(pendingMove);
+			havePendingMove = false;
+			++movesQueued;
+		}
+
+		move.Spin();
+
+		if (allMovesFed && gCodes.SimQueueEmpty() && move.AllMovesAreFinished())
+		{
+			break;
+		}
+
+		// Run any step interrupts that fall due before the next spin, then advance to the next spin
+		const uint64_t nextSpinTime = SimulatedTime + SpinIntervalClocks;
+		uint32_t when;
+		while (Platform::SimStepInterruptPending(when))
+		{
+			// Convert the scheduled 32-bit time to 64 bits relative to now
+			const uint64_t whenAbsolute = SimulatedTime + (uint64_t)(int64_t)(int32_t)(when - (uint32_t)SimulatedTime);
+			if (whenAbsolute >= nextSpinTime)
+			{
+				break;
+			}
+			Platform::DisableStepInterrupt();
+			Platform::SimSetClock(whenAbsolute);
+			move.Interrupt();
+		}
+		Platform::SimSetClock(nextSpinTime);
+
+		if (SimulatedTime > MaxSimulatedClocks)
+		{
+			fprintf(stderr, "FAILED: simulation did not complete within the simulated time limit\n");
+			return 1;
+		}
+	}
+
+	const auto wallEnd = std::chrono::steady_clock::now();
+	const double wallSeconds = std::chrono::duration<double>(wallEnd - wallStart).count();
+	const double simulatedSeconds = (double)SimulatedTime/(double)SimStepClockRate;
+
+	if (movesFile != nullptr)
+	{
+		fclose(movesFile);
+	}
+
+	// Check the recorded step counts against the commanded final position
+	const size_t numAxes = gCodes.GetVisibleAxes();
+	int exitCode = 0;
+	int32_t expectedEndpoints[DRIVES];
+	memset(expectedEndpoints, 0, sizeof(expectedEndpoints));
+	if (!move.CartesianToMotorSteps(currentPosition, expectedEndpoints, true))
+	{
+		fprintf(stderr, "FAILED: final position could not be transformed to motor steps\n");
+		exitCode = 1;
+	}
+	else
+	{
+		for (size_t drive = 0; drive < numAxes; ++drive)
+		{
+			const int32_t actual = startEndpoints[drive] + platform.SimGetMotorPosition(drive);
+			if (labs((long)(actual - expectedEndpoints[drive])) > 1)
+			{
+				fprintf(stderr, "FAILED: motor %u at %" PRIi32 " steps (%" PRIi32 " + net %" PRIi32 "), expected %" PRIi32 "\n",
+							(unsigned int)drive, actual, startEndpoints[drive], platform.SimGetMotorPosition(drive), expectedEndpoints[drive]);
+				exitCode = 1;
+			}
+		}
+	}
+
+	// The extruder carries sub-step extrusion forward between moves, and PrepareExtruder may clamp the
+	// step count by one step per move when the deceleration distance rounds down, so allow one step of
+	// slack per extruding move plus a little for the sub-step carry
+	const int32_t expectedExtruderSteps = (int32_t)(totalExtrusion * platform.DriveStepsPerUnit(numAxes));
+	const int32_t actualExtruderSteps = platform.SimGetMotorPosition(numAxes);
+	if (labs((long)(actualExtruderSteps - expectedExtruderSteps)) > (long)(extrudingMoves + 2))
+	{
+		fprintf(stderr, "FAILED: extruder at %" PRIi32 " steps, expected %" PRIi32 "\n",
+					actualExtruderSteps, expectedExtruderSteps);
+		exitCode = 1;
+	}
+
+	if (platform.SimGetErrorCodeBits() != 0)
+	{
+		fprintf(stderr, "FAILED: error code bits %08" PRIx32 " were set\n", platform.SimGetErrorCodeBits());
+		exitCode = 1;
+	}
+
+	const uint64_t totalStepPulses = Platform::SimGetTotalStepPulses();
+	printf("Moves %u, step pulses %" PRIu64 ", simulated time %.2fs, wall time %.3fs\n",
+				movesQueued, totalStepPulses, simulatedSeconds, wallSeconds);
+	if (wallSeconds > 0.0)
+	{
+		printf("Throughput: %.0f moves/sec, %.0f steps/sec\n",
+					(double)movesQueued/wallSeconds, (double)totalStepPulses/wallSeconds);
+	}
+	printf("Scheduled moves %" PRIu32 ", completed moves %" PRIu32 "\n", move.GetScheduledMoves(), move.GetCompletedMoves());
+	printf((exitCode == 0) ? "PASSED\n" : "FAILED\n");
+	return exitCode;
+}
+
+// End
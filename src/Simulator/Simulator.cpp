@@ -0,0 +1,408 @@
+/*
+ * Simulator.cpp
+ *
+ * Implementations of the stub Platform, RepRap, GCodes and FileStore classes and of the globals
+ * that RepRapFirmware.cpp normally provides, for the host motion simulator build.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "RepRapFirmware.h"
+#include "Platform.h"
+#include "RepRap.h"
+#include "GCodes/GCodes.h"
+#include "PrintMonitor.h"
+#include "Storage/FileStore.h"
+#include "Movement/Move.h"
+
+// Globals normally defined in RepRapFirmware.cpp
+RepRap reprap;
+
+static char scratchStringBuffer[220];
+StringRef scratchString(scratchStringBuffer, ARRAY_SIZE(scratchStringBuffer));
+
+const char * const moduleName[] =
+{
+	"Platform",
+	"Network",
+	"Webserver",
+	"GCodes",
+	"Move",
+	"Heat",
+	"DDA",
+	"Roland",
+	"Scanner",
+	"PrintMonitor",
+	"Storage",
+	"PortControl",
+	"DuetExpansion",
+	"FilamentSensors",
+	"WiFi",
+	"none"
+};
+
+void debugPrintf(const char* fmt, ...)
+{
+	va_list vargs;
+	va_start(vargs, fmt);
+	vfprintf(stderr, fmt, vargs);
+	va_end(vargs);
+}
+
+bool StringEndsWith(const char* string, const char* ending)
+{
+	const size_t j = strlen(string);
+	const size_t k = strlen(ending);
+	return k <= j && StringEquals(&string[j - k], ending);
+}
+
+bool StringEquals(const char* s1, const char* s2)
+{
+	return strcasecmp(s1, s2) == 0;
+}
+
+bool StringStartsWith(const char* string, const char* starting)
+{
+	const size_t j = strlen(string);
+	const size_t k = strlen(starting);
+	return k <= j && strncmp(string, starting, k) == 0;
+}
+
+int StringContains(const char* string, const char* match)
+{
+	const char *p = strstr(string, match);
+	return (p == nullptr) ? -1 : (p - string) + strlen(match);
+}
+
+void SafeStrncpy(char *dst, const char *src, size_t length)
+{
+	strncpy(dst, src, length);
+	dst[length - 1] = 0;
+}
+
+void SafeStrncat(char *dst, const char *src, size_t length)
+{
+	dst[length - 1] = 0;
+	const size_t toCopy = length - strlen(dst) - 1;
+	strncat(dst, src, toCopy);
+}
+
+void ListDrivers(const StringRef& str, DriversBitmap drivers)
+{
+	for (unsigned int d = 0; drivers != 0; ++d)
+	{
+		if ((drivers & 1) != 0)
+		{
+			str.catf(" %u", d);
+		}
+		drivers >>= 1;
+	}
+}
+
+// Simulated time
+
+uint64_t SimulatedTime = 0;
+
+static constexpr uint32_t SimStepClockRate = VARIANT_MCK/128;
+static constexpr uint32_t SimStepClocksPerMilli = SimStepClockRate/1000;
+
+uint32_t millis()
+{
+	return (uint32_t)(SimulatedTime/SimStepClocksPerMilli);
+}
+
+uint64_t millis64()
+{
+	return SimulatedTime/SimStepClocksPerMilli;
+}
+
+uint32_t micros()
+{
+	return (uint32_t)((SimulatedTime * 1000)/SimStepClocksPerMilli);
+}
+
+// Platform
+
+int32_t Platform::simMotorSteps[DRIVES];
+bool Platform::simDirections[DRIVES];
+uint64_t Platform::simTotalStepPulses = 0;
+bool Platform::stepInterruptScheduled = false;
+uint32_t Platform::stepInterruptTime = 0;
+
+Platform::Platform() : maxPrintingAcceleration(10000.0), maxTravelAcceleration(10000.0), errorCodeBits(0)
+{
+	for (size_t drive = 0; drive < DRIVES; ++drive)
+	{
+		driveStepsPerUnit[drive] = (drive < MinAxes) ? 80.0 : 420.0;
+		accelerations[drive] = (drive < MinAxes) ? 500.0 : 1000.0;
+		maxFeedrates[drive] = 100.0;					// mm/sec
+		instantDvs[drive] = 15.0;						// mm/sec
+		axisDrivers[drive].numDrivers = 1;
+		axisDrivers[drive].driverNumbers[0] = (uint8_t)drive;
+		simMotorSteps[drive] = 0;
+		simDirections[drive] = true;
+	}
+	for (size_t extruder = 0; extruder < MaxExtruders; ++extruder)
+	{
+		pressureAdvance[extruder] = 0.0;
+	}
+	for (size_t axis = 0; axis < MaxAxes; ++axis)
+	{
+		axisMinima[axis] = 0.0;
+		axisMaxima[axis] = 230.0;
+	}
+	memset(&zProbeParameters, 0, sizeof(zProbeParameters));
+}
+
+/*static*/ uint32_t Platform::GetInterruptClocks()
+{
+	return (uint32_t)SimulatedTime;
+}
+
+// Schedule an interrupt at the specified clock count, or return true if it has passed already.
+// The real implementation also returns true when the requested time is less than a few microseconds
+// away; the simulator can honour any future time exactly, so it only rejects times already passed.
+/*static*/ bool Platform::ScheduleStepInterrupt(uint32_t tim)
+{
+	if ((int32_t)(tim - GetInterruptClocks()) <= 0)
+	{
+		return true;									// tell the caller to simulate an interrupt instead
+	}
+	stepInterruptScheduled = true;
+	stepInterruptTime = tim;
+	return false;
+}
+
+/*static*/ void Platform::DisableStepInterrupt()
+{
+	stepInterruptScheduled = false;
+}
+
+/*static*/ void Platform::SimSetClock(uint64_t when)
+{
+	SimulatedTime = when;
+}
+
+/*static*/ bool Platform::SimStepInterruptPending(uint32_t& when)
+{
+	if (stepInterruptScheduled)
+	{
+		when = stepInterruptTime;
+		return true;
+	}
+	return false;
+}
+
+void Platform::SimResetMotorPositions()
+{
+	for (size_t drive = 0; drive < DRIVES; ++drive)
+	{
+		simMotorSteps[drive] = 0;
+	}
+}
+
+void Platform::SetDirection(size_t drive, bool direction)
+{
+	simDirections[drive] = direction;
+}
+
+/*static*/ void Platform::StepDriversHigh(uint32_t driverMap)
+{
+	for (size_t drive = 0; driverMap != 0; ++drive, driverMap >>= 1)
+	{
+		if ((driverMap & 1u) != 0)
+		{
+			simMotorSteps[drive] += (simDirections[drive]) ? 1 : -1;
+			++simTotalStepPulses;
+		}
+	}
+}
+
+void Platform::Message(MessageType type, const char *message)
+{
+	(void)type;
+	fputs(message, stdout);
+}
+
+void Platform::MessageF(MessageType type, const char *fmt, va_list vargs)
+{
+	(void)type;
+	vfprintf(stdout, fmt, vargs);
+}
+
+void Platform::MessageF(MessageType type, const char *fmt, ...)
+{
+	va_list vargs;
+	va_start(vargs, fmt);
+	MessageF(type, fmt, vargs);
+	va_end(vargs);
+}
+
+void Platform::GetStackUsage(uint32_t* currentStack, uint32_t* maxStack, uint32_t* neverUsed) const
+{
+	// Report plenty of never-used RAM so that M595-style queue growth is never refused
+	if (currentStack != nullptr) { *currentStack = 0; }
+	if (maxStack != nullptr) { *maxStack = 0; }
+	if (neverUsed != nullptr) { *neverUsed = 1024 * 1024; }
+}
+
+static MassStorage massStorageInstance;
+
+MassStorage* Platform::GetMassStorage() const
+{
+	return &massStorageInstance;
+}
+
+// RepRap
+
+RepRap::RepRap() : debugFlags(0)
+{
+	platform = new Platform();
+	gCodes = new GCodes();
+	move = new Move();
+	printMonitor = new PrintMonitor();
+}
+
+void RepRap::Init()
+{
+	move->Init();
+}
+
+void RepRap::SetDebug(Module m, bool enable)
+{
+	if (enable)
+	{
+		debugFlags |= (1u << m);
+	}
+	else
+	{
+		debugFlags &= ~(1u << m);
+	}
+}
+
+// GCodes
+
+GCodes::GCodes() : numTotalAxes(MinAxes), numVisibleAxes(MinAxes), numExtruders(1), queueHead(0), queueTail(0)
+{
+	static const char defaultLetters[MaxAxes + 1] = "XYZUVWABC";
+	memcpy(axisLetters, defaultLetters, sizeof(axisLetters));
+}
+
+void GCodes::SimSetNumAxes(size_t visible, size_t total)
+{
+	numVisibleAxes = visible;
+	numTotalAxes = total;
+}
+
+bool GCodes::ReadMove(RawMove& m)
+{
+	if (queueHead == queueTail)
+	{
+		return false;
+	}
+	m = moveQueue[queueTail];
+	queueTail = (queueTail + 1) % MoveQueueLength;
+	return true;
+}
+
+bool GCodes::SimQueueMove(const RawMove& m)
+{
+	const size_t nextHead = (queueHead + 1) % MoveQueueLength;
+	if (nextHead == queueTail)
+	{
+		return false;
+	}
+	moveQueue[queueHead] = m;
+	queueHead = nextHead;
+	return true;
+}
+
+// FileStore
+
+bool FileStore::Open(const char *filePath, bool write)
+{
+	Close();
+	f = fopen(filePath, (write) ? "w" : "r");
+	return f != nullptr;
+}
+
+bool FileStore::Close()
+{
+	if (f != nullptr)
+	{
+		fclose(f);
+		f = nullptr;
+	}
+	return true;
+}
+
+bool FileStore::Read(char& b)
+{
+	return f != nullptr && fread(&b, 1, 1, f) == 1;
+}
+
+int FileStore::Read(char* buf, size_t nBytes)
+{
+	return (f == nullptr) ? -1 : (int)fread(buf, 1, nBytes, f);
+}
+
+int FileStore::ReadLine(char* buf, size_t nBytes)
+{
+	if (f == nullptr || fgets(buf, nBytes, f) == nullptr)
+	{
+		return -1;
+	}
+	size_t len = strlen(buf);
+	while (len != 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+	{
+		buf[--len] = 0;
+	}
+	return (int)len;
+}
+
+bool FileStore::Write(char b)
+{
+	return f != nullptr && fwrite(&b, 1, 1, f) == 1;
+}
+
+bool FileStore::Write(const char *s, size_t len)
+{
+	return f != nullptr && fwrite(s, 1, len, f) == len;
+}
+
+bool FileStore::Write(const uint8_t *s, size_t len)
+{
+	return Write(reinterpret_cast<const char*>(s), len);
+}
+
+bool FileStore::Write(const char* s)
+{
+	return Write(s, strlen(s));
+}
+
+bool FileStore::Seek(FilePosition pos)
+{
+	return f != nullptr && fseek(f, (long)pos, SEEK_SET) == 0;
+}
+
+FilePosition FileStore::Position() const
+{
+	return (f == nullptr) ? 0 : (FilePosition)ftell(f);
+}
+
+FilePosition FileStore::Length() const
+{
+	if (f == nullptr)
+	{
+		return 0;
+	}
+	const long here = ftell(f);
+	fseek(f, 0, SEEK_END);
+	const long len = ftell(f);
+	fseek(f, here, SEEK_SET);
+	return (FilePosition)len;
+}
+
+// End
@@ -0,0 +1,41 @@
+/*
+ * Storage/FileStore.h - simulator stub
+ *
+ * The height map and some kinematics classes read and write SD card files. The simulator maps a
+ * FileStore onto a host stdio stream, so height maps can be loaded from and saved to ordinary
+ * files when the driver wants that; everything else about the class is omitted.
+ */
+
+#ifndef FILESTORE_H
+#define FILESTORE_H
+
+#include <cstdio>
+
+#include "RepRapFirmware.h"
+
+class FileStore
+{
+public:
+	FileStore() : f(nullptr) { }
+	~FileStore() { Close(); }
+
+	bool Open(const char *filePath, bool write);
+	bool Close();
+
+	bool Read(char& b);								// Read 1 byte
+	int Read(char* buf, size_t nBytes);				// Returns the number of bytes read or -1 if the read process failed
+	int ReadLine(char* buf, size_t nBytes);			// As Read but stop after '\n' or '\r\n' and null-terminate
+	bool Write(char b);
+	bool Write(const char *s, size_t len);
+	bool Write(const uint8_t *s, size_t len);
+	bool Write(const char* s);
+	bool Seek(FilePosition pos);
+	bool Flush() { return f == nullptr || fflush(f) == 0; }
+	FilePosition Position() const;
+	FilePosition Length() const;
+
+private:
+	FILE *f;
+};
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * Storage/MassStorage.h - simulator stub
+ *
+ * There is no SD card in the simulator. The only thing the motion sources ask of MassStorage is
+ * whether homing files exist, and the answer is always no.
+ */
+
+#ifndef MASSSTORAGE_H
+#define MASSSTORAGE_H
+
+#include "RepRapFirmware.h"
+
+class MassStorage
+{
+public:
+	bool FileExists(const char* directory, const char *fileName) const { (void)directory; (void)fileName; return false; }
+};
+
+#endif
@@ -0,0 +1,13 @@
+/*
+ * WMath.h - simulator stub
+ *
+ * On target builds this header comes from CoreNG. The simulator only needs the maths helpers
+ * that the motion sources use, all of which are provided by our Core.h stub.
+ */
+
+#ifndef WMATH_H
+#define WMATH_H
+
+#include "Core.h"
+
+#endif
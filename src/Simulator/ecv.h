@@ -0,0 +1,21 @@
+/*
+ * ecv.h - simulator stub
+ *
+ * The firmware sources carry eCv (Escher C Verifier) annotations such as pre() and post().
+ * On target builds CoreNG supplies the macros that compile them away; for the host simulator
+ * build we supply them here instead.
+ */
+
+#ifndef ECV_H
+#define ECV_H
+
+#define array
+#define out
+#define null
+#define not_null(_x)	(_x)
+#define pre(...)
+#define post(...)
+#define decrease(...)
+#define invariant(...)
+
+#endif
@@ -0,0 +1,66 @@
+# Makefile for the RepRapFirmware host motion simulator
+#
+# Licensed under the terms of the GNU Public License v2
+# see http://www.gnu.org/licenses/gpl-2.0.html
+#
+# This builds the real motion planner (Move, DDA, DriveMovement, the kinematics classes and the
+# bed probing grid) for the host using the native compiler, against the stub headers in this
+# directory, together with a driver that replays move streams and checks the step counts.
+#
+# It is invoked directly rather than through the top-level Makefile, because that one refuses to
+# parse without an Arduino installation:
+#
+#   make -C src -f Simulator/simulator.mk
+
+VERSION := 1.20.1
+
+# Workspace directories
+BUILD_PATH := $(PWD)/../Release/Simulator/obj
+OUTPUT_PATH := $(PWD)/../Release/Simulator
+
+HOST_CXX ?= g++
+OPTIMISATION ?= -O2
+
+# The stub include directory must come first so that its Platform.h, RepRap.h etc. shadow the
+# real ones; PLATFORM=Simulator makes Pins.h pick up Simulator/Pins_Simulator.h
+INCLUDES := -I"$(PWD)/Simulator" -I"$(PWD)"
+
+VPATH := $(PWD)/Movement $(PWD)/Movement/BedProbing $(PWD)/Movement/Kinematics
+VPATH += $(PWD)/Libraries/General $(PWD)/Libraries/Math $(PWD)/Storage $(PWD)/Simulator
+
+CPP_SOURCES := $(wildcard $(PWD)/Movement/*.cpp) $(wildcard $(PWD)/Movement/BedProbing/*.cpp) $(wildcard $(PWD)/Movement/Kinematics/*.cpp)
+CPP_SOURCES += $(PWD)/Libraries/General/StringRef.cpp $(PWD)/Libraries/Math/Isqrt.cpp $(PWD)/Storage/CRC32.cpp
+CPP_SOURCES += $(PWD)/Simulator/Simulator.cpp $(PWD)/Simulator/SimMain.cpp
+
+CPP_OBJS := $(foreach src,$(CPP_SOURCES),$(BUILD_PATH)/$(notdir $(src:.cpp=.cpp.o)))
+
+DEPS := $(CPP_OBJS:%.o=%.d)
+
+CPPFLAGS := -DVERSION=\"$(VERSION)\" -DPLATFORM=Simulator -Wall -c -std=gnu++11 -g -MMD -MP
+
+
+# ================================= Target all ======================================
+.PHONY += all
+all: $(OUTPUT_PATH)/simulator
+
+$(OUTPUT_PATH)/simulator: $(BUILD_PATH) $(OUTPUT_PATH) $(CPP_OBJS)
+	@echo "  LD      ../Release/Simulator/simulator"
+	@$(HOST_CXX) $(OPTIMISATION) -o $(OUTPUT_PATH)/simulator $(CPP_OBJS) -lm
+-include $(DEPS)
+
+$(BUILD_PATH)/%.cpp.o: %.cpp
+	@echo "  CC      $(subst $(PWD)/,,$<)"
+	@$(HOST_CXX) $(CPPFLAGS) $(OPTIMISATION) $(INCLUDES) $< -o $@
+
+$(BUILD_PATH):
+	@mkdir -p $(BUILD_PATH)
+
+$(OUTPUT_PATH):
+	@mkdir -p $(OUTPUT_PATH)
+
+
+# ================================= Target clean ====================================
+.PHONY += clean
+clean:
+	@rm -rf $(BUILD_PATH) $(OUTPUT_PATH)/simulator
+	$(info Simulator build removed.)
@@ -7,10 +7,17 @@
 
 #include "SoftTimer.h"
 #include "Platform.h"
+#include "RepRap.h"
 #include "Movement/DDA.h"
 
 SoftTimer * volatile SoftTimer::pendingList = nullptr;
 
+volatile unsigned int SoftTimer::numScheduled = 0;
+unsigned int SoftTimer::maxScheduled = 0;
+unsigned int SoftTimer::maxInsertSearchDepth = 0;
+uint32_t SoftTimer::callbacksExecuted = 0;
+SoftTimer::Ticks SoftTimer::maxTicksInInterrupt = 0;
+
 SoftTimer::SoftTimer() : next(nullptr), callback(nullptr)
 {
 }
@@ -38,14 +45,25 @@ bool SoftTimer::ScheduleCallback(Ticks when, Callback cb, void *param)
 	}
 	else
 	{
+		unsigned int searchDepth = 0;
 		while (*ppst != nullptr && (int32_t)((*ppst)->whenDue - now) < howSoon)
 		{
 			ppst = &((*ppst)->next);
+			++searchDepth;
+		}
+		if (searchDepth > maxInsertSearchDepth)
+		{
+			maxInsertSearchDepth = searchDepth;
 		}
 	}
 
 	next = *ppst;
 	*ppst = this;
+	++numScheduled;
+	if (numScheduled > maxScheduled)
+	{
+		maxScheduled = numScheduled;
+	}
 	cpu_irq_restore(flags);
 	return false;
 }
@@ -59,6 +77,7 @@ void SoftTimer::CancelCallback()
 		if (*ppst == this)
 		{
 			*ppst = this->next;		// unlink this from the pending list
+			--numScheduled;
 			break;
 		}
 	}
@@ -80,6 +99,7 @@ void SoftTimer::CancelCallback()
 // ISR called from Platform. May sometimes get called prematurely.
 /*static*/ void SoftTimer::Interrupt()
 {
+	const Ticks startTicks = GetTimerTicksNow();
 	for (;;)
 	{
 		SoftTimer * const tmr = pendingList;
@@ -94,6 +114,8 @@ void SoftTimer::CancelCallback()
 		if (Platform::ScheduleSoftTimerInterrupt(tmr->whenDue))
 		{
 			pendingList = tmr->next;														// remove it from the pending list
+			--numScheduled;
+			++callbacksExecuted;
 			if (tmr->callback != nullptr && tmr->callback(tmr->cbParam, tmr->whenDue))		// execute its callback
 			{
 				// Schedule another callback for this timer
@@ -104,6 +126,7 @@ void SoftTimer::CancelCallback()
 				}
 				tmr->next = *ppst;
 				*ppst = tmr;
+				++numScheduled;
 			}
 		}
 		else
@@ -111,6 +134,24 @@ void SoftTimer::CancelCallback()
 			break;
 		}
 	}
+
+	const Ticks elapsed = GetTimerTicksNow() - startTicks;
+	if (elapsed > maxTicksInInterrupt)
+	{
+		maxTicksInInterrupt = elapsed;
+	}
+}
+
+// Report and reset the timer statistics
+/*static*/ void SoftTimer::Diagnostics(MessageType mtype)
+{
+	reprap.GetPlatform().MessageF(mtype, "Soft timers: %u pending (%u max), insert depth %u max, %" PRIu32 " callbacks, longest interrupt %.1fus\n",
+			numScheduled, maxScheduled, maxInsertSearchDepth, callbacksExecuted,
+			(double)((float)maxTicksInInterrupt * 1000000.0f/(float)GetTickRate()));
+	maxScheduled = numScheduled;
+	maxInsertSearchDepth = 0;
+	callbacksExecuted = 0;
+	maxTicksInInterrupt = 0;
 }
 
 // End
@@ -9,6 +9,7 @@
 #define SRC_SOFTTIMER_H_
 
 #include "RepRapFirmware.h"
+#include "MessageType.h"
 
 
 // Class to implement a software timer
@@ -35,6 +36,9 @@ public:
 	// ISR called from Platform. May sometimes get called prematurely.
 	static void Interrupt();
 
+	// Report and reset the timer statistics
+	static void Diagnostics(MessageType mtype);
+
 private:
 	SoftTimer *next;
 	Ticks whenDue;
@@ -42,6 +46,13 @@ private:
 	void *cbParam;
 
 	static SoftTimer * volatile pendingList;			// list of pending callbacks, soonest first
+
+	// Statistics for reporting under M122, so that we can see how much work the timer does in interrupt context
+	static volatile unsigned int numScheduled;			// how many timers are currently pending
+	static unsigned int maxScheduled;					// the most timers that have been pending at any one time
+	static unsigned int maxInsertSearchDepth;			// the longest walk down the pending list that an insertion has needed
+	static uint32_t callbacksExecuted;					// how many callbacks have been run
+	static Ticks maxTicksInInterrupt;					// the longest time spent in one call to Interrupt()
 };
 
 #endif /* SRC_SOFTTIMER_H_ */
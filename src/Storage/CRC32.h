@@ -7,7 +7,7 @@
 class CRC32
 {
 private:
-	static const uint32_t CRC_32_TAB[];
+	static const uint32_t CRC_32_TAB[4][256];		// four tables so that Update can use the slicing-by-4 algorithm
 	uint32_t crc;
 
 public:
@@ -8,7 +8,7 @@
 
 uint32_t FileStore::longestWriteTime = 0;
 
-FileStore::FileStore() : writeBuffer(nullptr)
+FileStore::FileStore() : writeBuffer(nullptr), pendingWriteBuffers(nullptr)
 {
 	Init();
 }
@@ -19,6 +19,13 @@ void FileStore::Init()
 	writing = false;
 	openCount = 0;
 	closeRequested = false;
+	pendingWriteBuffers = nullptr;
+	pendingWriteFailed = false;
+	deferredSync = false;
+	syncNeeded = false;
+	lastWriteTime = 0;
+	ramData = nullptr;
+	ramLength = ramPosition = 0;
 }
 
 // Invalidate the file if it uses the specified FATFS object
@@ -33,6 +40,12 @@ bool FileStore::Invalidate(const FATFS *fs, bool doClose)
 		else
 		{
 			file.fs = nullptr;
+			while (pendingWriteBuffers != nullptr)
+			{
+				FileWriteBuffer * const buf = pendingWriteBuffers;
+				pendingWriteBuffers = buf->Next();
+				reprap.GetPlatform().GetMassStorage()->ReleaseWriteBuffer(buf);
+			}
 			if (writeBuffer != nullptr)
 			{
 				reprap.GetPlatform().GetMassStorage()->ReleaseWriteBuffer(writeBuffer);
@@ -115,6 +128,21 @@ bool FileStore::Open(const char* directory, const char* fileName, OpenMode mode)
 	return true;
 }
 
+// Open this file store on a RAM copy of a file held by MassStorage. The FIL object is not valid in this mode,
+// so we clear its file system pointer to make sure that Invalidate() and IsOpenOn() leave this file alone.
+bool FileStore::OpenFromCache(const char *data, FilePosition length)
+{
+	ramData = data;
+	ramLength = length;
+	ramPosition = 0;
+	file.fs = nullptr;
+	writing = false;
+	crc.Reset();
+	inUse = true;
+	openCount = 1;
+	return true;
+}
+
 void FileStore::Duplicate()
 {
 	if (!inUse)
@@ -173,6 +201,13 @@ bool FileStore::Close()
 
 bool FileStore::ForceClose()
 {
+	if (ramData != nullptr)
+	{
+		// We are reading from a RAM copy of the file, so there is nothing to close on the SD card
+		Init();
+		return true;
+	}
+
 	bool ok = true;
 	if (writing)
 	{
@@ -200,13 +235,22 @@ bool FileStore::Seek(FilePosition pos)
 		reprap.GetPlatform().Message(ErrorMessage, "Attempt to seek on a non-open file.\n");
 		return false;
 	}
+	if (ramData != nullptr)
+	{
+		if (pos > ramLength)
+		{
+			return false;
+		}
+		ramPosition = pos;
+		return true;
+	}
 	FRESULT fr = f_lseek(&file, pos);
 	return fr == FR_OK;
 }
 
 FilePosition FileStore::Position() const
 {
-	return file.fptr;
+	return (ramData != nullptr) ? ramPosition : file.fptr;
 }
 
 #if 0	// not currently used
@@ -224,7 +268,11 @@ FilePosition FileStore::Length() const
 		return 0;
 	}
 
-	return (writeBuffer != nullptr) ? file.fsize + writeBuffer->BytesStored() : file.fsize;
+	if (ramData != nullptr)
+	{
+		return ramLength;
+	}
+	return (writeBuffer != nullptr) ? file.fsize + BytesBuffered() : file.fsize;
 }
 
 // Single character read
@@ -242,6 +290,14 @@ int FileStore::Read(char* extBuf, size_t nBytes)
 		return -1;
 	}
 
+	if (ramData != nullptr)
+	{
+		const size_t bytesAvailable = min<size_t>(nBytes, ramLength - ramPosition);
+		memcpy(extBuf, ramData + ramPosition, bytesAvailable);
+		ramPosition += bytesAvailable;
+		return (int)bytesAvailable;
+	}
+
 	UINT bytes_read;
 	FRESULT readStatus = f_read(&file, extBuf, nBytes, &bytes_read);
 	if (readStatus != FR_OK)
@@ -296,6 +352,11 @@ FRESULT FileStore::Store(const char *s, size_t len, size_t *bytesWritten)
 	{
 		longestWriteTime = time;
 	}
+	if (writeStatus == FR_OK)
+	{
+		syncNeeded = true;
+		lastWriteTime = millis();
+	}
 	return writeStatus;
 }
 
@@ -317,6 +378,13 @@ bool FileStore::Write(const char *s, size_t len)
 		return false;
 	}
 
+	if (pendingWriteFailed)
+	{
+		// A write-behind write failed since the caller last checked, so report the failure now
+		reprap.GetPlatform().Message(ErrorMessage, "Failed to write to file. Drive may be full.\n");
+		return false;
+	}
+
 	size_t totalBytesWritten = 0;
 	FRESULT writeStatus = FR_OK;
 	if (writeBuffer == nullptr)
@@ -330,15 +398,31 @@ bool FileStore::Write(const char *s, size_t len)
 			size_t bytesStored = writeBuffer->Store(s + totalBytesWritten, len - totalBytesWritten);
 			if (writeBuffer->BytesLeft() == 0)
 			{
-				const size_t bytesToWrite = writeBuffer->BytesStored();
-				size_t bytesWritten;
-				writeStatus = Store(writeBuffer->Data(), bytesToWrite, &bytesWritten);
-				writeBuffer->DataTaken();
-
-				if (bytesToWrite != bytesWritten)
+				// The buffer is full. If we can get another one then queue this one for write-behind, so that
+				// MassStorage::Spin() writes it to the SD card while our caller gets on with filling the next one.
+				FileWriteBuffer * const nb = reprap.GetPlatform().GetMassStorage()->AllocateWriteBuffer();
+				if (nb != nullptr)
 				{
-					// Something went wrong
-					break;
+					QueuePendingWriteBuffer(nb);
+				}
+				else
+				{
+					// No free buffer available, so catch up: write any queued buffers and then this one, in order
+					if (!WriteAllPendingBuffers())
+					{
+						writeStatus = FR_DISK_ERR;
+						break;
+					}
+					const size_t bytesToWrite = writeBuffer->BytesStored();
+					size_t bytesWritten;
+					writeStatus = Store(writeBuffer->Data(), bytesToWrite, &bytesWritten);
+					writeBuffer->DataTaken();
+
+					if (bytesToWrite != bytesWritten)
+					{
+						// Something went wrong
+						break;
+					}
 				}
 			}
 			totalBytesWritten += bytesStored;
@@ -354,32 +438,129 @@ bool FileStore::Write(const char *s, size_t len)
 	return true;
 }
 
-bool FileStore::Flush()
+// Add the current write buffer to the tail of the write-behind queue and adopt 'nb' as the new one
+void FileStore::QueuePendingWriteBuffer(FileWriteBuffer *nb)
 {
-	if (!inUse)
+	writeBuffer->SetNext(nullptr);
+	if (pendingWriteBuffers == nullptr)
 	{
-		reprap.GetPlatform().Message(ErrorMessage, "Attempt to flush a non-open file.\n");
-		return false;
+		pendingWriteBuffers = writeBuffer;
 	}
+	else
+	{
+		FileWriteBuffer *last = pendingWriteBuffers;
+		while (last->Next() != nullptr)
+		{
+			last = last->Next();
+		}
+		last->SetNext(writeBuffer);
+	}
+	writeBuffer = nb;
+}
 
+// Write the oldest queued write-behind buffer to the file and return it to the pool. Returns true if successful.
+// Called from MassStorage::Spin() so that upload data gets written to the SD card outside the network code,
+// and by ourselves when we need to catch up. On failure we record the error for the next Write or Flush call,
+// because the caller that stored the data has already been told that it succeeded.
+bool FileStore::WriteOnePendingBuffer()
+{
+	FileWriteBuffer * const buf = pendingWriteBuffers;
+	if (buf != nullptr)
+	{
+		pendingWriteBuffers = buf->Next();
+		const size_t bytesToWrite = buf->BytesStored();
+		size_t bytesWritten;
+		const FRESULT writeStatus = Store(buf->Data(), bytesToWrite, &bytesWritten);
+		reprap.GetPlatform().GetMassStorage()->ReleaseWriteBuffer(buf);
+		if ((writeStatus != FR_OK) || (bytesToWrite != bytesWritten))
+		{
+			pendingWriteFailed = true;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Write out all queued write-behind buffers in order. The queue is emptied even if a write fails.
+bool FileStore::WriteAllPendingBuffers()
+{
+	bool ok = true;
+	while (pendingWriteBuffers != nullptr)
+	{
+		if (!WriteOnePendingBuffer())
+		{
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+// Return the number of bytes of data held in RAM waiting to be written
+size_t FileStore::BytesBuffered() const
+{
+	size_t bytes = (writeBuffer != nullptr) ? writeBuffer->BytesStored() : 0;
+	for (const FileWriteBuffer *buf = pendingWriteBuffers; buf != nullptr; buf = buf->Next())
+	{
+		bytes += buf->BytesStored();
+	}
+	return bytes;
+}
+
+// Write out all buffered data, reporting an error if any write fails
+bool FileStore::FlushBuffers()
+{
 	if (writeBuffer != nullptr)
 	{
+		bool ok = WriteAllPendingBuffers();				// this empties the queue even if a write fails
 		const size_t bytesToWrite = writeBuffer->BytesStored();
-		if (bytesToWrite != 0)
+		if (ok && bytesToWrite != 0)
 		{
 			size_t bytesWritten;
 			const FRESULT writeStatus = Store(writeBuffer->Data(), bytesToWrite, &bytesWritten);
-			writeBuffer->DataTaken();
+			ok = (writeStatus == FR_OK) && (bytesToWrite == bytesWritten);
+		}
+		writeBuffer->DataTaken();
 
-			if ((writeStatus != FR_OK) || (bytesToWrite != bytesWritten))
-			{
-				reprap.GetPlatform().Message(ErrorMessage, "Failed to write to file. Drive may be full.\n");
-				return false;
-			}
+		if (!ok || pendingWriteFailed)
+		{
+			reprap.GetPlatform().Message(ErrorMessage, "Failed to write to file. Drive may be full.\n");
+			return false;
 		}
 	}
+	return true;
+}
+
+bool FileStore::Flush()
+{
+	if (!inUse)
+	{
+		reprap.GetPlatform().Message(ErrorMessage, "Attempt to flush a non-open file.\n");
+		return false;
+	}
 
-	return f_sync(&file) == FR_OK;
+	if (deferredSync)
+	{
+		return FlushBuffers();							// the f_sync is done later by MassStorage::SyncAll, so that the FAT updates are batched
+	}
+	return Sync();
+}
+
+// As Flush, but also bring the FAT and directory entry up to date even if sync is deferred.
+// Called by MassStorage::SyncAll for files that use deferred sync.
+bool FileStore::Sync()
+{
+	const bool ok = FlushBuffers();
+	syncNeeded = false;
+	return f_sync(&file) == FR_OK && ok;
+}
+
+// Batch FAT updates for this file. Each f_sync (and hence each Flush) rewrites the FAT and the directory
+// entry, which costs time and flash wear; a file that is written often and kept open can opt to leave the
+// sync to MassStorage::SyncAll, which runs when the file has not been written for a while, and is forced
+// before power-sensitive events. The data writes themselves are not delayed, only the metadata updates.
+void FileStore::UseDeferredSync()
+{
+	deferredSync = true;
 }
 
 float FileStore::GetAndClearLongestWriteTime()
@@ -389,24 +570,31 @@ float FileStore::GetAndClearLongestWriteTime()
 	return ret;
 }
 
-#if 0	// not currently used
-
-// Provide a cluster map for fast seeking. Needs _USE_FASTSEEK defined as 1 in conf_fatfs to make any difference.
+// Provide a cluster map for fast seeking. Needs _USE_FASTSEEK defined as 1 in ffconf.h to make any difference.
 // The first element of the table must be set to the total number of 32-bit entries in the table before calling this.
-bool FileStore::SetClusterMap(uint32_t tbl[])
+// With the map in place, FatFS locates the cluster for any file offset directly instead of walking the FAT chain,
+// which speeds up both long sequential reads and mid-file seeks. Each caller provides its own table, so if another
+// open file is still using the same table (e.g. GCodes reusing its table for a new print file) we revert that file
+// to normal FAT traversal first.
+bool FileStore::SetClusterMap(DWORD tbl[])
 {
-	if (!inUse)
+	if (!inUse || ramData != nullptr)
 	{
-		platform->Message(ErrorMessage, "attempt to set cluster map for a non-open file.\n");
+		reprap.GetPlatform().Message(ErrorMessage, "Attempt to set cluster map for a non-open file.\n");
 		return false;
 	}
 
+	reprap.GetPlatform().GetMassStorage()->ReleaseClusterMap(tbl);
+
 	file.cltbl = tbl;
-	FRESULT ret = f_lseek(&file, CREATE_LINKMAP);
-//	debugPrintf("ret %d need %u\n", (int)ret, tbl[0]);
-	return ret == FR_OK;
+	const FRESULT ret = f_lseek(&file, CREATE_LINKMAP);
+	if (ret != FR_OK)
+	{
+		// Most likely the file is too fragmented for the table. Revert to normal FAT chain traversal.
+		file.cltbl = nullptr;
+		return false;
+	}
+	return true;
 }
 
-#endif
-
 // End
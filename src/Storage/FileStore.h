@@ -17,12 +17,23 @@ enum class OpenMode : uint8_t
 	append			// append to an existing file, or create a new file if it is not found
 };
 
+// Size of a table passed to SetClusterMap. Each file fragment uses two entries plus one for the header.
+#if SAM4E || SAM4S || SAME70
+const size_t FileClusterMapSize = 100;				// enough for a file in up to 49 fragments
+#else
+const size_t FileClusterMapSize = 50;				// enough for a file in up to 24 fragments; we are more memory-constrained on the SAM3X
+#endif
+
+// How long a file using deferred sync may be left with unsynced data before MassStorage::Spin syncs it anyway
+const uint32_t FileSyncInterval = 4000;				// milliseconds
+
 class FileStore
 {
 public:
 	FileStore();
 
     bool Open(const char* directory, const char* fileName, OpenMode mode);
+	bool OpenFromCache(const char *data, FilePosition length);	// Open this file store on a RAM copy of a file held by MassStorage
 	bool Read(char& b);								// Read 1 byte
 	int Read(char* buf, size_t nBytes);				// Read a block of nBytes length
 	int ReadLine(char* buf, size_t nBytes);			// As Read but stop after '\n' or '\r\n' and null-terminate
@@ -40,13 +51,13 @@ public:
 	FilePosition Length() const;					// File size in bytes
 	void Duplicate();								// Create a second reference to this file
 	bool Flush();									// Write remaining buffer data
+	bool Sync();									// As Flush, but also bring the FAT and directory entry up to date even if sync is deferred
+	void UseDeferredSync();							// Batch FAT updates for this file: Flush writes the data but leaves the sync to MassStorage::SyncAll
 	bool Invalidate(const FATFS *fs, bool doClose);	// Invalidate the file if it uses the specified FATFS object
 	bool IsOpenOn(const FATFS *fs) const;			// Return true if the file is open on the specified file system
 	uint32_t GetCRC32() const;
 
-#if 0	// not currently used
-	bool SetClusterMap(uint32_t[]);					// Provide a cluster map for fast seeking
-#endif
+	bool SetClusterMap(DWORD[]);					// Provide a cluster map for fast seeking
 	static float GetAndClearLongestWriteTime();		// Return the longest time it took to write a block to a file, in milliseconds
 
 	friend class MassStorage;
@@ -54,16 +65,32 @@ public:
 private:
 	void Init();
 	FRESULT Store(const char *s, size_t len, size_t *bytesWritten); // Write data to the non-volatile storage
+	void QueuePendingWriteBuffer(FileWriteBuffer *nb);	// Queue the current write buffer for write-behind and adopt a new one
+	bool WriteOnePendingBuffer();					// Write the oldest queued buffer to the file; called by MassStorage::Spin too
+	bool WriteAllPendingBuffers();					// Write out all queued buffers in order
+	bool FlushBuffers();							// Write out all buffered data, reporting an error if any write fails
+	size_t BytesBuffered() const;					// How many bytes are in RAM waiting to be written
 
     FIL file;
-	FileWriteBuffer *writeBuffer;
+	FileWriteBuffer *writeBuffer;					// the buffer we are currently filling, or nullptr if writes are unbuffered
+	FileWriteBuffer *pendingWriteBuffers;			// full buffers queued for write-behind, oldest first
+	bool pendingWriteFailed;						// true if a write-behind write failed, reported at the next Write or Flush
 	volatile unsigned int openCount;
 	volatile bool closeRequested;
 
 	bool inUse;
 	bool writing;
+	bool deferredSync;								// if true, Flush leaves the f_sync to MassStorage::SyncAll so that FAT updates are batched
+	bool syncNeeded;								// has data been written since the last f_sync?
+	uint32_t lastWriteTime;							// when syncNeeded was last set, so that SyncAll can leave recently-written files alone
 	CRC32 crc;
 
+	// These support reading from a RAM copy of a file instead of from the SD card. When ramData is non-null,
+	// reads, seeks and position/length queries are served from the RAM copy and the FIL object is not valid.
+	const char *ramData;
+	FilePosition ramLength;
+	FilePosition ramPosition;
+
 	static uint32_t longestWriteTime;
 };
 
@@ -11,10 +11,10 @@
 #include "RepRapFirmware.h"
 
 #if SAM4E || SAM4S || SAME70
-const size_t NumFileWriteBuffers = 2;					// Number of write buffers
+const size_t NumFileWriteBuffers = 4;					// Number of write buffers; we need several for write-behind to work
 const size_t FileWriteBufLen = 8192;					// Size of each write buffer
 #else
-const size_t NumFileWriteBuffers = 1;
+const size_t NumFileWriteBuffers = 2;					// We are more memory-constrained on the SAM3X
 const size_t FileWriteBufLen = 4096;
 #endif
 
@@ -0,0 +1,681 @@
+/*
+ * GZipDecompressor.cpp
+ *
+ * Streaming DEFLATE decompressor for gzip streams. The decoder is a straightforward canonical
+ * Huffman implementation in the style of zlib's 'puff' reference inflater, restructured as a
+ * state machine so that it can be suspended whenever the current input chunk runs out and
+ * resumed when the next one arrives.
+ */
+
+#include "GZipDecompressor.h"
+
+#if SAM4E || SAM4S || SAME70
+
+#include <cstring>
+
+// Base lengths and extra bit counts for the length symbols 257-285
+static const uint16_t LengthBase[29] =
+{
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t LengthExtra[29] =
+{
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+// Base distances and extra bit counts for the distance symbols 0-29
+static const uint16_t DistanceBase[30] =
+{
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t DistanceExtra[30] =
+{
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// The order in which the code lengths of the code length code are transmitted
+static const uint8_t ClenOrder[19] =
+{
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+GZipDecompressor::GZipDecompressor()
+	: outputFile(nullptr), window(nullptr), inPtr(nullptr), inLen(0), bitBuffer(0), bitCount(0),
+	  state(InflateState::gzHeader), errorMessage(nullptr), bytesWritten(0),
+	  fieldValue(0), fieldBytes(0), storedBytesLeft(0), lastBlock(false), gzFlags(0),
+	  fixedTablesBuilt(false), numLitLenCodes(0), numDistCodes(0), numClenCodes(0),
+	  lengthIndex(0), pendingLength(0), pendingDistSym(-1)
+{
+}
+
+// Begin decompressing to the given file, returning false if we are already busy or cannot get a window buffer
+bool GZipDecompressor::Start(FileStore *f)
+{
+	if (outputFile != nullptr || f == nullptr)
+	{
+		return false;
+	}
+
+	if (window == nullptr)
+	{
+		window = new char[GzipWindowSize];
+		if (window == nullptr)
+		{
+			return false;
+		}
+	}
+
+	outputFile = f;
+	bitBuffer = 0;
+	bitCount = 0;
+	state = InflateState::gzHeader;
+	errorMessage = nullptr;
+	outputCrc.Reset();
+	bytesWritten = 0;
+	fieldValue = 0;
+	fieldBytes = 0;
+	storedBytesLeft = 0;
+	lastBlock = false;
+	gzFlags = 0;
+	fixedTablesBuilt = false;
+	pendingDistSym = -1;
+	return true;
+}
+
+// Stop without finishing, e.g. because the connection was lost
+void GZipDecompressor::Abandon()
+{
+	outputFile = nullptr;
+}
+
+// Record an error and go idle. The output file is left for the caller to close and delete.
+GZipDecompressor::PutResult GZipDecompressor::Fail(const char *msg)
+{
+	errorMessage = msg;
+	outputFile = nullptr;
+	return PutResult::error;
+}
+
+// Try to get at least n bits into the accumulator, returning false if the input has run out.
+// n must not exceed 25, so that a whole byte can always be appended when fewer bits are held.
+inline bool GZipDecompressor::EnsureBits(unsigned int n)
+{
+	while (bitCount < n)
+	{
+		if (inLen == 0)
+		{
+			return false;
+		}
+		bitBuffer |= (uint32_t)(*inPtr++) << bitCount;
+		--inLen;
+		bitCount += 8;
+	}
+	return true;
+}
+
+// Remove and return the next n bits. TakeBits(0) is legal and returns 0.
+inline uint32_t GZipDecompressor::TakeBits(unsigned int n)
+{
+	const uint32_t ret = bitBuffer & ((1u << n) - 1u);
+	bitBuffer >>= n;
+	bitCount -= n;
+	return ret;
+}
+
+// Decode one symbol, returning -1 if the code is invalid. The accumulator must already hold
+// at least MaxCodeBits bits, so that we never run out of input partway through a symbol.
+int GZipDecompressor::DecodeSymbol(const HuffmanTable& table)
+{
+	int code = 0, first = 0, index = 0;
+	for (unsigned int len = 1; len <= MaxCodeBits; ++len)
+	{
+		code |= (int)TakeBits(1);
+		const int count = table.counts[len];
+		if (code - count < first)
+		{
+			return table.symbols[index + (code - first)];
+		}
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+// Build a canonical Huffman decoding table from a list of code lengths.
+// Returns 0 for a complete code, a negative value for an over-subscribed (invalid) code,
+// and a positive value for an incomplete code, which is legal in a few cases.
+/*static*/ int GZipDecompressor::BuildTable(HuffmanTable& table, const uint8_t *lengths, unsigned int numSymbols)
+{
+	for (unsigned int len = 0; len <= MaxCodeBits; ++len)
+	{
+		table.counts[len] = 0;
+	}
+	for (unsigned int sym = 0; sym < numSymbols; ++sym)
+	{
+		++table.counts[lengths[sym]];
+	}
+	if (table.counts[0] == numSymbols)
+	{
+		return 0;										// no codes at all; any attempt to decode will fail
+	}
+
+	int left = 1;										// number of possible codes left of the current length
+	for (unsigned int len = 1; len <= MaxCodeBits; ++len)
+	{
+		left <<= 1;
+		left -= table.counts[len];
+		if (left < 0)
+		{
+			return left;
+		}
+	}
+
+	uint16_t offs[MaxCodeBits + 1];
+	offs[1] = 0;
+	for (unsigned int len = 1; len < MaxCodeBits; ++len)
+	{
+		offs[len + 1] = offs[len] + table.counts[len];
+	}
+	for (unsigned int sym = 0; sym < numSymbols; ++sym)
+	{
+		if (lengths[sym] != 0)
+		{
+			table.symbols[offs[lengths[sym]]++] = sym;
+		}
+	}
+	return left;
+}
+
+// Build the fixed literal/length and distance codes defined by the format
+void GZipDecompressor::BuildFixedTables()
+{
+	uint8_t lengths[NumLitLenSymbols];
+	unsigned int sym = 0;
+	while (sym < 144) { lengths[sym++] = 8; }
+	while (sym < 256) { lengths[sym++] = 9; }
+	while (sym < 280) { lengths[sym++] = 7; }
+	while (sym < NumLitLenSymbols) { lengths[sym++] = 8; }
+	(void)BuildTable(litLenTable, lengths, NumLitLenSymbols);
+
+	for (sym = 0; sym < NumDistSymbols; ++sym)
+	{
+		lengths[sym] = 5;
+	}
+	(void)BuildTable(distTable, lengths, NumDistSymbols);
+	fixedTablesBuilt = true;
+}
+
+// Move on to the next optional gzip header field, or to the first block if there are none left
+void GZipDecompressor::StartNextHeaderField()
+{
+	fieldValue = 0;
+	fieldBytes = 0;
+	if ((gzFlags & 0x04) != 0)			// FEXTRA
+	{
+		gzFlags &= ~0x04;
+		state = InflateState::gzExtraLength;
+	}
+	else if ((gzFlags & 0x08) != 0)		// FNAME
+	{
+		gzFlags &= ~0x08;
+		state = InflateState::gzName;
+	}
+	else if ((gzFlags & 0x10) != 0)		// FCOMMENT
+	{
+		gzFlags &= ~0x10;
+		state = InflateState::gzComment;
+	}
+	else if ((gzFlags & 0x02) != 0)		// FHCRC
+	{
+		gzFlags &= ~0x02;
+		state = InflateState::gzHeaderCrc;
+	}
+	else
+	{
+		state = InflateState::blockHeader;
+	}
+}
+
+// Write one byte to the file, the window and the CRC
+inline bool GZipDecompressor::OutputByte(uint8_t b)
+{
+	window[bytesWritten & (GzipWindowSize - 1)] = (char)b;
+	++bytesWritten;
+	outputCrc.Update((char)b);
+	return outputFile->Write((char)b);
+}
+
+// Feed the next chunk of the compressed stream
+GZipDecompressor::PutResult GZipDecompressor::PutData(const uint8_t *data, size_t len)
+{
+	inPtr = data;
+	inLen = len;
+
+	for (;;)
+	{
+		switch (state)
+		{
+		case InflateState::gzHeader:
+			while (fieldBytes < 10)
+			{
+				if (!EnsureBits(8))
+				{
+					return PutResult::ok;
+				}
+				const uint8_t b = (uint8_t)TakeBits(8);
+				switch (fieldBytes)
+				{
+				case 0:
+					if (b != 0x1F)
+					{
+						return Fail("not a gzip file");
+					}
+					break;
+				case 1:
+					if (b != 0x8B)
+					{
+						return Fail("not a gzip file");
+					}
+					break;
+				case 2:
+					if (b != 8)
+					{
+						return Fail("unsupported compression method");
+					}
+					break;
+				case 3:
+					if ((b & 0xE0) != 0)
+					{
+						return Fail("unsupported flags in gzip header");
+					}
+					gzFlags = b;
+					break;
+				default:				// MTIME, XFL and OS are of no interest
+					break;
+				}
+				++fieldBytes;
+			}
+			StartNextHeaderField();
+			break;
+
+		case InflateState::gzExtraLength:
+			if (!EnsureBits(16))
+			{
+				return PutResult::ok;
+			}
+			storedBytesLeft = TakeBits(16);
+			state = InflateState::gzExtra;
+			break;
+
+		case InflateState::gzExtra:
+			while (storedBytesLeft != 0)
+			{
+				if (!EnsureBits(8))
+				{
+					return PutResult::ok;
+				}
+				(void)TakeBits(8);
+				--storedBytesLeft;
+			}
+			StartNextHeaderField();
+			break;
+
+		case InflateState::gzName:
+		case InflateState::gzComment:
+			for (;;)
+			{
+				if (!EnsureBits(8))
+				{
+					return PutResult::ok;
+				}
+				if (TakeBits(8) == 0)
+				{
+					break;
+				}
+			}
+			StartNextHeaderField();
+			break;
+
+		case InflateState::gzHeaderCrc:
+			if (!EnsureBits(16))
+			{
+				return PutResult::ok;
+			}
+			(void)TakeBits(16);
+			StartNextHeaderField();
+			break;
+
+		case InflateState::blockHeader:
+			if (!EnsureBits(3))
+			{
+				return PutResult::ok;
+			}
+			lastBlock = (TakeBits(1) != 0);
+			switch (TakeBits(2))
+			{
+			case 0:						// stored block; it starts at the next byte boundary
+				(void)TakeBits(bitCount & 7);
+				state = InflateState::storedLength;
+				break;
+			case 1:						// fixed Huffman codes
+				if (!fixedTablesBuilt)
+				{
+					BuildFixedTables();
+				}
+				state = InflateState::symbol;
+				break;
+			case 2:						// dynamic Huffman codes
+				state = InflateState::dynHeader;
+				break;
+			default:
+				return Fail("bad block type in compressed stream");
+			}
+			break;
+
+		case InflateState::storedLength:
+			if (!EnsureBits(16))
+			{
+				return PutResult::ok;
+			}
+			storedBytesLeft = TakeBits(16);
+			state = InflateState::storedNegLength;
+			break;
+
+		case InflateState::storedNegLength:
+			if (!EnsureBits(16))
+			{
+				return PutResult::ok;
+			}
+			if (TakeBits(16) != (~storedBytesLeft & 0xFFFF))
+			{
+				return Fail("corrupt stored block in compressed stream");
+			}
+			state = InflateState::storedData;
+			break;
+
+		case InflateState::storedData:
+			while (storedBytesLeft != 0)
+			{
+				if (bitCount >= 8)						// a few bytes may still be held in the bit accumulator
+				{
+					if (!OutputByte((uint8_t)TakeBits(8)))
+					{
+						return Fail("failed to write decompressed data");
+					}
+					--storedBytesLeft;
+				}
+				else if (inLen != 0)
+				{
+					const size_t chunk = min<size_t>(storedBytesLeft, inLen);
+					for (size_t i = 0; i < chunk; ++i)
+					{
+						window[bytesWritten & (GzipWindowSize - 1)] = (char)inPtr[i];
+						++bytesWritten;
+					}
+					outputCrc.Update(reinterpret_cast<const char*>(inPtr), chunk);
+					if (!outputFile->Write(inPtr, chunk))
+					{
+						return Fail("failed to write decompressed data");
+					}
+					inPtr += chunk;
+					inLen -= chunk;
+					storedBytesLeft -= chunk;
+				}
+				else
+				{
+					return PutResult::ok;
+				}
+			}
+			if (lastBlock)
+			{
+				(void)TakeBits(bitCount & 7);
+				fieldValue = 0;
+				fieldBytes = 0;
+				state = InflateState::trailer;
+			}
+			else
+			{
+				state = InflateState::blockHeader;
+			}
+			break;
+
+		case InflateState::dynHeader:
+			if (!EnsureBits(14))
+			{
+				return PutResult::ok;
+			}
+			numLitLenCodes = TakeBits(5) + 257;
+			numDistCodes = TakeBits(5) + 1;
+			numClenCodes = TakeBits(4) + 4;
+			if (numLitLenCodes > 286 || numDistCodes > NumDistSymbols)
+			{
+				return Fail("bad code counts in compressed stream");
+			}
+			memset(codeLengths, 0, NumClenSymbols);
+			lengthIndex = 0;
+			state = InflateState::dynCodeLengthCodes;
+			break;
+
+		case InflateState::dynCodeLengthCodes:
+			while (lengthIndex < numClenCodes)
+			{
+				if (!EnsureBits(3))
+				{
+					return PutResult::ok;
+				}
+				codeLengths[ClenOrder[lengthIndex++]] = (uint8_t)TakeBits(3);
+			}
+			if (BuildTable(clenTable, codeLengths, NumClenSymbols) != 0)
+			{
+				return Fail("bad code length code in compressed stream");
+			}
+			lengthIndex = 0;
+			state = InflateState::dynCodeLengths;
+			break;
+
+		case InflateState::dynCodeLengths:
+			while (lengthIndex < numLitLenCodes + numDistCodes)
+			{
+				if (!EnsureBits(14))					// code length codes are at most 7 bits, plus at most 7 extra bits
+				{
+					return PutResult::ok;
+				}
+				const int sym = DecodeSymbol(clenTable);
+				if (sym < 0)
+				{
+					return Fail("bad code length in compressed stream");
+				}
+				if (sym < 16)
+				{
+					codeLengths[lengthIndex++] = (uint8_t)sym;
+				}
+				else
+				{
+					uint8_t value = 0;
+					unsigned int repeat;
+					if (sym == 16)
+					{
+						if (lengthIndex == 0)
+						{
+							return Fail("bad code length repeat in compressed stream");
+						}
+						value = codeLengths[lengthIndex - 1];
+						repeat = 3 + TakeBits(2);
+					}
+					else if (sym == 17)
+					{
+						repeat = 3 + TakeBits(3);
+					}
+					else
+					{
+						repeat = 11 + TakeBits(7);
+					}
+					if (lengthIndex + repeat > numLitLenCodes + numDistCodes)
+					{
+						return Fail("bad code length repeat in compressed stream");
+					}
+					while (repeat-- != 0)
+					{
+						codeLengths[lengthIndex++] = value;
+					}
+				}
+			}
+			if (codeLengths[256] == 0)
+			{
+				return Fail("compressed block has no end-of-block marker");
+			}
+			{
+				int err = BuildTable(litLenTable, codeLengths, numLitLenCodes);
+				if (err < 0 || (err > 0 && numLitLenCodes != (unsigned int)(litLenTable.counts[0] + litLenTable.counts[1])))
+				{
+					return Fail("invalid literal/length code in compressed stream");
+				}
+				err = BuildTable(distTable, codeLengths + numLitLenCodes, numDistCodes);
+				if (err < 0 || (err > 0 && numDistCodes != (unsigned int)(distTable.counts[0] + distTable.counts[1])))
+				{
+					return Fail("invalid distance code in compressed stream");
+				}
+			}
+			fixedTablesBuilt = false;
+			state = InflateState::symbol;
+			break;
+
+		case InflateState::symbol:
+			for (;;)
+			{
+				// A symbol needs at most MaxCodeBits + 5 bits including its extra bits. There are always
+				// at least that many left in the stream, because the end-of-block code and the trailer follow.
+				if (!EnsureBits(MaxCodeBits + 5))
+				{
+					return PutResult::ok;
+				}
+				const int sym = DecodeSymbol(litLenTable);
+				if (sym < 0 || sym > 285)
+				{
+					return Fail("bad symbol in compressed stream");
+				}
+				if (sym < 256)
+				{
+					if (!OutputByte((uint8_t)sym))
+					{
+						return Fail("failed to write decompressed data");
+					}
+				}
+				else if (sym == 256)					// end of block
+				{
+					if (lastBlock)
+					{
+						(void)TakeBits(bitCount & 7);
+						fieldValue = 0;
+						fieldBytes = 0;
+						state = InflateState::trailer;
+					}
+					else
+					{
+						state = InflateState::blockHeader;
+					}
+					break;
+				}
+				else
+				{
+					pendingLength = LengthBase[sym - 257] + TakeBits(LengthExtra[sym - 257]);
+					state = InflateState::distance;
+					break;
+				}
+			}
+			break;
+
+		case InflateState::distance:
+			{
+				// The symbol and its extra bits could need up to 28 bits between them, which is more than
+				// EnsureBits can promise, so fetch them separately and remember the symbol in between
+				if (pendingDistSym < 0)
+				{
+					if (!EnsureBits(MaxCodeBits))
+					{
+						return PutResult::ok;
+					}
+					const int sym = DecodeSymbol(distTable);
+					if (sym < 0 || sym >= (int)NumDistSymbols)
+					{
+						return Fail("bad distance in compressed stream");
+					}
+					pendingDistSym = sym;
+				}
+				if (!EnsureBits(DistanceExtra[pendingDistSym]))	// at most 13 extra bits
+				{
+					return PutResult::ok;
+				}
+				const uint32_t dist = DistanceBase[pendingDistSym] + TakeBits(DistanceExtra[pendingDistSym]);
+				pendingDistSym = -1;
+				if (dist > bytesWritten)
+				{
+					return Fail("compressed stream refers to data before the start of the file");
+				}
+				if (dist > GzipWindowSize)
+				{
+					return Fail("compressed stream uses a larger window than this board supports");
+				}
+
+				// Copy the match a byte at a time because it may overlap the data it is producing,
+				// but collect it in a buffer so that the file write and CRC update are done in one go
+				uint8_t buf[MaxMatchLength];
+				const size_t matchLen = pendingLength;
+				for (size_t i = 0; i < matchLen; ++i)
+				{
+					const char b = window[(bytesWritten - dist) & (GzipWindowSize - 1)];
+					window[bytesWritten & (GzipWindowSize - 1)] = b;
+					++bytesWritten;
+					buf[i] = (uint8_t)b;
+				}
+				outputCrc.Update(reinterpret_cast<const char*>(buf), matchLen);
+				if (!outputFile->Write(buf, matchLen))
+				{
+					return Fail("failed to write decompressed data");
+				}
+				state = InflateState::symbol;
+			}
+			break;
+
+		case InflateState::trailer:
+			while (fieldBytes < 8)
+			{
+				if (!EnsureBits(8))
+				{
+					return PutResult::ok;
+				}
+				fieldValue |= TakeBits(8) << (8 * (fieldBytes & 3));
+				++fieldBytes;
+				if (fieldBytes == 4)
+				{
+					if (fieldValue != outputCrc.Get())
+					{
+						return Fail("CRC mismatch in decompressed file");
+					}
+					fieldValue = 0;
+				}
+			}
+			if (fieldValue != (uint32_t)bytesWritten)
+			{
+				return Fail("length mismatch in decompressed file");
+			}
+			if (bitCount >= 8 || inLen != 0)
+			{
+				return Fail("unexpected data after the end of the gzip stream");
+			}
+			outputFile = nullptr;
+			return PutResult::finished;
+		}
+	}
+}
+
+#endif
+
+// End
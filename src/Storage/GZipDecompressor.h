@@ -0,0 +1,130 @@
+/*
+ * GZipDecompressor.h
+ *
+ * Streaming DEFLATE decompressor for gzip streams, used to accept compressed G-code uploads.
+ * G-code compresses roughly 4:1, so on a slow or congested link it is much quicker to send the
+ * compressed file and inflate it here while writing the output through the usual write buffering.
+ *
+ * The decompressor is fed the compressed stream a chunk at a time in whatever sizes the network
+ * delivers it, so all of the decoding state including the bit accumulator lives in the object and
+ * PutData simply stops and waits for more input whenever the current chunk runs out. The history
+ * window is allocated the first time the decompressor is used and then kept for the life of the
+ * firmware, so it cannot fragment the heap.
+ */
+
+#ifndef SRC_STORAGE_GZIPDECOMPRESSOR_H_
+#define SRC_STORAGE_GZIPDECOMPRESSOR_H_
+
+#include "RepRapFirmware.h"
+
+#if SAM4E || SAM4S || SAME70
+
+#include "FileStore.h"
+#include "CRC32.h"
+
+// Size of the history window we keep. The gzip format allows backward references of up to 32Kb,
+// so on boards with less RAM to spare the sender must compress with a reduced window
+// (e.g. zlib with windowBits <= 14), else we reject the stream with a clear error message.
+#if SAME70
+const size_t GzipWindowSize = 32768;
+#else
+const size_t GzipWindowSize = 16384;
+#endif
+
+class GZipDecompressor
+{
+public:
+	GZipDecompressor();
+
+	enum class PutResult : uint8_t
+	{
+		ok = 0,										// the chunk was consumed and more input is expected
+		finished,									// the gzip stream is complete and the CRC and length in its trailer have been verified
+		error										// the stream is invalid or the output could not be written; see GetErrorMessage
+	};
+
+	bool Start(FileStore *f);						// begin decompressing to the given file, returning false if we are already busy
+	PutResult PutData(const uint8_t *data, size_t len);	// feed the next chunk of the compressed stream
+	void Abandon();									// stop without finishing, e.g. because the connection was lost
+	bool IsBusy() const { return outputFile != nullptr; }
+	const char *GetErrorMessage() const { return errorMessage; }
+	FilePosition GetBytesWritten() const { return bytesWritten; }
+
+private:
+	static const unsigned int MaxCodeBits = 15;		// longest Huffman code the format allows
+	static const unsigned int NumLitLenSymbols = 288;
+	static const unsigned int NumDistSymbols = 30;
+	static const unsigned int NumClenSymbols = 19;
+	static const size_t MaxMatchLength = 258;
+
+	// A canonical Huffman code, stored as the number of codes of each length plus the symbols
+	// sorted by code length. This is compact enough to keep two of them in the object.
+	struct HuffmanTable
+	{
+		uint16_t counts[MaxCodeBits + 1];
+		uint16_t symbols[NumLitLenSymbols];			// big enough for the largest alphabet; the others use a prefix of it
+	};
+
+	enum class InflateState : uint8_t
+	{
+		gzHeader = 0,			// reading the 10 fixed gzip header bytes
+		gzExtraLength,			// reading the length of the optional extra field
+		gzExtra,				// skipping the optional extra field
+		gzName,					// skipping the optional original filename
+		gzComment,				// skipping the optional comment
+		gzHeaderCrc,			// skipping the optional header CRC
+		blockHeader,			// reading the BFINAL/BTYPE bits of the next block
+		storedLength,			// reading the LEN field of a stored block
+		storedNegLength,		// reading and checking the NLEN field of a stored block
+		storedData,				// copying the bytes of a stored block
+		dynHeader,				// reading the HLIT/HDIST/HCLEN fields of a dynamic block
+		dynCodeLengthCodes,		// reading the code lengths of the code length code
+		dynCodeLengths,			// reading the literal/length and distance code lengths
+		symbol,					// decoding the next literal/length symbol
+		distance,				// decoding the distance of a match
+		trailer					// reading and checking the CRC32 and ISIZE trailer fields
+	};
+
+	bool EnsureBits(unsigned int n);				// try to get at least n bits into the accumulator, returning false if the input has run out; n must not exceed 25
+	uint32_t TakeBits(unsigned int n);				// remove and return the next n bits
+	int DecodeSymbol(const HuffmanTable& table);	// decode one symbol, returning -1 if the code is invalid; the accumulator must hold at least MaxCodeBits bits
+	static int BuildTable(HuffmanTable& table, const uint8_t *lengths, unsigned int numSymbols);
+	void BuildFixedTables();
+	void StartNextHeaderField();					// move on to the next optional gzip header field, or to the first block
+	bool OutputByte(uint8_t b);						// write one byte to the file, the window and the CRC
+	PutResult Fail(const char *msg);
+
+	FileStore *outputFile;							// where the decompressed data goes, or nullptr if we are idle
+	char *window;									// the history window, allocated on first use and then kept
+
+	// Input handling. These are only valid while PutData is executing, except for the bit accumulator.
+	const uint8_t *inPtr;
+	size_t inLen;
+	uint32_t bitBuffer;								// input bits not yet consumed, least recent in the low bits
+	unsigned int bitCount;							// how many bits of bitBuffer are valid
+
+	InflateState state;
+	const char *errorMessage;
+	CRC32 outputCrc;								// CRC of the decompressed data, checked against the trailer
+	FilePosition bytesWritten;						// how much decompressed data we have produced; also indexes the window
+	uint32_t fieldValue;							// accumulator for multi-byte header/trailer fields
+	unsigned int fieldBytes;						// how many bytes of the current field we have read
+	unsigned int storedBytesLeft;					// bytes still to copy in a stored block, also used to skip the extra field
+	bool lastBlock;									// was the current block flagged as the final one?
+	uint8_t gzFlags;								// the optional-field flags from the gzip header, cleared as each field is handled
+
+	// Huffman decoding state
+	HuffmanTable litLenTable;
+	HuffmanTable distTable;
+	HuffmanTable clenTable;
+	bool fixedTablesBuilt;							// do litLenTable/distTable currently hold the fixed-Huffman code?
+	unsigned int numLitLenCodes, numDistCodes, numClenCodes;
+	unsigned int lengthIndex;						// progress through the code length arrays of a dynamic block
+	unsigned int pendingLength;						// the match length decoded while we wait for its distance
+	int pendingDistSym;								// the distance symbol decoded while we wait for its extra bits, or -1
+	uint8_t codeLengths[NumLitLenSymbols + NumDistSymbols];	// the code lengths of a dynamic block as they are read
+};
+
+#endif
+
+#endif /* SRC_STORAGE_GZIPDECOMPRESSOR_H_ */
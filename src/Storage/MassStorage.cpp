@@ -59,11 +59,30 @@ void MassStorage::Init()
 		freeWriteBuffers = new FileWriteBuffer(freeWriteBuffers);
 	}
 
+	maxFilesOpen = 0;
+
+	dirCacheState = DirCacheState::invalid;
+	dirCacheLength = dirCacheReadPointer = 0;
+	cachedDirName[0] = 0;
+
+	copySrcFile = copyDstFile = nullptr;
+	copyChunkBuffer = nullptr;
+	copyDstFilename[0] = 0;
+
+	for (MacroCacheEntry& entry : macroCache)
+	{
+		entry.name[0] = 0;
+		entry.data = nullptr;
+		entry.length = 0;
+		entry.lastUsed = 0;
+	}
+
 	for (size_t card = 0; card < NumSdCards; ++card)
 	{
 		SdCardInfo& inf = info[card];
 		memset(&inf.fileSystem, 0, sizeof(inf.fileSystem));
 		inf.mounting = inf.isMounted = false;
+		inf.prestagePending = inf.prestaged = false;
 		inf.cdPin = SdCardDetectPins[card];
 		inf.cardState = CardDetectState::present;
 	}
@@ -100,12 +119,110 @@ FileWriteBuffer *MassStorage::AllocateWriteBuffer()
 
 void MassStorage::ReleaseWriteBuffer(FileWriteBuffer *buffer)
 {
+	buffer->DataTaken();			// make sure the next user starts with an empty buffer
 	buffer->SetNext(freeWriteBuffers);
 	freeWriteBuffers = buffer;
 }
 
+// Begin copying a file (M598). Returns false if the copy cannot be started, e.g. because the source file
+// does not exist, the destination cannot be created, a copy is already in progress or no buffer is free.
+bool MassStorage::StartCopy(const char *srcFilename, const char *dstFilename)
+{
+	if (CopyInProgress())
+	{
+		return false;
+	}
+
+	copyChunkBuffer = AllocateWriteBuffer();
+	if (copyChunkBuffer == nullptr)
+	{
+		return false;										// all the write buffers are in use, probably by uploads
+	}
+
+	copySrcFile = OpenFile(FS_PREFIX, srcFilename, OpenMode::read);
+	if (copySrcFile == nullptr)
+	{
+		ReleaseWriteBuffer(copyChunkBuffer);
+		copyChunkBuffer = nullptr;
+		return false;
+	}
+
+	copyDstFile = OpenFile(FS_PREFIX, dstFilename, OpenMode::write);
+	if (copyDstFile == nullptr)
+	{
+		copySrcFile->Close();
+		copySrcFile = nullptr;
+		ReleaseWriteBuffer(copyChunkBuffer);
+		copyChunkBuffer = nullptr;
+		return false;
+	}
+
+	SafeStrncpy(copyDstFilename, CombineName(FS_PREFIX, dstFilename), ARRAY_SIZE(copyDstFilename));
+	return true;
+}
+
+// Copy the next chunk of the file being copied, returning notFinished until the copy has completed.
+// On any error the partial destination file is deleted.
+GCodeResult MassStorage::AdvanceCopy(StringRef& reply)
+{
+	char * const buf = copyChunkBuffer->Data();
+	const int bytesRead = copySrcFile->Read(buf, FileWriteBufLen);
+	bool ok = (bytesRead >= 0);
+	if (ok && bytesRead != 0)
+	{
+		ok = copyDstFile->Write(buf, (size_t)bytesRead);
+	}
+
+	if (ok && bytesRead == (int)FileWriteBufLen)
+	{
+		return GCodeResult::notFinished;
+	}
+
+	// We have either finished or failed. Tidy up.
+	if (ok)
+	{
+		ok = copyDstFile->Close();
+	}
+	else
+	{
+		copyDstFile->Close();
+	}
+	copySrcFile->Close();
+	copySrcFile = copyDstFile = nullptr;
+	ReleaseWriteBuffer(copyChunkBuffer);
+	copyChunkBuffer = nullptr;
+
+	if (!ok)
+	{
+		Delete(nullptr, copyDstFilename, true);
+		reply.printf("Failed to copy file to %s", copyDstFilename);
+		return GCodeResult::error;
+	}
+	return GCodeResult::ok;
+}
+
+// Revert any open file that is still using this cluster map table to normal FAT traversal,
+// so that the table can safely be reused for another file
+void MassStorage::ReleaseClusterMap(const DWORD *tbl)
+{
+	for (FileStore& fil : files)
+	{
+		if (fil.inUse && fil.file.cltbl == tbl)
+		{
+			fil.file.cltbl = nullptr;
+		}
+	}
+}
+
 FileStore* MassStorage::OpenFile(const char* directory, const char* fileName, OpenMode mode)
 {
+	if (mode != OpenMode::read)
+	{
+		// The file is about to be modified, so forget any cached copy of it and the cached directory listing
+		InvalidateCachedMacro(CombineName(directory, fileName));
+		InvalidateDirCache();
+	}
+
 	for (size_t i = 0; i < MAX_FILES; i++)
 	{
 		if (!files[i].inUse)
@@ -125,6 +242,74 @@ FileStore* MassStorage::OpenFile(const char* directory, const char* fileName, Op
 	return nullptr;
 }
 
+// As OpenFile in read mode, but replay small macro files from the RAM cache. Tool change and pause/resume macros are
+// opened very frequently during a print, and opening a file on the SD card costs several directory reads.
+FileStore* MassStorage::OpenMacroFile(const char* directory, const char* fileName)
+{
+	const char* const location = (directory != nullptr) ? CombineName(directory, fileName) : fileName;
+
+	// See whether we have a RAM copy of this file
+	for (MacroCacheEntry& entry : macroCache)
+	{
+		if (entry.name[0] != 0 && StringEquals(entry.name, location))
+		{
+			for (size_t i = 0; i < MAX_FILES; i++)
+			{
+				if (!files[i].inUse)
+				{
+					entry.lastUsed = millis();
+					files[i].OpenFromCache(entry.data, entry.length);
+					RecordFilesOpen();
+					return &files[i];
+				}
+			}
+			reprap.GetPlatform().Message(ErrorMessage, "Max open file count exceeded.\n");
+			return nullptr;
+		}
+	}
+
+	// No RAM copy, so open the file on the SD card
+	FileStore * const f = OpenFile(directory, fileName, OpenMode::read);
+	if (f != nullptr && f->Length() <= MaxCachedMacroFileLength)
+	{
+		// The file is small enough to cache, so look for an entry to hold it. Prefer an empty entry,
+		// else replace the least recently used one that no open file is still reading from.
+		MacroCacheEntry *victim = nullptr;
+		for (MacroCacheEntry& entry : macroCache)
+		{
+			if (!IsCacheEntryInUse(entry) && (victim == nullptr || entry.name[0] == 0 || (victim->name[0] != 0 && (int32_t)(entry.lastUsed - victim->lastUsed) < 0)))
+			{
+				victim = &entry;
+				if (entry.name[0] == 0 && entry.data != nullptr)
+				{
+					break;						// an empty entry that already has a buffer is the ideal choice
+				}
+			}
+		}
+
+		if (victim != nullptr)
+		{
+			if (victim->data == nullptr)
+			{
+				victim->data = new char[MaxCachedMacroFileLength];
+			}
+			victim->name[0] = 0;				// invalidate the entry in case the read fails
+			const FilePosition length = f->Length();
+			if (f->Read(victim->data, length) == (int)length && f->Seek(0))
+			{
+				SafeStrncpy(victim->name, location, ARRAY_SIZE(victim->name));
+				victim->length = length;
+				victim->lastUsed = millis();
+			}
+			else
+			{
+				(void)f->Seek(0);				// try to restore the file position so that the caller can still use the file
+			}
+		}
+	}
+	return f;
+}
+
 // Close all files
 void MassStorage::CloseAllFiles()
 {
@@ -194,10 +379,27 @@ bool MassStorage::FindFirst(const char *directory, FileInfo &file_info)
 		loc[len - 1] = 0;
 	}
 
+	// If we hold the complete listing of this directory in the cache, serve the walk from RAM
+	if (   (dirCacheState == DirCacheState::valid || dirCacheState == DirCacheState::reading)
+		&& StringEquals(loc, cachedDirName)
+	   )
+	{
+		dirCacheState = DirCacheState::reading;
+		dirCacheReadPointer = 0;
+		return ReadDirCacheEntry(file_info);
+	}
+
+	dirCacheState = DirCacheState::invalid;
+
 	findDir.lfn = nullptr;
 	FRESULT res = f_opendir(&findDir, loc);
 	if (res == FR_OK)
 	{
+		// Start recording this walk so that we can serve the next one from RAM
+		SafeStrncpy(cachedDirName, loc, ARRAY_SIZE(cachedDirName));
+		dirCacheLength = 0;
+		dirCacheState = DirCacheState::filling;
+
 		FILINFO entry;
 		entry.lfname = file_info.fileName;
 		entry.lfsize = ARRAY_SIZE(file_info.fileName);
@@ -218,8 +420,16 @@ bool MassStorage::FindFirst(const char *directory, FileInfo &file_info)
 			file_info.size = entry.fsize;
 			file_info.lastModified = ConvertTimeStamp(entry.fdate, entry.ftime);
 
+			if (!AppendDirCacheEntry(file_info))
+			{
+				dirCacheState = DirCacheState::invalid;	// the directory is too big for the cache
+			}
 			return true;
 		}
+
+		// We reached the end of the directory without returning an entry
+		dirCacheState = (res == FR_OK) ? DirCacheState::valid		// the directory is empty, which is worth remembering too
+										: DirCacheState::invalid;
 	}
 
 	return false;
@@ -228,14 +438,25 @@ bool MassStorage::FindFirst(const char *directory, FileInfo &file_info)
 // Find the next file in a directory. Returns true if another file has been read.
 bool MassStorage::FindNext(FileInfo &file_info)
 {
+	if (dirCacheState == DirCacheState::reading)
+	{
+		return ReadDirCacheEntry(file_info);
+	}
+
 	FILINFO entry;
 	entry.lfname = file_info.fileName;
 	entry.lfsize = ARRAY_SIZE(file_info.fileName);
 
 	findDir.lfn = nullptr;
-	if (f_readdir(&findDir, &entry) != FR_OK || entry.fname[0] == 0)
+	const FRESULT res = f_readdir(&findDir, &entry);
+	if (res != FR_OK || entry.fname[0] == 0)
 	{
 		//f_closedir(findDir);
+		if (dirCacheState == DirCacheState::filling)
+		{
+			// If we got a clean end-of-directory then the cache now holds the complete listing
+			dirCacheState = (res == FR_OK && entry.fname[0] == 0) ? DirCacheState::valid : DirCacheState::invalid;
+		}
 		return false;
 	}
 
@@ -248,6 +469,116 @@ bool MassStorage::FindNext(FileInfo &file_info)
 	}
 
 	file_info.lastModified = ConvertTimeStamp(entry.fdate, entry.ftime);
+
+	if (dirCacheState == DirCacheState::filling && !AppendDirCacheEntry(file_info))
+	{
+		dirCacheState = DirCacheState::invalid;			// the directory is too big for the cache
+	}
+	return true;
+}
+
+// Versions of FindFirst/FindNext that keep the iterator state in a caller-supplied DIR instead of in 'findDir'.
+// The shared versions above cannot have their walk suspended and resumed across Spin calls, because another
+// consumer (e.g. M20 or an HTTP file list request) may start its own walk in between and trash both 'findDir'
+// and the directory cache read pointer. These versions don't touch the cache, so concurrent walks are safe.
+bool MassStorage::FindFirst(const char *directory, FileInfo &file_info, DIR& dir)
+{
+	TCHAR loc[FILENAME_LENGTH + 1];
+
+	// Remove the trailing '/' from the directory name
+	SafeStrncpy(loc, directory, ARRAY_SIZE(loc));
+	const size_t len = strlen(loc);
+	if (len != 0 && loc[len - 1] == '/')
+	{
+		loc[len - 1] = 0;
+	}
+
+	dir.lfn = nullptr;
+	if (f_opendir(&dir, loc) != FR_OK)
+	{
+		return false;
+	}
+	return FindNext(file_info, dir);
+}
+
+// Find the next file in a directory using caller-supplied iterator state. Returns true if another file has been read.
+bool MassStorage::FindNext(FileInfo &file_info, DIR& dir)
+{
+	FILINFO entry;
+	entry.lfname = file_info.fileName;
+	entry.lfsize = ARRAY_SIZE(file_info.fileName);
+
+	dir.lfn = nullptr;
+	for (;;)
+	{
+		const FRESULT res = f_readdir(&dir, &entry);
+		if (res != FR_OK || entry.fname[0] == 0)
+		{
+			return false;
+		}
+		if (!StringEquals(entry.fname, ".") && !StringEquals(entry.fname, ".."))
+		{
+			break;
+		}
+	}
+
+	file_info.isDirectory = (entry.fattrib & AM_DIR);
+	file_info.size = entry.fsize;
+
+	if (file_info.fileName[0] == 0)
+	{
+		SafeStrncpy(file_info.fileName, entry.fname, ARRAY_SIZE(file_info.fileName));
+	}
+
+	file_info.lastModified = ConvertTimeStamp(entry.fdate, entry.ftime);
+	return true;
+}
+
+// Forget the cached directory listing. Called whenever anything on the cards is created, deleted, renamed or written.
+void MassStorage::InvalidateDirCache()
+{
+	dirCacheState = DirCacheState::invalid;
+}
+
+// Add an entry to the directory cache, returning false if there is no room for it.
+// Each entry is stored as a flags byte (bit 0 = directory), the file size, the last modified time and the null-terminated name.
+bool MassStorage::AppendDirCacheEntry(const FileInfo& info)
+{
+	const size_t nameLength = strlen(info.fileName) + 1;
+	const size_t entryLength = 1 + sizeof(uint32_t) + sizeof(time_t) + nameLength;
+	if (dirCacheLength + entryLength > DirCacheSize)
+	{
+		return false;
+	}
+
+	char *p = dirCache + dirCacheLength;
+	*p++ = (info.isDirectory) ? 1 : 0;
+	memcpy(p, &info.size, sizeof(uint32_t));
+	p += sizeof(uint32_t);
+	memcpy(p, &info.lastModified, sizeof(time_t));
+	p += sizeof(time_t);
+	memcpy(p, info.fileName, nameLength);
+	dirCacheLength += entryLength;
+	return true;
+}
+
+// Read the next entry from the directory cache, returning false if we have reached the end of the listing
+bool MassStorage::ReadDirCacheEntry(FileInfo& info)
+{
+	if (dirCacheReadPointer >= dirCacheLength)
+	{
+		dirCacheState = DirCacheState::valid;
+		return false;
+	}
+
+	const char *p = dirCache + dirCacheReadPointer;
+	info.isDirectory = (*p++ & 1) != 0;
+	memcpy(&info.size, p, sizeof(uint32_t));
+	p += sizeof(uint32_t);
+	memcpy(&info.lastModified, p, sizeof(time_t));
+	p += sizeof(time_t);
+	SafeStrncpy(info.fileName, p, ARRAY_SIZE(info.fileName));
+	dirCacheReadPointer += 1 + sizeof(uint32_t) + sizeof(time_t) + strlen(p) + 1;
 	return true;
 }
 
@@ -292,6 +623,8 @@ bool MassStorage::Delete(const char* directory, const char* fileName, bool silen
 		}
 		return false;
 	}
+	InvalidateCachedMacro(location);
+	InvalidateDirCache();
 	return true;
 }
 
@@ -304,6 +637,7 @@ bool MassStorage::MakeDirectory(const char *parentDir, const char *dirName)
 		reprap.GetPlatform().MessageF(ErrorMessage, "Failed to create directory %s\n", location);
 		return false;
 	}
+	InvalidateDirCache();
 	return true;
 }
 
@@ -314,6 +648,7 @@ bool MassStorage::MakeDirectory(const char *directory)
 		reprap.GetPlatform().MessageF(ErrorMessage, "Failed to create directory %s\n", directory);
 		return false;
 	}
+	InvalidateDirCache();
 	return true;
 }
 
@@ -332,6 +667,9 @@ bool MassStorage::Rename(const char *oldFilename, const char *newFilename)
 		reprap.GetPlatform().MessageF(ErrorMessage, "Failed to rename file or directory %s to %s\n", oldFilename, newFilename);
 		return false;
 	}
+	InvalidateCachedMacro(oldFilename);
+	InvalidateCachedMacro(newFilename);
+	InvalidateDirCache();
 	return true;
 }
 
@@ -389,7 +727,11 @@ bool MassStorage::SetLastModifiedTime(const char* directory, const char *fileNam
     fno.fdate = (WORD)(((timeInfo->tm_year - 80) * 512U) | (timeInfo->tm_mon + 1) * 32U | timeInfo->tm_mday);
     fno.ftime = (WORD)(timeInfo->tm_hour * 2048U | timeInfo->tm_min * 32U | timeInfo->tm_sec / 2U);
     const bool ok = (f_utime(location, &fno) == FR_OK);
-    if (!ok)
+    if (ok)
+    {
+		InvalidateDirCache();
+    }
+    else
 	{
 		reprap.GetPlatform().MessageF(ErrorMessage, "Failed to set last modified time for file '%s'\n", location);
 	}
@@ -423,6 +765,7 @@ GCodeResult MassStorage::Mount(size_t card, const StringRef& reply, bool reportS
 
 		inf.mountStartTime = millis();
 		inf.mounting = true;
+		inf.prestagePending = false;						// we are doing the card initialisation ourselves now
 		delay(2);
 	}
 
@@ -438,27 +781,36 @@ GCodeResult MassStorage::Mount(size_t card, const StringRef& reply, bool reportS
 		return GCodeResult::notFinished;						// wait for debounce to finish
 	}
 
-	const sd_mmc_err_t err = sd_mmc_check(card);
-	if (err != SD_MMC_OK && millis() - inf.mountStartTime < 5000)
+	if (inf.prestaged)
 	{
-		delay(2);
-		DEBUG_HERE;
-		return GCodeResult::notFinished;
+		// The card was initialised and its file system primed in the background when it was inserted, so there is nothing left to do
+		inf.mounting = false;
+		inf.prestaged = false;
 	}
-
-	inf.mounting = false;
-	if (err != SD_MMC_OK)
+	else
 	{
-		reply.printf("Cannot initialise SD card %u: %s", card, TranslateCardError(err));
-		return GCodeResult::error;
-	}
+		const sd_mmc_err_t err = sd_mmc_check(card);
+		if (err != SD_MMC_OK && millis() - inf.mountStartTime < 5000)
+		{
+			delay(2);
+			DEBUG_HERE;
+			return GCodeResult::notFinished;
+		}
 
-	// Mount the file systems
-	const FRESULT mounted = f_mount(card, &inf.fileSystem);
-	if (mounted != FR_OK)
-	{
-		reply.printf("Cannot mount SD card %u: code %d", card, mounted);
-		return GCodeResult::error;
+		inf.mounting = false;
+		if (err != SD_MMC_OK)
+		{
+			reply.printf("Cannot initialise SD card %u: %s", card, TranslateCardError(err));
+			return GCodeResult::error;
+		}
+
+		// Mount the file systems
+		const FRESULT mounted = f_mount(card, &inf.fileSystem);
+		if (mounted != FR_OK)
+		{
+			reply.printf("Cannot mount SD card %u: code %d", card, mounted);
+			return GCodeResult::error;
+		}
 	}
 
 	inf.isMounted = true;
@@ -523,6 +875,44 @@ bool MassStorage::AnyFileOpen(const FATFS *fs) const
 	return false;
 }
 
+// Forget any cached copy of the specified file. Called when the file is deleted, renamed or opened for writing.
+// The buffer is not freed, because an open file may still be replaying it; the entry just becomes available for reuse.
+void MassStorage::InvalidateCachedMacro(const char *location)
+{
+	for (MacroCacheEntry& entry : macroCache)
+	{
+		if (entry.name[0] != 0 && StringEquals(entry.name, location))
+		{
+			entry.name[0] = 0;
+		}
+	}
+}
+
+// Forget all cached macro files. Called when a card is unmounted, because a different card may be inserted.
+void MassStorage::ClearMacroCache()
+{
+	for (MacroCacheEntry& entry : macroCache)
+	{
+		entry.name[0] = 0;
+	}
+}
+
+// Return true if any open file is reading from the entry, in which case we must not overwrite its buffer
+bool MassStorage::IsCacheEntryInUse(const MacroCacheEntry& entry) const
+{
+	if (entry.data != nullptr)
+	{
+		for (const FileStore& fil : files)
+		{
+			if (fil.inUse && fil.ramData == entry.data)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
 // Invalidate all open files on the specified file system, returning true if any files were invalidated
 unsigned int MassStorage::InvalidateFiles(const FATFS *fs, bool doClose)
 {
@@ -561,11 +951,14 @@ bool MassStorage::IsCardDetected(size_t card) const
 bool MassStorage::InternalUnmount(size_t card, bool doClose)
 {
 	SdCardInfo& inf = info[card];
+	ClearMacroCache();									// the cached copies belong to the card being unmounted
+	InvalidateDirCache();								// so does the cached directory listing
 	const bool invalidated = InvalidateFiles(&inf.fileSystem, doClose);
 	f_mount(card, nullptr);
 	memset(&inf.fileSystem, 0, sizeof(inf.fileSystem));
 	sd_mmc_unmount(card);
 	inf.isMounted = false;
+	inf.prestagePending = inf.prestaged = false;
 	return invalidated;
 }
 
@@ -582,6 +975,49 @@ unsigned int MassStorage::GetNumFreeFiles() const
 	return numFreeFiles;
 }
 
+// Update the high-water mark of open file objects. Called just after a file has been opened.
+void MassStorage::RecordFilesOpen()
+{
+	size_t filesOpen = 0;
+	for (const FileStore& fil : files)
+	{
+		if (fil.inUse)
+		{
+			++filesOpen;
+		}
+	}
+	if (filesOpen > maxFilesOpen)
+	{
+		maxFilesOpen = filesOpen;
+	}
+}
+
+// Report the RAM used by the file system objects and their high-water marks, for capacity planning
+void MassStorage::MemoryReport(MessageType mtype)
+{
+	size_t filesOpen = 0;
+	for (const FileStore& fil : files)
+	{
+		if (fil.inUse)
+		{
+			++filesOpen;
+		}
+	}
+	size_t macroBuffers = 0;
+	for (const MacroCacheEntry& entry : macroCache)
+	{
+		if (entry.data != nullptr)
+		{
+			++macroBuffers;
+		}
+	}
+	Platform& p = reprap.GetPlatform();
+	p.MessageF(mtype, "File objects: %u of %u open (%u max), %u bytes each, %u bytes total\n",
+				filesOpen, MAX_FILES, maxFilesOpen, sizeof(FileStore), MAX_FILES * sizeof(FileStore));
+	p.MessageF(mtype, "FatFS work areas: %u bytes; macro cache: %u of %u buffers allocated, %u bytes\n",
+				NumSdCards * sizeof(FATFS), macroBuffers, NumCachedMacroFiles, macroBuffers * MaxCachedMacroFileLength);
+}
+
 void MassStorage::Spin()
 {
 	for (size_t card = 0; card < NumSdCards; ++card)
@@ -604,6 +1040,7 @@ void MassStorage::Spin()
 					if (millis() - inf.cdChangedTime > SdCardDetectDebounceMillis)
 					{
 						inf.cardState = CardDetectState::notPresent;
+						inf.prestagePending = false;
 						if (inf.isMounted)
 						{
 							const unsigned int numFiles = InternalUnmount(card, false);
@@ -612,6 +1049,14 @@ void MassStorage::Spin()
 								reprap.GetPlatform().MessageF(ErrorMessage, "SD card %u removed with %u file(s) open on it\n", card, numFiles);
 							}
 						}
+						else if (inf.prestaged)
+						{
+							// The card was pre-staged but never mounted, so just deregister its file system
+							f_mount(card, nullptr);
+							memset(&inf.fileSystem, 0, sizeof(inf.fileSystem));
+							sd_mmc_unmount(card);
+							inf.prestaged = false;
+						}
 					}
 					break;
 
@@ -632,12 +1077,55 @@ void MassStorage::Spin()
 
 				case CardDetectState::inserting:
 					inf.cardState = CardDetectState::present;
+					if (!inf.isMounted && !inf.mounting)
+					{
+						// Start pre-staging the new card in the background, so that the eventual M21 is nearly instant
+						inf.prestagePending = true;
+						inf.prestaged = false;
+						inf.prestageStartTime = millis();
+					}
 					break;
 
 				default:
 					break;
 				}
 			}
+
+			// Background pre-staging of a newly inserted card. We initialise the card (which reads and caches its CSD, so the
+			// geometry is then known) and register and prime the file system, doing at most one card initialisation step per
+			// call so that we never stall file I/O on the other card. Operators often swap cards between queued jobs, and
+			// without this the M21 stalls for several seconds while the card is initialised from scratch.
+			if (inf.prestagePending && !inf.mounting && !inf.isMounted && inf.cardState == CardDetectState::present)
+			{
+				const sd_mmc_err_t err = sd_mmc_check(card);
+				if (err == SD_MMC_OK)
+				{
+					inf.prestagePending = false;
+					if (f_mount(card, &inf.fileSystem) == FR_OK)
+					{
+						// Force the volume mount now so that the boot sector and FAT parameters have already been read
+						// by the time Mount is called
+						char path[4];
+						path[0] = (char)('0' + card);
+						path[1] = ':';
+						path[2] = 0;
+						DIR dir;
+						if (f_opendir(&dir, path) == FR_OK)
+						{
+							inf.prestaged = true;
+						}
+						else
+						{
+							f_mount(card, nullptr);		// the volume is unreadable, so let Mount report the error
+							memset(&inf.fileSystem, 0, sizeof(inf.fileSystem));
+						}
+					}
+				}
+				else if (millis() - inf.prestageStartTime >= 5000)
+				{
+					inf.prestagePending = false;		// the card didn't initialise, so leave it for an explicit M21 to report the error
+				}
+			}
 		}
 	}
 
@@ -650,6 +1138,177 @@ void MassStorage::Spin()
 			fil.Close();
 		}
 	}
+
+	// Write-behind: write at most one queued buffer to the SD card per call, so that during uploads the
+	// network code can be filling the next buffer while we do the SD card write here
+	for (FileStore & fil : files)
+	{
+		if (fil.inUse && fil.pendingWriteBuffers != nullptr)
+		{
+			(void)fil.WriteOnePendingBuffer();
+			break;
+		}
+	}
+
+	// Deferred sync: when a file that batches its FAT updates has not been written for a while,
+	// bring its metadata up to date. One file per call, for the same reason as above.
+	const uint32_t now = millis();
+	for (FileStore & fil : files)
+	{
+		if (fil.inUse && fil.deferredSync && fil.syncNeeded && !fil.closeRequested && now - fil.lastWriteTime >= FileSyncInterval)
+		{
+			(void)fil.Sync();
+			break;
+		}
+	}
+}
+
+// Run a read/write benchmark on the card through the FileStore layer and report the results. This is
+// blocking and is meant to be run from M122 when the machine is idle, e.g. to validate a card at
+// provisioning time. The sequential figures show the sustained speed; the small random reads show the
+// worst-case latency, which is what causes G-code read stalls on a poor card during a print.
+void MassStorage::SpeedTest(MessageType mtype)
+{
+	static const char * const testFilename = "speedtest.tmp";
+	static const FilePosition testFileSize = 1024 * 1024;
+	static const size_t ReadBlockSizes[] = { 512, 4096 };
+	static const unsigned int NumRandomReads = 128;
+	static const size_t RandomReadSize = 512;
+
+	Platform& platform = reprap.GetPlatform();
+	FileWriteBuffer * const buf = AllocateWriteBuffer();
+	if (buf == nullptr)
+	{
+		platform.Message(AddError(mtype), "Speed test not run because no file write buffer is free\n");
+		return;
+	}
+
+	// Fill the buffer with pseudo-random data
+	uint32_t lcg = millis() | 1;
+	for (size_t i = 0; i < FileWriteBufLen; ++i)
+	{
+		lcg = (lcg * 1664525) + 1013904223;
+		buf->Data()[i] = (char)(lcg >> 24);
+	}
+
+	bool ok = false;
+	FileStore *f = OpenFile(platform.GetSysDir(), testFilename, OpenMode::write);
+	if (f == nullptr)
+	{
+		platform.Message(AddError(mtype), "Speed test failed to create its test file\n");
+	}
+	else
+	{
+		// Sequential write test, using the same buffered path that file uploads use
+		(void)FileStore::GetAndClearLongestWriteTime();
+		const uint32_t writeStartTime = millis();
+		ok = true;
+		for (FilePosition written = 0; ok && written < testFileSize; written += FileWriteBufLen)
+		{
+			ok = f->Write(buf->Data(), FileWriteBufLen);
+		}
+		if (ok)
+		{
+			ok = f->Flush();
+		}
+		const uint32_t writeTime = millis() - writeStartTime;
+		(void)f->Close();
+		if (!ok)
+		{
+			platform.Message(AddError(mtype), "Speed test failed to write its test file\n");
+		}
+		else
+		{
+			platform.MessageF(mtype, "SD speed test, file size %lu bytes:\n", (unsigned long)testFileSize);
+			platform.MessageF(mtype, "Write: %lu KB/s, worst block write time %.1fms\n",
+								(unsigned long)((testFileSize/1024 * 1000)/max<uint32_t>(writeTime, 1)), (double)FileStore::GetAndClearLongestWriteTime());
+		}
+	}
+
+	// Sequential read test at each block size
+	for (size_t i = 0; ok && i < ARRAY_SIZE(ReadBlockSizes); ++i)
+	{
+		const size_t blockSize = ReadBlockSizes[i];
+		f = OpenFile(platform.GetSysDir(), testFilename, OpenMode::read);
+		if (f == nullptr)
+		{
+			ok = false;
+			break;
+		}
+		uint32_t worstReadTime = 0;
+		const uint32_t readStartTime = millis();
+		for (FilePosition pos = 0; ok && pos < testFileSize; pos += blockSize)
+		{
+			const uint32_t startMicros = micros();
+			ok = (f->Read(buf->Data(), blockSize) == (int)blockSize);
+			const uint32_t readMicros = micros() - startMicros;
+			if (readMicros > worstReadTime)
+			{
+				worstReadTime = readMicros;
+			}
+		}
+		const uint32_t readTime = millis() - readStartTime;
+		(void)f->Close();
+		if (ok)
+		{
+			platform.MessageF(mtype, "Sequential read, %u byte blocks: %lu KB/s, worst block read time %.1fms\n",
+								blockSize, (unsigned long)((testFileSize/1024 * 1000)/max<uint32_t>(readTime, 1)), (double)worstReadTime/1000.0);
+		}
+	}
+
+	// Random read test, which is what retrieving G-code while simultaneously writing an upload looks like to the card
+	if (ok)
+	{
+		f = OpenFile(platform.GetSysDir(), testFilename, OpenMode::read);
+		if (f == nullptr)
+		{
+			ok = false;
+		}
+		else
+		{
+			uint32_t worstReadTime = 0, totalReadTime = 0;
+			for (unsigned int i = 0; ok && i < NumRandomReads; ++i)
+			{
+				lcg = (lcg * 1664525) + 1013904223;
+				const FilePosition pos = (lcg % (testFileSize - RandomReadSize)) & ~(RandomReadSize - 1);
+				const uint32_t startMicros = micros();		// include the seek in the timing, because locating the cluster is part of the cost
+				ok = f->Seek(pos) && (f->Read(buf->Data(), RandomReadSize) == (int)RandomReadSize);
+				const uint32_t readMicros = micros() - startMicros;
+				totalReadTime += readMicros;
+				if (readMicros > worstReadTime)
+				{
+					worstReadTime = readMicros;
+				}
+			}
+			(void)f->Close();
+			if (ok)
+			{
+				platform.MessageF(mtype, "Random read, %u reads of %u bytes: average %.1fms, worst %.1fms\n",
+									NumRandomReads, RandomReadSize, (double)totalReadTime/(1000.0 * NumRandomReads), (double)worstReadTime/1000.0);
+			}
+		}
+	}
+
+	if (!ok)
+	{
+		platform.Message(AddError(mtype), "Speed test failed to read back its test file\n");
+	}
+
+	ReleaseWriteBuffer(buf);
+	(void)Delete(platform.GetSysDir(), testFilename, true);
+}
+
+// Sync all open files that have unsynced data. Called before power-sensitive events such as turning off
+// the ATX power supply, so that deferred FAT and directory entry updates reach the card first.
+void MassStorage::SyncAll()
+{
+	for (FileStore & fil : files)
+	{
+		if (fil.inUse && fil.syncNeeded && !fil.closeRequested)
+		{
+			(void)fil.Sync();
+		}
+	}
 }
 
 // Get information about the SD card and interface speed
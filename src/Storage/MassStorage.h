@@ -5,10 +5,23 @@
 #include "Pins.h"
 #include "FileWriteBuffer.h"
 #include "Libraries/Fatfs/ff.h"
+#include "MessageType.h"
 #include "GCodes/GCodeResult.h"
 #include "FileStore.h"
 #include <ctime>
 
+// A job that uses several tools opens the same small tool change macros hundreds of times, so we keep RAM copies
+// of the most recently used small macro files and replay them from memory instead of going to the SD card each time.
+#if SAM4E || SAM4S || SAME70
+const size_t NumCachedMacroFiles = 4;				// how many macro files we can cache
+const size_t MaxCachedMacroFileLength = 1024;		// the longest macro file we cache
+const size_t DirCacheSize = 8192;					// how much RAM we use to cache the last directory listing
+#else
+const size_t NumCachedMacroFiles = 2;				// we are more memory-constrained on the SAM3X
+const size_t MaxCachedMacroFileLength = 512;
+const size_t DirCacheSize = 2048;
+#endif
+
 // Info returned by FindFirst/FindNext calls
 struct FileInfo
 {
@@ -22,8 +35,11 @@ class MassStorage
 {
 public:
 	FileStore* OpenFile(const char* directory, const char* fileName, OpenMode mode);
+	FileStore* OpenMacroFile(const char* directory, const char* fileName);	// As OpenFile in read mode, but replay small macro files from the RAM cache
 	bool FindFirst(const char *directory, FileInfo &file_info);
 	bool FindNext(FileInfo &file_info);
+	bool FindFirst(const char *directory, FileInfo &file_info, DIR& dir);	// as FindFirst but with caller-owned iterator state, for walks that are suspended across Spin calls
+	bool FindNext(FileInfo &file_info, DIR& dir);							// as FindNext but with caller-owned iterator state
 	const char* GetMonthName(const uint8_t month);
 	const char* CombineName(const char* directory, const char* fileName);
 	bool Delete(const char* directory, const char* fileName, bool silent = false);
@@ -38,14 +54,20 @@ public:
 	bool SetLastModifiedTime(const char* directory, const char *file, time_t time);
 	GCodeResult Mount(size_t card, const StringRef& reply, bool reportSuccess);
 	GCodeResult Unmount(size_t card, const StringRef& reply);
+	bool StartCopy(const char *srcFilename, const char *dstFilename);	// Begin copying a file, returning false if it cannot be started
+	GCodeResult AdvanceCopy(StringRef& reply);			// Copy the next chunk, returning notFinished until the copy has completed
+	bool CopyInProgress() const { return copySrcFile != nullptr; }
 	bool IsDriveMounted(size_t drive) const { return drive < NumSdCards && info[drive].isMounted; }
 	bool CheckDriveMounted(const char* path);
 	bool IsCardDetected(size_t card) const;
 	unsigned int InvalidateFiles(const FATFS *fs, bool doClose);	// Invalidate all open files on the specified file system, returning the number of files invalidated
 	bool AnyFileOpen(const FATFS *fs) const;						// Return true if any files are open on the file system
 	void CloseAllFiles();
+	void SyncAll();										// Sync all open files that have unsynced data; called before power-sensitive events
 	unsigned int GetNumFreeFiles() const;
 	void Spin();
+	void MemoryReport(MessageType mtype);							// Report the RAM used by the file system objects and their high-water marks
+	void SpeedTest(MessageType mtype);								// Run a read/write benchmark on the card and report the results (blocking)
 
 	enum class InfoResult : uint8_t
 	{
@@ -65,6 +87,7 @@ protected:
 
 	FileWriteBuffer *AllocateWriteBuffer();
 	void ReleaseWriteBuffer(FileWriteBuffer *buffer);
+	void ReleaseClusterMap(const DWORD *tbl);			// Revert any open file using this cluster map table to normal FAT traversal
 
 private:
 	enum class CardDetectState : uint8_t
@@ -80,21 +103,71 @@ private:
 		FATFS fileSystem;
 		uint32_t cdChangedTime;
 		uint32_t mountStartTime;
+		uint32_t prestageStartTime;
 		Pin cdPin;
 		bool mounting;
 		bool isMounted;
+		bool prestagePending;						// a card has been inserted and we have not yet pre-staged it
+		bool prestaged;								// the card has been initialised and its file system primed, so Mount has little left to do
 		CardDetectState cardState;
 	};
 
+	// A cached RAM copy of a macro file. The buffer is allocated the first time the entry is used and is then
+	// kept for the life of the firmware, so the cache cannot fragment the heap.
+	struct MacroCacheEntry
+	{
+		char name[FILENAME_LENGTH];					// the full path of the cached file, or empty if the entry is not valid
+		char *data;									// the file contents, or nullptr if no buffer has been allocated yet
+		size_t length;								// how many bytes of the buffer are used
+		uint32_t lastUsed;							// when we last replayed this file, for LRU replacement
+	};
+
 	bool InternalUnmount(size_t card, bool doClose);
+	void InvalidateDirCache();							// Forget the cached directory listing
+	bool AppendDirCacheEntry(const FileInfo& info);		// Add an entry to the directory cache, returning false if it is full
+	bool ReadDirCacheEntry(FileInfo& info);				// Read the next entry from the directory cache
+	void InvalidateCachedMacro(const char *location);	// Forget any cached copy of the specified file
+	void ClearMacroCache();								// Forget all cached macro files
+	bool IsCacheEntryInUse(const MacroCacheEntry& entry) const;	// Return true if any open file is reading from the entry
 	static time_t ConvertTimeStamp(uint16_t fdate, uint16_t ftime);
 
 	SdCardInfo info[NumSdCards];
+	MacroCacheEntry macroCache[NumCachedMacroFiles];
+	void RecordFilesOpen();											// Update the open-files high-water mark
+
+	size_t maxFilesOpen;											// the most file objects that have been open at any one time
 
 	DIR findDir;
 	char combinedName[FILENAME_LENGTH + 1];
 	FileWriteBuffer *freeWriteBuffers;
 
+	// File copy state (M598). The copy proceeds one chunk per AdvanceCopy call so that it does not
+	// stall the main loop, using a write buffer from the pool as the bounce buffer; the destination
+	// file gets its own write buffer, so its SD writes are multi-sector and use write-behind.
+	FileStore *copySrcFile;								// the file being copied, or nullptr if no copy is in progress
+	FileStore *copyDstFile;								// the file being written
+	FileWriteBuffer *copyChunkBuffer;					// the bounce buffer for the copy
+	char copyDstFilename[FILENAME_LENGTH];				// the destination path, so that we can delete a partial file on error
+
+	// Directory listing cache. DWC fetches the complete file list every time the jobs page is opened, and walking
+	// the FAT directory and reading every entry takes seconds when there are several hundred files. We record the
+	// entries of the most recently completed directory walk in a packed buffer and serve later walks of the same
+	// directory from RAM, invalidating the cache whenever anything on the cards is modified. A directory whose
+	// entries do not fit in the buffer is simply never cached.
+	enum class DirCacheState : uint8_t
+	{
+		invalid = 0,			// the cache holds nothing useful
+		filling,				// a FAT directory walk is in progress and its entries are being recorded
+		valid,					// the cache holds the complete listing of cachedDirName
+		reading					// a caller is being fed entries from the cache
+	};
+
+	char dirCache[DirCacheSize];						// the packed directory entries
+	char cachedDirName[FILENAME_LENGTH + 1];			// which directory the cache describes
+	size_t dirCacheLength;								// how many bytes of the cache are used
+	size_t dirCacheReadPointer;							// how far through the cache the current read has got
+	DirCacheState dirCacheState;
+
 	FileStore files[MAX_FILES];
 };
 
@@ -0,0 +1,198 @@
+/*
+ * Telemetry.cpp
+ *
+ * High-rate sampling of selected machine values for control tuning
+ */
+
+#include "Telemetry.h"
+#include "OutputMemory.h"
+#include "RepRap.h"
+#include "Platform.h"
+#include "GCodes/GCodes.h"
+#include "Heating/Heat.h"
+#include "Movement/Move.h"
+
+Telemetry::Telemetry()
+	: values(nullptr), timestamps(nullptr), capacity(0), head(0), tail(0),
+	  samplingInterval(0), lastSampleTime(0), axesSelected(0), heatersSelected(0), includeFanRpm(false), overruns(0)
+{
+}
+
+// How many values each sample comprises: two per selected heater (temperature and average PWM),
+// one per selected axis, and one for the fan RPM if selected
+size_t Telemetry::NumChannels() const
+{
+	size_t numChannels = (includeFanRpm) ? 1 : 0;
+	for (size_t heater = 0; heater < Heaters; ++heater)
+	{
+		if ((heatersSelected & (1u << heater)) != 0)
+		{
+			numChannels += 2;
+		}
+	}
+	for (size_t axis = 0; axis < MaxAxes; ++axis)
+	{
+		if (IsBitSet(axesSelected, axis))
+		{
+			++numChannels;
+		}
+	}
+	return numChannels;
+}
+
+// Start sampling with the given interval and channel selection, discarding any buffered samples.
+// The buffers are allocated the first time sampling is started and are never freed, to avoid fragmenting the heap.
+void Telemetry::Start(uint32_t p_samplingInterval, AxesBitmap p_axesSelected, uint32_t p_heatersSelected, bool p_includeFanRpm)
+{
+	samplingInterval = 0;								// stop sampling while we change the configuration
+	axesSelected = p_axesSelected;
+	heatersSelected = p_heatersSelected;
+	includeFanRpm = p_includeFanRpm;
+
+	if (values == nullptr)
+	{
+		values = new float[TelemetryBufferFloats];
+		timestamps = new uint32_t[MaxTelemetrySamples];
+	}
+	capacity = min<size_t>(TelemetryBufferFloats/NumChannels(), MaxTelemetrySamples);
+	head = tail = 0;
+	overruns = 0;
+	lastSampleTime = millis();
+	samplingInterval = p_samplingInterval;
+}
+
+// Take a sample if one is due. Called regularly by the Platform.
+void Telemetry::Spin()
+{
+	if (samplingInterval == 0)
+	{
+		return;
+	}
+
+	const uint32_t now = millis();
+	if (now - lastSampleTime < samplingInterval)
+	{
+		return;
+	}
+	lastSampleTime = now;
+
+	const size_t nextHead = (head + 1) % capacity;
+	if (nextHead == tail)
+	{
+		tail = (tail + 1) % capacity;					// buffer full, so overwrite the oldest sample
+		++overruns;
+	}
+
+	float *p = values + (head * NumChannels());
+	timestamps[head] = now;
+
+	Heat& heat = reprap.GetHeat();
+	for (size_t heater = 0; heater < Heaters; ++heater)
+	{
+		if ((heatersSelected & (1u << heater)) != 0)
+		{
+			*p++ = heat.GetTemperature(heater);
+			*p++ = heat.GetAveragePWM(heater);
+		}
+	}
+
+	if (axesSelected != 0)
+	{
+		float liveCoordinates[DRIVES];
+		reprap.GetMove().LiveCoordinates(liveCoordinates, reprap.GetCurrentXAxes(), reprap.GetCurrentYAxes());
+		for (size_t axis = 0; axis < MaxAxes; ++axis)
+		{
+			if (IsBitSet(axesSelected, axis))
+			{
+				*p++ = liveCoordinates[axis];
+			}
+		}
+	}
+
+	if (includeFanRpm)
+	{
+		*p++ = reprap.GetPlatform().GetFanRPM();
+	}
+
+	head = nextHead;
+}
+
+// Append the CSV column headings to the output buffer
+void Telemetry::AppendHeader(OutputBuffer *buf) const
+{
+	buf->copy("time");
+	for (size_t heater = 0; heater < Heaters; ++heater)
+	{
+		if ((heatersSelected & (1u << heater)) != 0)
+		{
+			buf->catf(",temp%u,pwm%u", heater, heater);
+		}
+	}
+	const char *const axisLetters = reprap.GetGCodes().GetAxisLetters();
+	for (size_t axis = 0; axis < MaxAxes; ++axis)
+	{
+		if (IsBitSet(axesSelected, axis))
+		{
+			buf->catf(",%c", axisLetters[axis]);
+		}
+	}
+	if (includeFanRpm)
+	{
+		buf->cat(",fanrpm");
+	}
+	buf->cat('\n');
+}
+
+// Append the buffered samples to the output buffer as CSV lines, consuming them. Only every
+// 'decimation'th sample is output, so a client that wants less data can downsample on the machine
+// instead of transferring values it will discard.
+void Telemetry::Report(OutputBuffer *buf, unsigned int decimation)
+{
+	if (decimation == 0)
+	{
+		decimation = 1;
+	}
+	AppendHeader(buf);
+
+	const size_t numChannels = NumChannels();
+	unsigned int skipCount = 0;
+	while (tail != head)
+	{
+		if (skipCount == 0)
+		{
+			buf->catf("%" PRIu32, timestamps[tail]);
+			const float *p = values + (tail * numChannels);
+			for (size_t i = 0; i < numChannels; ++i)
+			{
+				buf->catf(",%.2f", (double)p[i]);
+			}
+			buf->cat('\n');
+			skipCount = decimation;
+		}
+		--skipCount;
+		tail = (tail + 1) % capacity;
+	}
+
+	if (overruns != 0)
+	{
+		buf->catf("(%u samples lost)\n", overruns);
+		overruns = 0;
+	}
+}
+
+// Append the sampling configuration and buffer state to a reply
+void Telemetry::AppendStatus(StringRef& reply) const
+{
+	if (samplingInterval == 0)
+	{
+		reply.copy("Telemetry sampling is stopped");
+	}
+	else
+	{
+		const size_t samplesBuffered = (head - tail + capacity) % capacity;
+		reply.printf("Telemetry: sampling %u channels every %" PRIu32 "ms, %u of %u samples buffered, %u overruns",
+						NumChannels(), samplingInterval, samplesBuffered, capacity - 1, overruns);
+	}
+}
+
+// End
@@ -0,0 +1,51 @@
+/*
+ * Telemetry.h
+ *
+ * High-rate sampling of selected machine values for control tuning
+ */
+
+#ifndef SRC_TELEMETRY_H_
+#define SRC_TELEMETRY_H_
+
+#include "RepRapFirmware.h"
+
+class OutputBuffer;
+
+// This class samples selected channels (heater temperatures and PWM, live axis coordinates, fan RPM) into a RAM
+// ring buffer at a configured rate, typically much faster than the status responses are polled. A client fetches
+// the buffered samples in bulk as CSV with M930 P1, optionally decimated, so one request returns a few seconds
+// of high-rate data instead of a single snapshot per status poll.
+class Telemetry
+{
+public:
+	Telemetry();
+
+	void Start(uint32_t p_samplingInterval, AxesBitmap p_axesSelected, uint32_t p_heatersSelected, bool p_includeFanRpm);
+	void Stop() { samplingInterval = 0; }
+	bool IsActive() const { return samplingInterval != 0; }
+
+	void Spin();										// called regularly by the Platform to take samples when they are due
+	void Report(OutputBuffer *buf, unsigned int decimation);	// append the buffered samples to 'buf' as CSV and consume them
+	void AppendStatus(StringRef& reply) const;			// append the sampling configuration and buffer state to a reply
+
+private:
+	size_t NumChannels() const;							// how many values each sample comprises
+	void AppendHeader(OutputBuffer *buf) const;			// append the CSV column headings
+
+	static const size_t TelemetryBufferFloats = 1024;	// how many values we buffer; with 8 channels this is 2.5 seconds of data at 50Hz
+	static const size_t MaxTelemetrySamples = 256;		// upper bound on the number of buffered samples when there are few channels
+
+	float *values;										// ring buffer of sample values, allocated on first use and never freed
+	uint32_t *timestamps;								// the value of millis() when each buffered sample was taken
+	size_t capacity;									// how many samples the buffers hold with the current channel selection
+	size_t head, tail;									// ring buffer indices; head == tail means empty
+
+	uint32_t samplingInterval;							// milliseconds between samples, 0 means sampling is stopped
+	uint32_t lastSampleTime;							// when we took the previous sample
+	AxesBitmap axesSelected;							// which axes we record live coordinates of
+	uint32_t heatersSelected;							// which heaters we record the temperature and average PWM of
+	bool includeFanRpm;									// true to record the fan RPM reading as well
+	unsigned int overruns;								// how many samples have been overwritten because the buffer was not emptied in time
+};
+
+#endif /* SRC_TELEMETRY_H_ */
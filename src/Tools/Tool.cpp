@@ -33,6 +33,8 @@
 
 Tool * Tool::freelist = nullptr;
 
+static const float MaxPredictedStandbyInterval = 600.0;		// the longest standby-to-active interval we try to predict, in seconds
+
 // Create a new tool and return a pointer to it. If an error occurs, put an error message in 'reply' and return nullptr.
 /*static*/ Tool *Tool::Create(int toolNumber, const char *name, long d[], size_t dCount, long h[], size_t hCount, AxesBitmap xMap, AxesBitmap yMap, FansBitmap fanMap, StringRef& reply)
 {
@@ -90,16 +92,7 @@ Tool * Tool::freelist = nullptr;
 		t->filament = nullptr;
 	}
 
-	const size_t nameLength = strlen(name);
-	if (nameLength != 0)
-	{
-		t->name = new char[nameLength + 1];
-		SafeStrncpy(t->name, name, nameLength + 1);
-	}
-	else
-	{
-		t->name = nullptr;
-	}
+	SafeStrncpy(t->name, name, ARRAY_SIZE(t->name));
 
 	t->next = nullptr;
 	t->myNumber = toolNumber;
@@ -111,7 +104,18 @@ Tool * Tool::freelist = nullptr;
 	t->fanMapping = fanMap;
 	t->heaterFault = false;
 	t->axisOffsetsProbed = 0;
+	t->canExtrude = false;
+	t->canRetract = false;
 	t->displayColdExtrudeWarning = false;
+	t->whenPutOnStandby = 0;
+	t->standbyIntervalEstimate = 0.0;
+	t->reheatStarted = false;
+	t->lifetimeExtrusionMm = 0;
+	t->lifetimeExtrusionFraction = 0.0;
+	t->lifetimeHeaterSeconds = 0;
+	t->lifetimeHeaterFraction = 0.0;
+	t->lifetimeToolChanges = 0;
+	t->statsChanged = false;
 
 	for (size_t axis = 0; axis < MaxAxes; axis++)
 	{
@@ -136,6 +140,8 @@ Tool * Tool::freelist = nullptr;
 		t->filament->LoadAssignment();
 	}
 
+	t->UpdateExtrusionGate();							// set the cached permission flags, so a tool with no heaters can extrude straight away
+
 	return t;
 }
 
@@ -143,18 +149,28 @@ Tool * Tool::freelist = nullptr;
 {
 	if (t != nullptr)
 	{
-		delete t->name;
-		t->name = nullptr;
+		t->name[0] = 0;
 		t->filament = nullptr;
 		t->next = freelist;
 		freelist = t;
 	}
 }
 
+// Return how many recycled tool objects are awaiting reuse, for the diagnostics report
+/*static*/ unsigned int Tool::FreelistSize()
+{
+	unsigned int count = 0;
+	for (const Tool *t = freelist; t != nullptr; t = t->next)
+	{
+		++count;
+	}
+	return count;
+}
+
 void Tool::Print(StringRef& reply) const
 {
 	reply.printf("Tool %d - ", myNumber);
-	if (name != nullptr)
+	if (name[0] != 0)
 	{
 		reply.catf("name: %s; ", name);
 	}
@@ -177,35 +193,26 @@ void Tool::Print(StringRef& reply) const
 
 	reply.cat("; xmap:");
 	sep = ' ';
-	for (size_t xi = 0; xi < MaxAxes; ++xi)
+	for (AxesBitmap xm = xMapping; xm != 0; )
 	{
-		if ((xMapping & (1u << xi)) != 0)
-		{
-			reply.catf("%c%c", sep, reprap.GetGCodes().GetAxisLetters()[xi]);
-			sep = ',';
-		}
+		reply.catf("%c%c", sep, reprap.GetGCodes().GetAxisLetters()[TakeLowestSetBit(xm)]);
+		sep = ',';
 	}
 
 	reply.cat("; ymap:");
 	sep = ' ';
-	for (size_t yi = 0; yi < MaxAxes; ++yi)
+	for (AxesBitmap ym = yMapping; ym != 0; )
 	{
-		if ((yMapping & (1u << yi)) != 0)
-		{
-			reply.catf("%c%c", sep, reprap.GetGCodes().GetAxisLetters()[yi]);
-			sep = ',';
-		}
+		reply.catf("%c%c", sep, reprap.GetGCodes().GetAxisLetters()[TakeLowestSetBit(ym)]);
+		sep = ',';
 	}
 
 	reply.cat("; fans:");
 	sep = ' ';
-	for (size_t fi = 0; fi < NUM_FANS; ++fi)
+	for (FansBitmap fm = fanMapping; fm != 0; )
 	{
-		if ((fanMapping & (1u << fi)) != 0)
-		{
-			reply.catf("%c%u", sep, fi);
-			sep = ',';
-		}
+		reply.catf("%c%u", sep, TakeLowestSetBit(fm));
+		sep = ',';
 	}
 
 	reply.catf("; status: %s", (state == ToolState::active) ? "selected" : (state == ToolState::standby) ? "standby" : "off");
@@ -300,21 +307,44 @@ void Tool::ResetTemperatureFault(int8_t wasDudHeater)
 	}
 }
 
-bool Tool::AllHeatersAtHighTemperature(bool forExtrusion) const
+// Refresh the cached extrude/retract permission flags from the heater temperatures. This is called regularly from
+// the Heat housekeeping via RepRap::CheckToolReheat, so that ToolCanDrive - which runs in the step ISR for every
+// extruding move - is reduced to a flag test. Once a flag has been granted, the temperature must fall a little
+// below the threshold before it is revoked, so the flags do not chatter when a temperature hovers at the limit.
+void Tool::UpdateExtrusionGate()
 {
+	const float extrudeThreshold = HOT_ENOUGH_TO_EXTRUDE - ((canExtrude) ? COLD_EXTRUDE_HYSTERESIS : 0.0);
+	const float retractThreshold = HOT_ENOUGH_TO_RETRACT - ((canRetract) ? COLD_EXTRUDE_HYSTERESIS : 0.0);
+	bool extrudeOk = true, retractOk = true;
 	for (size_t heater = 0; heater < heaterCount; heater++)
 	{
 		const float temperature = reprap.GetHeat().GetTemperature(heaters[heater]);
-		if (temperature < HOT_ENOUGH_TO_RETRACT || (temperature < HOT_ENOUGH_TO_EXTRUDE && forExtrusion))
+		if (temperature < retractThreshold)
+		{
+			retractOk = false;
+		}
+		if (temperature < extrudeThreshold)
 		{
-			return false;
+			extrudeOk = false;
 		}
 	}
-	return true;
+	canExtrude = extrudeOk && retractOk;
+	canRetract = retractOk;
 }
 
 void Tool::Activate()
 {
+	if (state == ToolState::standby)
+	{
+		// Learn how long this tool spent on standby, for predicting when it will next be wanted
+		const float interval = (float)(millis() - whenPutOnStandby) * MillisToSeconds;
+		standbyIntervalEstimate = (interval > MaxPredictedStandbyInterval) ? 0.0
+									: (standbyIntervalEstimate > 0.0) ? (standbyIntervalEstimate + interval) * 0.5
+										: interval;
+	}
+	reheatStarted = false;
+	++lifetimeToolChanges;
+	statsChanged = true;
 	for (size_t heater = 0; heater < heaterCount; heater++)
 	{
 		reprap.GetHeat().SetActiveTemperature(heaters[heater], activeTemperatures[heater]);
@@ -331,9 +361,129 @@ void Tool::Standby()
 		reprap.GetHeat().SetStandbyTemperature(heaters[heater], standbyTemperatures[heater]);
 		reprap.GetHeat().Standby(heaters[heater], this);
 	}
+	whenPutOnStandby = millis();
+	reheatStarted = false;
 	state = ToolState::standby;
 }
 
+// Ramp this tool's heaters to their active temperatures ahead of selecting it, so that the heating
+// overlaps the wait for outstanding moves to complete and the tool change macros instead of starting
+// after them. Heaters shared with the currently selected tool are left alone until it is released.
+// This may be called repeatedly while a tool change is pending, so avoid redundant setpoint changes.
+void Tool::HeatersToActive() const
+{
+	const Tool * const currentTool = reprap.GetCurrentTool();
+	Heat& heat = reprap.GetHeat();
+	for (size_t heater = 0; heater < heaterCount; heater++)
+	{
+		bool sharedWithCurrentTool = false;
+		if (currentTool != nullptr && currentTool != this)
+		{
+			for (size_t h = 0; h < currentTool->heaterCount; h++)
+			{
+				if (currentTool->heaters[h] == heaters[heater])
+				{
+					sharedWithCurrentTool = true;
+					break;
+				}
+			}
+		}
+		if (!sharedWithCurrentTool)
+		{
+			if (heat.GetActiveTemperature(heaters[heater]) != activeTemperatures[heater])
+			{
+				heat.SetActiveTemperature(heaters[heater], activeTemperatures[heater]);
+			}
+			if (heat.GetStandbyTemperature(heaters[heater]) != standbyTemperatures[heater])
+			{
+				heat.SetStandbyTemperature(heaters[heater], standbyTemperatures[heater]);
+			}
+			if (heat.GetStatus(heaters[heater]) != Heat::HS_active)
+			{
+				heat.Activate(heaters[heater]);
+			}
+		}
+	}
+}
+
+// Add forward extrusion to the lifetime extruded length. Called from the extrusion bookkeeping in GCodes,
+// so this must be cheap; whole millimetres are promoted to the 32-bit count to preserve precision.
+void Tool::AccumulateExtrusion(float amount)
+{
+	if (amount > 0.0)
+	{
+		lifetimeExtrusionFraction += amount;
+		if (lifetimeExtrusionFraction >= 1.0)
+		{
+			const uint32_t wholeMm = (uint32_t)lifetimeExtrusionFraction;
+			lifetimeExtrusionMm += wholeMm;
+			lifetimeExtrusionFraction -= (float)wholeMm;
+			statsChanged = true;
+		}
+	}
+}
+
+// Called at each temperature sampling cycle. Accumulate heater-on time while any of this tool's heaters
+// is switched on, for scheduling nozzle maintenance.
+void Tool::AccumulateHeaterOnTime(float seconds)
+{
+	for (size_t heater = 0; heater < heaterCount; heater++)
+	{
+		const Heat::HeaterStatus hs = reprap.GetHeat().GetStatus(heaters[heater]);
+		if (hs == Heat::HS_active || hs == Heat::HS_standby || hs == Heat::HS_tuning)
+		{
+			lifetimeHeaterFraction += seconds;
+			if (lifetimeHeaterFraction >= 1.0)
+			{
+				const uint32_t wholeSeconds = (uint32_t)lifetimeHeaterFraction;
+				lifetimeHeaterSeconds += wholeSeconds;
+				lifetimeHeaterFraction -= (float)wholeSeconds;
+				statsChanged = true;
+			}
+			break;
+		}
+	}
+}
+
+// Called at each temperature sampling cycle. If this tool is on standby and its recent selection pattern
+// suggests it will be wanted again soon, start reheating it early so that it reaches its active temperatures
+// around the time its next T command arrives, using the heater process models to predict the reheat time.
+// If a predicted reselection fails to happen, drop the heaters back to standby and forget the prediction.
+void Tool::CheckPredictedReheat()
+{
+	if (state == ToolState::standby && standbyIntervalEstimate > 0.0)
+	{
+		const float standbyTime = (float)(millis() - whenPutOnStandby) * MillisToSeconds;
+		if (reheatStarted)
+		{
+			if (standbyTime > standbyIntervalEstimate * 2.0)
+			{
+				// The predicted reselection didn't happen, so don't leave the heaters at active temperature
+				for (size_t heater = 0; heater < heaterCount; heater++)
+				{
+					reprap.GetHeat().Standby(heaters[heater], this);
+				}
+				reheatStarted = false;
+				standbyIntervalEstimate = 0.0;
+			}
+		}
+		else
+		{
+			// Find the longest predicted reheat time of this tool's heaters
+			float reheatTime = 0.0;
+			for (size_t heater = 0; heater < heaterCount; heater++)
+			{
+				reheatTime = max<float>(reheatTime, reprap.GetHeat().GetHeatingTime(heaters[heater], activeTemperatures[heater]));
+			}
+			if (standbyTime + reheatTime >= standbyIntervalEstimate)
+			{
+				HeatersToActive();
+				reheatStarted = true;
+			}
+		}
+	}
+}
+
 void Tool::SetVariables(const float* standby, const float* active)
 {
 	for (size_t heater = 0; heater < heaterCount; heater++)
@@ -368,6 +518,7 @@ void Tool::SetVariables(const float* standby, const float* active)
 			}
 		}
 	}
+	reprap.StatusChanged();							// tool temperatures are omitted from differential status responses
 }
 
 void Tool::GetVariables(float* standby, float* active) const
@@ -379,10 +530,11 @@ void Tool::GetVariables(float* standby, float* active) const
 	}
 }
 
-// May be called from ISR
+// May be called from ISR. The permission flags are kept up to date by UpdateExtrusionGate, so there is no need
+// to consult the heater temperatures here.
 bool Tool::ToolCanDrive(bool extrude)
 {
-	if (!heaterFault && AllHeatersAtHighTemperature(extrude))
+	if (!heaterFault && ((extrude) ? canExtrude : canRetract))
 	{
 		return true;
 	}
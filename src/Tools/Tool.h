@@ -47,6 +47,7 @@ public:
 
 	static Tool *Create(int toolNumber, const char *name, long d[], size_t dCount, long h[], size_t hCount, AxesBitmap xMap, AxesBitmap yMap, FansBitmap fanMap, StringRef& reply);
 	static void Delete(Tool *t);
+	static unsigned int FreelistSize();						// how many recycled tool objects are awaiting reuse, for the diagnostics report
 
 	float GetOffset(size_t axis) const pre(axis < MaxAxes);
 	void SetOffset(size_t axis, float offs, bool byProbing) pre(axis < MaxAxes);
@@ -54,6 +55,7 @@ public:
 	size_t DriveCount() const;
 	int Drive(size_t driveNumber) const;
 	bool ToolCanDrive(bool extrude);
+	void UpdateExtrusionGate();								// refresh the cached extrude/retract permission flags from the heater temperatures
 	size_t HeaterCount() const;
 	int Heater(size_t heaterNumber) const;
 	const char *GetName() const;
@@ -71,6 +73,7 @@ public:
 	Filament *GetFilament() const { return filament; }
 	Tool *Next() const { return next; }
 	ToolState GetState() const { return state; }
+	void AccumulateExtrusion(float amount);			// add to the lifetime extruded length
 	bool WriteSettings(FileStore *f) const;			// write the tool's settings to file
 
 	friend class RepRap;
@@ -78,6 +81,9 @@ public:
 protected:
 	void Activate();
 	void Standby();
+	void HeatersToActive() const;
+	void CheckPredictedReheat();
+	void AccumulateHeaterOnTime(float seconds);
 	void FlagTemperatureFault(int8_t dudHeater);
 	void ClearTemperatureFault(int8_t wasDudHeater);
 	void UpdateExtruderAndHeaterCount(uint16_t &extruders, uint16_t &heaters) const;
@@ -86,15 +92,14 @@ protected:
 private:
 	static Tool *freelist;
 
-	Tool() : next(nullptr), filament(nullptr), name(nullptr) { }
+	Tool() : next(nullptr), filament(nullptr) { name[0] = 0; }
 
 	void SetTemperatureFault(int8_t dudHeater);
 	void ResetTemperatureFault(int8_t wasDudHeater);
-	bool AllHeatersAtHighTemperature(bool forExtrusion) const;
 
 	Tool* next;
 	Filament *filament;
-	char *name;
+	char name[ToolNameLength];		// held in the tool itself rather than on the heap, so that deleting and recreating tools cannot fragment the heap
 	float offset[MaxAxes];
 	float mix[MaxExtruders];
 	float activeTemperatures[Heaters];
@@ -108,8 +113,25 @@ private:
 	uint8_t drives[MaxExtruders];
 	int8_t heaters[Heaters];
 
+	// Lifetime usage statistics, persisted across restarts so that nozzle and drive maintenance can be
+	// scheduled on real usage rather than reconstructed from job logs
+	uint32_t lifetimeExtrusionMm;				// whole millimetres of filament fed through this tool
+	float lifetimeExtrusionFraction;			// fractional millimetres awaiting promotion to the whole count
+	uint32_t lifetimeHeaterSeconds;				// whole seconds this tool's heaters have spent switched on
+	float lifetimeHeaterFraction;				// fractional seconds awaiting promotion to the whole count
+	uint32_t lifetimeToolChanges;				// how many times this tool has been selected
+	bool statsChanged;							// true if the statistics have changed since they were last saved
+
+	// Predictive reheat state. We learn how long this tool typically spends on standby between selections,
+	// and use that together with the heater models to start reheating it shortly before its next T command.
+	uint32_t whenPutOnStandby;					// when this tool last went from active to standby
+	float standbyIntervalEstimate;				// smoothed standby-to-active interval in seconds, 0 = no estimate yet
+	bool reheatStarted;							// true if we have begun an early reheat during the current standby period
+
 	ToolState state;
 	bool heaterFault;
+	volatile bool canExtrude;					// cached permission to extrude, refreshed by UpdateExtrusionGate and read by the step ISR
+	volatile bool canRetract;					// cached permission to retract, maintained likewise
 	volatile bool displayColdExtrudeWarning;
 };
 
@@ -130,7 +152,7 @@ inline int Tool::Heater(size_t heaterNumber) const
 
 inline const char *Tool::GetName() const
 {
-	return (name == nullptr) ? "" : name;
+	return name;
 }
 
 inline int Tool::Number() const
@@ -10,6 +10,10 @@
 
 #include "SoftTimer.h"
 
+// This class sends a program to a programmable Z probe by bit-banging the probe MOD line.
+// The bit timing is entirely interrupt-driven: each bit transition is generated from a SoftTimer
+// callback scheduled at an absolute tick count derived from the start time, so there is no busy
+// waiting and no cumulative drift, and motion continues undisturbed while a program is being sent.
 class ZProbeProgrammer
 {
 public: